@@ -0,0 +1,57 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "ProgramGenerator.hpp"
+
+using namespace std;
+
+/**
+ * Writes a generated Theta program to a directory, a file per capsule, for reproducing what theta-bench measures on
+ * inputs of a given size by hand, or compiling them with `theta --time-passes`. Prints the entry file, Gen0.th.
+ *
+ * Usage: theta-generate [--out dir] [--capsules N] [--functions N] [--link-depth N] [--nesting N]
+ *                       [--closure-every N] [--overload-every N] [--seed N]
+ */
+
+int main(int argc, char **argv) {
+  filesystem::path outDir = "generated";
+  ProgramShape shape;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (i + 1 >= argc) {
+      cerr << "Missing value for " << arg << endl;
+      return 1;
+    }
+
+    if (arg == "--out") outDir = argv[++i];
+    else if (arg == "--capsules") shape.capsules = stoi(argv[++i]);
+    else if (arg == "--functions") shape.functionsPerCapsule = stoi(argv[++i]);
+    else if (arg == "--link-depth") shape.linkDepth = stoi(argv[++i]);
+    else if (arg == "--nesting") shape.expressionNesting = stoi(argv[++i]);
+    else if (arg == "--closure-every") shape.closureEvery = stoi(argv[++i]);
+    else if (arg == "--overload-every") shape.overloadEvery = stoi(argv[++i]);
+    else if (arg == "--seed") shape.seed = stoul(argv[++i]);
+    else {
+      cerr << "Unknown option " << arg << endl;
+      return 1;
+    }
+  }
+
+  if (shape.capsules < 1 || shape.functionsPerCapsule < 1 || shape.linkDepth < 0) {
+    cerr << "Programs need at least a capsule with a function, and links can't go less than 0 deep" << endl;
+    return 1;
+  }
+
+  filesystem::path entry = ProgramGenerator(shape).writeTo(outDir);
+
+  if (entry.empty()) {
+    cerr << "Failed to write the program to " << outDir << endl;
+    return 1;
+  }
+
+  cout << entry.string() << endl;
+
+  return 0;
+}
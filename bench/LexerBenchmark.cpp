@@ -0,0 +1,105 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "lexer/Lexer.cpp"
+
+using namespace std;
+
+/**
+ * Microbenchmark for the lexer. Lexes either the given file or a synthetic capsule a number of times
+ * and reports throughput in tokens/sec and MB/sec.
+ *
+ * Usage: LexerBenchmark [file.th] [--iterations N] [--repeat N]
+ */
+
+const string SYNTHETIC_CAPSULE_BODY = R"(
+    struct Point {
+        x<Number>
+        y<Number>
+    }
+
+    // Calculates a distance between two points
+    distance<Number> = p1<Point>, p2<Point> -> {
+        { x: x1, y: y1 } = p1
+        { x: x2, y: y2 } = p2
+
+        return (x2 - x1) ** 2 + (y2 - y1) ** 2
+    }
+
+    /-
+      Some multiline documentation
+      that spans a few lines
+    -/
+    classify<String> = n<Number> -> {
+        if (n >= 10 && n != 42) {
+            return 'big'
+        } else if (n <= 0 || !true) {
+            return 'small'
+        }
+
+        return 'medium: ' + 'value'
+    }
+
+    piped<Number> = a<Number> -> a => double() => add(1, 2)
+    words<List<String>> = [ 'this', 'is', 'a', 'word' ]
+    lookup<Dict<Number>> = { one: 1, two: 2.5, three: 3 % 2 }
+    counter<Number> = 10 * 2 / 4 - 1
+)";
+
+string makeSyntheticSource(int repeat) {
+  ostringstream oss;
+  oss << "link Theta.Math\n\ncapsule Benchmark {\n";
+  for (int i = 0; i < repeat; i++) oss << SYNTHETIC_CAPSULE_BODY;
+  oss << "}\n";
+
+  return oss.str();
+}
+
+int main(int argc, char **argv) {
+  string file;
+  int iterations = 20;
+  int repeat = 2000;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg == "--iterations" && i + 1 < argc) iterations = stoi(argv[++i]);
+    else if (arg == "--repeat" && i + 1 < argc) repeat = stoi(argv[++i]);
+    else file = arg;
+  }
+
+  string source;
+  if (file != "") {
+    ifstream t(file);
+    stringstream buffer;
+    buffer << t.rdbuf();
+    source = buffer.str();
+  } else {
+    source = makeSyntheticSource(repeat);
+  }
+
+  size_t tokenCount = 0;
+  chrono::duration<double> elapsed(0);
+
+  for (int i = 0; i < iterations; i++) {
+    Theta::Lexer lexer;
+
+    auto start = chrono::steady_clock::now();
+    lexer.lex(source);
+    elapsed += chrono::steady_clock::now() - start;
+
+    tokenCount += lexer.tokens.size();
+  }
+
+  double seconds = elapsed.count();
+  double megabytes = (double) source.length() * iterations / (1024 * 1024);
+
+  cout << "Lexed " << source.length() << " bytes x " << iterations << " iterations" << endl;
+  cout << "  tokens:     " << tokenCount / iterations << " per iteration" << endl;
+  cout << "  time:       " << seconds * 1000 / iterations << " ms per iteration" << endl;
+  cout << "  throughput: " << (size_t) (tokenCount / seconds) << " tokens/sec, " << megabytes / seconds << " MB/sec" << endl;
+
+  return 0;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The shape of a program ProgramGenerator generates. Each capsule has its functions call the one before them, and the
+ * first one calls into the capsules it links, so every function is reachable from main.
+ */
+struct ProgramShape {
+  int capsules = 1;
+  int functionsPerCapsule = 10;
+
+  // How many capsules deep links go. Capsules are linked in chains of this many, each linking the next, and the entry
+  // capsule links the first of each chain. 0 keeps every capsule linked straight from the entry capsule
+  int linkDepth = 0;
+
+  // How deeply the arithmetic in each function body nests
+  int expressionNesting = 2;
+
+  // Every this many functions defines a closure over its param and calls it, or none if 0
+  int closureEvery = 0;
+
+  // Every this many functions has an overload taking two params, which the function after it calls, or none if 0
+  int overloadEvery = 0;
+
+  // Picks the operators and literals, so that the same shape and seed always generate the same program
+  uint32_t seed = 1;
+};
+
+struct GeneratedFile {
+  string name;
+  string source;
+};
+
+/**
+ * Generates Theta programs of any size and shape, for benchmarking how the compiler scales with its input. Programs
+ * are a capsule per file, the first of which, Gen0, is the entry capsule and has the main function.
+ */
+class ProgramGenerator {
+public:
+  ProgramGenerator(ProgramShape shape) : shape(shape), state(shape.seed ? shape.seed : 1) {}
+
+  vector<GeneratedFile> generate() {
+    vector<GeneratedFile> files;
+
+    for (int capsule = 0; capsule < shape.capsules; capsule++) {
+      files.push_back({ getCapsuleName(capsule) + ".th", generateCapsule(capsule) });
+    }
+
+    return files;
+  }
+
+  /**
+   * @brief Writes the program's files to a directory, creating it if needed.
+   * @return The entry file, or an empty path if a file couldn't be written
+   */
+  filesystem::path writeTo(const filesystem::path &directory) {
+    filesystem::create_directories(directory);
+
+    vector<GeneratedFile> files = generate();
+
+    for (const GeneratedFile &file : files) {
+      ofstream stream(directory / file.name);
+      stream << file.source;
+
+      if (!stream.good()) return filesystem::path();
+    }
+
+    return directory / files.front().name;
+  }
+
+  static string getCapsuleName(int capsule) { return "Gen" + to_string(capsule); }
+
+  static string getFunctionName(int function) { return "f" + to_string(function); }
+
+private:
+  ProgramShape shape;
+  uint32_t state;
+
+  uint32_t next() {
+    // xorshift32, which is plenty for picking operators and literals
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state;
+  }
+
+  int getChainLength() const { return shape.linkDepth + 1; }
+
+  /**
+   * @brief The capsules a capsule links: the next one in its chain, and for the entry capsule, the first of every other
+   * chain.
+   */
+  vector<int> getLinks(int capsule) const {
+    vector<int> links;
+
+    bool isEndOfChain = (capsule + 1) % getChainLength() == 0;
+    if (!isEndOfChain && capsule + 1 < shape.capsules) links.push_back(capsule + 1);
+
+    if (capsule == 0) {
+      for (int head = getChainLength(); head < shape.capsules; head += getChainLength()) links.push_back(head);
+    }
+
+    return links;
+  }
+
+  string generateCapsule(int capsule) {
+    ostringstream oss;
+    vector<int> links = getLinks(capsule);
+
+    for (int link : links) oss << "link " << getCapsuleName(link) << "\n";
+    if (!links.empty()) oss << "\n";
+
+    oss << "capsule " << getCapsuleName(capsule) << " {\n";
+
+    int functions = shape.functionsPerCapsule > 0 ? shape.functionsPerCapsule : 1;
+
+    for (int function = 0; function < functions; function++) {
+      if (isOverloaded(function)) oss << generateOverload(function);
+
+      oss << generateFunction(function, links);
+    }
+
+    if (capsule == 0) oss << "  main<Function<Number>> = () -> " << getFunctionName(functions - 1) << "(1)\n";
+
+    oss << "}\n";
+
+    return oss.str();
+  }
+
+  bool isOverloaded(int function) const {
+    return shape.overloadEvery > 0 && function % shape.overloadEvery == 0;
+  }
+
+  string generateOverload(int function) {
+    return "  " + getFunctionName(function) + "<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> "
+      + generateExpression(shape.expressionNesting, "x") + " * y\n\n";
+  }
+
+  string generateFunction(int function, const vector<int> &links) {
+    ostringstream oss;
+    string name = getFunctionName(function);
+
+    // Each function calls the one before it, and the first calls the last function of each capsule it links
+    vector<string> calls;
+
+    if (function > 0) calls.push_back(getFunctionName(function - 1) + "(x)");
+    if (function > 0 && isOverloaded(function - 1)) calls.push_back(getFunctionName(function - 1) + "(x, 2)");
+
+    if (function == 0) {
+      int lastFunction = (shape.functionsPerCapsule > 0 ? shape.functionsPerCapsule : 1) - 1;
+
+      for (int link : links) calls.push_back(getCapsuleName(link) + "." + getFunctionName(lastFunction) + "(x)");
+    }
+
+    oss << "  " << name << "<Function<Number, Number>> = (x<Number>) -> {\n";
+
+    string value = generateExpression(shape.expressionNesting, "x");
+    for (const string &call : calls) value += " + " + call;
+
+    oss << "    y<Number> = " << value << "\n";
+
+    // Values can't be reassigned, so the closure's result gets a name of its own
+    string result = "y";
+
+    if (shape.closureEvery > 0 && function % shape.closureEvery == 0) {
+      oss << "    shift<Function<Number, Number>> = (z<Number>) -> z + x\n";
+      oss << "    shifted<Number> = shift(y)\n";
+
+      result = "shifted";
+    }
+
+    oss << "    if (" << result << " > 1000000) {\n"
+      << "      " << result << " % 1000000\n"
+      << "    } else {\n"
+      << "      " << result << " + " << next() % 100 << "\n"
+      << "    }\n"
+      << "  }\n\n";
+
+    return oss.str();
+  }
+
+  /**
+   * @brief Arithmetic nested the given number of levels deep, each level applying an operator to the one inside it and
+   * a literal or the variable. Only operators that can't trap are used.
+   */
+  string generateExpression(int nesting, const string &variable) {
+    if (nesting <= 0) return next() % 2 ? variable : to_string(next() % 100 + 1);
+
+    static const char *operators[] = { "+", "-", "*" };
+
+    string leaf = next() % 3 == 0 ? variable : to_string(next() % 100 + 1);
+
+    return "(" + generateExpression(nesting - 1, variable) + " " + operators[next() % 3] + " " + leaf + ")";
+  }
+};
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "compiler/CompilerSession.hpp"
+#include "compiler/OptimizationLevel.hpp"
+
+using namespace std;
+
+/**
+ * Microbenchmark for the string intrinsics. Searches and hashes a long string with the native intrinsics, and with
+ * versions of them written in Theta, and reports the time per run of each program. Theta can only read a string
+ * through the intrinsics, so the hand written versions are built out of the smallest of them: length, slice and
+ * charCodeAt, one call per position or code unit, as string code was written before indexOf and hash existed.
+ *
+ * Usage: StringBenchmark [--iterations N] [--doublings N]
+ */
+
+struct Comparison {
+  string name;
+  string native;
+  string handWritten;
+};
+
+string makeProgram(const string &functions, const string &body, int doublings) {
+  return R"(
+    capsule Bench {
+      grow<Function<String, Number, String>> = (text<String>, times<Number>) -> {
+        if (times == 0) {
+          text
+        } else {
+          grow(text + text, times - 1)
+        }
+      }
+    )" + functions + R"(
+      main<Function<Number>> = () -> {
+        text<String> = grow('haystack', )" + to_string(doublings) + R"() + 'needle'
+        )" + body + R"(
+      }
+    }
+  )";
+}
+
+vector<Comparison> getComparisons(int doublings) {
+  string find = R"(
+      find<Function<String, String, Number, Number>> = (text<String>, search<String>, index<Number>) -> {
+        if (index + length(search) > length(text)) {
+          -1
+        } else if (slice(text, index, index + length(search)) == search) {
+          index
+        } else {
+          find(text, search, index + 1)
+        }
+      }
+  )";
+
+  string polynomialHash = R"(
+      polynomialHash<Function<String, Number, Number, Number>> = (text<String>, index<Number>, accumulator<Number>) -> {
+        if (index == length(text)) {
+          accumulator
+        } else {
+          polynomialHash(text, index + 1, accumulator * 31 + charCodeAt(text, index))
+        }
+      }
+  )";
+
+  return {
+    { "indexOf", makeProgram("", "indexOf(text, 'needle')", doublings), makeProgram(find, "find(text, 'needle', 0)", doublings) },
+    { "hash", makeProgram("", "hash(text)", doublings), makeProgram(polynomialHash, "polynomialHash(text, 0, 0)", doublings) }
+  };
+}
+
+double timeRuns(Theta::CompilerSession &session, const vector<char> &wasm, int iterations) {
+  int64_t checksum = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) checksum += session.execute(wasm, "main0").result.i64();
+  chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+  // Keeps the runs from being optimized away
+  if (checksum == 42) cout << "";
+
+  return elapsed.count() / iterations;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 20;
+  int doublings = 12;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg == "--iterations" && i + 1 < argc) iterations = stoi(argv[++i]);
+    else if (arg == "--doublings" && i + 1 < argc) doublings = stoi(argv[++i]);
+  }
+
+  Theta::CompilerSession session;
+  Theta::OptimizationLevel level = *Theta::OptimizationLevel::fromFlag("-O3");
+
+  cout << "Ran each program " << iterations << " times, over a string of " << (8 << doublings) + 6 << " code units" << endl;
+  cout << "  intrinsic  native (ms)  hand written (ms)" << endl;
+
+  for (Comparison &comparison : getComparisons(doublings)) {
+    vector<char> native = session.compileDirect(comparison.native, level);
+    vector<char> handWritten = session.compileDirect(comparison.handWritten, level);
+
+    if (native.empty() || handWritten.empty()) {
+      cerr << "Could not compile the " << comparison.name << " programs" << endl;
+      return 1;
+    }
+
+    cout << "  " << comparison.name
+      << "\t     " << timeRuns(session, native, iterations)
+      << "\t  " << timeRuns(session, handWritten, iterations)
+      << endl;
+  }
+
+  return 0;
+}
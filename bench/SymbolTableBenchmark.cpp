@@ -0,0 +1,72 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "compiler/SymbolTableStack.hpp"
+
+using namespace std;
+
+/**
+ * Microbenchmark for scope lookups. Builds scope chains of increasing depth, with a handful of symbols in each scope,
+ * and reports the time per lookup of a symbol from the innermost scope, a symbol from the outermost scope, and a name
+ * that isn't in scope at all. Lookups from the innermost scope should cost the same however deep the chain is.
+ *
+ * Usage: SymbolTableBenchmark [--lookups N] [--symbols-per-scope N]
+ */
+
+const vector<int> DEPTHS = { 1, 4, 16, 64, 256 };
+
+double timeLookups(Theta::SymbolTableStack<shared_ptr<int>> &scopes, const string &name, int lookups) {
+  size_t found = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < lookups; i++) found += scopes.lookup(name).has_value();
+  chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+
+  // Keeps the loop from being optimized away
+  if (found == 42) cout << "";
+
+  return elapsed.count() / lookups;
+}
+
+int main(int argc, char **argv) {
+  int lookups = 2000000;
+  int symbolsPerScope = 8;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg == "--lookups" && i + 1 < argc) lookups = stoi(argv[++i]);
+    else if (arg == "--symbols-per-scope" && i + 1 < argc) symbolsPerScope = stoi(argv[++i]);
+  }
+
+  cout << "Looked up " << lookups << " times per measurement, " << symbolsPerScope << " symbols per scope" << endl;
+  cout << "  depth  innermost (ns)  outermost (ns)  missing (ns)" << endl;
+
+  for (int depth : DEPTHS) {
+    Theta::SymbolTableStack<shared_ptr<int>> scopes;
+
+    for (int d = 0; d < depth; d++) {
+      scopes.enterScope();
+
+      for (int s = 0; s < symbolsPerScope; s++) {
+        scopes.insert("scope" + to_string(d) + "symbol" + to_string(s), make_shared<int>(s));
+      }
+    }
+
+    string innermost = "scope" + to_string(depth - 1) + "symbol0";
+    string outermost = "scope0symbol0";
+
+    // Interned, but never declared, like a name that is only in scope somewhere else
+    Theta::SymbolInterner::getInstance().getId("undeclared");
+
+    cout << "  " << depth
+      << "\t " << timeLookups(scopes, innermost, lookups)
+      << "\t\t " << timeLookups(scopes, outermost, lookups)
+      << "\t\t " << timeLookups(scopes, "undeclared", lookups)
+      << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,527 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "compiler/CapsuleIndex.hpp"
+#include "compiler/CompilerSession.hpp"
+#include "compiler/PhaseTimer.hpp"
+#include "runtime/GCStats.hpp"
+#include "runtime/Runtime.hpp"
+#include "ProgramGenerator.hpp"
+
+using namespace std;
+
+/**
+ * Benchmark suite for the compiler and runtime. Compiles each input a number of times, and times every phase of the
+ * compile as the compiler records it for `theta --time-passes`: lexing, parsing, each optimization pass, type checking,
+ * code generation and serialization. Inputs that compile to a module with a main function are also compiled by V8,
+ * instantiated and run, each timed on its own. Inputs are the .th files in the fixtures directory, and programs made
+ * by ProgramGenerator with as many functions as each scale, shaped by the generator's options.
+ *
+ * Reports the percentiles of each stage, in milliseconds, and its throughput as JSON, for tracking regressions:
+ * source bytes per second for the compiler's stages, runs per second for the runtime's. Inputs that don't compile
+ * still report the phases they got through, so the fixtures with errors in them still benchmark the frontend. Phases
+ * the compiler records once per capsule are added up into one per compile. The generated programs also get a scaling
+ * report: how the median of each phase grows with the size of the program, as the exponent of the power law that fits
+ * it best, so a phase that grows quadratically with its input shows up as 2 rather than 1.
+ *
+ * Usage: theta-bench [--iterations N] [--fixtures dir] [--scales N,...] [--output file.json]
+ *                    [--capsules N] [--link-depth N] [--nesting N] [--closure-every N] [--overload-every N]
+ */
+
+struct StageSamples {
+  vector<double> ms;
+  bool isRuntime = false;
+};
+
+struct Input {
+  string name;
+
+  // Compiled from within its directory, since linked capsules are looked up in the directory the compiler runs in
+  filesystem::path directory;
+  string file;
+
+  bool isGenerated = false;
+};
+
+struct InputResult {
+  string name;
+  size_t bytes = 0;
+  bool isCompiled = false;
+  bool isGenerated = false;
+  map<string, StageSamples> stages;
+};
+
+const string RUNTIME_FUNCTION = "main0";
+
+/**
+ * Keeps the errors inputs report out of the output, since they'd otherwise be printed on every iteration.
+ */
+class SilencedOutput {
+public:
+  SilencedOutput() : previous(cout.rdbuf(silenced.rdbuf())) {}
+
+  ~SilencedOutput() { cout.rdbuf(previous); }
+
+private:
+  ostringstream silenced;
+  streambuf *previous;
+};
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * The phase a recorded phase is of, without the file or capsule it was recorded for, so that it's named the same for
+ * every capsule of every input.
+ */
+string getStageName(const string &phase, const set<string> &units) {
+  size_t space = phase.rfind(' ');
+  if (space != string::npos && units.count(phase.substr(space + 1))) return phase.substr(0, space);
+
+  return phase;
+}
+
+/**
+ * The names phases can be recorded under in a directory: its files, and the capsules they define.
+ */
+set<string> getUnits(const filesystem::path &directory) {
+  set<string> units;
+
+  error_code ec;
+  for (const filesystem::directory_entry &entry : filesystem::directory_iterator(directory, ec)) {
+    if (entry.path().extension() != ".th") continue;
+
+    units.insert(entry.path().filename().string());
+
+    string capsuleName = Theta::CapsuleIndex::findCapsuleNameInFile(entry.path().string());
+    if (capsuleName != "") units.insert(capsuleName);
+  }
+
+  return units;
+}
+
+size_t getSourceBytes(const filesystem::path &directory) {
+  size_t bytes = 0;
+
+  error_code ec;
+  for (const filesystem::directory_entry &entry : filesystem::directory_iterator(directory, ec)) {
+    if (entry.path().extension() == ".th") bytes += entry.file_size(ec);
+  }
+
+  return bytes;
+}
+
+vector<char> readFile(const filesystem::path &file) {
+  ifstream stream(file, ios::binary);
+
+  return vector<char>((istreambuf_iterator<char>(stream)), istreambuf_iterator<char>());
+}
+
+void benchmarkCompile(Theta::CompilerSession &session, const Input &input, const filesystem::path &outFile, int iterations, InputResult &result) {
+  set<string> units = getUnits(input.directory);
+
+  for (int i = 0; i < iterations; i++) {
+    bool isCompiled;
+
+    {
+      SilencedOutput silenced;
+      isCompiled = session.compile(input.file, outFile.string());
+      session.clearExceptions();
+
+      // Linked capsules would otherwise be parsed once, for the first iteration only
+      session.resetLinkedCapsules();
+    }
+
+    result.isCompiled = isCompiled;
+
+    map<string, double> iterationMs;
+    for (Theta::PhaseTimer::Phase &phase : session.getPhaseTimer()->getPhases()) {
+      iterationMs[getStageName(phase.name, units)] += phase.wallMs;
+    }
+
+    for (auto &[stage, ms] : iterationMs) result.stages[stage].ms.push_back(ms);
+  }
+}
+
+void recordRuntime(InputResult &result, const string &stage, chrono::steady_clock::time_point start) {
+  StageSamples &samples = result.stages[stage];
+  samples.ms.push_back(elapsedMs(start));
+  samples.isRuntime = true;
+}
+
+bool hasRunnableFunction(const wasm::Module &module) {
+  wasm::ownvec<wasm::ExportType> exportTypes = module.exports();
+
+  for (size_t i = 0; i < exportTypes.size(); i++) {
+    string exportName(exportTypes[i]->name().get(), exportTypes[i]->name().size());
+    const wasm::FuncType *funcType = exportTypes[i]->type()->func();
+
+    if (exportName == RUNTIME_FUNCTION && funcType && funcType->params().size() == 0) return true;
+  }
+
+  return false;
+}
+
+/**
+ * Compiles and instantiates the module on their own, rather than through Runtime::execute, which only does either the
+ * first time. V8 reuses the machine code of a module that's still alive when given the same binary again, so each
+ * compile drops the module before it, and the runtime only compiles it once they're done.
+ */
+void benchmarkRuntime(const vector<char> &wasmBinary, int iterations, InputResult &result) {
+  Theta::Runtime runtime;
+
+  auto binary = wasm::vec<byte_t>::make_uninitialized(wasmBinary.size());
+  memcpy(binary.get(), wasmBinary.data(), wasmBinary.size());
+
+  wasm::own<wasm::Module> module;
+
+  for (int i = 0; i < iterations; i++) {
+    module = nullptr;
+
+    auto start = chrono::steady_clock::now();
+    module = wasm::Module::make(runtime.getStore(), binary);
+    recordRuntime(result, "Module compile", start);
+
+    if (!module) return;
+  }
+
+  if (!hasRunnableFunction(*module)) return;
+
+  // Modules compiled without host functions import nothing, other than the clock if they time collections
+  wasm::ownvec<wasm::ImportType> importTypes = module->imports();
+  vector<wasm::own<wasm::Func>> importFuncs;
+  vector<const wasm::Extern*> imports;
+
+  for (size_t i = 0; i < importTypes.size(); i++) {
+    string importName(importTypes[i]->name().get(), importTypes[i]->name().size());
+    if (importName != "now") return;
+
+    importFuncs.push_back(wasm::Func::make(runtime.getStore(), importTypes[i]->type()->func(), Theta::GCStats::now));
+    imports.push_back(importFuncs.back().get());
+  }
+
+  for (int i = 0; i < iterations; i++) {
+    auto start = chrono::steady_clock::now();
+    wasm::own<wasm::Instance> instance = wasm::Instance::make(runtime.getStore(), module.get(), imports.data());
+    recordRuntime(result, "Instantiation", start);
+
+    if (!instance) return;
+  }
+
+  module = nullptr;
+
+  // Runs after the first reuse a pooled instance, so they're what a host running a program repeatedly pays
+  runtime.execute(wasmBinary, RUNTIME_FUNCTION);
+
+  for (int i = 0; i < iterations; i++) {
+    auto start = chrono::steady_clock::now();
+    runtime.execute(wasmBinary, RUNTIME_FUNCTION);
+    recordRuntime(result, "Invocation", start);
+  }
+}
+
+double percentile(const vector<double> &sorted, double p) {
+  size_t index = min(sorted.size() - 1, (size_t) (p / 100 * (sorted.size() - 1) + 0.5));
+
+  return sorted[index];
+}
+
+string escapeJSON(const string &value) {
+  string escaped;
+
+  for (char c : value) {
+    if (c == '"' || c == '\\') escaped += '\\';
+    escaped += c;
+  }
+
+  return escaped;
+}
+
+double getMedian(const vector<double> &samples) {
+  vector<double> sorted = samples;
+  sort(sorted.begin(), sorted.end());
+
+  return percentile(sorted, 50);
+}
+
+struct Scaling {
+  string stage;
+  vector<pair<size_t, double>> medians;
+
+  // The exponent of the power law the medians fit best, by least squares over their logs
+  double exponent = 0;
+};
+
+/**
+ * How each stage grows with the size of the generated programs, for the stages every one of them got to.
+ */
+vector<Scaling> getScaling(const vector<InputResult> &results) {
+  vector<const InputResult*> generated;
+  for (const InputResult &result : results) {
+    if (result.isGenerated && result.bytes > 0) generated.push_back(&result);
+  }
+
+  vector<Scaling> scaling;
+  if (generated.size() < 2) return scaling;
+
+  for (auto &[stage, samples] : generated.front()->stages) {
+    Scaling stageScaling{ stage };
+
+    for (const InputResult *result : generated) {
+      auto found = result->stages.find(stage);
+      if (found == result->stages.end()) break;
+
+      double median = getMedian(found->second.ms);
+      if (median <= 0) break;
+
+      stageScaling.medians.push_back(make_pair(result->bytes, median));
+    }
+
+    if (stageScaling.medians.size() != generated.size()) continue;
+
+    double n = stageScaling.medians.size();
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+
+    for (auto &[bytes, median] : stageScaling.medians) {
+      double x = log((double) bytes);
+      double y = log(median);
+
+      sumX += x;
+      sumY += y;
+      sumXX += x * x;
+      sumXY += x * y;
+    }
+
+    double denominator = n * sumXX - sumX * sumX;
+    if (denominator != 0) stageScaling.exponent = (n * sumXY - sumX * sumY) / denominator;
+
+    scaling.push_back(stageScaling);
+  }
+
+  sort(scaling.begin(), scaling.end(), [](const Scaling &a, const Scaling &b) { return a.exponent > b.exponent; });
+
+  return scaling;
+}
+
+string toJSON(const vector<InputResult> &results, const vector<Scaling> &scaling, int iterations) {
+  ostringstream json;
+  json << "{\n  \"iterations\": " << iterations << ",\n  \"inputs\": [";
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const InputResult &result = results[i];
+
+    json << (i > 0 ? "," : "") << "\n    {\n"
+      << "      \"name\": \"" << escapeJSON(result.name) << "\",\n"
+      << "      \"bytes\": " << result.bytes << ",\n"
+      << "      \"compiled\": " << (result.isCompiled ? "true" : "false") << ",\n"
+      << "      \"stages\": [";
+
+    bool isFirstStage = true;
+    for (auto &[name, samples] : result.stages) {
+      vector<double> sorted = samples.ms;
+      sort(sorted.begin(), sorted.end());
+
+      double total = 0;
+      for (double ms : sorted) total += ms;
+
+      double p50 = percentile(sorted, 50);
+
+      // Runtime stages run the whole module each time, whatever its size
+      string throughputUnit = samples.isRuntime ? "runsPerSecond" : "bytesPerSecond";
+      double throughput = p50 > 0 ? (samples.isRuntime ? 1 : result.bytes) * 1000 / p50 : 0;
+
+      json << (isFirstStage ? "" : ",") << "\n        {"
+        << " \"name\": \"" << escapeJSON(name) << "\","
+        << " \"samples\": " << sorted.size() << ","
+        << " \"meanMs\": " << total / sorted.size() << ","
+        << " \"minMs\": " << sorted.front() << ","
+        << " \"p50Ms\": " << p50 << ","
+        << " \"p90Ms\": " << percentile(sorted, 90) << ","
+        << " \"p99Ms\": " << percentile(sorted, 99) << ","
+        << " \"maxMs\": " << sorted.back() << ","
+        << " \"" << throughputUnit << "\": " << throughput
+        << " }";
+
+      isFirstStage = false;
+    }
+
+    json << "\n      ]\n    }";
+  }
+
+  json << "\n  ],\n  \"scaling\": [";
+
+  for (size_t i = 0; i < scaling.size(); i++) {
+    json << (i > 0 ? "," : "") << "\n    {"
+      << " \"name\": \"" << escapeJSON(scaling[i].stage) << "\","
+      << " \"exponent\": " << scaling[i].exponent << ","
+      << " \"p50Ms\": [";
+
+    for (size_t j = 0; j < scaling[i].medians.size(); j++) {
+      json << (j > 0 ? ", " : "") << "{ \"bytes\": " << scaling[i].medians[j].first << ", \"ms\": " << scaling[i].medians[j].second << " }";
+    }
+
+    json << "] }";
+  }
+
+  json << "\n  ]\n}\n";
+
+  return json.str();
+}
+
+void printScaling(const vector<Scaling> &scaling) {
+  if (scaling.empty()) return;
+
+  cerr << endl << "How each phase grows with the size of the generated programs, as the exponent of its power law:" << endl;
+
+  for (const Scaling &stageScaling : scaling) {
+    char exponent[16];
+    snprintf(exponent, sizeof(exponent), "%6.2f", stageScaling.exponent);
+
+    cerr << "  " << exponent << "  " << stageScaling.stage << endl;
+  }
+}
+
+vector<int> parseScales(const string &scales) {
+  vector<int> parsed;
+  stringstream stream(scales);
+  string scale;
+
+  while (getline(stream, scale, ',')) {
+    if (!scale.empty()) parsed.push_back(stoi(scale));
+  }
+
+  return parsed;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 20;
+  filesystem::path fixturesDir = "test/fixtures";
+  vector<int> scales = { 10, 100, 1000 };
+  string outputFile;
+
+  ProgramShape shape;
+  shape.expressionNesting = 3;
+  shape.closureEvery = 5;
+  shape.overloadEvery = 7;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg == "--iterations" && i + 1 < argc) iterations = stoi(argv[++i]);
+    else if (arg == "--fixtures" && i + 1 < argc) fixturesDir = argv[++i];
+    else if (arg == "--scales" && i + 1 < argc) scales = parseScales(argv[++i]);
+    else if (arg == "--output" && i + 1 < argc) outputFile = argv[++i];
+    else if (arg == "--capsules" && i + 1 < argc) shape.capsules = stoi(argv[++i]);
+    else if (arg == "--link-depth" && i + 1 < argc) shape.linkDepth = stoi(argv[++i]);
+    else if (arg == "--nesting" && i + 1 < argc) shape.expressionNesting = stoi(argv[++i]);
+    else if (arg == "--closure-every" && i + 1 < argc) shape.closureEvery = stoi(argv[++i]);
+    else if (arg == "--overload-every" && i + 1 < argc) shape.overloadEvery = stoi(argv[++i]);
+  }
+
+  if (iterations < 1 || shape.capsules < 1 || shape.linkDepth < 0) {
+    cerr << "--iterations and --capsules have to be at least 1, and --link-depth at least 0" << endl;
+    return 1;
+  }
+
+  if (!outputFile.empty()) outputFile = filesystem::absolute(outputFile).string();
+
+  filesystem::path workDir = filesystem::temp_directory_path() / "theta-bench";
+  filesystem::remove_all(workDir);
+
+  // The fixtures are copied, so that indexing their capsules doesn't write to the source tree
+  vector<Input> inputs;
+  filesystem::path fixturesCopy = workDir / "fixtures";
+
+  error_code ec;
+  filesystem::create_directories(fixturesCopy);
+  filesystem::copy(fixturesDir, fixturesCopy, filesystem::copy_options::recursive, ec);
+
+  if (ec) cerr << "Could not read the fixtures in " << fixturesDir << ", only benchmarking generated programs" << endl;
+
+  for (const filesystem::directory_entry &entry : filesystem::directory_iterator(fixturesCopy, ec)) {
+    if (entry.path().extension() != ".th") continue;
+
+    inputs.push_back({ entry.path().filename().string(), fixturesCopy, entry.path().filename().string(), false });
+  }
+
+  sort(inputs.begin(), inputs.end(), [](const Input &a, const Input &b) { return a.name < b.name; });
+
+  // Each program gets a directory of its own, since they all name their capsules the same
+  for (int scale : scales) {
+    if (scale < 1) continue;
+
+    ProgramShape scaledShape = shape;
+    scaledShape.functionsPerCapsule = max(1, scale / shape.capsules);
+
+    filesystem::path directory = workDir / ("generated" + to_string(scale));
+    filesystem::path entry = ProgramGenerator(scaledShape).writeTo(directory);
+
+    if (entry.empty()) {
+      cerr << "Could not write the generated program to " << directory << endl;
+      return 1;
+    }
+
+    inputs.push_back({ "generated/" + to_string(scale), directory, entry.filename().string(), true });
+  }
+
+  vector<InputResult> results;
+
+  for (const Input &input : inputs) {
+    cerr << "Benchmarking " << input.name << endl;
+
+    filesystem::current_path(input.directory);
+
+    // A session per input, since the capsules a session links are looked up once, in the directory it starts in
+    Theta::CompilerSession session;
+    session.setIsASTCacheEnabled(false);
+    session.setIsWasmCacheEnabled(false);
+    session.setIsTimingPhases(true);
+
+    InputResult result;
+    result.name = input.name;
+    result.isGenerated = input.isGenerated;
+    result.bytes = input.isGenerated ? getSourceBytes(input.directory) : filesystem::file_size(input.directory / input.file, ec);
+
+    filesystem::path outFile = input.directory / (filesystem::path(input.file).stem().string() + ".wasm");
+    benchmarkCompile(session, input, outFile, iterations, result);
+
+    try {
+      if (result.isCompiled) benchmarkRuntime(readFile(outFile), iterations, result);
+    } catch (const exception &e) {
+      cerr << "  " << e.what() << endl;
+    }
+
+    results.push_back(result);
+  }
+
+  vector<Scaling> scaling = getScaling(results);
+  printScaling(scaling);
+
+  string json = toJSON(results, scaling, iterations);
+
+  if (outputFile == "") {
+    cout << json;
+    return 0;
+  }
+
+  ofstream output(outputFile);
+  output << json;
+
+  if (!output.good()) {
+    cerr << "Failed to write the results to " << outputFile << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,60 @@
+# Writes a C++ header naming the build of the compiler, so that what the compiler caches can tell builds apart even
+# when the version number hasn't changed. It's the commit the tree is at, along with a hash of any uncommitted changes,
+# or a hash of the sources when the tree isn't a git checkout. Run as a script on every build:
+#
+#   cmake -DSOURCE_DIR=<repository> -DOUTPUT=<header.hpp> -P build_id.cmake
+
+find_package(Git QUIET)
+
+set(BUILD_ID "")
+
+if (GIT_FOUND)
+  execute_process(
+    COMMAND ${GIT_EXECUTABLE} rev-parse HEAD
+    WORKING_DIRECTORY ${SOURCE_DIR}
+    OUTPUT_VARIABLE COMMIT
+    OUTPUT_STRIP_TRAILING_WHITESPACE
+    RESULT_VARIABLE GIT_RESULT
+    ERROR_QUIET
+  )
+
+  if (GIT_RESULT EQUAL 0)
+    set(BUILD_ID "${COMMIT}")
+
+    execute_process(
+      COMMAND ${GIT_EXECUTABLE} diff HEAD -- src
+      WORKING_DIRECTORY ${SOURCE_DIR}
+      OUTPUT_VARIABLE CHANGES
+      ERROR_QUIET
+    )
+
+    if (NOT "${CHANGES}" STREQUAL "")
+      string(SHA1 CHANGES_HASH "${CHANGES}")
+      set(BUILD_ID "${BUILD_ID}-dirty-${CHANGES_HASH}")
+    endif()
+  endif()
+endif()
+
+if ("${BUILD_ID}" STREQUAL "")
+  file(GLOB_RECURSE SOURCES ${SOURCE_DIR}/src/*.cpp ${SOURCE_DIR}/src/*.hpp ${SOURCE_DIR}/src/*.wat)
+  list(SORT SOURCES)
+
+  set(SOURCES_HASH "")
+  foreach(SOURCE ${SOURCES})
+    file(SHA1 ${SOURCE} SOURCE_HASH)
+    string(SHA1 SOURCES_HASH "${SOURCES_HASH}${SOURCE_HASH}")
+  endforeach()
+
+  set(BUILD_ID "sources-${SOURCES_HASH}")
+endif()
+
+file(WRITE ${OUTPUT}.tmp
+"#pragma once
+
+// Generated at build time by scripts/build_id.cmake. Do not edit
+#define THETA_BUILD_ID \"${BUILD_ID}\"
+")
+
+# Only touching the header when the build id actually changed keeps everything that includes it from rebuilding
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
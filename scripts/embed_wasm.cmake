@@ -0,0 +1,37 @@
+# Turns a wasm binary into a C++ header that embeds it as a constexpr byte array, so the compiler doesn't need to find
+# and parse anything at runtime. Run as a script:
+#
+#   cmake -DINPUT=<module.wasm> -DOUTPUT=<header.hpp> -DSYMBOL=<NAME> -P embed_wasm.cmake
+
+file(READ ${INPUT} WASM_HEX HEX)
+string(LENGTH "${WASM_HEX}" WASM_HEX_LENGTH)
+math(EXPR WASM_SIZE "${WASM_HEX_LENGTH} / 2")
+
+# Every pair of hex digits becomes one byte, 16 to a line
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " WASM_BYTES "${WASM_HEX}")
+
+# CMake's regexes have no {n}, so the pattern for a line is spelled out
+set(WASM_LINE_PATTERN "")
+foreach(i RANGE 1 16)
+  set(WASM_LINE_PATTERN "${WASM_LINE_PATTERN}0x[0-9a-f][0-9a-f], ")
+endforeach()
+string(REGEX REPLACE "(${WASM_LINE_PATTERN})" "\\1\n    " WASM_BYTES "${WASM_BYTES}")
+
+file(WRITE ${OUTPUT}.tmp
+"#pragma once
+
+#include <cstddef>
+
+// Generated at build time by scripts/embed_wasm.cmake. Do not edit
+namespace Theta {
+  constexpr unsigned char ${SYMBOL}[] = {
+    ${WASM_BYTES}
+  };
+
+  constexpr size_t ${SYMBOL}_SIZE = ${WASM_SIZE};
+}
+")
+
+# Only touching the header when the module actually changed keeps everything that includes it from rebuilding
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
@@ -1,9 +1,19 @@
 #include "CLI.hpp"
 #include <iostream>
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
 #include "../../version.h"
-#include "../compiler/Compiler.hpp"
+#include "../compiler/CompilerSession.hpp"
+#include "../runtime/NativeCodeCache.hpp"
+#include "../runtime/Runtime.hpp"
 #include "REPL.hpp"
+#include "CompileServer.hpp"
 
 using namespace Theta;
 using namespace std;
@@ -12,21 +22,45 @@ void CLI::parseCommand(int argc, char* argv[]) {
   bool isEmitTokens = false;
   bool isEmitAST = false;
   bool isEmitWAT = false;
+  bool isUseASTCache = true;
+  bool isUseWasmCache = true;
+  bool isCacheNative = false;
+  bool isSourceMap = false;
+  int maxThreads = 0;
+  bool isServe = false;
+  bool isTimePasses = false;
+  bool isStats = false;
+  bool isProfiling = false;
+  bool isSplittingCapsules = false;
+  OptimizationLevel optimizationLevel;
+  HeapOptions heapOptions;
+  ExecutionLimits executionLimits;
+  RuntimeOptions runtimeOptions;
+  vector<string> exports;
+  string timePassesJSONFile;
+  string statsJSONFile;
+  string socketPath = CompileServer::DEFAULT_SOCKET_PATH.string();
   string sourceFile;
   string outFile;
 
+  // theta build compiles every source file it's given, and those a manifest lists, in one process
+  bool isBuild = argc > 1 && string(argv[1]) == "build";
+  vector<string> buildFiles;
+  string manifestFile;
+
   if (argc == 1) {
     REPL repl = REPL();
     repl.readInput();
-  } else if (argc == 2) {
+  } else if (argc == 2 && !isBuild) {
     string arg1 = argv[1];
 
     if (arg1 == "--version") return printLanguageVersion();
     if (arg1 == "--help") return printUsageInstructions();
 
-    sourceFile = argv[1];
+    if (arg1 == "--serve") isServe = true;
+    else sourceFile = argv[1];
   } else {
-    int i = 1;
+    int i = isBuild ? 2 : 1;
 
     while (i < argc) {
       string arg = argv[i];
@@ -35,9 +69,130 @@ void CLI::parseCommand(int argc, char* argv[]) {
         outFile = argv[i + 1];
         i++;
       }
+      else if (arg == "-j" && i + 1 < argc) {
+        maxThreads = atoi(argv[i + 1]);
+        i++;
+
+        if (maxThreads <= 0) {
+          cout << "Invalid number of threads: " << argv[i] << endl;
+          return;
+        }
+      }
       else if (arg == "--emitTokens") isEmitTokens = true;
       else if (arg == "--emitAST") isEmitAST = true;
       else if (arg == "--emitWAT") isEmitWAT = true;
+      else if (arg == "--noASTCache") isUseASTCache = false;
+      else if (arg == "--noWasmCache") isUseWasmCache = false;
+      else if (arg == "--cache-native") isCacheNative = true;
+      else if (arg == "--sourceMap") isSourceMap = true;
+      else if (arg.compare(0, 2, "-O") == 0 && i != argc - 1) {
+        optional<OptimizationLevel> level = OptimizationLevel::fromFlag(arg);
+        if (!level) {
+          cout << "Invalid optimization level: " << arg << endl;
+          return;
+        }
+
+        level->passes = optimizationLevel.passes;
+        optimizationLevel = *level;
+      }
+      else if (arg == "--passes" && i + 1 < argc) {
+        optimizationLevel.passes = OptimizationLevel::parsePassList(argv[i + 1]);
+        i++;
+      }
+      else if (arg == "--exports" && i + 1 < argc) {
+        exports = OptimizationLevel::parsePassList(argv[i + 1]);
+        i++;
+      }
+      else if ((arg == "--heap-pages" || arg == "--max-heap-pages") && i + 1 < argc) {
+        optional<int> pages = HeapOptions::parsePages(argv[i + 1]);
+        i++;
+
+        if (!pages) {
+          cout << "Invalid number of heap pages: " << argv[i] << endl;
+          return;
+        }
+
+        if (arg == "--heap-pages") heapOptions.initialPages = *pages;
+        else heapOptions.maximumPages = *pages;
+      }
+      else if (arg == "--gc-threshold" && i + 1 < argc) {
+        optional<int> threshold = HeapOptions::parseThreshold(argv[i + 1]);
+        i++;
+
+        if (!threshold) {
+          cout << "Invalid collection threshold: " << argv[i] << endl;
+          return;
+        }
+
+        heapOptions.collectionThreshold = *threshold;
+      }
+      else if (arg == "--time-gc") heapOptions.isTimingCollections = true;
+      else if ((arg == "--fuel" || arg == "--deadline") && i + 1 < argc) {
+        char *end;
+        unsigned long long limit = strtoull(argv[i + 1], &end, 10);
+        i++;
+
+        if (!isdigit(static_cast<unsigned char>(argv[i][0])) || *end != '\0' || limit == 0) {
+          cout << "Invalid " << arg.substr(2) << ": " << argv[i] << endl;
+          return;
+        }
+
+        if (arg == "--fuel") executionLimits.fuel = limit;
+        else executionLimits.deadline = chrono::milliseconds(limit);
+      }
+      else if (arg == "--wasm-tier" && i + 1 < argc) {
+        optional<RuntimeOptions::CompilationStrategy> strategy = RuntimeOptions::parseCompilationStrategy(argv[i + 1]);
+        i++;
+
+        if (!strategy) {
+          cout << "Invalid compilation strategy: " << argv[i] << endl;
+          return;
+        }
+
+        runtimeOptions.compilationStrategy = *strategy;
+      }
+      else if (arg == "--wasm-code-space" && i + 1 < argc) {
+        optional<int> megabytes = RuntimeOptions::parseCodeSpaceMegabytes(argv[i + 1]);
+        i++;
+
+        if (!megabytes) {
+          cout << "Invalid code space size: " << argv[i] << endl;
+          return;
+        }
+
+        runtimeOptions.codeSpaceMegabytes = *megabytes;
+      }
+      else if (arg == "--no-wasm-tail-call") runtimeOptions.isTailCallEnabled = false;
+      else if (arg == "--no-wasm-simd") runtimeOptions.isSimdEnabled = false;
+      else if (arg == "--no-wasm-multi-value") runtimeOptions.isMultiValueEnabled = false;
+      else if (arg == "--time-passes") isTimePasses = true;
+      else if (arg == "--profile") isProfiling = true;
+      else if (arg == "--split-capsules") isSplittingCapsules = true;
+      else if (arg == "--time-passes-json" && i + 1 < argc) {
+        isTimePasses = true;
+        timePassesJSONFile = argv[i + 1];
+        i++;
+      }
+      else if (arg == "--manifest" && i + 1 < argc) {
+        manifestFile = argv[i + 1];
+        i++;
+      }
+      else if (arg == "--stats") isStats = true;
+      else if (arg == "--stats-json" && i + 1 < argc) {
+        isStats = true;
+        statsJSONFile = argv[i + 1];
+        i++;
+      }
+      else if (arg == "--serve") {
+        isServe = true;
+
+        // The socket path is optional
+        if (i + 1 < argc && argv[i + 1][0] != '-') {
+          socketPath = argv[i + 1];
+          i++;
+        }
+      }
+      else if (isBuild && arg[0] != '-') buildFiles.push_back(arg);
       else if (i == argc - 1) sourceFile = arg;
       else validateOption(arg);
 
@@ -45,20 +200,163 @@ void CLI::parseCommand(int argc, char* argv[]) {
     }
   }
 
-  if (sourceFile == "") return;
+  vector<pair<string, string>> entrypoints;
+
+  if (isBuild) {
+    // With -o, build writes every module into that directory rather than next to its source file
+    for (const string &file : buildFiles) {
+      string output = getDefaultOutputFile(file);
+      if (outFile != "") output = (filesystem::path(outFile) / filesystem::path(output).filename()).string();
+
+      entrypoints.push_back(make_pair(file, output));
+    }
+
+    if (manifestFile != "" && !readManifest(manifestFile, outFile, entrypoints)) return;
+
+    if (entrypoints.empty()) {
+      cout << "Nothing to build: pass build the source files to compile, or a --manifest listing them" << endl;
+      return;
+    }
+
+    if (outFile != "") {
+      error_code ec;
+      filesystem::create_directories(outFile, ec);
+    }
+  } else if (sourceFile == "" && !isServe) return;
+
+  if (!heapOptions.isValid()) {
+    cout << "Invalid heap: --heap-pages can't be more than --max-heap-pages" << endl;
+    return;
+  }
+
+  // Has to come before anything makes a runtime, see Runtime::setEngineOptions
+  Runtime::setEngineOptions(runtimeOptions);
+
+  CompilerSession session;
+  session.setIsASTCacheEnabled(isUseASTCache);
+  session.setIsWasmCacheEnabled(isUseWasmCache);
+  session.setIsNativeCacheEnabled(isCacheNative);
+  session.setIsSourceMapEnabled(isSourceMap);
+  if (maxThreads > 0) session.setMaxThreads(maxThreads);
+  session.setIsTimingPhases(isTimePasses);
+  session.setIsCollectingStats(isStats);
+  session.setOptimizationLevel(optimizationLevel);
+  session.setExports(exports);
+  session.setHeapOptions(heapOptions);
+  session.setExecutionLimits(executionLimits);
+  session.setIsProfiling(isProfiling);
+  session.setIsSplittingCapsules(isSplittingCapsules);
+
+  // Sessions that run what they compile make the engine while compiling
+  if (isServe || isProfiling || isCacheNative) session.warmUp();
+
+  if (isServe) {
+    CompileServer server(session, socketPath);
+    if (server.listen()) server.serve();
+
+    return;
+  }
+
+  if (isBuild) {
+    session.compileBatch(entrypoints, isEmitTokens, isEmitAST, isEmitWAT);
+
+    if (isTimePasses) printPhaseTimings(*session.getPhaseTimer(), timePassesJSONFile);
+    if (isStats) printCompileStats(*session.getCompileStats(), statsJSONFile);
+
+    return;
+  }
+
+  if (outFile == "") outFile = getDefaultOutputFile(sourceFile);
+
+  bool isCompiled = session.compile(sourceFile, outFile, isEmitTokens, isEmitAST, isEmitWAT);
+
+  if (isTimePasses) printPhaseTimings(*session.getPhaseTimer(), timePassesJSONFile);
+  if (isStats) printCompileStats(*session.getCompileStats(), statsJSONFile);
+  if (isProfiling && isCompiled) profileRun(session, outFile);
+}
+
+void CLI::profileRun(CompilerSession &session, string wasmFile) {
+  ifstream wasmStream(wasmFile, ios::binary);
+  vector<char> wasm((istreambuf_iterator<char>(wasmStream)), istreambuf_iterator<char>());
+
+  try {
+    ExecutionContext context = session.execute(wasm, "main0");
+    cout << context.stringifiedResult() << endl;
+  } catch (const exception &e) {
+    cout << e.what() << endl;
+  }
+
+  Profiler &profiler = session.getProfiler();
+  cout << endl << profiler.toTable(PROFILE_TABLE_SIZE);
+
+  string stacksFile = wasmFile + ".folded";
+  ofstream stacks(stacksFile);
+  stacks << profiler.toCollapsedStacks();
+
+  if (!stacks.good()) cout << "Failed to write the profile to " + stacksFile << endl;
+  else cout << endl << "Wrote the time spent in each stack of calls to " << stacksFile << ", for flamegraph.pl" << endl;
+}
+
+void CLI::printPhaseTimings(PhaseTimer &timer, string jsonFile) {
+  cout << endl << timer.toTable();
+
+  if (jsonFile == "") return;
+
+  ofstream json(jsonFile);
+  json << timer.toJSON() << endl;
+
+  if (!json.good()) cout << "Failed to write phase timings to " + jsonFile << endl;
+}
+
+void CLI::printCompileStats(CompileStats &stats, string jsonFile) {
+  cout << endl << stats.toTable();
+
+  if (jsonFile == "") return;
+
+  ofstream json(jsonFile);
+  json << stats.toJSON() << endl;
+
+  if (!json.good()) cout << "Failed to write compile stats to " + jsonFile << endl;
+}
+
+bool CLI::readManifest(string manifestFile, string outputDirectory, vector<pair<string, string>> &entrypoints) {
+  ifstream manifest(manifestFile);
+
+  if (!manifest) {
+    cout << "Could not read the manifest " + manifestFile << endl;
+    return false;
+  }
+
+  string line;
+  while (getline(manifest, line)) {
+    istringstream fields(line);
+    string file;
+    string output;
 
-  if (outFile == "") {
-    bool reachedDelimiter = false;
-    for (int i = 0; !reachedDelimiter; i++) {
-      outFile += sourceFile[i];
+    if (!(fields >> file) || file[0] == '#') continue;
 
-      if (sourceFile[i + 1] == '.') reachedDelimiter = true;
+    if (!(fields >> output)) {
+      output = getDefaultOutputFile(file);
+      if (outputDirectory != "") output = (filesystem::path(outputDirectory) / filesystem::path(output).filename()).string();
     }
 
-    outFile += ".wasm";
+    entrypoints.push_back(make_pair(file, output));
+  }
+
+  return true;
+}
+
+string CLI::getDefaultOutputFile(string sourceFile) {
+  string outFile;
+
+  bool reachedDelimiter = false;
+  for (int i = 0; !reachedDelimiter && i < sourceFile.length(); i++) {
+    outFile += sourceFile[i];
+
+    if (sourceFile[i + 1] == '.') reachedDelimiter = true;
   }
 
-  Theta::Compiler::getInstance().compile(sourceFile, outFile, isEmitTokens, isEmitAST, isEmitWAT);
+  return outFile + ".wasm";
 }
 
 string CLI::makeLink(string url, string text) {
@@ -75,12 +373,49 @@ void CLI::printUsageInstructions() {
   cout << endl;
   cout << "Usage:" << endl;
   cout << "  theta [options] <source_file>" << endl;
+  cout << "  theta build [options] <source_file>... [--manifest <file>]" << endl;
+  cout << "                                 Compile many programs in one process, sharing the capsules they link." << endl;
   cout << endl;
   cout << "Options:" << endl;
   cout << "  -o <output_file>               Specify the output file name." << endl;
+  cout << "  -O0, -O1, -O2, -O3, -O4        Optimize the generated module with Binaryen at this level. Defaults to -O0." << endl;
+  cout << "  -Os, -Oz                       Optimize for size, or aggressively for size. -O on its own is the same as -Os." << endl;
+  cout << "  --passes <pass,...>            Run these Binaryen passes on the generated module, after the -O level's." << endl;
+  cout << "  --exports <function,...>       Only export these capsule functions, leaving out any that none of them use." << endl;
+  cout << "  --heap-pages <pages>           Start the heap at this many 64k pages, the first of which is the shadow stack. Defaults to 9." << endl;
+  cout << "  --max-heap-pages <pages>       Never grow the heap past this many 64k pages. Defaults to 1024." << endl;
+  cout << "  --gc-threshold <percent>       Collect once this much of the space left after the last collection is used. Defaults to 50." << endl;
+  cout << "  --time-gc                      Time collection pauses when running, using a clock imported from the host." << endl;
+  cout << "  --fuel <units>                 Meter fuel, stopping runs once they spend this many units. Each call and loop turn is one." << endl;
+  cout << "  --deadline <ms>                Meter fuel, stopping runs that are still going after this many milliseconds." << endl;
+  cout << "  --wasm-tier <strategy>         How V8 compiles modules it runs: dynamic, liftoff, turbofan or lazy. Defaults to dynamic." << endl;
+  cout << "  --wasm-code-space <mb>         Keep at most this much machine code for the modules V8 runs." << endl;
+  cout << "  --no-wasm-tail-call, --no-wasm-simd, --no-wasm-multi-value" << endl;
+  cout << "                                 Turn a wasm feature off in V8. Modules Theta generates need tail calls and multiple values." << endl;
+  cout << "  -j <threads>                   Parse and check linked capsules on this many threads. Defaults to one per core." << endl;
   cout << "  --emitTokens                   Emit the tokenized representation of the source file produced by the lexer." << endl;
   cout << "  --emitAST                      Emit the Abstract Syntax Tree (AST) representation produced by the parser." << endl;
   cout << "  --emitWAT                      Emit the WebAssembly Text format (WAT) representation produced." << endl;
+  cout << "  --noASTCache                   Lex and parse every source file, instead of loading unchanged ones from the AST cache." << endl;
+  cout << "  --noWasmCache                  Compile the program again even if it is unchanged since it was last compiled." << endl;
+  cout << "  --cache-native                 Compile the module with V8 too, keeping its machine code in " << NativeCodeCache::DEFAULT_CACHE_DIR.string() << "." << endl;
+  cout << "                                 Runs of the module in any process load the code instead of compiling it." << endl;
+  cout << "  --sourceMap                    Write a source map next to the output file, mapping the module back to the source." << endl;
+  cout << "  --profile                      Compile with profiling, run main, and print the functions that took the most time." << endl;
+  cout << "                                 Also writes <output_file>.folded, for flamegraph.pl." << endl;
+  cout << "  --split-capsules               Also write a module for each linked capsule, as <capsule>.wasm next to the output file," << endl;
+  cout << "                                 so that runtimes can load capsules the first time they're called." << endl;
+  cout << "  --time-passes                  Report the wall and CPU time taken by each phase of the compile." << endl;
+  cout << "                                 Optimization passes also report how many changes they made." << endl;
+  cout << "  --time-passes-json <file>      Like --time-passes, and also write the timings to a file as JSON." << endl;
+  cout << "  --manifest <file>              With build, also compile the source files listed in a file, one per line, each" << endl;
+  cout << "                                 optionally followed by its output file. Lines starting with # are skipped." << endl;
+  cout << "                                 With build, -o names the directory the modules are written to." << endl;
+  cout << "  --stats                        Report the memory each phase of the compile used: tokens, AST nodes by type," << endl;
+  cout << "                                 symbols, module and output sizes, linear memory, and peak RSS. Skips the caches." << endl;
+  cout << "  --stats-json <file>            Like --stats, and also write the stats to a file as JSON." << endl;
+  cout << "  --serve [socket_path]          Run a compile server, taking compile and run requests over a Unix socket." << endl;
+  cout << "                                 Listens on " << CompileServer::DEFAULT_SOCKET_PATH.string() << " by default." << endl;
   cout << "  --help                         Display this help message and exit." << endl;
   cout << "  --version                      Display the currently installed Theta language version and exit." << endl;
 }
@@ -92,6 +427,32 @@ bool CLI::validateOption(string option) {
     "--emitTokens",
     "--emitAST",
     "--emitWAT",
+    "--noASTCache",
+    "--noWasmCache",
+    "--cache-native",
+    "--sourceMap",
+    "--time-passes",
+    "--profile",
+    "--split-capsules",
+    "--time-passes-json",
+    "--stats",
+    "--stats-json",
+    "--manifest",
+    "--serve",
+    "--passes",
+    "--exports",
+    "--heap-pages",
+    "--max-heap-pages",
+    "--gc-threshold",
+    "--time-gc",
+    "--fuel",
+    "--deadline",
+    "--wasm-tier",
+    "--wasm-code-space",
+    "--no-wasm-tail-call",
+    "--no-wasm-simd",
+    "--no-wasm-multi-value",
+    "-j",
     "-o"
   };
 
@@ -1,10 +1,16 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
+#include "compiler/PhaseTimer.hpp"
+#include "compiler/CompileStats.hpp"
 
 using namespace std;
 
 namespace Theta {
+  class CompilerSession;
+
   class CLI {
   public:
     static void parseCommand(int argc, char* argv[]);
@@ -13,9 +19,42 @@ namespace Theta {
 
     static void printLanguageVersion();
 
+    /**
+     * @brief The file a source file compiles to when no output file is given: the source file's name, with a .wasm
+     * extension instead of its own.
+     */
+    static string getDefaultOutputFile(string sourceFile);
+
   private:
     static void printUsageInstructions();
 
     static bool validateOption(string option);
+
+    /**
+     * @brief Reads the entrypoints a build manifest lists into entrypoints, with the files their modules are written to.
+     * @param outputDirectory Where modules whose output file isn't listed are written, or an empty string for next to
+     * their source file.
+     * @return false If the manifest couldn't be read
+     */
+    static bool readManifest(string manifestFile, string outputDirectory, vector<pair<string, string>> &entrypoints);
+
+    /**
+     * @brief Prints the phase timings of a compile as a table, and writes them to a file as JSON if one is given.
+     */
+    static void printPhaseTimings(PhaseTimer &timer, string jsonFile);
+
+    /**
+     * @brief Prints the memory stats of a compile as a table, and writes them to a file as JSON if one is given.
+     */
+    static void printCompileStats(CompileStats &stats, string jsonFile);
+
+    /**
+     * @brief Runs a compiled program's main function, then prints the functions that took the most time in it and
+     * writes the time spent in each stack of calls next to the module, for flamegraph.pl.
+     */
+    static void profileRun(CompilerSession &session, string wasmFile);
+
+    // How many functions the profile table lists
+    static const size_t PROFILE_TABLE_SIZE = 20;
   };
 }
@@ -0,0 +1,328 @@
+#include "CompileServer.hpp"
+#include "CLI.hpp"
+#include "runtime/Runtime.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#ifdef THETA_COMPILE_SERVER_SOCKETS
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  /**
+   * Sends everything written to cout to a string for as long as it is alive, so that what the compiler prints while
+   * handling a request can be sent back to the client
+   */
+  class OutputCapture {
+  public:
+    ostringstream output;
+
+    OutputCapture() : previous(cout.rdbuf(output.rdbuf())) {}
+
+    ~OutputCapture() { cout.rdbuf(previous); }
+
+  private:
+    streambuf *previous;
+  };
+
+  bool readFully(int fd, char *buffer, size_t length) {
+    while (length > 0) {
+      ssize_t received = read(fd, buffer, length);
+      if (received < 0 && errno == EINTR) continue;
+      if (received <= 0) return false;
+
+      buffer += received;
+      length -= received;
+    }
+
+    return true;
+  }
+
+  bool writeFully(int fd, const char *buffer, size_t length) {
+    while (length > 0) {
+      ssize_t sent = write(fd, buffer, length);
+      if (sent < 0 && errno == EINTR) continue;
+      if (sent <= 0) return false;
+
+      buffer += sent;
+      length -= sent;
+    }
+
+    return true;
+  }
+
+  uint32_t readLength(const char *header) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(header);
+
+    return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 8 | bytes[3];
+  }
+
+  string response(bool isOk, string_view body) {
+    return string(isOk ? "ok" : "error") + "\n" + string(body);
+  }
+}
+
+CompileServer::~CompileServer() {
+  for (auto &[fd, connection] : connections) close(fd);
+
+  if (listenFd < 0) return;
+
+  close(listenFd);
+
+  error_code ec;
+  filesystem::remove(socketPath, ec);
+}
+
+bool CompileServer::listen() {
+#ifndef THETA_COMPILE_SERVER_SOCKETS
+  cerr << "The compile server isn't supported on this platform, since it has no Unix sockets" << endl;
+  return false;
+#else
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+
+  string path = socketPath.string();
+  if (path.length() >= sizeof(address.sun_path)) {
+    cerr << "Socket path is too long: " << path << endl;
+    return false;
+  }
+
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  error_code ec;
+  if (socketPath.has_parent_path()) filesystem::create_directories(socketPath.parent_path(), ec);
+
+  // A socket file that nothing is listening on was left behind by a server that didn't get to clean up after itself
+  filesystem::remove(socketPath, ec);
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    cerr << "Could not create socket: " << strerror(errno) << endl;
+    return false;
+  }
+
+  if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+    cerr << "Could not listen on " << path << ": " << strerror(errno) << endl;
+
+    close(listenFd);
+    listenFd = -1;
+
+    return false;
+  }
+
+  return true;
+#endif
+}
+
+void CompileServer::serve() {
+#ifdef THETA_COMPILE_SERVER_SOCKETS
+  // Clients that hang up before reading their response shouldn't take the server down with them
+  signal(SIGPIPE, SIG_IGN);
+
+  // Starting the engine spins up V8, which is a big part of what the server is there to avoid paying for every time
+  Runtime::getEngine();
+
+  cout << "Theta compile server listening on " << socketPath.string() << endl;
+
+  while (!isShuttingDown) {
+    vector<pollfd> polled = { { listenFd, POLLIN, 0 } };
+    for (auto &[fd, connection] : connections) polled.push_back({ fd, POLLIN, 0 });
+
+    if (poll(polled.data(), polled.size(), getPollTimeout()) < 0) {
+      if (errno == EINTR) continue;
+
+      cerr << "Could not wait for connections: " << strerror(errno) << endl;
+      break;
+    }
+
+    for (size_t i = 1; i < polled.size() && !isShuttingDown; i++) {
+      if (!polled[i].revents) continue;
+
+      int fd = polled[i].fd;
+      if (receive(fd, connections[fd])) continue;
+
+      close(fd);
+      connections.erase(fd);
+    }
+
+    if (!isShuttingDown && (polled[0].revents & POLLIN)) acceptConnection();
+
+    closeIdleConnections();
+  }
+
+  for (auto &[fd, connection] : connections) close(fd);
+  connections.clear();
+#endif
+}
+
+void CompileServer::handleConnection(int fd) {
+  Connection connection;
+
+  while (!isShuttingDown && receive(fd, connection));
+}
+
+void CompileServer::acceptConnection() {
+#ifdef THETA_COMPILE_SERVER_SOCKETS
+  int fd = accept(listenFd, nullptr, nullptr);
+  if (fd < 0) {
+    if (errno != EINTR) cerr << "Could not accept connection: " << strerror(errno) << endl;
+    return;
+  }
+
+  // Responses are written whole, so a client that stops reading them would otherwise keep everyone else waiting
+  timeval writeTimeout = { (time_t) WRITE_TIMEOUT.count(), 0 };
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &writeTimeout, sizeof(writeTimeout));
+
+  connections[fd] = { "", chrono::steady_clock::now() };
+#endif
+}
+
+bool CompileServer::receive(int fd, Connection &connection) {
+  char chunk[64 * 1024];
+
+  ssize_t received = read(fd, chunk, sizeof(chunk));
+  if (received < 0 && errno == EINTR) return true;
+  if (received <= 0) return false;
+
+  connection.received.append(chunk, received);
+  connection.lastActive = chrono::steady_clock::now();
+
+  // A frame can arrive in any number of pieces, and a piece can hold any number of frames
+  size_t offset = 0;
+  while (!isShuttingDown && connection.received.length() - offset >= 4) {
+    uint32_t length = readLength(connection.received.data() + offset);
+    if (length > MAX_FRAME_SIZE) return false;
+    if (connection.received.length() - offset - 4 < length) break;
+
+    string reply = handleRequest(string_view(connection.received).substr(offset + 4, length));
+    offset += 4 + length;
+
+    if (!writeFrame(fd, reply)) return false;
+  }
+
+  connection.received.erase(0, offset);
+
+  return true;
+}
+
+void CompileServer::closeIdleConnections() {
+  chrono::steady_clock::time_point idleSince = chrono::steady_clock::now() - IDLE_TIMEOUT;
+
+  for (auto it = connections.begin(); it != connections.end();) {
+    if (it->second.lastActive > idleSince) {
+      it++;
+      continue;
+    }
+
+    close(it->first);
+    it = connections.erase(it);
+  }
+}
+
+int CompileServer::getPollTimeout() {
+  if (connections.empty()) return -1;
+
+  chrono::steady_clock::time_point earliest = chrono::steady_clock::time_point::max();
+  for (auto &[fd, connection] : connections) earliest = min(earliest, connection.lastActive);
+
+  auto remaining = chrono::duration_cast<chrono::milliseconds>(earliest + IDLE_TIMEOUT - chrono::steady_clock::now());
+
+  return max((int) remaining.count(), 0) + 1;
+}
+
+string CompileServer::handleRequest(string_view request) {
+  size_t commandEnd = request.find('\n');
+  string_view command = request.substr(0, commandEnd);
+  string_view arguments = commandEnd == string_view::npos ? string_view() : request.substr(commandEnd + 1);
+
+  if (command == "compile") return compile(arguments);
+  if (command == "run") return run(arguments);
+
+  if (command == "shutdown") {
+    isShuttingDown = true;
+    return response(true, "");
+  }
+
+  return response(false, "Unknown command: " + string(command));
+}
+
+string CompileServer::compile(string_view arguments) {
+  size_t entrypointEnd = arguments.find('\n');
+  string entrypoint(arguments.substr(0, entrypointEnd));
+  string outputFile = entrypointEnd == string_view::npos ? "" : string(arguments.substr(entrypointEnd + 1));
+
+  if (entrypoint.empty()) return response(false, "No entrypoint given");
+  if (outputFile.empty()) outputFile = CLI::getDefaultOutputFile(entrypoint);
+
+  // Linked capsules may have changed since the last request. Everything else the compiler keeps between requests
+  // checks for changes by itself
+  session.resetLinkedCapsules();
+  session.clearExceptions();
+
+  OutputCapture capture;
+  bool isOk = false;
+
+  try {
+    isOk = session.compile(entrypoint, outputFile);
+  } catch (const exception &e) {
+    cout << e.what() << endl;
+  }
+
+  session.clearExceptions();
+
+  return response(isOk, capture.output.str());
+}
+
+string CompileServer::run(string_view source) {
+  session.resetLinkedCapsules();
+  session.clearExceptions();
+
+  OutputCapture capture;
+  bool isOk = false;
+
+  try {
+    vector<char> wasm = session.compileDirect(string(source));
+
+    if (wasm.size() > 0) {
+      ExecutionContext context = session.execute(wasm, "main0");
+
+      cout << context.stringifiedResult();
+      isOk = true;
+    }
+  } catch (const exception &e) {
+    cout << e.what() << endl;
+  }
+
+  session.clearExceptions();
+
+  return response(isOk, capture.output.str());
+}
+
+bool CompileServer::readFrame(int fd, string &frame) {
+  char header[4];
+  if (!readFully(fd, header, sizeof(header))) return false;
+
+  uint32_t length = readLength(header);
+  if (length > MAX_FRAME_SIZE) return false;
+
+  frame.resize(length);
+
+  return readFully(fd, frame.data(), length);
+}
+
+bool CompileServer::writeFrame(int fd, string_view frame) {
+  uint32_t length = frame.length();
+  char header[4] = { (char) (length >> 24), (char) (length >> 16), (char) (length >> 8), (char) length };
+
+  return writeFully(fd, header, sizeof(header)) && writeFully(fd, frame.data(), frame.length());
+}
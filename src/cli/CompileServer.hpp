@@ -0,0 +1,136 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include "compiler/CompilerSession.hpp"
+
+#if !defined(_WIN32) && !defined(__MSYS__)
+#define THETA_COMPILE_SERVER_SOCKETS
+#endif
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A long-running compile server, started with `theta --serve`. It keeps one warm process holding the capsule
+   * index, the runtime and everything else that every `theta` invocation would otherwise have to set up again, and
+   * takes compile and run requests over a Unix socket.
+   *
+   * Every message, in either direction, is a frame: a 4 byte big-endian length followed by that many bytes. A request
+   * is a single frame whose first line is the command, and whose remaining lines are its arguments:
+   *
+   *   compile\n<entrypoint>[\n<outputFile>]   Compiles a file, exactly like `theta <entrypoint>` would
+   *   run\n<source>                           Compiles and runs source code, exactly like the REPL would
+   *   shutdown                                Stops the server
+   *
+   * Each request gets a single frame in response. Its first line is `ok` or `error`, and the rest is everything the
+   * compiler printed while handling the request, or for `run`, the result. A connection can send any number of
+   * requests; they are handled one at a time, in the order they arrive.
+   *
+   * The server waits on every open connection at once, and handles a request as soon as all of its frame has arrived,
+   * so a client that stays connected without sending anything never holds up the others. Connections that stay idle
+   * for longer than IDLE_TIMEOUT are closed, and so are those of clients that don't read their responses within
+   * WRITE_TIMEOUT.
+   *
+   * Windows and MSYS builds don't have Unix sockets, so the server can't listen there, and says so.
+   */
+  class CompileServer {
+  public:
+    /**
+     * @param compilerSession The session to handle requests with.
+     * @param path The path of the Unix socket to listen on.
+     */
+    CompileServer(CompilerSession &compilerSession, filesystem::path path = DEFAULT_SOCKET_PATH) : session(compilerSession), socketPath(path) {}
+
+    ~CompileServer();
+
+    CompileServer(const CompileServer&) = delete;
+    CompileServer& operator=(const CompileServer&) = delete;
+
+    /**
+     * @brief Starts listening on the socket. A stale socket left behind by a server that didn't shut down cleanly is
+     * replaced.
+     * @return false If the socket couldn't be set up, or the platform has no Unix sockets
+     */
+    bool listen();
+
+    /**
+     * @brief Accepts connections and handles the requests on all of them until a shutdown request is received.
+     */
+    void serve();
+
+    /**
+     * @brief Handles the requests sent over a single connection, such as one end of a socketpair, until it's closed
+     * or a shutdown request is received. Unlike serve, this waits on nothing but the one connection.
+     * @param fd The connection's socket.
+     */
+    void handleConnection(int fd);
+
+    /**
+     * @brief Handles a single request.
+     * @param request The request frame.
+     * @return The response frame.
+     */
+    string handleRequest(string_view request);
+
+    /**
+     * @brief Reads a frame from a socket.
+     * @param fd The socket to read from.
+     * @param frame Where to store the frame's contents.
+     * @return false If the connection was closed, or the frame was malformed
+     */
+    static bool readFrame(int fd, string &frame);
+
+    /**
+     * @brief Writes a frame to a socket.
+     * @param fd The socket to write to.
+     * @param frame The frame's contents.
+     * @return false If the connection was closed
+     */
+    static bool writeFrame(int fd, string_view frame);
+
+    static inline const filesystem::path DEFAULT_SOCKET_PATH = filesystem::path(".theta") / "server.sock";
+
+    // Requests bigger than this are rejected rather than buffered
+    static const uint32_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+    static inline const chrono::seconds IDLE_TIMEOUT = chrono::seconds(300);
+    static inline const chrono::seconds WRITE_TIMEOUT = chrono::seconds(30);
+
+  private:
+    // What has been received on a connection that isn't a whole frame yet, and when anything was last received
+    struct Connection {
+      string received;
+      chrono::steady_clock::time_point lastActive;
+    };
+
+    CompilerSession &session;
+    filesystem::path socketPath;
+    int listenFd = -1;
+    bool isShuttingDown = false;
+    map<int, Connection> connections;
+
+    void acceptConnection();
+
+    /**
+     * @brief Reads what has arrived on a connection, and handles every request whose frame is now complete.
+     * @return false If the connection was closed, or sent a malformed frame
+     */
+    bool receive(int fd, Connection &connection);
+
+    void closeIdleConnections();
+
+    /**
+     * @brief How long until the next connection would be idle for too long, in milliseconds, or -1 if none are open.
+     */
+    int getPollTimeout();
+
+    string compile(string_view arguments);
+
+    string run(string_view source);
+  };
+}
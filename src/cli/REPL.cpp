@@ -1,9 +1,8 @@
 #include "REPL.hpp"
 #include <readline/readline.h>
 #include <readline/history.h>
-#include "compiler/Compiler.hpp"
 #include "CLI.hpp"
-#include "runtime/Runtime.hpp"
+#include <iostream>
 #include <map>
 
 using namespace Theta;
@@ -17,6 +16,9 @@ REPL::REPL() {
   CLI::printLanguageVersion();
   cout << "Report issues at " + CLI::makeLink("https://www.github.com/alexdovzhanyn/ThetaLang/issues") << endl;
   cout << "CTRL+D to exit" << endl << endl;
+
+  // Done while the first line is being typed, rather than once it's entered
+  session.getSession().warmUp();
 }
 
 REPL::~REPL() {
@@ -66,15 +68,14 @@ void REPL::readInput() {
 void REPL::execute(string source) {
   add_history(source.c_str());
 
-  vector<char> wasm = Compiler::getInstance().compileDirect(source);
+  ReplSession::Result result = session.evaluate(source);
 
-  if (wasm.size() > 0) {
-    ExecutionContext context = Runtime::getInstance().execute(wasm, "main0");
-    
-    cout << "\x1B[33m-----> " << context.stringifiedResult() << "\x1B[0m" << endl << endl;
-  }
+  // Lines that don't compile have already had their errors reported
+  if (result.output.empty()) return;
+
+  string style = result.isOk ? "\x1B[33m" : "\x1B[31m";
 
-  Compiler::getInstance().clearExceptions();
+  cout << style << "-----> " << result.output << "\x1B[0m" << endl << endl;
 }
 
 void REPL::prefillIndentation() {
@@ -2,6 +2,7 @@
 
 #include <stack>
 #include <string>
+#include "compiler/ReplSession.hpp"
 
 using namespace std;
 
@@ -31,6 +32,8 @@ namespace Theta {
     static stack<char> delimeterStack;
     static int lineNumber;
 
+    ReplSession session;
+
     bool isMatchingDelimeter(char &c, stack<char> delimeterStack);
 
     string getPrompt();
@@ -0,0 +1,430 @@
+#include "ASTCache.hpp"
+#include "compiler/BuildFingerprint.hpp"
+#include "lexer/Lexemes.hpp"
+#include "lexer/SourceFile.hpp"
+#include "parser/ast/ASTNodeList.hpp"
+#include "parser/ast/AssignmentNode.hpp"
+#include "parser/ast/BinaryOperationNode.hpp"
+#include "parser/ast/BlockNode.hpp"
+#include "parser/ast/CapsuleNode.hpp"
+#include "parser/ast/ControlFlowNode.hpp"
+#include "parser/ast/DictionaryNode.hpp"
+#include "parser/ast/EnumNode.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+#include "parser/ast/FunctionInvocationNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include "parser/ast/LinkNode.hpp"
+#include "parser/ast/ListNode.hpp"
+#include "parser/ast/LiteralNode.hpp"
+#include "parser/ast/ReturnNode.hpp"
+#include "parser/ast/SourceNode.hpp"
+#include "parser/ast/StructDeclarationNode.hpp"
+#include "parser/ast/StructDefinitionNode.hpp"
+#include "parser/ast/SymbolNode.hpp"
+#include "parser/ast/TupleNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+#include "parser/ast/UnaryOperationNode.hpp"
+#include "../../version.h"
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <thread>
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  const char MAGIC[8] = { 'T', 'H', 'E', 'T', 'A', 'A', 'S', 'T' };
+
+  // Offsets are relative to the start of the entry. The header lives at offset 0, so no record can, which is what
+  // lets 0 mean null
+  const uint32_t NONE = 0;
+
+  struct Header {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t rootOffset;
+    uint64_t sourceHash;
+    uint64_t length;
+    // Where the source the tree was parsed from is kept, after the records
+    uint64_t sourceOffset;
+    uint64_t sourceLength;
+  };
+
+  /**
+   * Every node is encoded as one of these, whatever its type. Fields that a node type doesn't have are NONE.
+   *
+   * text:   The node's string: an identifier, operator, literal value, type name and so on
+   * list:   An array of record offsets: the elements of a node list, the links of a source node, or the condition and
+   *         expression of each branch of a control flow node, one after the other
+   * first:  FunctionDeclaration parameters, FunctionInvocation identifier, Enum identifier
+   * second: FunctionDeclaration definition, FunctionInvocation arguments
+   */
+  struct NodeRecord {
+    uint32_t nodeType;
+    uint32_t textOffset;
+    uint32_t textLength;
+    uint32_t value;
+    uint32_t left;
+    uint32_t right;
+    uint32_t resolvedType;
+    uint32_t listOffset;
+    uint32_t listLength;
+    uint32_t first;
+    uint32_t second;
+    uint32_t line;
+    uint32_t column;
+  };
+
+  class Encoder {
+  public:
+    vector<char> buffer = vector<char>(sizeof(Header));
+
+    uint32_t writeNode(shared_ptr<ASTNode> node) {
+      if (!node) return NONE;
+
+      auto written = offsetsByNode.find(node.get());
+      if (written != offsetsByNode.end()) return written->second;
+
+      NodeRecord record = {};
+      record.nodeType = node->getNodeType();
+      record.line = node->getLine();
+      record.column = node->getColumn();
+
+      // Children are written before their parents, so that the parent's record can point at them
+      record.value = writeNode(node->getValue());
+      record.left = writeNode(node->getLeft());
+      record.right = writeNode(node->getRight());
+      record.resolvedType = writeNode(node->getResolvedType());
+
+      vector<shared_ptr<ASTNode>> list;
+      string text;
+
+      switch (node->getNodeType()) {
+        case ASTNode::SOURCE:
+          // Linked capsules have their own cache entries, so we only keep their names and they get resolved on load
+          for (auto &link : dynamic_pointer_cast<SourceNode>(node)->getLinks()) {
+            list.push_back(make_shared<LinkNode>(dynamic_pointer_cast<LinkNode>(link)->capsule, nullptr));
+            linkPlaceholders.push_back(list.back());
+          }
+          break;
+        case ASTNode::LINK: text = dynamic_pointer_cast<LinkNode>(node)->capsule; break;
+        case ASTNode::CAPSULE: text = dynamic_pointer_cast<CapsuleNode>(node)->getName(); break;
+        case ASTNode::BINARY_OPERATION: text = dynamic_pointer_cast<BinaryOperationNode>(node)->getOperator(); break;
+        case ASTNode::UNARY_OPERATION: text = dynamic_pointer_cast<UnaryOperationNode>(node)->getOperator(); break;
+        case ASTNode::IDENTIFIER: text = dynamic_pointer_cast<IdentifierNode>(node)->getIdentifier(); break;
+        case ASTNode::NUMBER_LITERAL:
+        case ASTNode::STRING_LITERAL:
+        case ASTNode::BOOLEAN_LITERAL:
+          text = dynamic_pointer_cast<LiteralNode>(node)->getLiteralValue();
+          break;
+        case ASTNode::SYMBOL: text = dynamic_pointer_cast<SymbolNode>(node)->getSymbol(); break;
+        case ASTNode::STRUCT_DECLARATION: text = dynamic_pointer_cast<StructDeclarationNode>(node)->getStructType(); break;
+        case ASTNode::STRUCT_DEFINITION: text = dynamic_pointer_cast<StructDefinitionNode>(node)->getName(); break;
+        case ASTNode::TYPE_DECLARATION: text = dynamic_pointer_cast<TypeDeclarationNode>(node)->getType(); break;
+        case ASTNode::FUNCTION_DECLARATION: {
+          shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(node);
+          record.first = writeNode(funcDecl->getParameters());
+          record.second = writeNode(funcDecl->getDefinition());
+
+          // The only annotation is kept as the node's text
+          if (funcDecl->getIsMemoized()) text = Lexemes::MEMO;
+          break;
+        }
+        case ASTNode::FUNCTION_INVOCATION: {
+          shared_ptr<FunctionInvocationNode> funcInv = dynamic_pointer_cast<FunctionInvocationNode>(node);
+          record.first = writeNode(funcInv->getIdentifier());
+          record.second = writeNode(funcInv->getParameters());
+          break;
+        }
+        case ASTNode::ENUM: record.first = writeNode(dynamic_pointer_cast<EnumNode>(node)->getIdentifier()); break;
+        case ASTNode::CONTROL_FLOW:
+          for (auto &[condition, expression] : dynamic_pointer_cast<ControlFlowNode>(node)->getConditionExpressionPairs()) {
+            list.push_back(condition);
+            list.push_back(expression);
+          }
+          break;
+        default:
+          break;
+      }
+
+      if (node->hasMany()) list = dynamic_pointer_cast<ASTNodeList>(node)->getElements();
+
+      vector<uint32_t> listOffsets;
+      for (auto &element : list) listOffsets.push_back(writeNode(element));
+
+      record.listLength = listOffsets.size();
+      record.listOffset = listOffsets.empty() ? NONE : append(listOffsets.data(), listOffsets.size() * sizeof(uint32_t));
+
+      record.textLength = text.length();
+      record.textOffset = text.empty() ? NONE : append(text.data(), text.length());
+
+      uint32_t offset = append(&record, sizeof(NodeRecord));
+      offsetsByNode.insert(make_pair(node.get(), offset));
+
+      return offset;
+    }
+
+    uint32_t append(const void *data, size_t length) {
+      // Everything is kept 4 byte aligned, so records can be read in place from a mapped entry
+      buffer.resize((buffer.size() + 3) & ~(size_t) 3);
+
+      uint32_t offset = buffer.size();
+      buffer.insert(buffer.end(), static_cast<const char*>(data), static_cast<const char*>(data) + length);
+
+      return offset;
+    }
+
+  private:
+    map<ASTNode*, uint32_t> offsetsByNode;
+
+    // Kept alive until we're done, so that their addresses can't be reused by another node in offsetsByNode
+    vector<shared_ptr<ASTNode>> linkPlaceholders;
+  };
+
+  class Decoder {
+  public:
+    Decoder(string_view d) : data(d), arena(make_shared<ASTArena>()) {}
+
+    bool isCorrupt = false;
+
+    shared_ptr<ASTNode> readNode(uint32_t offset, shared_ptr<ASTNode> parent) {
+      if (offset == NONE || isCorrupt) return nullptr;
+
+      // A record that (indirectly) contains itself can only come from a corrupt entry
+      if (inProgress.count(offset)) return fail();
+
+      auto decoded = nodesByOffset.find(offset);
+      if (decoded != nodesByOffset.end()) return decoded->second;
+
+      const NodeRecord *record = getRecord(offset);
+
+      if (!record) return fail();
+
+      inProgress.insert(offset);
+
+      string text;
+      if (record->textLength > 0) {
+        if (!isInBounds(record->textOffset, record->textLength)) return fail();
+
+        text = string(data.substr(record->textOffset, record->textLength));
+      }
+
+      shared_ptr<ASTNode> node = makeNode(record->nodeType, text, parent);
+      if (!node) return fail();
+
+      node->setSourceLocation(record->line, record->column);
+      nodesByOffset.insert(make_pair(offset, node));
+
+      node->setValue(readNode(record->value, node));
+      node->setLeft(readNode(record->left, node));
+      node->setRight(readNode(record->right, node));
+      node->setResolvedType(readNode(record->resolvedType, node));
+
+      vector<shared_ptr<ASTNode>> list;
+      if (record->listLength > 0) {
+        if (!isInBounds(record->listOffset, (uint64_t) record->listLength * sizeof(uint32_t))) return fail();
+
+        for (uint32_t i = 0; i < record->listLength; i++) {
+          uint32_t elementOffset;
+          memcpy(&elementOffset, data.data() + record->listOffset + i * sizeof(uint32_t), sizeof(uint32_t));
+
+          list.push_back(readNode(elementOffset, node));
+        }
+      }
+
+      switch (node->getNodeType()) {
+        case ASTNode::SOURCE: dynamic_pointer_cast<SourceNode>(node)->setLinks(list); break;
+        case ASTNode::FUNCTION_DECLARATION: {
+          shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(node);
+          funcDecl->setParameters(dynamic_pointer_cast<ASTNodeList>(readNode(record->first, node)));
+          funcDecl->setDefinition(readNode(record->second, node));
+          funcDecl->setIsMemoized(text == Lexemes::MEMO);
+          break;
+        }
+        case ASTNode::FUNCTION_INVOCATION: {
+          shared_ptr<FunctionInvocationNode> funcInv = dynamic_pointer_cast<FunctionInvocationNode>(node);
+          funcInv->setIdentifier(readNode(record->first, node));
+          funcInv->setParameters(dynamic_pointer_cast<ASTNodeList>(readNode(record->second, node)));
+          break;
+        }
+        case ASTNode::ENUM: dynamic_pointer_cast<EnumNode>(node)->setIdentifier(readNode(record->first, node)); break;
+        case ASTNode::CONTROL_FLOW: {
+          if (list.size() % 2 != 0) return fail();
+
+          vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> pairs;
+          for (size_t i = 0; i < list.size(); i += 2) pairs.push_back(make_pair(list[i], list[i + 1]));
+
+          dynamic_pointer_cast<ControlFlowNode>(node)->setConditionExpressionPairs(pairs);
+          break;
+        }
+        default:
+          break;
+      }
+
+      if (node->hasMany()) dynamic_pointer_cast<ASTNodeList>(node)->setElements(list);
+
+      inProgress.erase(offset);
+
+      return isCorrupt ? nullptr : node;
+    }
+
+  private:
+    string_view data;
+    shared_ptr<ASTArena> arena;
+    map<uint32_t, shared_ptr<ASTNode>> nodesByOffset;
+    set<uint32_t> inProgress;
+
+    shared_ptr<ASTNode> fail() {
+      isCorrupt = true;
+      return nullptr;
+    }
+
+    bool isInBounds(uint64_t offset, uint64_t length) {
+      return offset >= sizeof(Header) && offset + length <= data.length();
+    }
+
+    const NodeRecord* getRecord(uint32_t offset) {
+      if (offset % 4 != 0 || !isInBounds(offset, sizeof(NodeRecord))) return nullptr;
+
+      return reinterpret_cast<const NodeRecord*>(data.data() + offset);
+    }
+
+    shared_ptr<ASTNode> makeNode(uint32_t nodeType, const string &text, shared_ptr<ASTNode> parent) {
+      switch (nodeType) {
+        case ASTNode::ASSIGNMENT: return arena->make<AssignmentNode>(parent);
+        case ASTNode::AST_NODE_LIST: return arena->make<ASTNodeList>(parent);
+        case ASTNode::BINARY_OPERATION: return arena->make<BinaryOperationNode>(text, parent);
+        case ASTNode::BLOCK: return arena->make<BlockNode>(parent);
+        case ASTNode::BOOLEAN_LITERAL:
+        case ASTNode::NUMBER_LITERAL:
+        case ASTNode::STRING_LITERAL:
+          return arena->make<LiteralNode>((ASTNode::Types) nodeType, text, parent);
+        case ASTNode::CAPSULE: return arena->make<CapsuleNode>(text, parent);
+        case ASTNode::CONTROL_FLOW: return arena->make<ControlFlowNode>(parent);
+        case ASTNode::DICTIONARY: return arena->make<DictionaryNode>(parent);
+        case ASTNode::ENUM: return arena->make<EnumNode>(parent);
+        case ASTNode::FUNCTION_DECLARATION: return arena->make<FunctionDeclarationNode>(parent);
+        case ASTNode::FUNCTION_INVOCATION: return arena->make<FunctionInvocationNode>(parent);
+        case ASTNode::IDENTIFIER: return arena->make<IdentifierNode>(text, parent);
+        case ASTNode::LINK: return arena->make<LinkNode>(text, parent);
+        case ASTNode::LIST: return arena->make<ListNode>(parent);
+        case ASTNode::RETURN: return arena->make<ReturnNode>(parent);
+        case ASTNode::SOURCE: return arena->make<SourceNode>();
+        case ASTNode::STRUCT_DECLARATION: return arena->make<StructDeclarationNode>(text, parent);
+        case ASTNode::STRUCT_DEFINITION: return arena->make<StructDefinitionNode>(text, parent);
+        // Symbols are stored with the leading colon the constructor adds
+        case ASTNode::SYMBOL: return arena->make<SymbolNode>(text.empty() ? text : text.substr(1), parent);
+        case ASTNode::TUPLE: return arena->make<TupleNode>(parent);
+        case ASTNode::TYPE_DECLARATION: return arena->make<TypeDeclarationNode>(text, parent);
+        case ASTNode::UNARY_OPERATION: return arena->make<UnaryOperationNode>(text, parent);
+        default: return nullptr;
+      }
+    }
+  };
+}
+
+shared_ptr<ASTNode> ASTCache::load(string_view source) {
+  uint64_t sourceHash = hashSource(source);
+
+  shared_ptr<SourceFile> entry = SourceFile::open(getEntryPath(sourceHash).string());
+  if (!entry) return nullptr;
+
+  return deserialize(entry->view(), source, sourceHash);
+}
+
+void ASTCache::store(string_view source, shared_ptr<ASTNode> ast) {
+  uint64_t sourceHash = hashSource(source);
+  vector<char> encoded = serialize(ast, source, sourceHash);
+
+  error_code ec;
+  filesystem::create_directories(cacheDir, ec);
+
+  // Write to a temporary file and move it into place, so a concurrent compile never loads a partially written entry
+  filesystem::path entryPath = getEntryPath(sourceHash);
+  filesystem::path tempPath = entryPath;
+  tempPath += ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()));
+
+  {
+    ofstream entryFile(tempPath, ios::binary | ios::trunc);
+    if (!entryFile) return;
+
+    entryFile.write(encoded.data(), encoded.size());
+    if (!entryFile.good()) return;
+  }
+
+  filesystem::rename(tempPath, entryPath, ec);
+  if (ec) filesystem::remove(tempPath, ec);
+}
+
+vector<char> ASTCache::serialize(shared_ptr<ASTNode> ast, string_view source, uint64_t sourceHash) {
+  Encoder encoder;
+  uint32_t rootOffset = encoder.writeNode(ast);
+
+  Header header = {};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.formatVersion = FORMAT_VERSION;
+  header.rootOffset = rootOffset;
+  header.sourceHash = sourceHash;
+  header.sourceOffset = encoder.append(source.data(), source.length());
+  header.sourceLength = source.length();
+  header.length = encoder.buffer.size();
+
+  memcpy(encoder.buffer.data(), &header, sizeof(Header));
+
+  return encoder.buffer;
+}
+
+shared_ptr<ASTNode> ASTCache::deserialize(string_view data, string_view source, uint64_t sourceHash) {
+  if (data.length() < sizeof(Header)) return nullptr;
+
+  Header header;
+  memcpy(&header, data.data(), sizeof(Header));
+
+  if (
+    memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+    header.formatVersion != FORMAT_VERSION ||
+    header.sourceHash != sourceHash ||
+    header.length != data.length()
+  ) return nullptr;
+
+  // A matching hash only makes it likely that this is the same source. Comparing the stored source makes it certain
+  if (
+    header.sourceLength != source.length() ||
+    header.sourceOffset < sizeof(Header) ||
+    header.sourceOffset > data.length() ||
+    header.sourceLength > data.length() - header.sourceOffset ||
+    data.compare(header.sourceOffset, header.sourceLength, source) != 0
+  ) return nullptr;
+
+  Decoder decoder(data);
+  shared_ptr<ASTNode> ast = decoder.readNode(header.rootOffset, nullptr);
+
+  return decoder.isCorrupt ? nullptr : ast;
+}
+
+uint64_t ASTCache::hashSource(string_view source) {
+  // FNV-1a. We only need to tell sources apart, this isn't meant to be resistant to anyone crafting collisions
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](string_view bytes) {
+    for (unsigned char c : bytes) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  mix(to_string(VERSION_MAJOR) + "." + to_string(VERSION_MINOR) + "." + to_string(VERSION_PATCH) + ":" + to_string(FORMAT_VERSION) + ":");
+
+  // The parser can change without the version or the format changing, so builds never share what they cache
+  mix(BuildFingerprint::get() + ":");
+  mix(source);
+
+  return hash;
+}
+
+filesystem::path ASTCache::getEntryPath(uint64_t sourceHash) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.ast", (unsigned long long) sourceHash);
+
+  return cacheDir / name;
+}
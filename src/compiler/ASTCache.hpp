@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parser/ast/ASTNode.hpp"
+#include "parser/ast/ASTArena.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief An on-disk cache of parsed ASTs, so that source files which haven't changed don't have to be lexed and
+   * parsed again on every compile.
+   *
+   * Entries are keyed by a hash of the file's contents and the compiler version, so editing a file or upgrading the
+   * compiler both simply miss. Each entry is a flat binary image of the tree: fixed-size node records tagged with
+   * their node type, which refer to their children, lists and strings by offset. This lets an entry be memory-mapped
+   * and decoded straight into nodes, with no parsing of its own. Entries also hold the source they were parsed from,
+   * which is compared on load, so two sources whose hashes collide can never be given each other's tree.
+   *
+   * Linked capsules are stored by name only. They are cached in their own entries and have to be resolved again
+   * when an entry is loaded.
+   */
+  class ASTCache {
+  public:
+    /**
+     * @param directory Where cache entries are stored.
+     */
+    ASTCache(filesystem::path directory = DEFAULT_CACHE_DIR) : cacheDir(directory) {}
+
+    /**
+     * @brief Loads the cached AST for the given source, if there is one.
+     * @param source The source code the AST was parsed from.
+     * @return The cached AST, or nullptr if there is no valid entry for the source.
+     */
+    shared_ptr<ASTNode> load(string_view source);
+
+    /**
+     * @brief Stores the AST parsed from the given source. Failing to write the entry is not an error, the next
+     * compile will just miss.
+     * @param source The source code the AST was parsed from.
+     * @param ast The AST to store.
+     */
+    void store(string_view source, shared_ptr<ASTNode> ast);
+
+    /**
+     * @brief Encodes an AST into the cache's binary format.
+     * @param ast The AST to encode.
+     * @param source The source code the AST was parsed from, which is stored with it.
+     * @param sourceHash The hash of the source, see hashSource.
+     * @return The encoded AST.
+     */
+    static vector<char> serialize(shared_ptr<ASTNode> ast, string_view source, uint64_t sourceHash);
+
+    /**
+     * @brief Decodes an AST from the cache's binary format.
+     * @param data The encoded AST.
+     * @param source The source code the AST is expected to be for, compared byte for byte with the one it was stored
+     * with.
+     * @param sourceHash The hash of the source, see hashSource.
+     * @return The decoded AST, or nullptr if the data is corrupt or was encoded for a different source or compiler.
+     */
+    static shared_ptr<ASTNode> deserialize(string_view data, string_view source, uint64_t sourceHash);
+
+    /**
+     * @brief Hashes source code together with the compiler version, the cache's format version and the build of the
+     * compiler, see BuildFingerprint.
+     */
+    static uint64_t hashSource(string_view source);
+
+    static inline const filesystem::path DEFAULT_CACHE_DIR = filesystem::path(".theta") / "ast-cache";
+
+    // Bump this whenever the encoding, or the shape of the trees the parser produces, changes
+    static const uint32_t FORMAT_VERSION = 3;
+
+  private:
+    filesystem::path cacheDir;
+
+    filesystem::path getEntryPath(uint64_t sourceHash);
+  };
+}
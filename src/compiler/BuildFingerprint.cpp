@@ -0,0 +1,26 @@
+#include "BuildFingerprint.hpp"
+#include "BuildId.hpp"
+#include "wasm/ThetaLangCoreWasm.hpp"
+#include <cstdint>
+#include <cstdio>
+
+using namespace std;
+using namespace Theta;
+
+const string& BuildFingerprint::get() {
+  static const string fingerprint = []() {
+    // FNV-1a, like the cache keys themselves
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < THETA_LANG_CORE_WASM_SIZE; i++) {
+      hash ^= THETA_LANG_CORE_WASM[i];
+      hash *= 1099511628211ULL;
+    }
+
+    char coreHash[17];
+    snprintf(coreHash, sizeof(coreHash), "%016llx", (unsigned long long) hash);
+
+    return string(THETA_BUILD_ID) + ":" + coreHash;
+  }();
+
+  return fingerprint;
+}
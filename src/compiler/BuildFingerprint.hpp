@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Names the build of the compiler that's running, for what it caches to be keyed on. Its output can change
+   * without the version changing, as when code generation or the core module does, so entries one build stored must
+   * never be served by another. It's the id CMake gives the build, see scripts/build_id.cmake, and a hash of the core
+   * module the compiler embeds.
+   */
+  struct BuildFingerprint {
+    static const string& get();
+  };
+}
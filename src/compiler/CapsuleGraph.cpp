@@ -0,0 +1,160 @@
+#include "CapsuleGraph.hpp"
+#include "ASTCache.hpp"
+#include "lexer/SourceFile.hpp"
+#include "parser/ast/ASTNodeList.hpp"
+#include "parser/ast/CapsuleNode.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+#include "parser/ast/LinkNode.hpp"
+#include "parser/ast/SourceNode.hpp"
+#include <cstdint>
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  const size_t IN_PROGRESS = SIZE_MAX;
+
+  // FNV-1a, same as the AST cache uses for sources
+  class Hasher {
+  public:
+    uint64_t hash = 14695981039346656037ULL;
+
+    void mix(string_view bytes) {
+      for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+      }
+
+      // Keeps ("ab", "c") and ("a", "bc") apart
+      hash ^= 0xff;
+      hash *= 1099511628211ULL;
+    }
+
+    void mix(uint64_t value) {
+      mix(string_view(reinterpret_cast<const char*>(&value), sizeof(value)));
+    }
+  };
+}
+
+CapsuleGraph CapsuleGraph::build(shared_ptr<ASTNode> ast, string file, const map<string, string> &filesByCapsule) {
+  CapsuleGraph graph;
+
+  string name = file;
+  if (ast && ast->getValue() && ast->getValue()->getNodeType() == ASTNode::CAPSULE) {
+    name = dynamic_pointer_cast<CapsuleNode>(ast->getValue())->getName();
+  }
+
+  graph.addUnit(name, file, ast, filesByCapsule);
+
+  return graph;
+}
+
+const CapsuleUnit* CapsuleGraph::findUnit(const string &name) const {
+  auto it = unitIndexesByName.find(name);
+  if (it == unitIndexesByName.end() || it->second == IN_PROGRESS) return nullptr;
+
+  return &units[it->second];
+}
+
+void CapsuleGraph::addUnit(string name, string file, shared_ptr<ASTNode> ast, const map<string, string> &filesByCapsule) {
+  if (unitIndexesByName.find(name) != unitIndexesByName.end()) return;
+
+  CapsuleUnit unit;
+  unit.name = name;
+  unit.file = file;
+  unit.ast = ast;
+
+  // Marks the capsule as visited before its links are, in case a linked capsule links the entrypoint back
+  unitIndexesByName.insert(make_pair(name, IN_PROGRESS));
+
+  shared_ptr<SourceNode> sourceNode = dynamic_pointer_cast<SourceNode>(ast);
+  if (sourceNode) {
+    for (shared_ptr<ASTNode> link : sourceNode->getLinks()) {
+      shared_ptr<LinkNode> linkNode = dynamic_pointer_cast<LinkNode>(link);
+      if (!linkNode) continue;
+
+      unit.dependencies.push_back(linkNode->capsule);
+
+      auto linkedFile = filesByCapsule.find(linkNode->capsule);
+      addUnit(
+        linkNode->capsule,
+        linkedFile != filesByCapsule.end() ? linkedFile->second : "",
+        linkNode->getValue(),
+        filesByCapsule
+      );
+    }
+  }
+
+  Hasher interfaceHasher;
+  interfaceHasher.mix(hashInterface(ast));
+
+  unit.sourceHash = hashFile(file, ast);
+
+  Hasher buildHasher;
+  buildHasher.mix(unit.sourceHash);
+
+  for (const string &dependency : unit.dependencies) {
+    const CapsuleUnit *dependencyUnit = findUnit(dependency);
+
+    // Capsules that are still being added are part of a cycle through the entrypoint, which already failed to link
+    uint64_t dependencyInterface = dependencyUnit ? dependencyUnit->interfaceHash : 0;
+
+    interfaceHasher.mix(dependency);
+    interfaceHasher.mix(dependencyInterface);
+    buildHasher.mix(dependency);
+    buildHasher.mix(dependencyInterface);
+  }
+
+  unit.interfaceHash = interfaceHasher.hash;
+  unit.buildKey = buildHasher.hash;
+
+  unitIndexesByName[name] = units.size();
+  units.push_back(unit);
+}
+
+uint64_t CapsuleGraph::hashInterface(shared_ptr<ASTNode> ast) {
+  Hasher hasher;
+
+  shared_ptr<ASTNode> node = ast && ast->getNodeType() == ASTNode::SOURCE ? ast->getValue() : ast;
+  if (!node) return hasher.hash;
+
+  // Sources that aren't capsules can't be linked, so all of them counts
+  if (node->getNodeType() != ASTNode::CAPSULE) {
+    hasher.mix(node->toJSON());
+    return hasher.hash;
+  }
+
+  hasher.mix(dynamic_pointer_cast<CapsuleNode>(node)->getName());
+
+  shared_ptr<ASTNodeList> elements = dynamic_pointer_cast<ASTNodeList>(node->getValue());
+  if (!elements) return hasher.hash;
+
+  for (shared_ptr<ASTNode> elem : elements->getElements()) {
+    if (!elem) continue;
+
+    if (elem->getNodeType() != ASTNode::ASSIGNMENT) {
+      hasher.mix(elem->toJSON());
+      continue;
+    }
+
+    // The identifier carries the declared type
+    if (elem->getLeft()) hasher.mix(elem->getLeft()->toJSON());
+
+    shared_ptr<FunctionDeclarationNode> function = dynamic_pointer_cast<FunctionDeclarationNode>(elem->getRight());
+    if (function && function->getParameters()) {
+      for (shared_ptr<ASTNode> param : function->getParameters()->getElements()) {
+        hasher.mix(param->toJSON());
+      }
+    }
+  }
+
+  return hasher.hash;
+}
+
+uint64_t CapsuleGraph::hashFile(const string &file, shared_ptr<ASTNode> ast) {
+  shared_ptr<SourceFile> source = file.empty() ? nullptr : SourceFile::open(file);
+  if (source) return ASTCache::hashSource(source->view());
+
+  // Sources that didn't come from a file can only be told apart by what they parsed to
+  return ASTCache::hashSource(ast ? ast->toJSON() : "");
+}
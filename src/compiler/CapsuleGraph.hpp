@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "parser/ast/ASTNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief One capsule of a program, as a unit of compilation.
+   */
+  struct CapsuleUnit {
+    // The capsule's name, or the file name for sources that don't declare a capsule
+    string name;
+
+    // The file the capsule is defined in. Empty for sources that weren't read from a file
+    string file;
+
+    shared_ptr<ASTNode> ast;
+
+    // The names of the capsules this one links, in the order they are linked
+    vector<string> dependencies;
+
+    // Hash of the capsule's source code
+    uint64_t sourceHash = 0;
+
+    /**
+     * Hash of everything other capsules can see of this one: the names and declared types of its top level
+     * declarations, and the interfaces of the capsules it links. Editing a function body leaves it unchanged.
+     */
+    uint64_t interfaceHash = 0;
+
+    /**
+     * Hash of everything that goes into compiling the capsule: its own source and the interfaces of the capsules it
+     * links. A capsule only needs to be compiled again when this changes.
+     */
+    uint64_t buildKey = 0;
+  };
+
+  /**
+   * @brief The capsules a program is made of and the links between them, built from the LinkNodes of a parsed
+   * program. Each capsule gets a build key, so that compiled capsules can be cached and only the capsules whose
+   * source, or whose dependencies' interfaces, changed have to be compiled again.
+   */
+  class CapsuleGraph {
+  public:
+    /**
+     * @brief Builds the graph for a parsed program.
+     * @param ast The AST of the program's entrypoint, with its links resolved.
+     * @param file The file the entrypoint was read from.
+     * @param filesByCapsule The files each linked capsule was resolved to.
+     * @return The capsule graph of the program.
+     */
+    static CapsuleGraph build(shared_ptr<ASTNode> ast, string file, const map<string, string> &filesByCapsule);
+
+    /**
+     * @brief The unit of the program's entrypoint.
+     */
+    const CapsuleUnit& getEntrypoint() const { return units.back(); }
+
+    /**
+     * @brief All units in the program, ordered so that every capsule comes after the capsules it links. The entrypoint
+     * is always last.
+     */
+    const vector<CapsuleUnit>& getUnits() const { return units; }
+
+    /**
+     * @brief Finds the unit for the given capsule.
+     * @param name The name of the capsule.
+     * @return A pointer to the unit, or nullptr if the capsule isn't part of the program.
+     */
+    const CapsuleUnit* findUnit(const string &name) const;
+
+    /**
+     * @brief Hashes the interface of a parsed source: the names and declared types of the declarations at the top
+     * level of its capsule, and any struct and enum definitions there. Anything inside function bodies or on the
+     * right side of assignments is not part of it.
+     * @param ast The AST of the source.
+     * @return The hash of the source's interface.
+     */
+    static uint64_t hashInterface(shared_ptr<ASTNode> ast);
+
+  private:
+    vector<CapsuleUnit> units;
+    map<string, size_t> unitIndexesByName;
+
+    /**
+     * @brief Adds the unit for a source after the units of everything it links. Capsules that are already in the graph
+     * are skipped.
+     */
+    void addUnit(string name, string file, shared_ptr<ASTNode> ast, const map<string, string> &filesByCapsule);
+
+    static uint64_t hashFile(const string &file, shared_ptr<ASTNode> ast);
+  };
+}
@@ -0,0 +1,193 @@
+#include "CapsuleIndex.hpp"
+#include "lexer/Lexemes.hpp"
+#include "lexer/SourceFile.hpp"
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace Theta;
+
+const string INDEX_HEADER = "ThetaCapsuleIndex 1";
+
+optional<string> CapsuleIndex::findCapsuleFile(string capsuleName) {
+  if (!isLoaded) load();
+
+  auto it = filesByCapsule.find(capsuleName);
+  if (it != filesByCapsule.end()) {
+    // Once we've refreshed during this run, every entry was just validated
+    if (isRefreshed || isEntryCurrent(it->second, entriesByFile[it->second])) return it->second;
+  }
+
+  // Either the capsule is new, or the file it was indexed in has changed. Either way we need to look at the tree again,
+  // but we only ever do that once per run
+  if (isRefreshed) return nullopt;
+
+  refresh();
+
+  it = filesByCapsule.find(capsuleName);
+  if (it != filesByCapsule.end()) return it->second;
+
+  return nullopt;
+}
+
+void CapsuleIndex::prepare() {
+  if (isRefreshed) return;
+  if (!isLoaded) load();
+
+  refresh();
+}
+
+void CapsuleIndex::refresh() {
+  map<string, Entry> refreshedEntries;
+  bool isChanged = false;
+
+  error_code ec;
+  auto it = filesystem::recursive_directory_iterator(root, filesystem::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != filesystem::recursive_directory_iterator(); it.increment(ec)) {
+    if (!it->is_regular_file(ec) || it->path().extension() != ".th") continue;
+
+    string file = it->path().string();
+    long long modifiedTime;
+    uintmax_t size;
+    if (!statFile(file, modifiedTime, size)) continue;
+
+    auto existing = entriesByFile.find(file);
+    if (existing != entriesByFile.end() && existing->second.modifiedTime == modifiedTime && existing->second.size == size) {
+      refreshedEntries.insert(*existing);
+      continue;
+    }
+
+    refreshedEntries.insert(make_pair(file, Entry{ findCapsuleNameInFile(file), modifiedTime, size }));
+    isChanged = true;
+  }
+
+  // Files that have been deleted also count as a change
+  if (refreshedEntries.size() != entriesByFile.size()) isChanged = true;
+
+  entriesByFile = refreshedEntries;
+  rebuildCapsuleLookup();
+  isLoaded = true;
+  isRefreshed = true;
+
+  if (isChanged) save();
+}
+
+string CapsuleIndex::findCapsuleNameInFile(string file) {
+  // Capsule declarations are almost always right at the top of the file, so we only load the first page. If the
+  // capsule keyword isn't in there and the file is longer, we fall back to loading all of it.
+  shared_ptr<SourceFile> sourceFile = SourceFile::open(file, SourceFile::getPageSize());
+  if (!sourceFile) return "";
+
+  string capsuleName = findCapsuleName(sourceFile->view());
+
+  if (capsuleName == "" && sourceFile->truncated()) {
+    sourceFile = SourceFile::open(file);
+    if (sourceFile) capsuleName = findCapsuleName(sourceFile->view());
+  }
+
+  return capsuleName;
+}
+
+string CapsuleIndex::findCapsuleName(string_view source) {
+  int i = 0;
+  bool capsuleNameFound = false;
+  string capsuleName;
+
+  // TODO: This is probably better suited to live in the lexer as a callable function
+  // Iterate over the source but stop once we find a capsule
+  while (i + 6 < source.length() && !capsuleNameFound) {
+    if (source.compare(i, Lexemes::CAPSULE.length(), Lexemes::CAPSULE) == 0) {
+      capsuleNameFound = true;
+      i += 7;
+    }
+
+    i++;
+  }
+
+  if (capsuleNameFound) {
+    while (i < source.length() && source[i] != '\n' && !isspace(source[i]) && source[i] != '{') {
+      capsuleName.push_back(source[i]);
+
+      i++;
+    }
+  }
+
+  return capsuleName;
+}
+
+void CapsuleIndex::load() {
+  isLoaded = true;
+
+  ifstream indexFile(indexPath);
+  if (!indexFile) return;
+
+  string line;
+  if (!getline(indexFile, line) || line != INDEX_HEADER) return;
+
+  // Each line is: capsuleName \t modifiedTime \t size \t path
+  while (getline(indexFile, line)) {
+    istringstream fields(line);
+    string capsuleName, modifiedTime, size, file;
+
+    if (!getline(fields, capsuleName, '\t') || !getline(fields, modifiedTime, '\t') || !getline(fields, size, '\t') || !getline(fields, file)) continue;
+
+    try {
+      entriesByFile.insert(make_pair(file, Entry{ capsuleName, stoll(modifiedTime), stoull(size) }));
+    } catch (const exception &e) {
+      // A corrupt line just means that file will get indexed again
+    }
+  }
+
+  rebuildCapsuleLookup();
+}
+
+void CapsuleIndex::save() {
+  error_code ec;
+  if (indexPath.has_parent_path()) filesystem::create_directories(indexPath.parent_path(), ec);
+
+  // Write to a temporary file and move it into place, so a concurrent run never sees a partially written index. The
+  // temporary file is per thread, since compilers on different threads can save at the same time
+  filesystem::path tempPath = indexPath;
+  tempPath += ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()));
+
+  {
+    ofstream indexFile(tempPath, ios::trunc);
+    if (!indexFile) return;
+
+    indexFile << INDEX_HEADER << '\n';
+    for (auto &[file, entry] : entriesByFile) {
+      indexFile << entry.capsuleName << '\t' << entry.modifiedTime << '\t' << entry.size << '\t' << file << '\n';
+    }
+  }
+
+  filesystem::rename(tempPath, indexPath, ec);
+}
+
+bool CapsuleIndex::isEntryCurrent(const string &file, const Entry &entry) {
+  long long modifiedTime;
+  uintmax_t size;
+
+  return statFile(file, modifiedTime, size) && modifiedTime == entry.modifiedTime && size == entry.size;
+}
+
+void CapsuleIndex::rebuildCapsuleLookup() {
+  filesByCapsule.clear();
+
+  for (auto &[file, entry] : entriesByFile) {
+    if (entry.capsuleName != "") filesByCapsule.insert(make_pair(entry.capsuleName, file));
+  }
+}
+
+bool CapsuleIndex::statFile(const string &file, long long &modifiedTime, uintmax_t &size) {
+  error_code ec;
+
+  auto lastWriteTime = filesystem::last_write_time(file, ec);
+  if (ec) return false;
+
+  size = filesystem::file_size(file, ec);
+  if (ec) return false;
+
+  modifiedTime = lastWriteTime.time_since_epoch().count();
+  return true;
+}
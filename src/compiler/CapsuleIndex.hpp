@@ -0,0 +1,93 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief An on-disk index of which file each capsule is defined in, so that we don't have to open every `.th` file in
+   * the tree on every invocation just to resolve links.
+   *
+   * Each entry records the file's modification time and size. Entries are validated as they are used, and only files
+   * that have changed since they were indexed get read again. The index is loaded lazily, the first time a capsule
+   * actually needs to be resolved.
+   */
+  class CapsuleIndex {
+  public:
+    /**
+     * @param rootDir The directory to discover capsules in.
+     * @param indexFile Where to persist the index.
+     */
+    CapsuleIndex(filesystem::path rootDir = ".", filesystem::path indexFile = DEFAULT_INDEX_FILE) : root(rootDir), indexPath(indexFile) {}
+
+    /**
+     * @brief Finds the file that defines the given capsule. Loads the on-disk index on first use, and rescans the tree
+     * if the capsule isn't indexed or its entry has gone stale.
+     * @param capsuleName The name of the capsule to find.
+     * @return The path of the file defining the capsule, if there is one.
+     */
+    optional<string> findCapsuleFile(string capsuleName);
+
+    /**
+     * @brief Walks the tree for `.th` files, reusing the indexed capsule name of any file that hasn't changed, and
+     * writes the updated index back to disk.
+     */
+    void refresh();
+
+    /**
+     * @brief Loads and refreshes the index ahead of the first capsule being resolved, unless that already happened.
+     */
+    void prepare();
+
+    /**
+     * @brief Finds the capsule name declared in the given source.
+     * @param source The source to search.
+     * @return The capsule name, or an empty string if there is no capsule declaration.
+     */
+    static string findCapsuleName(string_view source);
+
+    /**
+     * @brief Finds the capsule name declared in the given file. Only the first page of the file is read, unless the
+     * declaration isn't found there.
+     * @param file The file to search.
+     * @return The capsule name, or an empty string if there is no capsule declaration.
+     */
+    static string findCapsuleNameInFile(string file);
+
+    static inline const filesystem::path DEFAULT_INDEX_FILE = filesystem::path(".theta") / "capsules.index";
+
+  private:
+    struct Entry {
+      string capsuleName;
+      long long modifiedTime;
+      uintmax_t size;
+    };
+
+    filesystem::path root;
+    filesystem::path indexPath;
+    bool isLoaded = false;
+    bool isRefreshed = false;
+
+    // Keyed by file path
+    map<string, Entry> entriesByFile;
+    map<string, string> filesByCapsule;
+
+    void load();
+
+    void save();
+
+    /**
+     * @brief Checks that the file still has the modification time and size it was indexed with
+     */
+    bool isEntryCurrent(const string &file, const Entry &entry);
+
+    void rebuildCapsuleLookup();
+
+    static bool statFile(const string &file, long long &modifiedTime, uintmax_t &size);
+  };
+}
@@ -1,19 +1,29 @@
 #include <iostream>
+#include <iomanip>
 #include <libgen.h>
 #include <limits.h>
 #include <unistd.h>
 #include <iterator>
+#include <algorithm>
+#include <exception>
 #include <memory>
 #include <set>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include "asmjs/shared-constants.h"
 #include "binaryen-c.h"
+#include "ir/module-utils.h"
+#include "wasm-builder.h"
+#include "wasm-traversal.h"
+#include "wasm/ThetaLangCoreWasm.hpp"
 #include "compiler/Compiler.hpp"
 #include "compiler/TypeChecker.hpp"
+#include "compiler/TypeInterner.hpp"
 #include "compiler/WasmClosure.hpp"
+#include "compiler/optimization/InliningPass.hpp"
 #include "lexer/Lexemes.hpp"
 #include "StandardLibrary.hpp"
 #include "CodeGen.hpp"
@@ -36,14 +46,37 @@
 using namespace Theta;
 
 BinaryenModuleRef CodeGen::generateWasmFromAST(shared_ptr<ASTNode> ast) {
-  BinaryenModuleRef module = initializeWasmModule();        
+  PhaseTimer *phaseTimer = Compiler::getInstance().getPhaseTimer();
+  BinaryenModuleRef module;
 
-  generate(ast, module);
+  {
+    PhaseTimer::Scope timing(phaseTimer, "Code generation");
 
-  registerModuleFunctions(module);
+    module = initializeWasmModule();
 
-  // Automatically adds drops to unused stack values
-  BinaryenModuleAutoDrop(module);
+    if (!debugInfoFile.empty()) debugInfoFileIndex = BinaryenModuleAddDebugInfoFileName(module, debugInfoFile.c_str());
+
+    collectSymbols(ast);
+    generate(ast, module);
+
+    registerModuleFunctions(module);
+    configureHeap(module);
+    addResultTypes(module);
+
+    if (Compiler::getInstance().getIsProfiling()) addProfiling(module);
+    if (Compiler::getInstance().getIsMeteringFuel()) meterFuel(module);
+
+    if (!debugInfoFile.empty()) addSymbolNames(module);
+  }
+
+  {
+    // Automatically adds drops to unused stack values
+    PhaseTimer::Scope timing(phaseTimer, "BinaryenModuleAutoDrop");
+    BinaryenModuleAutoDrop(module);
+  }
+
+  PhaseTimer::Scope timing(phaseTimer, "Tree shaking");
+  removeUnusedModuleElements(module);
 
   return module;
 }
@@ -51,80 +84,134 @@ BinaryenModuleRef CodeGen::generateWasmFromAST(shared_ptr<ASTNode> ast) {
 BinaryenModuleRef CodeGen::initializeWasmModule() {
   BinaryenModuleRef module = importCoreLangWasm();
 
-  BinaryenModuleSetFeatures(module, BinaryenFeatureStrings());
+  BinaryenModuleSetFeatures(
+    module,
+    BinaryenFeatureStrings() |
+    BinaryenFeatureTailCall() |
+    BinaryenFeatureReferenceTypes() |
+    BinaryenFeatureBulkMemory() |
+    BinaryenFeatureSIMD128() |
+    BinaryenFeatureMultivalue() |
+    BinaryenFeatureMutableGlobals()
+  );
+
+  StandardLibrary::registerFunctions(module);
+
+  return module;
+}
+
+void CodeGen::configureHeap(BinaryenModuleRef &module) {
+  const HeapOptions &heapOptions = Compiler::getInstance().getHeapOptions();
+
+  // The segments are passive, so they take up no memory until a dictionary is copied out of one
+  vector<const char*> segmentNames;
+  vector<const char*> segmentDatas;
+  vector<BinaryenIndex> segmentSizes;
+  vector<BinaryenExpressionRef> segmentOffsets;
+  bool *segmentPassives = new bool[dictionaryLayoutSegments.size()];
+
+  for (int i = 0; i < dictionaryLayoutSegments.size(); i++) {
+    segmentNames.push_back(dictionaryLayoutSegments.at(i).first.c_str());
+    segmentDatas.push_back(dictionaryLayoutSegments.at(i).second.data());
+    segmentSizes.push_back(dictionaryLayoutSegments.at(i).second.size());
+    segmentOffsets.push_back(NULL);
+    segmentPassives[i] = true;
+  }
+
+  // Memo tables take up whole pages, which are added on top of the heap's, so the heap stays as big as it was
+  // configured to be and starts on a page, which growing it relies on
+  int memoPages = (memoTablesSize + HeapOptions::PAGE_BYTES - 1) / HeapOptions::PAGE_BYTES;
+  int maxPages = HeapOptions::MAX_PAGES;
+  int initialPages = min(heapOptions.initialPages + memoPages, maxPages);
+  int maximumPages = min(heapOptions.maximumPages + memoPages, maxPages);
+
   BinaryenSetMemory(
     module,
-    1, // IMPORTANT: Memory size is dictated in pages, NOT bytes, where each page is 64k
-    10,
-    "memory", // TODO: We don't actually want to export this -- just for now
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    0,
+    initialPages, // IMPORTANT: Memory size is dictated in pages, NOT bytes, where each page is 64k
+    maximumPages,
+    "memory", // The runtime reads the collector's counters out of memory after a program runs
+    segmentNames.data(),
+    segmentDatas.data(),
+    segmentPassives,
+    segmentOffsets.data(),
+    segmentSizes.data(),
+    dictionaryLayoutSegments.size(),
     false,
     false,
     MEMORY_NAME.c_str()
   );
-  
-  BinaryenAddTable(
+
+  delete[] segmentPassives;
+
+  if (CompileStats *stats = Compiler::getInstance().getCompileStats()) {
+    size_t dataBytes = 0;
+    for (auto &segment : dictionaryLayoutSegments) dataBytes += segment.second.size();
+
+    stats->setLinearMemory(static_cast<size_t>(initialPages) * HeapOptions::PAGE_BYTES, static_cast<size_t>(maximumPages) * HeapOptions::PAGE_BYTES, dataBytes);
+  }
+
+  // Globals can't be redefined in place, so the core module's default ratio is swapped out for the configured one
+  BinaryenRemoveGlobal(module, GC_COLLECTION_RATIO.c_str());
+  BinaryenAddGlobal(
     module,
-    STRINGREF_TABLE.c_str(),
-    1000,
-    100000000,
-    BinaryenTypeStringref()
+    GC_COLLECTION_RATIO.c_str(),
+    BinaryenTypeInt32(),
+    false,
+    BinaryenConst(module, BinaryenLiteralInt32(heapOptions.collectionThreshold))
   );
 
-  StandardLibrary::registerFunctions(module);
+  if (memoPages > 0) {
+    BinaryenRemoveGlobal(module, GC_HEAP_START.c_str());
+    BinaryenAddGlobal(
+      module,
+      GC_HEAP_START.c_str(),
+      BinaryenTypeInt32(),
+      false,
+      BinaryenConst(module, BinaryenLiteralInt32(MEMO_TABLES_START + memoPages * HeapOptions::PAGE_BYTES))
+    );
+  }
 
-  return module;
+  if (!heapOptions.isTimingCollections) return;
+
+  // Calls to the core module's clock are by name, so they go to the host's once it takes its place
+  BinaryenRemoveFunction(module, GC_NOW_FN.c_str());
+  BinaryenAddFunctionImport(module, GC_NOW_FN.c_str(), "theta", "now", BinaryenTypeNone(), BinaryenTypeInt64());
 }
 
 BinaryenExpressionRef CodeGen::generate(shared_ptr<ASTNode> node, BinaryenModuleRef &module) {
+  BinaryenExpressionRef expression = generateNode(node, module);
+
+  if (expression && !debugInfoFile.empty() && node->getLine() > 0) {
+    debugLocations.push_back({ expression, node->getLine(), node->getColumn() });
+  }
+
+  return expression;
+}
+
+void CodeGen::addDebugLocations(BinaryenFunctionRef fn, const vector<DebugLocation> &locations) {
+  if (debugInfoFile.empty()) return;
+
+  for (const DebugLocation &location : locations) {
+    // Source maps count columns from 0, the lexer counts them from 1
+    BinaryenFunctionSetDebugLocation(fn, location.expression, debugInfoFileIndex, location.line, location.column - 1);
+  }
+}
+
+BinaryenExpressionRef CodeGen::generateNode(shared_ptr<ASTNode> node, BinaryenModuleRef &module) {
   if (node->hasOwnScope()) {
     scope.enterScope();
     scopeReferences.enterScope();
   }
 
-  if (node->getNodeType() == ASTNode::SOURCE) {
-    generateSource(dynamic_pointer_cast<SourceNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::CAPSULE) {
-    generateCapsule(dynamic_pointer_cast<CapsuleNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::ASSIGNMENT) {
-    return generateAssignment(dynamic_pointer_cast<AssignmentNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::BLOCK) {
-    return generateBlock(dynamic_pointer_cast<ASTNodeList>(node), module);
-  } else if (node->getNodeType() == Theta::ASTNode::RETURN) {
-    return generateReturn(dynamic_pointer_cast<ReturnNode>(node), module); 
-  } else if (node->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
-    // The only time we should get here is if we have a function defined inside a function,
-    // because the normal function declaration flow goes through the generateAssignment flow
-    return generateClosureFunctionDeclaration(dynamic_pointer_cast<FunctionDeclarationNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
-    return generateFunctionInvocation(dynamic_pointer_cast<FunctionInvocationNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::CONTROL_FLOW) {
-    return generateControlFlow(dynamic_pointer_cast<ControlFlowNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::IDENTIFIER) {
-    return generateIdentifier(dynamic_pointer_cast<IdentifierNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::BINARY_OPERATION) {
-    return generateBinaryOperation(dynamic_pointer_cast<BinaryOperationNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::UNARY_OPERATION) {
-    return generateUnaryOperation(dynamic_pointer_cast<UnaryOperationNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::NUMBER_LITERAL) {
-    return generateNumberLiteral(dynamic_pointer_cast<LiteralNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::STRING_LITERAL) {
-    return generateStringLiteral(dynamic_pointer_cast<LiteralNode>(node), module);
-  } else if (node->getNodeType() == ASTNode::BOOLEAN_LITERAL) {
-    return generateBooleanLiteral(dynamic_pointer_cast<LiteralNode>(node), module);
-  }
+  BinaryenExpressionRef expression = visit(node, module);
 
-  if (node->hasOwnScope()) {
+  // Blocks return without exiting their scope, so only a capsule's is exited here
+  if (node->hasOwnScope() && node->getNodeType() != ASTNode::BLOCK) {
     scope.exitScope();
     scopeReferences.exitScope();
   }
 
-  return nullptr;
+  return expression;
 }
 
 void CodeGen::generateCapsule(shared_ptr<CapsuleNode> capsuleNode, BinaryenModuleRef &module) {
@@ -132,18 +219,16 @@ void CodeGen::generateCapsule(shared_ptr<CapsuleNode> capsuleNode, BinaryenModul
 
   hoistCapsuleElements(capsuleElements);
 
+  // Values are generated first, since the functions are generated by copies of this CodeGen that need them in scope
+  vector<shared_ptr<ASTNode>> functions;
+
   for (auto elem : capsuleElements) {
     string elemType = dynamic_pointer_cast<TypeDeclarationNode>(elem->getResolvedType())->getType();
     if (elem->getNodeType() == ASTNode::ASSIGNMENT) {
       string identifier = dynamic_pointer_cast<IdentifierNode>(elem->getLeft())->getIdentifier();
 
       if (elemType == DataTypes::FUNCTION) {
-        generateFunctionDeclaration(
-          identifier,
-          dynamic_pointer_cast<FunctionDeclarationNode>(elem->getRight()),
-          module,
-          true
-        );
+        functions.push_back(elem);
       } else {
         shared_ptr<ASTNode> assignmentRhs = elem->getRight();
         assignmentRhs->setMappedBinaryenIndex(-1); //Index of -1 means its a global
@@ -157,6 +242,162 @@ void CodeGen::generateCapsule(shared_ptr<CapsuleNode> capsuleNode, BinaryenModul
       }
     }
   }
+
+  generateCapsuleFunctions(functions, module);
+}
+
+void CodeGen::generateCapsuleFunctions(const vector<shared_ptr<ASTNode>> &functions, BinaryenModuleRef &module) {
+  Compiler &compiler = Compiler::getInstance();
+  ThreadPool &workerPool = compiler.getWorkerPool();
+
+  // Each task generates a run of functions that are declared next to each other
+  size_t taskCount = min(functions.size(), (workerPool.getThreadCount() + 1) * TASKS_PER_THREAD);
+  auto firstFunction = [&functions, taskCount](size_t task) { return task * functions.size() / taskCount; };
+
+  vector<CodeGen> generators(taskCount, *this);
+  vector<string> generatedNames(functions.size());
+  vector<shared_future<void>> tasks;
+
+  for (size_t task = 0; task < taskCount; task++) {
+    CodeGen &generator = generators[task];
+    generator.capsuleReferences.clear();
+    generator.debugLocations.clear();
+
+    size_t first = firstFunction(task);
+    size_t last = firstFunction(task + 1);
+
+    tasks.push_back(workerPool.submit([&compiler, &generator, &functions, &generatedNames, first, last, module]() mutable {
+      Compiler::ActiveScope activeScope(&compiler);
+
+      for (size_t i = first; i < last; i++) {
+        generatedNames[i] = generator.generateFunctionDeclaration(
+          dynamic_pointer_cast<IdentifierNode>(functions[i]->getLeft())->getIdentifier(),
+          dynamic_pointer_cast<FunctionDeclarationNode>(functions[i]->getRight()),
+          module
+        );
+      }
+    }));
+  }
+
+  // The generators are only safe to throw away once every task is done with them, even if one of them failed
+  exception_ptr error;
+  for (shared_future<void> &task : tasks) {
+    try {
+      workerPool.await(task);
+    } catch (...) {
+      if (!error) error = current_exception();
+    }
+  }
+
+  if (error) rethrow_exception(error);
+
+  addReferences(*this, capsuleReferences, "main", module);
+  capsuleReferences.clear();
+
+  const set<string> &exports = compiler.getExports();
+
+  for (size_t task = 0; task < taskCount; task++) {
+    for (size_t i = firstFunction(task); i < firstFunction(task + 1); i++) {
+      string identifier = dynamic_pointer_cast<IdentifierNode>(functions[i]->getLeft())->getIdentifier();
+      shared_ptr<FunctionDeclarationNode> fnDeclNode = dynamic_pointer_cast<FunctionDeclarationNode>(functions[i]->getRight());
+      string functionName = Compiler::getQualifiedFunctionIdentifier(identifier, dynamic_pointer_cast<ASTNode>(fnDeclNode));
+
+      addGeneratedFunction(generators[task], generatedNames[i], module);
+
+      if (fnDeclNode->getIsMemoized()) {
+        const GeneratedFunction &uncached = generators[task].generatedFunctions.at(generatedNames[i]);
+        generateMemoizedFunction(functionName, generatedNames[i], uncached.paramTypes, uncached.returnType, module);
+      }
+
+      bool isExported = !SpecializationPass::isSpecialization(identifier) &&
+        (exports.empty() || exports.find(identifier) != exports.end());
+
+      if (isExported) {
+        BinaryenAddFunctionExport(module, functionName.c_str(), functionName.c_str());
+        exportResultTypes.push_back(make_pair(functionName, TypeChecker::getFunctionReturnType(fnDeclNode)));
+      }
+    }
+  }
+}
+
+void CodeGen::keepGeneratedFunction(
+  const string &name,
+  BinaryenType paramType,
+  vector<BinaryenType> localTypes,
+  BinaryenExpressionRef body,
+  size_t firstDebugLocation
+) {
+  GeneratedFunction function;
+  function.enclosingName = currentFunction->name;
+  function.paramType = paramType;
+  function.paramTypes = currentFunction->paramTypes;
+  function.returnType = currentFunction->returnType;
+  function.localTypes = std::move(localTypes);
+  function.body = body;
+  function.debugLocations.assign(debugLocations.begin() + firstDebugLocation, debugLocations.end());
+  function.references = std::move(currentFunction->references);
+
+  debugLocations.resize(firstDebugLocation);
+  generatedFunctions.insert(make_pair(name, std::move(function)));
+}
+
+void CodeGen::addReference(Reference reference) {
+  if (currentFunction) {
+    currentFunction->references.push_back(std::move(reference));
+  } else {
+    capsuleReferences.push_back(std::move(reference));
+  }
+}
+
+void CodeGen::addGeneratedFunction(CodeGen &generator, const string &name, BinaryenModuleRef &module) {
+  if (!addedFunctions.insert(name).second) return;
+
+  const GeneratedFunction &function = generator.generatedFunctions.at(name);
+
+  addReferences(generator, function.references, function.enclosingName, module);
+
+  BinaryenFunctionRef fn = BinaryenAddFunction(
+    module,
+    name.c_str(),
+    function.paramType,
+    function.returnType,
+    const_cast<BinaryenType*>(function.localTypes.data()),
+    function.localTypes.size(),
+    function.body
+  );
+
+  addDebugLocations(fn, function.debugLocations);
+}
+
+void CodeGen::addReferences(
+  CodeGen &generator,
+  const vector<Reference> &references,
+  const string &enclosingName,
+  BinaryenModuleRef &module
+) {
+  for (const Reference &reference : references) {
+    if (reference.kind == Reference::FUNCTION) {
+      addGeneratedFunction(generator, reference.name, module);
+    } else if (reference.kind == Reference::LAMBDA) {
+      // Named before the lambda is added, so the lambdas declared in it are named after it
+      auto lifted = liftedFunctionNames.find(enclosingName);
+      string enclosingDisplayName = lifted != liftedFunctionNames.end() ? lifted->second : enclosingName;
+
+      liftedFunctionNames.insert(make_pair(reference.name, enclosingDisplayName + "/" + reference.text));
+      addGeneratedFunction(generator, reference.name, module);
+    } else if (reference.kind == Reference::TABLE_SLOT) {
+      BinaryenConstSetValueI32(reference.expression, getTableSlot(reference.name));
+    } else if (reference.kind == Reference::STRING_LITERAL) {
+      BinaryenGlobalGetSetName(reference.expression, getStringLiteralGlobal(reference.text, module).c_str());
+    } else if (reference.kind == Reference::DICTIONARY_LAYOUT) {
+      string segmentName = DICT_LAYOUT_SEGMENT_PREFIX + to_string(dictionaryLayoutSegments.size());
+      dictionaryLayoutSegments.push_back(make_pair(segmentName, reference.text));
+
+      BinaryenMemoryInitSetSegment(reference.expression, segmentName.c_str());
+    } else if (reference.kind == Reference::HOST_FUNCTION) {
+      addHostFunctionImport(Compiler::getInstance().getHostFunctions().at(reference.name), module);
+    }
+  }
 }
 
 BinaryenExpressionRef CodeGen::generateAssignment(shared_ptr<AssignmentNode> assignmentNode, BinaryenModuleRef &module) {
@@ -200,16 +441,20 @@ BinaryenExpressionRef CodeGen::generateAssignment(shared_ptr<AssignmentNode> ass
     // just return the value
     if (isLastInBlock) return generate(assignmentRhs, module);
 
-    return BinaryenLocalSet(module, idxOfAssignment, generate(assignmentRhs, module));
+    if (assignmentRhs->getNodeType() == ASTNode::STRUCT_DECLARATION && canScalarReplace(assignmentNode)) {
+      return generateScalarReplacedStruct(identName, dynamic_pointer_cast<StructDeclarationNode>(assignmentRhs), module);
+    }
+
+    return generateLocalSet(idxOfAssignment, generate(assignmentRhs, module), isHeapReference(rhsResolvedType), module);
   }
 
   return generateClosureFunctionDeclaration(
     dynamic_pointer_cast<FunctionDeclarationNode>(assignmentNode->getRight()),
     module,
-    [module, idxOfAssignment, isLastInBlock](const BinaryenExpressionRef &addressRefExpression) {
+    [this, &module, idxOfAssignment, isLastInBlock](const BinaryenExpressionRef &addressRefExpression) {
       if (isLastInBlock) return addressRefExpression;
 
-      return BinaryenLocalSet(module, idxOfAssignment, addressRefExpression);
+      return generateLocalSet(idxOfAssignment, addressRefExpression, true, module);
     },
     make_optional(make_pair(assignmentIdentifier, idxOfAssignment))
   );
@@ -223,21 +468,26 @@ BinaryenExpressionRef CodeGen::generateClosureFunctionDeclaration(
 ) {
   shared_ptr<FunctionDeclarationNode> simplifiedDeclaration = liftLambda(function, module);
 
-  // Generating a unique hash for this function is necessary because it will be stored on the module globally,
-  // so we need to make sure there are no naming collisions
-  string simplifiedDeclarationHash = generateFunctionHash(simplifiedDeclaration);
+  // The function is stored on the module globally, so it's named by its structural hash. Lambdas that are the same up
+  // to renaming share the one function, and each binds its own captured values into its closure below
+  bool isNew;
+  string simplifiedDeclarationHash = getLiftedFunctionName(simplifiedDeclaration, isNew);
 
-  generateFunctionDeclaration(
-    simplifiedDeclarationHash,
-    simplifiedDeclaration,
-    module
-  );
+  if (isNew) generateFunctionDeclaration(simplifiedDeclarationHash, simplifiedDeclaration, module);
 
   string globalQualifiedFunctionName = Compiler::getQualifiedFunctionIdentifier(
     simplifiedDeclarationHash,
     simplifiedDeclaration
   );
 
+  // Profiles name the lambda after where it was first declared
+  addReference({
+    Reference::LAMBDA,
+    globalQualifiedFunctionName,
+    assignmentIdentifierPair ? assignmentIdentifierPair->first : "lambda@" + to_string(function->getLine()),
+    nullptr
+  });
+
   // If an assignmentIdentifier was passed in, this function is being assigned to a variable.
   // We need to add some items to the scope to make the function available elsewhere
   if (assignmentIdentifierPair) {
@@ -259,56 +509,58 @@ BinaryenExpressionRef CodeGen::generateClosureFunctionDeclaration(
     scopeReferences.insert(assignmentIdentifierPair->first, globalQualifiedFunctionName);
   }
 
-  pair<WasmClosure, vector<BinaryenExpressionRef>> storage = generateAndStoreClosure(
+  BinaryenExpressionRef addressRefExpression = generateAndStoreClosure(
     globalQualifiedFunctionName,
     simplifiedDeclaration,
     function,
     module
   );
 
-  vector<BinaryenExpressionRef> expressions = storage.second;
-
-  BinaryenExpressionRef addressRefExpression = BinaryenConst(
-    module,
-    BinaryenLiteralInt32(storage.first.getPointer().getAddress())
-  );
+  // Returns a reference to the closure memory address
+  return returnValueFormatter(addressRefExpression);
+}
 
-  BinaryenExpressionRef returnedValueExpression = returnValueFormatter(addressRefExpression);
+string CodeGen::getLiftedFunctionName(shared_ptr<FunctionDeclarationNode> function, bool &isNew) {
+  uint64_t hash = structuralHasher.getFunctionHash(function);
+  int index = 0;
 
-  // Returns a reference to the closure memory address
-  expressions.push_back(returnedValueExpression);
+  {
+    lock_guard<mutex> lock(sharedNames->namesMutex);
+    vector<shared_ptr<FunctionDeclarationNode>> &lifted = sharedNames->liftedFunctions[hash];
 
-  BinaryenExpressionRef* blockExpressions = new BinaryenExpressionRef[expressions.size()];
-  for (int i = 0; i < expressions.size(); i++) {
-    blockExpressions[i] = expressions.at(i);
+    // Which lambda of a collision is lifted first depends on which thread gets there first, so the rare lambdas whose
+    // hashes collide aren't always named the same
+    while (index < lifted.size() && !StructuralHasher::isAlphaEquivalent(lifted[index], function)) index++;
+    if (index == lifted.size()) lifted.push_back(function);
   }
 
-  return BinaryenBlock(
-    module,
-    NULL,
-    blockExpressions,
-    expressions.size(),
-    BinaryenTypeInt32()
-  );
+  ostringstream stream;
+  stream << hex << nouppercase << setw(sizeof(uint64_t) * 2) << setfill('0') << hash;
+
+  // Lambdas whose hashes collide without being equivalent still need their own functions
+  if (index > 0) stream << "." << dec << index;
+
+  isNew = generatedLambdas.insert(stream.str()).second;
+
+  return stream.str();
 }
 
-pair<WasmClosure, vector<BinaryenExpressionRef>> CodeGen::generateAndStoreClosure(
+BinaryenExpressionRef CodeGen::generateAndStoreClosure(
   string qualifiedReferenceFunctionName,
   shared_ptr<FunctionDeclarationNode> simplifiedReference,
   shared_ptr<FunctionDeclarationNode> originalReference,
   BinaryenModuleRef &module
 ) {
-  Pointer referencePtr = functionNameToClosureTemplateMap.find(qualifiedReferenceFunctionName)->second.getFunctionPointer();
   set<string> originalParameters;
 
   for (auto param : originalReference->getParameters()->getElements()) {
     originalParameters.insert(dynamic_pointer_cast<IdentifierNode>(param)->getIdentifier());
   }
 
-  vector<BinaryenExpressionRef> expressions;
-  vector<Pointer<PointerType::Data>> argPointers; 
+  vector<Operand> boundArgs;
+  vector<shared_ptr<TypeDeclarationNode>> boundArgTypes;
 
-  // Store the args into memory
+  // Bind the values of the enclosing scope the closure needs as its first arguments
   for (auto param : simplifiedReference->getParameters()->getElements()) {
     string paramName = dynamic_pointer_cast<IdentifierNode>(param)->getIdentifier();
 
@@ -317,54 +569,28 @@ pair<WasmClosure, vector<BinaryenExpressionRef>> CodeGen::generateAndStoreClosur
     shared_ptr<ASTNode> paramValue = scope.lookup(paramName).value();
     shared_ptr<TypeDeclarationNode> paramType = dynamic_pointer_cast<TypeDeclarationNode>(param->getValue());
 
-    BinaryenExpressionRef generatedValue = generate(paramValue, module);
-    if (paramType->getType() == DataTypes::STRING) {
-      expressions.push_back(
-        BinaryenTableSet(
-          module,
-          STRINGREF_TABLE.c_str(),
-          BinaryenConst(module, BinaryenLiteralInt32(stringRefOffset)),
-          generatedValue
-        )
-      );
-
-      argPointers.push_back(Pointer<PointerType::Data>(stringRefOffset));
-
-      stringRefOffset += 1;
-    } else {
-      int byteSize = getByteSizeForType(paramType);
-
-      expressions.push_back(
-        BinaryenStore(
-          module,
-          byteSize,
-          0,
-          0,
-          BinaryenConst(module, BinaryenLiteralInt32(memoryOffset)),
-          generatedValue,
-          getBinaryenStorageTypeFromTypeDeclaration(paramType),
-          MEMORY_NAME.c_str()
-        )
-      );
-      
-      argPointers.push_back(Pointer<PointerType::Data>(memoryOffset));
-  
-      memoryOffset += byteSize;
-    }
+    boundArgs.push_back({
+      paramValue,
+      nullptr,
+      getBinaryenTypeFromTypeDeclaration(paramType),
+      isHeapReference(paramType),
+      canCollect(paramValue)
+    });
+    boundArgTypes.push_back(paramType);
   }
 
-  WasmClosure closure = WasmClosure(
-    referencePtr,
-    simplifiedReference->getParameters()->getElements().size(),
-    argPointers
-  );
-
-  // Store a closure pointing to the args that were stored in memory
-  vector<BinaryenExpressionRef> storageExpressions = generateClosureMemoryStore(closure, module);
+  vector<BinaryenExpressionRef> expressions;
+  vector<BinaryenExpressionRef> boundArgExpressions = generateOperands(boundArgs, true, expressions, module);
 
-  copy(storageExpressions.begin(), storageExpressions.end(), back_inserter(expressions));
+  expressions.push_back(generateClosureAllocation(
+    qualifiedReferenceFunctionName,
+    simplifiedReference->getParameters()->getElements().size(),
+    boundArgExpressions,
+    boundArgTypes,
+    module
+  ));
 
-  return make_pair(closure, expressions);
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeInt32());
 }
 
 // Transforms nested function declarations and generates an anonymous function in the function table
@@ -423,10 +649,9 @@ shared_ptr<FunctionDeclarationNode> CodeGen::liftLambda(
   );
 
   shared_ptr<FunctionDeclarationNode> simplifiedDeclaration = make_shared<FunctionDeclarationNode>(nullptr);
-  simplifiedDeclaration->setResolvedType(Compiler::deepCopyTypeDeclaration(
-    dynamic_pointer_cast<TypeDeclarationNode>(fnDeclNode->getResolvedType()), 
-    simplifiedDeclaration
-  ));
+  simplifiedDeclaration->setResolvedType(
+    TypeInterner::getInstance().intern(dynamic_pointer_cast<TypeDeclarationNode>(fnDeclNode->getResolvedType()))
+  );
 
   shared_ptr<ASTNodeList> parametersNode = make_shared<ASTNodeList>(simplifiedDeclaration);
   parametersNode->setElements(simplifiedDeclarationParameters);
@@ -509,11 +734,10 @@ void CodeGen::collectClosureScope(
   collectClosureScope(node->getParent(), identifiersToFind, parameters, bodyExpressions);
 }
 
-void CodeGen::generateFunctionDeclaration(
+string CodeGen::generateFunctionDeclaration(
   string identifier,
   shared_ptr<FunctionDeclarationNode> fnDeclNode,
-  BinaryenModuleRef &module,
-  bool addToExports
+  BinaryenModuleRef &module
 ) {
   scope.enterScope();
   scopeReferences.enterScope();
@@ -522,6 +746,8 @@ void CodeGen::generateFunctionDeclaration(
 
   scope.insert(LOCAL_IDX_SCOPE_KEY, make_shared<LiteralNode>(ASTNode::NUMBER_LITERAL, to_string(totalParams), nullptr));
 
+  vector<BinaryenType> paramTypes;
+
   if (totalParams > 0) {
     BinaryenType* types = new BinaryenType[totalParams];
 
@@ -534,6 +760,8 @@ void CodeGen::generateFunctionDeclaration(
       types[i] = getBinaryenTypeFromTypeDeclaration(
         dynamic_pointer_cast<TypeDeclarationNode>(fnDeclNode->getParameters()->getElements().at(i)->getValue())
       );
+
+      paramTypes.push_back(types[i]);
     }
 
     parameterType = BinaryenTypeCreate(types, totalParams);
@@ -541,11 +769,22 @@ void CodeGen::generateFunctionDeclaration(
 
   vector<shared_ptr<ASTNode>> localVariables = Compiler::findAllInTree(fnDeclNode->getDefinition(), ASTNode::ASSIGNMENT);
 
-  BinaryenType* localVariableTypes = new BinaryenType[localVariables.size()];
+  // Parameters and locals holding heap references are kept in the function's frame on the shadow stack, so the
+  // collector can find and move what they point to
+  vector<BinaryenIndex> heapLocals;
+  for (int i = 0; i < totalParams; i++) {
+    if (isHeapReference(dynamic_pointer_cast<TypeDeclarationNode>(fnDeclNode->getParameters()->getElements().at(i)->getValue()))) {
+      heapLocals.push_back(i);
+    }
+  }
+
+  vector<BinaryenType> localVariableTypes;
   for (int i = 0; i < localVariables.size(); i++) {
-    localVariableTypes[i] = getBinaryenTypeFromTypeDeclaration(
-      dynamic_pointer_cast<TypeDeclarationNode>(localVariables.at(i)->getResolvedType())
-    );
+    shared_ptr<TypeDeclarationNode> localType = dynamic_pointer_cast<TypeDeclarationNode>(localVariables.at(i)->getResolvedType());
+
+    localVariableTypes.push_back(getBinaryenTypeFromTypeDeclaration(localType));
+
+    if (isHeapReference(localType)) heapLocals.push_back(totalParams + i);
   }
 
   string functionName = Compiler::getQualifiedFunctionIdentifier(
@@ -553,15 +792,25 @@ void CodeGen::generateFunctionDeclaration(
     dynamic_pointer_cast<ASTNode>(fnDeclNode)
   );
 
-  BinaryenFunctionRef fn = BinaryenAddFunction(
-    module,
-    functionName.c_str(),
-    parameterType,
-    getBinaryenTypeFromTypeDeclaration(TypeChecker::getFunctionReturnType(fnDeclNode)),
-    localVariableTypes,
-    localVariables.size(),
-    generate(fnDeclNode->getDefinition(), module)
-  );
+  BinaryenType returnType = getBinaryenTypeFromTypeDeclaration(TypeChecker::getFunctionReturnType(fnDeclNode));
+
+  size_t firstDebugLocation = debugLocations.size();
+
+  // Closures declared in the body get generated while we're in it, so the enclosing function needs to be restored after
+  optional<FunctionContext> enclosingFunction = currentFunction;
+  enterFunction(functionName, returnType, paramTypes, totalParams + localVariables.size(), heapLocals);
+
+  BinaryenExpressionRef body = generateFunctionFrame(generate(fnDeclNode->getDefinition(), module), module);
+
+  vector<BinaryenType> addedLocalTypes = getAddedLocalTypes();
+  localVariableTypes.insert(localVariableTypes.end(), addedLocalTypes.begin(), addedLocalTypes.end());
+
+  // A memoized function is called through its lookup, which is generated under its name instead
+  string generatedName = fnDeclNode->getIsMemoized() ? functionName + MEMO_UNCACHED_SUFFIX : functionName;
+
+  keepGeneratedFunction(generatedName, parameterType, std::move(localVariableTypes), body, firstDebugLocation);
+
+  currentFunction = enclosingFunction;
 
   // Only add to the closure template map if its not already in there. It may have been added during hoisting
   if (functionNameToClosureTemplateMap.find(functionName) == functionNameToClosureTemplateMap.end()) {
@@ -574,12 +823,111 @@ void CodeGen::generateFunctionDeclaration(
     ));
   }
 
-  if (addToExports) {
-    BinaryenAddFunctionExport(module, functionName.c_str(), functionName.c_str());
-  }
-
   scope.exitScope();
   scopeReferences.exitScope();
+
+  return generatedName;
+}
+
+void CodeGen::generateMemoizedFunction(
+  string functionName,
+  string uncachedName,
+  vector<BinaryenType> paramTypes,
+  BinaryenType returnType,
+  BinaryenModuleRef &module
+) {
+  int arity = paramTypes.size();
+  int table = MEMO_TABLES_START + memoTablesSize;
+
+  // The arguments being looked up, then the entries, each a word of flags, the arguments and the result
+  memoTablesSize += arity * 8 + MEMO_TABLE_CAPACITY * (16 + arity * 8);
+
+  BinaryenIndex entryLocal = arity;
+  BinaryenIndex resultLocal = arity + 1;
+
+  // Tables hold every argument and result as an i64
+  auto toSlot = [&](BinaryenExpressionRef value, BinaryenType type) {
+    return type == BinaryenTypeInt64() ? value : BinaryenUnary(module, BinaryenExtendUInt32(), value);
+  };
+
+  auto memoCall = [&](const string &fn, vector<BinaryenExpressionRef> extraOperands, BinaryenType type) {
+    vector<BinaryenExpressionRef> operands = {
+      BinaryenConst(module, BinaryenLiteralInt32(table)),
+      BinaryenConst(module, BinaryenLiteralInt32(arity)),
+      BinaryenConst(module, BinaryenLiteralInt32(MEMO_TABLE_CAPACITY))
+    };
+    operands.insert(operands.end(), extraOperands.begin(), extraOperands.end());
+
+    return BinaryenCall(module, fn.c_str(), operands.data(), operands.size(), type);
+  };
+
+  vector<BinaryenExpressionRef> arguments;
+  for (int i = 0; i < arity; i++) arguments.push_back(BinaryenLocalGet(module, i, paramTypes[i]));
+
+  // The core module's functions read the arguments from the start of the table
+  auto generateArgumentStores = [&](vector<BinaryenExpressionRef> &expressions) {
+    for (int i = 0; i < arity; i++) {
+      expressions.push_back(BinaryenStore(
+        module,
+        8,
+        i * 8,
+        0,
+        BinaryenConst(module, BinaryenLiteralInt32(table)),
+        toSlot(BinaryenLocalGet(module, i, paramTypes[i]), paramTypes[i]),
+        BinaryenTypeInt64(),
+        MEMORY_NAME.c_str()
+      ));
+    }
+  };
+
+  vector<BinaryenExpressionRef> expressions;
+  generateArgumentStores(expressions);
+
+  expressions.push_back(BinaryenLocalSet(module, entryLocal, memoCall(MEMO_FIND_FN, {}, BinaryenTypeInt32())));
+
+  BinaryenExpressionRef storedResult = BinaryenLoad(
+    module,
+    8,
+    false,
+    0,
+    0,
+    BinaryenTypeInt64(),
+    BinaryenLocalGet(module, entryLocal, BinaryenTypeInt32()),
+    MEMORY_NAME.c_str()
+  );
+
+  if (returnType != BinaryenTypeInt64()) storedResult = BinaryenUnary(module, BinaryenWrapInt64(), storedResult);
+
+  expressions.push_back(BinaryenIf(
+    module,
+    BinaryenLocalGet(module, entryLocal, BinaryenTypeInt32()),
+    BinaryenReturn(module, storedResult),
+    NULL
+  ));
+
+  expressions.push_back(BinaryenLocalSet(
+    module,
+    resultLocal,
+    BinaryenCall(module, uncachedName.c_str(), arguments.data(), arguments.size(), returnType)
+  ));
+
+  // The call may have looked other arguments up in the same table, so they are written again
+  generateArgumentStores(expressions);
+
+  expressions.push_back(memoCall(MEMO_STORE_FN, { toSlot(BinaryenLocalGet(module, resultLocal, returnType), returnType) }, BinaryenTypeNone()));
+  expressions.push_back(BinaryenLocalGet(module, resultLocal, returnType));
+
+  BinaryenType locals[] = { BinaryenTypeInt32(), returnType };
+
+  BinaryenAddFunction(
+    module,
+    functionName.c_str(),
+    BinaryenTypeCreate(paramTypes.data(), paramTypes.size()),
+    returnType,
+    locals,
+    2,
+    BinaryenBlock(module, NULL, expressions.data(), expressions.size(), returnType)
+  );
 }
 
 BinaryenExpressionRef CodeGen::generateBlock(shared_ptr<ASTNodeList> blockNode, BinaryenModuleRef &module) {
@@ -599,15 +947,58 @@ BinaryenExpressionRef CodeGen::generateBlock(shared_ptr<ASTNodeList> blockNode,
 }
 
 BinaryenExpressionRef CodeGen::generateReturn(shared_ptr<ReturnNode> returnNode, BinaryenModuleRef &module) {
-  return BinaryenReturn(module, generate(returnNode->getValue(), module));
+  return BinaryenReturn(module, generatePoppingFrame(generate(returnNode->getValue(), module), module));
 }
 
 BinaryenExpressionRef CodeGen::generateFunctionInvocation(shared_ptr<FunctionInvocationNode> funcInvNode, BinaryenModuleRef &module) {
   string funcInvIdentifier = dynamic_pointer_cast<IdentifierNode>(funcInvNode->getIdentifier())->getIdentifier();
 
-  string scopeLookupIdentifier = Compiler::getQualifiedFunctionIdentifier(funcInvIdentifier, funcInvNode);
+  vector<shared_ptr<ASTNode>> funcInvArgs = funcInvNode->getParameters()->getElements();
+  if (
+    ListIntrinsics::isListIntrinsic(funcInvIdentifier) &&
+    !funcInvArgs.empty() &&
+    dynamic_pointer_cast<TypeDeclarationNode>(funcInvArgs.at(0)->getResolvedType())->getType() == DataTypes::LIST
+  ) {
+    return generateListIntrinsic(funcInvNode, module);
+  }
+
+  if (
+    DictIntrinsics::isDictIntrinsic(funcInvIdentifier) &&
+    !funcInvArgs.empty() &&
+    dynamic_pointer_cast<TypeDeclarationNode>(funcInvArgs.at(0)->getResolvedType())->getType() == DataTypes::DICT
+  ) {
+    return generateDictIntrinsic(funcInvNode, module);
+  }
+
+  if (
+    StringIntrinsics::isStringIntrinsic(funcInvIdentifier) &&
+    !funcInvArgs.empty() &&
+    dynamic_pointer_cast<TypeDeclarationNode>(funcInvArgs.at(0)->getResolvedType())->getType() == DataTypes::STRING
+  ) {
+    return generateStringIntrinsic(funcInvNode, module);
+  }
+
+  if (
+    TupleIntrinsics::isTupleIntrinsic(funcInvIdentifier) &&
+    !funcInvArgs.empty() &&
+    dynamic_pointer_cast<TypeDeclarationNode>(funcInvArgs.at(0)->getResolvedType())->getType() == DataTypes::TUPLE
+  ) {
+    return generateTupleIntrinsic(funcInvNode, module);
+  }
+
+  if (
+    funcInvIdentifier == DictIntrinsics::GET &&
+    !funcInvArgs.empty() &&
+    TypeChecker::isStructType(dynamic_pointer_cast<TypeDeclarationNode>(funcInvArgs.at(0)->getResolvedType())->getType())
+  ) {
+    return generateStructFieldAccess(funcInvNode, module);
+  }
+
+  int funcInvId = Compiler::getQualifiedFunctionId(funcInvIdentifier, funcInvNode);
+  string funcInvName = SymbolInterner::getInstance().getName(funcInvId);
+  string scopeLookupIdentifier = funcInvName;
 
-  auto localReference = scopeReferences.lookup(scopeLookupIdentifier); 
+  auto localReference = scopeReferences.lookup(funcInvId);
   if (localReference) {
     scopeLookupIdentifier = localReference.value();
   }
@@ -615,12 +1006,15 @@ BinaryenExpressionRef CodeGen::generateFunctionInvocation(shared_ptr<FunctionInv
   auto foundLocalReference = scope.lookup(scopeLookupIdentifier);
 
   if (!foundLocalReference) {
+    const map<string, HostFunction> &hostFunctions = Compiler::getInstance().getHostFunctions();
+
+    auto hostFunction = hostFunctions.find(funcInvIdentifier);
+    if (hostFunction != hostFunctions.end()) return generateHostFunctionInvocation(funcInvNode, hostFunction->second, module);
+
     cout << "Could not find reference for function invocation" << endl;
     throw new runtime_error("Reference not found");
   }
 
-  string funcInvName = Compiler::getQualifiedFunctionIdentifier(funcInvIdentifier, funcInvNode);
-
   // If the calculated name isn't the same as the refIdentifier, we know
   // this is a reference to a function and must have a closure already
   // in memory
@@ -631,123 +1025,47 @@ BinaryenExpressionRef CodeGen::generateFunctionInvocation(shared_ptr<FunctionInv
   return generateCallIndirectForNewClosure(funcInvNode, foundLocalReference.value(), scopeLookupIdentifier, module);
 }
 
-vector<Pointer<PointerType::Data>> CodeGen::generateFunctionInvocationArgMemoryInsertions(
+BinaryenExpressionRef CodeGen::generateCallIndirectForExistingClosure(
   shared_ptr<FunctionInvocationNode> funcInvNode,
-  vector<BinaryenExpressionRef> &expressions,
-  BinaryenModuleRef &module,
-  string refIdentifier
+  shared_ptr<ASTNode> reference,
+  string refIdentifier,
+  BinaryenModuleRef &module
 ) {
-  vector<Pointer<PointerType::Data>> paramMemPointers;
+  vector<shared_ptr<ASTNode>> args = funcInvNode->getParameters()->getElements();
 
-  // Store each passed argument into memory
-  for (shared_ptr<ASTNode> arg : funcInvNode->getParameters()->getElements()) {
-    shared_ptr<TypeDeclarationNode> argType = dynamic_pointer_cast<TypeDeclarationNode>(arg->getResolvedType());
-
-    BinaryenExpressionRef generatedValue = generate(arg, module);
-    Pointer<PointerType::Data> addressToPopulate;
-    if (argType->getType() == DataTypes::STRING) {
-      addressToPopulate = Pointer<PointerType::Data>(stringRefOffset);
+  FunctionMetaData functionMetaData = (reference->getNodeType() == ASTNode::FUNCTION_INVOCATION
+    ? getDerivedFunctionMetaData(funcInvNode, dynamic_pointer_cast<FunctionInvocationNode>(reference))
+    : getFunctionMetaData(dynamic_pointer_cast<FunctionDeclarationNode>(reference))
+  );
 
-      stringRefOffset += 1;
+  // The closure already holds pointers to the arguments it was created with, and the arguments of this call come after
+  // them. Closures store their argument pointers last to first
+  vector<Operand> operands;
 
-      expressions.push_back(
-        BinaryenTableSet(
-          module,
-          STRINGREF_TABLE.c_str(),
-          BinaryenConst(module, BinaryenLiteralInt32(addressToPopulate.getAddress())),
-          generatedValue
-        )
-      );
-    } else {
-      addressToPopulate = Pointer<PointerType::Data>(memoryOffset);
-      int argByteSize = getByteSizeForType(argType);
+  for (int i = functionMetaData.getArity() - 1; i >= args.size(); i--) {
+    BinaryenType argType = functionMetaData.getParams()[functionMetaData.getArity() - 1 - i];
 
-      memoryOffset += argByteSize;
-
-      expressions.push_back(
-        BinaryenStore(
-          module,
-          argByteSize,
-          0,
-          0,
-          BinaryenConst(module, BinaryenLiteralInt32(addressToPopulate.getAddress())),
-          generatedValue,
-          getBinaryenStorageTypeFromTypeDeclaration(argType),
-          MEMORY_NAME.c_str()
-        )
-      );
-    }
-
-    paramMemPointers.push_back(addressToPopulate);
-
-    // If a refIdentifier was passed, that means we have an existing closure
-    // in memory that we want to populate.
-    if (refIdentifier != "") {
-      BinaryenExpressionRef closureArgs[2] = {
-        BinaryenLocalGet(
-          module,
-          scope.lookup(refIdentifier).value()->getMappedBinaryenIndex(),
-          BinaryenTypeInt32()
-        ),
-        BinaryenConst(module, BinaryenLiteralInt32(addressToPopulate.getAddress()))
-      };
-
-      expressions.push_back(
-        BinaryenCall(
-          module,
-          "Theta.Function.populateClosure",
-          closureArgs,
-          2,
-          BinaryenTypeNone()
-        )
-      );
-    }
-  }
-
-  return paramMemPointers;
-}
-
-BinaryenExpressionRef CodeGen::generateCallIndirectForExistingClosure(
-  shared_ptr<FunctionInvocationNode> funcInvNode,
-  shared_ptr<ASTNode> reference,
-  string refIdentifier,
-  BinaryenModuleRef &module
-) {
-  vector<BinaryenExpressionRef> expressions;
-
-  generateFunctionInvocationArgMemoryInsertions(funcInvNode, expressions, module, refIdentifier);
-
-  FunctionMetaData functionMetaData = (reference->getNodeType() == ASTNode::FUNCTION_INVOCATION
-    ? getDerivedFunctionMetaData(funcInvNode, dynamic_pointer_cast<FunctionInvocationNode>(reference))
-    : getFunctionMetaData(dynamic_pointer_cast<FunctionDeclarationNode>(reference))
-  );
-
-  BinaryenExpressionRef* loadArgsExpressions = new BinaryenExpressionRef[functionMetaData.getArity()];
-
-  for (int i = functionMetaData.getArity() - 1; i >= 0; i--) {
-    BinaryenType argType = functionMetaData.getParams()[i];
-
-    BinaryenExpressionRef loadArgPointerExpr = BinaryenLoad( // Loads the arg pointer
-      module,
-      4,
-      false, 
-      8 + i * 4,
-      0,
-      BinaryenTypeInt32(),
-      BinaryenLocalGet( //  The local thats storing the pointer to the closure
-        module,
-        scope.lookup(refIdentifier).value()->getMappedBinaryenIndex(),
-        BinaryenTypeInt32()
-      ),
-      MEMORY_NAME.c_str()
-    );
+    BinaryenExpressionRef loadArgPointerExpr = BinaryenLoad( // Loads the pointer to the cell holding the arg
+      module,
+      4,
+      false, 
+      8 + i * 4,
+      0,
+      BinaryenTypeInt32(),
+      BinaryenLocalGet( //  The local thats storing the pointer to the closure
+        module,
+        scope.lookup(refIdentifier).value()->getMappedBinaryenIndex(),
+        BinaryenTypeInt32()
+      ),
+      MEMORY_NAME.c_str()
+    );
 
     BinaryenExpressionRef loadArgExpression;
     if (argType == BinaryenTypeStringref()) {
       loadArgExpression = BinaryenTableGet(
         module,
         STRINGREF_TABLE.c_str(),
-        loadArgPointerExpr,
+        BinaryenLoad(module, 4, false, 0, 0, BinaryenTypeInt32(), loadArgPointerExpr, MEMORY_NAME.c_str()),
         BinaryenTypeStringref()
       );                 
     } else {
@@ -757,80 +1075,93 @@ BinaryenExpressionRef CodeGen::generateCallIndirectForExistingClosure(
         true,
         0,
         0,
-        (argType == BinaryenTypeStringref() ? BinaryenTypeInt32() : argType),
+        argType,
         loadArgPointerExpr,
         MEMORY_NAME.c_str()
       );
     }
 
-    loadArgsExpressions[functionMetaData.getArity() - 1 - i] = loadArgExpression;
+    // Only the Binaryen type is known here, so any i32 is taken to be a heap reference. A boolean never points into
+    // the heap, so the collector leaves it as it is
+    operands.push_back({ nullptr, loadArgExpression, argType, argType == BinaryenTypeInt32(), false });
   }
 
-  // In order for if statements to return a value in WASM, both branches must return the same concrete type.
-  // This is the value that will be returned by the else branch, should the if fail
-  BinaryenExpressionRef defaultReturnValue;
-  if (functionMetaData.getReturnType() == BinaryenTypeInt32()) {
-    defaultReturnValue = BinaryenConst(module, BinaryenLiteralInt32(-1));
-  } else if (functionMetaData.getReturnType() == BinaryenTypeInt64()) {
-    defaultReturnValue = BinaryenConst(module, BinaryenLiteralInt64(-1));
-  } else {
-    defaultReturnValue = BinaryenStringConst(module, "");
+  // Passing the new arguments straight to the function, rather than storing them into the closure and loading them
+  // back out, keeps results flowing through a pipeline of closures on the stack. It also leaves the closure as it was,
+  // so it can be called again
+  for (int i = 0; i < args.size(); i++) {
+    operands.push_back(makeOperand(args.at(i)));
   }
 
-  // If arity hits 0, we can call_indirect
-  expressions.push_back(
-    BinaryenIf(
+  bool isTailCall = (
+    currentFunction &&
+    functionMetaData.getReturnType() == currentFunction->returnType &&
+    isInTailPosition(funcInvNode)
+  );
+
+  vector<BinaryenExpressionRef> expressions;
+  vector<BinaryenExpressionRef> operandExpressions = generateOperands(operands, isTailCall, expressions, module);
+
+  BinaryenExpressionRef call = (isTailCall ? BinaryenReturnCallIndirect : BinaryenCallIndirect)(
+    module, 
+    FN_TABLE_NAME.c_str(), 
+    BinaryenLoad(
       module,
-      BinaryenUnary( // Check if the arity is equal to 0
+      4,
+      false,
+      0,
+      0,
+      BinaryenTypeInt32(),
+      BinaryenLocalGet(
         module,
-        BinaryenEqZInt32(),
-        BinaryenLoad(
-          module,
-          4, // Add 4 to the closure pointer address to get the arity address
-          false,
-          4,
-          0,
-          BinaryenTypeInt32(),
-          BinaryenLocalGet( //  The local thats storing the pointer to the function we want to call
-            module,
-            scope.lookup(refIdentifier).value()->getMappedBinaryenIndex(),
-            BinaryenTypeInt32()
-          ),
-          MEMORY_NAME.c_str()
-        )
+        scope.lookup(refIdentifier).value()->getMappedBinaryenIndex(),
+        BinaryenTypeInt32()
       ),
-      BinaryenCallIndirect( // If the above check is true, execute_indirect
-        module, 
-        FN_TABLE_NAME.c_str(), 
-        BinaryenLoad(
-          module,
-          4,
-          false,
-          0,
-          0,
-          BinaryenTypeInt32(),
-          BinaryenLocalGet(
-            module,
-            scope.lookup(refIdentifier).value()->getMappedBinaryenIndex(),
-            BinaryenTypeInt32()
-          ),
-          MEMORY_NAME.c_str()
-        ),
-        loadArgsExpressions,
-        functionMetaData.getArity(),
-        functionMetaData.getParamType(),
-        functionMetaData.getReturnType()
-      ),   
-      defaultReturnValue
-    )
+      MEMORY_NAME.c_str()
+    ),
+    operandExpressions.data(),
+    functionMetaData.getArity(),
+    functionMetaData.getParamType(),
+    functionMetaData.getReturnType()
   );
 
-  BinaryenExpressionRef* blockExpressions = new BinaryenExpressionRef[expressions.size()];
-  for (int i = 0; i < expressions.size(); i++) {
-    blockExpressions[i] = expressions.at(i);
+  // A tail call leaves the function, so its frame is popped first
+  if (isTailCall) {
+    BinaryenExpressionRef tailCallExpressions[] = { generateFramePop(module), call };
+
+    call = BinaryenBlock(module, NULL, tailCallExpressions, 2, BinaryenTypeUnreachable());
+  } else {
+    call = generateCollectingCall(call, module);
   }
 
-  return BinaryenBlock(module, NULL, blockExpressions, expressions.size(), functionMetaData.getReturnType());
+  // The type checker only accepts calls that pass every argument the closure is still missing, so a closure with any
+  // other arity means the generated code is wrong. Trap rather than hand back a made up result
+  expressions.push_back(BinaryenIf(
+    module,
+    BinaryenBinary( // Check if the arity is equal to the number of arguments passed
+      module,
+      BinaryenEqInt32(),
+      BinaryenLoad(
+        module,
+        4, // Add 4 to the closure pointer address to get the arity address
+        false,
+        4,
+        0,
+        BinaryenTypeInt32(),
+        BinaryenLocalGet( //  The local thats storing the pointer to the function we want to call
+          module,
+          scope.lookup(refIdentifier).value()->getMappedBinaryenIndex(),
+          BinaryenTypeInt32()
+        ),
+        MEMORY_NAME.c_str()
+      ),
+      BinaryenConst(module, BinaryenLiteralInt32(args.size()))
+    ),
+    call, // If the above check is true, execute_indirect
+    BinaryenUnreachable(module)
+  ));
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), functionMetaData.getReturnType());
 }
 
 BinaryenExpressionRef CodeGen::generateCallIndirectForNewClosure(
@@ -842,59 +1173,779 @@ BinaryenExpressionRef CodeGen::generateCallIndirectForNewClosure(
   WasmClosure closureTemplate = functionNameToClosureTemplateMap.find(refIdentifier)->second;
   vector<BinaryenExpressionRef> expressions;
 
-  // If we're at 0 arity we can go ahead and execute the function call
+  // When every argument is passed, the function we call is known statically and nothing can see the closure, so
+  // the call goes straight to the function, with the arguments on the stack. Only partially applied calls build a
+  // closure in memory, since that closure is the call's value
   if (funcInvNode->getParameters()->getElements().size() == closureTemplate.getArity()) {
-    BinaryenExpressionRef* operands = new BinaryenExpressionRef[closureTemplate.getArity()];
+    FunctionMetaData functionMetaData = getFunctionMetaData(
+      dynamic_pointer_cast<FunctionDeclarationNode>(ref)
+    );
 
-    for (int i = 0; i < closureTemplate.getArity(); i++) {
-      shared_ptr<TypeDeclarationNode> argType = dynamic_pointer_cast<TypeDeclarationNode>(
-        funcInvNode->getParameters()->getElements().at(i)->getResolvedType()
-      );
+    // A tail call can only reuse the caller's frame if it returns exactly what the caller does
+    bool isTailCall = (
+      currentFunction &&
+      functionMetaData.getReturnType() == currentFunction->returnType &&
+      isInTailPosition(funcInvNode)
+    );
 
-      operands[i] = generate(funcInvNode->getParameters()->getElements().at(i), module);
+    if (isTailCall && refIdentifier == currentFunction->name) {
+      return generateSelfTailCall(funcInvNode, module);
     }
 
-    FunctionMetaData functionMetaData = getFunctionMetaData(
-      dynamic_pointer_cast<FunctionDeclarationNode>(ref)
+    vector<Operand> operands;
+    for (auto arg : funcInvNode->getParameters()->getElements()) operands.push_back(makeOperand(arg));
+
+    vector<BinaryenExpressionRef> operandExpressions = generateOperands(operands, isTailCall, expressions, module);
+
+    // The closure template is keyed by the name the function was added to the module with
+    BinaryenExpressionRef call = (isTailCall ? BinaryenReturnCall : BinaryenCall)(
+      module,
+      refIdentifier.c_str(),
+      operandExpressions.data(),
+      functionMetaData.getArity(),
+      functionMetaData.getReturnType()
     );
 
-    expressions.push_back(
-      BinaryenCallIndirect(
+    // A tail call leaves the function, so its frame is popped first
+    if (isTailCall) {
+      expressions.push_back(generateFramePop(module));
+      expressions.push_back(call);
+    } else {
+      expressions.push_back(generateCollectingCall(call, module));
+    }
+  } else {
+    vector<Operand> operands;
+    vector<shared_ptr<TypeDeclarationNode>> argTypes;
+
+    for (auto arg : funcInvNode->getParameters()->getElements()) {
+      operands.push_back(makeOperand(arg));
+      argTypes.push_back(dynamic_pointer_cast<TypeDeclarationNode>(arg->getResolvedType()));
+    }
+
+    vector<BinaryenExpressionRef> operandExpressions = generateOperands(operands, true, expressions, module);
+
+    expressions.push_back(generateClosureAllocation(
+      refIdentifier,
+      closureTemplate.getArity(),
+      operandExpressions,
+      argTypes,
+      module
+    ));
+  }
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeAuto());
+}
+
+BinaryenExpressionRef CodeGen::generateListIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module) {
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  if (intrinsic == ListIntrinsics::LENGTH) {
+    return BinaryenUnary(
+      module,
+      BinaryenExtendUInt32(),
+      BinaryenLoad(module, 4, false, 0, 0, BinaryenTypeInt32(), generate(args.at(0), module), MEMORY_NAME.c_str())
+    );
+  }
+
+  if (intrinsic == ListIntrinsics::SUM) {
+    BinaryenExpressionRef list = generate(args.at(0), module);
+
+    return BinaryenCall(module, LIST_SUM_FN.c_str(), &list, 1, BinaryenTypeInt64());
+  }
+
+  shared_ptr<TypeDeclarationNode> listType = dynamic_pointer_cast<TypeDeclarationNode>(args.at(0)->getResolvedType());
+  shared_ptr<TypeDeclarationNode> functionType = dynamic_pointer_cast<TypeDeclarationNode>(args.at(1)->getResolvedType());
+  shared_ptr<TypeDeclarationNode> functionReturnType = dynamic_pointer_cast<TypeDeclarationNode>(
+    functionType->getValue() ? functionType->getValue() : functionType->getElements().back()
+  );
+
+  string functionName = Compiler::getQualifiedFunctionIdentifierFromTypeSignature(
+    dynamic_pointer_cast<IdentifierNode>(args.at(1))->getIdentifier(),
+    functionType
+  );
+
+  string helperName = addListIntrinsicFunction(
+    intrinsic,
+    functionName,
+    getBinaryenTypeFromTypeDeclaration(dynamic_pointer_cast<TypeDeclarationNode>(listType->getValue())),
+    getBinaryenTypeFromTypeDeclaration(functionReturnType),
+    module
+  );
+
+  vector<Operand> operands = { makeOperand(args.at(0)) };
+  if (intrinsic == ListIntrinsics::REDUCE) operands.push_back(makeOperand(args.at(2)));
+
+  vector<BinaryenExpressionRef> expressions;
+  vector<BinaryenExpressionRef> helperArgs = generateOperands(operands, false, expressions, module);
+
+  BinaryenType resultType = getBinaryenTypeFromTypeDeclaration(
+    dynamic_pointer_cast<TypeDeclarationNode>(node->getResolvedType())
+  );
+
+  // The function called for each element can collect, which moves whatever the caller holds on the heap
+  expressions.push_back(generateCollectingCall(
+    BinaryenCall(module, helperName.c_str(), helperArgs.data(), helperArgs.size(), resultType),
+    module
+  ));
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeAuto());
+}
+
+string CodeGen::addListIntrinsicFunction(
+  const string &intrinsic,
+  const string &functionName,
+  BinaryenType elementType,
+  BinaryenType resultType,
+  BinaryenModuleRef &module
+) {
+  string name = "Theta.List." + intrinsic + "." + functionName;
+  addReference({ Reference::FUNCTION, name, "", nullptr });
+
+  if (listIntrinsicFunctions.find(name) != listIntrinsicFunctions.end()) return name;
+
+  listIntrinsicFunctions.insert(name);
+
+  bool isReduce = intrinsic == ListIntrinsics::REDUCE;
+  int elementSize = getByteSizeForType(elementType);
+  int resultElementSize = intrinsic == ListIntrinsics::MAP ? getByteSizeForType(resultType) : elementSize;
+
+  // The list is the first parameter, followed by the accumulator of reduce
+  BinaryenIndex accumulatorParam = 1;
+  vector<BinaryenType> paramTypes = { BinaryenTypeInt32() };
+  if (isReduce) paramTypes.push_back(resultType);
+
+  BinaryenIndex frameLocal = paramTypes.size();
+  BinaryenIndex lengthLocal = frameLocal + 1;
+  BinaryenIndex indexLocal = frameLocal + 2;
+  BinaryenIndex resultLocal = frameLocal + 3;
+  BinaryenIndex valueLocal = frameLocal + 4;
+  BinaryenIndex keptLocal = frameLocal + 5;
+
+  vector<BinaryenType> localTypes = {
+    BinaryenTypeInt32(),
+    BinaryenTypeInt32(),
+    BinaryenTypeInt32(),
+    BinaryenTypeInt32(),
+    intrinsic == ListIntrinsics::MAP ? resultType : elementType,
+    BinaryenTypeInt32()
+  };
+
+  auto getLocal = [&module](BinaryenIndex index) { return BinaryenLocalGet(module, index, BinaryenTypeInt32()); };
+
+  // The lists are read out of the frame every time they're used, since the function called for each element can move
+  // them. The list being read is in the first slot, and the one being built in the second
+  auto loadFrameSlot = [this, &module, &getLocal, frameLocal](int slot) {
+    return BinaryenLoad(module, 4, false, slot * 4, 0, BinaryenTypeInt32(), getLocal(frameLocal), MEMORY_NAME.c_str());
+  };
+
+  auto getElementAddress = [&module, &getLocal](BinaryenExpressionRef list, BinaryenIndex index, int size) {
+    return BinaryenBinary(
+      module,
+      BinaryenAddInt32(),
+      list,
+      BinaryenBinary(module, BinaryenMulInt32(), getLocal(index), BinaryenConst(module, BinaryenLiteralInt32(size)))
+    );
+  };
+
+  auto loadElement = [&]() {
+    return BinaryenLoad(
+      module,
+      elementSize,
+      false,
+      LIST_ELEMENTS_OFFSET,
+      0,
+      elementType,
+      getElementAddress(loadFrameSlot(0), indexLocal, elementSize),
+      MEMORY_NAME.c_str()
+    );
+  };
+
+  auto storeInResult = [&](BinaryenIndex index, BinaryenExpressionRef value, BinaryenType type) {
+    return BinaryenStore(
+      module,
+      resultElementSize,
+      LIST_ELEMENTS_OFFSET,
+      0,
+      getElementAddress(loadFrameSlot(1), index, resultElementSize),
+      value,
+      type,
+      MEMORY_NAME.c_str()
+    );
+  };
+
+  BinaryenExpressionRef slots = BinaryenConst(module, BinaryenLiteralInt32(isReduce ? 1 : 2));
+
+  vector<BinaryenExpressionRef> expressions = {
+    BinaryenLocalSet(module, frameLocal, BinaryenCall(module, GC_PUSH_FRAME_FN.c_str(), &slots, 1, BinaryenTypeInt32())),
+    BinaryenStore(module, 4, 0, 0, getLocal(frameLocal), getLocal(0), BinaryenTypeInt32(), MEMORY_NAME.c_str()),
+    BinaryenLocalSet(module, lengthLocal, BinaryenLoad(module, 4, false, 0, 0, BinaryenTypeInt32(), getLocal(0), MEMORY_NAME.c_str()))
+  };
+
+  // Filtering allocates room for every element, and sets the length to what it kept once it's done. Allocating never
+  // collects, so the new list can go straight into the frame
+  if (!isReduce) {
+    BinaryenExpressionRef resultAllocation[] = {
+      BinaryenBinary(
         module,
-        FN_TABLE_NAME.c_str(),
-        BinaryenConst(module, BinaryenLiteralInt32(closureTemplate.getFunctionPointer().getAddress())),
-        operands,
-        functionMetaData.getArity(),
-        functionMetaData.getParamType(),
-        functionMetaData.getReturnType()
+        BinaryenAddInt32(),
+        BinaryenConst(module, BinaryenLiteralInt32(LIST_ELEMENTS_OFFSET)),
+        BinaryenBinary(
+          module,
+          BinaryenMulInt32(),
+          getLocal(lengthLocal),
+          BinaryenConst(module, BinaryenLiteralInt32(resultElementSize))
+        )
+      ),
+      BinaryenConst(module, BinaryenLiteralInt32(HEAP_DATA))
+    };
+
+    expressions.push_back(BinaryenStore(
+      module,
+      4,
+      4,
+      0,
+      getLocal(frameLocal),
+      BinaryenCall(module, GC_ALLOCATE_FN.c_str(), resultAllocation, 2, BinaryenTypeInt32()),
+      BinaryenTypeInt32(),
+      MEMORY_NAME.c_str()
+    ));
+  }
+
+  BinaryenExpressionRef step;
+
+  if (intrinsic == ListIntrinsics::MAP) {
+    BinaryenExpressionRef element = loadElement();
+
+    // The value is computed before the address to store it at, which the call can move
+    BinaryenExpressionRef stepExpressions[] = {
+      BinaryenLocalSet(module, valueLocal, BinaryenCall(module, functionName.c_str(), &element, 1, resultType)),
+      storeInResult(indexLocal, BinaryenLocalGet(module, valueLocal, resultType), resultType)
+    };
+
+    step = BinaryenBlock(module, NULL, stepExpressions, 2, BinaryenTypeNone());
+  } else if (intrinsic == ListIntrinsics::FILTER) {
+    BinaryenExpressionRef element = BinaryenLocalGet(module, valueLocal, elementType);
+
+    BinaryenExpressionRef keptExpressions[] = {
+      storeInResult(keptLocal, BinaryenLocalGet(module, valueLocal, elementType), elementType),
+      BinaryenLocalSet(
+        module,
+        keptLocal,
+        BinaryenBinary(module, BinaryenAddInt32(), getLocal(keptLocal), BinaryenConst(module, BinaryenLiteralInt32(1)))
+      )
+    };
+
+    BinaryenExpressionRef stepExpressions[] = {
+      BinaryenLocalSet(module, valueLocal, loadElement()),
+      BinaryenIf(
+        module,
+        BinaryenCall(module, functionName.c_str(), &element, 1, BinaryenTypeInt32()),
+        BinaryenBlock(module, NULL, keptExpressions, 2, BinaryenTypeNone()),
+        NULL
       )
+    };
+
+    step = BinaryenBlock(module, NULL, stepExpressions, 2, BinaryenTypeNone());
+  } else {
+    // The accumulator is never read after a call before it's replaced by what the call returned, so it doesn't need a
+    // slot in the frame even if it's on the heap
+    BinaryenExpressionRef callArgs[] = { BinaryenLocalGet(module, accumulatorParam, resultType), loadElement() };
+
+    step = BinaryenLocalSet(
+      module,
+      accumulatorParam,
+      BinaryenCall(module, functionName.c_str(), callArgs, 2, resultType)
     );
+  }
+
+  string doneLabel = name + ".done";
+  string loopLabel = name + ".elements";
+
+  BinaryenExpressionRef loopExpressions[] = {
+    BinaryenBreak(
+      module,
+      doneLabel.c_str(),
+      BinaryenBinary(module, BinaryenGeUInt32(), getLocal(indexLocal), getLocal(lengthLocal)),
+      NULL
+    ),
+    step,
+    BinaryenLocalSet(
+      module,
+      indexLocal,
+      BinaryenBinary(module, BinaryenAddInt32(), getLocal(indexLocal), BinaryenConst(module, BinaryenLiteralInt32(1)))
+    ),
+    BinaryenBreak(module, loopLabel.c_str(), NULL, NULL)
+  };
+
+  BinaryenExpressionRef loop = BinaryenLoop(
+    module,
+    loopLabel.c_str(),
+    BinaryenBlock(module, NULL, loopExpressions, 4, BinaryenTypeNone())
+  );
+
+  expressions.push_back(BinaryenBlock(module, doneLabel.c_str(), &loop, 1, BinaryenTypeNone()));
+
+  if (isReduce) {
+    expressions.push_back(BinaryenGlobalSet(module, GC_SHADOW_STACK_POINTER.c_str(), getLocal(frameLocal)));
+    expressions.push_back(BinaryenLocalGet(module, accumulatorParam, resultType));
   } else {
-    WasmClosure closure = WasmClosure::clone(closureTemplate);
-    vector<Pointer<PointerType::Data>> paramMemPointers = generateFunctionInvocationArgMemoryInsertions(
-      funcInvNode,
-      expressions,
-      module
+    BinaryenExpressionRef resultLength = getLocal(intrinsic == ListIntrinsics::FILTER ? keptLocal : lengthLocal);
+
+    expressions.push_back(BinaryenLocalSet(module, resultLocal, loadFrameSlot(1)));
+    expressions.push_back(
+      BinaryenStore(module, 4, 0, 0, getLocal(resultLocal), resultLength, BinaryenTypeInt32(), MEMORY_NAME.c_str())
     );
+    expressions.push_back(BinaryenGlobalSet(module, GC_SHADOW_STACK_POINTER.c_str(), getLocal(frameLocal)));
+    expressions.push_back(getLocal(resultLocal));
+  }
+
+  BinaryenType returnType = isReduce ? resultType : BinaryenTypeInt32();
+
+  GeneratedFunction function;
+  function.enclosingName = name;
+  function.paramType = BinaryenTypeCreate(paramTypes.data(), paramTypes.size());
+  function.paramTypes = paramTypes;
+  function.returnType = returnType;
+  function.localTypes = localTypes;
+  function.body = BinaryenBlock(module, NULL, expressions.data(), expressions.size(), returnType);
 
-    closure.addArgs(paramMemPointers);
+  generatedFunctions.insert(make_pair(name, std::move(function)));
 
-    vector<BinaryenExpressionRef> storageExpressions = generateClosureMemoryStore(closure, module);
-    copy(storageExpressions.begin(), storageExpressions.end(), back_inserter(expressions));
+  return name;
+}
+
+BinaryenExpressionRef CodeGen::generateDictIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module) {
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  // Looking a key up never collects, but evaluating the key can
+  vector<BinaryenExpressionRef> expressions;
+  vector<BinaryenExpressionRef> lookupArgs = generateOperands(
+    { makeOperand(args.at(0)), makeOperand(args.at(1)) },
+    false,
+    expressions,
+    module
+  );
 
-    expressions.push_back(BinaryenConst(module, BinaryenLiteralInt32(closure.getPointer().getAddress())));
+  BinaryenType resultType = getBinaryenTypeFromTypeDeclaration(
+    dynamic_pointer_cast<TypeDeclarationNode>(node->getResolvedType())
+  );
+
+  if (intrinsic == DictIntrinsics::HAS) {
+    expressions.push_back(BinaryenBinary(
+      module,
+      BinaryenNeInt32(),
+      BinaryenCall(module, DICT_FIND_FN.c_str(), lookupArgs.data(), 2, BinaryenTypeInt32()),
+      BinaryenConst(module, BinaryenLiteralInt32(0))
+    ));
+  } else {
+    expressions.push_back(BinaryenLoad(
+      module,
+      getByteSizeForType(resultType),
+      false,
+      DictionaryLayout::VALUE_OFFSET,
+      0,
+      resultType,
+      BinaryenCall(module, DICT_GET_FN.c_str(), lookupArgs.data(), 2, BinaryenTypeInt32()),
+      MEMORY_NAME.c_str()
+    ));
   }
-  
-  BinaryenExpressionRef* blockExpressions = new BinaryenExpressionRef[expressions.size()];
-  for (int i = 0; i < expressions.size(); i++) {
-    blockExpressions[i] = expressions.at(i);
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), resultType);
+}
+
+BinaryenExpressionRef CodeGen::generateStringIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module) {
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  BinaryenExpressionRef stringRef = generate(args.at(0), module);
+
+  // Strings are indexed by i32s, and no string has as many code units as an i32 can count
+  auto getIndex = [&](int arg) {
+    return BinaryenUnary(module, BinaryenWrapInt64(), generate(args.at(arg), module));
+  };
+
+  auto callStandardLibrary = [&](const char *name, BinaryenExpressionRef argument, BinaryenType returnType) {
+    BinaryenExpressionRef operands[] = { stringRef, argument };
+
+    return BinaryenCall(module, name, operands, 2, returnType);
+  };
+
+  if (intrinsic == StringIntrinsics::LENGTH) {
+    return BinaryenUnary(module, BinaryenExtendUInt32(), BinaryenStringMeasure(module, BinaryenStringMeasureWTF16(), stringRef));
+  }
+
+  if (intrinsic == StringIntrinsics::CHAR_CODE_AT) {
+    return BinaryenUnary(module, BinaryenExtendUInt32(), BinaryenStringWTF16Get(module, stringRef, getIndex(1)));
+  }
+
+  if (intrinsic == StringIntrinsics::SLICE) {
+    return BinaryenStringSliceWTF(module, stringRef, getIndex(1), getIndex(2));
+  }
+
+  if (intrinsic == StringIntrinsics::HASH) {
+    return BinaryenCall(module, "Theta.String.hash", &stringRef, 1, BinaryenTypeInt64());
+  }
+
+  if (intrinsic == StringIntrinsics::CODE_POINT_AT) {
+    return callStandardLibrary("Theta.String.codePointAt", getIndex(1), BinaryenTypeInt64());
+  }
+
+  if (intrinsic == StringIntrinsics::CHAR_AT) {
+    return callStandardLibrary("Theta.String.charAt", getIndex(1), BinaryenTypeStringref());
+  }
+
+  return callStandardLibrary("Theta.String.indexOf", generate(args.at(1), module), BinaryenTypeInt64());
+}
+
+BinaryenExpressionRef CodeGen::generateHostFunctionInvocation(
+  shared_ptr<FunctionInvocationNode> node,
+  const HostFunction &hostFunction,
+  BinaryenModuleRef &module
+) {
+  string importName = hostFunction.getImportName();
+  BinaryenType returnType = getBinaryenTypeFromTypeDeclaration(HostFunction::parseType(hostFunction.returnType, false));
+
+  addReference({ Reference::HOST_FUNCTION, hostFunction.name, "", nullptr });
+
+  vector<Operand> operands;
+  for (auto &arg : node->getParameters()->getElements()) operands.push_back(makeOperand(arg));
+
+  vector<BinaryenExpressionRef> expressions;
+  vector<BinaryenExpressionRef> args = generateOperands(operands, false, expressions, module);
+
+  // The host can't allocate, so unlike calls to Theta functions nothing moves while it runs
+  expressions.push_back(BinaryenCall(module, importName.c_str(), args.data(), args.size(), returnType));
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeAuto());
+}
+
+void CodeGen::addHostFunctionImport(const HostFunction &hostFunction, BinaryenModuleRef &module) {
+  string importName = hostFunction.getImportName();
+  if (BinaryenGetFunction(module, importName.c_str())) return;
+
+  vector<BinaryenType> paramTypes;
+  for (const string &paramType : hostFunction.paramTypes) {
+    paramTypes.push_back(getBinaryenTypeFromTypeDeclaration(HostFunction::parseType(paramType, true)));
+  }
+
+  BinaryenAddFunctionImport(
+    module,
+    importName.c_str(),
+    HostFunction::IMPORT_MODULE.c_str(),
+    hostFunction.name.c_str(),
+    BinaryenTypeCreate(paramTypes.data(), paramTypes.size()),
+    getBinaryenTypeFromTypeDeclaration(HostFunction::parseType(hostFunction.returnType, false))
+  );
+}
+
+BinaryenExpressionRef CodeGen::generateTupleIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module) {
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+
+  return BinaryenTupleExtract(
+    module,
+    generate(node->getParameters()->getElements().at(0), module),
+    TupleIntrinsics::getIndex(intrinsic)
+  );
+}
+
+int CodeGen::getSymbolId(const string &symbol) {
+  lock_guard<mutex> lock(sharedNames->namesMutex);
+
+  auto found = sharedNames->symbolIds.find(symbol);
+  if (found != sharedNames->symbolIds.end()) return found->second;
+
+  sharedNames->symbolNames.push_back(symbol);
+  sharedNames->symbolIds.insert(make_pair(symbol, sharedNames->symbolNames.size()));
+
+  return sharedNames->symbolNames.size();
+}
+
+void CodeGen::collectSymbols(shared_ptr<ASTNode> node) {
+  if (!node) return;
+
+  if (node->getNodeType() == ASTNode::SYMBOL) getSymbolId(dynamic_pointer_cast<SymbolNode>(node)->getSymbol());
+
+  StructuralHasher::forEachChild(node, [this](shared_ptr<ASTNode> child) { collectSymbols(child); });
+}
+
+void CodeGen::addSymbolNames(BinaryenModuleRef &module) {
+  string names;
+
+  for (const string &name : sharedNames->symbolNames) {
+    names += name + "\n";
+  }
+
+  BinaryenAddCustomSection(module, SYMBOL_NAMES_SECTION.c_str(), names.data(), names.size());
+}
+
+void CodeGen::addResultTypes(BinaryenModuleRef &module) {
+  string types;
+  set<string> structTypes;
+
+  for (auto &[exportName, resultType] : exportResultTypes) {
+    types += exportName + " " + resultType->toString(true) + "\n";
+
+    if (structDefinitions.count(resultType->getType())) structTypes.insert(resultType->getType());
+  }
+
+  for (const string &structType : structTypes) {
+    types += "@" + structType;
+
+    for (const StructLayout::Field &field : getStructLayout(structType).fields) {
+      types += " " + field.name + ":" + field.type->toString(true) + ":" + to_string(field.offset) + ":" + to_string(field.size);
+    }
+
+    types += "\n";
+  }
+
+  BinaryenAddCustomSection(module, RESULT_TYPES_SECTION.c_str(), types.data(), types.size());
+}
+
+namespace {
+  // Prepends a charge of fuel to the body of every loop it walks
+  struct FuelMeter : public wasm::PostWalker<FuelMeter> {
+    function<wasm::Expression*()> makeCharge;
+
+    void visitLoop(wasm::Loop *loop) {
+      loop->body = wasm::Builder(*getModule()).makeSequence(makeCharge(), loop->body);
+    }
+  };
+}
+
+void CodeGen::meterFuel(BinaryenModuleRef &module) {
+  wasm::Module *wasmModule = reinterpret_cast<wasm::Module*>(module);
+  wasm::Builder builder(*wasmModule);
+
+  wasm::Name fuel = FUEL_REMAINING.c_str();
+  wasm::Name memory = MEMORY_NAME.c_str();
+
+  // The core module decides where the flag lives, so it's read from there rather than repeated here
+  uint32_t interruptAddress = BinaryenConstGetValueI32(
+    BinaryenGlobalGetInitExpr(BinaryenGetGlobal(module, FUEL_INTERRUPT.c_str()))
+  );
+
+  // Checking both at once keeps the common case to a single branch
+  auto makeCharge = [&]() -> wasm::Expression* {
+    wasm::Expression *spend = builder.makeGlobalSet(
+      fuel,
+      builder.makeBinary(wasm::SubInt64, builder.makeGlobalGet(fuel, wasm::Type::i64), builder.makeConst(int64_t(1)))
+    );
+
+    wasm::Expression *isStopping = builder.makeBinary(
+      wasm::OrInt32,
+      builder.makeBinary(wasm::LtSInt64, builder.makeGlobalGet(fuel, wasm::Type::i64), builder.makeConst(int64_t(0))),
+      builder.makeLoad(1, false, interruptAddress, 1, builder.makeConst(int32_t(0)), wasm::Type::i32, memory)
+    );
+
+    return builder.makeSequence(spend, builder.makeIf(isStopping, builder.makeUnreachable()));
+  };
+
+  FuelMeter meter;
+  meter.makeCharge = makeCharge;
+
+  for (auto &func : wasmModule->functions) {
+    string name(func->name.str);
+
+    // Collecting and resetting always finish, and the host relies on them to
+    if (func->imported() || name.rfind(GC_PREFIX, 0) == 0 || name == RESET_FN) continue;
+
+    meter.walkFunctionInModule(func.get(), wasmModule);
+    func->body = builder.makeSequence(makeCharge(), func->body);
+  }
+}
+
+namespace {
+  // Calls the host on leaving a function, at each return and tail call it walks
+  struct ProfileExits : public wasm::PostWalker<ProfileExits> {
+    wasm::Module *module;
+    wasm::Function *function;
+    wasm::Name exitFn;
+
+    wasm::Expression* makeExit() {
+      return wasm::Builder(*module).makeCall(exitFn, vector<wasm::Expression*>(), wasm::Type::none);
+    }
+
+    // Calls the host once the value has been evaluated, so that whatever it calls is still counted in this function
+    wasm::Expression* exitAfter(wasm::Expression *value) {
+      if (value->type == wasm::Type::unreachable) return value;
+
+      wasm::Builder builder(*module);
+      if (value->type == wasm::Type::none) return builder.makeSequence(value, makeExit());
+
+      wasm::Index local = wasm::Builder::addVar(function, value->type);
+
+      return builder.makeBlock({
+        builder.makeLocalSet(local, value),
+        makeExit(),
+        builder.makeLocalGet(local, value->type)
+      });
+    }
+
+    void visitReturn(wasm::Return *curr) {
+      if (curr->value) curr->value = exitAfter(curr->value);
+      else replaceCurrent(wasm::Builder(*module).makeSequence(makeExit(), curr));
+    }
+
+    // A tail call leaves the function before the call starts, once its operands are evaluated, and the last operand
+    // evaluated is the target of an indirect call
+    void visitCall(wasm::Call *curr) {
+      if (!curr->isReturn) return;
+
+      if (curr->operands.empty()) replaceCurrent(wasm::Builder(*module).makeSequence(makeExit(), curr));
+      else curr->operands.back() = exitAfter(curr->operands.back());
+    }
+
+    void visitCallIndirect(wasm::CallIndirect *curr) {
+      if (curr->isReturn) curr->target = exitAfter(curr->target);
+    }
+
+    void visitCallRef(wasm::CallRef *curr) {
+      if (curr->isReturn) curr->target = exitAfter(curr->target);
+    }
+  };
+}
+
+void CodeGen::addProfiling(BinaryenModuleRef &module) {
+  BinaryenAddFunctionImport(module, PROFILE_ENTER_FN.c_str(), "theta", "profileEnter", BinaryenTypeInt32(), BinaryenTypeNone());
+  BinaryenAddFunctionImport(module, PROFILE_EXIT_FN.c_str(), "theta", "profileExit", BinaryenTypeNone(), BinaryenTypeNone());
+
+  wasm::Module *wasmModule = reinterpret_cast<wasm::Module*>(module);
+  wasm::Builder builder(*wasmModule);
+
+  ProfileExits exits;
+  exits.module = wasmModule;
+  exits.exitFn = PROFILE_EXIT_FN.c_str();
+
+  string names;
+  int32_t functionId = 0;
+
+  for (auto &func : wasmModule->functions) {
+    string name(func->name.str);
+
+    // Only the program's own functions are profiled, not the core module's or the standard library's
+    if (func->imported() || name.rfind(CORE_FUNCTION_PREFIX, 0) == 0) continue;
+
+    exits.function = func.get();
+    exits.walkFunctionInModule(func.get(), wasmModule);
+
+    vector<wasm::Expression*> id = { builder.makeConst(functionId) };
+    wasm::Expression *enter = builder.makeCall(PROFILE_ENTER_FN.c_str(), id, wasm::Type::none);
+    func->body = builder.makeSequence(enter, exits.exitAfter(func->body));
+
+    auto lifted = liftedFunctionNames.find(name);
+    names += (lifted != liftedFunctionNames.end() ? lifted->second : name) + "\n";
+    functionId++;
+  }
+
+  BinaryenAddCustomSection(module, PROFILE_SECTION.c_str(), names.data(), names.size());
+}
+
+const StructLayout& CodeGen::getStructLayout(const string &structType) {
+  auto found = structLayouts.find(structType);
+  if (found != structLayouts.end()) return found->second;
+
+  auto definition = structDefinitions.find(structType);
+  if (definition == structDefinitions.end()) {
+    throw runtime_error("No definition found for struct " + structType);
+  }
+
+  return structLayouts.insert(make_pair(structType, StructLayout::fromDefinition(definition->second))).first->second;
+}
+
+BinaryenExpressionRef CodeGen::generateStructFieldAccess(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module) {
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+  string structType = dynamic_pointer_cast<TypeDeclarationNode>(args.at(0)->getResolvedType())->getType();
+  string fieldName = dynamic_pointer_cast<SymbolNode>(args.at(1))->getSymbol().substr(1);
+
+  const StructLayout::Field *field = getStructLayout(structType).getField(fieldName);
+  BinaryenType type = getBinaryenTypeFromTypeDeclaration(field->type);
+
+  shared_ptr<IdentifierNode> structIdentifier = dynamic_pointer_cast<IdentifierNode>(args.at(0));
+  if (structIdentifier && currentFunction) {
+    auto replaced = currentFunction->scalarReplacedStructs.find(structIdentifier->getIdentifier());
+
+    if (replaced != currentFunction->scalarReplacedStructs.end()) {
+      return BinaryenLocalGet(module, replaced->second.at(fieldName), type);
+    }
   }
 
-  return BinaryenBlock(module, NULL, blockExpressions, expressions.size(), BinaryenTypeInt64());
+  return BinaryenLoad(module, field->size, false, field->offset, 0, type, generate(args.at(0), module), MEMORY_NAME.c_str());
+}
+
+bool CodeGen::canScalarReplace(shared_ptr<AssignmentNode> assignmentNode) {
+  if (!currentFunction) return false;
+
+  string structType = dynamic_pointer_cast<StructDeclarationNode>(assignmentNode->getRight())->getStructType();
+  if (getStructLayout(structType).fields.size() > MAX_SCALAR_REPLACED_FIELDS) return false;
+
+  string identifier = dynamic_pointer_cast<IdentifierNode>(assignmentNode->getLeft())->getIdentifier();
+  int fieldReads = 0;
+
+  function<void(shared_ptr<ASTNode>)> countFieldReads = [&identifier, &fieldReads, &countFieldReads](shared_ptr<ASTNode> ast) {
+    if (!ast) return;
+
+    if (ast->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
+      shared_ptr<FunctionInvocationNode> funcInvNode = dynamic_pointer_cast<FunctionInvocationNode>(ast);
+      shared_ptr<IdentifierNode> funcInvIdentifier = dynamic_pointer_cast<IdentifierNode>(funcInvNode->getIdentifier());
+      vector<shared_ptr<ASTNode>> args = funcInvNode->getParameters()->getElements();
+
+      bool isFieldRead = (
+        funcInvIdentifier &&
+        funcInvIdentifier->getIdentifier() == DictIntrinsics::GET &&
+        args.size() == 2 &&
+        args.at(0)->getNodeType() == ASTNode::IDENTIFIER &&
+        dynamic_pointer_cast<IdentifierNode>(args.at(0))->getIdentifier() == identifier
+      );
+
+      if (isFieldRead) fieldReads++;
+    }
+
+    forEachChild(ast, countFieldReads);
+  };
+
+  map<string, int> references;
+  InliningPass::countReferences(assignmentNode->getParent(), references);
+  countFieldReads(assignmentNode->getParent());
+
+  // Any other use, such as passing the struct along or capturing it in a closure, needs it to be in memory
+  return references[identifier] == fieldReads;
+}
+
+BinaryenExpressionRef CodeGen::generateScalarReplacedStruct(
+  const string &identifier,
+  shared_ptr<StructDeclarationNode> node,
+  BinaryenModuleRef &module
+) {
+  const StructLayout &layout = getStructLayout(node->getStructType());
+  vector<shared_ptr<ASTNode>> entries = dynamic_pointer_cast<ASTNodeList>(node->getValue())->getElements();
+
+  vector<BinaryenExpressionRef> expressions;
+  unordered_map<string, BinaryenIndex> fieldLocals;
+
+  for (auto &entry : entries) {
+    const StructLayout::Field *field = layout.getField(dynamic_pointer_cast<SymbolNode>(entry->getLeft())->getSymbol().substr(1));
+    BinaryenIndex fieldLocal = addLocal(getBinaryenTypeFromTypeDeclaration(field->type));
+
+    expressions.push_back(BinaryenLocalSet(module, fieldLocal, generate(entry->getRight(), module)));
+    fieldLocals.insert(make_pair(field->name, fieldLocal));
+  }
+
+  currentFunction->scalarReplacedStructs[identifier] = fieldLocals;
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeNone());
 }
 
 BinaryenExpressionRef CodeGen::generateControlFlow(shared_ptr<ControlFlowNode> controlFlowNode, BinaryenModuleRef &module) {
-  controlFlowNode->getConditionExpressionPairs();
+  vector<JumpTableCase> jumpTableCases;
+  shared_ptr<IdentifierNode> scrutinee = collectJumpTableCases(controlFlowNode, jumpTableCases);
+
+  // Matching a value against many constants with nested ifs compares it against each of them in turn, so those
+  // chains branch straight to the case that matches instead
+  if (scrutinee) {
+    return generateJumpTable(scrutinee, jumpTableCases, controlFlowNode->getConditionExpressionPairs().back().second, module);
+  }
 
   BinaryenExpressionRef expr = NULL;
 
@@ -919,21 +1970,205 @@ BinaryenExpressionRef CodeGen::generateControlFlow(shared_ptr<ControlFlowNode> c
   for (int i = controlFlowNode->getConditionExpressionPairs().size() - 1; i >= 0; i--) {
     pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>> cndExprPair = controlFlowNode->getConditionExpressionPairs().at(i);
 
-    // Handle the else case
-    if (cndExprPair.first == nullptr) {
-      expr = generate(cndExprPair.second, module);
-      continue;
+    // Handle the else case
+    if (cndExprPair.first == nullptr) {
+      expr = generate(cndExprPair.second, module);
+      continue;
+    }
+
+    expr = BinaryenIf(
+      module,
+      generate(cndExprPair.first, module),
+      generate(cndExprPair.second, module),
+      expr
+    );
+  }
+
+  return expr;
+}
+
+shared_ptr<IdentifierNode> CodeGen::collectJumpTableCases(shared_ptr<ControlFlowNode> controlFlowNode, vector<JumpTableCase> &cases) {
+  vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> pairs = controlFlowNode->getConditionExpressionPairs();
+
+  // Without an else branch, the chain has no value when nothing matches
+  if (pairs.size() <= MIN_JUMP_TABLE_CASES || pairs.back().first) return nullptr;
+
+  shared_ptr<IdentifierNode> scrutinee;
+  set<int64_t> constants;
+
+  for (int i = 0; i < pairs.size() - 1; i++) {
+    shared_ptr<BinaryOperationNode> comparison = dynamic_pointer_cast<BinaryOperationNode>(pairs.at(i).first);
+    if (!comparison || comparison->getOperator() != Lexemes::EQUALITY) return nullptr;
+
+    shared_ptr<IdentifierNode> compared = dynamic_pointer_cast<IdentifierNode>(comparison->getLeft());
+    optional<int64_t> constant = getJumpTableConstant(comparison->getRight());
+
+    if (!compared || !constant) {
+      compared = dynamic_pointer_cast<IdentifierNode>(comparison->getRight());
+      constant = getJumpTableConstant(comparison->getLeft());
+    }
+
+    if (!compared || !constant) return nullptr;
+    if (scrutinee && compared->getIdentifier() != scrutinee->getIdentifier()) return nullptr;
+
+    scrutinee = compared;
+
+    if (constants.insert(constant.value()).second) {
+      cases.push_back({ constant.value(), pairs.at(i).second, "" });
+    }
+  }
+
+  if (cases.size() < MIN_JUMP_TABLE_CASES) return nullptr;
+
+  return scrutinee;
+}
+
+optional<int64_t> CodeGen::getJumpTableConstant(shared_ptr<ASTNode> node) {
+  if (node->getNodeType() == ASTNode::NUMBER_LITERAL) {
+    return stoi(dynamic_pointer_cast<LiteralNode>(node)->getLiteralValue());
+  }
+
+  if (node->getNodeType() == ASTNode::BOOLEAN_LITERAL) {
+    return dynamic_pointer_cast<LiteralNode>(node)->getLiteralValue() == "true" ? 1 : 0;
+  }
+
+  if (node->getNodeType() == ASTNode::SYMBOL) {
+    return getSymbolId(dynamic_pointer_cast<SymbolNode>(node)->getSymbol());
+  }
+
+  return nullopt;
+}
+
+BinaryenExpressionRef CodeGen::generateJumpTable(
+  shared_ptr<IdentifierNode> scrutinee,
+  vector<JumpTableCase> &cases,
+  shared_ptr<ASTNode> defaultBody,
+  BinaryenModuleRef &module
+) {
+  string label = JUMP_TABLE_LABEL_PREFIX + to_string(jumpTableCount++);
+  string defaultLabel = label + ".default";
+
+  for (int i = 0; i < cases.size(); i++) {
+    cases.at(i).label = label + ".case." + to_string(i);
+  }
+
+  vector<JumpTableCase> sortedCases = cases;
+  sort(sortedCases.begin(), sortedCases.end(), [](const JumpTableCase &a, const JumpTableCase &b) {
+    return a.constant < b.constant;
+  });
+
+  bool isNumber = dynamic_pointer_cast<TypeDeclarationNode>(scrutinee->getResolvedType())->getType() == DataTypes::NUMBER;
+  int64_t min = sortedCases.front().constant;
+  uint64_t spread = static_cast<uint64_t>(sortedCases.back().constant) - static_cast<uint64_t>(min) + 1;
+
+  BinaryenExpressionRef dispatch;
+
+  if (spread <= cases.size() * MAX_JUMP_TABLE_SPREAD) {
+    vector<const char*> targets(spread, defaultLabel.c_str());
+    for (JumpTableCase &jumpTableCase : sortedCases) {
+      targets.at(jumpTableCase.constant - min) = jumpTableCase.label.c_str();
+    }
+
+    auto offset = [&]() {
+      return isNumber
+        ? BinaryenBinary(module, BinaryenSubInt64(), generate(scrutinee, module), BinaryenConst(module, BinaryenLiteralInt64(min)))
+        : BinaryenBinary(module, BinaryenSubInt32(), generate(scrutinee, module), BinaryenConst(module, BinaryenLiteralInt32(min)));
+    };
+
+    if (isNumber) {
+      // br_table takes an i32, so Numbers too far from the cases to wrap into one go to the default first
+      BinaryenExpressionRef dispatchExpressions[] = {
+        BinaryenBreak(
+          module,
+          defaultLabel.c_str(),
+          BinaryenBinary(module, BinaryenGtUInt64(), offset(), BinaryenConst(module, BinaryenLiteralInt64(spread - 1))),
+          NULL
+        ),
+        BinaryenSwitch(
+          module,
+          targets.data(),
+          targets.size(),
+          defaultLabel.c_str(),
+          BinaryenUnary(module, BinaryenWrapInt64(), offset()),
+          NULL
+        )
+      };
+
+      dispatch = BinaryenBlock(module, NULL, dispatchExpressions, 2, BinaryenTypeNone());
+    } else {
+      dispatch = BinaryenSwitch(module, targets.data(), targets.size(), defaultLabel.c_str(), offset(), NULL);
+    }
+  } else {
+    dispatch = generateJumpTableSearch(scrutinee, sortedCases, 0, sortedCases.size(), defaultLabel, module);
+  }
+
+  // Each case's block ends where its body starts, so branching to it runs the body, which then leaves the table
+  for (JumpTableCase &jumpTableCase : cases) {
+    BinaryenExpressionRef caseExpressions[] = {
+      BinaryenBlock(module, jumpTableCase.label.c_str(), &dispatch, 1, BinaryenTypeNone()),
+      BinaryenBreak(module, label.c_str(), NULL, generate(jumpTableCase.body, module))
+    };
+
+    dispatch = BinaryenBlock(module, NULL, caseExpressions, 2, BinaryenTypeNone());
+  }
+
+  BinaryenExpressionRef tableExpressions[] = {
+    BinaryenBlock(module, defaultLabel.c_str(), &dispatch, 1, BinaryenTypeNone()),
+    generate(defaultBody, module)
+  };
+
+  return BinaryenBlock(module, label.c_str(), tableExpressions, 2, BinaryenTypeAuto());
+}
+
+BinaryenExpressionRef CodeGen::generateJumpTableSearch(
+  shared_ptr<IdentifierNode> scrutinee,
+  vector<JumpTableCase> &sortedCases,
+  int low,
+  int high,
+  const string &defaultLabel,
+  BinaryenModuleRef &module
+) {
+  bool isNumber = dynamic_pointer_cast<TypeDeclarationNode>(scrutinee->getResolvedType())->getType() == DataTypes::NUMBER;
+
+  auto constant = [&](int64_t value) {
+    return BinaryenConst(module, isNumber ? BinaryenLiteralInt64(value) : BinaryenLiteralInt32(value));
+  };
+
+  if (high - low <= LINEAR_JUMP_TABLE_SEARCH) {
+    vector<BinaryenExpressionRef> expressions;
+
+    for (int i = low; i < high; i++) {
+      expressions.push_back(BinaryenBreak(
+        module,
+        sortedCases.at(i).label.c_str(),
+        BinaryenBinary(
+          module,
+          isNumber ? BinaryenEqInt64() : BinaryenEqInt32(),
+          generate(scrutinee, module),
+          constant(sortedCases.at(i).constant)
+        ),
+        NULL
+      ));
     }
 
-    expr = BinaryenIf(
-      module,
-      generate(cndExprPair.first, module),
-      generate(cndExprPair.second, module),
-      expr
-    );
+    expressions.push_back(BinaryenBreak(module, defaultLabel.c_str(), NULL, NULL));
+
+    return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeNone());
   }
 
-  return expr;
+  int middle = low + (high - low) / 2;
+
+  return BinaryenIf(
+    module,
+    BinaryenBinary(
+      module,
+      isNumber ? BinaryenLtSInt64() : BinaryenLtSInt32(),
+      generate(scrutinee, module),
+      constant(sortedCases.at(middle).constant)
+    ),
+    generateJumpTableSearch(scrutinee, sortedCases, low, middle, defaultLabel, module),
+    generateJumpTableSearch(scrutinee, sortedCases, middle, high, defaultLabel, module)
+  );
 }
 
 BinaryenExpressionRef CodeGen::generateIdentifier(shared_ptr<IdentifierNode> identNode, BinaryenModuleRef &module) {
@@ -973,6 +2208,12 @@ BinaryenExpressionRef CodeGen::generateBinaryOperation(shared_ptr<BinaryOperatio
     return generateExponentOperation(binOpNode, module);
   }
 
+  bool isStringOperation = dynamic_pointer_cast<TypeDeclarationNode>(binOpNode->getLeft()->getResolvedType())->getType() == DataTypes::STRING;
+
+  if (isStringOperation && binOpNode->getOperator() == Lexemes::PLUS) {
+    return generateStringConcatenation(binOpNode, module);
+  }
+
   BinaryenExpressionRef binaryenLeft = generate(binOpNode->getLeft(), module);
   BinaryenExpressionRef binaryenRight = generate(binOpNode->getRight(), module);
 
@@ -980,7 +2221,7 @@ BinaryenExpressionRef CodeGen::generateBinaryOperation(shared_ptr<BinaryOperatio
     throw runtime_error("Invalid operand types for binary operation");
   }
 
-  if (dynamic_pointer_cast<TypeDeclarationNode>(binOpNode->getLeft()->getResolvedType())->getType() == DataTypes::STRING) {
+  if (isStringOperation) {
     return generateStringBinaryOperation(binOpNode->getOperator(), binaryenLeft, binaryenRight, module);
   } 
 
@@ -994,6 +2235,65 @@ BinaryenExpressionRef CodeGen::generateBinaryOperation(shared_ptr<BinaryOperatio
   );
 }
 
+BinaryenExpressionRef CodeGen::generateStringConcatenation(shared_ptr<BinaryOperationNode> node, BinaryenModuleRef &module) {
+  vector<shared_ptr<ASTNode>> parts;
+  collectConcatenatedParts(node, parts);
+
+  vector<BinaryenExpressionRef> expressions;
+  string literal;
+  bool hasLiteral = false;
+
+  for (shared_ptr<ASTNode> part : parts) {
+    if (part->getNodeType() == ASTNode::STRING_LITERAL) {
+      literal += dynamic_pointer_cast<LiteralNode>(part)->getLiteralValue();
+      hasLiteral = true;
+      continue;
+    }
+
+    if (hasLiteral) expressions.push_back(generateStringConstant(literal, module));
+    literal = "";
+    hasLiteral = false;
+
+    BinaryenExpressionRef expression = generate(part, module);
+    if (!expression) throw runtime_error("Invalid operand types for binary operation");
+
+    expressions.push_back(expression);
+  }
+
+  if (hasLiteral) expressions.push_back(generateStringConstant(literal, module));
+
+  // Concatenates neighbouring pairs until one string is left, which keeps the parts in order
+  while (expressions.size() > 1) {
+    vector<BinaryenExpressionRef> concatenated;
+
+    for (int i = 0; i + 1 < expressions.size(); i += 2) {
+      concatenated.push_back(BinaryenStringConcat(module, expressions[i], expressions[i + 1]));
+    }
+
+    if (expressions.size() % 2 == 1) concatenated.push_back(expressions.back());
+
+    expressions = concatenated;
+  }
+
+  return expressions[0];
+}
+
+void CodeGen::collectConcatenatedParts(shared_ptr<ASTNode> node, vector<shared_ptr<ASTNode>> &parts) {
+  shared_ptr<BinaryOperationNode> binOpNode = dynamic_pointer_cast<BinaryOperationNode>(node);
+
+  bool isConcatenation = binOpNode
+    && binOpNode->getOperator() == Lexemes::PLUS
+    && dynamic_pointer_cast<TypeDeclarationNode>(binOpNode->getLeft()->getResolvedType())->getType() == DataTypes::STRING;
+
+  if (!isConcatenation) {
+    parts.push_back(node);
+    return;
+  }
+
+  collectConcatenatedParts(binOpNode->getLeft(), parts);
+  collectConcatenatedParts(binOpNode->getRight(), parts);
+}
+
 BinaryenExpressionRef CodeGen::generateStringBinaryOperation(
   string op,
   BinaryenExpressionRef left,
@@ -1043,7 +2343,29 @@ BinaryenExpressionRef CodeGen::generateNumberLiteral(shared_ptr<LiteralNode> lit
 }
 
 BinaryenExpressionRef CodeGen::generateStringLiteral(shared_ptr<LiteralNode> literalNode, BinaryenModuleRef &module) {
-  return BinaryenStringConst(module, literalNode->getLiteralValue().c_str());
+  return generateStringConstant(literalNode->getLiteralValue(), module);
+}
+
+BinaryenExpressionRef CodeGen::generateStringConstant(const string &value, BinaryenModuleRef &module) {
+  // The literal's global is filled in once the functions are added, see addReferences
+  BinaryenExpressionRef globalGet = BinaryenGlobalGet(module, STRING_LITERAL_GLOBAL_PREFIX.c_str(), BinaryenTypeStringref());
+  addReference({ Reference::STRING_LITERAL, "", value, globalGet });
+
+  return globalGet;
+}
+
+string CodeGen::getStringLiteralGlobal(const string &value, BinaryenModuleRef &module) {
+  auto literalGlobal = stringLiteralGlobals.find(value);
+
+  if (literalGlobal == stringLiteralGlobals.end()) {
+    string globalName = STRING_LITERAL_GLOBAL_PREFIX + to_string(stringLiteralGlobals.size());
+
+    BinaryenAddGlobal(module, globalName.c_str(), BinaryenTypeStringref(), false, BinaryenStringConst(module, value.c_str()));
+
+    literalGlobal = stringLiteralGlobals.emplace(value, globalName).first;
+  }
+
+  return literalGlobal->second;
 }
 
 BinaryenExpressionRef CodeGen::generateBooleanLiteral(shared_ptr<LiteralNode> literalNode, BinaryenModuleRef &module) {
@@ -1053,9 +2375,357 @@ BinaryenExpressionRef CodeGen::generateBooleanLiteral(shared_ptr<LiteralNode> li
   );
 }
 
+BinaryenExpressionRef CodeGen::generateList(shared_ptr<ListNode> node, BinaryenModuleRef &module) {
+  if (!currentFunction) {
+    throw runtime_error("Lists can only be allocated inside of a function");
+  }
+
+  vector<shared_ptr<ASTNode>> elements = node->getElements();
+  shared_ptr<TypeDeclarationNode> elementType = dynamic_pointer_cast<TypeDeclarationNode>(
+    dynamic_pointer_cast<TypeDeclarationNode>(node->getResolvedType())->getValue()
+  );
+
+  bool isUnboxedElement = elementType->getType() == DataTypes::NUMBER || elementType->getType() == DataTypes::BOOLEAN;
+  if (!elements.empty() && !isUnboxedElement) {
+    throw runtime_error("Only lists of Numbers and Booleans can be generated, not lists of " + elementType->toString());
+  }
+
+  int elementSize = elements.empty() ? 0 : getByteSizeForType(elementType);
+  BinaryenType elementWasmType = elements.empty() ? BinaryenTypeNone() : getBinaryenTypeFromTypeDeclaration(elementType);
+
+  vector<BinaryenExpressionRef> expressions;
+  vector<BinaryenExpressionRef> values;
+
+  // Elements that call a function are evaluated before the list is allocated, so nothing can collect while the list
+  // is only held in a local
+  for (auto &element : elements) {
+    BinaryenExpressionRef value = generate(element, module);
+
+    if (!canCollect(element)) {
+      values.push_back(value);
+      continue;
+    }
+
+    BinaryenIndex valueLocal = addLocal(elementWasmType);
+
+    expressions.push_back(BinaryenLocalSet(module, valueLocal, value));
+    values.push_back(BinaryenLocalGet(module, valueLocal, elementWasmType));
+  }
+
+  BinaryenIndex listLocal = addLocal(BinaryenTypeInt32());
+  auto getList = [&module, listLocal]() { return BinaryenLocalGet(module, listLocal, BinaryenTypeInt32()); };
+
+  BinaryenExpressionRef listAllocation[] = {
+    BinaryenConst(module, BinaryenLiteralInt32(LIST_ELEMENTS_OFFSET + elements.size() * elementSize)),
+    BinaryenConst(module, BinaryenLiteralInt32(HEAP_DATA))
+  };
+
+  expressions.push_back(BinaryenLocalSet(
+    module,
+    listLocal,
+    BinaryenCall(module, GC_ALLOCATE_FN.c_str(), listAllocation, 2, BinaryenTypeInt32())
+  ));
+
+  expressions.push_back(BinaryenStore(
+    module,
+    4,
+    0,
+    0,
+    getList(),
+    BinaryenConst(module, BinaryenLiteralInt32(elements.size())),
+    BinaryenTypeInt32(),
+    MEMORY_NAME.c_str()
+  ));
+
+  for (int i = 0; i < values.size(); i++) {
+    expressions.push_back(BinaryenStore(
+      module,
+      elementSize,
+      LIST_ELEMENTS_OFFSET + i * elementSize,
+      0,
+      getList(),
+      values.at(i),
+      elementWasmType,
+      MEMORY_NAME.c_str()
+    ));
+  }
+
+  expressions.push_back(getList());
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeInt32());
+}
+
+BinaryenExpressionRef CodeGen::generateDictionary(shared_ptr<DictionaryNode> node, BinaryenModuleRef &module) {
+  if (!currentFunction) {
+    throw runtime_error("Dictionaries can only be allocated inside of a function");
+  }
+
+  vector<shared_ptr<ASTNode>> entries = node->getElements();
+  shared_ptr<TypeDeclarationNode> valueType = dynamic_pointer_cast<TypeDeclarationNode>(
+    dynamic_pointer_cast<TypeDeclarationNode>(node->getResolvedType())->getValue()
+  );
+
+  bool isUnboxedValue = valueType->getType() == DataTypes::NUMBER || valueType->getType() == DataTypes::BOOLEAN;
+  if (!entries.empty() && !isUnboxedValue) {
+    throw runtime_error("Only dictionaries of Numbers and Booleans can be generated, not of " + valueType->toString());
+  }
+
+  BinaryenType valueWasmType = entries.empty() ? BinaryenTypeNone() : getBinaryenTypeFromTypeDeclaration(valueType);
+
+  bool hasConstantKeys = true;
+  vector<int> constantKeys;
+
+  for (auto &entry : entries) {
+    if (entry->getLeft()->getNodeType() != ASTNode::SYMBOL) {
+      hasConstantKeys = false;
+      break;
+    }
+
+    constantKeys.push_back(getSymbolId(dynamic_pointer_cast<SymbolNode>(entry->getLeft())->getSymbol()));
+  }
+
+  vector<BinaryenExpressionRef> expressions;
+
+  // Keys and values that call a function are evaluated before the dictionary is allocated, so nothing can collect
+  // while the dictionary is only held in a local
+  auto generateBeforeAllocation = [&](shared_ptr<ASTNode> expression, BinaryenType type) {
+    BinaryenExpressionRef value = generate(expression, module);
+    if (!canCollect(expression)) return value;
+
+    BinaryenIndex local = addLocal(type);
+    expressions.push_back(BinaryenLocalSet(module, local, value));
+
+    return BinaryenLocalGet(module, local, type);
+  };
+
+  BinaryenIndex dictLocal = addLocal(BinaryenTypeInt32());
+  auto getDict = [&module, dictLocal]() { return BinaryenLocalGet(module, dictLocal, BinaryenTypeInt32()); };
+
+  if (!hasConstantKeys) {
+    vector<pair<BinaryenExpressionRef, BinaryenExpressionRef>> keyValues;
+
+    for (auto &entry : entries) {
+      BinaryenExpressionRef key = generateBeforeAllocation(entry->getLeft(), BinaryenTypeInt32());
+      BinaryenExpressionRef value = generateBeforeAllocation(entry->getRight(), valueWasmType);
+
+      keyValues.push_back(make_pair(key, value));
+    }
+
+    int capacity = DictionaryLayout::getCapacity(entries.size());
+    int byteSize = DictionaryLayout::HEADER_SIZE + capacity * DictionaryLayout::ENTRY_SIZE;
+
+    BinaryenExpressionRef dictAllocation[] = {
+      BinaryenConst(module, BinaryenLiteralInt32(byteSize)),
+      BinaryenConst(module, BinaryenLiteralInt32(HEAP_DATA))
+    };
+
+    expressions.push_back(BinaryenLocalSet(
+      module,
+      dictLocal,
+      BinaryenCall(module, GC_ALLOCATE_FN.c_str(), dictAllocation, 2, BinaryenTypeInt32())
+    ));
+
+    // The heap isn't cleared between collections, so every slot has to be marked empty before inserting
+    expressions.push_back(BinaryenMemoryFill(
+      module,
+      getDict(),
+      BinaryenConst(module, BinaryenLiteralInt32(0)),
+      BinaryenConst(module, BinaryenLiteralInt32(byteSize)),
+      MEMORY_NAME.c_str()
+    ));
+
+    expressions.push_back(BinaryenStore(
+      module,
+      4,
+      0,
+      0,
+      getDict(),
+      BinaryenConst(module, BinaryenLiteralInt32(capacity)),
+      BinaryenTypeInt32(),
+      MEMORY_NAME.c_str()
+    ));
+
+    for (auto &keyValue : keyValues) {
+      BinaryenExpressionRef value = keyValue.second;
+      if (valueWasmType == BinaryenTypeInt32()) value = BinaryenUnary(module, BinaryenExtendUInt32(), value);
+
+      BinaryenExpressionRef insertArgs[] = { getDict(), keyValue.first, value };
+
+      expressions.push_back(BinaryenCall(module, DICT_INSERT_FN.c_str(), insertArgs, 3, BinaryenTypeNone()));
+    }
+
+    expressions.push_back(getDict());
+
+    return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeInt32());
+  }
+
+  DictionaryLayout layout = DictionaryLayout::fromKeys(constantKeys);
+
+  // Literal values are part of the layout, and the rest are stored once it's copied in. A key given more than once
+  // takes its last value, though every value is still evaluated
+  unordered_map<int, int64_t> literalValues;
+  vector<pair<int, BinaryenExpressionRef>> storedValues;
+
+  for (int i = 0; i < entries.size(); i++) {
+    shared_ptr<ASTNode> value = entries.at(i)->getRight();
+    bool isLastForKey = find(constantKeys.begin() + i + 1, constantKeys.end(), constantKeys.at(i)) == constantKeys.end();
+
+    if (!isLastForKey) {
+      if (canCollect(value)) expressions.push_back(BinaryenDrop(module, generate(value, module)));
+      continue;
+    }
+
+    if (value->getNodeType() == ASTNode::NUMBER_LITERAL) {
+      literalValues.insert(make_pair(constantKeys.at(i), stoi(dynamic_pointer_cast<LiteralNode>(value)->getLiteralValue())));
+    } else if (value->getNodeType() == ASTNode::BOOLEAN_LITERAL) {
+      literalValues.insert(make_pair(constantKeys.at(i), dynamic_pointer_cast<LiteralNode>(value)->getLiteralValue() == "true" ? 1 : 0));
+    } else {
+      storedValues.push_back(make_pair(layout.getSlot(constantKeys.at(i)), generateBeforeAllocation(value, valueWasmType)));
+    }
+  }
+
+  BinaryenExpressionRef dictAllocation[] = {
+    BinaryenConst(module, BinaryenLiteralInt32(layout.getByteSize())),
+    BinaryenConst(module, BinaryenLiteralInt32(HEAP_DATA))
+  };
+
+  expressions.push_back(BinaryenLocalSet(
+    module,
+    dictLocal,
+    BinaryenCall(module, GC_ALLOCATE_FN.c_str(), dictAllocation, 2, BinaryenTypeInt32())
+  ));
+
+  // The layout's segment is added once the functions are, see addReferences
+  BinaryenExpressionRef memoryInit = BinaryenMemoryInit(
+    module,
+    DICT_LAYOUT_SEGMENT_PREFIX.c_str(),
+    getDict(),
+    BinaryenConst(module, BinaryenLiteralInt32(0)),
+    BinaryenConst(module, BinaryenLiteralInt32(layout.getByteSize())),
+    MEMORY_NAME.c_str()
+  );
+  addReference({ Reference::DICTIONARY_LAYOUT, "", layout.toBytes(literalValues), memoryInit });
+  expressions.push_back(memoryInit);
+
+  for (auto &storedValue : storedValues) {
+    expressions.push_back(BinaryenStore(
+      module,
+      getByteSizeForType(valueWasmType),
+      layout.getEntryOffset(storedValue.first) + DictionaryLayout::VALUE_OFFSET,
+      0,
+      getDict(),
+      storedValue.second,
+      valueWasmType,
+      MEMORY_NAME.c_str()
+    ));
+  }
+
+  expressions.push_back(getDict());
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeInt32());
+}
+
+BinaryenExpressionRef CodeGen::generateSymbol(shared_ptr<SymbolNode> node, BinaryenModuleRef &module) {
+  return BinaryenConst(module, BinaryenLiteralInt32(getSymbolId(node->getSymbol())));
+}
+
+BinaryenExpressionRef CodeGen::generateTuple(shared_ptr<TupleNode> node, BinaryenModuleRef &module) {
+  BinaryenExpressionRef values[] = {
+    generate(node->getLeft(), module),
+    generate(node->getRight(), module)
+  };
+
+  return BinaryenTupleMake(module, values, 2);
+}
+
+BinaryenExpressionRef CodeGen::generateStructDeclaration(shared_ptr<StructDeclarationNode> node, BinaryenModuleRef &module) {
+  if (!currentFunction) {
+    throw runtime_error("Structs can only be allocated inside of a function");
+  }
+
+  const StructLayout &layout = getStructLayout(node->getStructType());
+  vector<shared_ptr<ASTNode>> entries = dynamic_pointer_cast<ASTNodeList>(node->getValue())->getElements();
+
+  vector<BinaryenExpressionRef> expressions;
+  vector<pair<const StructLayout::Field*, BinaryenExpressionRef>> fieldValues;
+
+  // Fields that call a function are evaluated before the struct is allocated, so nothing can collect while the struct
+  // is only held in a local
+  for (auto &entry : entries) {
+    const StructLayout::Field *field = layout.getField(dynamic_pointer_cast<SymbolNode>(entry->getLeft())->getSymbol().substr(1));
+    BinaryenType type = getBinaryenTypeFromTypeDeclaration(field->type);
+    BinaryenExpressionRef value = generate(entry->getRight(), module);
+
+    if (canCollect(entry->getRight())) {
+      BinaryenIndex valueLocal = addLocal(type);
+
+      expressions.push_back(BinaryenLocalSet(module, valueLocal, value));
+      value = BinaryenLocalGet(module, valueLocal, type);
+    }
+
+    fieldValues.push_back(make_pair(field, value));
+  }
+
+  BinaryenIndex structLocal = addLocal(BinaryenTypeInt32());
+  auto getStruct = [&module, structLocal]() { return BinaryenLocalGet(module, structLocal, BinaryenTypeInt32()); };
+
+  BinaryenExpressionRef structAllocation[] = {
+    BinaryenConst(module, BinaryenLiteralInt32(layout.byteSize)),
+    BinaryenConst(module, BinaryenLiteralInt32(HEAP_DATA))
+  };
+
+  expressions.push_back(BinaryenLocalSet(
+    module,
+    structLocal,
+    BinaryenCall(module, GC_ALLOCATE_FN.c_str(), structAllocation, 2, BinaryenTypeInt32())
+  ));
+
+  // Booleans are stored in a single byte
+  for (auto &fieldValue : fieldValues) {
+    expressions.push_back(BinaryenStore(
+      module,
+      fieldValue.first->size,
+      fieldValue.first->offset,
+      0,
+      getStruct(),
+      fieldValue.second,
+      getBinaryenTypeFromTypeDeclaration(fieldValue.first->type),
+      MEMORY_NAME.c_str()
+    ));
+  }
+
+  expressions.push_back(getStruct());
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeInt32());
+}
+
 BinaryenExpressionRef CodeGen::generateExponentOperation(shared_ptr<BinaryOperationNode> binOpNode, BinaryenModuleRef &module) {
-  BinaryenExpressionRef binaryenLeft = generate(binOpNode->getLeft(), module);
-  BinaryenExpressionRef binaryenRight = generate(binOpNode->getRight(), module);
+  shared_ptr<ASTNode> base = binOpNode->getLeft();
+  shared_ptr<ASTNode> exponent = binOpNode->getRight();
+
+  // Small constant powers of a variable are cheaper as a chain of multiplications than as a call. The base is read
+  // again for every multiplication, so it can't be anything that does work
+  if (base->getNodeType() == ASTNode::IDENTIFIER && exponent->getNodeType() == ASTNode::NUMBER_LITERAL) {
+    string exponentValue = dynamic_pointer_cast<LiteralNode>(exponent)->getLiteralValue();
+
+    // A literal longer than one digit is either negative or too big
+    if (exponentValue.size() == 1 && stoi(exponentValue) <= MAX_INLINED_EXPONENT) {
+      int power = stoi(exponentValue);
+
+      if (power == 0) return BinaryenConst(module, BinaryenLiteralInt64(1));
+
+      BinaryenExpressionRef product = generate(base, module);
+
+      for (int i = 1; i < power; i++) {
+        product = BinaryenBinary(module, BinaryenMulInt64(), product, generate(base, module));
+      }
+
+      return product;
+    }
+  }
+
+  BinaryenExpressionRef binaryenLeft = generate(base, module);
+  BinaryenExpressionRef binaryenRight = generate(exponent, module);
 
   if (!binaryenLeft || !binaryenRight) {
     throw runtime_error("Invalid operand types for binary operation");
@@ -1074,23 +2744,23 @@ BinaryenExpressionRef CodeGen::generateExponentOperation(shared_ptr<BinaryOperat
 
 void CodeGen::generateSource(shared_ptr<SourceNode> sourceNode, BinaryenModuleRef &module) {
   if (sourceNode->getValue()->getNodeType() != ASTNode::CAPSULE) {
+    size_t firstDebugLocation = debugLocations.size();
+    shared_ptr<TypeDeclarationNode> returnType = dynamic_pointer_cast<TypeDeclarationNode>(sourceNode->getValue()->getResolvedType());
+
+    enterFunction("main", getBinaryenTypeFromTypeDeclaration(returnType), {}, 0, {});
+
     BinaryenExpressionRef body = generate(sourceNode->getValue(), module);
 
     if (!body) {
       throw runtime_error("Invalid body type for source node");
     }
 
-    shared_ptr<TypeDeclarationNode> returnType = dynamic_pointer_cast<TypeDeclarationNode>(sourceNode->getValue()->getResolvedType());
+    body = generateFunctionFrame(body, module);
 
-    BinaryenFunctionRef mainFn = BinaryenAddFunction(
-      module,
-      "main",
-      BinaryenTypeNone(),
-      getBinaryenTypeFromTypeDeclaration(returnType),
-      NULL,
-      0,
-      body
-    );
+    keepGeneratedFunction("main", BinaryenTypeNone(), getAddedLocalTypes(), body, firstDebugLocation);
+    currentFunction = nullopt;
+
+    addGeneratedFunction(*this, "main", module);
 
     BinaryenAddFunctionExport(module, "main", "main");
   } else {
@@ -1098,44 +2768,6 @@ void CodeGen::generateSource(shared_ptr<SourceNode> sourceNode, BinaryenModuleRe
   }
 }
 
-vector<BinaryenExpressionRef> CodeGen::generateClosureMemoryStore(WasmClosure &closure, BinaryenModuleRef &module) {
-  // At least 4 bytes for the fn_idx and 4 bytes for the arity. Then 4 bytes for each parameter the closure takes.
-  // We also multiply the remaining arity, since not all parameters may have been applied to the function
-  int totalMemSize = 8 + (closure.getArgPointers().size() * 4) + (closure.getArity() * 4);
-  int memLocation = memoryOffset;
-
-  memoryOffset += totalMemSize;
-
-  vector<int> closureDataSegments = { closure.getFunctionPointer().getAddress(), closure.getArity() };
-  for (int i = 0; i < closure.getArgPointers().size(); i++) {
-    closureDataSegments.push_back(closure.getArgPointers().at(i).getAddress());
-  }
-
-  vector<BinaryenExpressionRef> expressions;
-
-  for (int i = 0; i < closureDataSegments.size(); i++) {
-    // Don't store uninitialized pointers
-    if (closureDataSegments.at(i) == -1) continue;
-
-    expressions.push_back(
-      BinaryenStore(
-        module,
-        4,
-        i * 4,
-        0,
-        BinaryenConst(module, BinaryenLiteralInt32(memLocation)),
-        BinaryenConst(module, BinaryenLiteralInt32(closureDataSegments.at(i))),
-        BinaryenTypeInt32(),
-        MEMORY_NAME.c_str()
-      )
-    );
-  }
-
-  closure.setAddress(memLocation);
-
-  return expressions;
-}
-
 BinaryenOp CodeGen::getBinaryenOpFromBinOpNode(shared_ptr<BinaryOperationNode> binOpNode) {
   string op = binOpNode->getOperator();
 
@@ -1151,6 +2783,8 @@ BinaryenOp CodeGen::getBinaryenOpFromBinOpNode(shared_ptr<BinaryOperationNode> b
   if (op == Lexemes::EQUALITY && dataType == DataTypes::BOOLEAN) return BinaryenEqInt32();
   if (op == Lexemes::INEQUALITY && dataType == DataTypes::NUMBER) return BinaryenNeInt64();
   if (op == Lexemes::INEQUALITY && dataType == DataTypes::BOOLEAN) return BinaryenEqInt32();
+  if (op == Lexemes::EQUALITY && dataType == DataTypes::SYMBOL) return BinaryenEqInt32();
+  if (op == Lexemes::INEQUALITY && dataType == DataTypes::SYMBOL) return BinaryenNeInt32();
   if (op == Lexemes::LT && dataType == DataTypes::NUMBER) return BinaryenLtSInt64();
   if (op == Lexemes::GT && dataType == DataTypes::NUMBER) return BinaryenGtSInt64();
   if (op == Lexemes::LTEQ && dataType == DataTypes::NUMBER) return BinaryenLeSInt64();
@@ -1167,6 +2801,34 @@ BinaryenType CodeGen::getBinaryenTypeFromTypeDeclaration(shared_ptr<TypeDeclarat
   // Function references are returned as i32 pointers to a closure in the function table
   if (typeDeclaration->getType() == DataTypes::FUNCTION) return BinaryenTypeInt32();
 
+  // Lists are i32 pointers to their length, followed by their elements
+  if (typeDeclaration->getType() == DataTypes::LIST) return BinaryenTypeInt32();
+
+  // Dictionaries are i32 pointers to their hash table, and symbols the keys they're stored under
+  if (typeDeclaration->getType() == DataTypes::DICT) return BinaryenTypeInt32();
+  if (typeDeclaration->getType() == DataTypes::SYMBOL) return BinaryenTypeInt32();
+
+  // Structs are i32 pointers to their fields
+  if (TypeChecker::isStructType(typeDeclaration->getType())) return BinaryenTypeInt32();
+
+  // Tuples are multi-values, one value per element. Their elements can't point into the heap, since the collector
+  // only knows about locals that hold a single pointer
+  if (typeDeclaration->getType() == DataTypes::TUPLE) {
+    vector<BinaryenType> elementTypes;
+
+    for (auto &element : typeDeclaration->getElements()) {
+      shared_ptr<TypeDeclarationNode> elementType = dynamic_pointer_cast<TypeDeclarationNode>(element);
+
+      if (isHeapReference(elementType) || elementType->getType() == DataTypes::TUPLE) {
+        throw runtime_error("Tuples can't hold a " + elementType->toString());
+      }
+
+      elementTypes.push_back(getBinaryenTypeFromTypeDeclaration(elementType));
+    }
+
+    return BinaryenTypeCreate(elementTypes.data(), elementTypes.size());
+  }
+
   throw runtime_error("No matching WASM type for TypeDeclaration: " + typeDeclaration->getType());
 }
 
@@ -1190,6 +2852,11 @@ FunctionMetaData CodeGen::getFunctionMetaData(shared_ptr<Function> functionNode)
           : functionNode->getParameters()->getElements().at(i)->getValue()
       )
     );
+
+    // A function's params are a tuple of their own, which can't hold another one
+    if (BinaryenTypeArity(paramTypes[i]) > 1) {
+      throw runtime_error("Tuples can only be returned from functions, not passed to them");
+    }
   }
 
   BinaryenType returnType = getBinaryenTypeFromTypeDeclaration(TypeChecker::getFunctionReturnType(functionNode));
@@ -1260,7 +2927,16 @@ void CodeGen::hoistCapsuleElements(vector<shared_ptr<ASTNode>> elements) {
   scope.enterScope();
   scopeReferences.enterScope();
 
-  for (auto ast : elements) bindIdentifierToScope(ast);
+  for (auto ast : elements) {
+    if (ast->getNodeType() == ASTNode::STRUCT_DEFINITION) {
+      shared_ptr<StructDefinitionNode> definition = dynamic_pointer_cast<StructDefinitionNode>(ast);
+      structDefinitions.insert(make_pair(definition->getName(), definition));
+
+      continue;
+    }
+
+    bindIdentifierToScope(ast);
+  }
 }
 
 void CodeGen::bindIdentifierToScope(shared_ptr<ASTNode> ast) {
@@ -1284,27 +2960,40 @@ void CodeGen::registerModuleFunctions(BinaryenModuleRef &module) {
   BinaryenAddTable(
     module,
     FN_TABLE_NAME.c_str(),
-    functionNameToClosureTemplateMap.size(),
-    functionNameToClosureTemplateMap.size(),
+    tableFunctions.size(),
+    tableFunctions.size(),
     BinaryenTypeFuncref()
   );
 
-  const char** fnNames = new const char*[functionNameToClosureTemplateMap.size()];
-
-  for (auto& [fnName, fnRef] : functionNameToClosureTemplateMap) {
-    fnNames[fnRef.getFunctionPointer().getAddress()] = fnName.c_str();
-  }
+  vector<const char*> fnNames;
+  for (const string &fnName : tableFunctions) fnNames.push_back(fnName.c_str());
 
   BinaryenAddActiveElementSegment(
     module,
     FN_TABLE_NAME.c_str(),
     "0",
-    fnNames,
-    functionNameToClosureTemplateMap.size(),
+    fnNames.data(),
+    fnNames.size(),
     BinaryenConst(module, BinaryenLiteralInt32(0))
   );
 }
 
+int CodeGen::getTableSlot(const string &functionName) {
+  auto slot = tableSlots.find(functionName);
+  if (slot != tableSlots.end()) return slot->second;
+
+  tableFunctions.push_back(functionName);
+  tableSlots.insert(make_pair(functionName, tableFunctions.size() - 1));
+
+  return tableFunctions.size() - 1;
+}
+
+void CodeGen::removeUnusedModuleElements(BinaryenModuleRef &module) {
+  const char *passes[] = { "remove-unused-module-elements" };
+
+  BinaryenModuleRunPasses(module, passes, 1);
+}
+
 bool CodeGen::checkIsLastInBlock(shared_ptr<ASTNode> node) {
   if (node->getParent() == nullptr) return false;
   if (!node->getParent()->hasMany()) return false;
@@ -1313,10 +3002,510 @@ bool CodeGen::checkIsLastInBlock(shared_ptr<ASTNode> node) {
   return node->getId() == dynamic_pointer_cast<ASTNodeList>(node->getParent())->getElements().back()->getId();
 }
 
+bool CodeGen::isInTailPosition(shared_ptr<ASTNode> node) {
+  shared_ptr<ASTNode> parent = node->getParent();
+
+  while (parent) {
+    if (parent->getNodeType() == ASTNode::RETURN || parent->getNodeType() == ASTNode::FUNCTION_DECLARATION) return true;
+
+    if (parent->getNodeType() == ASTNode::BLOCK) {
+      if (dynamic_pointer_cast<ASTNodeList>(parent)->getElements().back()->getId() != node->getId()) return false;
+    } else if (parent->getNodeType() == ASTNode::CONTROL_FLOW) {
+      for (auto &conditionExpressionPair : dynamic_pointer_cast<ControlFlowNode>(parent)->getConditionExpressionPairs()) {
+        if (conditionExpressionPair.first && conditionExpressionPair.first->getId() == node->getId()) return false;
+      }
+    } else {
+      return false;
+    }
+
+    node = parent;
+    parent = node->getParent();
+  }
+
+  return false;
+}
+
+BinaryenExpressionRef CodeGen::generateSelfTailCall(shared_ptr<FunctionInvocationNode> funcInvNode, BinaryenModuleRef &module) {
+  vector<shared_ptr<ASTNode>> args = funcInvNode->getParameters()->getElements();
+  vector<BinaryenExpressionRef> expressions;
+
+  vector<Operand> operands;
+  for (auto arg : args) operands.push_back(makeOperand(arg));
+
+  vector<BinaryenExpressionRef> operandExpressions = generateOperands(operands, true, expressions, module);
+
+  // The arguments may still read the parameters, so every one of them is evaluated before any parameter is overwritten.
+  // The start of the loop keeps the new parameters in the frame
+  for (int i = 0; i < args.size(); i++) {
+    expressions.push_back(BinaryenLocalSet(module, currentFunction->firstScratchLocal + i, operandExpressions.at(i)));
+  }
+
+  for (int i = 0; i < args.size(); i++) {
+    expressions.push_back(BinaryenLocalSet(
+      module,
+      i,
+      BinaryenLocalGet(module, currentFunction->firstScratchLocal + i, currentFunction->paramTypes.at(i))
+    ));
+  }
+
+  expressions.push_back(BinaryenBreak(module, TAIL_CALL_LOOP_LABEL.c_str(), NULL, NULL));
+
+  currentFunction->hasSelfTailCall = true;
+
+  BinaryenExpressionRef* blockExpressions = new BinaryenExpressionRef[expressions.size()];
+  for (int i = 0; i < expressions.size(); i++) {
+    blockExpressions[i] = expressions.at(i);
+  }
+
+  return BinaryenBlock(module, NULL, blockExpressions, expressions.size(), BinaryenTypeUnreachable());
+}
+
+CodeGen::Operand CodeGen::makeOperand(shared_ptr<ASTNode> node) {
+  shared_ptr<TypeDeclarationNode> type = dynamic_pointer_cast<TypeDeclarationNode>(node->getResolvedType());
+
+  return { node, nullptr, getBinaryenTypeFromTypeDeclaration(type), isHeapReference(type), canCollect(node) };
+}
+
+vector<BinaryenExpressionRef> CodeGen::generateOperands(
+  vector<Operand> operands,
+  bool isTailCall,
+  vector<BinaryenExpressionRef> &prefix,
+  BinaryenModuleRef &module
+) {
+  int lastCollecting = -1;
+  bool hasHeapReferenceBeforeCollection = false;
+
+  for (int i = 0; i < operands.size(); i++) {
+    if (operands.at(i).canCollect) lastCollecting = i;
+  }
+
+  for (int i = 0; i < lastCollecting; i++) {
+    if (operands.at(i).isHeapReference) hasHeapReferenceBeforeCollection = true;
+  }
+
+  // Only the operands that can collect are evaluated first. The rest are left in place and evaluated after the last
+  // collection, so any heap reference they read from a local has already been loaded from the frame again
+  bool evaluateFirst = currentFunction && lastCollecting != -1 && (isTailCall || hasHeapReferenceBeforeCollection);
+
+  vector<BinaryenExpressionRef> expressions;
+
+  for (Operand &operand : operands) {
+    BinaryenExpressionRef value = operand.node ? generate(operand.node, module) : operand.expression;
+
+    if (!evaluateFirst || !operand.canCollect) {
+      expressions.push_back(value);
+    } else if (operand.isHeapReference) {
+      int slot = currentFunction->frameSlots++;
+
+      prefix.push_back(BinaryenStore(
+        module,
+        4,
+        slot * 4,
+        0,
+        BinaryenLocalGet(module, currentFunction->frameLocal, BinaryenTypeInt32()),
+        value,
+        BinaryenTypeInt32(),
+        MEMORY_NAME.c_str()
+      ));
+
+      expressions.push_back(BinaryenLoad(
+        module,
+        4,
+        false,
+        slot * 4,
+        0,
+        BinaryenTypeInt32(),
+        BinaryenLocalGet(module, currentFunction->frameLocal, BinaryenTypeInt32()),
+        MEMORY_NAME.c_str()
+      ));
+    } else {
+      BinaryenIndex local = addLocal(operand.type);
+
+      prefix.push_back(BinaryenLocalSet(module, local, value));
+      expressions.push_back(BinaryenLocalGet(module, local, operand.type));
+    }
+  }
+
+  return expressions;
+}
+
+BinaryenExpressionRef CodeGen::generateClosureAllocation(
+  const string &functionName,
+  int arity,
+  vector<BinaryenExpressionRef> boundArgs,
+  vector<shared_ptr<TypeDeclarationNode>> boundArgTypes,
+  BinaryenModuleRef &module
+) {
+  if (!currentFunction) {
+    throw runtime_error("Closures can only be allocated inside of a function");
+  }
+
+  // Nothing in here can collect, so the closure can stay in a local without being kept in the frame
+  BinaryenIndex closureLocal = addLocal(BinaryenTypeInt32());
+  auto getClosure = [&module, closureLocal]() { return BinaryenLocalGet(module, closureLocal, BinaryenTypeInt32()); };
+
+  BinaryenExpressionRef closureAllocation[] = {
+    BinaryenConst(module, BinaryenLiteralInt32(8 + arity * 4)),
+    BinaryenConst(module, BinaryenLiteralInt32(HEAP_CLOSURE))
+  };
+
+  // The function's table slot is filled in once the functions are added, see addReferences
+  BinaryenExpressionRef functionIndex = BinaryenConst(module, BinaryenLiteralInt32(0));
+  addReference({ Reference::TABLE_SLOT, functionName, "", functionIndex });
+
+  vector<BinaryenExpressionRef> expressions = {
+    BinaryenLocalSet(
+      module,
+      closureLocal,
+      BinaryenCall(module, GC_ALLOCATE_FN.c_str(), closureAllocation, 2, BinaryenTypeInt32())
+    ),
+    BinaryenStore(
+      module,
+      4,
+      0,
+      0,
+      getClosure(),
+      functionIndex,
+      BinaryenTypeInt32(),
+      MEMORY_NAME.c_str()
+    ),
+    BinaryenStore(
+      module,
+      4,
+      4,
+      0,
+      getClosure(),
+      BinaryenConst(module, BinaryenLiteralInt32(arity - boundArgs.size())),
+      BinaryenTypeInt32(),
+      MEMORY_NAME.c_str()
+    )
+  };
+
+  // Each argument gets a cell of its own on the heap, which the closure points to
+  for (int i = 0; i < boundArgs.size(); i++) {
+    shared_ptr<TypeDeclarationNode> argType = boundArgTypes.at(i);
+    int argPointerOffset = 8 + (arity - 1 - i) * 4;
+    int byteSize = getByteSizeForType(argType);
+
+    BinaryenExpressionRef cellAllocation[] = {
+      BinaryenConst(module, BinaryenLiteralInt32(byteSize)),
+      BinaryenConst(module, BinaryenLiteralInt32(getHeapKind(argType)))
+    };
+
+    expressions.push_back(BinaryenStore(
+      module,
+      4,
+      argPointerOffset,
+      0,
+      getClosure(),
+      BinaryenCall(module, GC_ALLOCATE_FN.c_str(), cellAllocation, 2, BinaryenTypeInt32()),
+      BinaryenTypeInt32(),
+      MEMORY_NAME.c_str()
+    ));
+
+    BinaryenExpressionRef value = boundArgs.at(i);
+    if (argType->getType() == DataTypes::STRING) {
+      value = BinaryenCall(module, STRINGS_STORE_FN.c_str(), &value, 1, BinaryenTypeInt32());
+    }
+
+    expressions.push_back(BinaryenStore(
+      module,
+      byteSize,
+      0,
+      0,
+      BinaryenLoad(module, 4, false, argPointerOffset, 0, BinaryenTypeInt32(), getClosure(), MEMORY_NAME.c_str()),
+      value,
+      getBinaryenStorageTypeFromTypeDeclaration(argType),
+      MEMORY_NAME.c_str()
+    ));
+  }
+
+  expressions.push_back(getClosure());
+
+  return BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeInt32());
+}
+
+BinaryenExpressionRef CodeGen::generateCollectingCall(BinaryenExpressionRef call, BinaryenModuleRef &module) {
+  BinaryenExpressionRef reload = generateHeapLocalReload(module);
+
+  if (!reload) return call;
+
+  BinaryenType type = BinaryenExpressionGetType(call);
+  BinaryenIndex valueLocal = getValueLocal(type);
+
+  BinaryenExpressionRef expressions[] = {
+    BinaryenLocalSet(module, valueLocal, call),
+    reload,
+    BinaryenLocalGet(module, valueLocal, type)
+  };
+
+  return BinaryenBlock(module, NULL, expressions, 3, type);
+}
+
+BinaryenExpressionRef CodeGen::generateLocalSet(
+  BinaryenIndex index,
+  BinaryenExpressionRef value,
+  bool holdsHeapReference,
+  BinaryenModuleRef &module
+) {
+  int slot = holdsHeapReference && currentFunction ? getFrameSlot(index) : -1;
+
+  if (slot == -1) return BinaryenLocalSet(module, index, value);
+
+  return BinaryenStore(
+    module,
+    4,
+    slot * 4,
+    0,
+    BinaryenLocalGet(module, currentFunction->frameLocal, BinaryenTypeInt32()),
+    BinaryenLocalTee(module, index, value, BinaryenTypeInt32()),
+    BinaryenTypeInt32(),
+    MEMORY_NAME.c_str()
+  );
+}
+
+BinaryenExpressionRef CodeGen::generateHeapLocalReload(BinaryenModuleRef &module) {
+  if (!currentFunction || currentFunction->heapLocals.empty()) return nullptr;
+
+  vector<BinaryenExpressionRef> expressions = {
+    BinaryenLocalSet(module, currentFunction->epochLocal, BinaryenGlobalGet(module, GC_EPOCH.c_str(), BinaryenTypeInt32()))
+  };
+
+  for (int i = 0; i < currentFunction->heapLocals.size(); i++) {
+    expressions.push_back(BinaryenLocalSet(
+      module,
+      currentFunction->heapLocals.at(i),
+      BinaryenLoad(
+        module,
+        4,
+        false,
+        i * 4,
+        0,
+        BinaryenTypeInt32(),
+        BinaryenLocalGet(module, currentFunction->frameLocal, BinaryenTypeInt32()),
+        MEMORY_NAME.c_str()
+      )
+    ));
+  }
+
+  // The frame only has to be read if there was a collection since it was last read
+  return BinaryenIf(
+    module,
+    BinaryenBinary(
+      module,
+      BinaryenNeInt32(),
+      BinaryenGlobalGet(module, GC_EPOCH.c_str(), BinaryenTypeInt32()),
+      BinaryenLocalGet(module, currentFunction->epochLocal, BinaryenTypeInt32())
+    ),
+    BinaryenBlock(module, NULL, expressions.data(), expressions.size(), BinaryenTypeNone()),
+    NULL
+  );
+}
+
+BinaryenExpressionRef CodeGen::generateFramePop(BinaryenModuleRef &module) {
+  if (!currentFunction) return BinaryenNop(module);
+
+  return BinaryenGlobalSet(
+    module,
+    GC_SHADOW_STACK_POINTER.c_str(),
+    BinaryenLocalGet(module, currentFunction->frameLocal, BinaryenTypeInt32())
+  );
+}
+
+BinaryenExpressionRef CodeGen::generatePoppingFrame(BinaryenExpressionRef value, BinaryenModuleRef &module) {
+  if (!currentFunction) return value;
+
+  BinaryenIndex valueLocal = getValueLocal(currentFunction->returnType);
+
+  BinaryenExpressionRef expressions[] = {
+    BinaryenLocalSet(module, valueLocal, value),
+    generateFramePop(module),
+    BinaryenLocalGet(module, valueLocal, currentFunction->returnType)
+  };
+
+  return BinaryenBlock(module, NULL, expressions, 3, currentFunction->returnType);
+}
+
+BinaryenExpressionRef CodeGen::generateFunctionFrame(BinaryenExpressionRef body, BinaryenModuleRef &module) {
+  vector<BinaryenExpressionRef> expressions;
+
+  // Parameters come first in the heap locals, since their indices are the lowest
+  for (int i = 0; i < currentFunction->heapLocals.size(); i++) {
+    if (currentFunction->heapLocals.at(i) >= currentFunction->paramTypes.size()) break;
+
+    expressions.push_back(BinaryenStore(
+      module,
+      4,
+      i * 4,
+      0,
+      BinaryenLocalGet(module, currentFunction->frameLocal, BinaryenTypeInt32()),
+      BinaryenLocalGet(module, currentFunction->heapLocals.at(i), BinaryenTypeInt32()),
+      BinaryenTypeInt32(),
+      MEMORY_NAME.c_str()
+    ));
+  }
+
+  expressions.push_back(
+    BinaryenLocalSet(module, currentFunction->epochLocal, BinaryenGlobalGet(module, GC_EPOCH.c_str(), BinaryenTypeInt32()))
+  );
+
+  // Allocating never collects. Once the heap is half full, the next function to start collects instead
+  expressions.push_back(BinaryenIf(
+    module,
+    BinaryenGlobalGet(module, GC_IS_COLLECTION_REQUESTED.c_str(), BinaryenTypeInt32()),
+    BinaryenCall(module, GC_COLLECT_FN.c_str(), NULL, 0, BinaryenTypeNone()),
+    NULL
+  ));
+
+  BinaryenExpressionRef reload = generateHeapLocalReload(module);
+  if (reload) expressions.push_back(reload);
+
+  expressions.push_back(generatePoppingFrame(body, module));
+
+  BinaryenExpressionRef frameBody = BinaryenBlock(
+    module,
+    NULL,
+    expressions.data(),
+    expressions.size(),
+    currentFunction->returnType
+  );
+
+  // A self call in tail position branches back here, having set the parameters through a scratch local per parameter
+  if (currentFunction->hasSelfTailCall) {
+    frameBody = BinaryenLoop(module, TAIL_CALL_LOOP_LABEL.c_str(), frameBody);
+  }
+
+  // A frame without slots is just the shadow stack pointer, so popping it leaves the shadow stack as it was
+  BinaryenExpressionRef frame;
+  if (currentFunction->frameSlots == 0) {
+    frame = BinaryenGlobalGet(module, GC_SHADOW_STACK_POINTER.c_str(), BinaryenTypeInt32());
+  } else {
+    BinaryenExpressionRef slots = BinaryenConst(module, BinaryenLiteralInt32(currentFunction->frameSlots));
+
+    frame = BinaryenCall(module, GC_PUSH_FRAME_FN.c_str(), &slots, 1, BinaryenTypeInt32());
+  }
+
+  BinaryenExpressionRef functionExpressions[] = {
+    BinaryenLocalSet(module, currentFunction->frameLocal, frame),
+    frameBody
+  };
+
+  return BinaryenBlock(module, NULL, functionExpressions, 2, currentFunction->returnType);
+}
+
+void CodeGen::enterFunction(
+  string name,
+  BinaryenType returnType,
+  vector<BinaryenType> paramTypes,
+  BinaryenIndex firstScratchLocal,
+  vector<BinaryenIndex> heapLocals
+) {
+  currentFunction = FunctionContext();
+  currentFunction->name = name;
+  currentFunction->returnType = returnType;
+  currentFunction->paramTypes = paramTypes;
+  currentFunction->firstScratchLocal = firstScratchLocal;
+  currentFunction->hasSelfTailCall = false;
+  currentFunction->heapLocals = heapLocals;
+  currentFunction->frameSlots = heapLocals.size();
+  currentFunction->frameLocal = addLocal(BinaryenTypeInt32());
+  currentFunction->epochLocal = addLocal(BinaryenTypeInt32());
+}
+
+vector<BinaryenType> CodeGen::getAddedLocalTypes() {
+  vector<BinaryenType> localTypes = currentFunction->paramTypes;
+
+  localTypes.insert(localTypes.end(), currentFunction->addedLocalTypes.begin(), currentFunction->addedLocalTypes.end());
+
+  return localTypes;
+}
+
+BinaryenIndex CodeGen::addLocal(BinaryenType type) {
+  // The scratch locals of self tail calls come first, one per parameter
+  BinaryenIndex index = (
+    currentFunction->firstScratchLocal +
+    currentFunction->paramTypes.size() +
+    currentFunction->addedLocalTypes.size()
+  );
+
+  currentFunction->addedLocalTypes.push_back(type);
+
+  return index;
+}
+
+BinaryenIndex CodeGen::getValueLocal(BinaryenType type) {
+  auto found = currentFunction->valueLocals.find(type);
+  if (found != currentFunction->valueLocals.end()) return found->second;
+
+  BinaryenIndex index = addLocal(type);
+  currentFunction->valueLocals.insert(make_pair(type, index));
+
+  return index;
+}
+
+int CodeGen::getFrameSlot(BinaryenIndex heapLocal) {
+  for (int i = 0; i < currentFunction->heapLocals.size(); i++) {
+    if (currentFunction->heapLocals.at(i) == heapLocal) return i;
+  }
+
+  return -1;
+}
+
+bool CodeGen::isHeapReference(shared_ptr<TypeDeclarationNode> type) {
+  // Functions are passed around as pointers to their closure, lists as pointers to their elements, dictionaries as
+  // pointers to their hash table, and structs as pointers to their fields
+  return type && (
+    type->getType() == DataTypes::FUNCTION ||
+    type->getType() == DataTypes::LIST ||
+    type->getType() == DataTypes::DICT ||
+    TypeChecker::isStructType(type->getType())
+  );
+}
+
+int CodeGen::getHeapKind(shared_ptr<TypeDeclarationNode> type) {
+  if (isHeapReference(type)) return HEAP_REFERENCE;
+
+  // The collector frees the string table index of every string cell that doesn't survive a collection
+  if (type && type->getType() == DataTypes::STRING) return HEAP_STRING;
+
+  return HEAP_DATA;
+}
+
+bool CodeGen::canCollect(shared_ptr<ASTNode> node) {
+  if (!node) return false;
+
+  // Declaring a closure evaluates what it captures from the enclosing scope, which may itself call a function
+  if (
+    node->getNodeType() == ASTNode::FUNCTION_INVOCATION ||
+    node->getNodeType() == ASTNode::FUNCTION_DECLARATION
+  ) return true;
+
+  if (node->getNodeType() == ASTNode::CONTROL_FLOW) {
+    for (auto &conditionExpressionPair : dynamic_pointer_cast<ControlFlowNode>(node)->getConditionExpressionPairs()) {
+      if (canCollect(conditionExpressionPair.first) || canCollect(conditionExpressionPair.second)) return true;
+    }
+
+    return false;
+  }
+
+  if (node->hasMany()) {
+    for (auto &elem : dynamic_pointer_cast<ASTNodeList>(node)->getElements()) {
+      if (canCollect(elem)) return true;
+    }
+  }
+
+  return canCollect(node->getValue()) || canCollect(node->getLeft()) || canCollect(node->getRight());
+}
+
 int CodeGen::getByteSizeForType(shared_ptr<TypeDeclarationNode> type) {
   if (type->getType() == DataTypes::NUMBER) return 8;
   if (type->getType() == DataTypes::BOOLEAN) return 4;
   if (type->getType() == DataTypes::STRING) return 4; 
+  if (type->getType() == DataTypes::FUNCTION) return 4;
+  if (type->getType() == DataTypes::LIST) return 4;
+  if (type->getType() == DataTypes::DICT) return 4;
+  if (type->getType() == DataTypes::SYMBOL) return 4;
+  if (TypeChecker::isStructType(type->getType())) return 4;
 
   cout << "Not implemented for type: " << type->getType() << endl;
   throw new runtime_error("Not implemented");
@@ -1331,42 +3520,31 @@ int CodeGen::getByteSizeForType(BinaryenType type) {
   throw new runtime_error("Not implemented");
 }
 
-BinaryenModuleRef CodeGen::importCoreLangWasm() {
-  ifstream file(Compiler::resolveAbsolutePath("wasm/ThetaLangCore.wat"), ios::binary);
-  if (!file.is_open()) {
-    cerr << "Failed to open the file." << endl;
-    return nullptr;
-  }
+BinaryenModuleRef CodeGen::getCoreLangWasm() {
+  // The core module is assembled at build time and embedded in the compiler, and only read once per process
+  static BinaryenModuleRef coreModule = BinaryenModuleReadWithFeatures(
+    reinterpret_cast<char*>(const_cast<unsigned char*>(THETA_LANG_CORE_WASM)),
+    THETA_LANG_CORE_WASM_SIZE,
+    BinaryenFeatureAll()
+  );
+
+  return coreModule;
+}
 
-  vector<char> buffer(istreambuf_iterator<char>(file), {});
+BinaryenModuleRef CodeGen::importCoreLangWasm() {
+  BinaryenModuleRef coreModule = getCoreLangWasm();
 
-  if (buffer.empty()) {
-    cerr << "Failed to read the file or the file is empty." << endl;
+  if (!coreModule) {
+    cerr << "Failed to load the core language module." << endl;
     return nullptr;
   }
 
-  // Add a null terminator at the end
-  buffer.push_back('\0');
+  // Code generation adds to the module it's given, so every compile gets its own copy
+  BinaryenModuleRef module = BinaryenModuleCreate();
 
-  BinaryenModuleRef module = BinaryenModuleParse(buffer.data());
-
-  file.close();
+  wasm::ModuleUtils::copyModule(*reinterpret_cast<wasm::Module*>(coreModule), *reinterpret_cast<wasm::Module*>(module));
 
   return module;
 }
 
-string CodeGen::generateFunctionHash(shared_ptr<FunctionDeclarationNode> function) {
-  hash<string> hasher;
-
-  size_t hashed = hasher(function->toJSON());
-
-  ostringstream stream;
-
-  stream << hex << nouppercase << setw(sizeof(size_t) * 2) << setfill('0');
-
-  stream << hashed;
-
-  return stream.str();
-}
-
 #pragma pop_macro("RETURN")
@@ -18,8 +18,24 @@
 #include "parser/ast/TypeDeclarationNode.hpp"
 #include "parser/ast/FunctionInvocationNode.hpp"
 #include "parser/ast/ControlFlowNode.hpp"
+#include "parser/ast/ListNode.hpp"
+#include "parser/ast/DictionaryNode.hpp"
+#include "parser/ast/SymbolNode.hpp"
+#include "parser/ast/TupleNode.hpp"
+#include "parser/ast/StructDeclarationNode.hpp"
+#include "parser/ast/StructDefinitionNode.hpp"
+#include "parser/ast/ASTVisitor.hpp"
 #include "compiler/FunctionMetaData.hpp"
+#include "compiler/ListIntrinsics.hpp"
+#include "compiler/DictIntrinsics.hpp"
+#include "compiler/TupleIntrinsics.hpp"
+#include "compiler/StringIntrinsics.hpp"
+#include "compiler/HostFunction.hpp"
+#include "compiler/DictionaryLayout.hpp"
+#include "compiler/StructLayout.hpp"
+#include "compiler/StructuralHasher.hpp"
 #include <binaryen-c.h>
+#include <mutex>
 #include <set>
 #include <unordered_map>
 #include <optional>
@@ -27,20 +43,51 @@
 using namespace std;
 
 namespace Theta {
-  class CodeGen {
+  class CodeGen : public ASTVisitor<CodeGen, BinaryenExpressionRef, BinaryenModuleRef&> {
   public:
     BinaryenModuleRef generateWasmFromAST(shared_ptr<ASTNode> ast);
     BinaryenExpressionRef generate(shared_ptr<ASTNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Makes generated expressions remember where in the given source file they came from, so that a source map
+     * can be written along with the module. Must be called before generateWasmFromAST.
+     * @param file The source file, as it should appear in the source map.
+     */
+    void setDebugInfoFile(string file) { debugInfoFile = file; }
     void generateCapsule(shared_ptr<CapsuleNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateAssignment(shared_ptr<AssignmentNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateBlock(shared_ptr<ASTNodeList> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateReturn(shared_ptr<ReturnNode> node, BinaryenModuleRef &module);
-    void generateFunctionDeclaration(
+    /**
+     * @brief Generates a function, keeping it to be added to the module once every function is generated, see
+     * addGeneratedFunction.
+     * @return The name the function is generated as
+     */
+    string generateFunctionDeclaration(
       string identifier, 
       shared_ptr<FunctionDeclarationNode> node,
-      BinaryenModuleRef &module,
-      bool addToExports = false
+      BinaryenModuleRef &module
     );
+
+    /**
+     * @brief Generates the function a memoized function is called by, which looks its arguments up in the function's
+     * memo table, and only calls the function itself if it doesn't find them, storing what it returns. The function
+     * is generated under another name, and its body still calls it by its own name, so its recursive calls are looked
+     * up too.
+     *
+     * @param functionName The name of the function, which the lookup is generated under.
+     * @param uncachedName The name the function itself was generated under.
+     * @param paramTypes The types of its parameters.
+     * @param returnType The type it returns.
+     */
+    void generateMemoizedFunction(
+      string functionName,
+      string uncachedName,
+      vector<BinaryenType> paramTypes,
+      BinaryenType returnType,
+      BinaryenModuleRef &module
+    );
+
     BinaryenExpressionRef generateClosureFunctionDeclaration(
       shared_ptr<FunctionDeclarationNode> node,
       BinaryenModuleRef &module,
@@ -49,11 +96,89 @@ namespace Theta {
     );
     BinaryenExpressionRef generateFunctionInvocation(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateControlFlow(shared_ptr<ControlFlowNode> controlFlowNode, BinaryenModuleRef &module);
+
+    struct JumpTableCase {
+      int64_t constant;
+      shared_ptr<ASTNode> body;
+      string label;
+    };
+
+    /**
+     * @brief Collects the cases of an if / else if chain whose conditions all compare the same identifier to a
+     * Number, Boolean or Symbol literal, such as the elements of an enum once they're inlined. Cases comparing against
+     * a constant an earlier case already matches are left out, since they can never run.
+     *
+     * @return The identifier compared against, or nullptr if the chain has no else branch, any other condition, or
+     * fewer than MIN_JUMP_TABLE_CASES cases
+     */
+    shared_ptr<IdentifierNode> collectJumpTableCases(shared_ptr<ControlFlowNode> controlFlowNode, vector<JumpTableCase> &cases);
+
+    /**
+     * @brief The value a literal has as a case of a jump table, if it's one that can be.
+     */
+    optional<int64_t> getJumpTableConstant(shared_ptr<ASTNode> node);
+
+    /**
+     * @brief Generates a chain collected by collectJumpTableCases as a block per case, which the identifier's value
+     * branches to. Cases whose constants are close together branch with a br_table, and spread out ones with a binary
+     * search tree of compares.
+     */
+    BinaryenExpressionRef generateJumpTable(
+      shared_ptr<IdentifierNode> scrutinee,
+      vector<JumpTableCase> &cases,
+      shared_ptr<ASTNode> defaultBody,
+      BinaryenModuleRef &module
+    );
+
+    /**
+     * @brief Generates the compares between sortedCases[low] and sortedCases[high - 1] of a jump table's search tree,
+     * branching to the default label if none of them match.
+     */
+    BinaryenExpressionRef generateJumpTableSearch(
+      shared_ptr<IdentifierNode> scrutinee,
+      vector<JumpTableCase> &sortedCases,
+      int low,
+      int high,
+      const string &defaultLabel,
+      BinaryenModuleRef &module
+    );
     BinaryenExpressionRef generateIdentifier(shared_ptr<IdentifierNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateBinaryOperation(shared_ptr<BinaryOperationNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateUnaryOperation(shared_ptr<UnaryOperationNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateNumberLiteral(shared_ptr<LiteralNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateStringLiteral(shared_ptr<LiteralNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Generates a list of Numbers or Booleans as a single heap object: its length, followed by its elements,
+     * unboxed and next to each other from LIST_ELEMENTS_OFFSET on.
+     */
+    BinaryenExpressionRef generateList(shared_ptr<ListNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Generates a dictionary of Numbers or Booleans as a hash table on the heap, see DictionaryLayout. If every
+     * key is a symbol, the table is laid out at compile time and copied in from a data segment, and only the values
+     * that aren't literals are stored at runtime. Otherwise each entry is inserted at runtime.
+     */
+    BinaryenExpressionRef generateDictionary(shared_ptr<DictionaryNode> node, BinaryenModuleRef &module);
+
+    BinaryenExpressionRef generateSymbol(shared_ptr<SymbolNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Generates a tuple as a multi-value, so a function returning one returns both its values on the stack and
+     * a local holding one is a local per value. Tuples are never boxed, since no heap object can hold one yet.
+     */
+    BinaryenExpressionRef generateTuple(shared_ptr<TupleNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Generates a struct as a heap object with its fields where its StructLayout puts them.
+     */
+    BinaryenExpressionRef generateStructDeclaration(shared_ptr<StructDeclarationNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Generates a read of the global holding a string constant, adding the global the first time the string is
+     * generated in the module.
+     */
+    BinaryenExpressionRef generateStringConstant(const string &value, BinaryenModuleRef &module);
     BinaryenExpressionRef generateBooleanLiteral(shared_ptr<LiteralNode> node, BinaryenModuleRef &module);
     BinaryenExpressionRef generateExponentOperation(shared_ptr<BinaryOperationNode> node, BinaryenModuleRef &module);
     void generateSource(shared_ptr<SourceNode> node, BinaryenModuleRef &module);
@@ -63,19 +188,520 @@ namespace Theta {
       BinaryenModuleRef &module
     );
 
+    /**
+     * @brief The core module every module generated starts from, read the first time it's asked for and kept for the
+     * rest of the process. Safe to call from any thread, so it can be read ahead of the first compile.
+     */
+    static BinaryenModuleRef getCoreLangWasm();
+
   private:
     SymbolTableStack<shared_ptr<ASTNode>> scope;          
     SymbolTableStack<string> scopeReferences;
     string FN_TABLE_NAME = "ThetaFunctionRefs";
-    string STRINGREF_TABLE = "ThetaStringRefs";
     string MEMORY_NAME = "0";
-    int memoryOffset = 0;
-    int stringRefOffset = 1;
+
+    // Defined by the core module, see src/wasm/ThetaLangCore.wat and doc/gc_process.md
+    string STRINGREF_TABLE = "ThetaStringRefs";
+    string STRINGS_STORE_FN = "Theta.Strings.store";
+    string GC_ALLOCATE_FN = "Theta.GC.allocate";
+    string GC_COLLECT_FN = "Theta.GC.collect";
+    string GC_PUSH_FRAME_FN = "Theta.GC.pushFrame";
+    string GC_SHADOW_STACK_POINTER = "Theta.GC.shadowStackPointer";
+    string GC_IS_COLLECTION_REQUESTED = "Theta.GC.isCollectionRequested";
+    string GC_EPOCH = "Theta.GC.epoch";
+    string GC_COLLECTION_RATIO = "Theta.GC.collectionRatio";
+    string GC_NOW_FN = "Theta.GC.now";
+
+    // What modules compiled with fuel metering spend, and the address of the flag the host interrupts them with
+    string FUEL_REMAINING = "Theta.Fuel.remaining";
+    string FUEL_INTERRUPT = "Theta.Fuel.INTERRUPT";
+
+    // The core module's and the standard library's functions all start with this
+    string CORE_FUNCTION_PREFIX = "Theta.";
+
+    // Core module functions that are never metered
+    string GC_PREFIX = "Theta.GC.";
+    string RESET_FN = "Theta.reset";
+
+    // The kinds of heap object the collector tells apart
+    static const int HEAP_DATA = 0;
+    static const int HEAP_REFERENCE = 1;
+    static const int HEAP_CLOSURE = 2;
+    static const int HEAP_STRING = 3;
+
+    // Lists are their length as an i32, then their elements from this offset on, which keeps i64 and v128 loads of
+    // elements aligned
+    static const int LIST_ELEMENTS_OFFSET = 8;
+    string LIST_SUM_FN = "Theta.List.sum";
+
+    // The functions looping over lists for map, filter and reduce, one per intrinsic and function passed to it
+    set<string> listIntrinsicFunctions;
+
+    string DICT_GET_FN = "Theta.Dict.get";
+    string DICT_FIND_FN = "Theta.Dict.find";
+    string DICT_INSERT_FN = "Theta.Dict.insert";
+    string DICT_LAYOUT_SEGMENT_PREFIX = "Theta.Dict.layout.";
+
+    // The names and bytes of the passive data segments that dictionaries laid out at compile time are copied from.
+    // They're only added to the module once it's generated, since they're set along with its memory
+    vector<pair<string, string>> dictionaryLayoutSegments;
+
+    // Memoized functions keep their results in tables laid out one after another from the end of the shadow stack,
+    // which the heap is moved past, see generateMemoizedFunction. Each holds a fixed number of results, so a function
+    // called with more distinct arguments than that forgets the ones found least recently
+    string MEMO_FIND_FN = "Theta.Memo.find";
+    string MEMO_STORE_FN = "Theta.Memo.store";
+    string MEMO_UNCACHED_SUFFIX = "$uncached";
+    string GC_HEAP_START = "Theta.GC.HEAP_START";
+    static const int MEMO_TABLES_START = 65536;
+    static const int MEMO_TABLE_CAPACITY = 1024;
+    int memoTablesSize = 0;
+
+    // The struct definitions of the capsules being generated, and the layouts of those that have been used so far.
+    // Structs are only laid out once they're used, since not every type they can be defined with can be generated yet
+    unordered_map<string, shared_ptr<StructDefinitionNode>> structDefinitions;
+    unordered_map<string, StructLayout> structLayouts;
+
+    // Structs with up to this many fields that are only ever read from are kept in a local per field instead
+    static const int MAX_SCALAR_REPLACED_FIELDS = 4;
+
+    string SYMBOL_NAMES_SECTION = "theta.symbols";
+
+    // The functions the module exports and the types they return, for the runtime to read results by, see ResultTypes
+    vector<pair<string, shared_ptr<TypeDeclarationNode>>> exportResultTypes;
+    string RESULT_TYPES_SECTION = "theta.types";
+
+    // Each distinct string literal is generated once per module, as an immutable global
+    unordered_map<string, string> stringLiteralGlobals;
+    string STRING_LITERAL_GLOBAL_PREFIX = "Theta.Strings.literal.";
+
+    // Lambdas that only differ in the names of their params and locals are lifted to the one function, named by their
+    // structural hash, and share its table slot
+    StructuralHasher structuralHasher;
+
+    // Lifted lambdas are named by their hash, so profiles name them after where they were first declared instead, such
+    // as `main0/double` for one assigned to `double` in `main`, or `main0/lambda@4` for one passed straight to a call
+    unordered_map<string, string> liftedFunctionNames;
+
+    // What modules compiled with profiling call on entering and leaving each function, and the readable names of their
+    // functions by the id they pass, a line each
+    string PROFILE_ENTER_FN = "Theta.Profile.enter";
+    string PROFILE_EXIT_FN = "Theta.Profile.exit";
+    string PROFILE_SECTION = "theta.profile";
+
     unordered_map<string, WasmClosure> functionNameToClosureTemplateMap;
+
+    // The functions in the function table, by slot. Only functions that a closure is made of get a slot, since anything
+    // in the table is kept in the module whether or not it's ever called
+    vector<string> tableFunctions;
+    unordered_map<string, int> tableSlots;
     string LOCAL_IDX_SCOPE_KEY = "ThetaLang.internal.localIdxCounter";
+    string TAIL_CALL_LOOP_LABEL = "ThetaLang.internal.tailCallLoop";
+
+    // Powers up to this one are generated as multiplications, rather than calls to Theta.Math.pow
+    static const int MAX_INLINED_EXPONENT = 4;
+
+    // If / else if chains matching a value against at least this many constants are generated as jump tables. A
+    // br_table is used when the constants span no more than MAX_JUMP_TABLE_SPREAD values per case, and otherwise the
+    // search tree compares against up to LINEAR_JUMP_TABLE_SEARCH cases one after another
+    static const int MIN_JUMP_TABLE_CASES = 4;
+    static const int MAX_JUMP_TABLE_SPREAD = 2;
+    static const int LINEAR_JUMP_TABLE_SEARCH = 3;
+    string JUMP_TABLE_LABEL_PREFIX = "Theta.JumpTable.";
+    int jumpTableCount = 0;
+
+    // A capsule's functions are generated on the compiler's worker pool, split into a few more tasks than there are
+    // threads, so that threads that finish early can take another, see generateCapsuleFunctions
+    static const int TASKS_PER_THREAD = 4;
+
+    // What the copies of a CodeGen that generate a capsule's functions share: the ids of the symbols generated in the
+    // module, see getSymbolId, with their names by id, less one, and the lambdas lifted so far, by structural hash
+    struct SharedNames {
+      mutex namesMutex;
+      unordered_map<string, int> symbolIds;
+      vector<string> symbolNames;
+      unordered_map<uint64_t, vector<shared_ptr<FunctionDeclarationNode>>> liftedFunctions;
+    };
+
+    shared_ptr<SharedNames> sharedNames = make_shared<SharedNames>();
+
+    // Something generating a function needs from the rest of the module. Functions are generated on several threads,
+    // so rather than changing the module they record what they need, which is added once they're all generated, one
+    // function after another in the order the capsule declares them, see addReferences. That way table slots, globals
+    // and segments come out in the same order however the functions were split between threads
+    struct Reference {
+      enum Kind {
+        // The function named by name, generated along with the one that needs it, such as a list intrinsic's loop
+        FUNCTION,
+
+        // The lifted lambda named by name, which profiles call text after the function it's declared in
+        LAMBDA,
+
+        // A closure of the function named by name, whose table slot goes in the constant that is expression
+        TABLE_SLOT,
+
+        // A read of the string literal text, whose global goes in the global.get that is expression
+        STRING_LITERAL,
+
+        // A copy of a dictionary laid out as the bytes text, whose segment goes in the memory.init that is expression
+        DICTIONARY_LAYOUT,
+
+        // A call to the host function named by name, which is imported the first time
+        HOST_FUNCTION
+      };
+
+      Kind kind;
+      string name;
+      string text;
+      BinaryenExpressionRef expression;
+    };
+
+    struct FunctionContext {
+      string name;
+      BinaryenType returnType;
+      vector<BinaryenType> paramTypes;
+      BinaryenIndex firstScratchLocal;
+      bool hasSelfTailCall;
+
+      // Locals added while the body is generated, which come after the scratch locals of self tail calls
+      vector<BinaryenType> addedLocalTypes;
+
+      // The function's frame on the shadow stack, and the GC epoch its heap references were last loaded from it in
+      BinaryenIndex frameLocal;
+      BinaryenIndex epochLocal;
+
+      // The locals holding heap references, in the order of the frame slots they are kept in. The frame has a slot
+      // for each of them, followed by slots for heap references that are operands of a call, see generateOperands
+      vector<BinaryenIndex> heapLocals;
+      int frameSlots;
+
+      // A local of each type to hold a value in while the frame is reloaded or popped
+      unordered_map<BinaryenType, BinaryenIndex> valueLocals;
+
+      // The local holding each field of the structs that were replaced by their fields, by the struct's identifier
+      unordered_map<string, unordered_map<string, BinaryenIndex>> scalarReplacedStructs;
+
+      vector<Reference> references;
+    };
+
+    // The function whose body is currently being generated, if any. Calls in tail position use it to tell whether
+    // they can return_call, or jump back to the start of the function when it calls itself
+    optional<FunctionContext> currentFunction;
+
+    // An operand of a call, or an argument bound to a closure. Either node is generated for it, or it is the given
+    // expression, which can't collect
+    struct Operand {
+      shared_ptr<ASTNode> node;
+      BinaryenExpressionRef expression;
+      BinaryenType type;
+      bool isHeapReference;
+      bool canCollect;
+    };
+
+    struct DebugLocation {
+      BinaryenExpressionRef expression;
+      int line;
+      int column;
+    };
+
+    // Binaryen can only attach a location to an expression once the function it's in has been added, so locations
+    // wait here until then. Only used when there is a debugInfoFile
+    string debugInfoFile;
+    BinaryenIndex debugInfoFileIndex = 0;
+    vector<DebugLocation> debugLocations;
+
+    // A function that was generated, waiting to be added to the module along with what it references
+    struct GeneratedFunction {
+      // The name it was generated under, which profiles name the lambdas declared in it after
+      string enclosingName;
+      BinaryenType paramType;
+      vector<BinaryenType> paramTypes;
+      BinaryenType returnType;
+      vector<BinaryenType> localTypes;
+      BinaryenExpressionRef body;
+      vector<DebugLocation> debugLocations;
+      vector<Reference> references;
+    };
+
+    // The functions generated that are waiting to be added, by name, and the references of capsule level values, which
+    // aren't in any function
+    unordered_map<string, GeneratedFunction> generatedFunctions;
+    vector<Reference> capsuleReferences;
+
+    // The lifted lambdas this CodeGen generated. Copies generating functions at the same time each generate the lambdas
+    // they come across, and only the first of each is added, see addGeneratedFunction
+    set<string> generatedLambdas;
+
+    // The functions that were added to the module, by name
+    set<string> addedFunctions;
+
+    BinaryenExpressionRef generateNode(shared_ptr<ASTNode> node, BinaryenModuleRef &module);
+
+    friend class ASTVisitor<CodeGen, BinaryenExpressionRef, BinaryenModuleRef&>;
+
+    // Sources and capsules add to the module rather than producing an expression
+    BinaryenExpressionRef visitSource(const shared_ptr<SourceNode> &node, BinaryenModuleRef &module) {
+      generateSource(node, module);
+      return nullptr;
+    }
+    BinaryenExpressionRef visitCapsule(const shared_ptr<CapsuleNode> &node, BinaryenModuleRef &module) {
+      generateCapsule(node, module);
+      return nullptr;
+    }
+
+    BinaryenExpressionRef visitAssignment(const shared_ptr<AssignmentNode> &node, BinaryenModuleRef &module) {
+      return generateAssignment(node, module);
+    }
+    BinaryenExpressionRef visitBlock(const shared_ptr<BlockNode> &node, BinaryenModuleRef &module) {
+      return generateBlock(node, module);
+    }
+    BinaryenExpressionRef visitReturn(const shared_ptr<ReturnNode> &node, BinaryenModuleRef &module) {
+      return generateReturn(node, module);
+    }
+    // The only time we should get here is if we have a function defined inside a function,
+    // because the normal function declaration flow goes through the generateAssignment flow
+    BinaryenExpressionRef visitFunctionDeclaration(const shared_ptr<FunctionDeclarationNode> &node, BinaryenModuleRef &module) {
+      return generateClosureFunctionDeclaration(node, module);
+    }
+    BinaryenExpressionRef visitFunctionInvocation(const shared_ptr<FunctionInvocationNode> &node, BinaryenModuleRef &module) {
+      return generateFunctionInvocation(node, module);
+    }
+    BinaryenExpressionRef visitControlFlow(const shared_ptr<ControlFlowNode> &node, BinaryenModuleRef &module) {
+      return generateControlFlow(node, module);
+    }
+    BinaryenExpressionRef visitIdentifier(const shared_ptr<IdentifierNode> &node, BinaryenModuleRef &module) {
+      return generateIdentifier(node, module);
+    }
+    BinaryenExpressionRef visitBinaryOperation(const shared_ptr<BinaryOperationNode> &node, BinaryenModuleRef &module) {
+      return generateBinaryOperation(node, module);
+    }
+    BinaryenExpressionRef visitUnaryOperation(const shared_ptr<UnaryOperationNode> &node, BinaryenModuleRef &module) {
+      return generateUnaryOperation(node, module);
+    }
+    BinaryenExpressionRef visitNumberLiteral(const shared_ptr<LiteralNode> &node, BinaryenModuleRef &module) {
+      return generateNumberLiteral(node, module);
+    }
+    BinaryenExpressionRef visitStringLiteral(const shared_ptr<LiteralNode> &node, BinaryenModuleRef &module) {
+      return generateStringLiteral(node, module);
+    }
+    BinaryenExpressionRef visitList(const shared_ptr<ListNode> &node, BinaryenModuleRef &module) {
+      return generateList(node, module);
+    }
+    BinaryenExpressionRef visitDictionary(const shared_ptr<DictionaryNode> &node, BinaryenModuleRef &module) {
+      return generateDictionary(node, module);
+    }
+    BinaryenExpressionRef visitSymbol(const shared_ptr<SymbolNode> &node, BinaryenModuleRef &module) {
+      return generateSymbol(node, module);
+    }
+    BinaryenExpressionRef visitTuple(const shared_ptr<TupleNode> &node, BinaryenModuleRef &module) {
+      return generateTuple(node, module);
+    }
+    BinaryenExpressionRef visitStructDeclaration(const shared_ptr<StructDeclarationNode> &node, BinaryenModuleRef &module) {
+      return generateStructDeclaration(node, module);
+    }
+    BinaryenExpressionRef visitBooleanLiteral(const shared_ptr<LiteralNode> &node, BinaryenModuleRef &module) {
+      return generateBooleanLiteral(node, module);
+    }
+
+    /**
+     * @brief Attaches debug locations to the function holding their expressions, once it's been added.
+     */
+    void addDebugLocations(BinaryenFunctionRef fn, const vector<DebugLocation> &locations);
+
+    /**
+     * @brief Generates the functions a capsule declares on the compiler's worker pool, each task with a copy of this
+     * CodeGen, since generating a function changes the scope and the function being generated. The functions are then
+     * added to the module in the order they're declared, with what they reference.
+     * @param functions The assignments of the functions, in the order they're declared.
+     */
+    void generateCapsuleFunctions(const vector<shared_ptr<ASTNode>> &functions, BinaryenModuleRef &module);
+
+    /**
+     * @brief Keeps the current function, whose body was just generated, to be added to the module later, see
+     * addGeneratedFunction. Takes the debug locations recorded since firstDebugLocation with it.
+     */
+    void keepGeneratedFunction(
+      const string &name,
+      BinaryenType paramType,
+      vector<BinaryenType> localTypes,
+      BinaryenExpressionRef body,
+      size_t firstDebugLocation
+    );
+
+    /**
+     * @brief Records something the function being generated needs from the rest of the module, see Reference.
+     */
+    void addReference(Reference reference);
+
+    /**
+     * @brief Adds a function one of the generators generated to the module, unless it was already added. What it
+     * references is added first, in the order it was referenced, so functions end up in the order they would have if
+     * each was added as soon as it was generated.
+     */
+    void addGeneratedFunction(CodeGen &generator, const string &name, BinaryenModuleRef &module);
+
+    /**
+     * @brief Adds what a function references to the module, in order.
+     * @param generator The CodeGen that generated the function, which holds the functions it references.
+     * @param enclosingName The name of the function, which lambdas declared in it are profiled after.
+     */
+    void addReferences(
+      CodeGen &generator,
+      const vector<Reference> &references,
+      const string &enclosingName,
+      BinaryenModuleRef &module
+    );
+
+    /**
+     * @brief The global holding a string literal, adding it the first time. Each distinct literal has one global.
+     */
+    string getStringLiteralGlobal(const string &value, BinaryenModuleRef &module);
+
+    /**
+     * @brief Imports a function the host provides, unless it already was.
+     */
+    void addHostFunctionImport(const HostFunction &hostFunction, BinaryenModuleRef &module);
+
+    /**
+     * @brief Gives every symbol in a tree its id, in the order they appear, so that ids don't depend on which thread
+     * generated a symbol first.
+     */
+    void collectSymbols(shared_ptr<ASTNode> node);
 
     BinaryenModuleRef initializeWasmModule();
 
+    /**
+     * @brief Sets the module's memory and the core module's collector up with the compiler's heap options, importing
+     * the host's clock if collections are timed. Memory is set along with its data segments, so this runs once the
+     * module is generated.
+     */
+    void configureHeap(BinaryenModuleRef &module);
+
+    /**
+     * @brief Generates a call to one of the dictionary intrinsics. See DictIntrinsics.
+     */
+    BinaryenExpressionRef generateDictIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief The id a symbol is generated as, giving it the next one if it doesn't have one yet. Ids are numbered from
+     * 1, since dictionaries mark their empty slots with 0, so comparing or hashing symbols only ever takes an i32.
+     */
+    int getSymbolId(const string &symbol);
+
+    /**
+     * @brief Adds the name of each symbol as the theta.symbols custom section, one per line in the order of their ids,
+     * so that debuggers can show them by name. Only added to modules built with debug info.
+     */
+    void addSymbolNames(BinaryenModuleRef &module);
+
+    /**
+     * @brief Adds the type each export returns, and the layout of each struct any of them return, as the theta.types
+     * custom section. The runtime reads results out of memory by it, see ResultTypes.
+     */
+    void addResultTypes(BinaryenModuleRef &module);
+
+    /**
+     * @brief Makes every function in the module, other than the collector's and the reset, spend a unit of fuel when
+     * it's entered and on each turn of each of its loops, trapping once the fuel runs out or the host interrupts it.
+     * Runs once the module is generated, so that the standard library's loops are metered too.
+     */
+    void meterFuel(BinaryenModuleRef &module);
+
+    /**
+     * @brief Makes every function the program was compiled to, lifted lambdas included, call the host on entering and
+     * on leaving it, whether it returns, tail calls or falls through, and adds the names of the functions as the
+     * theta.profile custom section. The runtime profiles the program by them, see Profiler.
+     */
+    void addProfiling(BinaryenModuleRef &module);
+
+    /**
+     * @brief The name a lifted lambda is generated as. If an alpha equivalent lambda was already lifted, its name is
+     * returned. isNew is set to whether this CodeGen has yet to generate the function.
+     */
+    string getLiftedFunctionName(shared_ptr<FunctionDeclarationNode> function, bool &isNew);
+
+    /**
+     * @brief Generates a call to one of the string intrinsics, straight on the stringref. See StringIntrinsics.
+     */
+    BinaryenExpressionRef generateStringIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Generates a call to a function the host provides, importing it the first time it's called. See
+     * HostFunction.
+     */
+    BinaryenExpressionRef generateHostFunctionInvocation(
+      shared_ptr<FunctionInvocationNode> node,
+      const HostFunction &hostFunction,
+      BinaryenModuleRef &module
+    );
+
+    /**
+     * @brief Generates a call to first or second as a read of one of the tuple's values. See TupleIntrinsics.
+     */
+    BinaryenExpressionRef generateTupleIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module);
+
+    const StructLayout& getStructLayout(const string &structType);
+
+    /**
+     * @brief Generates a read of a struct's field, written get(struct, :field), as a single load at the field's offset,
+     * or the local holding the field if the struct was replaced by its fields.
+     */
+    BinaryenExpressionRef generateStructFieldAccess(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Whether a struct assigned to a local can be replaced by a local per field: it's small, and every use of
+     * it reads one of its fields, so it never needs to exist in memory.
+     *
+     * @param assignmentNode The assignment of the struct declaration to the local.
+     */
+    bool canScalarReplace(shared_ptr<AssignmentNode> assignmentNode);
+
+    /**
+     * @brief Generates a struct declaration assigned to a local as a local per field, which reads of its fields then
+     * use instead.
+     */
+    BinaryenExpressionRef generateScalarReplacedStruct(
+      const string &identifier,
+      shared_ptr<StructDeclarationNode> node,
+      BinaryenModuleRef &module
+    );
+
+    /**
+     * @brief Generates a call to one of the list intrinsics. See ListIntrinsics.
+     */
+    BinaryenExpressionRef generateListIntrinsic(shared_ptr<FunctionInvocationNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Adds the function that loops over a list for map, filter or reduce, calling the given capsule function
+     * for each element, unless the module already has it. The function keeps the lists it works on in a frame of its
+     * own, since the function it calls can collect.
+     *
+     * @param intrinsic The intrinsic, one of ListIntrinsics::MAP, FILTER or REDUCE.
+     * @param functionName The qualified name of the function to call for each element.
+     * @param elementType The type of the list's elements.
+     * @param resultType What the function to call returns.
+     * @return The name of the function
+     */
+    string addListIntrinsicFunction(
+      const string &intrinsic,
+      const string &functionName,
+      BinaryenType elementType,
+      BinaryenType resultType,
+      BinaryenModuleRef &module
+    );
+
+    /**
+     * @brief Generates a chain of string concatenations, such as `a + b + c + d`, as a balanced tree of concatenations
+     * over all of its parts, with adjacent literals joined at compile time. Building a string up one part at a time
+     * copies the left side over and over, where a balanced tree copies each part a logarithmic number of times.
+     */
+    BinaryenExpressionRef generateStringConcatenation(shared_ptr<BinaryOperationNode> node, BinaryenModuleRef &module);
+
+    /**
+     * @brief Collects the parts of a chain of string concatenations, from left to right.
+     */
+    static void collectConcatenatedParts(shared_ptr<ASTNode> node, vector<shared_ptr<ASTNode>> &parts);
+
     BinaryenExpressionRef generateStringBinaryOperation(
       string op,
       BinaryenExpressionRef left,
@@ -83,13 +709,119 @@ namespace Theta {
       BinaryenModuleRef &modul
     );
 
-    vector<Pointer<PointerType::Data>> generateFunctionInvocationArgMemoryInsertions(
-      shared_ptr<FunctionInvocationNode> funcInvNode,
-      vector<BinaryenExpressionRef> &expressions,
-      BinaryenModuleRef &module,
-      string refIdentifier = ""
+    /**
+     * @brief Generates the operands of a call in order. A collection can move what the heap references evaluated
+     * before it point to, so when an operand that can collect comes after one that is a heap reference, the operands
+     * up to it are evaluated into locals first, with the heap references kept on the shadow stack.
+     *
+     * @param operands The operands, in the order they are passed.
+     * @param isTailCall Whether the call is in tail position, in which case every operand that can collect is
+     * evaluated first, since the frame is popped before the call.
+     * @param prefix Where the expressions evaluating operands into locals are added, which must run before the call.
+     * @return The expressions to pass as the operands
+     */
+    vector<BinaryenExpressionRef> generateOperands(
+      vector<Operand> operands,
+      bool isTailCall,
+      vector<BinaryenExpressionRef> &prefix,
+      BinaryenModuleRef &module
+    );
+
+    Operand makeOperand(shared_ptr<ASTNode> node);
+
+    /**
+     * @brief Allocates a closure on the heap, with an argument cell for each argument bound to it. Closures store
+     * their argument pointers last to first, after the function's index in the function table and the arity left.
+     *
+     * @param functionName The name of the function, whose index in the function table goes in the closure.
+     * @param arity How many parameters the function takes in total.
+     * @param boundArgs The arguments bound to the closure, in order. They must not be able to collect, see
+     * generateOperands.
+     * @param boundArgTypes The types of the bound arguments.
+     * @return An expression evaluating to the address of the closure
+     */
+    BinaryenExpressionRef generateClosureAllocation(
+      const string &functionName,
+      int arity,
+      vector<BinaryenExpressionRef> boundArgs,
+      vector<shared_ptr<TypeDeclarationNode>> boundArgTypes,
+      BinaryenModuleRef &module
+    );
+
+    /**
+     * @brief Wraps a call that may collect, so that the heap references the current function holds in locals are
+     * loaded from its frame afterwards, if a collection moved them.
+     */
+    BinaryenExpressionRef generateCollectingCall(BinaryenExpressionRef call, BinaryenModuleRef &module);
+
+    /**
+     * @brief Sets a local, keeping it in the current function's frame too if it holds a heap reference.
+     */
+    BinaryenExpressionRef generateLocalSet(
+      BinaryenIndex index,
+      BinaryenExpressionRef value,
+      bool holdsHeapReference,
+      BinaryenModuleRef &module
     );
 
+    /**
+     * @brief Loads every heap reference the current function holds from its frame, if there was a collection since
+     * they were last loaded. Null if the function holds none.
+     */
+    BinaryenExpressionRef generateHeapLocalReload(BinaryenModuleRef &module);
+
+    /**
+     * @brief Pops the current function's frame off the shadow stack.
+     */
+    BinaryenExpressionRef generateFramePop(BinaryenModuleRef &module);
+
+    /**
+     * @brief Evaluates a value the current function returns, popping its frame before it is returned.
+     */
+    BinaryenExpressionRef generatePoppingFrame(BinaryenExpressionRef value, BinaryenModuleRef &module);
+
+    /**
+     * @brief Adds the prologue and epilogue of the current function to its body. The prologue pushes its frame onto
+     * the shadow stack, keeps its heap reference parameters in it, and collects if a collection was requested. A
+     * function calling itself in tail position loops back to just after the frame is pushed.
+     */
+    BinaryenExpressionRef generateFunctionFrame(BinaryenExpressionRef body, BinaryenModuleRef &module);
+
+    /**
+     * @brief Starts generating a function, making it the current one.
+     *
+     * @param firstScratchLocal The index after the function's parameters and declared locals.
+     * @param heapLocals The parameters and declared locals that hold heap references.
+     */
+    void enterFunction(
+      string name,
+      BinaryenType returnType,
+      vector<BinaryenType> paramTypes,
+      BinaryenIndex firstScratchLocal,
+      vector<BinaryenIndex> heapLocals
+    );
+
+    /**
+     * @brief The locals of the current function that were added on top of its parameters and declared locals.
+     */
+    vector<BinaryenType> getAddedLocalTypes();
+
+    BinaryenIndex addLocal(BinaryenType type);
+    BinaryenIndex getValueLocal(BinaryenType type);
+    int getFrameSlot(BinaryenIndex heapLocal);
+
+    static bool isHeapReference(shared_ptr<TypeDeclarationNode> type);
+
+    /**
+     * @brief The kind of heap object a cell holding a value of the given type is, see HEAP_DATA.
+     */
+    static int getHeapKind(shared_ptr<TypeDeclarationNode> type);
+
+    /**
+     * @brief Whether evaluating a node may call a function, and so reach a function boundary, where the collector runs.
+     */
+    static bool canCollect(shared_ptr<ASTNode> node);
+
     BinaryenExpressionRef generateCallIndirectForNewClosure(
       shared_ptr<FunctionInvocationNode> funcInvNode,
       shared_ptr<ASTNode> ref,
@@ -122,17 +854,42 @@ namespace Theta {
     void bindIdentifierToScope(shared_ptr<ASTNode> ast);
     void registerModuleFunctions(BinaryenModuleRef &module);
 
+    /**
+     * @brief The slot of a function in the function table, giving it the next one the first time a closure is made of
+     * the function.
+     */
+    int getTableSlot(const string &functionName);
+
+    /**
+     * @brief Removes the functions, globals and segments that can't be reached from the module's exports, its function
+     * table or its start function. Every module starts out with the whole core module and standard library, and most
+     * programs only use a few of their functions.
+     */
+    void removeUnusedModuleElements(BinaryenModuleRef &module);
+
     bool checkIsLastInBlock(shared_ptr<ASTNode> node);
 
-    pair<WasmClosure, vector<BinaryenExpressionRef>> generateAndStoreClosure(
+    /**
+     * @brief Checks whether a node's value is what the function it is in returns, with nothing left to do after it is
+     * evaluated. This is the case for the value of a return, the last expression of the function's body, and the
+     * branches of an if that is itself in tail position.
+     */
+    static bool isInTailPosition(shared_ptr<ASTNode> node);
+
+    /**
+     * @brief Generates a call the current function makes to itself in tail position as a jump back to the start of
+     * the function, with the arguments in place of the parameters. Recursion like this then runs in a loop, in
+     * constant stack space.
+     */
+    BinaryenExpressionRef generateSelfTailCall(shared_ptr<FunctionInvocationNode> funcInvNode, BinaryenModuleRef &module);
+
+    BinaryenExpressionRef generateAndStoreClosure(
       string qualifiedReferenceFunctionName,
       shared_ptr<FunctionDeclarationNode> simplifiedReference,
       shared_ptr<FunctionDeclarationNode> originalReference,
       BinaryenModuleRef &module
     );
 
-    vector<BinaryenExpressionRef> generateClosureMemoryStore(WasmClosure &closure, BinaryenModuleRef &module);
-
     void collectClosureScope(
       shared_ptr<ASTNode> node,
       set<string> &identifiersToFind,
@@ -140,8 +897,6 @@ namespace Theta {
       vector<shared_ptr<ASTNode>> &bodyExpression
     );
 
-    string generateFunctionHash(shared_ptr<FunctionDeclarationNode> function);
-
     int getByteSizeForType(shared_ptr<TypeDeclarationNode> type);
     int getByteSizeForType(BinaryenType type);
 
@@ -0,0 +1,180 @@
+#include "CompileStats.hpp"
+#include "lexer/Token.hpp"
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace Theta;
+
+void CompileStats::addTokens(size_t count, size_t bytes) {
+  tokens += count;
+  sourceBytes += bytes;
+}
+
+void CompileStats::addAST(const map<ASTNode::Types, size_t> &counts, size_t bytes) {
+  arenaBytes += bytes;
+
+  lock_guard<mutex> lock(statsMutex);
+  for (auto &[type, count] : counts) nodeCounts[type] += count;
+}
+
+void CompileStats::setSymbols(size_t tableEntries, size_t symbols, size_t types) {
+  lock_guard<mutex> lock(statsMutex);
+  symbolTableEntries = tableEntries;
+  internedSymbols = symbols;
+  internedTypes = types;
+}
+
+void CompileStats::setModule(size_t functions, size_t bytes) {
+  lock_guard<mutex> lock(statsMutex);
+  moduleFunctions = functions;
+  moduleBytes = bytes;
+}
+
+void CompileStats::setWasmBytes(size_t bytes) {
+  lock_guard<mutex> lock(statsMutex);
+  wasmBytes = bytes;
+}
+
+void CompileStats::setLinearMemory(size_t initialBytes, size_t maximumBytes, size_t dataBytes) {
+  lock_guard<mutex> lock(statsMutex);
+  linearMemory = { initialBytes, maximumBytes, dataBytes };
+}
+
+void CompileStats::recordPeakRSS(string phase) {
+  size_t bytes = getPeakRSS();
+
+  lock_guard<mutex> lock(statsMutex);
+  peakRSS.push_back({ std::move(phase), bytes });
+}
+
+void CompileStats::clear() {
+  tokens = 0;
+  sourceBytes = 0;
+  arenaBytes = 0;
+
+  lock_guard<mutex> lock(statsMutex);
+  symbolTableEntries = 0;
+  internedSymbols = 0;
+  internedTypes = 0;
+  moduleFunctions = 0;
+  moduleBytes = 0;
+  wasmBytes = 0;
+  linearMemory = Memory();
+  nodeCounts.clear();
+  peakRSS.clear();
+}
+
+vector<pair<string, size_t>> CompileStats::getRows() {
+  lock_guard<mutex> lock(statsMutex);
+
+  size_t nodes = 0;
+  for (auto &[type, count] : nodeCounts) nodes += count;
+
+  vector<pair<string, size_t>> rows = {
+    { "Tokens", tokens },
+    { "Token bytes", tokens * sizeof(Token) },
+    { "Source bytes", sourceBytes },
+    { "AST nodes", nodes }
+  };
+
+  for (auto &[type, count] : nodeCounts) rows.push_back({ "  " + ASTNode::nodeTypeToString(type), count });
+
+  vector<pair<string, size_t>> rest = {
+    { "AST arena bytes", arenaBytes },
+    { "Symbol table entries", symbolTableEntries },
+    { "Interned symbols", internedSymbols },
+    { "Interned types", internedTypes },
+    { "Binaryen module functions", moduleFunctions },
+    { "Binaryen module bytes", moduleBytes },
+    { "Wasm bytes", wasmBytes },
+    { "Linear memory initial bytes", linearMemory.initialBytes },
+    { "Linear memory maximum bytes", linearMemory.maximumBytes },
+    { "Linear memory data bytes", linearMemory.dataBytes }
+  };
+
+  rows.insert(rows.end(), rest.begin(), rest.end());
+
+  for (const PeakRSS &peak : peakRSS) rows.push_back({ "Peak RSS after " + peak.phase, peak.bytes });
+
+  return rows;
+}
+
+string CompileStats::toTable() {
+  vector<pair<string, size_t>> rows = getRows();
+
+  size_t nameWidth = string("Stat").length();
+  for (auto &[name, value] : rows) nameWidth = max(nameWidth, name.length());
+
+  auto row = [nameWidth](const string &name, const string &value) {
+    return name + string(nameWidth - name.length(), ' ') + "  " + string(value.length() < 14 ? 14 - value.length() : 0, ' ') + value + "\n";
+  };
+
+  string table = row("Stat", "Value");
+  table += string(nameWidth + 16, '-') + "\n";
+
+  for (auto &[name, value] : rows) table += row(name, to_string(value));
+
+  return table;
+}
+
+string CompileStats::toJSON() {
+  lock_guard<mutex> lock(statsMutex);
+
+  string json = "{\"tokens\":" + to_string(tokens);
+  json += ",\"tokenBytes\":" + to_string(tokens * sizeof(Token));
+  json += ",\"sourceBytes\":" + to_string(sourceBytes);
+  json += ",\"astNodes\":{";
+
+  bool isFirst = true;
+  for (auto &[type, count] : nodeCounts) {
+    if (!isFirst) json += ",";
+    json += "\"" + ASTNode::nodeTypeToString(type) + "\":" + to_string(count);
+    isFirst = false;
+  }
+
+  json += "},\"astArenaBytes\":" + to_string(arenaBytes);
+  json += ",\"symbolTableEntries\":" + to_string(symbolTableEntries);
+  json += ",\"internedSymbols\":" + to_string(internedSymbols);
+  json += ",\"internedTypes\":" + to_string(internedTypes);
+  json += ",\"moduleFunctions\":" + to_string(moduleFunctions);
+  json += ",\"moduleBytes\":" + to_string(moduleBytes);
+  json += ",\"wasmBytes\":" + to_string(wasmBytes);
+  json += ",\"linearMemory\":{\"initialBytes\":" + to_string(linearMemory.initialBytes);
+  json += ",\"maximumBytes\":" + to_string(linearMemory.maximumBytes);
+  json += ",\"dataBytes\":" + to_string(linearMemory.dataBytes) + "}";
+  json += ",\"peakRSS\":[";
+
+  for (size_t i = 0; i < peakRSS.size(); i++) {
+    if (i > 0) json += ",";
+    json += "{\"phase\":\"" + peakRSS[i].phase + "\",\"bytes\":" + to_string(peakRSS[i].bytes) + "}";
+  }
+
+  return json + "]}";
+}
+
+size_t CompileStats::getPeakRSS() {
+  #if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+
+  return counters.PeakWorkingSetSize;
+  #else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+
+  // Linux reports the peak in kilobytes, macOS in bytes
+  #ifdef __APPLE__
+  return usage.ru_maxrss;
+  #else
+  return usage.ru_maxrss * 1024;
+  #endif
+  #endif
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "parser/ast/ASTNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Records how much memory each phase of a compile used, for `theta --stats`: how many tokens and AST nodes
+   * were made and the bytes they took, how many symbols were bound and how many symbols and types were interned, how
+   * big the module was before and after Binaryen, how much linear memory it reserves, and the peak resident set size of
+   * the process after each phase. Linked capsules are parsed on the worker pool, so it is safe to record into from any
+   * thread.
+   */
+  class CompileStats {
+  public:
+    struct PeakRSS {
+      string phase;
+      size_t bytes;
+    };
+
+    /**
+     * @brief Records the tokens a source was lexed into.
+     * @param count How many tokens there were.
+     * @param sourceBytes The size of the source, which the tokens point into rather than copy.
+     */
+    void addTokens(size_t count, size_t sourceBytes);
+
+    /**
+     * @brief Records the nodes of a parsed tree.
+     * @param nodeCounts How many nodes of each type were made.
+     * @param arenaBytes The bytes the tree's arena allocated for them, see ASTArena.
+     */
+    void addAST(const map<ASTNode::Types, size_t> &nodeCounts, size_t arenaBytes);
+
+    /**
+     * @brief Records the symbols of the compile.
+     * @param tableEntries How many symbols were bound in symbol tables.
+     * @param internedSymbols How many names the SymbolInterner holds, which it keeps between compiles.
+     * @param internedTypes How many types the TypeInterner holds, which it keeps between compiles.
+     */
+    void setSymbols(size_t tableEntries, size_t internedSymbols, size_t internedTypes);
+
+    /**
+     * @brief Records the Binaryen module code generation produced, before it was optimized.
+     * @param functions How many functions it has, including the ones imported from the core module.
+     * @param bytes Its size, serialized.
+     */
+    void setModule(size_t functions, size_t bytes);
+
+    /**
+     * @brief Records the size of the wasm written out.
+     */
+    void setWasmBytes(size_t bytes);
+
+    /**
+     * @brief Records the linear memory the module declares.
+     * @param initialBytes The memory the module starts with.
+     * @param maximumBytes The most memory the heap can grow to.
+     * @param dataBytes The bytes of its data segments.
+     */
+    void setLinearMemory(size_t initialBytes, size_t maximumBytes, size_t dataBytes);
+
+    /**
+     * @brief Records the peak resident set size of the process so far, as of the end of a phase.
+     */
+    void recordPeakRSS(string phase);
+
+    void clear();
+
+    /**
+     * @brief Formats the stats as a human readable table.
+     */
+    string toTable();
+
+    /**
+     * @brief Formats the stats as a JSON object.
+     */
+    string toJSON();
+
+    /**
+     * @brief The peak resident set size of the process so far, in bytes, or 0 if it can't be read.
+     */
+    static size_t getPeakRSS();
+
+  private:
+    struct Memory {
+      size_t initialBytes = 0;
+      size_t maximumBytes = 0;
+      size_t dataBytes = 0;
+    };
+
+    atomic<size_t> tokens = 0;
+    atomic<size_t> sourceBytes = 0;
+    atomic<size_t> arenaBytes = 0;
+    size_t symbolTableEntries = 0;
+    size_t internedSymbols = 0;
+    size_t internedTypes = 0;
+    size_t moduleFunctions = 0;
+    size_t moduleBytes = 0;
+    size_t wasmBytes = 0;
+    Memory linearMemory;
+    map<ASTNode::Types, size_t> nodeCounts;
+    vector<PeakRSS> peakRSS;
+    mutex statsMutex;
+
+    /**
+     * @brief The rows of the stats, as name and value, in the order they are reported.
+     */
+    vector<pair<string, size_t>> getRows();
+  };
+}
@@ -1,9 +1,15 @@
 #include "Compiler.hpp"
+#include "compiler/BuildFingerprint.hpp"
 #include "../lexer/Lexer.cpp"
 #include "../parser/Parser.cpp"
 #include "compiler/TypeChecker.hpp"
+#include "compiler/SymbolTable.hpp"
+#include "compiler/TypeInterner.hpp"
 #include <limits.h>
+#include <cstdlib>
 #include <cstring>
+#include <iomanip>
+#include <sstream>
 #include <unistd.h>
 
 #ifdef __APPLE__
@@ -13,334 +19,855 @@
 using namespace std;
 using namespace Theta;
 
+namespace {
+  void writeFile(string_view contents, const string &fileName) {
+    ofstream outFile(fileName, std::ios::binary);
+    if (!outFile) {
+      throw std::runtime_error("Failed to open file for writing: " + fileName);
+    }
+
+    outFile.write(contents.data(), contents.size());
+    outFile.close();
+
+    if (!outFile.good()) {
+      throw std::runtime_error("Failed to write to file: " + fileName);
+    }
+  }
+}
+
+thread_local Compiler *Compiler::active = nullptr;
+
 Compiler& Compiler::getInstance() {
+  if (active) return *active;
+
   static Compiler instance;
   return instance;
 }
 
-void Compiler::compile(string entrypoint, string outputFile, bool emitTokens, bool emitAST, bool emitWAT) {
+bool Compiler::compile(string entrypoint, string outputFile, bool emitTokens, bool emitAST, bool emitWAT) {
+  ActiveScope scope(this);
+
+  isEmitTokens = emitTokens;
+  isEmitAST = emitAST;
+  isEmitWAT = emitWAT;
+
+  phaseTimer.clear();
+  PhaseTimer::Scope timing(getPhaseTimer(), "Total");
+
+  compileStats.clear();
+
+  return compileEntrypoint(entrypoint, outputFile);
+}
+
+bool Compiler::compileBatch(const vector<pair<string, string>> &entrypoints, bool emitTokens, bool emitAST, bool emitWAT) {
+  ActiveScope scope(this);
+
   isEmitTokens = emitTokens;
   isEmitAST = emitAST;
   isEmitWAT = emitWAT;
 
+  phaseTimer.clear();
+  PhaseTimer::Scope timing(getPhaseTimer(), "Total");
+
+  compileStats.clear();
+
+  vector<shared_future<bool>> compiles;
+
+  for (const auto &[entrypoint, outputFile] : entrypoints) {
+    compiles.push_back(workerPool.submit([this, entrypoint = entrypoint, outputFile = outputFile]() {
+      ActiveScope scope(this);
+
+      // Entrypoints only report their own errors
+      ExceptionScope exceptionScope;
+      bool isCompiled = compileEntrypoint(entrypoint, outputFile);
+      displayExceptions(exceptionScope.exceptions);
+
+      return isCompiled;
+    }));
+  }
+
+  bool isCompiled = true;
+  for (const shared_future<bool> &compile : compiles) isCompiled = workerPool.await(compile) && isCompiled;
+
+  // Linked capsules parsed on a thread that wasn't compiling an entrypoint report their errors here
+  vector<shared_ptr<Theta::Error>> unreported = getEncounteredExceptions();
+  displayExceptions(unreported);
+
+  return isCompiled && unreported.empty();
+}
+
+bool Compiler::compileEntrypoint(string entrypoint, string outputFile) {
+  CompileStats *stats = getCompileStats();
+  size_t symbolTableEntries = SymbolTableCounter::entries;
+
+  // Entrypoints compiled together display their errors once they're done, see compileBatch
+  bool isDisplayingErrors = !ExceptionScope::active;
+
   shared_ptr<ASTNode> programAST = buildAST(entrypoint);
 
-  if (!optimizeAST(programAST)) return;
+  if (stats) stats->recordPeakRSS("Parse");
+
+  // Emitting anything other than the output, or counting what it took, needs the whole pipeline to actually run.
+  // Sources that failed to parse are never cached, so that their errors get reported
+  bool isCacheable = isWasmCacheEnabled && !isEmitTokens && !isEmitAST && !isEmitWAT && !isSourceMapEnabled && !isCollectingStats && programAST && getEncounteredExceptions().empty();
+  CapsuleGraph graph = buildCapsuleGraph(programAST, entrypoint);
+
+  // The same program compiles to different modules at different optimization levels, with different exports, with
+  // different heaps, against different host functions, and with or without fuel metering and profiling
+  string buildOptions = optimizationLevel.toString() + " " + heapOptions.toString();
+  if (isMeteringFuel) buildOptions += " --meter-fuel";
+  if (isProfiling) buildOptions += " --profile";
+  for (const string &exportedFunction : exports) buildOptions += " --export=" + exportedFunction;
+  for (auto &[name, hostFunction] : hostFunctions) buildOptions += " --host=" + hostFunction.toString();
+
+  // And different builds of the compiler can compile it differently without the version changing
+  buildOptions += " " + BuildFingerprint::get();
+
+  uint64_t buildKey = ASTCache::hashSource(to_string(graph.getEntrypoint().buildKey) + " " + buildOptions);
+
+  if (isCacheable) {
+    optional<vector<char>> cachedWasm;
+
+    {
+      PhaseTimer::Scope cacheTiming(getPhaseTimer(), "Wasm cache lookup");
+      cachedWasm = wasmCache.load(buildKey);
+    }
+
+    if (cachedWasm) {
+      {
+        PhaseTimer::Scope writeTiming(getPhaseTimer(), "File writing");
+        writeWasmToFile(string_view(cachedWasm->data(), cachedWasm->size()), outputFile);
+      }
+
+      return !isSplittingCapsules || compileLinkedCapsules(graph, outputFile, buildOptions, isCacheable);
+    }
+  }
+
+  if (!optimizeAST(programAST, !isDisplayingErrors)) return false;
+
+  if (stats) stats->recordPeakRSS("Optimization");
 
   outputAST(programAST, entrypoint);
 
-  TypeChecker typeChecker;
-  bool isTypeValid = typeChecker.checkAST(programAST);
+  bool isTypeValid = checkLinkedCapsules(graph);
+
+  if (isTypeValid) {
+    PhaseTimer::Scope typeCheckTiming(getPhaseTimer(), "Type check");
 
-  for (int i = 0; i < encounteredExceptions.size(); i++) {
-    encounteredExceptions[i]->display();
+    TypeChecker typeChecker;
+    isTypeValid = typeChecker.checkAST(programAST);
   }
 
-  if (!isTypeValid) return;
+  if (stats) stats->recordPeakRSS("Type check");
+
+  if (isDisplayingErrors) displayExceptions(getEncounteredExceptions());
+
+  if (!isTypeValid) return false;
+
+  optimizeCheckedAST(programAST);
+
+  if (stats) stats->recordPeakRSS("Checked optimization");
 
   CodeGen codeGen;
+  if (isSourceMapEnabled) codeGen.setDebugInfoFile(entrypoint);
+
   BinaryenModuleRef module = codeGen.generateWasmFromAST(programAST);
 
+  if (stats) {
+    stats->recordPeakRSS("Code generation");
+
+    // Binaryen doesn't say how much memory a module takes, so its serialized size before optimizing stands in for it
+    stats->setModule(BinaryenGetNumFunctions(module), writeModuleToBuffer(module).size());
+  }
+
+  optimizeModule(module, optimizationLevel);
+
+  if (stats) stats->recordPeakRSS("Binaryen");
+
   if (isEmitWAT) {
+    lock_guard<mutex> lock(outputMutex);
+
     cout << "Generated WAT for \"" + entrypoint + "\":" << endl;
     BinaryenModulePrint(module);
   }
 
-  writeModuleToFile(module, outputFile);
+  // The module points at its source map by a path relative to itself
+  string sourceMapFile = outputFile + ".map";
+  string sourceMapURL = filesystem::path(sourceMapFile).filename().string();
+  BinaryenModuleAllocateAndWriteResult serialized;
+
+  {
+    PhaseTimer::Scope serializationTiming(getPhaseTimer(), "Serialization");
+    serialized = BinaryenModuleAllocateAndWrite(module, isSourceMapEnabled ? sourceMapURL.c_str() : nullptr);
+  }
+
+  BinaryenModuleDispose(module);
+
+  // Binaryen hands back buffers it allocated, which are written out as they are
+  unique_ptr<void, void(*)(void*)> binary(serialized.binary, free);
+  unique_ptr<char, void(*)(void*)> sourceMap(serialized.sourceMap, free);
+  string_view wasm(static_cast<const char*>(serialized.binary), serialized.binaryBytes);
+
+  if (stats) {
+    stats->setWasmBytes(wasm.size());
+    stats->setSymbols(
+      SymbolTableCounter::entries - symbolTableEntries,
+      SymbolInterner::getInstance().getSize(),
+      TypeInterner::getInstance().getSize()
+    );
+    stats->recordPeakRSS("Serialization");
+  }
+
+  if (isCacheable && getEncounteredExceptions().empty()) wasmCache.store(buildKey, wasm);
+
+  {
+    PhaseTimer::Scope writeTiming(getPhaseTimer(), "File writing");
+
+    if (sourceMap) writeFile(sourceMap.get(), sourceMapFile);
+    writeWasmToFile(wasm, outputFile);
+  }
+
+  return !isSplittingCapsules || compileLinkedCapsules(graph, outputFile, buildOptions, isCacheable);
 }
 
-vector<char> Compiler::compileDirect(string source) {
+bool Compiler::compileLinkedCapsules(const CapsuleGraph &graph, string outputFile, string buildOptions, bool isCacheable) {
+  const vector<CapsuleUnit> &units = graph.getUnits();
+  filesystem::path directory = filesystem::path(outputFile).parent_path();
+  bool isChecked = false;
+
+  // The last unit is the entrypoint, which was already written to the output file
+  for (size_t i = 0; i + 1 < units.size(); i++) {
+    const CapsuleUnit &unit = units[i];
+    if (!unit.ast) continue;
+
+    string capsuleFile = (directory / (unit.name + ".wasm")).string();
+    uint64_t buildKey = ASTCache::hashSource(to_string(unit.buildKey) + " " + buildOptions);
+
+    if (isCacheable) {
+      optional<vector<char>> cachedWasm;
+
+      {
+        PhaseTimer::Scope cacheTiming(getPhaseTimer(), "Wasm cache lookup");
+        cachedWasm = wasmCache.load(buildKey);
+      }
+
+      if (cachedWasm) {
+        PhaseTimer::Scope writeTiming(getPhaseTimer(), "File writing");
+        writeWasmToFile(string_view(cachedWasm->data(), cachedWasm->size()), capsuleFile);
+        continue;
+      }
+    }
+
+    // Capsules are checked at most once per compiler, so this is only slow the first time a capsule is missed
+    if (!isChecked) {
+      if (!checkLinkedCapsules(graph)) return false;
+      isChecked = true;
+    }
+
+    vector<char> wasm = workerPool.await(requestCapsuleWasm(unit, buildKey, isCacheable));
+
+    PhaseTimer::Scope writeTiming(getPhaseTimer(), "File writing");
+    writeWasmToFile(string_view(wasm.data(), wasm.size()), capsuleFile);
+  }
+
+  return true;
+}
+
+shared_future<vector<char>> Compiler::requestCapsuleWasm(const CapsuleUnit &unit, uint64_t buildKey, bool isCacheable) {
+  lock_guard<mutex> lock(linksMutex);
+
+  auto it = generatedCapsules.find(buildKey);
+  if (it != generatedCapsules.end()) return it->second;
+
+  // Generating a capsule changes its AST, so entrypoints that link the same capsule wait on the one module
+  shared_future<vector<char>> capsuleWasm = workerPool.submit([this, unit, buildKey, isCacheable]() {
+    ActiveScope scope(this);
+
+    CodeGen codeGen;
+    BinaryenModuleRef module = codeGen.generateWasmFromAST(unit.ast);
+
+    optimizeModule(module, optimizationLevel);
+
+    vector<char> wasm;
+
+    {
+      PhaseTimer::Scope serializationTiming(getPhaseTimer(), "Serialization");
+      wasm = writeModuleToBuffer(module);
+    }
+
+    BinaryenModuleDispose(module);
+
+    if (isCacheable) wasmCache.store(buildKey, string_view(wasm.data(), wasm.size()));
+
+    return wasm;
+  });
+
+  generatedCapsules.insert(make_pair(buildKey, capsuleWasm));
+
+  return capsuleWasm;
+}
+
+vector<char> Compiler::compileDirect(string source, OptimizationLevel level) {
+  ActiveScope scope(this);
+
   shared_ptr<ASTNode> ast = buildAST(source, "ith");
+  CapsuleGraph graph = buildCapsuleGraph(ast, "ith");
 
   if (!optimizeAST(ast)) return {};
   
   outputAST(ast, "ith");
 
-  TypeChecker typeChecker;
-  bool isTypeValid = typeChecker.checkAST(ast);
+  bool isTypeValid = checkLinkedCapsules(graph);
 
-  for (int i = 0; i < encounteredExceptions.size(); i++) {
-    encounteredExceptions[i]->display();
+  if (isTypeValid) {
+    TypeChecker typeChecker;
+    isTypeValid = typeChecker.checkAST(ast);
   }
 
+  displayExceptions(encounteredExceptions);
+
   if (!isTypeValid) return {};
 
+  optimizeCheckedAST(ast);
+
   CodeGen codeGen;
   BinaryenModuleRef module = codeGen.generateWasmFromAST(ast);
 
-  return writeModuleToBuffer(module);
+  optimizeModule(module, level);
+
+  vector<char> wasm = writeModuleToBuffer(module);
+  BinaryenModuleDispose(module);
+
+  return wasm;
 }
 
 shared_ptr<ASTNode> Compiler::buildAST(string file) {
-  std::ifstream t(file);
-  std::stringstream buffer;
-  buffer << t.rdbuf();
+  ActiveScope scope(this);
+
+  return buildASTFromFile(file, "");
+}
+
+shared_ptr<ASTNode> Compiler::buildASTFromFile(string file, string linkedCapsuleName) {
+  shared_ptr<SourceFile> sourceFile = SourceFile::open(file);
+
+  // Unreadable files are treated as empty, same as any other source with nothing in it
+  if (!sourceFile) sourceFile = SourceFile::fromString("");
 
-  string fileSource = buffer.str();
+  // Emitting or counting tokens needs the file to actually be lexed
+  bool isCacheable = isASTCacheEnabled && !isEmitTokens && !isCollectingStats;
 
-  return buildAST(fileSource, file);
+  if (isCacheable) {
+    shared_ptr<ASTNode> cachedAST;
+
+    {
+      PhaseTimer::Scope timing(getPhaseTimer(), "AST cache lookup " + (linkedCapsuleName != "" ? linkedCapsuleName : file));
+      cachedAST = astCache.load(sourceFile->view());
+    }
+
+    if (cachedAST && resolveCachedLinks(cachedAST, linkedCapsuleName)) return cachedAST;
+  }
+
+  return buildASTFromSource(sourceFile, file, linkedCapsuleName, isCacheable);
 }
 
 shared_ptr<ASTNode> Compiler::buildAST(string source, string fileName) {
+  return buildAST(SourceFile::fromString(std::move(source)), fileName);
+}
+
+shared_ptr<ASTNode> Compiler::buildAST(shared_ptr<const SourceFile> source, string fileName) {
+  ActiveScope scope(this);
+
+  return buildASTFromSource(source, fileName, "", false);
+}
+
+shared_ptr<ASTNode> Compiler::buildASTFromSource(
+  shared_ptr<const SourceFile> source,
+  string fileName,
+  string linkedCapsuleName,
+  bool isCacheable
+) {
   Theta::Lexer lexer;
-  lexer.lex(source);
+  Theta::Parser parser;
+  shared_ptr<ASTNode> ast;
+  string phaseName = linkedCapsuleName != "" ? linkedCapsuleName : fileName;
+
+  // When emitting tokens we need the whole file lexed up front so we can print them, and when timing phases so that
+  // lexing and parsing can be timed apart, or when collecting stats so they can be counted. Otherwise the parser pulls
+  // tokens from the lexer as it needs them
+  if (isEmitTokens || isTimingPhases || isCollectingStats) {
+    {
+      PhaseTimer::Scope timing(getPhaseTimer(), "Lex " + phaseName);
+      lexer.lex(source);
+    }
 
-  if (isEmitTokens) {
-    cout << "Lexed Tokens for \"" + fileName + "\":" << endl;
-    for (int i = 0; i < lexer.tokens.size(); i++) {
-      cout << lexer.tokens[i].toJSON() << endl;
+    if (CompileStats *stats = getCompileStats()) stats->addTokens(lexer.tokens.size(), source->view().size());
+
+    if (isEmitTokens) {
+      lock_guard<mutex> lock(outputMutex);
+
+      cout << "Lexed Tokens for \"" + fileName + "\":" << endl;
+
+      // Written as they're serialized, rather than flushing the console for every token
+      JsonWriter writer(cout);
+      for (Token &token : lexer.tokens) {
+        token.writeJSON(writer);
+        writer.newline();
+      }
+
+      writer.newline();
     }
-    cout << endl;
+
+    PhaseTimer::Scope timing(getPhaseTimer(), "Parse " + phaseName);
+
+    Theta::DequeTokenStream tokens(lexer.tokens);
+    ast = parser.parse(tokens, lexer.getSource(), fileName, filesByCapsuleName, linkedCapsuleName);
+  } else {
+    lexer.load(source);
+
+    Theta::LexerTokenStream tokens(lexer);
+    ast = parser.parse(tokens, lexer.getSource(), fileName, filesByCapsuleName, linkedCapsuleName);
   }
 
-  Theta::Parser parser;
-  shared_ptr<Theta::ASTNode> parsedAST = parser.parse(lexer.tokens, source, fileName, filesByCapsuleName);
+  // Only clean parses are cached, since a hit would skip reporting the errors
+  if (isCacheable && ast && !parser.hasErrors()) astCache.store(source->view(), ast);
 
-  return parsedAST;
+  return ast;
 }
 
+bool Compiler::resolveCachedLinks(shared_ptr<ASTNode> ast, string linkedCapsuleName) {
+  shared_ptr<SourceNode> sourceNode = dynamic_pointer_cast<SourceNode>(ast);
+  if (!sourceNode) return false;
+
+  vector<shared_ptr<ASTNode>> links = sourceNode->getLinks();
+  vector<pair<size_t, shared_future<shared_ptr<LinkNode>>>> pendingLinks;
+
+  for (size_t i = 0; i < links.size(); i++) {
+    string capsuleName = dynamic_pointer_cast<LinkNode>(links[i])->capsule;
+
+    shared_ptr<LinkNode> linkNode = getIfExistsParsedLinkAST(capsuleName);
+    if (linkNode) {
+      links[i] = linkNode;
+      continue;
+    }
+
+    optional<string> file = resolveCapsuleFile(capsuleName, filesByCapsuleName);
+    if (!file) return false;
+
+    auto linkAST = requestLinkAST(capsuleName, *file, linkedCapsuleName, sourceNode);
+    if (!linkAST) return false;
+
+    pendingLinks.push_back(make_pair(i, *linkAST));
+  }
+
+  for (auto &[i, linkAST] : pendingLinks) {
+    links[i] = awaitLinkAST(linkAST);
+  }
+
+  sourceNode->setLinks(links);
+
+  return true;
+}
+
+void Compiler::resetLinkedCapsules() {
+  lock_guard<mutex> lock(linksMutex);
+
+  parsedLinkASTs.clear();
+  linkedCapsulesByCapsule.clear();
+  checkedCapsules.clear();
+  generatedCapsules.clear();
+  filesByCapsuleName->clear();
+}
+
+CapsuleGraph Compiler::buildCapsuleGraph(shared_ptr<ASTNode> ast, string file) {
+  lock_guard<mutex> lock(linksMutex);
+  return CapsuleGraph::build(ast, file, *filesByCapsuleName);
+}
+
+bool Compiler::checkLinkedCapsules(const CapsuleGraph &graph) {
+  const vector<CapsuleUnit> &units = graph.getUnits();
+  vector<shared_future<CapsuleCheck>> checks;
+
+  {
+    lock_guard<mutex> lock(linksMutex);
+
+    // Units come after everything they link, so the checks of a unit's dependencies have always been requested by
+    // the time the unit's own check is. The last unit is the entrypoint, which the caller checks itself
+    for (size_t i = 0; i + 1 < units.size(); i++) {
+      const CapsuleUnit &unit = units[i];
+
+      auto it = checkedCapsules.find(unit.name);
+      if (it != checkedCapsules.end()) {
+        checks.push_back(it->second);
+        continue;
+      }
+
+      vector<shared_future<CapsuleCheck>> dependencyChecks;
+      for (const string &dependency : unit.dependencies) {
+        auto dependencyCheck = checkedCapsules.find(dependency);
+        if (dependencyCheck != checkedCapsules.end()) dependencyChecks.push_back(dependencyCheck->second);
+      }
+
+      shared_future<CapsuleCheck> check = workerPool.submit([this, unit, dependencyChecks]() {
+        ActiveScope scope(this);
+
+        for (const shared_future<CapsuleCheck> &dependencyCheck : dependencyChecks) workerPool.await(dependencyCheck);
+
+        return checkCapsule(unit);
+      });
+
+      checkedCapsules.insert(make_pair(unit.name, check));
+      checks.push_back(check);
+    }
+  }
+
+  bool isValid = true;
+
+  // Errors are reported in link order, however the checks happened to be scheduled
+  for (const shared_future<CapsuleCheck> &check : checks) {
+    CapsuleCheck result = workerPool.await(check);
+
+    for (shared_ptr<Theta::Error> e : result.exceptions) addException(e);
+
+    isValid = isValid && result.isValid;
+  }
+
+  return isValid;
+}
+
+Compiler::CapsuleCheck Compiler::checkCapsule(const CapsuleUnit &unit) {
+  ExceptionScope scope;
+  CapsuleCheck result;
+
+  // Linked capsules that couldn't be found were already reported while linking
+  shared_ptr<ASTNode> ast = unit.ast;
+  if (!ast) return result;
+
+  vector<shared_ptr<OptimizationPass>> passes = createOptimizationPasses();
+
+  result.isValid = runOptimizationPasses(ast, passes, unit.name);
+
+  if (result.isValid) {
+    PhaseTimer::Scope timing(getPhaseTimer(), "Type check " + unit.name);
+
+    TypeChecker typeChecker;
+    result.isValid = typeChecker.checkAST(ast);
+  }
+
+  result.exceptions = scope.exceptions;
+
+  return result;
+}
+
+thread_local Compiler::ExceptionScope *Compiler::ExceptionScope::active = nullptr;
+
 void Compiler::addException(shared_ptr<Theta::Error> e) {
+  if (ExceptionScope::active) {
+    ExceptionScope::active->exceptions.push_back(e);
+    return;
+  }
+
+  lock_guard<mutex> lock(exceptionsMutex);
   encounteredExceptions.push_back(e);
 }
 
 vector<shared_ptr<Theta::Error>> Compiler::getEncounteredExceptions() {
+  if (ExceptionScope::active) return ExceptionScope::active->exceptions;
+
+  lock_guard<mutex> lock(exceptionsMutex);
   return encounteredExceptions;
 }
 
 void Compiler::clearExceptions() {
+  if (ExceptionScope::active) {
+    ExceptionScope::active->exceptions.clear();
+    return;
+  }
+
+  lock_guard<mutex> lock(exceptionsMutex);
   encounteredExceptions.clear();
 }
 
 shared_ptr<Theta::LinkNode> Compiler::getIfExistsParsedLinkAST(string capsuleName) {
+  lock_guard<mutex> lock(linksMutex);
   auto it = parsedLinkASTs.find(capsuleName);
 
-  if (it != parsedLinkASTs.end()) return it->second;
+  if (it != parsedLinkASTs.end() && it->second.wait_for(chrono::seconds(0)) == future_status::ready) return it->second.get();
 
   return nullptr;
 }
 
 void Compiler::addParsedLinkAST(string capsuleName, shared_ptr<Theta::LinkNode> linkNode) {
-  parsedLinkASTs.insert(make_pair(capsuleName, linkNode));
+  promise<shared_ptr<Theta::LinkNode>> parsed;
+  parsed.set_value(linkNode);
+
+  lock_guard<mutex> lock(linksMutex);
+  parsedLinkASTs.insert(make_pair(capsuleName, parsed.get_future().share()));
 }
 
-void Compiler::discoverCapsules() {
-  for (const auto& entry : std::filesystem::recursive_directory_iterator(".")) {
-    if (entry.is_regular_file() && entry.path().extension() == ".th") {
-      string capsuleName = findCapsuleName(entry.path().string());
+optional<shared_future<shared_ptr<Theta::LinkNode>>> Compiler::requestLinkAST(
+  string capsuleName,
+  string file,
+  string linkingCapsule,
+  shared_ptr<ASTNode> parent
+) {
+  lock_guard<mutex> lock(linksMutex);
 
-      filesByCapsuleName->insert(make_pair(capsuleName, entry.path().string()));
-    }
+  // Capsules that link each other would otherwise wait on each other forever
+  if (linkingCapsule != "") {
+    if (capsuleName == linkingCapsule || isLinkedTransitively(capsuleName, linkingCapsule)) return nullopt;
+
+    linkedCapsulesByCapsule[linkingCapsule].insert(capsuleName);
   }
-}
 
-string Compiler::findCapsuleName(string file) {
-  std::ifstream t(file);
-  std::stringstream buffer;
+  auto it = parsedLinkASTs.find(capsuleName);
+  if (it != parsedLinkASTs.end()) return it->second;
 
-  buffer << t.rdbuf();
+  shared_future<shared_ptr<Theta::LinkNode>> linkAST = workerPool.submit([this, capsuleName, file, parent]() {
+    ActiveScope scope(this);
 
-  string source = buffer.str();
+    shared_ptr<Theta::LinkNode> linkNode = make_shared<Theta::LinkNode>(capsuleName, parent);
+    linkNode->setValue(buildASTFromFile(file, capsuleName));
 
-  int i = 0;
-  bool capsuleNameFound = false;
-  string capsuleName;
+    return linkNode;
+  });
 
-  // TODO: This is probably better suited to live in the lexer as a callable function
-  // Iterate over the source but stop once we find a capsule
-  while (i + 6 < source.length() && !capsuleNameFound) {
-    if (source[i] == 'c' && source[i + 1] == 'a' && source[i + 2] == 'p' && source[i + 3] == 's' && source[i + 4] == 'u' && source[i + 5] == 'l' && source[i + 6] == 'e') {
-      capsuleNameFound = true;
-      i += 7;
-    }
+  parsedLinkASTs.insert(make_pair(capsuleName, linkAST));
 
-    i++;
-  }
+  return linkAST;
+}
+
+shared_ptr<Theta::LinkNode> Compiler::awaitLinkAST(const shared_future<shared_ptr<Theta::LinkNode>> &linkAST) {
+  return workerPool.await(linkAST);
+}
+
+bool Compiler::isLinkedTransitively(const string &from, const string &to) {
+  set<string> visited;
+  vector<string> toVisit = { from };
 
-  if (capsuleNameFound) {
-    while (source[i] != '\n' && !isspace(source[i]) && source[i] != '{') {
-      capsuleName.push_back(source[i]);
+  while (!toVisit.empty()) {
+    string capsule = toVisit.back();
+    toVisit.pop_back();
 
-      i++;
+    if (!visited.insert(capsule).second) continue;
+
+    auto it = linkedCapsulesByCapsule.find(capsule);
+    if (it == linkedCapsulesByCapsule.end()) continue;
+
+    for (const string &linked : it->second) {
+      if (linked == to) return true;
+
+      toVisit.push_back(linked);
     }
   }
 
-  return capsuleName;
+  return false;
+}
+
+optional<string> Compiler::findCapsuleFile(string capsuleName) {
+  lock_guard<mutex> lock(linksMutex);
+  return capsuleIndex.findCapsuleFile(capsuleName);
+}
+
+void Compiler::prepareCapsuleIndex() {
+  lock_guard<mutex> lock(linksMutex);
+  capsuleIndex.prepare();
+}
+
+optional<string> Compiler::resolveCapsuleFile(string capsuleName, shared_ptr<map<string, string>> filesByCapsule) {
+  lock_guard<mutex> lock(linksMutex);
+
+  auto it = filesByCapsule->find(capsuleName);
+  if (it != filesByCapsule->end()) return it->second;
+
+  // Capsules we haven't seen yet get resolved through the capsule index
+  optional<string> capsuleFile = capsuleIndex.findCapsuleFile(capsuleName);
+  if (capsuleFile) filesByCapsule->insert(make_pair(capsuleName, *capsuleFile));
+
+  return capsuleFile;
 }
 
 bool Compiler::optimizeAST(shared_ptr<ASTNode> &ast, bool silenceErrors) {
-  for (auto &pass : optimizationPasses) {
-    pass->optimize(ast);
-
-    if (encounteredExceptions.size() > 0) {
-      if (!silenceErrors) {
-        for (int i = 0; i < encounteredExceptions.size(); i++) {
-          encounteredExceptions[i]->display();
-        }
-      }
+  ActiveScope scope(this);
 
-      pass->cleanup();
-      return false;
-    }
+  // Passes keep state while they run, and entrypoints compiled together optimize at the same time
+  vector<shared_ptr<OptimizationPass>> passes = createOptimizationPasses();
+  if (runOptimizationPasses(ast, passes)) return true;
 
-    pass->cleanup();
+  if (!silenceErrors) {
+    displayExceptions(getEncounteredExceptions());
   }
 
-  return true;
+  return false;
 }
 
-vector<char> Compiler::writeModuleToBuffer(BinaryenModuleRef &module) {
-  vector<char> buffer(1024); // Start with 1KB buffer
+void Compiler::optimizeCheckedAST(shared_ptr<ASTNode> &ast) {
+  ActiveScope scope(this);
 
-  size_t written = BinaryenModuleWrite(module, buffer.data(), buffer.size());
+  vector<shared_ptr<OptimizationPass>> passes = createCheckedOptimizationPasses(exports);
+  runOptimizationPasses(ast, passes);
+}
 
-  // If the written size is equal to the buffer size, resize the buffer and try again
-  while (written == buffer.size()) {
-    buffer.resize(buffer.size() * 2);
-    
-    written = BinaryenModuleWrite(module, buffer.data(), buffer.size());
-  }
+bool Compiler::runOptimizationPasses(shared_ptr<ASTNode> &ast, vector<shared_ptr<OptimizationPass>> &passes, string linkedCapsuleName) {
+  PassManager passManager(passes);
 
-  buffer.resize(written);
+  return passManager.run(ast, getPhaseTimer(), linkedCapsuleName);
+}
 
-  return buffer;
+vector<shared_ptr<OptimizationPass>> Compiler::createOptimizationPasses() {
+  return {
+    make_shared<LiteralInlinerPass>(),
+    make_shared<ConstantFoldingPass>()
+  };
+}
+
+vector<shared_ptr<OptimizationPass>> Compiler::createCheckedOptimizationPasses(const set<string> &exports) {
+  return {
+    make_shared<SpecializationPass>(),
+    make_shared<InliningPass>(),
+    make_shared<ConstantFoldingPass>(),
+    make_shared<CommonSubexpressionEliminationPass>(),
+    make_shared<DeadCodeEliminationPass>(exports)
+  };
 }
 
-void Compiler::writeModuleToFile(BinaryenModuleRef &module, string fileName) {
-  vector<char> buffer = writeModuleToBuffer(module);
+void Compiler::optimizeModule(BinaryenModuleRef module, const OptimizationLevel &level) {
+  if (!level.isOptimizing()) return;
 
-  ofstream outFile(fileName, std::ios::binary);
-  if (!outFile) {
-    throw std::runtime_error("Failed to open file for writing: " + fileName);
-  }
+  PhaseTimer::Scope timing(getPhaseTimer(), "Binaryen " + level.toString());
+  level.optimize(module);
+}
 
-  outFile.write(buffer.data(), buffer.size());
-  outFile.close();
+void Compiler::setMaxThreads(size_t threads) {
+  // The thread that compiles works through queued tasks while it waits on them, so it counts as one of the threads
+  workerPool.setThreadCount(threads > 0 ? threads - 1 : 0);
+}
 
-  if (!outFile.good()) {
-    throw std::runtime_error("Failed to write module to file: " + fileName);
-  }
+vector<char> Compiler::writeModuleToBuffer(BinaryenModuleRef &module) {
+  // Binaryen sizes the buffer itself, so the module is only ever serialized once
+  BinaryenModuleAllocateAndWriteResult serialized = BinaryenModuleAllocateAndWrite(module, nullptr);
+
+  char *binary = static_cast<char*>(serialized.binary);
+  vector<char> buffer(binary, binary + serialized.binaryBytes);
 
+  free(serialized.binary);
+
+  return buffer;
+}
+
+void Compiler::writeWasmToFile(string_view wasm, string fileName) {
+  writeFile(wasm, fileName);
+
+  lock_guard<mutex> lock(outputMutex);
   cout << "Compilation successful. Output: " + fileName << endl;
 }
 
+void Compiler::displayExceptions(const vector<shared_ptr<Theta::Error>> &exceptions) {
+  if (exceptions.empty()) return;
+
+  ostringstream diagnostics;
+  for (auto &error : exceptions) error->display(diagnostics);
+
+  lock_guard<mutex> lock(outputMutex);
+  cout << diagnostics.str() << flush;
+}
+
 void Compiler::outputAST(shared_ptr<ASTNode> ast, string fileName) {
+  lock_guard<mutex> lock(outputMutex);
+
   if (ast && isEmitAST) {
     cout << "Generated AST for \"" + fileName + "\":" << endl;
-    cout << ast->toJSON() << endl;
-    cout << endl;
+
+    JsonWriter writer(cout);
+    ast->writeJSON(writer);
+    writer.newline().newline();
   } else if (!ast) {
     cout << "Could not parse AST for file " + fileName << endl;
   }
 }
 
 string Compiler::getQualifiedFunctionIdentifier(string variableName, shared_ptr<ASTNode> node) {
-  vector<shared_ptr<ASTNode>> params;
-
-  if (node->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
-    shared_ptr<FunctionDeclarationNode> declarationNode = dynamic_pointer_cast<FunctionDeclarationNode>(node);
-    params = declarationNode->getParameters()->getElements();
-  } else if (node->getNodeType() == ASTNode::TYPE_DECLARATION) {
-    return getQualifiedFunctionIdentifierFromTypeSignature(variableName, dynamic_pointer_cast<TypeDeclarationNode>(node));
-  } else {
-    shared_ptr<FunctionInvocationNode> invocationNode = dynamic_pointer_cast<FunctionInvocationNode>(node);
-    params = invocationNode->getParameters()->getElements();
-  }
-  
-  string functionIdentifier = variableName + to_string(params.size());
-
-  for (int i = 0; i < params.size(); i++) {
-    if (node->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
-      shared_ptr<TypeDeclarationNode> paramType = dynamic_pointer_cast<TypeDeclarationNode>(params.at(i)->getValue());
-      functionIdentifier += paramType->getType();
-    } else {
-      shared_ptr<TypeDeclarationNode> paramType = dynamic_pointer_cast<TypeDeclarationNode>(params.at(i)->getResolvedType());
-      functionIdentifier += paramType->getType();
-    }
-  }
-
-  return functionIdentifier;
+  return SymbolInterner::getInstance().getName(getQualifiedFunctionId(variableName, node));
 }
 
 string Compiler::getQualifiedFunctionIdentifierFromTypeSignature(string variableName, shared_ptr<TypeDeclarationNode> typeSig) {
-  vector<shared_ptr<ASTNode>> params;
-
-  // If typeSig is a function, and it has a value, that means the function takes in no parameters and only has a return value
-  if (typeSig->getType() == DataTypes::FUNCTION && typeSig->getValue() == nullptr) {
-    params.resize(typeSig->getElements().size() - 1);
-    copy(typeSig->getElements().begin(), typeSig->getElements().end() - 1, params.begin());
-  }
-
-  string functionIdentifier = variableName + to_string(params.size());
+  return SymbolInterner::getInstance().getName(getQualifiedFunctionId(variableName, typeSig));
+}
 
-  for (auto param : params) {
-    shared_ptr<TypeDeclarationNode> p = dynamic_pointer_cast<TypeDeclarationNode>(param);
-    functionIdentifier += p->getType();
-  }
+int Compiler::getQualifiedFunctionId(string variableName, shared_ptr<ASTNode> node) {
+  SymbolInterner &interner = SymbolInterner::getInstance();
+  int nameId = interner.getId(variableName);
 
-  return functionIdentifier;
-}
+  shared_ptr<FunctionDeclarationNode> declarationNode = nullptr;
+  vector<shared_ptr<ASTNode>> paramTypes;
 
-vector<shared_ptr<ASTNode>> Compiler::findAllInTree(shared_ptr<ASTNode> node, ASTNode::Types nodeType) {
-  if (node->getNodeType() == nodeType) return { node };
+  if (node->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
+    declarationNode = dynamic_pointer_cast<FunctionDeclarationNode>(node);
 
-  if (node->getNodeType() == ASTNode::CONTROL_FLOW) {
-    vector<shared_ptr<ASTNode>> found;
-    shared_ptr<ControlFlowNode> cfNode = dynamic_pointer_cast<ControlFlowNode>(node);
+    int cachedId = declarationNode->getSignatureId(nameId);
+    if (cachedId >= 0) return cachedId;
 
-    for (int i = 0; i < cfNode->getConditionExpressionPairs().size(); i++) {
-      vector<shared_ptr<ASTNode>> foundInElem = findAllInTree(cfNode->getConditionExpressionPairs().at(i).second, nodeType);
+    for (auto &param : declarationNode->getParameters()->getElements()) paramTypes.push_back(param->getValue());
+  } else if (node->getNodeType() == ASTNode::TYPE_DECLARATION) {
+    shared_ptr<TypeDeclarationNode> typeSig = dynamic_pointer_cast<TypeDeclarationNode>(node);
 
-      found.insert(found.end(), foundInElem.begin(), foundInElem.end());
+    // If typeSig is a function, and it has a value, that means the function takes in no parameters and only has a return value
+    if (typeSig->getType() == DataTypes::FUNCTION && typeSig->getValue() == nullptr) {
+      paramTypes.assign(typeSig->getElements().begin(), typeSig->getElements().end() - 1);
     }
+  } else {
+    shared_ptr<FunctionInvocationNode> invocationNode = dynamic_pointer_cast<FunctionInvocationNode>(node);
 
-    return found;
+    for (auto &arg : invocationNode->getParameters()->getElements()) paramTypes.push_back(arg->getResolvedType());
   }
 
-  if (node->getValue()) return findAllInTree(node->getValue(), nodeType);
+  vector<int> paramTypeIds;
+  for (auto &paramType : paramTypes) {
+    paramTypeIds.push_back(interner.getId(dynamic_pointer_cast<TypeDeclarationNode>(paramType)->getType()));
+  }
 
-  if (node->getLeft()) {
-    vector<shared_ptr<ASTNode>> found = findAllInTree(node->getLeft(), nodeType);
-    vector<shared_ptr<ASTNode>> rightFound = findAllInTree(node->getRight(), nodeType);
+  int id = interner.getSignatureId(nameId, paramTypeIds);
 
-    found.insert(found.end(), rightFound.begin(), rightFound.end());
+  if (declarationNode) declarationNode->setSignatureId(nameId, id);
 
-    return found;
-  }
+  return id;
+}
 
-  if (node->hasMany()) {
-    vector<shared_ptr<ASTNode>> found;
-    shared_ptr<ASTNodeList> nodeList = dynamic_pointer_cast<ASTNodeList>(node);
+string Compiler::generateFunctionHash(shared_ptr<FunctionDeclarationNode> function) {
+  hash<string> hasher;
 
-    for (int i = 0; i < nodeList->getElements().size(); i++) {
-      vector<shared_ptr<ASTNode>> foundInElem = findAllInTree(nodeList->getElements().at(i), nodeType);
-      found.insert(found.end(), foundInElem.begin(), foundInElem.end());
-    }
+  size_t hashed = hasher(function->toJSON());
 
-    return found;
-  }
+  ostringstream stream;
+
+  stream << hex << nouppercase << setw(sizeof(size_t) * 2) << setfill('0');
+
+  stream << hashed;
 
-  return {};
+  return stream.str();
 }
 
-shared_ptr<TypeDeclarationNode> Compiler::deepCopyTypeDeclaration(shared_ptr<TypeDeclarationNode> original, shared_ptr<ASTNode> parent) {
-  shared_ptr<TypeDeclarationNode> copy = make_shared<TypeDeclarationNode>(original->getType(), parent);
+vector<shared_ptr<ASTNode>> Compiler::findAllInTree(shared_ptr<ASTNode> node, ASTNode::Types nodeType) {
+  vector<shared_ptr<ASTNode>> found;
+  findAllInTree(node, nodeType, found);
 
-  if (original->getValue()) {
-    copy->setValue(deepCopyTypeDeclaration(dynamic_pointer_cast<TypeDeclarationNode>(original->getValue()), copy));
-  } else if (original->getLeft()) {
-    copy->setLeft(deepCopyTypeDeclaration(dynamic_pointer_cast<TypeDeclarationNode>(original->getLeft()), copy));
-    copy->setRight(deepCopyTypeDeclaration(dynamic_pointer_cast<TypeDeclarationNode>(original->getRight()), copy));
-  } else if (original->getElements().size() > 0) {
-    vector<shared_ptr<ASTNode>> copyChildren;
+  return found;
+}
 
-    for (int i = 0; i < original->getElements().size(); i++) {
-      copyChildren.push_back(deepCopyTypeDeclaration(dynamic_pointer_cast<TypeDeclarationNode>(original->getElements().at(i)), copy));
+void Compiler::findAllInTree(const shared_ptr<ASTNode> &node, ASTNode::Types nodeType, vector<shared_ptr<ASTNode>> &found) {
+  if (node->getNodeType() == nodeType) {
+    found.push_back(node);
+  } else if (node->getNodeType() == ASTNode::CONTROL_FLOW) {
+    for (auto &conditionExpressionPair : static_pointer_cast<ControlFlowNode>(node)->getConditionExpressionPairs()) {
+      findAllInTree(conditionExpressionPair.second, nodeType, found);
     }
-
-    copy->setElements(copyChildren);
+  } else if (node->getValue()) {
+    findAllInTree(node->getValue(), nodeType, found);
+  } else if (node->getLeft()) {
+    findAllInTree(node->getLeft(), nodeType, found);
+    findAllInTree(node->getRight(), nodeType, found);
+  } else if (node->hasMany()) {
+    for (auto &elem : static_pointer_cast<ASTNodeList>(node)->getElements()) findAllInTree(elem, nodeType, found);
   }
-
-  return copy;
 }
 
 string Compiler::resolveAbsolutePath(string relativePath) {
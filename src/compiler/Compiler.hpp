@@ -9,6 +9,10 @@
 #include <iostream>
 #include <memory>
 #include <filesystem>
+#include <optional>
+#include <mutex>
+#include <set>
+#include <future>
 #include <libgen.h>
 #include <binaryen-c.h>
 #include "../parser/ast/ASTNode.hpp"
@@ -18,31 +22,98 @@
 #include "CodeGen.hpp"
 #include "compiler/optimization/OptimizationPass.hpp"
 #include "compiler/optimization/LiteralInlinerPass.hpp"
+#include "compiler/optimization/ConstantFoldingPass.hpp"
+#include "compiler/optimization/CommonSubexpressionEliminationPass.hpp"
+#include "compiler/optimization/DeadCodeEliminationPass.hpp"
+#include "compiler/optimization/InliningPass.hpp"
+#include "compiler/optimization/SpecializationPass.hpp"
+#include "compiler/optimization/PassManager.hpp"
 #include "parser/ast/TypeDeclarationNode.hpp"
+#include "lexer/SourceFile.hpp"
+#include "CapsuleIndex.hpp"
+#include "ThreadPool.hpp"
+#include "ASTCache.hpp"
+#include "CapsuleGraph.hpp"
+#include "WasmCache.hpp"
+#include "PhaseTimer.hpp"
+#include "CompileStats.hpp"
+#include "OptimizationLevel.hpp"
+#include "HeapOptions.hpp"
+#include "HostFunction.hpp"
+#include "SymbolInterner.hpp"
 
 using namespace std;
 
 /**
- * @brief Singleton class responsible for compiling Theta source code into an Abstract Syntax Tree (AST).
+ * @brief Class responsible for compiling Theta source code into an Abstract Syntax Tree (AST), and from there into WASM.
+ *
+ * Each instance holds everything a compilation needs: its options, the exceptions it encountered and the linked
+ * capsules it has parsed and checked. Different instances can compile on different threads at the
+ * same time. Code inside the compiler reaches the instance it is working for through getInstance(). Embedders
+ * should go through CompilerSession rather than using this class directly.
  */
 namespace Theta {
   class Compiler {
   public:
+    /**
+     * @brief Capsules are not discovered here, they are looked up in the capsule index the first time a link needs
+     * them, so that startup stays fast.
+     */
+    Compiler() {
+      filesByCapsuleName = make_shared<map<string, string>>();
+    }
+
+    Compiler(const Compiler&) = delete;
+    Compiler& operator=(const Compiler&) = delete;
+
+    /**
+     * @brief Makes a compiler the one getInstance() returns on the current thread, for as long as the scope is alive.
+     * Scopes nest: the innermost one on a thread wins.
+     */
+    class ActiveScope {
+    public:
+      ActiveScope(Compiler *compiler) : previous(active) { active = compiler; }
+
+      ~ActiveScope() { active = previous; }
+
+      ActiveScope(const ActiveScope&) = delete;
+      ActiveScope& operator=(const ActiveScope&) = delete;
+
+    private:
+      Compiler *previous;
+    };
+
     /**
      * @brief Compiles the Theta source code starting from the specified entry point.
      * @param entrypoint The entry point file name or identifier.
      * @param outputFile The output file which will be the result of the compilation
      * @param isEmitTokens Toggles whether or not the lexer tokens should be output to the console
      * @param isEmitAST Toggles whether or not the AST should be output to the console
+     * @return true If the program compiled and the output was written
      */
-    void compile(string entrypoint, string outputFile, bool isEmitTokens = false, bool isEmitAST = false, bool isEmitWAT = false);
+    bool compile(string entrypoint, string outputFile, bool isEmitTokens = false, bool isEmitAST = false, bool isEmitWAT = false);
+
+    /**
+     * @brief Compiles several entrypoints at once on the worker pool, each to its own output file. The capsules they
+     * link are discovered, parsed and checked once for all of them, and when splitting capsules, generated once too.
+     * Each entrypoint reports its own errors. Phase timings and stats add up across the entrypoints.
+     * @param entrypoints Each entrypoint file, with the file its module is written to
+     * @return true If every entrypoint compiled and its output was written
+     */
+    bool compileBatch(
+      const vector<pair<string, string>> &entrypoints,
+      bool isEmitTokens = false,
+      bool isEmitAST = false,
+      bool isEmitWAT = false
+    );
 
     /**
      * @brief Compiles the Theta source code starting from the specified entry point.
      * @param source The source code to compile.
+     * @param level How hard to optimize the module. Defaults to -O0, since this is what the REPL compiles with
      * @return A buffer containing the compiled WASM module
      */
-    vector<char> compileDirect(string source);
+    vector<char> compileDirect(string source, OptimizationLevel level = OptimizationLevel());
 
     /**
      * @brief Builds the Abstract Syntax Tree (AST) for the Theta source code starting from the specified file.
@@ -60,19 +131,53 @@ namespace Theta {
     shared_ptr<Theta::ASTNode> buildAST(string source, string fileName);
 
     /**
-     * @brief Gets the singleton instance of the Compiler.
-     * @return Reference to the singleton instance of Compiler.
+     * @brief Builds the Abstract Syntax Tree (AST) for the given source file. The file is lexed in place, without copying it.
+     * @param source The source file to compile.
+     * @param fileName The file name of the Theta source code.
+     * @return A shared pointer to the root node of the constructed AST.
+     */
+    shared_ptr<Theta::ASTNode> buildAST(shared_ptr<const SourceFile> source, string fileName);
+
+    /**
+     * @brief Gets the compiler the current thread is working for: the one compiling on it, if any, or otherwise the
+     * process-wide default instance.
+     * @return Reference to the current instance of Compiler.
      */
     static Compiler& getInstance();
 
     /**
-     * @brief Adds an encountered exception to the list of exceptions to display later
+     * @brief Collects the exceptions reported on the current thread for as long as it is alive, instead of adding them
+     * to the compiler's list. This is what lets capsules be checked on several threads at once, each with its own
+     * errors. Scopes nest: the innermost one on a thread gets the exceptions.
+     */
+    class ExceptionScope {
+    public:
+      vector<shared_ptr<Theta::Error>> exceptions;
+
+      ExceptionScope() : previous(active) { active = this; }
+
+      ~ExceptionScope() { active = previous; }
+
+      ExceptionScope(const ExceptionScope&) = delete;
+      ExceptionScope& operator=(const ExceptionScope&) = delete;
+
+    private:
+      friend class Compiler;
+
+      static thread_local ExceptionScope *active;
+      ExceptionScope *previous;
+    };
+
+    /**
+     * @brief Adds an encountered exception to the list of exceptions to display later, or to the current thread's
+     * ExceptionScope if it has one. Safe to call from any thread.
      * @param e The exception to add
      */
     void addException(shared_ptr<Theta::Error> e);
 
     /**
-     * @brief Returns all the exceptions we encountered during the compilation process
+     * @brief Returns all the exceptions we encountered during the compilation process, or those collected by the
+     * current thread's ExceptionScope if it has one
      * @return A vector of compilation errors
      */
     vector<shared_ptr<Theta::Error>> getEncounteredExceptions();
@@ -83,7 +188,7 @@ namespace Theta {
     void clearExceptions();
 
     /**
-     * @brief Returns a LinkNode for a given capsule name, if it exists
+     * @brief Returns a LinkNode for a given capsule name, if it exists and has finished parsing
      * @param capsuleName The name of the capsule
      * @return A shared pointer to the LinkNode containing the parsed AST
      */
@@ -95,7 +200,39 @@ namespace Theta {
      * @param linkNode A shared pointer to the LinkNode to add
      */
     void addParsedLinkAST(string capsuleName, shared_ptr<Theta::LinkNode> linkNode);
-    
+
+    /**
+     * @brief Starts parsing a linked capsule on the worker pool. Each capsule is only ever parsed once: if it has
+     * already been requested, the existing result is returned instead.
+     * @param capsuleName The name of the linked capsule
+     * @param file The file that defines the capsule
+     * @param linkingCapsule The linked capsule whose source contains the link, or an empty string if the link is in
+     * a file that wasn't itself linked, such as the entrypoint
+     * @param parent The node to parent the LinkNode to
+     * @return The future LinkNode for the capsule, or nullopt if the link would make capsules depend on each other in a cycle
+     */
+    optional<shared_future<shared_ptr<Theta::LinkNode>>> requestLinkAST(
+      string capsuleName,
+      string file,
+      string linkingCapsule,
+      shared_ptr<ASTNode> parent
+    );
+
+    /**
+     * @brief Waits for a linked capsule requested through requestLinkAST to finish parsing. The calling thread helps
+     * parse other queued capsules while it waits.
+     * @param linkAST The future returned by requestLinkAST
+     * @return The LinkNode for the capsule
+     */
+    shared_ptr<Theta::LinkNode> awaitLinkAST(const shared_future<shared_ptr<Theta::LinkNode>> &linkAST);
+
+    /**
+     * @brief Forgets every linked capsule that has been parsed and checked so far, so that the next compile picks up
+     * any changes made to them since. Meant for long-running processes, which would otherwise keep using the first
+     * version of every capsule they ever linked.
+     */
+    void resetLinkedCapsules();
+
     /**
      * @brief Runs optimization passes on the AST (in-place)
      * @param The AST to optimize
@@ -103,6 +240,13 @@ namespace Theta {
      */
     bool optimizeAST(shared_ptr<ASTNode> &ast, bool silenceErrors = false);
 
+    /**
+     * @brief Runs the optimization passes that need a type checked AST on it (in-place), such as inlining and dead code
+     * elimination. Nodes they create or keep have their types resolved, like the type checker would have
+     * @param The type checked AST to optimize
+     */
+    void optimizeCheckedAST(shared_ptr<ASTNode> &ast);
+
     
     /**
      * @brief Generates a unique function identifier based on the function's name and its parameters to handle overloading.
@@ -122,6 +266,26 @@ namespace Theta {
      */
     static string getQualifiedFunctionIdentifierFromTypeSignature(string variableName, shared_ptr<TypeDeclarationNode> typeSig);
 
+    /**
+     * @brief The interned symbol id of the qualified function identifier, which is what scopes key functions by. The
+     * identifier itself isn't built unless the signature has never been seen before, and for function declarations the
+     * id is cached on the node.
+     *
+     * @param variableName The base name of the function.
+     * @param node The function declaration, function invocation or function type signature.
+     * @return int The id, whose name is what getQualifiedFunctionIdentifier returns.
+     */
+    static int getQualifiedFunctionId(string variableName, shared_ptr<ASTNode> node);
+
+    /**
+     * @brief Generates a name for a function that is unique to its parameters and definition, so that functions the
+     * compiler creates can be added to the module without naming collisions, and identical ones share a name.
+     *
+     * @param function The function declaration node to hash.
+     * @return string The hash, in hex.
+     */
+    static string generateFunctionHash(shared_ptr<FunctionDeclarationNode> function);
+
     /**
      * @brief Finds all AST nodes of a specific type within the tree rooted at a given node.
      * 
@@ -132,68 +296,226 @@ namespace Theta {
     static vector<shared_ptr<ASTNode>> findAllInTree(shared_ptr<ASTNode> node, ASTNode::Types type);
 
     /**
-     * @brief Creates a deep copy of a type declaration node, useful for cases where type information 
-     * needs to be duplicated without referencing the original.
-     * 
-     * @param original The original type declaration node to copy.
-     * @return shared_ptr<TypeDeclarationNode> The deep-copied type declaration node.
+     * @brief Adds the nodes of a specific type within the tree rooted at a given node to found, so that the whole
+     * search fills one vector.
      */
-    static shared_ptr<TypeDeclarationNode> deepCopyTypeDeclaration(shared_ptr<TypeDeclarationNode> node, shared_ptr<ASTNode> parent);
+    static void findAllInTree(const shared_ptr<ASTNode> &node, ASTNode::Types type, vector<shared_ptr<ASTNode>> &found);
 
+    /**
+     * @brief Serializes a module into a buffer, in a single pass.
+     */
     static vector<char> writeModuleToBuffer(BinaryenModuleRef &module);
 
+    /**
+     * @brief Finds the file that defines a capsule, using the persistent capsule index.
+     * @param capsuleName The name of the capsule
+     * @return The path of the file defining the capsule, if there is one
+     */
+    optional<string> findCapsuleFile(string capsuleName);
+
+    /**
+     * @brief Indexes the capsules in the tree ahead of the first link being resolved, see CapsuleIndex::prepare. Safe to
+     * call from another thread while compiling.
+     */
+    void prepareCapsuleIndex();
+
+    /**
+     * @brief Looks up the file that defines a capsule in the given map, falling back to the capsule index for
+     * capsules that haven't been resolved yet. Safe to call from any thread.
+     * @param capsuleName The name of the capsule
+     * @param filesByCapsule Capsules resolved so far. Newly resolved capsules are added to it
+     * @return The path of the file defining the capsule, if there is one
+     */
+    optional<string> resolveCapsuleFile(string capsuleName, shared_ptr<map<string, string>> filesByCapsule);
+
+    /**
+     * @brief Capsules that have been resolved so far, mapped to the files they are defined in. This is filled in
+     * lazily as links are parsed.
+     */
     shared_ptr<map<string, string>> filesByCapsuleName;
 
-    static string resolveAbsolutePath(string relativePath);
-  private:
     /**
-     * @brief Private constructor for Compiler. Initializes the compiler and discovers all capsules in the source files.
+     * @brief Toggles whether ASTs of unchanged source files are loaded from the on-disk AST cache instead of being
+     * lexed and parsed again. Enabled by default.
      */
-    Compiler() {
-      filesByCapsuleName = make_shared<map<string, string>>();
-      discoverCapsules();
+    void setIsASTCacheEnabled(bool isEnabled) { isASTCacheEnabled = isEnabled; }
+
+    /**
+     * @brief Toggles whether programs are loaded from the on-disk wasm cache when neither their entrypoint's source nor
+     * the interfaces of the capsules it links have changed since they were last compiled. Enabled by default.
+     */
+    void setIsWasmCacheEnabled(bool isEnabled) { isWasmCacheEnabled = isEnabled; }
+
+    /**
+     * @brief Toggles whether compile() writes a source map next to the module, mapping its code back to lines and
+     * columns of the entrypoint's source. The map is written to the output file's path with `.map` appended, and the
+     * module points at it. Disabled by default.
+     */
+    void setIsSourceMapEnabled(bool isEnabled) { isSourceMapEnabled = isEnabled; }
+
+    /**
+     * @brief Sets the number of threads that linked capsules are parsed and checked on, counting the thread that
+     * compiles. Only has an effect before anything has been handed to the worker pool.
+     * @param threads The number of threads to use
+     */
+    void setMaxThreads(size_t threads);
+
+    /**
+     * @brief The pool that linked capsules are parsed and checked on, for other work that can be split up the same way.
+     */
+    ThreadPool& getWorkerPool() { return workerPool; }
+
+    /**
+     * @brief Toggles whether the phases of each compile are timed into the phase timer. Disabled by default.
+     */
+    void setIsTimingPhases(bool isEnabled) { isTimingPhases = isEnabled; }
+
+    /**
+     * @brief Toggles whether each compile records how much memory it used into its stats. Sources are always lexed and
+     * parsed while it is on, rather than loaded from the AST or wasm cache, so that there is something to count.
+     * Disabled by default.
+     */
+    void setIsCollectingStats(bool isEnabled) { isCollectingStats = isEnabled; }
+
+    /**
+     * @brief Sets how hard compile() optimizes the modules it generates. Defaults to -O0.
+     */
+    void setOptimizationLevel(OptimizationLevel level) { optimizationLevel = level; }
+
+    /**
+     * @brief Sets which capsule functions, by name, the modules compile() generates export. Capsule functions that none
+     * of them can reach are left out of the module. By default every capsule function is exported.
+     */
+    void setExports(vector<string> functionNames) { exports = set<string>(functionNames.begin(), functionNames.end()); }
+
+    /**
+     * @brief The names of the capsule functions modules export, or an empty set if they export all of them
+     */
+    const set<string>& getExports() { return exports; }
+
+    /**
+     * @brief Sets how the heaps of the modules this compiler generates are sized and collected.
+     */
+    void setHeapOptions(HeapOptions options) { heapOptions = options; }
+
+    const HeapOptions& getHeapOptions() { return heapOptions; }
+
+    /**
+     * @brief Sets whether the modules this compiler generates meter fuel, so that the runtime can stop programs that run
+     * for too long, see Runtime::setExecutionLimits. Off by default, since metering slows programs down.
+     */
+    void setIsMeteringFuel(bool isEnabled) { isMeteringFuel = isEnabled; }
+
+    bool getIsMeteringFuel() { return isMeteringFuel; }
+
+    /**
+     * @brief Sets whether the modules this compiler generates call the host on entering and leaving each function, so
+     * that the runtime can profile them, see Profiler. Off by default.
+     */
+    void setIsProfiling(bool isEnabled) { isProfiling = isEnabled; }
+
+    bool getIsProfiling() { return isProfiling; }
+
+    /**
+     * @brief Sets whether compile() also writes a module for each capsule the program links, next to the output file
+     * and named after the capsule, so that a CapsuleLoader can load capsules the first time they are called rather
+     * than up front. Modules are cached per capsule, so only the capsules that changed are generated again. Off by
+     * default.
+     */
+    void setIsSplittingCapsules(bool isEnabled) { isSplittingCapsules = isEnabled; }
 
-      optimizationPasses = {
-        make_shared<LiteralInlinerPass>()
-      };
+    bool getIsSplittingCapsules() { return isSplittingCapsules; }
+
+    /**
+     * @brief Sets the functions the host provides to programs, replacing any set before. See HostFunction.
+     */
+    void setHostFunctions(vector<HostFunction> functions) {
+      hostFunctions.clear();
+      for (HostFunction &function : functions) hostFunctions.insert(make_pair(function.name, function));
     }
 
-    // Delete copy constructor and assignment operator to enforce singleton pattern
-    Compiler(const Compiler&) = delete;
-    Compiler& operator=(const Compiler&) = delete;
+    /**
+     * @brief The functions the host provides to programs, by name
+     */
+    const map<string, HostFunction>& getHostFunctions() { return hostFunctions; }
+
+    /**
+     * @brief The timer the phases of the last compile were recorded into, or nullptr if phases aren't being timed
+     */
+    PhaseTimer* getPhaseTimer() { return isTimingPhases ? &phaseTimer : nullptr; }
+
+    /**
+     * @brief The stats of the last compile, or nullptr if they aren't being collected
+     */
+    CompileStats* getCompileStats() { return isCollectingStats ? &compileStats : nullptr; }
+
+    static string resolveAbsolutePath(string relativePath);
+  private:
+    struct CapsuleCheck {
+      bool isValid = true;
+      vector<shared_ptr<Theta::Error>> exceptions;
+    };
 
+    static thread_local Compiler *active;
 
     bool isEmitTokens = false;
     bool isEmitAST = false;
     bool isEmitWAT = false;
+    bool isASTCacheEnabled = true;
+    bool isWasmCacheEnabled = true;
+    bool isTimingPhases = false;
+    bool isCollectingStats = false;
+    bool isSourceMapEnabled = false;
+    bool isMeteringFuel = false;
+    bool isProfiling = false;
+    bool isSplittingCapsules = false;
+    OptimizationLevel optimizationLevel;
+    set<string> exports;
+    HeapOptions heapOptions;
+    map<string, HostFunction> hostFunctions;
     vector<shared_ptr<Theta::Error>> encounteredExceptions;
-    map<string, shared_ptr<Theta::LinkNode>> parsedLinkASTs;
+    mutex exceptionsMutex;
 
-    vector<shared_ptr<OptimizationPass>> optimizationPasses; 
+    // Linked capsules are parsed on the worker pool, so everything to do with resolving them is guarded by linksMutex
+    map<string, shared_future<shared_ptr<Theta::LinkNode>>> parsedLinkASTs;
+    map<string, set<string>> linkedCapsulesByCapsule;
+    map<string, shared_future<CapsuleCheck>> checkedCapsules;
+
+    // The modules generated for linked capsules when splitting capsules, by build key, so entrypoints that link the
+    // same capsule share its module
+    map<uint64_t, shared_future<vector<char>>> generatedCapsules;
+    mutex linksMutex;
+    mutex outputMutex;
+    ThreadPool workerPool;
+
+    CapsuleIndex capsuleIndex;
+    ASTCache astCache;
+    WasmCache wasmCache;
+    PhaseTimer phaseTimer;
+    CompileStats compileStats;
+
+    /**
+     * @brief Compiles a program once compile() or compileBatch() has set up the compile's options, timer and stats.
+     * Entrypoints compiled together each go through here on their own thread.
+     */
+    bool compileEntrypoint(string entrypoint, string outputFile);
 
     /**
-     * @brief Outputs the contents of a given WASM module to the given file
-     * @param module The module to write
+     * @brief Outputs a compiled WASM module to the given file
+     * @param wasm The binary contents of the module
      * @param file The filename to write the module to
      */
-    void writeModuleToFile(BinaryenModuleRef &module, string file);
+    void writeWasmToFile(string_view wasm, string file);
 
     /**
-     * @brief Discovers all capsules in the Theta source code.
-     *
-     * Scans the current directory and subdirectories to find all `.th` files and extracts capsule names.
+     * @brief Runs Binaryen's optimizer on a generated module (in-place), at the given level
      */
-    void discoverCapsules();
+    void optimizeModule(BinaryenModuleRef module, const OptimizationLevel &level);
 
     /**
-     * @brief Finds the capsule name associated with the given file.
-     *
-     * Reads the content of the file and searches for the `capsule` keyword to identify the capsule name.
-     *
-     * @param file The file for which to find the capsule name.
-     * @return The capsule name corresponding to the file.
+     * @brief Writes errors to the console, all in one write
      */
-    string findCapsuleName(string file);
+    void displayExceptions(const vector<shared_ptr<Theta::Error>> &exceptions);
 
     /**
      * @brief Outputs a given AST to STDOUT
@@ -201,5 +523,85 @@ namespace Theta {
      * @param fileName The filename that appears as the "Source file" for the ast
      */
     void outputAST(shared_ptr<ASTNode> ast, string fileName);
+
+    /**
+     * @brief Builds the AST for a file, loading it from the AST cache if the file hasn't changed since it was cached.
+     * @param linkedCapsuleName The name of the capsule the file was linked as, or an empty string if it wasn't linked
+     */
+    shared_ptr<Theta::ASTNode> buildASTFromFile(string file, string linkedCapsuleName);
+
+    /**
+     * @brief Builds the AST for a source file.
+     * @param linkedCapsuleName The name of the capsule the file was linked as, or an empty string if it wasn't linked
+     * @param isCacheable Whether the AST should be stored in the AST cache, provided it parsed without errors
+     */
+    shared_ptr<Theta::ASTNode> buildASTFromSource(shared_ptr<const SourceFile> source, string fileName, string linkedCapsuleName, bool isCacheable);
+
+    /**
+     * @brief Resolves the links of an AST loaded from the AST cache, which only records the linked capsules' names.
+     * @return false if any link can't be resolved, in which case the file should be parsed to report why
+     */
+    bool resolveCachedLinks(shared_ptr<ASTNode> ast, string linkedCapsuleName);
+
+    /**
+     * @brief Builds the capsule graph of a program from its links.
+     */
+    CapsuleGraph buildCapsuleGraph(shared_ptr<ASTNode> ast, string file);
+
+    /**
+     * @brief Optimizes and type checks every capsule a program links, on the worker pool. Capsules only wait on the
+     * capsules they link, so independent capsules are checked at the same time. Each capsule is only checked once,
+     * and the errors found are reported in link order.
+     * @param graph The capsule graph of the program. Its entrypoint is not checked.
+     * @return true If all the linked capsules are valid
+     */
+    bool checkLinkedCapsules(const CapsuleGraph &graph);
+
+    /**
+     * @brief Writes a module for each capsule a program links, see setIsSplittingCapsules. Capsules are only checked
+     * and generated if a module for them isn't cached.
+     * @param graph The capsule graph of the program. Its entrypoint is not written.
+     * @param outputFile The file the entrypoint's module is written to, which the capsules' modules are written beside.
+     * @param buildOptions The options the modules are built with, which go into their cache keys.
+     * @return true If every linked capsule was valid and written
+     */
+    bool compileLinkedCapsules(const CapsuleGraph &graph, string outputFile, string buildOptions, bool isCacheable);
+
+    /**
+     * @brief The module of a checked linked capsule, generated on the worker pool the first time it's asked for with
+     * the given build key.
+     */
+    shared_future<vector<char>> requestCapsuleWasm(const CapsuleUnit &unit, uint64_t buildKey, bool isCacheable);
+
+    /**
+     * @brief Optimizes and type checks a single linked capsule, with its own optimization passes and type checker.
+     */
+    CapsuleCheck checkCapsule(const CapsuleUnit &unit);
+
+    /**
+     * @brief Runs the given optimization passes on an AST (in-place) with a PassManager, stopping at the first stage
+     * that reports an error. The passes enable each other, such as a folded constant becoming inlinable, so they are run
+     * again in rounds until none of them change anything, up to PassManager::MAX_ROUNDS times
+     * @param linkedCapsuleName The name of the capsule the AST was linked as, or an empty string if it wasn't linked
+     * @return true If all the passes succeeded
+     */
+    bool runOptimizationPasses(shared_ptr<ASTNode> &ast, vector<shared_ptr<OptimizationPass>> &passes, string linkedCapsuleName = "");
+
+    /**
+     * @brief Creates a fresh instance of each optimization pass. Passes keep state while they run, so every thread
+     * optimizing an AST needs its own.
+     */
+    static vector<shared_ptr<OptimizationPass>> createOptimizationPasses();
+
+    /**
+     * @brief Creates a fresh instance of each optimization pass that runs once the AST has type checked.
+     * @param exports The capsule functions the module exports, or an empty set if it exports all of them
+     */
+    static vector<shared_ptr<OptimizationPass>> createCheckedOptimizationPasses(const set<string> &exports);
+
+    /**
+     * @brief Checks whether capsule `to` is linked by `from`, directly or through other links. Expects linksMutex to be held
+     */
+    bool isLinkedTransitively(const string &from, const string &to);
   };
 }
@@ -0,0 +1,205 @@
+#include "CompilerSession.hpp"
+#include "Compiler.hpp"
+#include "CodeGen.hpp"
+#include "lexer/SourceFile.hpp"
+#include "runtime/Runtime.hpp"
+
+using namespace std;
+using namespace Theta;
+
+CompilerSession::CompilerSession() : compiler(make_unique<Compiler>()) {}
+
+// Defined here, where Compiler and Runtime are complete types
+CompilerSession::~CompilerSession() {
+  if (compilerWarmUp.valid()) compilerWarmUp.wait();
+  if (runtimeWarmUp.valid()) runtimeWarmUp.wait();
+}
+
+bool CompilerSession::compile(string entrypoint, string outputFile, bool isEmitTokens, bool isEmitAST, bool isEmitWAT) {
+  awaitWarmUp(compilerWarmUp);
+
+  bool isCompiled = compiler->compile(entrypoint, outputFile, isEmitTokens, isEmitAST, isEmitWAT);
+  if (isCompiled && isNativeCacheEnabled) precompileOutput(outputFile);
+
+  return isCompiled;
+}
+
+bool CompilerSession::compileBatch(
+  const vector<pair<string, string>> &entrypoints,
+  bool isEmitTokens,
+  bool isEmitAST,
+  bool isEmitWAT
+) {
+  awaitWarmUp(compilerWarmUp);
+
+  bool isCompiled = compiler->compileBatch(entrypoints, isEmitTokens, isEmitAST, isEmitWAT);
+
+  // The runtime belongs to this thread, so the modules are precompiled one after another
+  if (isCompiled && isNativeCacheEnabled) {
+    for (const auto &[entrypoint, outputFile] : entrypoints) precompileOutput(outputFile);
+  }
+
+  return isCompiled;
+}
+
+void CompilerSession::precompileOutput(const string &outputFile) {
+  shared_ptr<SourceFile> output = SourceFile::open(outputFile);
+  if (!output) return;
+
+  string_view wasm = output->view();
+  getRuntime().precompile(vector<char>(wasm.begin(), wasm.end()));
+}
+
+vector<char> CompilerSession::compileDirect(string source, OptimizationLevel level) {
+  awaitWarmUp(compilerWarmUp);
+
+  return compiler->compileDirect(source, level);
+}
+
+ExecutionContext CompilerSession::execute(const vector<char> &wasm, const string &functionName) {
+  return getRuntime().execute(wasm, functionName);
+}
+
+void CompilerSession::invoke(
+  const vector<char> &wasm,
+  const string &functionName,
+  const wasm::Val args[],
+  size_t argCount,
+  wasm::Val results[],
+  size_t resultCapacity
+) {
+  getRuntime().invoke(wasm, functionName, args, argCount, results, resultCapacity);
+}
+
+void CompilerSession::warmUp() {
+  if (compilerWarmUp.valid() || runtimeWarmUp.valid()) return;
+
+  Compiler *warmingCompiler = compiler.get();
+
+  compilerWarmUp = async(launch::async, [warmingCompiler]() {
+    CodeGen::getCoreLangWasm();
+    warmingCompiler->prepareCapsuleIndex();
+  });
+
+  // Only the engine can be made ahead of time, since the runtime's store belongs to the thread that makes it
+  runtimeWarmUp = async(launch::async, []() { Runtime::getEngine(); });
+}
+
+void CompilerSession::awaitWarmUp(future<void> &warmUp) {
+  if (warmUp.valid()) warmUp.get();
+}
+
+Runtime& CompilerSession::getRuntime() {
+  if (!runtime) {
+    awaitWarmUp(runtimeWarmUp);
+
+    runtime = make_unique<Runtime>();
+    if (isNativeCacheEnabled) runtime->setNativeCodeCache(NativeCodeCache());
+    runtime->setExecutionLimits(executionLimits);
+
+    for (size_t i = 0; i < hostFunctions.size(); i++) runtime->setHostFunction(hostFunctions[i].name, hostCallbacks[i]);
+  }
+
+  return *runtime;
+}
+
+vector<shared_ptr<Error>> CompilerSession::getEncounteredExceptions() {
+  return compiler->getEncounteredExceptions();
+}
+
+void CompilerSession::clearExceptions() {
+  compiler->clearExceptions();
+}
+
+void CompilerSession::resetLinkedCapsules() {
+  compiler->resetLinkedCapsules();
+}
+
+void CompilerSession::setIsASTCacheEnabled(bool isEnabled) {
+  compiler->setIsASTCacheEnabled(isEnabled);
+}
+
+void CompilerSession::setIsWasmCacheEnabled(bool isEnabled) {
+  compiler->setIsWasmCacheEnabled(isEnabled);
+}
+
+void CompilerSession::setIsNativeCacheEnabled(bool isEnabled) {
+  isNativeCacheEnabled = isEnabled;
+
+  if (runtime) runtime->setNativeCodeCache(isEnabled ? make_optional(NativeCodeCache()) : nullopt);
+}
+
+void CompilerSession::setIsSourceMapEnabled(bool isEnabled) {
+  compiler->setIsSourceMapEnabled(isEnabled);
+}
+
+void CompilerSession::setMaxThreads(size_t threads) {
+  compiler->setMaxThreads(threads);
+}
+
+void CompilerSession::setIsTimingPhases(bool isEnabled) {
+  compiler->setIsTimingPhases(isEnabled);
+}
+
+void CompilerSession::setIsCollectingStats(bool isEnabled) {
+  compiler->setIsCollectingStats(isEnabled);
+}
+
+void CompilerSession::setOptimizationLevel(OptimizationLevel level) {
+  compiler->setOptimizationLevel(level);
+}
+
+void CompilerSession::setExports(vector<string> functionNames) {
+  compiler->setExports(functionNames);
+}
+
+void CompilerSession::setHeapOptions(HeapOptions options) {
+  compiler->setHeapOptions(options);
+}
+
+void CompilerSession::setExecutionLimits(ExecutionLimits limits) {
+  executionLimits = limits;
+
+  compiler->setIsMeteringFuel(limits.isLimited());
+  if (runtime) runtime->setExecutionLimits(limits);
+}
+
+void CompilerSession::setIsProfiling(bool isEnabled) {
+  compiler->setIsProfiling(isEnabled);
+}
+
+void CompilerSession::setIsSplittingCapsules(bool isEnabled) {
+  compiler->setIsSplittingCapsules(isEnabled);
+}
+
+Profiler& CompilerSession::getProfiler() {
+  return getRuntime().getProfiler();
+}
+
+bool CompilerSession::addHostFunction(HostFunction function, HostCallback callback) {
+  if (!function.isValid()) return false;
+
+  size_t index = 0;
+  while (index < hostFunctions.size() && hostFunctions[index].name != function.name) index++;
+
+  if (index == hostFunctions.size()) {
+    hostFunctions.push_back(function);
+    hostCallbacks.push_back(callback);
+  } else {
+    hostFunctions[index] = function;
+    hostCallbacks[index] = callback;
+  }
+
+  compiler->setHostFunctions(hostFunctions);
+  if (runtime) runtime->setHostFunction(function.name, callback);
+
+  return true;
+}
+
+PhaseTimer* CompilerSession::getPhaseTimer() {
+  return compiler->getPhaseTimer();
+}
+
+CompileStats* CompilerSession::getCompileStats() {
+  return compiler->getCompileStats();
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "exceptions/Error.hpp"
+#include "compiler/PhaseTimer.hpp"
+#include "compiler/CompileStats.hpp"
+#include "compiler/OptimizationLevel.hpp"
+#include "compiler/HeapOptions.hpp"
+#include "compiler/HostFunction.hpp"
+#include "runtime/ExecutionContext.hpp"
+#include "runtime/ExecutionLimits.hpp"
+#include "runtime/HostCall.hpp"
+#include "runtime/Profiler.hpp"
+
+using namespace std;
+
+namespace Theta {
+  class Compiler;
+  class Runtime;
+
+  /**
+   * @brief The entry point for embedding Theta. A session owns its own compiler and runtime: its options, the
+   * exceptions it encountered, the capsules it linked, its optimization passes and its wasm store. Sessions don't
+   * share any of that with each other, so any number of them can compile and run programs on different threads at
+   * the same time.
+   *
+   * A single session is not meant to be used from several threads at once. Its work is still spread over several
+   * threads internally, see setMaxThreads.
+   */
+  class CompilerSession {
+  public:
+    CompilerSession();
+
+    ~CompilerSession();
+
+    CompilerSession(const CompilerSession&) = delete;
+    CompilerSession& operator=(const CompilerSession&) = delete;
+
+    /**
+     * @brief Compiles the program starting from the given entrypoint file, and writes the module to a file.
+     * @param entrypoint The file to start compiling from.
+     * @param outputFile The file to write the compiled module to.
+     * @param isEmitTokens Toggles whether or not the lexer tokens should be output to the console
+     * @param isEmitAST Toggles whether or not the AST should be output to the console
+     * @param isEmitWAT Toggles whether or not the generated WAT should be output to the console
+     * @return true If the program compiled and the output was written
+     */
+    bool compile(string entrypoint, string outputFile, bool isEmitTokens = false, bool isEmitAST = false, bool isEmitWAT = false);
+
+    /**
+     * @brief Compiles several programs at once, each from its entrypoint file to its own output file, sharing the
+     * capsules they link. See Compiler::compileBatch.
+     * @param entrypoints Each entrypoint file, with the file to write its module to.
+     * @return true If every program compiled and its output was written
+     */
+    bool compileBatch(
+      const vector<pair<string, string>> &entrypoints,
+      bool isEmitTokens = false,
+      bool isEmitAST = false,
+      bool isEmitWAT = false
+    );
+
+    /**
+     * @brief Compiles source code.
+     * @param source The source code to compile.
+     * @param level How hard to optimize the module. Defaults to -O0, to keep interactive compiles fast
+     * @return A buffer containing the compiled WASM module, or an empty buffer if it didn't compile
+     */
+    vector<char> compileDirect(string source, OptimizationLevel level = OptimizationLevel());
+
+    /**
+     * @brief Runs a function exported by a compiled module on the session's runtime.
+     * @param wasm The compiled module.
+     * @param functionName The name of the exported function to call.
+     * @return The result of the call
+     */
+    ExecutionContext execute(const vector<char> &wasm, const string &functionName);
+
+    /**
+     * @brief Calls a function exported by a compiled module with arguments on the session's runtime, see
+     * Runtime::invoke.
+     */
+    void invoke(
+      const vector<char> &wasm,
+      const string &functionName,
+      const wasm::Val args[],
+      size_t argCount,
+      wasm::Val results[],
+      size_t resultCapacity
+    );
+
+    /**
+     * @brief Starts getting ready for the session's first compile and run, in the background: making the engine,
+     * reading the core module and indexing the capsules in the tree. The first compile or run waits for whatever it
+     * needs that isn't done yet, so a session that is warmed up while waiting on input answers its first request as
+     * fast as any other. Engine options have to be set before, see Runtime::setEngineOptions.
+     */
+    void warmUp();
+
+    /**
+     * @brief Returns all the exceptions the session encountered since they were last cleared
+     */
+    vector<shared_ptr<Error>> getEncounteredExceptions();
+
+    void clearExceptions();
+
+    /**
+     * @brief Forgets the linked capsules parsed so far, so that changes to them are picked up by the next compile
+     */
+    void resetLinkedCapsules();
+
+    void setIsASTCacheEnabled(bool isEnabled);
+
+    void setIsWasmCacheEnabled(bool isEnabled);
+
+    /**
+     * @brief Toggles whether the machine code V8 compiles modules to is kept on disk, see NativeCodeCache. The session
+     * stores the code of the modules it runs, and compile() precompiles the module it writes, so that later runs in any
+     * process can skip compiling them. Disabled by default.
+     */
+    void setIsNativeCacheEnabled(bool isEnabled);
+
+    /**
+     * @brief Toggles whether compile() writes a source map next to the module. Disabled by default.
+     */
+    void setIsSourceMapEnabled(bool isEnabled);
+
+    /**
+     * @brief Sets the number of threads the session compiles on. Only has an effect before the first compile.
+     */
+    void setMaxThreads(size_t threads);
+
+    /**
+     * @brief Toggles whether the phases of each compile are timed. Disabled by default.
+     */
+    void setIsTimingPhases(bool isEnabled);
+
+    /**
+     * @brief Toggles whether each compile records how much memory it used. Disabled by default.
+     */
+    void setIsCollectingStats(bool isEnabled);
+
+    /**
+     * @brief Sets how hard compile() optimizes the modules it generates. Defaults to -O0.
+     */
+    void setOptimizationLevel(OptimizationLevel level);
+
+    /**
+     * @brief Sets which capsule functions, by name, compile() exports. Capsule functions that none of them can reach
+     * are left out of the module. By default every capsule function is exported.
+     */
+    void setExports(vector<string> functionNames);
+
+    /**
+     * @brief Sets how the heaps of the modules compile() generates are sized and collected.
+     */
+    void setHeapOptions(HeapOptions options);
+
+    /**
+     * @brief Sets how long the programs the session runs are allowed to run for. Programs it compiles from then on meter
+     * fuel whenever either limit is set, since only metered programs can be stopped, see ExecutionLimits.
+     */
+    void setExecutionLimits(ExecutionLimits limits);
+
+    /**
+     * @brief Sets whether the programs the session compiles from then on can be profiled, see getProfiler.
+     */
+    void setIsProfiling(bool isEnabled);
+
+    /**
+     * @brief Sets whether compile() also writes a module for each capsule the program links, for a CapsuleLoader to
+     * load as they are called. Disabled by default.
+     */
+    void setIsSplittingCapsules(bool isEnabled);
+
+    /**
+     * @brief Where the time went in the programs the session ran that were compiled with profiling.
+     */
+    Profiler& getProfiler();
+
+    /**
+     * @brief Provides a function to the programs the session compiles and runs, which they call by name. See
+     * HostFunction for the types it can take and return, and HostCall for reading the lists it's passed in place.
+     * @param function The function's name and type.
+     * @param callback What it does when a program calls it.
+     * @return false If the function's types aren't ones a host function can have, in which case it isn't added
+     *
+     * A function with the name of one added before replaces it, and programs compiled before that call it call the new
+     * callback from then on, with the types they were compiled with.
+     */
+    bool addHostFunction(HostFunction function, HostCallback callback);
+
+    /**
+     * @brief The timings of the last compile's phases, or nullptr if phases aren't being timed
+     */
+    PhaseTimer* getPhaseTimer();
+
+    /**
+     * @brief How much memory the last compile used, or nullptr if stats aren't being collected
+     */
+    CompileStats* getCompileStats();
+
+    /**
+     * @brief The compiler underneath the session, for anything not exposed here
+     */
+    Compiler& getCompiler() { return *compiler; }
+
+  private:
+    unique_ptr<Compiler> compiler;
+
+    // Only started once the session actually runs something, since starting a store isn't free
+    unique_ptr<Runtime> runtime;
+
+    bool isNativeCacheEnabled = false;
+
+    ExecutionLimits executionLimits;
+
+    vector<HostFunction> hostFunctions;
+    vector<HostCallback> hostCallbacks;
+
+    // Declared last, so that warming up finishes before anything it uses is destroyed
+    future<void> compilerWarmUp;
+    future<void> runtimeWarmUp;
+
+    Runtime& getRuntime();
+
+    /**
+     * @brief Compiles a module that was written to a file with V8, so its machine code goes in the native code cache.
+     */
+    void precompileOutput(const string &outputFile);
+
+    /**
+     * @brief Waits for a warm up started by warmUp to finish, if there is one, rethrowing anything it threw.
+     */
+    static void awaitWarmUp(future<void> &warmUp);
+  };
+}
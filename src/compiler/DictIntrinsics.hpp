@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * The functions built into the language for dictionaries of Numbers and Booleans. A call to one of these names whose
+   * first argument is a dictionary always calls the intrinsic:
+   *
+   * - get(dict, key) is the value of the key, trapping if the dictionary doesn't have it
+   * - has(dict, key) is whether the dictionary has the key
+   */
+  namespace DictIntrinsics {
+    const string GET = "get";
+    const string HAS = "has";
+
+    inline bool isDictIntrinsic(const string &name) {
+      return name == GET || name == HAS;
+    }
+  }
+}
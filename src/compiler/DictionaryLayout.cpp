@@ -0,0 +1,117 @@
+#include "DictionaryLayout.hpp"
+#include <cstring>
+#include <unordered_set>
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  void writeInt32(string &bytes, int offset, int32_t value) {
+    memcpy(&bytes[offset], &value, sizeof(int32_t));
+  }
+}
+
+DictionaryLayout DictionaryLayout::fromKeys(const vector<int> &keys) {
+  unordered_set<int> uniqueKeys(keys.begin(), keys.end());
+  int minCapacity = getCapacity(uniqueKeys.size());
+
+  for (int capacity = minCapacity; capacity <= minCapacity * MAX_PERFECT_HASH_GROWTH; capacity *= 2) {
+    DictionaryLayout layout = fromKeys(keys, capacity);
+
+    if (layout.isPerfect()) return layout;
+  }
+
+  return fromKeys(keys, minCapacity);
+}
+
+DictionaryLayout DictionaryLayout::fromKeys(const vector<int> &keys, int capacity) {
+  DictionaryLayout layout;
+  layout.capacity = capacity;
+  layout.keys.assign(capacity, 0);
+  layout.distances.assign(capacity, 0);
+
+  for (int key : keys) {
+    if (layout.getSlot(key) == -1) layout.insert(key);
+  }
+
+  return layout;
+}
+
+int DictionaryLayout::getCapacity(int count) {
+  int capacity = 1;
+
+  // There's always at least one empty slot, so a probe for a missing key ends
+  while (capacity * 3 < count * 4 || capacity <= count) capacity *= 2;
+
+  return capacity;
+}
+
+uint32_t DictionaryLayout::hash(int key) {
+  // Fibonacci hashing, folding the high bits down since the table only looks at the low ones
+  uint32_t hashed = static_cast<uint32_t>(key) * 0x9E3779B1u;
+
+  return hashed ^ (hashed >> 16);
+}
+
+int DictionaryLayout::getSlot(int key) const {
+  int mask = capacity - 1;
+  int slot = hash(key) & mask;
+
+  for (int distance = 0; keys.at(slot) != 0 && distances.at(slot) >= distance; distance++) {
+    if (keys.at(slot) == key) return slot;
+
+    slot = (slot + 1) & mask;
+  }
+
+  return -1;
+}
+
+bool DictionaryLayout::isPerfect() const {
+  for (int i = 0; i < capacity; i++) {
+    if (keys.at(i) != 0 && distances.at(i) != 0) return false;
+  }
+
+  return true;
+}
+
+string DictionaryLayout::toBytes(const unordered_map<int, int64_t> &values) const {
+  string bytes(getByteSize(), '\0');
+
+  writeInt32(bytes, 0, capacity);
+  writeInt32(bytes, 4, count);
+
+  for (int i = 0; i < capacity; i++) {
+    if (keys.at(i) == 0) continue;
+
+    writeInt32(bytes, getEntryOffset(i), keys.at(i));
+    writeInt32(bytes, getEntryOffset(i) + DISTANCE_OFFSET, distances.at(i));
+
+    auto value = values.find(keys.at(i));
+    if (value != values.end()) memcpy(&bytes[getEntryOffset(i) + VALUE_OFFSET], &value->second, sizeof(int64_t));
+  }
+
+  return bytes;
+}
+
+void DictionaryLayout::insert(int key) {
+  int mask = capacity - 1;
+  int slot = hash(key) & mask;
+  int distance = 0;
+
+  count++;
+
+  // Each entry passed that is closer to its own slot than the one being placed gives up its slot to it, and carries on
+  // looking for one of its own
+  while (keys.at(slot) != 0) {
+    if (distances.at(slot) < distance) {
+      swap(keys.at(slot), key);
+      swap(distances.at(slot), distance);
+    }
+
+    slot = (slot + 1) & mask;
+    distance++;
+  }
+
+  keys.at(slot) = key;
+  distances.at(slot) = distance;
+}
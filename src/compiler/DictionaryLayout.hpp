@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Where the entries of a dictionary go in its hash table. Dictionaries are open addressing tables probed
+   * linearly, with Robin Hood insertion: an entry further from the slot its key hashes to takes the place of one closer
+   * to its own, so lookups can stop as soon as they pass an entry closer to home than the key would be.
+   *
+   * A dictionary is its capacity, a power of two, and its count, each an i32, followed by its entries. Each entry is
+   * its key, its distance from the slot its key hashes to, and its value, which takes 8 bytes whatever its type. A key
+   * of 0 marks an empty slot. The core module looks keys up and inserts them the same way, see Theta.Dict in
+   * src/wasm/ThetaLangCore.wat, so a table laid out at compile time can be read at runtime.
+   */
+  struct DictionaryLayout {
+    static const int HEADER_SIZE = 8;
+    static const int ENTRY_SIZE = 16;
+    static const int DISTANCE_OFFSET = 4;
+    static const int VALUE_OFFSET = 8;
+
+    int capacity = 0;
+    int count = 0;
+
+    // The key in each slot, or 0 if it is empty, and how far each is from the slot its key hashes to
+    vector<int> keys;
+    vector<int> distances;
+
+    /**
+     * @brief Lays out a dictionary of the given keys, none of which may be 0. If growing the table a little makes every
+     * key land in the slot it hashes to, the layout is a perfect hash and every lookup takes a single probe.
+     *
+     * @param keys The keys, which may repeat.
+     */
+    static DictionaryLayout fromKeys(const vector<int> &keys);
+
+    /**
+     * @brief The smallest capacity that keeps a table of the given number of keys at most 3/4 full.
+     */
+    static int getCapacity(int count);
+
+    /**
+     * @brief Spreads keys that are close together, such as interned ids, over the table.
+     */
+    static uint32_t hash(int key);
+
+    /**
+     * @brief The slot holding a key, or -1 if the dictionary doesn't have it.
+     */
+    int getSlot(int key) const;
+
+    /**
+     * @brief The offset of a slot's entry from the start of the dictionary.
+     */
+    int getEntryOffset(int slot) const { return HEADER_SIZE + slot * ENTRY_SIZE; }
+
+    int getByteSize() const { return HEADER_SIZE + capacity * ENTRY_SIZE; }
+
+    /**
+     * @brief Whether every key is in the slot it hashes to.
+     */
+    bool isPerfect() const;
+
+    /**
+     * @brief The bytes of the dictionary in memory, with the given values for the keys that have them and 0 for the
+     * rest. Booleans are stored in the low 4 bytes of their value, which is where they are read back from.
+     */
+    string toBytes(const unordered_map<int, int64_t> &values) const;
+
+  private:
+    // How many times the smallest capacity a table can be grown to, looking for a perfect hash
+    static const int MAX_PERFECT_HASH_GROWTH = 4;
+
+    static DictionaryLayout fromKeys(const vector<int> &keys, int capacity);
+
+    void insert(int key);
+  };
+}
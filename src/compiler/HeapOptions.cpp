@@ -0,0 +1,46 @@
+#include "HeapOptions.hpp"
+#include <cctype>
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  optional<int> parseBoundedInt(const string &value, int min, int max) {
+    if (value.empty() || value.length() > 9) return nullopt;
+
+    for (char c : value) {
+      if (!isdigit(static_cast<unsigned char>(c))) return nullopt;
+    }
+
+    int parsed = stoi(value);
+    if (parsed < min || parsed > max) return nullopt;
+
+    return parsed;
+  }
+}
+
+optional<int> HeapOptions::parsePages(const string &pages) {
+  return parseBoundedInt(pages, MIN_PAGES, MAX_PAGES);
+}
+
+optional<int> HeapOptions::parseThreshold(const string &threshold) {
+  return parseBoundedInt(threshold, 1, 100);
+}
+
+bool HeapOptions::isValid() const {
+  return initialPages >= MIN_PAGES
+    && maximumPages <= MAX_PAGES
+    && initialPages <= maximumPages
+    && collectionThreshold >= 1
+    && collectionThreshold <= 100;
+}
+
+string HeapOptions::toString() const {
+  string description = "--heap-pages=" + to_string(initialPages)
+    + " --max-heap-pages=" + to_string(maximumPages)
+    + " --gc-threshold=" + to_string(collectionThreshold);
+
+  if (isTimingCollections) description += " --time-gc";
+
+  return description;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief How a generated module's heap is sized and collected. Memory is given in 64k pages: the first page holds
+   * the shadow stack, and the rest is split into the collector's two semispaces. The heap doubles whenever more than
+   * the collection threshold of a semispace survives a collection, until it reaches the maximum.
+   */
+  struct HeapOptions {
+    static const int MIN_PAGES = 3;
+    static const int MAX_PAGES = 65536;
+    static const int PAGE_BYTES = 65536;
+
+    int initialPages = 9;
+    int maximumPages = 1024;
+
+    // How much of the space left after a collection, as a percentage, can be allocated before the next one
+    int collectionThreshold = 50;
+
+    // Collection pauses are only timed if this is set, since the clock is imported from the host
+    bool isTimingCollections = false;
+
+    /**
+     * @brief Parses a count of pages, for the --heap-pages and --max-heap-pages flags.
+     * @return The number of pages, or nullopt if it isn't a number between MIN_PAGES and MAX_PAGES
+     */
+    static optional<int> parsePages(const string &pages);
+
+    /**
+     * @brief Parses a collection threshold, for the --gc-threshold flag.
+     * @return The threshold, or nullopt if it isn't a percentage between 1 and 100
+     */
+    static optional<int> parseThreshold(const string &threshold);
+
+    /**
+     * @brief Whether the options describe a heap that can exist, with no more initial pages than maximum ones.
+     */
+    bool isValid() const;
+
+    /**
+     * @brief A stable description of the options, such as `--heap-pages=9 --max-heap-pages=1024 --gc-threshold=50`.
+     * Programs compiled with different heaps are cached apart by it.
+     */
+    string toString() const;
+  };
+}
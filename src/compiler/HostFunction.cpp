@@ -0,0 +1,43 @@
+#include "HostFunction.hpp"
+#include "DataTypes.hpp"
+
+using namespace std;
+using namespace Theta;
+
+bool HostFunction::isValid() const {
+  if (name.empty() || !parseType(returnType, false)) return false;
+
+  for (const string &paramType : paramTypes) {
+    if (!parseType(paramType, true)) return false;
+  }
+
+  return true;
+}
+
+string HostFunction::toString() const {
+  string description = name + "(";
+
+  for (size_t i = 0; i < paramTypes.size(); i++) {
+    if (i > 0) description += ", ";
+    description += paramTypes[i];
+  }
+
+  return description + ") -> " + returnType;
+}
+
+shared_ptr<TypeDeclarationNode> HostFunction::parseType(const string &type, bool isParam) {
+  if (type == DataTypes::NUMBER || type == DataTypes::BOOLEAN) return make_shared<TypeDeclarationNode>(type, nullptr);
+
+  if (!isParam) return nullptr;
+
+  for (const string &elementType : { DataTypes::NUMBER, DataTypes::BOOLEAN }) {
+    if (type != DataTypes::LIST + "<" + elementType + ">") continue;
+
+    shared_ptr<TypeDeclarationNode> listType = make_shared<TypeDeclarationNode>(DataTypes::LIST, nullptr);
+    listType->setValue(make_shared<TypeDeclarationNode>(elementType, listType));
+
+    return listType;
+  }
+
+  return nullptr;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "parser/ast/TypeDeclarationNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A function the host provides to Theta programs. Programs call it by name like a capsule function, and the
+   * module imports it from the "host" module, for the runtime to supply (see Runtime::setHostFunction). A capsule
+   * function of the same name and arity takes precedence over it.
+   *
+   * Types are given as in Theta source. Params can be Numbers, Booleans, or Lists of either, and the result a Number or
+   * Boolean. Lists are passed as their address in memory, so the host reads them in place rather than copying them out,
+   * see HostCall.
+   */
+  struct HostFunction {
+    // The module host functions are imported from
+    static inline const string IMPORT_MODULE = "host";
+
+    string name;
+    vector<string> paramTypes;
+    string returnType;
+
+    /**
+     * @brief The name the function is imported as within the module, such as Host.checksum.
+     */
+    string getImportName() const { return "Host." + name; }
+
+    /**
+     * @brief Whether every type is one a host function can take or return.
+     */
+    bool isValid() const;
+
+    /**
+     * @brief A stable description of the function, such as `checksum(List<Number>) -> Number`. Programs compiled
+     * against different host functions are cached apart by it.
+     */
+    string toString() const;
+
+    /**
+     * @brief The type a param or the result is given as, or nullptr if it isn't one a host function can have.
+     * @param type The type, such as List<Number>.
+     * @param isParam Whether it's the type of a param, which can also be a list.
+     */
+    static shared_ptr<TypeDeclarationNode> parseType(const string &type, bool isParam);
+  };
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * The functions built into the language for lists of Numbers and Booleans. A call to one of these names whose first
+   * argument is a list always calls the intrinsic:
+   *
+   * - length(list) is the number of elements in the list
+   * - sum(list) adds up a list of Numbers, two elements at a time with SIMD
+   * - map(list, function) is a new list of function(element) for each element
+   * - filter(list, function) is a new list of the elements for which function(element) is true
+   * - reduce(list, function, initial) folds the list from the left, as function(accumulator, element)
+   *
+   * The functions passed to map, filter and reduce must be capsule functions, named directly, so the loops over the
+   * list can call them without going through a closure.
+   */
+  namespace ListIntrinsics {
+    const string LENGTH = "length";
+    const string SUM = "sum";
+    const string MAP = "map";
+    const string FILTER = "filter";
+    const string REDUCE = "reduce";
+
+    inline bool isListIntrinsic(const string &name) {
+      return name == LENGTH || name == SUM || name == MAP || name == FILTER || name == REDUCE;
+    }
+
+    /**
+     * @brief The number of arguments an intrinsic takes, the list included.
+     */
+    inline int getArity(const string &name) {
+      if (name == MAP || name == FILTER) return 2;
+      if (name == REDUCE) return 3;
+
+      return 1;
+    }
+
+    /**
+     * @brief Whether an intrinsic calls a function for each element, in which case it can collect.
+     */
+    inline bool takesFunction(const string &name) {
+      return name == MAP || name == FILTER || name == REDUCE;
+    }
+  }
+}
@@ -0,0 +1,86 @@
+#include "OptimizationLevel.hpp"
+#include <mutex>
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  mutex binaryenOptionsMutex;
+}
+
+optional<OptimizationLevel> OptimizationLevel::fromFlag(const string &flag) {
+  OptimizationLevel level;
+
+  if (flag == "-O" || flag == "-Os") {
+    level.optimizeLevel = 2;
+    level.shrinkLevel = 1;
+  } else if (flag == "-Oz") {
+    level.optimizeLevel = 2;
+    level.shrinkLevel = 2;
+  } else if (flag.length() == 3 && flag.compare(0, 2, "-O") == 0 && flag[2] >= '0' && flag[2] <= '4') {
+    level.optimizeLevel = flag[2] - '0';
+  } else {
+    return nullopt;
+  }
+
+  return level;
+}
+
+vector<string> OptimizationLevel::parsePassList(const string &list) {
+  vector<string> passes;
+  size_t start = 0;
+
+  while (start <= list.length()) {
+    size_t end = list.find(',', start);
+    if (end == string::npos) end = list.length();
+
+    if (end > start) passes.push_back(list.substr(start, end - start));
+
+    start = end + 1;
+  }
+
+  return passes;
+}
+
+string OptimizationLevel::toString() const {
+  string description;
+
+  if (shrinkLevel == 0) description = "-O" + to_string(optimizeLevel);
+  else if (optimizeLevel == 2 && shrinkLevel == 1) description = "-Os";
+  else if (optimizeLevel == 2 && shrinkLevel == 2) description = "-Oz";
+  else description = "-O" + to_string(optimizeLevel) + " -s" + to_string(shrinkLevel);
+
+  if (passes.empty()) return description;
+
+  description += " --passes=";
+  for (size_t i = 0; i < passes.size(); i++) {
+    if (i > 0) description += ",";
+    description += passes[i];
+  }
+
+  return description;
+}
+
+void OptimizationLevel::optimize(BinaryenModuleRef module) const {
+  if (!isOptimizing()) return;
+
+  lock_guard<mutex> lock(binaryenOptionsMutex);
+
+  int previousOptimizeLevel = BinaryenGetOptimizeLevel();
+  int previousShrinkLevel = BinaryenGetShrinkLevel();
+
+  BinaryenSetOptimizeLevel(optimizeLevel);
+  BinaryenSetShrinkLevel(shrinkLevel);
+
+  if (optimizeLevel > 0 || shrinkLevel > 0) BinaryenModuleOptimize(module);
+
+  if (!passes.empty()) {
+    vector<const char*> passNames;
+    for (const string &pass : passes) passNames.push_back(pass.c_str());
+
+    BinaryenModuleRunPasses(module, passNames.data(), passNames.size());
+  }
+
+  BinaryenSetOptimizeLevel(previousOptimizeLevel);
+  BinaryenSetShrinkLevel(previousShrinkLevel);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+#include <binaryen-c.h>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief How hard Binaryen should optimize a generated module, mirroring wasm-opt's `-O` flags: an optimize level
+   * from 0 to 4, a shrink level from 0 to 2, and any number of extra Binaryen passes to run after them, by name.
+   * The default, -O0, runs nothing, which is what keeps REPL compiles fast.
+   */
+  struct OptimizationLevel {
+    int optimizeLevel = 0;
+    int shrinkLevel = 0;
+
+    // Run in order, after the passes the optimize and shrink levels pick
+    vector<string> passes;
+
+    /**
+     * @brief Parses an optimization flag: -O0, -O1, -O2, -O3, -O4, -Os, -Oz, or -O which is the same as -Os.
+     * @param flag The flag to parse.
+     * @return The level the flag stands for, or nullopt if it isn't an optimization flag
+     */
+    static optional<OptimizationLevel> fromFlag(const string &flag);
+
+    /**
+     * @brief Parses a comma separated list of Binaryen pass names.
+     */
+    static vector<string> parsePassList(const string &list);
+
+    /**
+     * @brief Whether this level does anything at all to a module.
+     */
+    bool isOptimizing() const { return optimizeLevel > 0 || shrinkLevel > 0 || !passes.empty(); }
+
+    /**
+     * @brief A stable description of the level, such as `-O2` or `-Os --passes=dce,vacuum`. Programs compiled at
+     * different levels are cached apart by it.
+     */
+    string toString() const;
+
+    /**
+     * @brief Runs the level's passes on a module (in-place). Binaryen keeps its optimization settings in globals, so
+     * modules are only ever optimized one at a time, and the settings are put back afterwards.
+     * @param module The module to optimize.
+     */
+    void optimize(BinaryenModuleRef module) const;
+  };
+}
@@ -0,0 +1,125 @@
+#include "PhaseTimer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  string formatMs(double ms) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", ms);
+
+    return buffer;
+  }
+
+  string escapeJSON(const string &value) {
+    string escaped;
+
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+        escaped += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char buffer[8];
+        snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+        escaped += buffer;
+      } else {
+        escaped += c;
+      }
+    }
+
+    return escaped;
+  }
+}
+
+PhaseTimer::Scope::Scope(PhaseTimer *phaseTimer, string phaseName) : timer(phaseTimer) {
+  if (!timer) return;
+
+  name = std::move(phaseName);
+  wallStart = chrono::steady_clock::now();
+  cpuStart = threadCPUTime();
+}
+
+PhaseTimer::Scope::~Scope() {
+  if (!timer) return;
+
+  double cpuMs = threadCPUTime() - cpuStart;
+  double wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - wallStart).count();
+
+  timer->record(std::move(name), wallMs, cpuMs);
+}
+
+void PhaseTimer::record(string name, double wallMs, double cpuMs, int changes) {
+  lock_guard<mutex> lock(phasesMutex);
+  phases.push_back({ std::move(name), wallMs, cpuMs, changes });
+}
+
+vector<PhaseTimer::Phase> PhaseTimer::getPhases() {
+  lock_guard<mutex> lock(phasesMutex);
+  return phases;
+}
+
+void PhaseTimer::clear() {
+  lock_guard<mutex> lock(phasesMutex);
+  phases.clear();
+}
+
+string PhaseTimer::toTable() {
+  vector<Phase> recorded = getPhases();
+
+  size_t nameWidth = string("Phase").length();
+  bool hasChanges = false;
+
+  for (const Phase &phase : recorded) {
+    nameWidth = max(nameWidth, phase.name.length());
+    hasChanges = hasChanges || phase.changes >= 0;
+  }
+
+  auto row = [nameWidth, hasChanges](const string &name, const string &wall, const string &cpu, const string &changes) {
+    string line = name + string(nameWidth - name.length(), ' ');
+
+    line += "  " + string(wall.length() < 12 ? 12 - wall.length() : 0, ' ') + wall;
+    line += "  " + string(cpu.length() < 12 ? 12 - cpu.length() : 0, ' ') + cpu;
+
+    if (hasChanges) line += "  " + string(changes.length() < 8 ? 8 - changes.length() : 0, ' ') + changes;
+
+    return line + "\n";
+  };
+
+  string table = row("Phase", "Wall (ms)", "CPU (ms)", "Changes");
+  table += string(nameWidth + 28 + (hasChanges ? 10 : 0), '-') + "\n";
+
+  for (const Phase &phase : recorded) {
+    table += row(phase.name, formatMs(phase.wallMs), formatMs(phase.cpuMs), phase.changes >= 0 ? to_string(phase.changes) : "");
+  }
+
+  return table;
+}
+
+string PhaseTimer::toJSON() {
+  vector<Phase> recorded = getPhases();
+  string json = "{\"phases\":[";
+
+  for (size_t i = 0; i < recorded.size(); i++) {
+    if (i > 0) json += ",";
+
+    json += "{\"name\":\"" + escapeJSON(recorded[i].name) + "\"";
+    json += ",\"wallMs\":" + formatMs(recorded[i].wallMs);
+    json += ",\"cpuMs\":" + formatMs(recorded[i].cpuMs);
+
+    if (recorded[i].changes >= 0) json += ",\"changes\":" + to_string(recorded[i].changes);
+
+    json += "}";
+  }
+
+  return json + "]}";
+}
+
+double PhaseTimer::threadCPUTime() {
+  timespec time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) return 0;
+
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
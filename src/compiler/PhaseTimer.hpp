@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Records how long each phase of a compile took, for `theta --time-passes`. Phases are recorded in the order
+   * they finish. Linked capsules are handled on the worker pool, so their phases can overlap each other and the phases
+   * of the thread waiting on them. Safe to record into from any thread.
+   */
+  class PhaseTimer {
+  public:
+    struct Phase {
+      string name;
+      double wallMs;
+      double cpuMs;
+
+      // How many times an optimization pass changed the AST, or -1 for phases that don't count changes
+      int changes;
+    };
+
+    /**
+     * @brief Times a phase for as long as it is alive. A scope on a null timer does nothing, so that phases can be
+     * timed unconditionally and cost nothing when timing is off.
+     */
+    class Scope {
+    public:
+      Scope(PhaseTimer *phaseTimer, string phaseName);
+
+      ~Scope();
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+    private:
+      PhaseTimer *timer;
+      string name;
+      chrono::steady_clock::time_point wallStart;
+      double cpuStart;
+    };
+
+    /**
+     * @brief Records a finished phase.
+     * @param name The name of the phase.
+     * @param wallMs The wall clock time the phase took, in milliseconds.
+     * @param cpuMs The CPU time the thread running the phase spent on it, in milliseconds.
+     * @param changes How many changes the phase made, if it counts them.
+     */
+    void record(string name, double wallMs, double cpuMs, int changes = -1);
+
+    vector<Phase> getPhases();
+
+    void clear();
+
+    /**
+     * @brief Formats the recorded phases as a human readable table.
+     */
+    string toTable();
+
+    /**
+     * @brief Formats the recorded phases as JSON, as an object with a `phases` array of `name`, `wallMs` and `cpuMs`,
+     * and `changes` for the phases that count them.
+     */
+    string toJSON();
+
+    /**
+     * @brief The CPU time the calling thread has used so far, in milliseconds.
+     */
+    static double threadCPUTime();
+
+  private:
+    vector<Phase> phases;
+    mutex phasesMutex;
+  };
+}
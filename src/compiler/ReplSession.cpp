@@ -0,0 +1,109 @@
+#include "ReplSession.hpp"
+#include "Compiler.hpp"
+#include "DataTypes.hpp"
+#include "parser/ast/ASTNode.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+
+using namespace std;
+using namespace Theta;
+
+ReplSession::Result ReplSession::evaluate(const string &input) {
+  // Parsed once up front to tell definitions from expressions. Compiling the line parses it again and reports any
+  // errors, so they aren't kept from this
+  session.clearExceptions();
+  shared_ptr<ASTNode> ast = session.getCompiler().buildAST(input, FILE_NAME);
+  bool isParsed = ast && session.getEncounteredExceptions().empty();
+  session.clearExceptions();
+
+  shared_ptr<ASTNode> value = isParsed ? ast->getValue() : nullptr;
+
+  if (value && value->getNodeType() == ASTNode::CAPSULE) return run(input, CAPSULE_FUNCTION);
+
+  bool isDefinition = value
+    && value->getNodeType() == ASTNode::ASSIGNMENT
+    && value->getRight()
+    && value->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION;
+
+  if (isDefinition) return define(input, value);
+
+  return run(input, EXPRESSION_FUNCTION);
+}
+
+ReplSession::Result ReplSession::define(const string &input, shared_ptr<ASTNode> assignment) {
+  optional<HostFunction> signature = getSignature(assignment);
+  if (!signature) return { false, "Only functions that take and return Numbers and Booleans can be kept between lines" };
+
+  // Definitions compiled before call whatever was defined last, with the types they were compiled with
+  auto existing = definitions.find(signature->name);
+  if (existing != definitions.end() && existing->second.toString() != signature->toString()) {
+    return { false, signature->name + " is already " + existing->second.toString() + ", and can only be redefined with the same types" };
+  }
+
+  // A capsule function takes precedence over a host function of the same name, so the definition calls itself rather
+  // than what it replaces
+  vector<char> wasm = session.compileDirect("capsule " + FILE_NAME + " {\n" + input + "\n}");
+  session.clearExceptions();
+
+  if (wasm.empty()) return { false, "" };
+
+  auto module = make_shared<vector<char>>(std::move(wasm));
+  string exportName = Compiler::getQualifiedFunctionIdentifier(signature->name, assignment->getRight());
+
+  // Host functions are called with as many args as their signature takes, and return a single result
+  size_t paramCount = signature->paramTypes.size();
+  session.addHostFunction(*signature, [this, module, exportName, paramCount](HostCall &call, const wasm::Val args[], wasm::Val results[]) {
+    session.invoke(*module, exportName, args, paramCount, results, 1);
+  });
+
+  definitions[signature->name] = *signature;
+
+  return { true, signature->toString() };
+}
+
+ReplSession::Result ReplSession::run(const string &source, const string &functionName) {
+  vector<char> wasm = session.compileDirect(source);
+  session.clearExceptions();
+
+  if (wasm.empty()) return { false, "" };
+
+  try {
+    return { true, session.execute(wasm, functionName).stringifiedResult() };
+  } catch (const exception &e) {
+    return { false, e.what() };
+  }
+}
+
+optional<HostFunction> ReplSession::getSignature(shared_ptr<ASTNode> assignment) {
+  shared_ptr<IdentifierNode> identifier = dynamic_pointer_cast<IdentifierNode>(assignment->getLeft());
+  shared_ptr<FunctionDeclarationNode> function = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+  if (!identifier || !function) return nullopt;
+
+  shared_ptr<TypeDeclarationNode> type = dynamic_pointer_cast<TypeDeclarationNode>(identifier->getValue());
+  if (!type || type->getType() != DataTypes::FUNCTION) return nullopt;
+
+  HostFunction signature{ identifier->getIdentifier(), {}, "" };
+
+  for (shared_ptr<ASTNode> param : function->getParameters()->getElements()) {
+    shared_ptr<TypeDeclarationNode> paramType = dynamic_pointer_cast<TypeDeclarationNode>(param->getValue());
+
+    // Lists are passed by their address in the heap of the module calling, which the module called can't read
+    if (!paramType || !HostFunction::parseType(paramType->toString(true), false)) return nullopt;
+
+    signature.paramTypes.push_back(paramType->toString(true));
+  }
+
+  // Functions without params only have their return type as the type's value, see Compiler::getQualifiedFunctionId
+  shared_ptr<ASTNode> returnType = type->getValue();
+  if (!returnType && !type->getElements().empty()) returnType = type->getElements().back();
+
+  shared_ptr<TypeDeclarationNode> returnTypeDeclaration = dynamic_pointer_cast<TypeDeclarationNode>(returnType);
+  if (!returnTypeDeclaration) return nullopt;
+
+  signature.returnType = returnTypeDeclaration->toString(true);
+
+  if (!signature.isValid()) return nullopt;
+
+  return signature;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "compiler/CompilerSession.hpp"
+#include "compiler/HostFunction.hpp"
+
+using namespace std;
+
+namespace Theta {
+  class ASTNode;
+
+  /**
+   * @brief What the REPL evaluates its input with, keeping the functions defined on earlier lines for the lines after.
+   *
+   * A line that defines a function, such as `double<Function<Number, Number>> = (x<Number>) -> x * 2`, is compiled on
+   * its own, once, into a module of its own. Later lines are compiled against it as a host function, see
+   * HostFunction, which calls into the module it was compiled to. So each line only compiles what it defines, and the
+   * runtime keeps the compiled module of every definition, and pooled instances of it, for as long as the session
+   * lasts. Any other line is an expression, which is compiled and run straight away, and whole capsules are run by
+   * their main function as before.
+   *
+   * Lines only share Numbers and Booleans, since each module has a heap of its own, so only functions that take and
+   * return them can be kept.
+   */
+  class ReplSession {
+  public:
+    struct Result {
+      bool isOk;
+
+      // The value of an expression, the type of a definition, or why the line couldn't be evaluated. Empty when the
+      // line didn't compile, in which case the compiler already reported why
+      string output;
+    };
+
+    /**
+     * @brief Evaluates a line, or several, of input.
+     */
+    Result evaluate(const string &input);
+
+    /**
+     * @brief The functions defined so far, by name.
+     */
+    const map<string, HostFunction>& getDefinitions() const { return definitions; }
+
+    CompilerSession& getSession() { return session; }
+
+  private:
+    CompilerSession session;
+    map<string, HostFunction> definitions;
+
+    static inline const string FILE_NAME = "ith";
+    static inline const string EXPRESSION_FUNCTION = "main";
+    static inline const string CAPSULE_FUNCTION = "main0";
+
+    Result define(const string &input, shared_ptr<ASTNode> assignment);
+
+    Result run(const string &source, const string &functionName);
+
+    /**
+     * @brief The name and types of the function an assignment defines, or nullopt if it isn't one that takes and
+     * returns only Numbers and Booleans.
+     */
+    static optional<HostFunction> getSignature(shared_ptr<ASTNode> assignment);
+  };
+}
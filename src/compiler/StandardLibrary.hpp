@@ -17,76 +17,119 @@ namespace Theta {
   public:
     static void registerFunctions(BinaryenModuleRef &module) {
       registerMathPow(module);
+      registerStringCodePointAt(module);
+      registerStringCharAt(module);
+      registerStringIndexOf(module);
+      registerStringHash(module);
     }
 
   private:
-    // FIXME: This won't work for negative values of an exponent like 10**-5. We need to check the sign and do division instead
-    // if the exponent is negative. It also won't work for negative base values. If the base is negative we need to multiply times
-    // the absolute value of the base in order to get the correct answer. It also wont work for floating point exponents.
+    // Uses exponentiation by squaring, so it takes O(log exp) multiplications. Numbers are integers, so negative
+    // exponents give 1 / base ** -exp truncated, like integer division would. That also means they trap for a base of 0
     static void registerMathPow(BinaryenModuleRef &module) {
       /*
-      (func (export "Theta.Math.pow") (param $base i32) (param $exp i32) (result i32) (local $res i32)
-        i32.const 1
+      (func (export "Theta.Math.pow") (param $base i64) (param $exp i64) (result i64) (local $res i64) (local $remaining i64)
+        i64.const 1
         local.set $res ;; 2
 
-        (loop $powLoop
-          local.get $base ;; 0
-            local.get $res ;; 2
-            i32.mul
-            local.set $res ;; 2
-
-            local.get $exp ;; 1
-            i32.const 1
-            i32.sub
-            local.set $exp ;; 1
-
-            local.get $exp ;; 1
-            i32.const 0
-            i32.ne
-            br_if $powLoop
+        ;; The magnitude of the exponent, read as unsigned so that it is also right for the smallest i64
+        (select (i64.sub (i64.const 0) (local.get $exp)) (local.get $exp) (i64.lt_s (local.get $exp) (i64.const 0)))
+        local.set $remaining ;; 3
+
+        (block $powDone
+          (loop $powLoop
+            local.get $remaining ;; 3
+            i64.eqz
+            br_if $powDone
+
+            (if (i64.and (local.get $remaining) (i64.const 1))
+              (local.set $res (i64.mul (local.get $res) (local.get $base))))
+
+            (local.set $base (i64.mul (local.get $base) (local.get $base)))
+            (local.set $remaining (i64.shr_u (local.get $remaining) (i64.const 1)))
+            br $powLoop
+          )
         )
 
-        local.get $res ;; 2
+        (if (result i64) (i64.lt_s (local.get $exp) (i64.const 0))
+          (then (i64.div_s (i64.const 1) (local.get $res)))
+          (else (local.get $res)))
       )
       */
 
       BinaryenExpressionRef loopExpressions[] = {
-        // Multiply base * result
+        // Stop once every bit of the exponent has been used
+        BinaryenBreak(
+          module,
+          "powDone",
+          BinaryenUnary(module, BinaryenEqZInt64(), BinaryenLocalGet(module, 3, BinaryenTypeInt64())),
+          NULL
+        ),
+        // Multiply the result by the base's current power of two if the exponent has that bit set
+        BinaryenIf(
+          module,
+          BinaryenUnary(
+            module,
+            BinaryenWrapInt64(),
+            BinaryenBinary(
+              module,
+              BinaryenAndInt64(),
+              BinaryenLocalGet(module, 3, BinaryenTypeInt64()),
+              BinaryenConst(module, BinaryenLiteralInt64(1))
+            )
+          ),
+          BinaryenLocalSet(
+            module,
+            2,
+            BinaryenBinary(
+              module,
+              BinaryenMulInt64(),
+              BinaryenLocalGet(module, 2, BinaryenTypeInt64()),
+              BinaryenLocalGet(module, 0, BinaryenTypeInt64())
+            )
+          ),
+          NULL
+        ),
+        // Square the base
         BinaryenLocalSet(
           module,
-          2,
+          0,
           BinaryenBinary(
             module,
             BinaryenMulInt64(),
             BinaryenLocalGet(module, 0, BinaryenTypeInt64()),
-            BinaryenLocalGet(module, 2, BinaryenTypeInt64())
+            BinaryenLocalGet(module, 0, BinaryenTypeInt64())
           )
         ),
-        // Subtract 1 from exponent
+        // Move on to the next bit of the exponent
         BinaryenLocalSet(
           module,
-          1,
+          3,
           BinaryenBinary(
             module,
-            BinaryenSubInt64(),
-            BinaryenLocalGet(module, 1, BinaryenTypeInt64()),
+            BinaryenShrUInt64(),
+            BinaryenLocalGet(module, 3, BinaryenTypeInt64()),
             BinaryenConst(module, BinaryenLiteralInt64(1))
           )
         ),
-        // Check if exponent is 0. If not, loop again
-        BinaryenBreak(
+        BinaryenBreak(module, "powLoop", NULL, NULL)
+      };
+
+      BinaryenExpressionRef powLoop[] = {
+        BinaryenLoop(
           module,
           "powLoop",
-          BinaryenBinary(
-            module,
-            BinaryenNeInt64(),
-            BinaryenLocalGet(module, 1, BinaryenTypeInt64()),
-            BinaryenConst(module, BinaryenLiteralInt64(0))
-          ),
-          NULL
+          BinaryenBlock(module, NULL, loopExpressions, 5, BinaryenTypeNone())
         )
       };
 
+      BinaryenExpressionRef isExponentNegative = BinaryenBinary(
+        module,
+        BinaryenLtSInt64(),
+        BinaryenLocalGet(module, 1, BinaryenTypeInt64()),
+        BinaryenConst(module, BinaryenLiteralInt64(0))
+      );
+
       BinaryenExpressionRef expressions[] = {
         // Set the result to 1 first
         BinaryenLocalSet(
@@ -94,24 +137,46 @@ namespace Theta {
           2,
           BinaryenConst(module, BinaryenLiteralInt64(1))
         ),
-        // Loop and multiply the base times itself as many times as needed
-        BinaryenLoop(
+        // Take the magnitude of the exponent
+        BinaryenLocalSet(
           module,
-          "powLoop",
-          BinaryenBlock(
+          3,
+          BinaryenSelect(
             module,
-            NULL,
-            loopExpressions,
-            3,
-            BinaryenTypeNone()
+            isExponentNegative,
+            BinaryenBinary(
+              module,
+              BinaryenSubInt64(),
+              BinaryenConst(module, BinaryenLiteralInt64(0)),
+              BinaryenLocalGet(module, 1, BinaryenTypeInt64())
+            ),
+            BinaryenLocalGet(module, 1, BinaryenTypeInt64()),
+            BinaryenTypeInt64()
           )
         ),
-        // Put the result on the stack so it gets returned
-        BinaryenLocalGet(module, 2, BinaryenTypeInt64())
+        // Loop over the bits of the exponent, squaring the base as we go
+        BinaryenBlock(module, "powDone", powLoop, 1, BinaryenTypeNone()),
+        // Put the result on the stack so it gets returned, inverted if the exponent was negative
+        BinaryenIf(
+          module,
+          BinaryenBinary(
+            module,
+            BinaryenLtSInt64(),
+            BinaryenLocalGet(module, 1, BinaryenTypeInt64()),
+            BinaryenConst(module, BinaryenLiteralInt64(0))
+          ),
+          BinaryenBinary(
+            module,
+            BinaryenDivSInt64(),
+            BinaryenConst(module, BinaryenLiteralInt64(1)),
+            BinaryenLocalGet(module, 2, BinaryenTypeInt64())
+          ),
+          BinaryenLocalGet(module, 2, BinaryenTypeInt64())
+        )
       };
 
       BinaryenType paramTypes[2] = { BinaryenTypeInt64(), BinaryenTypeInt64() };
-      BinaryenType varTypes[1] = { BinaryenTypeInt64() }; 
+      BinaryenType varTypes[2] = { BinaryenTypeInt64(), BinaryenTypeInt64() };
 
       BinaryenFunctionRef powFn = BinaryenAddFunction(
         module,
@@ -119,15 +184,374 @@ namespace Theta {
         BinaryenTypeCreate(paramTypes, 2),
         BinaryenTypeInt64(),
         varTypes,
-        1,
+        2,
         BinaryenBlock(
           module,
           NULL,
           expressions,
-          3,
+          4,
           BinaryenTypeInt64()
         )
       );
     }
+
+    static BinaryenExpressionRef getCodeUnit(BinaryenModuleRef &module, BinaryenExpressionRef string, BinaryenExpressionRef index) {
+      return BinaryenStringWTF16Get(module, string, index);
+    }
+
+    static BinaryenExpressionRef measure(BinaryenModuleRef &module, BinaryenIndex string) {
+      return BinaryenStringMeasure(module, BinaryenStringMeasureWTF16(), BinaryenLocalGet(module, string, BinaryenTypeStringref()));
+    }
+
+    static BinaryenExpressionRef isSurrogate(BinaryenModuleRef &module, BinaryenExpressionRef codeUnit, int surrogateStart) {
+      return BinaryenBinary(
+        module,
+        BinaryenEqInt32(),
+        BinaryenBinary(module, BinaryenAndInt32(), codeUnit, BinaryenConst(module, BinaryenLiteralInt32(0xFC00))),
+        BinaryenConst(module, BinaryenLiteralInt32(surrogateStart))
+      );
+    }
+
+    // A lead surrogate followed by a trail surrogate is a single code point. Any other code unit, unpaired surrogates
+    // included, is a code point of its own
+    static void registerStringCodePointAt(BinaryenModuleRef &module) {
+      /*
+      (func (export "Theta.String.codePointAt") (param $string stringref) (param $index i32) (result i64) (local $lead i32) (local $trail i32)
+        (local.set $lead (string.wtf16_get (local.get $string) (local.get $index)))
+
+        (if (i32.eq (i32.and (local.get $lead) (i32.const 0xFC00)) (i32.const 0xD800))
+          (if (i32.lt_u (i32.add (local.get $index) (i32.const 1)) (string.measure_wtf16 (local.get $string)))
+            (block
+              (local.set $trail (string.wtf16_get (local.get $string) (i32.add (local.get $index) (i32.const 1))))
+
+              (if (i32.eq (i32.and (local.get $trail) (i32.const 0xFC00)) (i32.const 0xDC00))
+                (return (i64.extend_i32_u
+                  (i32.add
+                    (i32.add
+                      (i32.shl (i32.sub (local.get $lead) (i32.const 0xD800)) (i32.const 10))
+                      (i32.sub (local.get $trail) (i32.const 0xDC00)))
+                    (i32.const 0x10000))))))))
+
+        (i64.extend_i32_u (local.get $lead))
+      )
+      */
+
+      auto getLocal = [&](BinaryenIndex index) {
+        return BinaryenLocalGet(module, index, index == 0 ? BinaryenTypeStringref() : BinaryenTypeInt32());
+      };
+
+      BinaryenExpressionRef nextIndex = BinaryenBinary(module, BinaryenAddInt32(), getLocal(1), BinaryenConst(module, BinaryenLiteralInt32(1)));
+
+      BinaryenExpressionRef codePoint = BinaryenBinary(
+        module,
+        BinaryenAddInt32(),
+        BinaryenBinary(
+          module,
+          BinaryenAddInt32(),
+          BinaryenBinary(
+            module,
+            BinaryenShlInt32(),
+            BinaryenBinary(module, BinaryenSubInt32(), getLocal(2), BinaryenConst(module, BinaryenLiteralInt32(0xD800))),
+            BinaryenConst(module, BinaryenLiteralInt32(10))
+          ),
+          BinaryenBinary(module, BinaryenSubInt32(), getLocal(3), BinaryenConst(module, BinaryenLiteralInt32(0xDC00)))
+        ),
+        BinaryenConst(module, BinaryenLiteralInt32(0x10000))
+      );
+
+      BinaryenExpressionRef pairExpressions[] = {
+        BinaryenLocalSet(
+          module,
+          3,
+          getCodeUnit(
+            module,
+            getLocal(0),
+            BinaryenBinary(module, BinaryenAddInt32(), getLocal(1), BinaryenConst(module, BinaryenLiteralInt32(1)))
+          )
+        ),
+        BinaryenIf(
+          module,
+          isSurrogate(module, getLocal(3), 0xDC00),
+          BinaryenReturn(module, BinaryenUnary(module, BinaryenExtendUInt32(), codePoint)),
+          NULL
+        )
+      };
+
+      BinaryenExpressionRef expressions[] = {
+        BinaryenLocalSet(module, 2, getCodeUnit(module, getLocal(0), getLocal(1))),
+        BinaryenIf(
+          module,
+          isSurrogate(module, getLocal(2), 0xD800),
+          BinaryenIf(
+            module,
+            BinaryenBinary(module, BinaryenLtUInt32(), nextIndex, measure(module, 0)),
+            BinaryenBlock(module, NULL, pairExpressions, 2, BinaryenTypeNone()),
+            NULL
+          ),
+          NULL
+        ),
+        BinaryenUnary(module, BinaryenExtendUInt32(), getLocal(2))
+      };
+
+      BinaryenType paramTypes[2] = { BinaryenTypeStringref(), BinaryenTypeInt32() };
+      BinaryenType varTypes[2] = { BinaryenTypeInt32(), BinaryenTypeInt32() };
+
+      BinaryenAddFunction(
+        module,
+        "Theta.String.codePointAt",
+        BinaryenTypeCreate(paramTypes, 2),
+        BinaryenTypeInt64(),
+        varTypes,
+        2,
+        BinaryenBlock(module, NULL, expressions, 3, BinaryenTypeInt64())
+      );
+    }
+
+    // A function rather than a slice at each call, so that the index is only evaluated once
+    static void registerStringCharAt(BinaryenModuleRef &module) {
+      /*
+      (func (export "Theta.String.charAt") (param $string stringref) (param $index i32) (result stringref)
+        (string.slice_wtf (local.get $string) (local.get $index) (i32.add (local.get $index) (i32.const 1)))
+      )
+      */
+
+      BinaryenType paramTypes[2] = { BinaryenTypeStringref(), BinaryenTypeInt32() };
+
+      BinaryenAddFunction(
+        module,
+        "Theta.String.charAt",
+        BinaryenTypeCreate(paramTypes, 2),
+        BinaryenTypeStringref(),
+        NULL,
+        0,
+        BinaryenStringSliceWTF(
+          module,
+          BinaryenLocalGet(module, 0, BinaryenTypeStringref()),
+          BinaryenLocalGet(module, 1, BinaryenTypeInt32()),
+          BinaryenBinary(
+            module,
+            BinaryenAddInt32(),
+            BinaryenLocalGet(module, 1, BinaryenTypeInt32()),
+            BinaryenConst(module, BinaryenLiteralInt32(1))
+          )
+        )
+      );
+    }
+
+    // Compares the code units at each position in turn, so no slices of the string are made while searching
+    static void registerStringIndexOf(BinaryenModuleRef &module) {
+      /*
+      (func (export "Theta.String.indexOf") (param $string stringref) (param $search stringref) (result i64)
+        (local $index i32) (local $offset i32) (local $last i32) (local $searchLength i32)
+        (local.set $searchLength (string.measure_wtf16 (local.get $search)))
+        (local.set $last (i32.sub (string.measure_wtf16 (local.get $string)) (local.get $searchLength)))
+
+        (block $notFound
+          (loop $positions
+            (br_if $notFound (i32.gt_s (local.get $index) (local.get $last)))
+            (local.set $offset (i32.const 0))
+
+            (block $mismatch
+              (loop $codeUnits
+                (if (i32.ge_u (local.get $offset) (local.get $searchLength))
+                  (return (i64.extend_i32_u (local.get $index))))
+
+                (br_if $mismatch (i32.ne
+                  (string.wtf16_get (local.get $string) (i32.add (local.get $index) (local.get $offset)))
+                  (string.wtf16_get (local.get $search) (local.get $offset))))
+
+                (local.set $offset (i32.add (local.get $offset) (i32.const 1)))
+                br $codeUnits
+              )
+            )
+
+            (local.set $index (i32.add (local.get $index) (i32.const 1)))
+            br $positions
+          )
+        )
+
+        (i64.const -1)
+      )
+      */
+
+      auto getLocal = [&](BinaryenIndex index) {
+        return BinaryenLocalGet(module, index, index < 2 ? BinaryenTypeStringref() : BinaryenTypeInt32());
+      };
+
+      auto increment = [&](BinaryenIndex index) {
+        return BinaryenLocalSet(
+          module,
+          index,
+          BinaryenBinary(module, BinaryenAddInt32(), getLocal(index), BinaryenConst(module, BinaryenLiteralInt32(1)))
+        );
+      };
+
+      BinaryenExpressionRef codeUnitExpressions[] = {
+        // Every code unit of the search matched
+        BinaryenIf(
+          module,
+          BinaryenBinary(module, BinaryenGeUInt32(), getLocal(3), getLocal(5)),
+          BinaryenReturn(module, BinaryenUnary(module, BinaryenExtendUInt32(), getLocal(2))),
+          NULL
+        ),
+        BinaryenBreak(
+          module,
+          "indexOfMismatch",
+          BinaryenBinary(
+            module,
+            BinaryenNeInt32(),
+            getCodeUnit(module, getLocal(0), BinaryenBinary(module, BinaryenAddInt32(), getLocal(2), getLocal(3))),
+            getCodeUnit(module, getLocal(1), getLocal(3))
+          ),
+          NULL
+        ),
+        increment(3),
+        BinaryenBreak(module, "indexOfCodeUnits", NULL, NULL)
+      };
+
+      BinaryenExpressionRef codeUnitsLoop = BinaryenLoop(
+        module,
+        "indexOfCodeUnits",
+        BinaryenBlock(module, NULL, codeUnitExpressions, 4, BinaryenTypeNone())
+      );
+
+      BinaryenExpressionRef positionExpressions[] = {
+        // The search can't start any later than its length from the end
+        BinaryenBreak(
+          module,
+          "indexOfNotFound",
+          BinaryenBinary(module, BinaryenGtSInt32(), getLocal(2), getLocal(4)),
+          NULL
+        ),
+        BinaryenLocalSet(module, 3, BinaryenConst(module, BinaryenLiteralInt32(0))),
+        BinaryenBlock(module, "indexOfMismatch", &codeUnitsLoop, 1, BinaryenTypeNone()),
+        increment(2),
+        BinaryenBreak(module, "indexOfPositions", NULL, NULL)
+      };
+
+      BinaryenExpressionRef positionsLoop = BinaryenLoop(
+        module,
+        "indexOfPositions",
+        BinaryenBlock(module, NULL, positionExpressions, 5, BinaryenTypeNone())
+      );
+
+      BinaryenExpressionRef expressions[] = {
+        BinaryenLocalSet(module, 5, measure(module, 1)),
+        BinaryenLocalSet(module, 4, BinaryenBinary(module, BinaryenSubInt32(), measure(module, 0), getLocal(5))),
+        BinaryenBlock(module, "indexOfNotFound", &positionsLoop, 1, BinaryenTypeNone()),
+        BinaryenConst(module, BinaryenLiteralInt64(-1))
+      };
+
+      BinaryenType paramTypes[2] = { BinaryenTypeStringref(), BinaryenTypeStringref() };
+      BinaryenType varTypes[4] = { BinaryenTypeInt32(), BinaryenTypeInt32(), BinaryenTypeInt32(), BinaryenTypeInt32() };
+
+      BinaryenAddFunction(
+        module,
+        "Theta.String.indexOf",
+        BinaryenTypeCreate(paramTypes, 2),
+        BinaryenTypeInt64(),
+        varTypes,
+        4,
+        BinaryenBlock(module, NULL, expressions, 4, BinaryenTypeInt64())
+      );
+    }
+
+    // 64 bit FNV-1a, one code unit at a time
+    static void registerStringHash(BinaryenModuleRef &module) {
+      /*
+      (func (export "Theta.String.hash") (param $string stringref) (result i64) (local $hash i64) (local $index i32) (local $length i32)
+        (local.set $hash (i64.const 0xcbf29ce484222325))
+        (local.set $length (string.measure_wtf16 (local.get $string)))
+
+        (block $hashDone
+          (loop $hashLoop
+            (br_if $hashDone (i32.ge_u (local.get $index) (local.get $length)))
+
+            (local.set $hash (i64.mul
+              (i64.xor (local.get $hash) (i64.extend_i32_u (string.wtf16_get (local.get $string) (local.get $index))))
+              (i64.const 0x100000001b3)))
+
+            (local.set $index (i32.add (local.get $index) (i32.const 1)))
+            br $hashLoop
+          )
+        )
+
+        (local.get $hash)
+      )
+      */
+
+      BinaryenExpressionRef loopExpressions[] = {
+        BinaryenBreak(
+          module,
+          "hashDone",
+          BinaryenBinary(
+            module,
+            BinaryenGeUInt32(),
+            BinaryenLocalGet(module, 2, BinaryenTypeInt32()),
+            BinaryenLocalGet(module, 3, BinaryenTypeInt32())
+          ),
+          NULL
+        ),
+        BinaryenLocalSet(
+          module,
+          1,
+          BinaryenBinary(
+            module,
+            BinaryenMulInt64(),
+            BinaryenBinary(
+              module,
+              BinaryenXorInt64(),
+              BinaryenLocalGet(module, 1, BinaryenTypeInt64()),
+              BinaryenUnary(
+                module,
+                BinaryenExtendUInt32(),
+                getCodeUnit(
+                  module,
+                  BinaryenLocalGet(module, 0, BinaryenTypeStringref()),
+                  BinaryenLocalGet(module, 2, BinaryenTypeInt32())
+                )
+              )
+            ),
+            BinaryenConst(module, BinaryenLiteralInt64(0x100000001b3))
+          )
+        ),
+        BinaryenLocalSet(
+          module,
+          2,
+          BinaryenBinary(
+            module,
+            BinaryenAddInt32(),
+            BinaryenLocalGet(module, 2, BinaryenTypeInt32()),
+            BinaryenConst(module, BinaryenLiteralInt32(1))
+          )
+        ),
+        BinaryenBreak(module, "hashLoop", NULL, NULL)
+      };
+
+      BinaryenExpressionRef hashLoop = BinaryenLoop(
+        module,
+        "hashLoop",
+        BinaryenBlock(module, NULL, loopExpressions, 4, BinaryenTypeNone())
+      );
+
+      BinaryenExpressionRef expressions[] = {
+        BinaryenLocalSet(module, 1, BinaryenConst(module, BinaryenLiteralInt64(static_cast<int64_t>(0xcbf29ce484222325)))),
+        BinaryenLocalSet(module, 3, measure(module, 0)),
+        BinaryenBlock(module, "hashDone", &hashLoop, 1, BinaryenTypeNone()),
+        BinaryenLocalGet(module, 1, BinaryenTypeInt64())
+      };
+
+      BinaryenType varTypes[3] = { BinaryenTypeInt64(), BinaryenTypeInt32(), BinaryenTypeInt32() };
+
+      BinaryenAddFunction(
+        module,
+        "Theta.String.hash",
+        BinaryenTypeStringref(),
+        BinaryenTypeInt64(),
+        varTypes,
+        3,
+        BinaryenBlock(module, NULL, expressions, 4, BinaryenTypeInt64())
+      );
+    }
   };
 }
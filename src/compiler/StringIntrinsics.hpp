@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * The functions built into the language for Strings. They work on the strings' WTF-16 code units, straight on the
+   * stringrefs, so strings never go through linear memory. A call to one of these names whose first argument is a
+   * String always calls the intrinsic:
+   *
+   * - length(string) is the number of code units in the string
+   * - charCodeAt(string, index) is the code unit at the index, trapping if it's past the end
+   * - codePointAt(string, index) is the code point starting at the index, joining surrogate pairs. Iterating over the
+   *   code points of a string moves on by 2 after any code point above 0xFFFF
+   * - charAt(string, index) is the code unit at the index, as a String. It's empty past the end
+   * - slice(string, start, end) is the code units from start up to end, which are clamped to the end of the string
+   * - indexOf(string, search) is where search first starts in the string, or -1 if it doesn't
+   * - hash(string) is the string's 64 bit FNV-1a hash, over its code units
+   *
+   * Strings are compared with ==, which is already a single string.eq.
+   */
+  namespace StringIntrinsics {
+    const string LENGTH = "length";
+    const string CHAR_CODE_AT = "charCodeAt";
+    const string CODE_POINT_AT = "codePointAt";
+    const string CHAR_AT = "charAt";
+    const string SLICE = "slice";
+    const string INDEX_OF = "indexOf";
+    const string HASH = "hash";
+
+    inline bool isStringIntrinsic(const string &name) {
+      return (
+        name == LENGTH ||
+        name == CHAR_CODE_AT ||
+        name == CODE_POINT_AT ||
+        name == CHAR_AT ||
+        name == SLICE ||
+        name == INDEX_OF ||
+        name == HASH
+      );
+    }
+
+    /**
+     * @brief The number of arguments an intrinsic takes, the string included.
+     */
+    inline int getArity(const string &name) {
+      if (name == SLICE) return 3;
+      if (name == LENGTH || name == HASH) return 1;
+
+      return 2;
+    }
+
+    /**
+     * @brief Whether an intrinsic gives back a String, rather than a Number.
+     */
+    inline bool returnsString(const string &name) {
+      return name == CHAR_AT || name == SLICE;
+    }
+  }
+}
@@ -0,0 +1,45 @@
+#include "StructLayout.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include "DataTypes.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+
+using namespace std;
+using namespace Theta;
+
+StructLayout StructLayout::fromDefinition(shared_ptr<StructDefinitionNode> definition) {
+  StructLayout layout;
+
+  for (auto &element : definition->getElements()) {
+    shared_ptr<IdentifierNode> field = dynamic_pointer_cast<IdentifierNode>(element);
+    shared_ptr<TypeDeclarationNode> type = dynamic_pointer_cast<TypeDeclarationNode>(field->getValue());
+
+    layout.fields.push_back({ field->getIdentifier(), type, 0, getFieldSize(type) });
+  }
+
+  stable_sort(layout.fields.begin(), layout.fields.end(), [](const Field &a, const Field &b) { return a.size > b.size; });
+
+  for (auto &field : layout.fields) {
+    field.offset = layout.byteSize;
+    layout.byteSize += field.size;
+  }
+
+  return layout;
+}
+
+int StructLayout::getFieldSize(shared_ptr<TypeDeclarationNode> type) {
+  if (type->getType() == DataTypes::NUMBER) return 8;
+  if (type->getType() == DataTypes::SYMBOL) return 4;
+  if (type->getType() == DataTypes::BOOLEAN) return 1;
+
+  // The collector doesn't look inside of structs, so they can't hold anything it has to move or keep alive
+  throw runtime_error("Struct fields can only be Numbers, Booleans or Symbols, not " + type->getType());
+}
+
+const StructLayout::Field* StructLayout::getField(const string &name) const {
+  for (auto &field : fields) {
+    if (field.name == name) return &field;
+  }
+
+  return nullptr;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "parser/ast/StructDefinitionNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Where each field of a struct goes in memory. Fields are ordered from the largest to the smallest, keeping
+   * the order they are defined in otherwise, so every field is naturally aligned without any padding between them.
+   * Booleans take a single byte, so a struct's Booleans are packed together at its end.
+   */
+  struct StructLayout {
+    struct Field {
+      string name;
+      shared_ptr<TypeDeclarationNode> type;
+      int offset;
+      int size;
+    };
+
+    // The fields, in the order they are laid out in
+    vector<Field> fields;
+    int byteSize = 0;
+
+    /**
+     * @brief Lays out the fields of a struct definition.
+     * @throws runtime_error If a field is of a type that can't be stored in a struct yet
+     */
+    static StructLayout fromDefinition(shared_ptr<StructDefinitionNode> definition);
+
+    /**
+     * @brief How many bytes a field of the given type takes in a struct.
+     * @throws runtime_error If fields of the type can't be stored in a struct yet
+     */
+    static int getFieldSize(shared_ptr<TypeDeclarationNode> type);
+
+    /**
+     * @brief The field with the given name, without the leading : of a symbol, or nullptr if there isn't one.
+     */
+    const Field* getField(const string &name) const;
+  };
+}
@@ -0,0 +1,163 @@
+#include "StructuralHasher.hpp"
+#include <unordered_set>
+#include "parser/ast/BinaryOperationNode.hpp"
+#include "parser/ast/ControlFlowNode.hpp"
+#include "parser/ast/EnumNode.hpp"
+#include "parser/ast/FunctionInvocationNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include "parser/ast/LiteralNode.hpp"
+#include "parser/ast/StructDeclarationNode.hpp"
+#include "parser/ast/StructDefinitionNode.hpp"
+#include "parser/ast/SymbolNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+#include "parser/ast/UnaryOperationNode.hpp"
+
+using namespace std;
+using namespace Theta;
+
+uint64_t StructuralHasher::getShapeHash(shared_ptr<ASTNode> node) {
+  if (!node) return 0;
+
+  auto cached = shapeHashes.find(node->getId());
+  if (cached != shapeHashes.end()) return cached->second;
+
+  uint64_t hash = combine(node->getNodeType() + 1, std::hash<string>{}(getText(node)));
+
+  forEachChild(node, [this, &hash](shared_ptr<ASTNode> child) {
+    hash = combine(hash, getShapeHash(child));
+  });
+
+  shapeHashes.insert(make_pair(node->getId(), hash));
+
+  return hash;
+}
+
+uint64_t StructuralHasher::getFunctionHash(shared_ptr<FunctionDeclarationNode> function) {
+  uint64_t hash = getShapeHash(function);
+
+  for (string &binding : getBindings(function)) hash = combine(hash, std::hash<string>{}(binding));
+
+  return hash;
+}
+
+bool StructuralHasher::isAlphaEquivalent(shared_ptr<FunctionDeclarationNode> a, shared_ptr<FunctionDeclarationNode> b) {
+  return isSameShape(a, b) && getBindings(a) == getBindings(b);
+}
+
+void StructuralHasher::forEachChild(shared_ptr<ASTNode> node, const function<void(shared_ptr<ASTNode>)> &visit) {
+  visit(node->getValue());
+  visit(node->getLeft());
+  visit(node->getRight());
+  visit(node->getResolvedType());
+
+  switch (node->getNodeType()) {
+    case ASTNode::FUNCTION_DECLARATION: {
+      shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(node);
+      visit(funcDecl->getParameters());
+      visit(funcDecl->getDefinition());
+      break;
+    }
+    case ASTNode::FUNCTION_INVOCATION: {
+      shared_ptr<FunctionInvocationNode> funcInv = dynamic_pointer_cast<FunctionInvocationNode>(node);
+      visit(funcInv->getIdentifier());
+      visit(funcInv->getParameters());
+      break;
+    }
+    case ASTNode::ENUM: visit(dynamic_pointer_cast<EnumNode>(node)->getIdentifier()); break;
+    case ASTNode::CONTROL_FLOW:
+      for (auto &[condition, expression] : dynamic_pointer_cast<ControlFlowNode>(node)->getConditionExpressionPairs()) {
+        visit(condition);
+        visit(expression);
+      }
+      break;
+    default:
+      break;
+  }
+
+  if (node->hasMany()) {
+    for (auto &element : dynamic_pointer_cast<ASTNodeList>(node)->getElements()) visit(element);
+  }
+}
+
+string StructuralHasher::getText(shared_ptr<ASTNode> node) {
+  switch (node->getNodeType()) {
+    case ASTNode::BINARY_OPERATION: return dynamic_pointer_cast<BinaryOperationNode>(node)->getOperator();
+    case ASTNode::UNARY_OPERATION: return dynamic_pointer_cast<UnaryOperationNode>(node)->getOperator();
+    case ASTNode::NUMBER_LITERAL:
+    case ASTNode::STRING_LITERAL:
+    case ASTNode::BOOLEAN_LITERAL:
+      return dynamic_pointer_cast<LiteralNode>(node)->getLiteralValue();
+    case ASTNode::SYMBOL: return dynamic_pointer_cast<SymbolNode>(node)->getSymbol();
+    case ASTNode::STRUCT_DECLARATION: return dynamic_pointer_cast<StructDeclarationNode>(node)->getStructType();
+    case ASTNode::STRUCT_DEFINITION: return dynamic_pointer_cast<StructDefinitionNode>(node)->getName();
+    case ASTNode::TYPE_DECLARATION: return dynamic_pointer_cast<TypeDeclarationNode>(node)->getType();
+    default: return "";
+  }
+}
+
+vector<string> StructuralHasher::getBindings(shared_ptr<FunctionDeclarationNode> function) {
+  unordered_set<string> declared;
+
+  std::function<void(shared_ptr<ASTNode>)> collectDeclared = [&](shared_ptr<ASTNode> node) {
+    if (!node) return;
+
+    if (node->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
+      for (auto &param : dynamic_pointer_cast<FunctionDeclarationNode>(node)->getParameters()->getElements()) {
+        declared.insert(dynamic_pointer_cast<IdentifierNode>(param)->getIdentifier());
+      }
+    } else if (node->getNodeType() == ASTNode::ASSIGNMENT && node->getLeft()->getNodeType() == ASTNode::IDENTIFIER) {
+      declared.insert(dynamic_pointer_cast<IdentifierNode>(node->getLeft())->getIdentifier());
+    }
+
+    forEachChild(node, collectDeclared);
+  };
+
+  collectDeclared(function);
+
+  // Params are the function's first identifiers, so they always get the first indexes, in order
+  unordered_map<string, int> indexes;
+  vector<string> bindings;
+
+  std::function<void(shared_ptr<ASTNode>)> collectBindings = [&](shared_ptr<ASTNode> node) {
+    if (!node) return;
+
+    if (node->getNodeType() == ASTNode::IDENTIFIER) {
+      string name = dynamic_pointer_cast<IdentifierNode>(node)->getIdentifier();
+
+      if (declared.count(name)) {
+        auto index = indexes.insert(make_pair(name, indexes.size())).first;
+        bindings.push_back("#" + to_string(index->second));
+      } else {
+        bindings.push_back(name);
+      }
+    }
+
+    forEachChild(node, collectBindings);
+  };
+
+  collectBindings(function);
+
+  return bindings;
+}
+
+bool StructuralHasher::isSameShape(shared_ptr<ASTNode> a, shared_ptr<ASTNode> b) {
+  if (!a || !b) return !a && !b;
+  if (a->getNodeType() != b->getNodeType() || getText(a) != getText(b)) return false;
+
+  vector<shared_ptr<ASTNode>> aChildren;
+  vector<shared_ptr<ASTNode>> bChildren;
+  forEachChild(a, [&aChildren](shared_ptr<ASTNode> child) { aChildren.push_back(child); });
+  forEachChild(b, [&bChildren](shared_ptr<ASTNode> child) { bChildren.push_back(child); });
+
+  if (aChildren.size() != bChildren.size()) return false;
+
+  for (int i = 0; i < aChildren.size(); i++) {
+    if (!isSameShape(aChildren[i], bChildren[i])) return false;
+  }
+
+  return true;
+}
+
+uint64_t StructuralHasher::combine(uint64_t seed, uint64_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "parser/ast/ASTNode.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Hashes ASTs by their structure, so that lambdas which only differ in what they call their params and locals
+   * can be generated as one function. A node's shape is hashed once, from the hashes of its children, and kept for as
+   * long as the hasher is, so hashing a lambda whose body was already hashed only combines a few hashes.
+   */
+  class StructuralHasher {
+  public:
+    /**
+     * @brief The hash of a node's shape: the type of each node in it and what the node holds, such as its operator or
+     * literal value, but not the names of identifiers.
+     */
+    uint64_t getShapeHash(shared_ptr<ASTNode> node);
+
+    /**
+     * @brief The hash of a function up to renaming its params and locals. It's the hash of the function's shape,
+     * combined with which of its identifiers name the same thing. Identifiers the function doesn't declare are hashed
+     * by name, since they refer to something outside of it.
+     */
+    uint64_t getFunctionHash(shared_ptr<FunctionDeclarationNode> function);
+
+    /**
+     * @brief Whether two functions are the same up to renaming their params and locals, in which case they compute the
+     * same thing from the same arguments.
+     */
+    static bool isAlphaEquivalent(shared_ptr<FunctionDeclarationNode> a, shared_ptr<FunctionDeclarationNode> b);
+
+    /**
+     * @brief Calls visit with each of a node's children, in order. Missing children are passed as nullptr, so that
+     * nodes of the same type always have their children in the same places.
+     */
+    static void forEachChild(shared_ptr<ASTNode> node, const function<void(shared_ptr<ASTNode>)> &visit);
+
+  private:
+    unordered_map<int, uint64_t> shapeHashes;
+
+    /**
+     * @brief What a node holds other than its children, such as an operator, a literal value or a type's name. Empty
+     * for identifiers, whose names are only compared through getBindings.
+     */
+    static string getText(shared_ptr<ASTNode> node);
+
+    /**
+     * @brief The identifiers of a function, in the order they appear in it. Those the function declares, its params
+     * first, are numbered by where they were first declared, and the rest are kept as their names.
+     */
+    static vector<string> getBindings(shared_ptr<FunctionDeclarationNode> function);
+
+    static bool isSameShape(shared_ptr<ASTNode> a, shared_ptr<ASTNode> b);
+
+    static uint64_t combine(uint64_t seed, uint64_t value);
+  };
+}
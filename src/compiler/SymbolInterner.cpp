@@ -0,0 +1,73 @@
+#include "SymbolInterner.hpp"
+#include <mutex>
+
+using namespace Theta;
+
+SymbolInterner& SymbolInterner::getInstance() {
+  static SymbolInterner instance;
+  return instance;
+}
+
+int SymbolInterner::getId(const string &name) {
+  int id = findId(name);
+  if (id >= 0) return id;
+
+  unique_lock<shared_mutex> lock(mutex);
+
+  // Another thread may have added it while the lock was released
+  auto it = idsByName.find(name);
+  if (it != idsByName.end()) return it->second;
+
+  id = names.size();
+  names.push_back(name);
+  idsByName.insert(make_pair(name, id));
+
+  return id;
+}
+
+int SymbolInterner::findId(const string &name) {
+  shared_lock<shared_mutex> lock(mutex);
+
+  auto it = idsByName.find(name);
+
+  return it != idsByName.end() ? it->second : -1;
+}
+
+size_t SymbolInterner::getSize() {
+  shared_lock<shared_mutex> lock(mutex);
+
+  return names.size();
+}
+
+const string& SymbolInterner::getName(int id) {
+  shared_lock<shared_mutex> lock(mutex);
+
+  return names.at(id);
+}
+
+int SymbolInterner::getSignatureId(int nameId, const vector<int> &parameterTypeIds) {
+  // Probing is all most calls do, so each thread builds its keys in the same buffer rather than allocating one per call
+  thread_local vector<int> key;
+  key.clear();
+  key.push_back(nameId);
+  key.insert(key.end(), parameterTypeIds.begin(), parameterTypeIds.end());
+
+  string qualifiedName;
+
+  {
+    shared_lock<shared_mutex> lock(mutex);
+
+    auto it = signatureIds.find(key);
+    if (it != signatureIds.end()) return it->second;
+
+    qualifiedName = names.at(nameId) + to_string(parameterTypeIds.size());
+    for (int typeId : parameterTypeIds) qualifiedName += names.at(typeId);
+  }
+
+  int id = getId(qualifiedName);
+
+  unique_lock<shared_mutex> lock(mutex);
+  signatureIds.insert(make_pair(key, id));
+
+  return id;
+}
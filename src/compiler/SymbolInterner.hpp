@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Gives every identifier name a small, dense integer id, so that symbol tables can be keyed by ints rather than
+   * by strings. Ids are never reused, and the interner is shared by every thread for the life of the program.
+   */
+  class SymbolInterner {
+  public:
+    static SymbolInterner& getInstance();
+
+    /**
+     * @brief The id of a name, giving it one if it doesn't have one yet.
+     */
+    int getId(const string &name);
+
+    /**
+     * @brief The id of a name, without giving it one.
+     *
+     * @param name The name.
+     * @return The id, or -1 if the name was never interned, in which case no symbol table can contain it
+     */
+    int findId(const string &name);
+
+    /**
+     * @brief The name with the given id.
+     */
+    const string& getName(int id);
+
+    /**
+     * @brief The id of the qualified name of a function overload, such as add2NumberNumber for add<Number, Number>. The
+     * qualified name is only built the first time a signature is seen, after that the id is found from the ids alone.
+     *
+     * @param nameId The id of the function's name.
+     * @param parameterTypeIds The ids of the names of the function's parameter types, in order.
+     * @return The id of the qualified name
+     */
+    int getSignatureId(int nameId, const vector<int> &parameterTypeIds);
+
+    /**
+     * @brief How many names have been interned.
+     */
+    size_t getSize();
+
+  private:
+    unordered_map<string, int> idsByName;
+
+    struct SignatureHash {
+      size_t operator()(const vector<int> &signature) const {
+        size_t hash = signature.size();
+        for (int id : signature) hash ^= (size_t) id + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+
+        return hash;
+      }
+    };
+
+    // The name id followed by the parameter type ids, to the id of the qualified name
+    unordered_map<vector<int>, int, SignatureHash> signatureIds;
+
+    // A deque so that the names handed out by getName stay where they are as more get added
+    deque<string> names;
+    shared_mutex mutex;
+
+    SymbolInterner() = default;
+  };
+}
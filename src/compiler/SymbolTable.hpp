@@ -1,28 +1,111 @@
 #pragma once
 
-#include <memory>
-#include <optional>
-#include <map>
+#include "SymbolInterner.hpp"
+#include <atomic>
 #include <optional>
+#include <string>
+#include <vector>
+
 using namespace std;
 
 namespace Theta {
+  /**
+   * @brief How many symbols have been bound in any symbol table, for `theta --stats`. Counted across every compile in
+   * the process, so the entries of a compile are the difference between the count before it and after.
+   */
+  struct SymbolTableCounter {
+    static inline atomic<size_t> entries = 0;
+  };
+
+  /**
+   * @brief A single scope's symbols, in a flat open-addressing hash table keyed by interned symbol id. Symbols are
+   * never removed one at a time, only all at once by clear, which keeps the table's memory for the next scope.
+   */
   template<typename T>
   class SymbolTable {
   public:
     void insert(const string &name, T value) {
-      table[name] = value;
+      insert(SymbolInterner::getInstance().getId(name), value);
     }
 
-    optional<T> lookup(const string &name) {
-      auto it = table.find(name);
+    void insert(int id, T value) {
+      if ((count + 1) * 4 > ids.size() * 3) grow();
 
-      if (it != table.end()) return it->second;
+      int slot = findSlot(id);
+      if (ids[slot] == EMPTY) {
+        ids[slot] = id;
+        count++;
+        SymbolTableCounter::entries.fetch_add(1, memory_order_relaxed);
+      }
 
-      return nullopt;
+      values[slot] = value;
+    }
+
+    optional<T> lookup(const string &name) const {
+      return lookup(SymbolInterner::getInstance().findId(name));
+    }
+
+    optional<T> lookup(int id) const {
+      if (count == 0 || id < 0) return nullopt;
+
+      int slot = findSlot(id);
+      if (ids[slot] == EMPTY) return nullopt;
+
+      return values[slot];
+    }
+
+    /**
+     * @brief Removes every symbol, releasing their values but keeping the table's capacity.
+     */
+    void clear() {
+      if (count == 0) return;
+
+      for (int i = 0; i < ids.size(); i++) {
+        if (ids[i] == EMPTY) continue;
+
+        ids[i] = EMPTY;
+        values[i] = T();
+      }
+
+      count = 0;
     }
 
   private:
-    map<string, T> table;
+    static constexpr int EMPTY = -1;
+    static constexpr int INITIAL_CAPACITY = 8;
+
+    // Always a power of two in size, so a slot is found by masking
+    vector<int> ids;
+    vector<T> values;
+    int count = 0;
+
+    /**
+     * @brief The slot that holds the id, or the empty slot it would go in. The table must have an empty slot.
+     */
+    int findSlot(int id) const {
+      int mask = ids.size() - 1;
+      int slot = (id * 2654435761u) & mask;
+
+      while (ids[slot] != EMPTY && ids[slot] != id) slot = (slot + 1) & mask;
+
+      return slot;
+    }
+
+    void grow() {
+      vector<int> oldIds = std::move(ids);
+      vector<T> oldValues = std::move(values);
+
+      int capacity = oldIds.empty() ? INITIAL_CAPACITY : oldIds.size() * 2;
+      ids.assign(capacity, EMPTY);
+      values.assign(capacity, T());
+
+      for (int i = 0; i < oldIds.size(); i++) {
+        if (oldIds[i] == EMPTY) continue;
+
+        int slot = findSlot(oldIds[i]);
+        ids[slot] = oldIds[i];
+        values[slot] = std::move(oldValues[i]);
+      }
+    }
   };
 }
@@ -2,41 +2,63 @@
 
 #include "SymbolTable.hpp"
 #include <optional>
-#include <stack>
+#include <string>
+#include <vector>
 
 using namespace std;
 
 namespace Theta {
+  /**
+   * @brief A chain of nested scopes, innermost last. Lookups walk the chain in place, and a scope's table is kept when
+   * the scope is exited, to be reused by the next one entered at the same depth, so entering, exiting and looking up
+   * don't allocate once the tables have grown.
+   */
   template<typename T>
   class SymbolTableStack {
   public:
     void enterScope() {
-      scopes.push(make_shared<SymbolTable<T>>());
+      if (depth == scopes.size()) scopes.emplace_back();
+
+      depth++;
     }
 
     void exitScope() {
-      if (!scopes.empty()) scopes.pop();
+      if (depth == 0) return;
+
+      depth--;
+      scopes[depth].clear();
     }
 
     void insert(const string &name, T value) {
-      if (!scopes.empty()) scopes.top()->insert(name, value);
+      if (depth > 0) scopes[depth - 1].insert(name, value);
+    }
+
+    void insert(int id, T value) {
+      if (depth > 0) scopes[depth - 1].insert(id, value);
+    }
+
+    optional<T> lookup(const string &name) const {
+      return lookup(SymbolInterner::getInstance().findId(name));
     }
 
-    optional<T> lookup(const string &name) {
-      stack<shared_ptr<SymbolTable<T>>> tmpScopes = scopes;
+    /**
+     * @brief Looks up a symbol by its interned id, innermost scope first.
+     */
+    optional<T> lookup(int id) const {
+      if (id < 0) return nullopt;
 
-      while(!tmpScopes.empty()) {
-        auto result = tmpScopes.top()->lookup(name);
-        
-        if (result.has_value()) return result.value();
+      for (int i = depth - 1; i >= 0; i--) {
+        optional<T> result = scopes[i].lookup(id);
 
-        tmpScopes.pop();
+        if (result.has_value()) return result;
       }
 
       return nullopt;
     }
 
   private:
-    stack<shared_ptr<SymbolTable<T>>> scopes;
+    // Only the first depth of these are in scope, the rest are cleared tables waiting to be reused
+    vector<SymbolTable<T>> scopes;
+    int depth = 0;
   };
 }
@@ -0,0 +1,72 @@
+#include "ThreadPool.hpp"
+
+using namespace std;
+using namespace Theta;
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(tasksMutex);
+    isStopping = true;
+  }
+
+  tasksAvailable.notify_all();
+
+  for (thread &worker : workers) worker.join();
+}
+
+bool ThreadPool::runPendingTask() {
+  function<void()> task;
+
+  {
+    lock_guard<mutex> lock(tasksMutex);
+    if (tasks.empty()) return false;
+
+    task = std::move(tasks.front());
+    tasks.pop_front();
+  }
+
+  task();
+  return true;
+}
+
+void ThreadPool::setThreadCount(size_t threads) {
+  lock_guard<mutex> lock(tasksMutex);
+  threadCount = threads;
+}
+
+size_t ThreadPool::getDefaultThreadCount() {
+  size_t hardwareThreads = thread::hardware_concurrency();
+
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+void ThreadPool::enqueue(function<void()> task) {
+  {
+    lock_guard<mutex> lock(tasksMutex);
+    tasks.push_back(std::move(task));
+
+    if (workers.empty()) {
+      for (size_t i = 0; i < threadCount; i++) workers.emplace_back(&ThreadPool::runWorker, this);
+    }
+  }
+
+  tasksAvailable.notify_one();
+}
+
+void ThreadPool::runWorker() {
+  while (true) {
+    function<void()> task;
+
+    {
+      unique_lock<mutex> lock(tasksMutex);
+      tasksAvailable.wait(lock, [this]() { return isStopping || !tasks.empty(); });
+
+      if (isStopping && tasks.empty()) return;
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    task();
+  }
+}
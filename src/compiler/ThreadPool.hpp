@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A fixed-size pool of worker threads that the compiler hands independent pieces of work to, such as parsing
+   * linked capsules. Workers are only started the first time something is submitted, so compilations that never need
+   * them don't pay for them.
+   *
+   * Tasks are allowed to wait on other tasks. A thread that waits through await() runs queued tasks while it waits.
+   * This means a bounded pool can't deadlock on nested work, as long as the tasks don't wait on each other in a cycle.
+   */
+  class ThreadPool {
+  public:
+    /**
+     * @param threads The number of worker threads to start. Defaults to one less than the number of hardware threads,
+     * since the thread that submits the work helps out while waiting for it. With no workers at all, tasks are only
+     * run by threads that await them.
+     */
+    ThreadPool(size_t threads = getDefaultThreadCount()) : threadCount(threads) {}
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues a task to be run on one of the workers.
+     * @param task The task to run.
+     * @return A future that becomes ready once the task has finished running.
+     */
+    template<typename F>
+    shared_future<invoke_result_t<F>> submit(F task) {
+      auto packagedTask = make_shared<packaged_task<invoke_result_t<F>()>>(std::move(task));
+      shared_future<invoke_result_t<F>> result = packagedTask->get_future().share();
+
+      enqueue([packagedTask]() { (*packagedTask)(); });
+
+      return result;
+    }
+
+    /**
+     * @brief Waits for a future to become ready, running queued tasks on the calling thread in the meantime.
+     * @param result The future to wait for.
+     * @return The value of the future.
+     */
+    template<typename T>
+    T await(const shared_future<T> &result) {
+      while (result.wait_for(chrono::seconds(0)) != future_status::ready) {
+        if (!runPendingTask()) result.wait_for(chrono::milliseconds(1));
+      }
+
+      return result.get();
+    }
+
+    /**
+     * @brief Runs one queued task on the calling thread, if there is one.
+     * @return Whether a task was run.
+     */
+    bool runPendingTask();
+
+    /**
+     * @brief Changes the number of worker threads to start. Has no effect once workers have been started.
+     * @param threads The number of worker threads.
+     */
+    void setThreadCount(size_t threads);
+
+    /**
+     * @brief The number of worker threads, not counting the threads that help out while awaiting.
+     */
+    size_t getThreadCount() const { return threadCount; }
+
+    static size_t getDefaultThreadCount();
+
+  private:
+    size_t threadCount;
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex tasksMutex;
+    condition_variable tasksAvailable;
+    bool isStopping = false;
+
+    void enqueue(function<void()> task);
+
+    void runWorker();
+  };
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * The functions built into the language for taking tuples apart. A call to one of these names whose argument is a
+   * tuple always calls the intrinsic:
+   *
+   * - first(tuple) is the tuple's left value
+   * - second(tuple) is the tuple's right value
+   */
+  namespace TupleIntrinsics {
+    const string FIRST = "first";
+    const string SECOND = "second";
+
+    inline bool isTupleIntrinsic(const string &name) {
+      return name == FIRST || name == SECOND;
+    }
+
+    /**
+     * @brief The position in the tuple of the value an intrinsic reads.
+     */
+    inline int getIndex(const string &name) {
+      return name == FIRST ? 0 : 1;
+    }
+  }
+}
@@ -3,9 +3,15 @@
 #include <algorithm>
 #include <memory>
 #include <array>
+#include <optional>
 #include <string>
 #include <utility>
 #include "DataTypes.hpp"
+#include "DictIntrinsics.hpp"
+#include "ListIntrinsics.hpp"
+#include "StringIntrinsics.hpp"
+#include "TupleIntrinsics.hpp"
+#include "TypeInterner.hpp"
 #include "exceptions/IllegalReassignmentError.hpp"
 #include "exceptions/ReferenceError.hpp"
 #include "exceptions/TypeError.hpp"
@@ -39,7 +45,11 @@ bool TypeChecker::checkAST(shared_ptr<ASTNode> ast, vector<pair<string, shared_p
   }
 
   // Check node children first
-  if (ast->getValue()) {
+  if (ast->getNodeType() == ASTNode::CAPSULE) {
+    bool blockValid = checkCapsuleBlock(ast->getValue());
+
+    if (!blockValid) return false;
+  } else if (ast->getValue()) {
     bool childValid = checkAST(ast->getValue());
 
     if (!childValid) return false;
@@ -66,63 +76,49 @@ bool TypeChecker::checkAST(shared_ptr<ASTNode> ast, vector<pair<string, shared_p
 }
 
 bool TypeChecker::checkNode(shared_ptr<ASTNode> node) {
-  if (node->getNodeType() == ASTNode::AST_NODE_LIST) {
-    return true;
-  } else if (node->getNodeType() == ASTNode::SOURCE) {
-    node->setResolvedType(node->getValue()->getResolvedType());
-    return true;
-  } else if (node->getNodeType() == ASTNode::RETURN) {
-    node->setResolvedType(node->getValue()->getResolvedType());
-    return true;
-  } else if (node->getNodeType() == ASTNode::NUMBER_LITERAL) {
-    node->setResolvedType(make_shared<TypeDeclarationNode>(DataTypes::NUMBER, node));
-    return true;
-  } else if (node->getNodeType() == ASTNode::STRING_LITERAL) {
-    node->setResolvedType(make_shared<TypeDeclarationNode>(DataTypes::STRING, node));
-    return true;
-  } else if (node->getNodeType() == ASTNode::BOOLEAN_LITERAL) {
-    node->setResolvedType(make_shared<TypeDeclarationNode>(DataTypes::BOOLEAN, node));
-    return true;
-  } else if (node->getNodeType() == ASTNode::CAPSULE) {
-    node->setResolvedType(make_shared<TypeDeclarationNode>(DataTypes::CAPSULE, node));
-    return true;
-  } else if (node->getNodeType() == ASTNode::SYMBOL) {
-    node->setResolvedType(make_shared<TypeDeclarationNode>(DataTypes::SYMBOL, node));
-    return true;
-  } else if (node->getNodeType() == ASTNode::TYPE_DECLARATION) {
-    return checkTypeDeclarationNode(dynamic_pointer_cast<TypeDeclarationNode>(node));
-  } else if (node->getNodeType() == ASTNode::ASSIGNMENT) {
-    return checkAssignmentNode(dynamic_pointer_cast<AssignmentNode>(node));
-  } else if (node->getNodeType() == ASTNode::IDENTIFIER) {
-    return checkIdentifierNode(dynamic_pointer_cast<IdentifierNode>(node));
-  } else if (node->getNodeType() == ASTNode::BINARY_OPERATION) {
-    return checkBinaryOperationNode(dynamic_pointer_cast<BinaryOperationNode>(node));
-  } else if (node->getNodeType() == ASTNode::UNARY_OPERATION) {
-    return checkUnaryOperationNode(dynamic_pointer_cast<UnaryOperationNode>(node));
-  } else if (node->getNodeType() == ASTNode::BLOCK) {
-    return checkBlockNode(dynamic_pointer_cast<BlockNode>(node));
-  } else if (node->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
-    return checkFunctionDeclarationNode(dynamic_pointer_cast<FunctionDeclarationNode>(node));
-  } else if (node->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
-    return checkFunctionInvocationNode(dynamic_pointer_cast<FunctionInvocationNode>(node));
-  } else if (node->getNodeType() == ASTNode::CONTROL_FLOW) {
-    return checkControlFlowNode(dynamic_pointer_cast<ControlFlowNode>(node));
-  } else if (node->getNodeType() == ASTNode::LIST) {
-    return checkListNode(dynamic_pointer_cast<ListNode>(node));
-  } else if (node->getNodeType() == ASTNode::TUPLE) {
-    return checkTupleNode(dynamic_pointer_cast<TupleNode>(node));
-  } else if (node->getNodeType() == ASTNode::DICTIONARY) {
-    return checkDictionaryNode(dynamic_pointer_cast<DictionaryNode>(node));
-  } else if (node->getNodeType() == ASTNode::STRUCT_DEFINITION) {
-    return checkStructDefinitionNode(dynamic_pointer_cast<StructDefinitionNode>(node));
-  } else if (node->getNodeType() == ASTNode::STRUCT_DECLARATION) {
-    return checkStructDeclarationNode(dynamic_pointer_cast<StructDeclarationNode>(node));
-  }
+  return visit(node);
+}
 
-  return false;
+bool TypeChecker::visitASTNodeList(shared_ptr<ASTNodeList> node) {
+  return true;
+}
+
+bool TypeChecker::visitSource(shared_ptr<SourceNode> node) {
+  node->setResolvedType(node->getValue()->getResolvedType());
+  return true;
 }
 
-bool TypeChecker::checkTypeDeclarationNode(shared_ptr<TypeDeclarationNode> node) {
+bool TypeChecker::visitReturn(shared_ptr<ReturnNode> node) {
+  node->setResolvedType(node->getValue()->getResolvedType());
+  return true;
+}
+
+bool TypeChecker::visitNumberLiteral(shared_ptr<LiteralNode> node) {
+  node->setResolvedType(TypeInterner::getInstance().intern(DataTypes::NUMBER));
+  return true;
+}
+
+bool TypeChecker::visitStringLiteral(shared_ptr<LiteralNode> node) {
+  node->setResolvedType(TypeInterner::getInstance().intern(DataTypes::STRING));
+  return true;
+}
+
+bool TypeChecker::visitBooleanLiteral(shared_ptr<LiteralNode> node) {
+  node->setResolvedType(TypeInterner::getInstance().intern(DataTypes::BOOLEAN));
+  return true;
+}
+
+bool TypeChecker::visitCapsule(shared_ptr<CapsuleNode> node) {
+  node->setResolvedType(TypeInterner::getInstance().intern(DataTypes::CAPSULE));
+  return true;
+}
+
+bool TypeChecker::visitSymbol(shared_ptr<SymbolNode> node) {
+  node->setResolvedType(TypeInterner::getInstance().intern(DataTypes::SYMBOL));
+  return true;
+}
+
+bool TypeChecker::visitTypeDeclaration(shared_ptr<TypeDeclarationNode> node) {
   if (isLanguageDataType(node->getType())) return true;
 
   shared_ptr<ASTNode> customDataTypeInScope = lookupInScope(node->getType());
@@ -135,7 +131,7 @@ bool TypeChecker::checkTypeDeclarationNode(shared_ptr<TypeDeclarationNode> node)
   return true;
 }
 
-bool TypeChecker::checkAssignmentNode(shared_ptr<AssignmentNode> node) {
+bool TypeChecker::visitAssignment(shared_ptr<AssignmentNode> node) {
   bool typesMatch = isSameType(node->getLeft()->getValue(), node->getRight()->getResolvedType());
 
   shared_ptr<IdentifierNode> ident = dynamic_pointer_cast<IdentifierNode>(node->getLeft());
@@ -161,7 +157,7 @@ bool TypeChecker::checkAssignmentNode(shared_ptr<AssignmentNode> node) {
   
   // Function names can be overloaded, so functions don't need this check
   if (rhsType == DataTypes::FUNCTION) {
-    string uniqueFuncIdentifier = Compiler::getQualifiedFunctionIdentifier(
+    int uniqueFuncId = Compiler::getQualifiedFunctionId(
       ident->getIdentifier(),
       (node->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION 
         ? node->getRight()
@@ -170,14 +166,14 @@ bool TypeChecker::checkAssignmentNode(shared_ptr<AssignmentNode> node) {
       )
     );
     
-    auto existingFuncIdentifierInScope = identifierTable.lookup(uniqueFuncIdentifier);
+    auto existingFuncIdentifierInScope = identifierTable.lookup(uniqueFuncId);
 
     if (existingFuncIdentifierInScope.has_value()) {
       Compiler::getInstance().addException(make_shared<IllegalReassignmentError>(ident->getIdentifier()));
       return false;
     }
 
-    identifierTable.insert(uniqueFuncIdentifier, node->getRight());
+    identifierTable.insert(uniqueFuncId, node->getRight());
     
     // Also insert as the non-unique identifier, in case the function will be referenced without being called later.
     // It's okay to overwrite any identifier table value thats already there for this identifier, because if there are
@@ -198,7 +194,7 @@ bool TypeChecker::checkAssignmentNode(shared_ptr<AssignmentNode> node) {
   return true;
 }
 
-bool TypeChecker::checkIdentifierNode(shared_ptr<IdentifierNode> node) {
+bool TypeChecker::visitIdentifier(shared_ptr<IdentifierNode> node) {
   // Auto return if the identifier comes with its own type declaration. This is for assignment nodes lhs
   if (node->getValue()) return true;
   
@@ -213,7 +209,7 @@ bool TypeChecker::checkIdentifierNode(shared_ptr<IdentifierNode> node) {
   return true;
 }
 
-bool TypeChecker::checkBinaryOperationNode(shared_ptr<BinaryOperationNode> node) {
+bool TypeChecker::visitBinaryOperation(shared_ptr<BinaryOperationNode> node) {
   bool typesMatch = isSameType(node->getLeft()->getResolvedType(), node->getRight()->getResolvedType());
 
   if (!typesMatch) {
@@ -229,7 +225,7 @@ bool TypeChecker::checkBinaryOperationNode(shared_ptr<BinaryOperationNode> node)
   }
 
   if (isBooleanOperator(node->getOperator())) {
-    node->setResolvedType(make_shared<TypeDeclarationNode>(DataTypes::BOOLEAN, node));
+    node->setResolvedType(TypeInterner::getInstance().intern(DataTypes::BOOLEAN));
   } else {
     node->setResolvedType(node->getLeft()->getResolvedType());
   }
@@ -237,13 +233,13 @@ bool TypeChecker::checkBinaryOperationNode(shared_ptr<BinaryOperationNode> node)
   return true;
 }
 
-bool TypeChecker::checkUnaryOperationNode(shared_ptr<UnaryOperationNode> node) {
+bool TypeChecker::visitUnaryOperation(shared_ptr<UnaryOperationNode> node) {
   bool valid = checkAST(node->getValue());
 
   if (!valid) return false;
 
-  shared_ptr<TypeDeclarationNode> boolType = make_shared<TypeDeclarationNode>(DataTypes::BOOLEAN, nullptr);
-  shared_ptr<TypeDeclarationNode> numType = make_shared<TypeDeclarationNode>(DataTypes::NUMBER, nullptr);
+  shared_ptr<TypeDeclarationNode> boolType = TypeInterner::getInstance().intern(DataTypes::BOOLEAN);
+  shared_ptr<TypeDeclarationNode> numType = TypeInterner::getInstance().intern(DataTypes::NUMBER);
 
   if (isSameType(node->getValue()->getResolvedType(), boolType) && node->getOperator() != Lexemes::NOT) {
     Compiler::getInstance().addException(
@@ -273,7 +269,7 @@ bool TypeChecker::checkUnaryOperationNode(shared_ptr<UnaryOperationNode> node) {
   return true;
 }
 
-bool TypeChecker::checkBlockNode(shared_ptr<BlockNode> node) {
+bool TypeChecker::visitBlock(shared_ptr<BlockNode> node) {
   vector<shared_ptr<TypeDeclarationNode>> blockReturnTypes;
 
   vector<shared_ptr<ASTNode>> returns = Compiler::findAllInTree(node, ASTNode::RETURN);
@@ -298,7 +294,7 @@ bool TypeChecker::checkBlockNode(shared_ptr<BlockNode> node) {
   return true;
 }
 
-bool TypeChecker::checkFunctionDeclarationNode(shared_ptr<FunctionDeclarationNode> node) {
+bool TypeChecker::visitFunctionDeclaration(shared_ptr<FunctionDeclarationNode> node) {
   // "Typecheck" function params first to make them available within the scope of the definition
   vector<shared_ptr<ASTNode>> fnParams = dynamic_pointer_cast<ASTNodeList>(node->getParameters())->getElements();
 
@@ -316,44 +312,106 @@ bool TypeChecker::checkFunctionDeclarationNode(shared_ptr<FunctionDeclarationNod
 
   if (!valid) return false;
 
-  shared_ptr<TypeDeclarationNode> funcType = make_shared<TypeDeclarationNode>(DataTypes::FUNCTION, node);
+  if (node->getIsMemoized() && !checkMemoizable(node)) return false;
 
   vector<shared_ptr<ASTNode>> typeValues;
   for (auto param : node->getParameters()->getElements()) {
-    typeValues.push_back(Compiler::deepCopyTypeDeclaration(dynamic_pointer_cast<TypeDeclarationNode>(param->getValue()), funcType));
+    typeValues.push_back(TypeInterner::getInstance().intern(dynamic_pointer_cast<TypeDeclarationNode>(param->getValue())));
   }
 
   typeValues.push_back(node->getDefinition()->getResolvedType());
-  
-  funcType->setElements(typeValues);
 
-  // A function might already have a resolvedType if it was hoisted, we need to redefine it with the real return type
-  if (node->getResolvedType()) {
-    if (typeValues.size() == 1) {
-      node->getResolvedType()->setValue(typeValues.at(0));
-    } else {
-      dynamic_pointer_cast<TypeDeclarationNode>(node->getResolvedType())->setElements(typeValues);
-    }
-  } else {
-    node->setResolvedType(funcType); 
+  // Other functions are being checked against the hoisted signature at the same time, so it is left as it is for now
+  if (node == deferredFunction) {
+    deferredFunctionType = typeValues;
+    return valid;
   }
 
+  setFunctionType(node, typeValues);
+
   return valid;
 }
 
-bool TypeChecker::checkFunctionInvocationNode(shared_ptr<FunctionInvocationNode> node) {
+bool TypeChecker::checkMemoizable(shared_ptr<FunctionDeclarationNode> node) {
+  vector<shared_ptr<ASTNode>> types;
+  for (auto &param : node->getParameters()->getElements()) types.push_back(param->getValue());
+
+  types.push_back(node->getDefinition()->getResolvedType());
+
+  for (auto &type : types) {
+    string typeName = dynamic_pointer_cast<TypeDeclarationNode>(type)->getType();
+
+    if (typeName == DataTypes::NUMBER || typeName == DataTypes::BOOLEAN || typeName == DataTypes::SYMBOL) continue;
+
+    Compiler::getInstance().addException(
+      make_shared<TypeError>(
+        "Memoized functions can only take and return Numbers, Booleans and Symbols",
+        make_shared<TypeDeclarationNode>(DataTypes::NUMBER, nullptr),
+        type
+      )
+    );
+
+    return false;
+  }
+
+  return true;
+}
+
+void TypeChecker::setFunctionType(shared_ptr<FunctionDeclarationNode> node, vector<shared_ptr<ASTNode>> typeValues) {
+  shared_ptr<TypeDeclarationNode> funcType = make_shared<TypeDeclarationNode>(DataTypes::FUNCTION, node);
+
+  // A function might already have a resolvedType if it was hoisted, we need to redefine it with the real return type.
+  // The hoisted type is the interner's canonical instance, so it is replaced rather than changed
+  if (node->getResolvedType() && typeValues.size() == 1) {
+    funcType->setValue(typeValues.at(0));
+  } else {
+    funcType->setElements(typeValues);
+  }
+
+  node->setResolvedType(funcType);
+}
+
+bool TypeChecker::visitFunctionInvocation(shared_ptr<FunctionInvocationNode> node) {
   vector<shared_ptr<ASTNode>> params = dynamic_pointer_cast<ASTNodeList>(node->getParameters())->getElements();
+  string funcIdentifier = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+
+  // The functions passed to list intrinsics aren't values the arguments can be checked as on their own, so only the
+  // list, dictionary, tuple or string is checked before telling whether this is one
+  bool isListIntrinsic = ListIntrinsics::isListIntrinsic(funcIdentifier);
+  bool isDictIntrinsic = DictIntrinsics::isDictIntrinsic(funcIdentifier);
+  bool isTupleIntrinsic = TupleIntrinsics::isTupleIntrinsic(funcIdentifier);
+  bool isStringIntrinsic = StringIntrinsics::isStringIntrinsic(funcIdentifier);
+
+  if ((isListIntrinsic || isDictIntrinsic || isTupleIntrinsic || isStringIntrinsic) && !params.empty()) {
+    if (!checkAST(params.at(0))) return false;
+
+    shared_ptr<TypeDeclarationNode> firstParamType = dynamic_pointer_cast<TypeDeclarationNode>(params.at(0)->getResolvedType());
+
+    if (isListIntrinsic && firstParamType && firstParamType->getType() == DataTypes::LIST) return checkListIntrinsic(node);
+    if (isDictIntrinsic && firstParamType && firstParamType->getType() == DataTypes::DICT) return checkDictIntrinsic(node);
+    if (isTupleIntrinsic && firstParamType && firstParamType->getType() == DataTypes::TUPLE) return checkTupleIntrinsic(node);
+    if (isStringIntrinsic && firstParamType && firstParamType->getType() == DataTypes::STRING) return checkStringIntrinsic(node);
+
+    // Fields are read with get, using the field's name as the key
+    if (funcIdentifier == DictIntrinsics::GET && firstParamType && isStructType(firstParamType->getType())) {
+      return checkStructFieldAccess(node);
+    }
+  }
 
   bool validParams = checkAST(node->getParameters());
 
   if (!validParams) return false;
 
-  string funcIdentifier = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
-  string uniqueFuncIdentifier = Compiler::getQualifiedFunctionIdentifier(funcIdentifier, node);
+  int uniqueFuncId = Compiler::getQualifiedFunctionId(funcIdentifier, node);
+
+  shared_ptr<ASTNode> referencedFunction = lookupInScope(uniqueFuncId);
 
-  shared_ptr<ASTNode> referencedFunction = lookupInScope(uniqueFuncIdentifier);
-  
   if (!referencedFunction) {
+    const map<string, HostFunction> &hostFunctions = Compiler::getInstance().getHostFunctions();
+
+    auto hostFunction = hostFunctions.find(funcIdentifier);
+    if (hostFunction != hostFunctions.end()) return checkHostFunctionInvocation(node, hostFunction->second);
+
     string paramTypes = "(";
 
     for (int i = 0; i < node->getParameters()->getElements().size(); i++) {
@@ -382,7 +440,309 @@ bool TypeChecker::checkFunctionInvocationNode(shared_ptr<FunctionInvocationNode>
   return true;
 }
 
-bool TypeChecker::checkControlFlowNode(shared_ptr<ControlFlowNode> node) {
+bool TypeChecker::checkListIntrinsic(shared_ptr<FunctionInvocationNode> node) {
+  TypeInterner &interner = TypeInterner::getInstance();
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  shared_ptr<TypeDeclarationNode> listType = dynamic_pointer_cast<TypeDeclarationNode>(args.at(0)->getResolvedType());
+  shared_ptr<TypeDeclarationNode> elementType = dynamic_pointer_cast<TypeDeclarationNode>(listType->getValue());
+
+  if (args.size() != ListIntrinsics::getArity(intrinsic)) {
+    Compiler::getInstance().addException(
+      make_shared<ReferenceError>(intrinsic + "(" + listType->toString() + ", ...) with " + to_string(args.size()) + " arguments")
+    );
+
+    return false;
+  }
+
+  if (intrinsic == ListIntrinsics::LENGTH) {
+    node->setResolvedType(interner.intern(DataTypes::NUMBER));
+    return true;
+  }
+
+  // Elements are stored unboxed, which only Numbers and Booleans are so far
+  bool isUnboxedElement = elementType->getType() == DataTypes::NUMBER || elementType->getType() == DataTypes::BOOLEAN;
+
+  if (!isUnboxedElement || (intrinsic == ListIntrinsics::SUM && elementType->getType() != DataTypes::NUMBER)) {
+    Compiler::getInstance().addException(
+      make_shared<TypeError>(
+        "Only lists of Numbers can be summed, and only lists of Numbers or Booleans mapped, filtered or reduced",
+        elementType,
+        interner.intern(DataTypes::NUMBER)
+      )
+    );
+
+    return false;
+  }
+
+  if (intrinsic == ListIntrinsics::SUM) {
+    node->setResolvedType(interner.intern(DataTypes::NUMBER));
+    return true;
+  }
+
+  shared_ptr<ASTNode> accumulatorType;
+  vector<shared_ptr<ASTNode>> functionParamTypes = { elementType };
+
+  if (intrinsic == ListIntrinsics::REDUCE) {
+    if (!checkAST(args.at(2))) return false;
+
+    accumulatorType = args.at(2)->getResolvedType();
+    functionParamTypes = { accumulatorType, elementType };
+  }
+
+  shared_ptr<TypeDeclarationNode> functionType = resolveListIntrinsicFunction(args.at(1), functionParamTypes);
+  if (!functionType) return false;
+
+  shared_ptr<TypeDeclarationNode> returnType = dynamic_pointer_cast<TypeDeclarationNode>(
+    functionType->getValue() ? functionType->getValue() : functionType->getElements().back()
+  );
+
+  shared_ptr<ASTNode> expectedReturnType;
+  if (intrinsic == ListIntrinsics::FILTER) expectedReturnType = interner.intern(DataTypes::BOOLEAN);
+  if (intrinsic == ListIntrinsics::REDUCE) expectedReturnType = accumulatorType;
+
+  bool isValidReturnType = expectedReturnType
+    ? isSameType(returnType, expectedReturnType)
+    : returnType->getType() == DataTypes::NUMBER || returnType->getType() == DataTypes::BOOLEAN;
+
+  if (!isValidReturnType) {
+    Compiler::getInstance().addException(
+      make_shared<TypeError>(
+        "Function passed to " + intrinsic + " returns the wrong type",
+        returnType,
+        expectedReturnType ? expectedReturnType : interner.intern(DataTypes::NUMBER)
+      )
+    );
+
+    return false;
+  }
+
+  if (intrinsic == ListIntrinsics::MAP) {
+    shared_ptr<TypeDeclarationNode> mappedType = make_shared<TypeDeclarationNode>(DataTypes::LIST, node);
+    mappedType->setValue(returnType);
+
+    node->setResolvedType(mappedType);
+  } else if (intrinsic == ListIntrinsics::FILTER) {
+    node->setResolvedType(listType);
+  } else {
+    node->setResolvedType(accumulatorType);
+  }
+
+  return true;
+}
+
+shared_ptr<TypeDeclarationNode> TypeChecker::resolveListIntrinsicFunction(
+  shared_ptr<ASTNode> argument,
+  vector<shared_ptr<ASTNode>> paramTypes
+) {
+  shared_ptr<IdentifierNode> functionName = dynamic_pointer_cast<IdentifierNode>(argument);
+
+  // The signature is only used to look the function up by, which doesn't depend on what it returns
+  shared_ptr<TypeDeclarationNode> signature = make_shared<TypeDeclarationNode>(DataTypes::FUNCTION, argument);
+  vector<shared_ptr<ASTNode>> signatureTypes = paramTypes;
+  signatureTypes.push_back(TypeInterner::getInstance().intern(DataTypes::UNKNOWN));
+  signature->setElements(signatureTypes);
+
+  if (!functionName) {
+    if (checkAST(argument)) {
+      Compiler::getInstance().addException(
+        make_shared<TypeError>("List intrinsics take a capsule function by name", argument->getResolvedType(), signature)
+      );
+    }
+
+    return nullptr;
+  }
+
+  shared_ptr<ASTNode> function = lookupInScope(Compiler::getQualifiedFunctionId(functionName->getIdentifier(), signature));
+
+  if (!function) {
+    string paramTypeNames = "(";
+
+    for (int i = 0; i < paramTypes.size(); i++) {
+      if (i > 0) paramTypeNames += ", ";
+
+      paramTypeNames += dynamic_pointer_cast<TypeDeclarationNode>(paramTypes.at(i))->toString();
+    }
+
+    Compiler::getInstance().addException(make_shared<ReferenceError>(functionName->getIdentifier() + paramTypeNames + ")"));
+    return nullptr;
+  }
+
+  argument->setResolvedType(function->getResolvedType());
+
+  return dynamic_pointer_cast<TypeDeclarationNode>(function->getResolvedType());
+}
+
+bool TypeChecker::checkDictIntrinsic(shared_ptr<FunctionInvocationNode> node) {
+  TypeInterner &interner = TypeInterner::getInstance();
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  shared_ptr<TypeDeclarationNode> dictType = dynamic_pointer_cast<TypeDeclarationNode>(args.at(0)->getResolvedType());
+
+  if (args.size() != 2) {
+    Compiler::getInstance().addException(
+      make_shared<ReferenceError>(intrinsic + "(" + dictType->toString() + ", ...) with " + to_string(args.size()) + " arguments")
+    );
+
+    return false;
+  }
+
+  if (!checkAST(args.at(1))) return false;
+
+  shared_ptr<TypeDeclarationNode> symbolType = interner.intern(DataTypes::SYMBOL);
+
+  if (!isSameType(args.at(1)->getResolvedType(), symbolType)) {
+    Compiler::getInstance().addException(
+      make_shared<TypeError>("Dictionary key must be a <Symbol>", args.at(1)->getResolvedType(), symbolType)
+    );
+
+    return false;
+  }
+
+  if (intrinsic == DictIntrinsics::HAS) {
+    node->setResolvedType(interner.intern(DataTypes::BOOLEAN));
+  } else {
+    node->setResolvedType(dictType->getValue());
+  }
+
+  return true;
+}
+
+bool TypeChecker::checkStructFieldAccess(shared_ptr<FunctionInvocationNode> node) {
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+  string structType = dynamic_pointer_cast<TypeDeclarationNode>(args.at(0)->getResolvedType())->getType();
+
+  if (args.size() != 2) {
+    Compiler::getInstance().addException(
+      make_shared<ReferenceError>(DictIntrinsics::GET + "(" + structType + ", ...) with " + to_string(args.size()) + " arguments")
+    );
+
+    return false;
+  }
+
+  // Fields are laid out at compile time, so which one is read has to be known then too
+  shared_ptr<SymbolNode> field = dynamic_pointer_cast<SymbolNode>(args.at(1));
+
+  if (!field) {
+    if (checkAST(args.at(1))) {
+      Compiler::getInstance().addException(
+        make_shared<TypeError>(
+          "Struct fields must be read with a symbol literal",
+          args.at(1)->getResolvedType(),
+          TypeInterner::getInstance().intern(DataTypes::SYMBOL)
+        )
+      );
+    }
+
+    return false;
+  }
+
+  checkAST(field);
+
+  shared_ptr<ASTNodeList> structDefinition = dynamic_pointer_cast<ASTNodeList>(lookupInScope(structType));
+
+  if (structDefinition) {
+    for (auto &element : structDefinition->getElements()) {
+      shared_ptr<IdentifierNode> definedField = dynamic_pointer_cast<IdentifierNode>(element);
+
+      if (":" + definedField->getIdentifier() == field->getSymbol()) {
+        node->setResolvedType(definedField->getValue());
+        return true;
+      }
+    }
+  }
+
+  Compiler::getInstance().addException(make_shared<ReferenceError>(structType + " field " + field->getSymbol()));
+
+  return false;
+}
+
+bool TypeChecker::checkTupleIntrinsic(shared_ptr<FunctionInvocationNode> node) {
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  shared_ptr<TypeDeclarationNode> tupleType = dynamic_pointer_cast<TypeDeclarationNode>(args.at(0)->getResolvedType());
+
+  if (args.size() != 1) {
+    Compiler::getInstance().addException(
+      make_shared<ReferenceError>(intrinsic + "(" + tupleType->toString() + ", ...) with " + to_string(args.size()) + " arguments")
+    );
+
+    return false;
+  }
+
+  node->setResolvedType(tupleType->getElements().at(TupleIntrinsics::getIndex(intrinsic)));
+
+  return true;
+}
+
+bool TypeChecker::checkStringIntrinsic(shared_ptr<FunctionInvocationNode> node) {
+  TypeInterner &interner = TypeInterner::getInstance();
+  string intrinsic = dynamic_pointer_cast<IdentifierNode>(node->getIdentifier())->getIdentifier();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  if (args.size() != StringIntrinsics::getArity(intrinsic)) {
+    Compiler::getInstance().addException(
+      make_shared<ReferenceError>(intrinsic + "(String, ...) with " + to_string(args.size()) + " arguments")
+    );
+
+    return false;
+  }
+
+  // Every argument after the string is an index, other than what indexOf searches for
+  shared_ptr<TypeDeclarationNode> argType = interner.intern(
+    intrinsic == StringIntrinsics::INDEX_OF ? DataTypes::STRING : DataTypes::NUMBER
+  );
+
+  for (int i = 1; i < args.size(); i++) {
+    if (!checkAST(args.at(i))) return false;
+
+    if (!isSameType(args.at(i)->getResolvedType(), argType)) {
+      Compiler::getInstance().addException(
+        make_shared<TypeError>("Invalid argument to " + intrinsic, args.at(i)->getResolvedType(), argType)
+      );
+
+      return false;
+    }
+  }
+
+  node->setResolvedType(interner.intern(StringIntrinsics::returnsString(intrinsic) ? DataTypes::STRING : DataTypes::NUMBER));
+
+  return true;
+}
+
+bool TypeChecker::checkHostFunctionInvocation(shared_ptr<FunctionInvocationNode> node, const HostFunction &hostFunction) {
+  TypeInterner &interner = TypeInterner::getInstance();
+  vector<shared_ptr<ASTNode>> args = node->getParameters()->getElements();
+
+  if (args.size() != hostFunction.paramTypes.size()) {
+    Compiler::getInstance().addException(
+      make_shared<ReferenceError>(hostFunction.toString() + " with " + to_string(args.size()) + " arguments")
+    );
+
+    return false;
+  }
+
+  for (int i = 0; i < args.size(); i++) {
+    shared_ptr<TypeDeclarationNode> paramType = interner.intern(HostFunction::parseType(hostFunction.paramTypes.at(i), true));
+
+    if (!isSameType(args.at(i)->getResolvedType(), paramType)) {
+      Compiler::getInstance().addException(
+        make_shared<TypeError>("Invalid argument to " + hostFunction.name, args.at(i)->getResolvedType(), paramType)
+      );
+
+      return false;
+    }
+  }
+
+  node->setResolvedType(interner.intern(hostFunction.returnType));
+
+  return true;
+}
+
+bool TypeChecker::visitControlFlow(shared_ptr<ControlFlowNode> node) {
   vector<shared_ptr<TypeDeclarationNode>> returnTypes;
   bool hasElseBlock = false;
 
@@ -393,11 +753,11 @@ bool TypeChecker::checkControlFlowNode(shared_ptr<ControlFlowNode> node) {
     if (pair.first) {
       bool validCondition = checkAST(pair.first);
 
-      shared_ptr<TypeDeclarationNode> boolType = make_shared<TypeDeclarationNode>(DataTypes::BOOLEAN, nullptr);
+      shared_ptr<TypeDeclarationNode> boolType = TypeInterner::getInstance().intern(DataTypes::BOOLEAN);
 
       vector<shared_ptr<ASTNode>> typesThatCanBeInterpretedAsBooleans = {
         boolType,
-        make_shared<TypeDeclarationNode>(DataTypes::NUMBER, nullptr)
+        TypeInterner::getInstance().intern(DataTypes::NUMBER)
       };
 
       if (!validCondition || !isOneOfTypes(pair.first->getResolvedType(), typesThatCanBeInterpretedAsBooleans)) {
@@ -425,7 +785,7 @@ bool TypeChecker::checkControlFlowNode(shared_ptr<ControlFlowNode> node) {
   // If we have an if without an else, thats fine, but that means we have a potential hole if we try to use this as
   // a return value to something (like assigning a variable to the result of a control flow). We can return nil as part
   // of the resolved type of the node, which will cause assignments without an else to fail (as they should)
-  if (!hasElseBlock) returnTypes.push_back(make_shared<TypeDeclarationNode>(DataTypes::NIL, node));
+  if (!hasElseBlock) returnTypes.push_back(TypeInterner::getInstance().intern(DataTypes::NIL));
 
   if (returnTypes.size() == 1) {
     node->setResolvedType(returnTypes[0]);
@@ -436,7 +796,7 @@ bool TypeChecker::checkControlFlowNode(shared_ptr<ControlFlowNode> node) {
   return true;
 }
 
-bool TypeChecker::checkListNode(shared_ptr<ListNode> node) {
+bool TypeChecker::visitList(shared_ptr<ListNode> node) {
   vector<shared_ptr<TypeDeclarationNode>> returnTypes;
 
   shared_ptr<ASTNodeList> listNode = dynamic_pointer_cast<ASTNodeList>(node);
@@ -478,7 +838,7 @@ bool TypeChecker::checkListNode(shared_ptr<ListNode> node) {
   return true;
 }
 
-bool TypeChecker::checkTupleNode(shared_ptr<TupleNode> node) {
+bool TypeChecker::visitTuple(shared_ptr<TupleNode> node) {
   bool validLeft = checkAST(node->getLeft());
   bool validRight = checkAST(node->getRight());
 
@@ -496,7 +856,7 @@ bool TypeChecker::checkTupleNode(shared_ptr<TupleNode> node) {
   return true;
 }
 
-bool TypeChecker::checkDictionaryNode(shared_ptr<DictionaryNode> node) {
+bool TypeChecker::visitDictionary(shared_ptr<DictionaryNode> node) {
   vector<shared_ptr<TypeDeclarationNode>> keyTypes;
   vector<shared_ptr<TypeDeclarationNode>> valueTypes;
 
@@ -510,7 +870,7 @@ bool TypeChecker::checkDictionaryNode(shared_ptr<DictionaryNode> node) {
 
     if (!isKeyValid || !isValValid) return false;
 
-    shared_ptr<TypeDeclarationNode> symbolType = make_shared<TypeDeclarationNode>(DataTypes::SYMBOL, nullptr);
+    shared_ptr<TypeDeclarationNode> symbolType = TypeInterner::getInstance().intern(DataTypes::SYMBOL);
 
     if (!isSameType(kvTuple->getLeft()->getResolvedType(), symbolType)) {
       Compiler::getInstance().addException(
@@ -526,7 +886,12 @@ bool TypeChecker::checkDictionaryNode(shared_ptr<DictionaryNode> node) {
     valueTypes.push_back(dynamic_pointer_cast<TypeDeclarationNode>(kvTuple->getRight()->getResolvedType()));
   }
 
-  if (!isHomogenous(valueTypes)) {
+  // A struct's fields are checked one by one against its definition in visitStructDeclaration,
+  // so they are free to have different types
+  shared_ptr<ASTNode> parent = node->getParent();
+  bool isStructBody = parent && parent->getNodeType() == ASTNode::STRUCT_DECLARATION;
+
+  if (!isStructBody && !isHomogenous(valueTypes)) {
     Compiler::getInstance().addException(
       make_shared<TypeError>(
         "Dictionary values must be homogenous",
@@ -551,7 +916,7 @@ bool TypeChecker::checkDictionaryNode(shared_ptr<DictionaryNode> node) {
   return true;
 }
 
-bool TypeChecker::checkStructDefinitionNode(shared_ptr<StructDefinitionNode> node) {
+bool TypeChecker::visitStructDefinition(shared_ptr<StructDefinitionNode> node) {
   shared_ptr<ASTNodeList> structNode = dynamic_pointer_cast<ASTNodeList>(node);
 
   for (int i = 0; i < structNode->getElements().size(); i++) {
@@ -574,7 +939,7 @@ bool TypeChecker::checkStructDefinitionNode(shared_ptr<StructDefinitionNode> nod
   return true;
 }
 
-bool TypeChecker::checkStructDeclarationNode(shared_ptr<StructDeclarationNode> node) {
+bool TypeChecker::visitStructDeclaration(shared_ptr<StructDeclarationNode> node) {
   shared_ptr<ASTNode> foundDefinition = lookupInScope(node->getStructType());
 
   if (!foundDefinition) {
@@ -649,6 +1014,124 @@ bool TypeChecker::checkStructDeclarationNode(shared_ptr<StructDeclarationNode> n
   return true;
 }
 
+bool TypeChecker::checkCapsuleBlock(shared_ptr<ASTNode> block) {
+  vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(block)->getElements();
+  vector<FunctionBodyCheck> bodyChecks = checkFunctionBodies(elements);
+
+  if (block->hasOwnScope()) identifierTable.enterScope();
+
+  // Everything else is checked in source order, as if the bodies were checked in it too: a body's errors are only
+  // reported if everything before it was valid, and its signature is only updated once it would have been checked
+  for (int i = 0; i < elements.size(); i++) {
+    if (!bodyChecks[i].isChecked) {
+      bool elValid = checkAST(elements[i]);
+
+      if (!elValid) return false;
+
+      continue;
+    }
+
+    bool lhsValid = checkAST(elements[i]->getLeft());
+
+    for (auto &e : bodyChecks[i].exceptions) Compiler::getInstance().addException(e);
+
+    if (!lhsValid || !bodyChecks[i].isValid) return false;
+
+    setFunctionType(dynamic_pointer_cast<FunctionDeclarationNode>(elements[i]->getRight()), bodyChecks[i].typeValues);
+
+    bool assignmentValid = checkNode(elements[i]);
+
+    if (!assignmentValid) return false;
+  }
+
+  if (block->hasOwnScope()) identifierTable.exitScope();
+
+  return checkNode(block);
+}
+
+vector<TypeChecker::FunctionBodyCheck> TypeChecker::checkFunctionBodies(vector<shared_ptr<ASTNode>> &elements) {
+  vector<FunctionBodyCheck> bodyChecks(elements.size());
+
+  vector<int> functions;
+  for (int i = 0; i < elements.size(); i++) {
+    if (isCapsuleFunction(elements[i])) functions.push_back(i);
+  }
+
+  // Not worth handing out to other threads
+  if (functions.size() <= PARALLEL_CHECK_CHUNK_SIZE) return bodyChecks;
+
+  Compiler &compiler = Compiler::getInstance();
+  vector<shared_future<void>> chunks;
+
+  for (int start = 0; start < functions.size(); start += PARALLEL_CHECK_CHUNK_SIZE) {
+    int end = min((int) functions.size(), start + PARALLEL_CHECK_CHUNK_SIZE);
+
+    chunks.push_back(compiler.getWorkerPool().submit([this, &compiler, &elements, &functions, &bodyChecks, start, end]() {
+      Compiler::ActiveScope activeScope(&compiler);
+
+      TypeChecker worker;
+      worker.capsuleChecker = this;
+      worker.identifierTable.enterScope();
+
+      // The worker's scope starts out as it would be by the time the first body in the chunk was checked in order
+      for (int i = 0; i < functions[start]; i++) worker.bindCapsuleElement(elements[i]);
+
+      for (int i = functions[start]; i <= functions[end - 1]; i++) {
+        if (isCapsuleFunction(elements[i])) {
+          bodyChecks[i] = worker.checkFunctionBody(dynamic_pointer_cast<FunctionDeclarationNode>(elements[i]->getRight()));
+        }
+
+        worker.bindCapsuleElement(elements[i]);
+      }
+    }));
+  }
+
+  for (auto &chunk : chunks) compiler.getWorkerPool().await(chunk);
+
+  return bodyChecks;
+}
+
+TypeChecker::FunctionBodyCheck TypeChecker::checkFunctionBody(shared_ptr<FunctionDeclarationNode> node) {
+  FunctionBodyCheck bodyCheck;
+  Compiler::ExceptionScope scope;
+
+  deferredFunction = node;
+  bodyCheck.isChecked = true;
+  bodyCheck.isValid = checkAST(node);
+  bodyCheck.typeValues = deferredFunctionType;
+  bodyCheck.exceptions = scope.exceptions;
+
+  deferredFunction = nullptr;
+  deferredFunctionType.clear();
+
+  return bodyCheck;
+}
+
+void TypeChecker::bindCapsuleElement(shared_ptr<ASTNode> element) {
+  if (element->getNodeType() == ASTNode::STRUCT_DEFINITION) {
+    identifierTable.insert(dynamic_pointer_cast<StructDefinitionNode>(element)->getName(), element);
+    return;
+  }
+
+  if (element->getNodeType() != ASTNode::ASSIGNMENT) return;
+
+  shared_ptr<IdentifierNode> ident = dynamic_pointer_cast<IdentifierNode>(element->getLeft());
+  shared_ptr<TypeDeclarationNode> declaredType = dynamic_pointer_cast<TypeDeclarationNode>(ident->getValue());
+
+  // The same bindings visitAssignment makes, going by the declared type, since the value may not be checked yet
+  if (element->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
+    identifierTable.insert(Compiler::getQualifiedFunctionId(ident->getIdentifier(), element->getRight()), element->getRight());
+  } else if (declaredType->getType() == DataTypes::FUNCTION) {
+    identifierTable.insert(Compiler::getQualifiedFunctionId(ident->getIdentifier(), declaredType), element->getRight());
+  }
+
+  identifierTable.insert(ident->getIdentifier(), declaredType);
+}
+
+bool TypeChecker::isCapsuleFunction(shared_ptr<ASTNode> element) {
+  return element->getNodeType() == ASTNode::ASSIGNMENT && element->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION;
+}
+
 void TypeChecker::hoistCapsuleDeclarations(shared_ptr<CapsuleNode> node) {
   vector<shared_ptr<ASTNode>> capsuleTopLevelElements = dynamic_pointer_cast<ASTNodeList>(node->getValue())->getElements();
 
@@ -673,9 +1156,9 @@ void TypeChecker::hoistFunction(shared_ptr<ASTNode> node) {
   shared_ptr<AssignmentNode> assignmentNode = dynamic_pointer_cast<AssignmentNode>(node); 
   shared_ptr<IdentifierNode> ident = dynamic_pointer_cast<IdentifierNode>(node->getLeft());
 
-  string uniqueFuncIdentifier = Compiler::getQualifiedFunctionIdentifier(ident->getIdentifier(), node->getRight());
+  int uniqueFuncId = Compiler::getQualifiedFunctionId(ident->getIdentifier(), node->getRight());
 
-  auto existingFuncIdentifierInScope = capsuleDeclarationsTable.lookup(uniqueFuncIdentifier);
+  auto existingFuncIdentifierInScope = capsuleDeclarationsTable.lookup(uniqueFuncId);
 
   if (existingFuncIdentifierInScope.has_value()) {
     Compiler::getInstance().addException(make_shared<IllegalReassignmentError>(ident->getIdentifier()));
@@ -685,9 +1168,9 @@ void TypeChecker::hoistFunction(shared_ptr<ASTNode> node) {
   // Initially set the function resolvedType to whatever the identifier type is specified. This will get
   // updated later when we actually typecheck the function definition to whatever types the function actually returns.
   // This way, we support recursive function type resolution and cyclic function type resolution
-  node->getRight()->setResolvedType(Compiler::deepCopyTypeDeclaration(dynamic_pointer_cast<TypeDeclarationNode>(ident->getValue()), node));
+  node->getRight()->setResolvedType(TypeInterner::getInstance().intern(dynamic_pointer_cast<TypeDeclarationNode>(ident->getValue())));
 
-  capsuleDeclarationsTable.insert(uniqueFuncIdentifier, node->getRight());
+  capsuleDeclarationsTable.insert(uniqueFuncId, node->getRight());
 }
 
 void TypeChecker::hoistStructDefinition(shared_ptr<ASTNode> node) {
@@ -733,7 +1216,26 @@ bool TypeChecker::isSameType(shared_ptr<ASTNode> type1, shared_ptr<ASTNode> type
   shared_ptr<TypeDeclarationNode> t2 = dynamic_pointer_cast<TypeDeclarationNode>(type2);
 
   if (!t1 && !t2) return true;
+  if (!t1 || !t2) return false;
+
+  TypeInterner &interner = TypeInterner::getInstance();
+  int id1 = interner.getId(t1);
+  int id2 = interner.getId(t2);
+
+  // Every type is the same as itself
+  if (id1 == id2) return true;
+
+  optional<bool> knownCompatibility = interner.findCompatibility(id1, id2);
+  if (knownCompatibility) return *knownCompatibility;
 
+  // The canonical instances are compared, so that comparing the types they contain is only ever an id lookup
+  bool isCompatible = isCompatibleType(interner.getType(id1), interner.getType(id2));
+  interner.storeCompatibility(id1, id2, isCompatible);
+
+  return isCompatible;
+}
+
+bool TypeChecker::isCompatibleType(shared_ptr<TypeDeclarationNode> t1, shared_ptr<TypeDeclarationNode> t2) {
   // For dicts or lists that are initialized to empty 
   if (
     t1 && t2 && 
@@ -829,6 +1331,10 @@ bool TypeChecker::isLanguageDataType(string type) {
   return find(LANGUAGE_DATATYPES.begin(), LANGUAGE_DATATYPES.end(), type) != LANGUAGE_DATATYPES.end();
 }
 
+bool TypeChecker::isStructType(const string &type) {
+  return !isLanguageDataType(type) && type != DataTypes::UNKNOWN && type != DataTypes::NIL && type != DataTypes::CAPSULE;
+}
+
 bool TypeChecker::isBooleanOperator(string op) {
   array<string, 9> BOOLEAN_OPERATORS = {
     Lexemes::EQUALITY,
@@ -871,12 +1377,21 @@ shared_ptr<TypeDeclarationNode> TypeChecker::makeVariadicType(vector<shared_ptr<
 }
 
 shared_ptr<ASTNode> TypeChecker::lookupInScope(string identifierName) {
-  auto foundInCapsule = capsuleDeclarationsTable.lookup(identifierName);
-  auto foundInLocalScope = identifierTable.lookup(identifierName);
+  return lookupInScope(SymbolInterner::getInstance().findId(identifierName));
+}
+
+shared_ptr<ASTNode> TypeChecker::lookupInScope(int identifierId) {
+  auto foundInLocalScope = identifierTable.lookup(identifierId);
 
   // Local scope overrides capsule scope
   if (foundInLocalScope.has_value()) return foundInLocalScope.value();
 
+  const SymbolTableStack<shared_ptr<ASTNode>> &capsuleDeclarations = (
+    capsuleChecker ? capsuleChecker->capsuleDeclarationsTable : capsuleDeclarationsTable
+  );
+
+  auto foundInCapsule = capsuleDeclarations.lookup(identifierId);
+
   if (foundInCapsule.has_value()) return foundInCapsule.value();
 
   return nullptr;
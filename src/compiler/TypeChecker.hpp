@@ -18,7 +18,10 @@
 #include "parser/ast/StructDeclarationNode.hpp"
 #include "parser/ast/StructDefinitionNode.hpp"
 #include "parser/ast/TupleNode.hpp"
+#include "parser/ast/ASTVisitor.hpp"
 #include "SymbolTableStack.hpp"
+#include "HostFunction.hpp"
+#include "exceptions/Error.hpp"
 
 using namespace std;
 
@@ -29,7 +32,7 @@ using namespace std;
 namespace Theta {
   class Compiler;
 
-  class TypeChecker {
+  class TypeChecker : public ASTVisitor<TypeChecker, bool> {
   public:
     /**
      * @brief Checks the types of all nodes within an AST recursively
@@ -42,7 +45,8 @@ namespace Theta {
     bool checkAST(shared_ptr<ASTNode> ast, vector<pair<string, shared_ptr<ASTNode>>> bindToScope = {});
 
     /**
-     * @brief Determines if two AST nodes represent the same type.
+     * @brief Determines if two AST nodes represent the same type. Types are compared by the ids the TypeInterner gives
+     * them, so identical types are the same in constant time, and any other pair is only ever compared once.
      * 
      * @param type1 The first type node. This should be an ASTNode that is a TypeDeclarationNode
      * @param type2 The second type node. This should be an ASTNode that is a TypeDeclarationNode
@@ -63,9 +67,34 @@ namespace Theta {
 
     static shared_ptr<TypeDeclarationNode> getFunctionReturnType(shared_ptr<ASTNode> fn);
 
+    /**
+     * @brief Whether a type is a struct, which is any type that isn't built into the language.
+     */
+    static bool isStructType(const string &type);
+
+    // Capsules with more functions than this have their function bodies checked on the worker pool, this many at a time
+    static const int PARALLEL_CHECK_CHUNK_SIZE = 16;
+
   private:
+    // The outcome of checking the body of a capsule function away from the rest of the capsule
+    struct FunctionBodyCheck {
+      bool isChecked = false;
+      bool isValid = false;
+      vector<shared_ptr<Theta::Error>> exceptions;
+
+      // The function's type, with the return type the body actually has, to replace the hoisted signature with
+      vector<shared_ptr<ASTNode>> typeValues;
+    };
+
     SymbolTableStack<shared_ptr<ASTNode>> identifierTable;
     SymbolTableStack<shared_ptr<ASTNode>> capsuleDeclarationsTable;
+
+    // Set on the checkers that check function bodies for another checker, whose hoisted declarations they share
+    const TypeChecker *capsuleChecker = nullptr;
+
+    // The function whose hoisted signature is left alone when it is checked, and the type it should get instead
+    shared_ptr<FunctionDeclarationNode> deferredFunction;
+    vector<shared_ptr<ASTNode>> deferredFunctionType;
     
     /**
      * @brief Performs type checking on a single AST node.
@@ -76,6 +105,32 @@ namespace Theta {
      */
     bool checkNode(shared_ptr<ASTNode> node);
 
+    friend class ASTVisitor<TypeChecker, bool>;
+
+    /**
+     * @brief Node lists on their own have no type to check. Always returns true
+     */
+    bool visitASTNodeList(shared_ptr<ASTNodeList> node);
+
+    /**
+     * @brief Gives the source the type of its value. Always returns true
+     */
+    bool visitSource(shared_ptr<SourceNode> node);
+
+    /**
+     * @brief Gives a return the type of the value it returns. Always returns true
+     */
+    bool visitReturn(shared_ptr<ReturnNode> node);
+
+    /**
+     * @brief Literals, capsules and symbols always have the type they are written as. Always returns true
+     */
+    bool visitNumberLiteral(shared_ptr<LiteralNode> node);
+    bool visitStringLiteral(shared_ptr<LiteralNode> node);
+    bool visitBooleanLiteral(shared_ptr<LiteralNode> node);
+    bool visitCapsule(shared_ptr<CapsuleNode> node);
+    bool visitSymbol(shared_ptr<SymbolNode> node);
+
     /**
      * @brief Checks a type declaration node to ensure it represents a valid type.
      * 
@@ -83,7 +138,7 @@ namespace Theta {
      * @return true If the type is valid.
      * @return false If the type is undefined or invalid.
      */
-    bool checkTypeDeclarationNode(shared_ptr<TypeDeclarationNode> node);
+    bool visitTypeDeclaration(shared_ptr<TypeDeclarationNode> node);
 
     /**
      * @brief Checks an assignment node to ensure that the types of the left-hand side and right-hand side match.
@@ -92,7 +147,7 @@ namespace Theta {
      * @return true If the assignment is valid.
      * @return false If the types do not match or if a reassignment was attempted.
      */
-    bool checkAssignmentNode(shared_ptr<AssignmentNode> node);
+    bool visitAssignment(shared_ptr<AssignmentNode> node);
 
     /**
      * @brief Checks an identifier node to ensure it is defined within the current scope.
@@ -101,7 +156,7 @@ namespace Theta {
      * @return true If the identifier is defined.
      * @return false If the identifier is undefined.
      */
-    bool checkIdentifierNode(shared_ptr<IdentifierNode> node);
+    bool visitIdentifier(shared_ptr<IdentifierNode> node);
 
     /**
      * @brief Checks a binary operation node to ensure the types of the operands match.
@@ -110,7 +165,7 @@ namespace Theta {
      * @return true If the operands are of the same type.
      * @return false If the operands are of different types.
      */
-    bool checkBinaryOperationNode(shared_ptr<BinaryOperationNode> node);
+    bool visitBinaryOperation(shared_ptr<BinaryOperationNode> node);
 
     /**
      * @brief Checks a unary operation node for type correctness based on the operation.
@@ -119,7 +174,7 @@ namespace Theta {
      * @return true If the operation is valid for the operand's type.
      * @return false Otherwise.
      */
-    bool checkUnaryOperationNode(shared_ptr<UnaryOperationNode> node);
+    bool visitUnaryOperation(shared_ptr<UnaryOperationNode> node);
 
     /**
      * @brief Sets the resolvedType of the block to whatever the return values of the block are.
@@ -128,7 +183,7 @@ namespace Theta {
      * @param node The block node to check.
      * @return true Always
      */
-    bool checkBlockNode(shared_ptr<BlockNode> node);
+    bool visitBlock(shared_ptr<BlockNode> node);
 
     /**
      * @brief Checks a function declaration node to set the resolvedType of the function. Also
@@ -138,7 +193,25 @@ namespace Theta {
      * @return true If the function body statements are valid
      * @return false Otherwise.
      */
-    bool checkFunctionDeclarationNode(shared_ptr<FunctionDeclarationNode> node);
+    bool visitFunctionDeclaration(shared_ptr<FunctionDeclarationNode> node);
+
+    /**
+     * @brief Checks that a function annotated with `@memo` only takes and returns values its memo table can hold as they
+     * are, which are the ones that aren't heap references or strings.
+     *
+     * @param node The function declaration, after its body was checked.
+     * @return true If it can be memoized.
+     * @return false Otherwise, having reported why.
+     */
+    bool checkMemoizable(shared_ptr<FunctionDeclarationNode> node);
+
+    /**
+     * @brief Gives a function the type it was checked to have, updating its hoisted signature if it has one.
+     *
+     * @param node The function declaration.
+     * @param typeValues The parameter types, followed by the return type.
+     */
+    void setFunctionType(shared_ptr<FunctionDeclarationNode> node, vector<shared_ptr<ASTNode>> typeValues);
 
     /**
      * @brief Checks a function invocation node to ensure that the arguments match the parameters of the called function.
@@ -147,7 +220,75 @@ namespace Theta {
      * @return true If the arguments match the function's parameters.
      * @return false If the referenced function cant be found, or otherwise.
      */
-    bool checkFunctionInvocationNode(shared_ptr<FunctionInvocationNode> node);
+    bool visitFunctionInvocation(shared_ptr<FunctionInvocationNode> node);
+
+    /**
+     * @brief Checks a call to one of the list intrinsics, such as sum or map, whose first argument has already been
+     * checked and is a list. See ListIntrinsics.
+     *
+     * @param node The function invocation node to check.
+     * @return true If the arguments are what the intrinsic takes.
+     * @return false If there are too many or too few of them, the list isn't of a type the intrinsic works on, or the
+     * function passed to it doesn't exist or returns the wrong type.
+     */
+    bool checkListIntrinsic(shared_ptr<FunctionInvocationNode> node);
+
+    /**
+     * @brief Resolves the capsule function passed to a list intrinsic by name, from the types it is called with.
+     *
+     * @param argument The argument naming the function.
+     * @param paramTypes The types the intrinsic calls the function with.
+     * @return The type of the function, or nullptr if the argument doesn't name one that takes those types
+     */
+    shared_ptr<TypeDeclarationNode> resolveListIntrinsicFunction(shared_ptr<ASTNode> argument, vector<shared_ptr<ASTNode>> paramTypes);
+
+    /**
+     * @brief Checks a call to one of the dictionary intrinsics, see DictIntrinsics, whose dictionary has already been
+     * checked.
+     *
+     * @param node The function invocation node to check.
+     * @return true If the arguments are what the intrinsic takes.
+     * @return false If there are too many or too few of them, or the key isn't a Symbol.
+     */
+    bool checkDictIntrinsic(shared_ptr<FunctionInvocationNode> node);
+
+    /**
+     * @brief Checks a field read from a struct, written get(struct, :field), whose struct has already been checked.
+     *
+     * @param node The function invocation node to check.
+     * @return true If the field is a symbol naming a field of the struct.
+     * @return false If there are too many or too few arguments, the field isn't a symbol literal, or the struct has no
+     * such field.
+     */
+    bool checkStructFieldAccess(shared_ptr<FunctionInvocationNode> node);
+
+    /**
+     * @brief Checks a call to first or second, see TupleIntrinsics, whose tuple has already been checked.
+     *
+     * @param node The function invocation node to check.
+     * @return true If the tuple is the only argument.
+     * @return false If there are any other arguments.
+     */
+    bool checkTupleIntrinsic(shared_ptr<FunctionInvocationNode> node);
+
+    /**
+     * @brief Checks a call to one of the string intrinsics, see StringIntrinsics, whose string has already been checked.
+     *
+     * @param node The function invocation node to check.
+     * @return true If the arguments are what the intrinsic takes.
+     * @return false If there are too many or too few of them, or any of them is of the wrong type.
+     */
+    bool checkStringIntrinsic(shared_ptr<FunctionInvocationNode> node);
+
+    /**
+     * @brief Checks a call to a function the host provides, see HostFunction, whose arguments have already been checked.
+     *
+     * @param node The function invocation node to check.
+     * @param hostFunction The function it calls.
+     * @return true If the arguments are what the host function takes.
+     * @return false If there are too many or too few of them, or any of them is of the wrong type.
+     */
+    bool checkHostFunctionInvocation(shared_ptr<FunctionInvocationNode> node, const HostFunction &hostFunction);
 
     /**
      * @brief Checks a control flow node (e.g., if statements) to ensure that the conditions resolve to a boolean.
@@ -157,7 +298,7 @@ namespace Theta {
      * @return true If all conditions are boolean.
      * @return false If any condition is not boolean or if any blocks have invalid types in them.
      */
-    bool checkControlFlowNode(shared_ptr<ControlFlowNode> node);
+    bool visitControlFlow(shared_ptr<ControlFlowNode> node);
 
     /**
      * @brief Checks a list node to ensure all elements are of the same type.
@@ -166,7 +307,7 @@ namespace Theta {
      * @return true If all elements are of the same type.
      * @return false If elements are of different types.
      */
-    bool checkListNode(shared_ptr<ListNode> node);
+    bool visitList(shared_ptr<ListNode> node);
 
     /**
      * @brief Checks a tuple node to ensure the types of its elements are valid.
@@ -175,7 +316,7 @@ namespace Theta {
      * @return true If the tuple's elements are correctly typed.
      * @return false Otherwise.
      */
-    bool checkTupleNode(shared_ptr<TupleNode> node);
+    bool visitTuple(shared_ptr<TupleNode> node);
 
     /**
      * @brief Checks a dictionary node to ensure that all keys are symbols and all values are of one type.
@@ -184,7 +325,7 @@ namespace Theta {
      * @return true If the dictionary is correctly typed.
      * @return false If there are type mismatches.
      */
-    bool checkDictionaryNode(shared_ptr<DictionaryNode> node);
+    bool visitDictionary(shared_ptr<DictionaryNode> node);
 
     /**
      * @brief Checks a struct definition node to ensure it hasn't already been defined, and all types
@@ -194,7 +335,7 @@ namespace Theta {
      * @return true If the definition has not been made already and it uses valid types.
      * @return false Otherwise.
      */
-    bool checkStructDefinitionNode(shared_ptr<StructDefinitionNode> node);
+    bool visitStructDefinition(shared_ptr<StructDefinitionNode> node);
 
     /**
      * @brief Checks a struct declaration node to ensure all required fields are present and correctly typed.
@@ -203,7 +344,7 @@ namespace Theta {
      * @return true If the struct is correctly declared.
      * @return false If there are missing fields or type mismatches.
      */
-    bool checkStructDeclarationNode(shared_ptr<StructDeclarationNode> node);
+    bool visitStructDeclaration(shared_ptr<StructDeclarationNode> node);
 
     /**
      * @brief Processes capsule declarations, hoisting them into the appropriate scope.
@@ -212,6 +353,38 @@ namespace Theta {
      */
     void hoistCapsuleDeclarations(shared_ptr<CapsuleNode> node);
 
+    /**
+     * @brief Checks the top level elements of a capsule, once its declarations have been hoisted. The bodies of the
+     * capsule's functions only depend on each other through their hoisted signatures, so in large capsules they are
+     * checked on the worker pool first, and the results merged back in source order.
+     *
+     * @param block The capsule's block of top level elements.
+     * @return true If every element is correctly typed.
+     */
+    bool checkCapsuleBlock(shared_ptr<ASTNode> block);
+
+    /**
+     * @brief Checks the bodies of a capsule's functions on the worker pool, if there are enough of them to be worth it.
+     *
+     * @param elements The capsule's top level elements.
+     * @return vector<FunctionBodyCheck> The result for each element, left unchecked for the ones that weren't checked.
+     */
+    vector<FunctionBodyCheck> checkFunctionBodies(vector<shared_ptr<ASTNode>> &elements);
+
+    /**
+     * @brief Checks a capsule function without changing its hoisted signature, collecting its errors rather than
+     * reporting them.
+     */
+    FunctionBodyCheck checkFunctionBody(shared_ptr<FunctionDeclarationNode> node);
+
+    /**
+     * @brief Binds a top level element into the local scope the way checking it would, so that the bodies after it see
+     * the scope they would have if the capsule was checked in order.
+     */
+    void bindCapsuleElement(shared_ptr<ASTNode> element);
+
+    static bool isCapsuleFunction(shared_ptr<ASTNode> element);
+
     /**
      * @brief Hoists function declarations to the appropriate scope to make them globally accessible within the capsule.
      * 
@@ -241,6 +414,11 @@ namespace Theta {
      */
     shared_ptr<ASTNode> lookupInScope(string identifier);
 
+    /**
+     * @brief Looks up an identifier by its interned symbol id, such as a qualified function id.
+     */
+    shared_ptr<ASTNode> lookupInScope(int identifierId);
+
     /**
      * @brief Determines if a vector of type declaration nodes is homogenous, i.e., all elements are of the same type.
      * 
@@ -250,6 +428,16 @@ namespace Theta {
      */
     static bool isHomogenous(vector<shared_ptr<TypeDeclarationNode>> types);
 
+    /**
+     * @brief The structural comparison behind isSameType, for two types that aren't identical. isSameType only calls it
+     * once for any pair of types, and remembers the result.
+     *
+     * @param t1 The canonical instance of the first type.
+     * @param t2 The canonical instance of the second type.
+     * @return true If a value of the second type can be used where the first is expected.
+     */
+    static bool isCompatibleType(shared_ptr<TypeDeclarationNode> t1, shared_ptr<TypeDeclarationNode> t2);
+
     /**
      * @brief Checks if a given type is a built-in language data type.
      * 
@@ -0,0 +1,104 @@
+#include "TypeInterner.hpp"
+#include <mutex>
+
+using namespace Theta;
+
+TypeInterner& TypeInterner::getInstance() {
+  static TypeInterner instance;
+  return instance;
+}
+
+int TypeInterner::getId(shared_ptr<TypeDeclarationNode> type) {
+  if (!type) return -1;
+
+  int id = type->getInternedId();
+  if (id >= 0) return id;
+
+  TypeKey key{ type->getType(), { getChildId(type->getValue()), getChildId(type->getLeft()), getChildId(type->getRight()) } };
+
+  for (auto &elem : type->getElements()) key.children.push_back(getChildId(elem));
+
+  id = getIdForKey(key);
+  type->setInternedId(id);
+
+  return id;
+}
+
+shared_ptr<TypeDeclarationNode> TypeInterner::intern(shared_ptr<TypeDeclarationNode> type) {
+  int id = getId(type);
+
+  return id < 0 ? nullptr : getType(id);
+}
+
+shared_ptr<TypeDeclarationNode> TypeInterner::intern(string type) {
+  return getType(getIdForKey(TypeKey{ type, { -1, -1, -1 } }));
+}
+
+shared_ptr<TypeDeclarationNode> TypeInterner::getType(int id) {
+  shared_lock<shared_mutex> lock(typesMutex);
+
+  return canonicalTypes.at(id);
+}
+
+size_t TypeInterner::getSize() {
+  shared_lock<shared_mutex> lock(typesMutex);
+
+  return canonicalTypes.size();
+}
+
+optional<bool> TypeInterner::findCompatibility(int expected, int actual) {
+  shared_lock<shared_mutex> lock(compatibilityMutex);
+
+  auto it = compatibility.find(getCompatibilityKey(expected, actual));
+  if (it == compatibility.end()) return nullopt;
+
+  return it->second;
+}
+
+void TypeInterner::storeCompatibility(int expected, int actual, bool isCompatible) {
+  unique_lock<shared_mutex> lock(compatibilityMutex);
+
+  compatibility.insert(make_pair(getCompatibilityKey(expected, actual), isCompatible));
+}
+
+int TypeInterner::getIdForKey(const TypeKey &key) {
+  {
+    shared_lock<shared_mutex> lock(typesMutex);
+
+    auto it = idsByKey.find(key);
+    if (it != idsByKey.end()) return it->second;
+  }
+
+  unique_lock<shared_mutex> lock(typesMutex);
+
+  // Another thread may have added it while the lock was released
+  auto it = idsByKey.find(key);
+  if (it != idsByKey.end()) return it->second;
+
+  shared_ptr<TypeDeclarationNode> canonical = make_shared<TypeDeclarationNode>(key.type, nullptr);
+
+  if (key.children[0] >= 0) canonical->setValue(canonicalTypes.at(key.children[0]));
+  if (key.children[1] >= 0) canonical->setLeft(canonicalTypes.at(key.children[1]));
+  if (key.children[2] >= 0) canonical->setRight(canonicalTypes.at(key.children[2]));
+
+  vector<shared_ptr<ASTNode>> elements;
+  for (int i = 3; i < key.children.size(); i++) elements.push_back(canonicalTypes.at(key.children[i]));
+
+  canonical->setElements(elements);
+
+  int id = canonicalTypes.size();
+  canonical->setInternedId(id, true);
+
+  canonicalTypes.push_back(canonical);
+  idsByKey.insert(make_pair(key, id));
+
+  return id;
+}
+
+uint64_t TypeInterner::getCompatibilityKey(int expected, int actual) {
+  return ((uint64_t) (uint32_t) expected << 32) | (uint32_t) actual;
+}
+
+int TypeInterner::getChildId(shared_ptr<ASTNode> child) {
+  return getId(dynamic_pointer_cast<TypeDeclarationNode>(child));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "parser/ast/TypeDeclarationNode.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Gives every distinct type a stable id, so that telling whether two types are the same is an integer compare,
+   * however deeply nested they are. Types are hash-consed: a type's id is looked up by its name and the ids of the types
+   * it contains, so interning a type only looks at the children that haven't been interned yet.
+   *
+   * Each id has a canonical instance, shared by everything the type is interned for. Canonical types are never changed,
+   * so they can be used as resolved types in place of copies. The interner is shared by every thread, and lives as long
+   * as the program does, since the types a program uses are few.
+   */
+  class TypeInterner {
+  public:
+    static TypeInterner& getInstance();
+
+    /**
+     * @brief The id of a type, which every type with the same structure shares.
+     *
+     * @param type The type.
+     * @return The id, or -1 if there is no type
+     */
+    int getId(shared_ptr<TypeDeclarationNode> type);
+
+    /**
+     * @brief The canonical instance of a type. Must not be changed.
+     */
+    shared_ptr<TypeDeclarationNode> intern(shared_ptr<TypeDeclarationNode> type);
+
+    /**
+     * @brief The canonical instance of a type with no type parameters, such as Number. Must not be changed.
+     */
+    shared_ptr<TypeDeclarationNode> intern(string type);
+
+    /**
+     * @brief The canonical instance of the type with the given id.
+     */
+    shared_ptr<TypeDeclarationNode> getType(int id);
+
+    /**
+     * @brief Looks up whether a value of one type was already found to be acceptable where another is expected.
+     *
+     * @param expected The id of the expected type.
+     * @param actual The id of the type of the value.
+     * @return The result of the earlier check, if there was one
+     */
+    optional<bool> findCompatibility(int expected, int actual);
+
+    /**
+     * @brief Remembers whether a value of one type is acceptable where another is expected.
+     */
+    void storeCompatibility(int expected, int actual, bool isCompatible);
+
+    /**
+     * @brief How many distinct types have been interned.
+     */
+    size_t getSize();
+
+  private:
+    // A type's name, and the ids of its value, left, right and elements, -1 where it has none
+    struct TypeKey {
+      string type;
+      vector<int> children;
+
+      bool operator==(const TypeKey &other) const {
+        return type == other.type && children == other.children;
+      }
+    };
+
+    struct TypeKeyHash {
+      size_t operator()(const TypeKey &key) const {
+        size_t hash = std::hash<string>()(key.type);
+        for (int id : key.children) hash ^= (size_t) id + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+
+        return hash;
+      }
+    };
+
+    unordered_map<TypeKey, int, TypeKeyHash> idsByKey;
+    vector<shared_ptr<TypeDeclarationNode>> canonicalTypes;
+
+    // The expected type's id in the high half and the actual type's in the low half, to whether they are compatible
+    unordered_map<uint64_t, bool> compatibility;
+    shared_mutex typesMutex;
+    shared_mutex compatibilityMutex;
+
+    TypeInterner() = default;
+
+    /**
+     * @brief The id of the type with the given key, adding a canonical type for it if there isn't one yet.
+     */
+    int getIdForKey(const TypeKey &key);
+
+    int getChildId(shared_ptr<ASTNode> child);
+
+    static uint64_t getCompatibilityKey(int expected, int actual);
+  };
+}
@@ -0,0 +1,52 @@
+#include "WasmCache.hpp"
+#include "lexer/SourceFile.hpp"
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+using namespace Theta;
+
+namespace {
+  const char WASM_MAGIC[4] = { '\0', 'a', 's', 'm' };
+}
+
+optional<vector<char>> WasmCache::load(uint64_t buildKey) {
+  shared_ptr<SourceFile> entry = SourceFile::open(getEntryPath(buildKey).string());
+  if (!entry) return nullopt;
+
+  string_view wasm = entry->view();
+
+  // Anything that isn't even a wasm module was left behind by something else, and is ignored
+  if (wasm.length() < sizeof(WASM_MAGIC) || memcmp(wasm.data(), WASM_MAGIC, sizeof(WASM_MAGIC)) != 0) return nullopt;
+
+  return vector<char>(wasm.begin(), wasm.end());
+}
+
+void WasmCache::store(uint64_t buildKey, string_view wasm) {
+  error_code ec;
+  filesystem::create_directories(cacheDir, ec);
+
+  // Write to a temporary file and move it into place, so a concurrent compile never loads a partially written entry
+  filesystem::path entryPath = getEntryPath(buildKey);
+  filesystem::path tempPath = entryPath;
+  tempPath += ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()));
+
+  {
+    ofstream entryFile(tempPath, ios::binary | ios::trunc);
+    if (!entryFile) return;
+
+    entryFile.write(wasm.data(), wasm.size());
+    if (!entryFile.good()) return;
+  }
+
+  filesystem::rename(tempPath, entryPath, ec);
+  if (ec) filesystem::remove(tempPath, ec);
+}
+
+filesystem::path WasmCache::getEntryPath(uint64_t buildKey) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.wasm", (unsigned long long) buildKey);
+
+  return cacheDir / name;
+}
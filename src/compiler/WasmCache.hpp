@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief An on-disk cache of compiled wasm, keyed by the build key of the capsule it was compiled from (see
+   * CapsuleGraph). A capsule whose source and dependency interfaces haven't changed since it was last compiled is
+   * loaded from here instead of being type checked and code generated again.
+   */
+  class WasmCache {
+  public:
+    /**
+     * @param directory Where cache entries are stored.
+     */
+    WasmCache(filesystem::path directory = DEFAULT_CACHE_DIR) : cacheDir(directory) {}
+
+    /**
+     * @brief Loads the wasm compiled for the given build key, if there is any.
+     * @param buildKey The build key of the capsule.
+     * @return The compiled wasm binary, or nullopt if there is no valid entry for the key.
+     */
+    optional<vector<char>> load(uint64_t buildKey);
+
+    /**
+     * @brief Stores the wasm compiled for the given build key. Failing to write the entry is not an error, the next
+     * compile will just miss.
+     * @param buildKey The build key of the capsule.
+     * @param wasm The compiled wasm binary.
+     */
+    void store(uint64_t buildKey, string_view wasm);
+
+    static inline const filesystem::path DEFAULT_CACHE_DIR = filesystem::path(".theta") / "wasm-cache";
+
+  private:
+    filesystem::path cacheDir;
+
+    filesystem::path getEntryPath(uint64_t buildKey);
+  };
+}
@@ -0,0 +1,191 @@
+#include "CommonSubexpressionEliminationPass.hpp"
+#include "InliningPass.hpp"
+#include "compiler/DataTypes.hpp"
+#include "compiler/TypeInterner.hpp"
+#include "parser/ast/AssignmentNode.hpp"
+#include "parser/ast/BinaryOperationNode.hpp"
+#include "parser/ast/ControlFlowNode.hpp"
+#include "parser/ast/FunctionInvocationNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+#include <memory>
+#include <utility>
+
+using namespace Theta;
+
+void CommonSubexpressionEliminationPass::optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) {
+  if (ast->getNodeType() != ASTNode::BLOCK || !ast->getParent()) return;
+
+  // The code generator only gives the assignments in function bodies and branches locals
+  ASTNode::Types parentType = ast->getParent()->getNodeType();
+  if (parentType != ASTNode::FUNCTION_DECLARATION && parentType != ASTNode::CONTROL_FLOW) return;
+
+  eliminateInBlock(dynamic_pointer_cast<ASTNodeList>(ast));
+}
+
+void CommonSubexpressionEliminationPass::eliminateInBlock(shared_ptr<ASTNodeList> block) {
+  while (true) {
+    map<string, int> occurrences;
+    map<string, shared_ptr<ASTNode>> firstOccurrences;
+
+    for (auto &elem : block->getElements()) collectCandidates(elem, occurrences, firstOccurrences);
+
+    // Binding the largest repeated subexpression first also takes care of the ones inside it
+    string key;
+    int bestCost = -1;
+
+    for (auto &[candidate, count] : occurrences) {
+      int cost = InliningPass::getInlineCost(firstOccurrences[candidate]);
+
+      if (count > 1 && cost > bestCost) {
+        key = candidate;
+        bestCost = cost;
+      }
+    }
+
+    if (bestCost < 0) return;
+
+    shared_ptr<ASTNode> expression = firstOccurrences[key];
+    shared_ptr<TypeDeclarationNode> type = dynamic_pointer_cast<TypeDeclarationNode>(expression->getResolvedType());
+    string identifier = BINDING_PREFIX + to_string(nextBindingId++);
+
+    vector<shared_ptr<ASTNode>> newElements;
+    bool isBound = false;
+
+    for (auto elem : block->getElements()) {
+      bool isReplaced = replaceOccurrences(elem, key, identifier);
+
+      // The first element that uses the subexpression is the first one that could, so the binding goes right before it
+      if (isReplaced && !isBound) {
+        shared_ptr<AssignmentNode> assignment = make_shared<AssignmentNode>(block);
+        shared_ptr<IdentifierNode> binding = make_shared<IdentifierNode>(identifier, assignment);
+
+        binding->setValue(TypeInterner::getInstance().intern(type));
+        binding->setSourceLocation(expression->getLine(), expression->getColumn());
+        expression->setParent(assignment);
+
+        assignment->setLeft(binding);
+        assignment->setRight(expression);
+        assignment->setResolvedType(TypeInterner::getInstance().intern(type));
+        assignment->setSourceLocation(expression->getLine(), expression->getColumn());
+
+        newElements.push_back(assignment);
+        isBound = true;
+      }
+
+      newElements.push_back(elem);
+    }
+
+    block->setElements(newElements);
+    changed = true;
+  }
+}
+
+bool CommonSubexpressionEliminationPass::isCandidate(shared_ptr<ASTNode> ast) {
+  switch (ast->getNodeType()) {
+    case ASTNode::BINARY_OPERATION:
+    case ASTNode::UNARY_OPERATION:
+    case ASTNode::FUNCTION_INVOCATION:
+      break;
+    default:
+      return false;
+  }
+
+  shared_ptr<TypeDeclarationNode> type = dynamic_pointer_cast<TypeDeclarationNode>(ast->getResolvedType());
+  if (!type) return false;
+
+  // Functions returned by a call are closures, which the code generator keeps track of by the call that made them
+  bool isValueType = (
+    type->getType() == DataTypes::NUMBER ||
+    type->getType() == DataTypes::STRING ||
+    type->getType() == DataTypes::BOOLEAN
+  );
+
+  return isValueType && InliningPass::getInlineCost(ast) >= 0;
+}
+
+void CommonSubexpressionEliminationPass::forEachEvaluatedChild(
+  shared_ptr<ASTNode> ast,
+  const std::function<void(shared_ptr<ASTNode> &)> &visit
+) {
+  switch (ast->getNodeType()) {
+    case ASTNode::BLOCK:
+    case ASTNode::FUNCTION_DECLARATION:
+      return;
+    case ASTNode::CONTROL_FLOW: {
+      shared_ptr<ControlFlowNode> cFlowNode = dynamic_pointer_cast<ControlFlowNode>(ast);
+      vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> pairs = cFlowNode->getConditionExpressionPairs();
+
+      // Only the first condition is always evaluated
+      if (pairs.empty() || !pairs.front().first) return;
+
+      visit(pairs.front().first);
+      cFlowNode->setConditionExpressionPairs(pairs);
+
+      return;
+    }
+    case ASTNode::FUNCTION_INVOCATION:
+      for (auto &arg : dynamic_pointer_cast<FunctionInvocationNode>(ast)->getParameters()->getElements()) visit(arg);
+
+      return;
+    case ASTNode::BINARY_OPERATION: {
+      string op = dynamic_pointer_cast<BinaryOperationNode>(ast)->getOperator();
+
+      visit(ast->getLeft());
+
+      // The right side of a short circuiting operator might never be evaluated
+      if (op != "&&" && op != "||") visit(ast->getRight());
+
+      return;
+    }
+    default:
+      break;
+  }
+
+  if (ast->getValue()) {
+    visit(ast->getValue());
+  } else if (ast->getLeft()) {
+    visit(ast->getLeft());
+    visit(ast->getRight());
+  } else if (ast->hasMany()) {
+    for (auto &elem : dynamic_pointer_cast<ASTNodeList>(ast)->getElements()) visit(elem);
+  }
+}
+
+void CommonSubexpressionEliminationPass::collectCandidates(
+  shared_ptr<ASTNode> ast,
+  map<string, int> &occurrences,
+  map<string, shared_ptr<ASTNode>> &firstOccurrences
+) {
+  if (isCandidate(ast)) {
+    string key = ast->toJSON();
+
+    occurrences[key]++;
+    firstOccurrences.insert(make_pair(key, ast));
+  }
+
+  forEachEvaluatedChild(ast, [&occurrences, &firstOccurrences](shared_ptr<ASTNode> &child) {
+    collectCandidates(child, occurrences, firstOccurrences);
+  });
+}
+
+bool CommonSubexpressionEliminationPass::replaceOccurrences(shared_ptr<ASTNode> &ast, const string &key, const string &identifier) {
+  if (isCandidate(ast) && ast->toJSON() == key) {
+    shared_ptr<IdentifierNode> reference = make_shared<IdentifierNode>(identifier, ast->getParent());
+
+    reference->setResolvedType(TypeInterner::getInstance().intern(dynamic_pointer_cast<TypeDeclarationNode>(ast->getResolvedType())));
+    reference->setSourceLocation(ast->getLine(), ast->getColumn());
+
+    ast = reference;
+
+    return true;
+  }
+
+  bool isReplaced = false;
+
+  forEachEvaluatedChild(ast, [&key, &identifier, &isReplaced](shared_ptr<ASTNode> &child) {
+    isReplaced = replaceOccurrences(child, key, identifier) || isReplaced;
+  });
+
+  return isReplaced;
+}
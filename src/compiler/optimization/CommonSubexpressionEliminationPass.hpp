@@ -0,0 +1,84 @@
+#pragma once
+
+#include "OptimizationPass.hpp"
+#include "parser/ast/ASTNode.hpp"
+#include "parser/ast/ASTNodeList.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief An optimization pass that computes repeated subexpressions once. Theta values are immutable and its operations
+ * have no side effects, so `(a * b) + (a * b)` can be rewritten to bind `a * b` to a local before the expression, and
+ * reference the local in both places.
+ *
+ * Subexpressions are compared by their structure, so two occurrences are equal if they serialize to the same JSON. Only
+ * operations and calls that produce a Number, String or Boolean are bound, and only within a single block, where every
+ * identifier in them refers to the same thing. The pass never looks inside nested blocks, functions, or anything that is
+ * only evaluated some of the time, like the branches of an if or the right side of `&&` and `||`, since binding those
+ * ahead of time would evaluate them when the program otherwise wouldn't.
+ *
+ * Runs after type checking, since the locals it adds need the types the type checker resolved for the expressions.
+ */
+namespace Theta {
+  class CommonSubexpressionEliminationPass : public OptimizationPass {
+  public:
+    string getName() override { return "CommonSubexpressionElimination"; }
+
+    set<ASTNode::Types> getInterests() override { return { ASTNode::BLOCK }; }
+
+  private:
+    // Can't be written in Theta, so the locals never clash with user defined variables
+    static inline const string BINDING_PREFIX = "ThetaLang.internal.cse.";
+
+    // Bindings are numbered across the whole program, so that a closure never shadows one from its enclosing function
+    int nextBindingId = 0;
+
+    void optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) override;
+
+    /**
+     * @brief Binds every subexpression that appears more than once among a block's elements to a local.
+     *
+     * @param block The block.
+     */
+    void eliminateInBlock(shared_ptr<ASTNodeList> block);
+
+    /**
+     * @brief Whether a node is an expression worth computing only once.
+     */
+    static bool isCandidate(shared_ptr<ASTNode> ast);
+
+    /**
+     * @brief Calls visit on each child of a node that is evaluated whenever the node is, and replaces the child with
+     * whatever visit leaves in it.
+     */
+    static void forEachEvaluatedChild(shared_ptr<ASTNode> ast, const std::function<void(shared_ptr<ASTNode> &)> &visit);
+
+    /**
+     * @brief Finds the candidate subexpressions of a node, keyed by their structure.
+     *
+     * @param ast The node to search.
+     * @param occurrences How many times each subexpression was found.
+     * @param firstOccurrences The first node found for each subexpression.
+     */
+    static void collectCandidates(
+      shared_ptr<ASTNode> ast,
+      map<string, int> &occurrences,
+      map<string, shared_ptr<ASTNode>> &firstOccurrences
+    );
+
+    /**
+     * @brief Replaces every occurrence of a subexpression inside a node with a reference to the local it was bound to.
+     *
+     * @param ast Reference to the node to search.
+     * @param key The structure of the subexpression.
+     * @param identifier The name of the local.
+     * @return true If anything was replaced
+     */
+    static bool replaceOccurrences(shared_ptr<ASTNode> &ast, const string &key, const string &identifier);
+  };
+}
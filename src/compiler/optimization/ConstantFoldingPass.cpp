@@ -0,0 +1,177 @@
+#include "ConstantFoldingPass.hpp"
+#include "compiler/DataTypes.hpp"
+#include "lexer/Lexemes.hpp"
+#include "parser/ast/BinaryOperationNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+#include "parser/ast/UnaryOperationNode.hpp"
+#include <climits>
+#include <memory>
+
+using namespace Theta;
+
+void ConstantFoldingPass::optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) {
+  shared_ptr<LiteralNode> folded;
+
+  if (ast->getNodeType() == ASTNode::BINARY_OPERATION) {
+    if (!isLiteral(ast->getLeft()) || !isLiteral(ast->getRight())) return;
+
+    folded = foldBinaryOperation(
+      dynamic_pointer_cast<BinaryOperationNode>(ast)->getOperator(),
+      dynamic_pointer_cast<LiteralNode>(ast->getLeft()),
+      dynamic_pointer_cast<LiteralNode>(ast->getRight())
+    );
+  } else if (ast->getNodeType() == ASTNode::UNARY_OPERATION) {
+    if (!isLiteral(ast->getValue())) return;
+
+    folded = foldUnaryOperation(
+      dynamic_pointer_cast<UnaryOperationNode>(ast)->getOperator(),
+      dynamic_pointer_cast<LiteralNode>(ast->getValue())
+    );
+  }
+
+  if (!folded) return;
+
+  folded->setParent(ast->getParent());
+  folded->setSourceLocation(ast->getLine(), ast->getColumn());
+
+  // Once the AST has type checked, whatever replaces a node needs a type too
+  if (ast->getResolvedType()) folded->setResolvedType(make_shared<TypeDeclarationNode>(getLiteralType(folded), folded));
+
+  ast = folded;
+  changed = true;
+}
+
+shared_ptr<LiteralNode> ConstantFoldingPass::foldBinaryOperation(string op, shared_ptr<LiteralNode> left, shared_ptr<LiteralNode> right) {
+  // Operands of different types are a type error, which the type checker reports
+  if (left->getNodeType() != right->getNodeType()) return nullptr;
+
+  if (left->getNodeType() == ASTNode::NUMBER_LITERAL) {
+    optional<int64_t> leftValue = getWholeNumber(left);
+    optional<int64_t> rightValue = getWholeNumber(right);
+
+    if (!leftValue || !rightValue) return nullptr;
+
+    int64_t l = leftValue.value();
+    int64_t r = rightValue.value();
+
+    // Operands fit in 32 bits, so none of these can overflow
+    if (op == Lexemes::PLUS) return makeNumberLiteral(l + r);
+    if (op == Lexemes::MINUS) return makeNumberLiteral(l - r);
+    if (op == Lexemes::TIMES) return makeNumberLiteral(l * r);
+
+    // Division by zero traps at runtime, so it has to stay there
+    if (op == Lexemes::DIVISION) return r == 0 ? nullptr : makeNumberLiteral(l / r);
+    if (op == Lexemes::MODULO) return r == 0 ? nullptr : makeNumberLiteral(l % r);
+
+    if (op == Lexemes::EXPONENT) {
+      if (r < 0) return nullptr;
+
+      // The only bases whose powers never outgrow 32 bits
+      if (r == 0) return makeNumberLiteral(1);
+      if (l == 0 || l == 1) return makeNumberLiteral(l);
+      if (l == -1) return makeNumberLiteral(r % 2 == 0 ? 1 : -1);
+
+      int64_t result = 1;
+      for (int64_t i = 0; i < r; i++) {
+        result *= l;
+
+        // Any other base outgrows 32 bits within a few dozen steps
+        if (result > INT_MAX || result < INT_MIN) return nullptr;
+      }
+
+      return makeNumberLiteral(result);
+    }
+
+    if (op == Lexemes::EQUALITY) return makeBooleanLiteral(l == r);
+    if (op == Lexemes::INEQUALITY) return makeBooleanLiteral(l != r);
+    if (op == Lexemes::LT) return makeBooleanLiteral(l < r);
+    if (op == Lexemes::GT) return makeBooleanLiteral(l > r);
+    if (op == Lexemes::LTEQ) return makeBooleanLiteral(l <= r);
+    if (op == Lexemes::GTEQ) return makeBooleanLiteral(l >= r);
+
+    return nullptr;
+  }
+
+  if (left->getNodeType() == ASTNode::BOOLEAN_LITERAL) {
+    bool l = left->getLiteralValue() == Lexemes::TRUE;
+    bool r = right->getLiteralValue() == Lexemes::TRUE;
+
+    if (op == Lexemes::AND) return makeBooleanLiteral(l && r);
+    if (op == Lexemes::OR) return makeBooleanLiteral(l || r);
+    if (op == Lexemes::EQUALITY) return makeBooleanLiteral(l == r);
+    if (op == Lexemes::INEQUALITY) return makeBooleanLiteral(l != r);
+
+    return nullptr;
+  }
+
+  if (left->getNodeType() == ASTNode::STRING_LITERAL) {
+    if (op == Lexemes::PLUS) {
+      return make_shared<LiteralNode>(ASTNode::STRING_LITERAL, left->getLiteralValue() + right->getLiteralValue(), nullptr);
+    }
+
+    if (op == Lexemes::EQUALITY) return makeBooleanLiteral(left->getLiteralValue() == right->getLiteralValue());
+    if (op == Lexemes::INEQUALITY) return makeBooleanLiteral(left->getLiteralValue() != right->getLiteralValue());
+  }
+
+  return nullptr;
+}
+
+shared_ptr<LiteralNode> ConstantFoldingPass::foldUnaryOperation(string op, shared_ptr<LiteralNode> value) {
+  if (value->getNodeType() == ASTNode::BOOLEAN_LITERAL && op == Lexemes::NOT) {
+    return makeBooleanLiteral(value->getLiteralValue() != Lexemes::TRUE);
+  }
+
+  if (value->getNodeType() == ASTNode::NUMBER_LITERAL && op == Lexemes::MINUS) {
+    optional<int64_t> number = getWholeNumber(value);
+
+    if (!number) return nullptr;
+
+    return makeNumberLiteral(-number.value());
+  }
+
+  return nullptr;
+}
+
+optional<int64_t> ConstantFoldingPass::getWholeNumber(shared_ptr<LiteralNode> literal) {
+  string value = literal->getLiteralValue();
+  size_t start = !value.empty() && value[0] == '-' ? 1 : 0;
+
+  // Anything longer can't fit in 32 bits anyway, and this keeps stoll from overflowing
+  if (value.length() == start || value.length() - start > 10) return nullopt;
+
+  for (size_t i = start; i < value.length(); i++) {
+    if (value[i] < '0' || value[i] > '9') return nullopt;
+  }
+
+  int64_t number = stoll(value);
+  if (number > INT_MAX || number < INT_MIN) return nullopt;
+
+  return number;
+}
+
+shared_ptr<LiteralNode> ConstantFoldingPass::makeNumberLiteral(int64_t value) {
+  if (value > INT_MAX || value < INT_MIN) return nullptr;
+
+  return make_shared<LiteralNode>(ASTNode::NUMBER_LITERAL, to_string(value), nullptr);
+}
+
+shared_ptr<LiteralNode> ConstantFoldingPass::makeBooleanLiteral(bool value) {
+  return make_shared<LiteralNode>(ASTNode::BOOLEAN_LITERAL, value ? Lexemes::TRUE : Lexemes::FALSE, nullptr);
+}
+
+string ConstantFoldingPass::getLiteralType(shared_ptr<LiteralNode> literal) {
+  if (literal->getNodeType() == ASTNode::NUMBER_LITERAL) return DataTypes::NUMBER;
+  if (literal->getNodeType() == ASTNode::BOOLEAN_LITERAL) return DataTypes::BOOLEAN;
+
+  return DataTypes::STRING;
+}
+
+bool ConstantFoldingPass::isLiteral(shared_ptr<ASTNode> ast) {
+  if (!ast) return false;
+
+  return (
+    ast->getNodeType() == ASTNode::NUMBER_LITERAL ||
+    ast->getNodeType() == ASTNode::BOOLEAN_LITERAL ||
+    ast->getNodeType() == ASTNode::STRING_LITERAL
+  );
+}
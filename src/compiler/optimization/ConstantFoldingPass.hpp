@@ -0,0 +1,73 @@
+#pragma once
+
+#include "OptimizationPass.hpp"
+#include "parser/ast/ASTNode.hpp"
+#include "parser/ast/LiteralNode.hpp"
+#include <memory>
+#include <optional>
+
+using namespace std;
+
+/**
+ * @brief An optimization pass that evaluates operations whose operands are all literals at compile time, replacing them
+ * with the literal they evaluate to. It runs after the LiteralInlinerPass, which turns references to constants into
+ * literals, so together they reduce constant expressions such as `x * 2 + 1` down to a single literal.
+ *
+ * Only operations that are sure to evaluate the same way at runtime are folded. Anything that would fail to type check
+ * is left alone, so that the type checker still reports it. The pass runs again once the AST has type checked, to fold
+ * what inlining exposes.
+ */
+namespace Theta {
+  class ConstantFoldingPass : public OptimizationPass {
+  public:
+    string getName() override { return "ConstantFolding"; }
+
+    set<ASTNode::Types> getInterests() override { return { ASTNode::BINARY_OPERATION, ASTNode::UNARY_OPERATION }; }
+
+  private:
+    void optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) override;
+
+    /**
+     * @brief Evaluates a binary operation on two literals.
+     *
+     * @param op The operator symbol.
+     * @param left The left operand.
+     * @param right The right operand.
+     * @return The literal the operation evaluates to, or nullptr if it can't be folded
+     */
+    static shared_ptr<LiteralNode> foldBinaryOperation(string op, shared_ptr<LiteralNode> left, shared_ptr<LiteralNode> right);
+
+    /**
+     * @brief Evaluates a unary operation on a literal.
+     *
+     * @param op The operator symbol.
+     * @param value The operand.
+     * @return The literal the operation evaluates to, or nullptr if it can't be folded
+     */
+    static shared_ptr<LiteralNode> foldUnaryOperation(string op, shared_ptr<LiteralNode> value);
+
+    /**
+     * @brief Parses the value of a number literal. Numbers are whole 32 bit integers once they're compiled, so decimal
+     * literals aren't folded, to leave their handling up to code generation.
+     *
+     * @param literal The literal to parse.
+     * @return The value of the literal, or nullopt if it isn't a whole number literal
+     */
+    static optional<int64_t> getWholeNumber(shared_ptr<LiteralNode> literal);
+
+    /**
+     * @brief Creates a number literal, as long as its value still fits in a 32 bit integer.
+     * @return The literal, or nullptr if the value doesn't fit
+     */
+    static shared_ptr<LiteralNode> makeNumberLiteral(int64_t value);
+
+    static shared_ptr<LiteralNode> makeBooleanLiteral(bool value);
+
+    /**
+     * @brief The data type a literal has, for literals created after type checking
+     */
+    static string getLiteralType(shared_ptr<LiteralNode> literal);
+
+    static bool isLiteral(shared_ptr<ASTNode> ast);
+  };
+}
@@ -0,0 +1,215 @@
+#include "DeadCodeEliminationPass.hpp"
+#include "SpecializationPass.hpp"
+#include "lexer/Lexemes.hpp"
+#include "parser/ast/ASTNodeList.hpp"
+#include "parser/ast/ControlFlowNode.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+#include "parser/ast/FunctionInvocationNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include "parser/ast/LiteralNode.hpp"
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace Theta;
+
+void DeadCodeEliminationPass::optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) {
+  if (ast->getNodeType() == ASTNode::CONTROL_FLOW) {
+    pruneControlFlow(ast);
+  } else if (ast->getNodeType() == ASTNode::BLOCK) {
+    removeUnreachableElements(ast);
+  }
+}
+
+void DeadCodeEliminationPass::hoistNecessary(shared_ptr<ASTNode> &ast) {
+  shared_ptr<ASTNodeList> capsuleBlock = dynamic_pointer_cast<ASTNodeList>(ast->getValue());
+  vector<shared_ptr<ASTNode>> elements = capsuleBlock->getElements();
+
+  // Functions can be overloaded, so one name can stand for several of them
+  map<string, vector<shared_ptr<ASTNode>>> functionsByName;
+  set<string> references = exports;
+  bool hasSpecializations = false;
+
+  for (auto &elem : elements) {
+    bool isFunction = elem->getNodeType() == ASTNode::ASSIGNMENT && elem->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION;
+
+    if (isFunction) {
+      string identifier = dynamic_pointer_cast<IdentifierNode>(elem->getLeft())->getIdentifier();
+      bool isSpecialization = SpecializationPass::isSpecialization(identifier);
+
+      functionsByName[identifier].push_back(elem);
+      hasSpecializations = hasSpecializations || isSpecialization;
+
+      // Without a list of exports, every function the user wrote gets exported
+      if (exports.empty() && !isSpecialization) references.insert(identifier);
+    } else {
+      collectReferences(elem->getNodeType() == ASTNode::ASSIGNMENT ? elem->getRight() : elem, references);
+    }
+  }
+
+  if (exports.empty() && !hasSpecializations) return;
+
+  set<string> visited;
+  vector<string> toVisit(references.begin(), references.end());
+
+  while (!toVisit.empty()) {
+    string name = toVisit.back();
+    toVisit.pop_back();
+
+    if (!visited.insert(name).second) continue;
+
+    auto it = functionsByName.find(name);
+    if (it == functionsByName.end()) continue;
+
+    for (auto &function : it->second) {
+      set<string> functionReferences;
+      collectReferences(function->getRight(), functionReferences);
+
+      toVisit.insert(toVisit.end(), functionReferences.begin(), functionReferences.end());
+    }
+  }
+
+  vector<shared_ptr<ASTNode>> reachableElements;
+
+  for (auto &elem : elements) {
+    bool isFunction = elem->getNodeType() == ASTNode::ASSIGNMENT && elem->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION;
+
+    if (isFunction && visited.find(dynamic_pointer_cast<IdentifierNode>(elem->getLeft())->getIdentifier()) == visited.end()) {
+      changed = true;
+      continue;
+    }
+
+    reachableElements.push_back(elem);
+  }
+
+  capsuleBlock->setElements(reachableElements);
+}
+
+void DeadCodeEliminationPass::pruneControlFlow(shared_ptr<ASTNode> &ast) {
+  shared_ptr<ControlFlowNode> cFlowNode = dynamic_pointer_cast<ControlFlowNode>(ast);
+  vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> pairs = cFlowNode->getConditionExpressionPairs();
+  vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> takeablePairs;
+  bool isPruned = false;
+
+  for (auto &conditionExpressionPair : pairs) {
+    shared_ptr<ASTNode> condition = conditionExpressionPair.first;
+
+    if (condition && isBooleanLiteral(condition, false)) {
+      isPruned = true;
+      continue;
+    }
+
+    // A branch that is always taken works like an else, and none of the branches after it can be reached
+    if (!condition || isBooleanLiteral(condition, true)) {
+      takeablePairs.push_back(make_pair(nullptr, conditionExpressionPair.second));
+
+      if (condition != nullptr || &conditionExpressionPair != &pairs.back()) isPruned = true;
+
+      break;
+    }
+
+    takeablePairs.push_back(conditionExpressionPair);
+  }
+
+  if (!isPruned) return;
+
+  shared_ptr<ASTNode> parent = ast->getParent();
+
+  if (takeablePairs.empty()) {
+    // An if that does nothing can only be dropped from the middle of a block, anywhere else its value is still used
+    if (
+      !parent ||
+      parent->getNodeType() != ASTNode::BLOCK ||
+      dynamic_pointer_cast<ASTNodeList>(parent)->getElements().back()->getId() == ast->getId()
+    ) return;
+
+    ast = nullptr;
+  } else if (takeablePairs.front().first == nullptr) {
+    ast = takeablePairs.front().second;
+    ast->setParent(parent);
+  } else {
+    cFlowNode->setConditionExpressionPairs(takeablePairs);
+  }
+
+  changed = true;
+}
+
+void DeadCodeEliminationPass::removeUnreachableElements(shared_ptr<ASTNode> ast) {
+  shared_ptr<ASTNodeList> block = dynamic_pointer_cast<ASTNodeList>(ast);
+  vector<shared_ptr<ASTNode>> elements = block->getElements();
+
+  for (int i = 0; i + 1 < elements.size(); i++) {
+    if (!alwaysReturns(elements.at(i))) continue;
+
+    elements.erase(elements.begin() + i + 1, elements.end());
+    block->setElements(elements);
+    changed = true;
+
+    return;
+  }
+}
+
+bool DeadCodeEliminationPass::alwaysReturns(shared_ptr<ASTNode> ast) {
+  if (ast->getNodeType() == ASTNode::RETURN) return true;
+
+  if (ast->getNodeType() == ASTNode::BLOCK) {
+    for (auto &elem : dynamic_pointer_cast<ASTNodeList>(ast)->getElements()) {
+      if (alwaysReturns(elem)) return true;
+    }
+
+    return false;
+  }
+
+  if (ast->getNodeType() == ASTNode::CONTROL_FLOW) {
+    vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> pairs = dynamic_pointer_cast<ControlFlowNode>(ast)->getConditionExpressionPairs();
+
+    // Without an else, none of the branches might be taken
+    if (pairs.empty() || pairs.back().first != nullptr) return false;
+
+    for (auto &conditionExpressionPair : pairs) {
+      if (!alwaysReturns(conditionExpressionPair.second)) return false;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+bool DeadCodeEliminationPass::isBooleanLiteral(shared_ptr<ASTNode> ast, bool value) {
+  if (ast->getNodeType() != ASTNode::BOOLEAN_LITERAL) return false;
+
+  return dynamic_pointer_cast<LiteralNode>(ast)->getLiteralValue() == (value ? Lexemes::TRUE : Lexemes::FALSE);
+}
+
+void DeadCodeEliminationPass::collectReferences(shared_ptr<ASTNode> ast, set<string> &references) {
+  if (!ast) return;
+
+  if (ast->getNodeType() == ASTNode::IDENTIFIER) {
+    references.insert(dynamic_pointer_cast<IdentifierNode>(ast)->getIdentifier());
+  }
+
+  // A node can fill more than one of these, and missing a reference would drop a function that is still called
+  collectReferences(ast->getValue(), references);
+  collectReferences(ast->getLeft(), references);
+  collectReferences(ast->getRight(), references);
+
+  if (ast->hasMany()) {
+    for (auto &elem : dynamic_pointer_cast<ASTNodeList>(ast)->getElements()) collectReferences(elem, references);
+  }
+
+  if (ast->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
+    collectReferences(dynamic_pointer_cast<FunctionDeclarationNode>(ast)->getDefinition(), references);
+  } else if (ast->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
+    shared_ptr<FunctionInvocationNode> funcInvNode = dynamic_pointer_cast<FunctionInvocationNode>(ast);
+
+    collectReferences(funcInvNode->getIdentifier(), references);
+    collectReferences(funcInvNode->getParameters(), references);
+  } else if (ast->getNodeType() == ASTNode::CONTROL_FLOW) {
+    for (auto &conditionExpressionPair : dynamic_pointer_cast<ControlFlowNode>(ast)->getConditionExpressionPairs()) {
+      collectReferences(conditionExpressionPair.first, references);
+      collectReferences(conditionExpressionPair.second, references);
+    }
+  }
+}
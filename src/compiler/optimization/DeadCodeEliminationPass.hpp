@@ -0,0 +1,82 @@
+#pragma once
+
+#include "OptimizationPass.hpp"
+#include "parser/ast/ASTNode.hpp"
+#include <memory>
+#include <set>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief An optimization pass that removes code which can never run: branches of an if whose conditions are constant,
+ * expressions in a block after it has returned, and capsule functions that none of the module's exports can reach,
+ * including specializations nothing calls anymore.
+ *
+ * Like inlining, this pass runs after type checking, so that dead code still gets type checked and its errors
+ * reported. The nodes it keeps are left exactly as the type checker resolved them.
+ */
+namespace Theta {
+  class DeadCodeEliminationPass : public OptimizationPass {
+  public:
+    /**
+     * @param exportedFunctions The names of the capsule functions the module should export. If empty, every capsule
+     * function the user wrote is exported, so only specializations can be removed.
+     */
+    DeadCodeEliminationPass(set<string> exportedFunctions = {}) : exports(exportedFunctions) {}
+
+    string getName() override { return "DeadCodeElimination"; }
+
+    set<ASTNode::Types> getInterests() override { return { ASTNode::CONTROL_FLOW, ASTNode::BLOCK }; }
+
+    // Seeing the calls that are left once inlining is done lets the functions inlined away be removed in the same round
+    vector<string> getDependencies() override { return { "Inlining" }; }
+
+  private:
+    set<string> exports;
+
+    void optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) override;
+
+    /**
+     * @brief Removes the capsule functions that aren't reachable from the exports, before the rest of the capsule is
+     * traversed. Capsule variables are always kept, so anything they reference is reachable too.
+     *
+     * @param ast Reference to the shared pointer of the capsule node.
+     */
+    void hoistNecessary(shared_ptr<ASTNode> &ast) override;
+
+    /**
+     * @brief Drops the branches of an if that can never be taken. If the first branch left is always taken, the
+     * whole if is replaced by that branch's expression, and if no branch is left at all, the if is removed.
+     *
+     * @param ast Reference to the shared pointer of the control flow node.
+     */
+    void pruneControlFlow(shared_ptr<ASTNode> &ast);
+
+    /**
+     * @brief Drops the elements of a block that come after an element which always returns.
+     *
+     * @param ast The block node.
+     */
+    void removeUnreachableElements(shared_ptr<ASTNode> ast);
+
+    /**
+     * @brief Checks whether evaluating a node always returns from the function it is in, such as a return, or an if
+     * with an else whose branches all return.
+     */
+    static bool alwaysReturns(shared_ptr<ASTNode> ast);
+
+    /**
+     * @brief Checks whether a node is the boolean literal `value`.
+     */
+    static bool isBooleanLiteral(shared_ptr<ASTNode> ast, bool value);
+
+    /**
+     * @brief Collects the name of every identifier referenced anywhere inside a node, including the functions it calls.
+     *
+     * @param ast The node to search.
+     * @param references Where to add the names.
+     */
+    static void collectReferences(shared_ptr<ASTNode> ast, set<string> &references);
+  };
+}
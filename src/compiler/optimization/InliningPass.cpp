@@ -0,0 +1,305 @@
+#include "InliningPass.hpp"
+#include "compiler/Compiler.hpp"
+#include "compiler/DataTypes.hpp"
+#include "compiler/TypeChecker.hpp"
+#include "parser/ast/ASTNodeList.hpp"
+#include "parser/ast/BinaryOperationNode.hpp"
+#include "parser/ast/BlockNode.hpp"
+#include "parser/ast/ControlFlowNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include "parser/ast/LiteralNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+#include "parser/ast/UnaryOperationNode.hpp"
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace Theta;
+
+namespace {
+  // Identifiers that declare something, rather than reference it, carry the declared type
+  bool isDeclaration(shared_ptr<ASTNode> ast) {
+    return ast->getNodeType() == ASTNode::IDENTIFIER && ast->getValue() && ast->getValue()->getNodeType() == ASTNode::TYPE_DECLARATION;
+  }
+
+  // The qualified identifier of the function a call resolved to, or an empty string if the call wasn't type checked
+  string getCalledFunction(shared_ptr<FunctionInvocationNode> funcInvNode) {
+    if (funcInvNode->getIdentifier()->getNodeType() != ASTNode::IDENTIFIER) return "";
+
+    for (auto &arg : funcInvNode->getParameters()->getElements()) {
+      if (!arg->getResolvedType()) return "";
+    }
+
+    string identifier = dynamic_pointer_cast<IdentifierNode>(funcInvNode->getIdentifier())->getIdentifier();
+
+    return Compiler::getQualifiedFunctionIdentifier(identifier, funcInvNode);
+  }
+}
+
+void InliningPass::optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) {
+  if (ast->getNodeType() != ASTNode::FUNCTION_INVOCATION || inlinableFunctions.empty()) return;
+
+  shared_ptr<FunctionInvocationNode> funcInvNode = dynamic_pointer_cast<FunctionInvocationNode>(ast);
+
+  auto it = inlinableFunctions.find(getCalledFunction(funcInvNode));
+  if (it == inlinableFunctions.end() || !canInline(funcInvNode, it->second)) return;
+
+  shared_ptr<FunctionDeclarationNode> function = it->second;
+  vector<shared_ptr<ASTNode>> params = function->getParameters()->getElements();
+  vector<shared_ptr<ASTNode>> args = funcInvNode->getParameters()->getElements();
+  map<string, shared_ptr<ASTNode>> arguments;
+
+  for (int i = 0; i < params.size(); i++) {
+    arguments.insert(make_pair(dynamic_pointer_cast<IdentifierNode>(params.at(i))->getIdentifier(), args.at(i)));
+  }
+
+  shared_ptr<ASTNode> body = dynamic_pointer_cast<ASTNodeList>(function->getDefinition())->getElements().front();
+
+  ast = copyExpression(body, ast->getParent(), arguments);
+  changed = true;
+}
+
+void InliningPass::hoistNecessary(shared_ptr<ASTNode> &ast) {
+  inlinableFunctions.clear();
+
+  vector<shared_ptr<ASTNode>> capsuleElements = dynamic_pointer_cast<ASTNodeList>(ast->getValue())->getElements();
+  map<string, shared_ptr<FunctionDeclarationNode>> functions;
+  map<string, set<string>> callsByFunction;
+
+  for (auto &elem : capsuleElements) {
+    if (elem->getNodeType() != ASTNode::ASSIGNMENT || elem->getRight()->getNodeType() != ASTNode::FUNCTION_DECLARATION) continue;
+
+    string identifier = dynamic_pointer_cast<IdentifierNode>(elem->getLeft())->getIdentifier();
+    shared_ptr<FunctionDeclarationNode> function = dynamic_pointer_cast<FunctionDeclarationNode>(elem->getRight());
+    string qualifiedIdentifier = Compiler::getQualifiedFunctionIdentifier(identifier, function);
+
+    functions.insert(make_pair(qualifiedIdentifier, function));
+    collectCalls(function->getDefinition(), callsByFunction[qualifiedIdentifier]);
+  }
+
+  for (auto &[qualifiedIdentifier, function] : functions) {
+    vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(function->getDefinition())->getElements();
+
+    if (body.size() != 1 || !function->getResolvedType()) continue;
+
+    // Inlined calls wouldn't go through the function's memo table
+    if (function->getIsMemoized()) continue;
+
+    int cost = getInlineCost(body.front());
+    if (cost < 0 || cost > MAX_INLINE_COST) continue;
+
+    // Functions passed in or handed back would need a closure anyway
+    bool isHigherOrder = TypeChecker::getFunctionReturnType(function)->getType() == DataTypes::FUNCTION;
+    for (auto &param : function->getParameters()->getElements()) {
+      isHigherOrder = isHigherOrder || dynamic_pointer_cast<TypeDeclarationNode>(param->getValue())->getType() == DataTypes::FUNCTION;
+    }
+
+    if (isHigherOrder) continue;
+
+    // Recursion guard: a function that can reach itself would be inlined into itself forever
+    set<string> visited;
+    vector<string> toVisit(callsByFunction[qualifiedIdentifier].begin(), callsByFunction[qualifiedIdentifier].end());
+    bool isRecursive = false;
+
+    while (!toVisit.empty() && !isRecursive) {
+      string callee = toVisit.back();
+      toVisit.pop_back();
+
+      if (callee == qualifiedIdentifier) isRecursive = true;
+      if (!visited.insert(callee).second) continue;
+
+      auto calls = callsByFunction.find(callee);
+      if (calls != callsByFunction.end()) toVisit.insert(toVisit.end(), calls->second.begin(), calls->second.end());
+    }
+
+    if (!isRecursive) inlinableFunctions.insert(make_pair(qualifiedIdentifier, function));
+  }
+}
+
+bool InliningPass::canInline(shared_ptr<FunctionInvocationNode> funcInvNode, shared_ptr<FunctionDeclarationNode> function) {
+  // Everything declared in the outermost function the call is in, since closures see their parents' scope, or in the
+  // whole program if it isn't in a function
+  shared_ptr<ASTNode> caller = funcInvNode->getParent();
+  shared_ptr<ASTNode> outermostFunction;
+
+  while (caller && caller->getParent()) {
+    if (caller->getNodeType() == ASTNode::FUNCTION_DECLARATION) outermostFunction = caller;
+    caller = caller->getParent();
+  }
+
+  if (outermostFunction) caller = outermostFunction;
+  if (!caller) return false;
+
+  set<string> callerDeclarations;
+  collectDeclarations(caller, callerDeclarations);
+
+  // The call might be to a local closure that shadows the capsule function
+  if (callerDeclarations.count(dynamic_pointer_cast<IdentifierNode>(funcInvNode->getIdentifier())->getIdentifier())) return false;
+
+  shared_ptr<ASTNode> body = dynamic_pointer_cast<ASTNodeList>(function->getDefinition())->getElements().front();
+  map<string, int> bodyReferences;
+  countReferences(body, bodyReferences);
+
+  vector<shared_ptr<ASTNode>> params = function->getParameters()->getElements();
+  vector<shared_ptr<ASTNode>> args = funcInvNode->getParameters()->getElements();
+  set<string> paramNames;
+
+  for (int i = 0; i < params.size(); i++) {
+    string paramName = dynamic_pointer_cast<IdentifierNode>(params.at(i))->getIdentifier();
+    paramNames.insert(paramName);
+
+    // An argument that does any work mustn't end up evaluated more often than it would be for the call
+    if (!isTrivialArgument(args.at(i)) && bodyReferences[paramName] > 1) return false;
+  }
+
+  // Anything else the body references lives in the capsule, and mustn't be shadowed where the body ends up
+  for (auto &[identifier, count] : bodyReferences) {
+    if (!paramNames.count(identifier) && callerDeclarations.count(identifier)) return false;
+  }
+
+  return true;
+}
+
+int InliningPass::getInlineCost(shared_ptr<ASTNode> ast) {
+  switch (ast->getNodeType()) {
+    case ASTNode::NUMBER_LITERAL:
+    case ASTNode::STRING_LITERAL:
+    case ASTNode::BOOLEAN_LITERAL:
+    case ASTNode::IDENTIFIER:
+    case ASTNode::BINARY_OPERATION:
+    case ASTNode::UNARY_OPERATION:
+    case ASTNode::FUNCTION_INVOCATION:
+    case ASTNode::CONTROL_FLOW:
+    case ASTNode::BLOCK:
+    case ASTNode::AST_NODE_LIST:
+      break;
+    default:
+      return -1;
+  }
+
+  int cost = ast->getNodeType() == ASTNode::AST_NODE_LIST ? 0 : 1;
+
+  forEachChild(ast, [&cost](shared_ptr<ASTNode> child) {
+    if (cost < 0 || isDeclaration(child)) return;
+
+    int childCost = getInlineCost(child);
+    cost = childCost < 0 ? -1 : cost + childCost;
+  });
+
+  return cost;
+}
+
+shared_ptr<ASTNode> InliningPass::copyExpression(
+  shared_ptr<ASTNode> ast,
+  shared_ptr<ASTNode> parent,
+  const map<string, shared_ptr<ASTNode>> &arguments
+) {
+  shared_ptr<ASTNode> copy;
+
+  if (ast->getNodeType() == ASTNode::IDENTIFIER) {
+    string identifier = dynamic_pointer_cast<IdentifierNode>(ast)->getIdentifier();
+    auto argument = arguments.find(identifier);
+
+    if (argument == arguments.end()) {
+      copy = make_shared<IdentifierNode>(identifier, parent);
+    } else if (isTrivialArgument(argument->second)) {
+      return copyExpression(argument->second, parent, {});
+    } else {
+      // Referenced at most once, so the argument itself can be moved into the body
+      argument->second->setParent(parent);
+      return argument->second;
+    }
+  } else if (
+    ast->getNodeType() == ASTNode::NUMBER_LITERAL ||
+    ast->getNodeType() == ASTNode::STRING_LITERAL ||
+    ast->getNodeType() == ASTNode::BOOLEAN_LITERAL
+  ) {
+    copy = make_shared<LiteralNode>(ast->getNodeType(), dynamic_pointer_cast<LiteralNode>(ast)->getLiteralValue(), parent);
+  } else if (ast->getNodeType() == ASTNode::BINARY_OPERATION) {
+    copy = make_shared<BinaryOperationNode>(dynamic_pointer_cast<BinaryOperationNode>(ast)->getOperator(), parent);
+    copy->setLeft(copyExpression(ast->getLeft(), copy, arguments));
+    copy->setRight(copyExpression(ast->getRight(), copy, arguments));
+  } else if (ast->getNodeType() == ASTNode::UNARY_OPERATION) {
+    copy = make_shared<UnaryOperationNode>(dynamic_pointer_cast<UnaryOperationNode>(ast)->getOperator(), parent);
+    copy->setValue(copyExpression(ast->getValue(), copy, arguments));
+  } else if (ast->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
+    shared_ptr<FunctionInvocationNode> funcInvNode = dynamic_pointer_cast<FunctionInvocationNode>(ast);
+    shared_ptr<FunctionInvocationNode> funcInvCopy = make_shared<FunctionInvocationNode>(parent);
+    shared_ptr<ASTNodeList> argsCopy = make_shared<ASTNodeList>(funcInvCopy);
+    vector<shared_ptr<ASTNode>> args;
+
+    for (auto &arg : funcInvNode->getParameters()->getElements()) args.push_back(copyExpression(arg, argsCopy, arguments));
+    argsCopy->setElements(args);
+
+    // Functions can't be parameters of inlined functions, so the function called is never substituted
+    funcInvCopy->setIdentifier(copyExpression(funcInvNode->getIdentifier(), funcInvCopy, {}));
+    funcInvCopy->setParameters(argsCopy);
+
+    copy = funcInvCopy;
+  } else if (ast->getNodeType() == ASTNode::CONTROL_FLOW) {
+    shared_ptr<ControlFlowNode> cFlowCopy = make_shared<ControlFlowNode>(parent);
+    vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> pairs;
+
+    for (auto &conditionExpressionPair : dynamic_pointer_cast<ControlFlowNode>(ast)->getConditionExpressionPairs()) {
+      shared_ptr<ASTNode> condition = conditionExpressionPair.first;
+
+      pairs.push_back(make_pair(
+        condition ? copyExpression(condition, cFlowCopy, arguments) : nullptr,
+        copyExpression(conditionExpressionPair.second, cFlowCopy, arguments)
+      ));
+    }
+
+    cFlowCopy->setConditionExpressionPairs(pairs);
+
+    copy = cFlowCopy;
+  } else if (ast->getNodeType() == ASTNode::BLOCK) {
+    shared_ptr<BlockNode> blockCopy = make_shared<BlockNode>(parent);
+    vector<shared_ptr<ASTNode>> elements;
+
+    for (auto &elem : dynamic_pointer_cast<ASTNodeList>(ast)->getElements()) elements.push_back(copyExpression(elem, blockCopy, arguments));
+    blockCopy->setElements(elements);
+
+    copy = blockCopy;
+  }
+
+  copy->setResolvedType(ast->getResolvedType());
+  copy->setSourceLocation(ast->getLine(), ast->getColumn());
+
+  return copy;
+}
+
+void InliningPass::collectCalls(shared_ptr<ASTNode> ast, set<string> &calls) {
+  if (ast->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
+    string calledFunction = getCalledFunction(dynamic_pointer_cast<FunctionInvocationNode>(ast));
+
+    if (calledFunction != "") calls.insert(calledFunction);
+  }
+
+  forEachChild(ast, [&calls](shared_ptr<ASTNode> child) { collectCalls(child, calls); });
+}
+
+void InliningPass::countReferences(shared_ptr<ASTNode> ast, map<string, int> &references) {
+  if (ast->getNodeType() == ASTNode::IDENTIFIER && !isDeclaration(ast)) {
+    references[dynamic_pointer_cast<IdentifierNode>(ast)->getIdentifier()]++;
+  }
+
+  forEachChild(ast, [&references](shared_ptr<ASTNode> child) { countReferences(child, references); });
+}
+
+void InliningPass::collectDeclarations(shared_ptr<ASTNode> ast, set<string> &declarations) {
+  if (isDeclaration(ast)) {
+    declarations.insert(dynamic_pointer_cast<IdentifierNode>(ast)->getIdentifier());
+    return;
+  }
+
+  forEachChild(ast, [&declarations](shared_ptr<ASTNode> child) { collectDeclarations(child, declarations); });
+}
+
+bool InliningPass::isTrivialArgument(shared_ptr<ASTNode> ast) {
+  return (
+    ast->getNodeType() == ASTNode::NUMBER_LITERAL ||
+    ast->getNodeType() == ASTNode::STRING_LITERAL ||
+    ast->getNodeType() == ASTNode::BOOLEAN_LITERAL ||
+    ast->getNodeType() == ASTNode::IDENTIFIER
+  );
+}
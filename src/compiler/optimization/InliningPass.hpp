@@ -0,0 +1,102 @@
+#pragma once
+
+#include "OptimizationPass.hpp"
+#include "parser/ast/ASTNode.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+#include "parser/ast/FunctionInvocationNode.hpp"
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief An optimization pass that replaces calls to small capsule functions with the function's body, with the
+ * arguments substituted for the parameters. This saves the closure that every call otherwise builds in memory, and the
+ * indirect call through it.
+ *
+ * Only functions whose body is a single expression are inlined, so that inlining never introduces locals or returns
+ * into the caller, and only if the function can't end up calling itself. The expression's cost is the number of nodes
+ * in it, and functions that cost more than MAX_INLINE_COST are left alone. Calls are only inlined where every argument
+ * is supplied, and where an argument that does any work wouldn't end up evaluated more than once.
+ *
+ * Runs after type checking, since telling overloaded functions apart needs the types of the arguments. Inlined nodes
+ * keep the types the type checker resolved for them.
+ */
+namespace Theta {
+  class InliningPass : public OptimizationPass {
+  public:
+    string getName() override { return "Inlining"; }
+
+    set<ASTNode::Types> getInterests() override { return { ASTNode::FUNCTION_INVOCATION }; }
+
+    static const int MAX_INLINE_COST = 16;
+
+    /**
+     * @brief Calculates how expensive an expression is to inline.
+     *
+     * @param ast The expression.
+     * @return The number of nodes in the expression, or -1 if it contains anything that can't be inlined
+     */
+    static int getInlineCost(shared_ptr<ASTNode> ast);
+
+    /**
+     * @brief Copies an expression, replacing the identifiers of parameters with the arguments passed for them.
+     *
+     * @param ast The expression to copy.
+     * @param parent The parent of the copy.
+     * @param arguments The argument to substitute for each parameter, by the parameter's name.
+     * @return The copy
+     */
+    static shared_ptr<ASTNode> copyExpression(
+      shared_ptr<ASTNode> ast,
+      shared_ptr<ASTNode> parent,
+      const map<string, shared_ptr<ASTNode>> &arguments
+    );
+
+    /**
+     * @brief Collects the qualified identifiers of the functions called anywhere inside a node.
+     */
+    static void collectCalls(shared_ptr<ASTNode> ast, set<string> &calls);
+
+    /**
+     * @brief Counts how many times each identifier is referenced anywhere inside a node, including as the function
+     * of a call.
+     */
+    static void countReferences(shared_ptr<ASTNode> ast, map<string, int> &references);
+
+    /**
+     * @brief Collects the names of all the variables and parameters declared anywhere inside a node.
+     */
+    static void collectDeclarations(shared_ptr<ASTNode> ast, set<string> &declarations);
+
+    /**
+     * @brief Whether an argument is cheap enough to be evaluated as many times as its parameter is referenced.
+     */
+    static bool isTrivialArgument(shared_ptr<ASTNode> ast);
+
+  private:
+    // The capsule functions that can be inlined, by their qualified identifier
+    map<string, shared_ptr<FunctionDeclarationNode>> inlinableFunctions;
+
+    void optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) override;
+
+    /**
+     * @brief Finds the capsule functions that can be inlined, before the rest of the capsule is traversed.
+     *
+     * @param ast Reference to the shared pointer of the capsule node.
+     */
+    void hoistNecessary(shared_ptr<ASTNode> &ast) override;
+
+    /**
+     * @brief Checks whether a call can be replaced by the body of the function it calls, without changing what any
+     * identifier in either of them refers to, or how many times an argument gets evaluated.
+     *
+     * @param funcInvNode The call.
+     * @param function The function it calls.
+     * @return true If the call can be inlined
+     */
+    bool canInline(shared_ptr<FunctionInvocationNode> funcInvNode, shared_ptr<FunctionDeclarationNode> function);
+  };
+}
@@ -23,6 +23,7 @@ void LiteralInlinerPass::optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDir
     unpackEnumElementsInScope(ast, localScope);
 
     ast = nullptr;
+    changed = true;
   } else if (ast->getNodeType() == ASTNode::ASSIGNMENT && !isCapsuleDirectChild) {
     bindIdentifierToScope(ast, localScope);
 
@@ -35,6 +36,7 @@ void LiteralInlinerPass::optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDir
       )
     ) {
       ast = nullptr;
+      changed = true;
     }
   }
 }
@@ -65,7 +67,8 @@ void LiteralInlinerPass::substituteIdentifiers(shared_ptr<ASTNode> &ast) {
 
   shared_ptr<LiteralNode> literal = dynamic_pointer_cast<LiteralNode>(foundIdentifier.value());
 
-  ast = make_shared<LiteralNode>(literal->getNodeType(), literal->getLiteralValue(), ast);
+  ast = make_shared<LiteralNode>(literal->getNodeType(), literal->getLiteralValue(), ast->getParent());
+  changed = true;
 }
 
 // When we have a variable assigned to a literal, we can safely just add that to the scope
@@ -74,16 +77,16 @@ void LiteralInlinerPass::bindIdentifierToScope(shared_ptr<ASTNode> &ast, SymbolT
   string identifier = dynamic_pointer_cast<IdentifierNode>(ast->getLeft())->getIdentifier();
 
   if (ast->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
-    string uniqueFuncIdentifier = Compiler::getQualifiedFunctionIdentifier(identifier, ast->getRight());
+    int uniqueFuncId = Compiler::getQualifiedFunctionId(identifier, ast->getRight());
 
-    auto existingFuncIdentifierInScope = scope.lookup(uniqueFuncIdentifier);
+    auto existingFuncIdentifierInScope = scope.lookup(uniqueFuncId);
 
     if (existingFuncIdentifierInScope.has_value()) {
       Compiler::getInstance().addException(make_shared<IllegalReassignmentError>(identifier));
       return;
     }
 
-    scope.insert(uniqueFuncIdentifier, ast->getRight());
+    scope.insert(uniqueFuncId, ast->getRight());
   } else {
     auto foundIdentInScope = scope.lookup(identifier);
 
@@ -124,6 +127,8 @@ void LiteralInlinerPass::hoistNecessary(shared_ptr<ASTNode> &ast) {
 
   // Set the modified vector back
   nodeList->setElements(topLevelElements);
+
+  if (!removeAtIndices.empty()) changed = true;
 }
 
 void LiteralInlinerPass::unpackEnumElementsInScope(shared_ptr<ASTNode> node, SymbolTableStack<shared_ptr<ASTNode>> &scope) {
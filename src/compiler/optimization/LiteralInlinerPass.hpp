@@ -17,6 +17,13 @@ using namespace std;
  */
 namespace Theta {
   class LiteralInlinerPass : public OptimizationPass {
+  public:
+    string getName() override { return "LiteralInliner"; }
+
+    set<ASTNode::Types> getInterests() override {
+      return { ASTNode::ASSIGNMENT, ASTNode::ENUM, ASTNode::IDENTIFIER, ASTNode::TYPE_DECLARATION };
+    }
+
   private:
     /**
      * @brief Processes different types of nodes such as identifiers, enums, and assignments,
@@ -1,41 +1,65 @@
 #pragma once
 
 #include "parser/ast/ASTNode.hpp"
+#include "parser/ast/ASTVisitor.hpp"
 #include "compiler/SymbolTableStack.hpp"
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
 
 /**
  * @brief Abstract base class for optimization passes in the Theta compiler.
  *
- * Provides mechanisms for walking through an Abstract Syntax Tree (AST) and applying transformations
- * or optimizations to AST nodes.
+ * Passes rewrite the AST one node at a time, in optimizeAST, and can analyse the whole capsule up front in
+ * hoistNecessary. They are run by a PassManager, which walks the AST for them, so that passes that don't depend on each
+ * other can share a single traversal.
  */
 namespace Theta {
+  class PassManager;
+
   class OptimizationPass {
   public:
-    /**
-     * @brief Initiates the optimization process on an AST node.
-     *
-     * This function orchestrates the optimization of a given AST node and its children,
-     * ensuring scope rules are followed and necessary hoisting is performed. It serves as the
-     * entry point for the recursive optimization process.
-     *
-     * @param ast Reference to the shared pointer of the root AST node to be optimized.
-     * @param isCapsuleDirectChild Is this ast node the direct child of the capsule node?
-     */
-    void optimize(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild = false);
-
     /**
      * @brief Cleans up and resets scope variables for the pass. Should always be called after the optimization pass finishes
      */
     void cleanup() {
         localScope = SymbolTableStack<shared_ptr<ASTNode>>();
         hoistedScope = SymbolTableStack<shared_ptr<ASTNode>>();
+        changed = false;
     }
 
+    /**
+     * @brief Whether the last run of the pass changed the AST. Passes can enable each other, so the pass manager keeps
+     * rerunning them until none of them do. Must be checked before cleanup() is called
+     */
+    bool hasChanged() { return changed; }
+
+    /**
+     * @brief The name the pass is reported under, such as in `theta --time-passes`
+     */
+    virtual string getName() = 0;
+
+    /**
+     * @brief The types of node optimizeAST does anything with. The pass manager only calls it on nodes of these types,
+     * and skips walking into type declarations if no pass it is running wants them.
+     */
+    virtual set<ASTNode::Types> getInterests() = 0;
+
+    /**
+     * @brief The names of the passes that have to finish with the whole AST before this one starts, because this
+     * pass's hoistNecessary needs to see what they leave behind. Passes with no dependency between them run fused, in the
+     * same traversal.
+     */
+    virtual vector<string> getDependencies() { return {}; }
+
   protected:
     SymbolTableStack<shared_ptr<ASTNode>> localScope;
     SymbolTableStack<shared_ptr<ASTNode>> hoistedScope;
 
+    // Set by derived classes whenever they rewrite or remove a node
+    bool changed = false;
+
     /**
      * @brief Retrieves an AST node based on an identifier from the available scopes.
      *
@@ -46,7 +70,16 @@ namespace Theta {
      */
     shared_ptr<ASTNode> lookupInScope(string identifier);
 
+    /**
+     * @brief Calls visit on each direct child of a node, including the parameters and definitions of functions, the
+     * function and arguments of calls, and the conditions and expressions of control flow.
+     */
+    template<typename Callback>
+    static void forEachChild(shared_ptr<ASTNode> ast, Callback &&visit) { Theta::forEachChild(ast, visit); }
+
   private:
+    friend class PassManager;
+
     /**
      * @brief Pure virtual function to be implemented by derived classes for performing specific optimizations on the AST.
      *
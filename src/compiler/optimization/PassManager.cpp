@@ -0,0 +1,297 @@
+#include "PassManager.hpp"
+#include "compiler/Compiler.hpp"
+#include "parser/ast/ASTNodeList.hpp"
+#include "parser/ast/ControlFlowNode.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+#include "parser/ast/FunctionInvocationNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include <chrono>
+#include <memory>
+#include <utility>
+
+using namespace Theta;
+
+PassManager::PassManager(vector<shared_ptr<OptimizationPass>> passList) {
+  set<string> names;
+  for (auto &pass : passList) names.insert(pass->getName());
+
+  // Passes keep the order they were given in, except that none goes before a pass it depends on
+  vector<bool> isPlaced(passList.size(), false);
+  set<string> placedNames;
+
+  while (passes.size() < passList.size()) {
+    int next = -1;
+
+    for (int i = 0; i < passList.size() && next < 0; i++) {
+      if (isPlaced[i]) continue;
+
+      bool isReady = true;
+      for (auto &dependency : passList[i]->getDependencies()) {
+        isReady = isReady && (!names.count(dependency) || placedNames.count(dependency));
+      }
+
+      if (isReady) next = i;
+    }
+
+    // Passes that depend on each other can't both go first, so the first of them does
+    for (int i = 0; i < passList.size() && next < 0; i++) {
+      if (!isPlaced[i]) next = i;
+    }
+
+    isPlaced[next] = true;
+    placedNames.insert(passList[next]->getName());
+    passes.push_back(passList[next]);
+  }
+
+  for (int i = 0; i < passes.size(); i++) {
+    vector<string> dependencies = passes[i]->getDependencies();
+    bool dependsOnStage = stages.empty();
+
+    for (int j = 0; !dependsOnStage && j < stages.back().passes.size(); j++) {
+      string name = passes[stages.back().passes[j]]->getName();
+
+      for (auto &dependency : dependencies) dependsOnStage = dependsOnStage || dependency == name;
+    }
+
+    if (dependsOnStage) stages.push_back(Stage());
+
+    interests.push_back(passes[i]->getInterests());
+
+    stages.back().passes.push_back(i);
+    stages.back().isInterestedInTypeDeclarations = (
+      stages.back().isInterestedInTypeDeclarations ||
+      interests[i].count(ASTNode::TYPE_DECLARATION)
+    );
+  }
+}
+
+bool PassManager::run(shared_ptr<ASTNode> &ast, PhaseTimer *timer, string phaseSuffix) {
+  phaseTimer = timer;
+  statistics.assign(passes.size(), PassStatistics());
+
+  isCapsuleChanged = false;
+  changedElements.clear();
+  changedNames.clear();
+
+  bool isValid = true;
+
+  for (int round = 0; round < MAX_ROUNDS && isValid; round++) {
+    isFirstRound = round == 0;
+    nextIsCapsuleChanged = false;
+    nextChangedElements.clear();
+    nextChangedNames.clear();
+
+    bool isRoundChanged = false;
+
+    for (int i = 0; i < stages.size() && isValid; i++) {
+      traverse(ast, stages[i]);
+
+      for (int pass : stages[i].passes) {
+        isRoundChanged = isRoundChanged || passes[pass]->hasChanged();
+        passes[pass]->cleanup();
+      }
+
+      isValid = Compiler::getInstance().getEncounteredExceptions().empty();
+    }
+
+    if (!isRoundChanged) break;
+
+    isCapsuleChanged = nextIsCapsuleChanged;
+    changedElements = std::move(nextChangedElements);
+    changedNames = std::move(nextChangedNames);
+  }
+
+  if (phaseTimer) {
+    for (int i = 0; i < passes.size(); i++) {
+      string name = passes[i]->getName() + (phaseSuffix != "" ? " " + phaseSuffix : "");
+
+      phaseTimer->record(name, statistics[i].wallMs, statistics[i].cpuMs, statistics[i].changes);
+    }
+  }
+
+  phaseTimer = nullptr;
+
+  return isValid;
+}
+
+vector<vector<shared_ptr<OptimizationPass>>> PassManager::getStages() {
+  vector<vector<shared_ptr<OptimizationPass>>> stagePasses;
+
+  for (auto &stage : stages) {
+    stagePasses.push_back({});
+
+    for (int pass : stage.passes) stagePasses.back().push_back(passes[pass]);
+  }
+
+  return stagePasses;
+}
+
+void PassManager::traverse(shared_ptr<ASTNode> &ast, const Stage &stage, bool isCapsuleDirectChild) {
+  // Type declarations only ever contain other type declarations
+  if (ast->getNodeType() == ASTNode::TYPE_DECLARATION && !stage.isInterestedInTypeDeclarations) return;
+
+  bool hasOwnScope = ast->hasOwnScope();
+  if (hasOwnScope) {
+    for (int pass : stage.passes) passes[pass]->localScope.enterScope();
+  }
+
+  if (ast->getNodeType() == ASTNode::CAPSULE) {
+    traverseCapsule(ast, stage);
+  } else if (ast->getValue()) {
+    traverse(ast->getValue(), stage);
+  } else if (ast->getLeft()) {
+    traverse(ast->getLeft(), stage);
+    traverse(ast->getRight(), stage);
+  } else if (ast->hasMany()) {
+    shared_ptr<ASTNodeList> nodeList = dynamic_pointer_cast<ASTNodeList>(ast);
+    vector<shared_ptr<ASTNode>> elements = nodeList->getElements();
+    vector<shared_ptr<ASTNode>> newElements;
+
+    for (int i = 0; i < elements.size(); i++) {
+      traverse(elements.at(i), stage);
+
+      if (elements.at(i) != nullptr) newElements.push_back(elements.at(i));
+    }
+
+    nodeList->setElements(newElements);
+  } else if (ast->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
+    shared_ptr<FunctionDeclarationNode> funcDecNode = dynamic_pointer_cast<FunctionDeclarationNode>(ast);
+
+    shared_ptr<ASTNode> params = dynamic_pointer_cast<ASTNode>(funcDecNode->getParameters());
+    traverse(params, stage);
+
+    traverse(funcDecNode->getDefinition(), stage);
+  } else if (ast->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
+    shared_ptr<FunctionInvocationNode> funcInvNode = dynamic_pointer_cast<FunctionInvocationNode>(ast);
+
+    shared_ptr<ASTNode> args = dynamic_pointer_cast<ASTNode>(funcInvNode->getParameters());
+    traverse(args, stage);
+  } else if (ast->getNodeType() == ASTNode::CONTROL_FLOW) {
+    shared_ptr<ControlFlowNode> cFlowNode = dynamic_pointer_cast<ControlFlowNode>(ast);
+    vector<pair<shared_ptr<ASTNode>, shared_ptr<ASTNode>>> newPairs;
+
+    for (auto conditionExpressionPair : cFlowNode->getConditionExpressionPairs()) {
+      shared_ptr<ASTNode> condition = conditionExpressionPair.first;
+      shared_ptr<ASTNode> expression = conditionExpressionPair.second;
+
+      if (condition) traverse(condition, stage);
+      traverse(expression, stage);
+
+      newPairs.push_back(make_pair(condition, expression));
+    }
+
+    cFlowNode->setConditionExpressionPairs(newPairs);
+  }
+
+  if (hasOwnScope) {
+    for (int pass : stage.passes) passes[pass]->localScope.exitScope();
+  }
+
+  // The capsule itself has nothing to rewrite, its elements were already visited as direct children
+  if (ast->getNodeType() != ASTNode::CAPSULE) visit(ast, stage, isCapsuleDirectChild);
+}
+
+void PassManager::traverseCapsule(shared_ptr<ASTNode> &ast, const Stage &stage) {
+  for (int pass : stage.passes) {
+    if (runPass(pass, [this, &ast, pass]() { passes[pass]->hoistNecessary(ast); })) {
+      isCapsuleChanged = true;
+      nextIsCapsuleChanged = true;
+    }
+  }
+
+  shared_ptr<ASTNodeList> capsuleBlock = dynamic_pointer_cast<ASTNodeList>(ast->getValue());
+  vector<shared_ptr<ASTNode>> elements = capsuleBlock->getElements();
+  vector<shared_ptr<ASTNode>> newElements;
+
+  for (int i = 0; i < elements.size(); i++) {
+    if (isDirty(elements.at(i))) {
+      string name = getDeclaredName(elements.at(i));
+
+      isNodeChanged = false;
+      traverse(elements.at(i), stage, true);
+
+      if (isNodeChanged) markChanged(elements.at(i), name);
+    }
+
+    if (elements.at(i) != nullptr) newElements.push_back(elements.at(i));
+  }
+
+  capsuleBlock->setElements(newElements);
+}
+
+void PassManager::visit(shared_ptr<ASTNode> &ast, const Stage &stage, bool isCapsuleDirectChild) {
+  for (int pass : stage.passes) {
+    // An earlier pass may have replaced the node with one of another type, or removed it
+    if (!ast) return;
+    if (!interests[pass].count(ast->getNodeType())) continue;
+
+    if (runPass(pass, [this, &ast, pass, isCapsuleDirectChild]() { passes[pass]->optimizeAST(ast, isCapsuleDirectChild); })) {
+      isNodeChanged = true;
+    }
+  }
+}
+
+bool PassManager::runPass(int pass, const std::function<void()> &work) {
+  OptimizationPass &optimizationPass = *passes[pass];
+
+  // Passes only ever set changed, so it is cleared to see whether this run of it is what set it
+  bool wasChanged = optimizationPass.changed;
+  optimizationPass.changed = false;
+
+  if (phaseTimer) {
+    chrono::steady_clock::time_point wallStart = chrono::steady_clock::now();
+    double cpuStart = PhaseTimer::threadCPUTime();
+
+    work();
+
+    statistics[pass].cpuMs += PhaseTimer::threadCPUTime() - cpuStart;
+    statistics[pass].wallMs += chrono::duration<double, milli>(chrono::steady_clock::now() - wallStart).count();
+  } else {
+    work();
+  }
+
+  bool isChanged = optimizationPass.changed;
+  if (isChanged) statistics[pass].changes++;
+
+  optimizationPass.changed = wasChanged || isChanged;
+
+  return isChanged;
+}
+
+bool PassManager::isDirty(shared_ptr<ASTNode> element) {
+  if (isFirstRound || isCapsuleChanged || changedElements.count(element)) return true;
+
+  return !changedNames.empty() && referencesAny(element, changedNames);
+}
+
+void PassManager::markChanged(shared_ptr<ASTNode> element, string name) {
+  if (element) {
+    changedElements.insert(element);
+    nextChangedElements.insert(element);
+  }
+
+  if (name != "") {
+    changedNames.insert(name);
+    nextChangedNames.insert(name);
+  }
+}
+
+string PassManager::getDeclaredName(shared_ptr<ASTNode> element) {
+  if (element->getNodeType() != ASTNode::ASSIGNMENT) return "";
+
+  return dynamic_pointer_cast<IdentifierNode>(element->getLeft())->getIdentifier();
+}
+
+bool PassManager::referencesAny(shared_ptr<ASTNode> ast, const set<string> &names) {
+  if (ast->getNodeType() == ASTNode::IDENTIFIER && names.count(dynamic_pointer_cast<IdentifierNode>(ast)->getIdentifier())) {
+    return true;
+  }
+
+  bool isFound = false;
+
+  OptimizationPass::forEachChild(ast, [&names, &isFound](shared_ptr<ASTNode> child) {
+    isFound = isFound || referencesAny(child, names);
+  });
+
+  return isFound;
+}
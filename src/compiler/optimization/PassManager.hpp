@@ -0,0 +1,128 @@
+#pragma once
+
+#include "OptimizationPass.hpp"
+#include "compiler/PhaseTimer.hpp"
+#include "parser/ast/ASTNode.hpp"
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Runs optimization passes over an AST until none of them change anything.
+ *
+ * Rather than each pass walking the whole tree on its own, passes are grouped into stages, and every pass in a stage
+ * runs in the same post-order traversal: at each node, each interested pass gets to rewrite it in turn, so a call can
+ * be inlined and the result folded before the traversal moves on. A pass only starts a new stage if it depends on a
+ * pass in the current one.
+ *
+ * The first round visits every element of the capsule. Later rounds only revisit the elements that changed in the round
+ * before, and the ones that reference them, unless a pass changed the capsule as a whole in hoistNecessary.
+ */
+namespace Theta {
+  class PassManager {
+  public:
+    /**
+     * @param passes The passes to run, in the order they should run in, as far as their dependencies allow.
+     */
+    PassManager(vector<shared_ptr<OptimizationPass>> passes);
+
+    /**
+     * @brief Optimizes an AST in place, in rounds, stopping at the first stage that reports an error.
+     *
+     * @param ast Reference to the shared pointer of the root node.
+     * @param timer If set, each pass gets recorded into it as a phase, with its total time and how many changes it made.
+     * @param phaseSuffix Appended to the name each pass is recorded under, such as the name of a linked capsule.
+     * @return true If all the passes succeeded
+     */
+    bool run(shared_ptr<ASTNode> &ast, PhaseTimer *timer = nullptr, string phaseSuffix = "");
+
+    /**
+     * @brief The passes, grouped into the stages that each run in a single traversal.
+     */
+    vector<vector<shared_ptr<OptimizationPass>>> getStages();
+
+    static const int MAX_ROUNDS = 16;
+
+  private:
+    struct Stage {
+      vector<int> passes;
+      bool isInterestedInTypeDeclarations = false;
+    };
+
+    struct PassStatistics {
+      double wallMs = 0;
+      double cpuMs = 0;
+      int changes = 0;
+    };
+
+    vector<shared_ptr<OptimizationPass>> passes;
+
+    // The node types the pass at each index is interested in
+    vector<set<ASTNode::Types>> interests;
+
+    vector<Stage> stages;
+    vector<PassStatistics> statistics;
+    PhaseTimer *phaseTimer = nullptr;
+
+    bool isFirstRound = true;
+    bool isNodeChanged = false;
+
+    // What changed in the last round, and so far in this one. A change made by one stage has to be seen by the later
+    // stages in the same round, and by the earlier ones in the next
+    bool isCapsuleChanged = false;
+    set<shared_ptr<ASTNode>> changedElements;
+    set<string> changedNames;
+
+    bool nextIsCapsuleChanged = false;
+    set<shared_ptr<ASTNode>> nextChangedElements;
+    set<string> nextChangedNames;
+
+    /**
+     * @brief Walks a node and its descendants in post-order, running the stage's passes on each of them.
+     */
+    void traverse(shared_ptr<ASTNode> &ast, const Stage &stage, bool isCapsuleDirectChild = false);
+
+    /**
+     * @brief Runs the stage's hoisting on a capsule, then traverses the capsule elements that need it.
+     */
+    void traverseCapsule(shared_ptr<ASTNode> &ast, const Stage &stage);
+
+    /**
+     * @brief Runs optimizeAST of each pass in the stage that is interested in the node, in order.
+     */
+    void visit(shared_ptr<ASTNode> &ast, const Stage &stage, bool isCapsuleDirectChild);
+
+    /**
+     * @brief Runs part of a pass, keeping track of whether it changed anything and how long it took.
+     *
+     * @param pass The index of the pass.
+     * @param work Runs the pass.
+     * @return true If the pass changed the AST
+     */
+    bool runPass(int pass, const std::function<void()> &work);
+
+    /**
+     * @brief Whether a capsule element could be changed by running the passes over it again.
+     */
+    bool isDirty(shared_ptr<ASTNode> element);
+
+    /**
+     * @brief Records a capsule element as changed, for the rest of this round and the next one.
+     */
+    void markChanged(shared_ptr<ASTNode> element, string name);
+
+    /**
+     * @brief The name a capsule element declares, or an empty string if it doesn't declare one.
+     */
+    static string getDeclaredName(shared_ptr<ASTNode> element);
+
+    /**
+     * @brief Whether any identifier with one of the given names appears anywhere inside a node.
+     */
+    static bool referencesAny(shared_ptr<ASTNode> ast, const set<string> &names);
+  };
+}
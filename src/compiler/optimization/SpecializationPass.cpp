@@ -0,0 +1,235 @@
+#include "SpecializationPass.hpp"
+#include "InliningPass.hpp"
+#include "compiler/Compiler.hpp"
+#include "compiler/TypeInterner.hpp"
+#include "parser/ast/AssignmentNode.hpp"
+#include "parser/ast/IdentifierNode.hpp"
+#include "parser/ast/LiteralNode.hpp"
+#include "parser/ast/TypeDeclarationNode.hpp"
+#include <memory>
+#include <utility>
+
+using namespace Theta;
+
+bool SpecializationPass::isSpecialization(string identifier) {
+  return identifier.rfind(SPECIALIZATION_PREFIX, 0) == 0;
+}
+
+void SpecializationPass::hoistNecessary(shared_ptr<ASTNode> &ast) {
+  capsuleBlock = dynamic_pointer_cast<ASTNodeList>(ast->getValue());
+  curriedFunctions.clear();
+  specializations.clear();
+  addedSpecializations.clear();
+
+  vector<shared_ptr<ASTNode>> elements = capsuleBlock->getElements();
+  vector<shared_ptr<FunctionDeclarationNode>> functions;
+
+  for (auto &elem : elements) {
+    if (elem->getNodeType() != ASTNode::ASSIGNMENT || elem->getRight()->getNodeType() != ASTNode::FUNCTION_DECLARATION) continue;
+
+    string identifier = dynamic_pointer_cast<IdentifierNode>(elem->getLeft())->getIdentifier();
+    shared_ptr<FunctionDeclarationNode> function = dynamic_pointer_cast<FunctionDeclarationNode>(elem->getRight());
+
+    functions.push_back(function);
+
+    if (isSpecialization(identifier)) specializations.insert(make_pair(identifier, elem));
+
+    if (getInnerFunction(function)) {
+      curriedFunctions.insert(make_pair(Compiler::getQualifiedFunctionIdentifier(identifier, function), function));
+    }
+  }
+
+  if (curriedFunctions.empty()) return;
+
+  for (auto &function : functions) specializeApplications(function->getDefinition(), function);
+
+  if (addedSpecializations.empty()) return;
+
+  elements.insert(elements.end(), addedSpecializations.begin(), addedSpecializations.end());
+  capsuleBlock->setElements(elements);
+}
+
+void SpecializationPass::specializeApplications(shared_ptr<ASTNode> ast, shared_ptr<FunctionDeclarationNode> function) {
+  forEachChild(ast, [this, &function](shared_ptr<ASTNode> child) { specializeApplications(child, function); });
+
+  if (ast->getNodeType() != ASTNode::BLOCK) return;
+
+  shared_ptr<ASTNodeList> block = dynamic_pointer_cast<ASTNodeList>(ast);
+  vector<shared_ptr<ASTNode>> elements = block->getElements();
+  vector<shared_ptr<ASTNode>> keptElements;
+
+  for (int i = 0; i < elements.size(); i++) {
+    // The last element of a block is its value, so the closure it assigns is needed either way
+    bool isSpecialized = (
+      i + 1 < elements.size() &&
+      elements.at(i)->getNodeType() == ASTNode::ASSIGNMENT &&
+      specializeAssignment(elements.at(i), function)
+    );
+
+    if (isSpecialized) {
+      changed = true;
+      continue;
+    }
+
+    keptElements.push_back(elements.at(i));
+  }
+
+  if (keptElements.size() != elements.size()) block->setElements(keptElements);
+}
+
+bool SpecializationPass::specializeAssignment(shared_ptr<ASTNode> assignment, shared_ptr<FunctionDeclarationNode> function) {
+  if (assignment->getRight()->getNodeType() != ASTNode::FUNCTION_INVOCATION) return false;
+
+  shared_ptr<FunctionInvocationNode> funcInvNode = dynamic_pointer_cast<FunctionInvocationNode>(assignment->getRight());
+  if (funcInvNode->getIdentifier()->getNodeType() != ASTNode::IDENTIFIER) return false;
+
+  vector<shared_ptr<ASTNode>> args = funcInvNode->getParameters()->getElements();
+
+  for (auto &arg : args) {
+    bool isLiteral = (
+      arg->getNodeType() == ASTNode::NUMBER_LITERAL ||
+      arg->getNodeType() == ASTNode::STRING_LITERAL ||
+      arg->getNodeType() == ASTNode::BOOLEAN_LITERAL
+    );
+
+    if (!isLiteral || !arg->getResolvedType()) return false;
+  }
+
+  string calledIdentifier = dynamic_pointer_cast<IdentifierNode>(funcInvNode->getIdentifier())->getIdentifier();
+
+  auto curriedFunction = curriedFunctions.find(Compiler::getQualifiedFunctionIdentifier(calledIdentifier, funcInvNode));
+  if (curriedFunction == curriedFunctions.end()) return false;
+
+  // The call might be to a local closure that shadows the capsule function
+  set<string> declarations;
+  InliningPass::collectDeclarations(function, declarations);
+
+  if (declarations.count(calledIdentifier)) return false;
+
+  string variable = dynamic_pointer_cast<IdentifierNode>(assignment->getLeft())->getIdentifier();
+  vector<shared_ptr<FunctionInvocationNode>> calls;
+  map<string, int> references;
+
+  collectCallsTo(variable, function, calls);
+  InliningPass::countReferences(function, references);
+
+  // Anything but calling the closure, such as returning it or passing it along, lets it escape
+  if (references[variable] != calls.size() || countDeclarations(variable, function) != 1) return false;
+
+  int arity = getInnerFunction(curriedFunction->second)->getParameters()->getElements().size();
+
+  // Calls that don't pass every argument make closures of their own
+  for (auto &call : calls) {
+    if (call->getParameters()->getElements().size() != arity) return false;
+  }
+
+  shared_ptr<ASTNode> specialization = createSpecialization(curriedFunction->second, args);
+  string identifier = dynamic_pointer_cast<IdentifierNode>(specialization->getLeft())->getIdentifier();
+
+  if (specializations.insert(make_pair(identifier, specialization)).second) addedSpecializations.push_back(specialization);
+
+  for (auto &call : calls) {
+    shared_ptr<IdentifierNode> calledSpecialization = make_shared<IdentifierNode>(identifier, call);
+    calledSpecialization->setSourceLocation(call->getIdentifier()->getLine(), call->getIdentifier()->getColumn());
+
+    call->setIdentifier(calledSpecialization);
+  }
+
+  return true;
+}
+
+shared_ptr<ASTNode> SpecializationPass::createSpecialization(
+  shared_ptr<FunctionDeclarationNode> curriedFunction,
+  vector<shared_ptr<ASTNode>> arguments
+) {
+  shared_ptr<FunctionDeclarationNode> innerFunction = getInnerFunction(curriedFunction);
+  vector<shared_ptr<ASTNode>> outerParams = curriedFunction->getParameters()->getElements();
+  map<string, shared_ptr<ASTNode>> boundArguments;
+
+  for (int i = 0; i < outerParams.size(); i++) {
+    boundArguments.insert(make_pair(dynamic_pointer_cast<IdentifierNode>(outerParams.at(i))->getIdentifier(), arguments.at(i)));
+  }
+
+  shared_ptr<AssignmentNode> assignment = make_shared<AssignmentNode>(capsuleBlock);
+  shared_ptr<FunctionDeclarationNode> specialized = make_shared<FunctionDeclarationNode>(assignment);
+  shared_ptr<ASTNodeList> parameters = make_shared<ASTNodeList>(specialized);
+  vector<shared_ptr<ASTNode>> parameterCopies;
+
+  for (auto &param : innerFunction->getParameters()->getElements()) {
+    shared_ptr<IdentifierNode> paramCopy = make_shared<IdentifierNode>(dynamic_pointer_cast<IdentifierNode>(param)->getIdentifier(), parameters);
+    paramCopy->setValue(TypeInterner::getInstance().intern(dynamic_pointer_cast<TypeDeclarationNode>(param->getValue())));
+
+    parameterCopies.push_back(paramCopy);
+  }
+
+  parameters->setElements(parameterCopies);
+  specialized->setParameters(parameters);
+  specialized->setDefinition(InliningPass::copyExpression(innerFunction->getDefinition(), specialized, boundArguments));
+
+  shared_ptr<TypeDeclarationNode> type = dynamic_pointer_cast<TypeDeclarationNode>(innerFunction->getResolvedType());
+  specialized->setResolvedType(TypeInterner::getInstance().intern(type));
+
+  shared_ptr<IdentifierNode> identifier = make_shared<IdentifierNode>(
+    SPECIALIZATION_PREFIX + Compiler::generateFunctionHash(specialized),
+    assignment
+  );
+  identifier->setValue(TypeInterner::getInstance().intern(type));
+
+  assignment->setLeft(identifier);
+  assignment->setRight(specialized);
+  assignment->setResolvedType(TypeInterner::getInstance().intern(type));
+
+  return assignment;
+}
+
+shared_ptr<FunctionDeclarationNode> SpecializationPass::getInnerFunction(shared_ptr<FunctionDeclarationNode> function) {
+  vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(function->getDefinition())->getElements();
+
+  if (body.size() != 1 || body.front()->getNodeType() != ASTNode::FUNCTION_DECLARATION) return nullptr;
+
+  shared_ptr<FunctionDeclarationNode> innerFunction = dynamic_pointer_cast<FunctionDeclarationNode>(body.front());
+
+  if (!innerFunction->getResolvedType() || InliningPass::getInlineCost(innerFunction->getDefinition()) < 0) return nullptr;
+
+  // An inner parameter that shadows an outer one would get the outer one's argument
+  set<string> outerParams;
+  for (auto &param : function->getParameters()->getElements()) {
+    outerParams.insert(dynamic_pointer_cast<IdentifierNode>(param)->getIdentifier());
+  }
+
+  for (auto &param : innerFunction->getParameters()->getElements()) {
+    if (outerParams.count(dynamic_pointer_cast<IdentifierNode>(param)->getIdentifier())) return nullptr;
+  }
+
+  return innerFunction;
+}
+
+void SpecializationPass::collectCallsTo(string identifier, shared_ptr<ASTNode> ast, vector<shared_ptr<FunctionInvocationNode>> &calls) {
+  if (ast->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
+    shared_ptr<FunctionInvocationNode> funcInvNode = dynamic_pointer_cast<FunctionInvocationNode>(ast);
+
+    bool isCallToIdentifier = (
+      funcInvNode->getIdentifier()->getNodeType() == ASTNode::IDENTIFIER &&
+      dynamic_pointer_cast<IdentifierNode>(funcInvNode->getIdentifier())->getIdentifier() == identifier
+    );
+
+    if (isCallToIdentifier) calls.push_back(funcInvNode);
+  }
+
+  forEachChild(ast, [&identifier, &calls](shared_ptr<ASTNode> child) { collectCallsTo(identifier, child, calls); });
+}
+
+int SpecializationPass::countDeclarations(string identifier, shared_ptr<ASTNode> ast) {
+  bool isDeclaration = (
+    ast->getNodeType() == ASTNode::IDENTIFIER &&
+    ast->getValue() &&
+    ast->getValue()->getNodeType() == ASTNode::TYPE_DECLARATION
+  );
+
+  if (isDeclaration) return dynamic_pointer_cast<IdentifierNode>(ast)->getIdentifier() == identifier ? 1 : 0;
+
+  int count = 0;
+  forEachChild(ast, [&identifier, &count](shared_ptr<ASTNode> child) { count += countDeclarations(identifier, child); });
+
+  return count;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "OptimizationPass.hpp"
+#include "parser/ast/ASTNode.hpp"
+#include "parser/ast/ASTNodeList.hpp"
+#include "parser/ast/FunctionDeclarationNode.hpp"
+#include "parser/ast/FunctionInvocationNode.hpp"
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief An optimization pass that specializes curried capsule functions for the constant arguments they are applied
+ * to. Applying `multiply<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x * y` to 10
+ * otherwise builds a closure in memory, which every call then has to read 10 back out of.
+ *
+ * When a variable is assigned the closure a curried function returns for literal arguments, and the variable is only
+ * ever called, the pass adds a capsule function with the literals in place of the outer parameters, and calls that
+ * instead. Specializations are named by Compiler::generateFunctionHash, so identical ones are shared. Being plain
+ * capsule functions, they can then be called directly, inlined and folded like any other.
+ *
+ * Runs after type checking, since both the calls it rewrites and the functions it adds need their types resolved.
+ */
+namespace Theta {
+  class SpecializationPass : public OptimizationPass {
+  public:
+    string getName() override { return "Specialization"; }
+
+    // Everything happens in hoistNecessary
+    set<ASTNode::Types> getInterests() override { return {}; }
+
+    /**
+     * @brief Checks whether a capsule function is a specialization this pass added. Specializations are never
+     * exported, and are removed once nothing calls them.
+     */
+    static bool isSpecialization(string identifier);
+
+  private:
+    // Can't be written in Theta, so specializations never clash with user defined functions
+    static inline const string SPECIALIZATION_PREFIX = "ThetaLang.internal.specialized.";
+
+    shared_ptr<ASTNodeList> capsuleBlock;
+
+    // The capsule functions that can be specialized, by their qualified identifier
+    map<string, shared_ptr<FunctionDeclarationNode>> curriedFunctions;
+
+    // The capsule assignments of every specialization, by their identifier, and the ones this run added
+    map<string, shared_ptr<ASTNode>> specializations;
+    vector<shared_ptr<ASTNode>> addedSpecializations;
+
+    void optimizeAST(shared_ptr<ASTNode> &ast, bool isCapsuleDirectChild) override {}
+
+    /**
+     * @brief Specializes the curried functions partially applied anywhere in the capsule, before it is traversed.
+     *
+     * @param ast Reference to the shared pointer of the capsule node.
+     */
+    void hoistNecessary(shared_ptr<ASTNode> &ast) override;
+
+    /**
+     * @brief Specializes the partial applications assigned in a node and all of its descendants.
+     *
+     * @param ast The node to search.
+     * @param function The capsule function the node is in.
+     */
+    void specializeApplications(shared_ptr<ASTNode> ast, shared_ptr<FunctionDeclarationNode> function);
+
+    /**
+     * @brief Replaces an assignment of a partial application with calls to a specialization, if the closure it assigns
+     * never escapes the function it is in.
+     *
+     * @param assignment The assignment node.
+     * @param function The capsule function the assignment is in.
+     * @return true If the assignment is no longer needed
+     */
+    bool specializeAssignment(shared_ptr<ASTNode> assignment, shared_ptr<FunctionDeclarationNode> function);
+
+    /**
+     * @brief Creates the capsule assignment for a curried function's inner function, with the given literals in place
+     * of the outer function's parameters.
+     */
+    shared_ptr<ASTNode> createSpecialization(shared_ptr<FunctionDeclarationNode> curriedFunction, vector<shared_ptr<ASTNode>> arguments);
+
+    /**
+     * @brief The function a curried capsule function returns, if its body is nothing but that function and everything
+     * in it can be copied.
+     */
+    static shared_ptr<FunctionDeclarationNode> getInnerFunction(shared_ptr<FunctionDeclarationNode> function);
+
+    /**
+     * @brief Collects every call made anywhere inside a node to an identifier with the given name.
+     */
+    static void collectCallsTo(string identifier, shared_ptr<ASTNode> ast, vector<shared_ptr<FunctionInvocationNode>> &calls);
+
+    /**
+     * @brief Counts how many times a name gets declared anywhere inside a node.
+     */
+    static int countDeclarations(string identifier, shared_ptr<ASTNode> ast);
+  };
+}
@@ -2,8 +2,12 @@
 
 #include <string>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
 #include "Error.hpp"
 #include "lexer/Token.hpp"
+#include "lexer/SourceFile.hpp"
 
 using namespace std;
 
@@ -13,69 +17,41 @@ namespace Theta {
     string errorType;
     string message;
     Token token;
-    string source;
+    shared_ptr<const SourceFile> sourceBuffer;
     string fileName;
 
   public:
-    CompilationError(string type, string msg, Token tok, string &src, string file) : errorType(type), message(msg), token(tok), source(src), fileName(file) {};
+    /**
+     * @param src The source buffer that tok was lexed from. The error shares ownership of it, so the token's
+     * lexeme view stays valid until the error is displayed.
+     */
+    CompilationError(string type, string msg, Token tok, shared_ptr<const SourceFile> src, string file) : errorType(type), message(msg), token(tok), sourceBuffer(src), fileName(file) {};
 
     string what() {
       return message + " at line " + to_string(token.getStartLocation()[0]) + ", column " + to_string(token.getStartLocation()[1]);
     }
 
-    void display() override {
-      cout << "\n" + fileName << endl;
-      cout << "  \033[1;31m" + errorType + "\033[0m: " << what() << ':' << endl;
+    void display(ostream &out) override {
+      int line = token.getStartLocation()[0];
+      int column = token.getStartLocation()[1];
 
-      string contextPrevLine;
-      string contextErrorLine;
-      string contextNextLine;
-      int line = 1;
-      int charIdx = 0;
+      out << "\n" << fileName << "\n";
+      out << "  \033[1;31m" << errorType << "\033[0m: " << what() << ":\n";
 
-      // If the error isn't on the first line of the file, we want to add a prevLine to the log output, for context.
-      if (token.getStartLocation()[0] > 1) {
-        for (; line < token.getStartLocation()[0] - 1; charIdx++) {
-          if (source[charIdx] == '\n') line++;
-        }
+      // The lines either side of the error are shown for context, where there are any
+      optional<string_view> prevLine = line > 1 ? sourceBuffer->getLine(line - 1) : nullopt;
+      string_view errorLine = sourceBuffer->getLine(line).value_or("");
+      optional<string_view> nextLine = sourceBuffer->getLine(line + 1);
 
-        while (source[charIdx] != '\n') {
-          contextPrevLine += source[charIdx];
-          charIdx++;
-        }
-      }
+      string errorMarker(column + to_string(line).length() + 1, ' ');
+      string errorPoint(token.getLexemeView().length(), '^');
 
-      // Skip to the line where the error is
-      for (; line < token.getStartLocation()[0]; charIdx++) {
-        if (source[charIdx] == '\n') line++;
-      }
+      if (prevLine && !prevLine->empty()) out << "    " << line - 1 << ": " << *prevLine << "\n";
 
-      while (source[charIdx] != '\n' && charIdx <= source.length()) {
-        contextErrorLine += source[charIdx];
-        charIdx++;
-      }
+      out << "    " << line << ": " << errorLine << "\n";
+      out << "    " << errorMarker << "\033[31m" << errorPoint << "\033[0m\n";
 
-      // If there's another line after this one, add its contents to the nextLine for logging output
-      if (charIdx++ < source.length()) {
-        while (source[charIdx] != '\n') {
-          contextNextLine += source[charIdx];
-          charIdx++;
-        }
-      }
-
-      string errorMarker(token.getStartLocation()[1] + to_string(token.getStartLocation()[0]).length() + 1, ' ');
-      string errorPoint(token.getLexeme().length(), '^');
-
-      if (contextPrevLine != "") {
-        cout << "    " + to_string(token.getStartLocation()[0] - 1) + ": " + contextPrevLine << endl;
-      }
-
-      cout << "    " + to_string(token.getStartLocation()[0]) + ": " +  contextErrorLine << endl;
-      cout << "    " + errorMarker + "\033[31m" + errorPoint + "\033[0m" << endl;
-
-      if (contextNextLine != "") {
-        cout << "    " + to_string(token.getStartLocation()[0] + 1) + ": " + contextNextLine << endl;
-      }
+      if (nextLine && !nextLine->empty()) out << "    " << line + 1 << ": " << *nextLine << "\n";
     }
   };
 }
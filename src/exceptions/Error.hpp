@@ -1,9 +1,19 @@
 #pragma once
 
+#include <exception>
+#include <iostream>
+#include <ostream>
+
+using namespace std;
+
 namespace Theta {
   class Error : public exception {
   public:
-    virtual void display() = 0;
+    /**
+     * @brief Writes the error, as it is shown to the user, to a stream.
+     */
+    virtual void display(ostream &out) = 0;
+
+    void display() { display(cout); }
   };
 }
-
@@ -13,10 +13,10 @@ namespace Theta {
 
     string identifier;
 
-    void display() override {
-      cout << "  \033[1;31mIllegalReassignmentError\033[0m: '" +
+    void display(ostream &out) override {
+      out << "  \033[1;31mIllegalReassignmentError\033[0m: '" +
         identifier +
-        "' can not be reassigned once it has been defined" << endl;
+        "' can not be reassigned once it has been defined\n";
     }
   };
 }
@@ -13,10 +13,10 @@ namespace Theta {
 
     string identifier;
 
-    void display() override {
-      cout << "  \033[1;31mReferenceError\033[0m: '" +
+    void display(ostream &out) override {
+      out << "  \033[1;31mReferenceError\033[0m: '" +
         identifier +
-        "' does not exist in the scope where it was referenced." << endl;
+        "' does not exist in the scope where it was referenced.\n";
     }
   };
 }
@@ -16,7 +16,7 @@ namespace Theta {
     shared_ptr<ASTNode> type1;
     shared_ptr<ASTNode> type2;
 
-    void display() override {
+    void display(ostream &out) override {
       string errText = "  \033[1;31mTypeError\033[0m: " + message + ": "; 
 
       pair<string, string> typeDiff = getTypeDiff(
@@ -30,7 +30,7 @@ namespace Theta {
         errText += typeDiff.first + " is not equivalent to " + typeDiff.second;
       }
 
-      cout << errText << endl;
+      out << errText << "\n";
     }
   
   private:
@@ -0,0 +1,118 @@
+#include "JsonWriter.hpp"
+#include <cstdio>
+
+using namespace std;
+using namespace Theta;
+
+JsonWriter& JsonWriter::beginObject() {
+  separate();
+  write('{');
+  hasValues.push_back(false);
+
+  return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+  hasValues.pop_back();
+  write('}');
+
+  return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+  separate();
+  write('[');
+  hasValues.push_back(false);
+
+  return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+  hasValues.pop_back();
+  write(']');
+
+  return *this;
+}
+
+JsonWriter& JsonWriter::key(string_view name) {
+  separate();
+  write('"');
+  writeEscaped(name);
+  write("\": ");
+  isAfterKey = true;
+
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(string_view text) {
+  separate();
+  write('"');
+  writeEscaped(text);
+  write('"');
+
+  return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+  separate();
+  write("null");
+
+  return *this;
+}
+
+JsonWriter& JsonWriter::newline() {
+  write('\n');
+
+  return *this;
+}
+
+void JsonWriter::flush() {
+  out.write(buffer.data(), buffer.size());
+  out.flush();
+  buffer.clear();
+}
+
+void JsonWriter::separate() {
+  // A field's value follows its key, with nothing in between
+  if (isAfterKey) {
+    isAfterKey = false;
+    return;
+  }
+
+  if (hasValues.empty()) return;
+
+  if (hasValues.back()) write(", ");
+  hasValues.back() = true;
+}
+
+void JsonWriter::write(char c) {
+  write(string_view(&c, 1));
+}
+
+void JsonWriter::write(string_view text) {
+  buffer.append(text.data(), text.size());
+
+  if (buffer.size() >= BUFFER_SIZE) {
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+}
+
+void JsonWriter::writeEscaped(string_view text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      write('\\');
+      write(c);
+    } else if (c == '\n') {
+      write("\\n");
+    } else if (c == '\t') {
+      write("\\t");
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      write(escaped);
+    } else {
+      write(c);
+    }
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Writes JSON to a stream as it is produced, rather than building it up in strings. Commas go between values
+   * and strings are escaped as they're written, so writers only say what comes next. Output is buffered and handed to
+   * the stream in large chunks, the rest when the writer is flushed or destroyed.
+   *
+   * Anything with a `writeJSON(JsonWriter&)` can be written as a value with node(), which is how ASTs and tokens are
+   * dumped, each node writing itself into the writer its parent is writing into.
+   */
+  class JsonWriter {
+  public:
+    explicit JsonWriter(ostream &stream) : out(stream) {}
+
+    ~JsonWriter() { flush(); }
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& beginObject();
+
+    JsonWriter& endObject();
+
+    JsonWriter& beginArray();
+
+    JsonWriter& endArray();
+
+    /**
+     * @brief Starts a field of the object being written. Its value is whatever is written next.
+     */
+    JsonWriter& key(string_view name);
+
+    /**
+     * @brief Writes a string value, escaping it.
+     */
+    JsonWriter& value(string_view text);
+
+    JsonWriter& null();
+
+    /**
+     * @brief Writes a field with a string value.
+     */
+    JsonWriter& field(string_view name, string_view text) { return key(name).value(text); }
+
+    /**
+     * @brief Writes something that writes itself, see ASTNode::writeJSON, or null if there isn't anything.
+     */
+    template<typename T>
+    JsonWriter& node(const T &writable) {
+      if (!writable) return null();
+
+      writable->writeJSON(*this);
+      return *this;
+    }
+
+    /**
+     * @brief Ends a line, for writing one value per line.
+     */
+    JsonWriter& newline();
+
+    /**
+     * @brief Hands everything written so far to the stream, and flushes it.
+     */
+    void flush();
+
+  private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    ostream &out;
+    string buffer;
+
+    // Whether each object and array being written has a value yet, innermost last
+    vector<bool> hasValues;
+    bool isAfterKey = false;
+
+    /**
+     * @brief Writes the comma that goes before a value, if one does.
+     */
+    void separate();
+
+    void write(char c);
+
+    void write(string_view text);
+
+    void writeEscaped(string_view text);
+  };
+}
@@ -69,5 +69,8 @@ namespace Theta {
     const string TRUE = "true";
     const string FALSE = "false";
     const string AT = "@";
+
+    // Annotations, which follow an AT
+    const string MEMO = "memo";
   }
 }
@@ -4,9 +4,14 @@
 #include <string>
 #include <iostream>
 #include <algorithm>
-#include <functional>
+#include <memory>
+#include <string_view>
+#include <stdexcept>
 #include "Token.hpp"
 #include "Lexemes.hpp"
+#include "TokenStream.hpp"
+#include "Scanners.hpp"
+#include "SourceFile.hpp"
 
 using namespace std;
 
@@ -20,16 +25,74 @@ namespace Theta {
     deque<Token> tokens = {};
 
     /**
-     * @brief Tokenizes the given source code string.
+     * @brief Tokenizes the given source code string into tokens. The lexer takes ownership of the source, and every
+     * emitted token's lexeme is a view into that single buffer, so no text is copied per token. Tokens stay
+     * valid for as long as the buffer returned by getSource() is alive.
      * @param source The source code to lex.
      */
     void lex(string source) {
-      int i = 0;
+      load(std::move(source));
 
-      // Iterate over the whole source
-      while (i < source.length()) {
-        char currentChar = source[i];
-        char nextChar = source[i + 1];
+      Token token;
+      while (lexNext(token)) tokens.push_back(token);
+    }
+
+    /**
+     * @brief Tokenizes the given source file into tokens, without copying it.
+     * @param source The source file to lex.
+     */
+    void lex(shared_ptr<const SourceFile> source) {
+      load(source);
+
+      Token token;
+      while (lexNext(token)) tokens.push_back(token);
+    }
+
+    /**
+     * @brief Takes ownership of the source code to be lexed incrementally with lexNext.
+     * @param source The source code to lex.
+     */
+    void load(string source) {
+      load(SourceFile::fromString(std::move(source)));
+    }
+
+    /**
+     * @brief Loads a source file to be lexed incrementally with lexNext. Tokens will be views directly into the file.
+     * @param source The source file to lex.
+     */
+    void load(shared_ptr<const SourceFile> source) {
+      sourceBuffer = source;
+      currentIndex = 0;
+    }
+
+    /**
+     * @brief Loads a source file to be lexed with lexNext from partway through, such as from the start of a part of it
+     * that was edited. Tokens get the lines and columns they have in the whole file.
+     * @param source The source file to lex.
+     * @param index Where to start lexing. Must be the start of a token, or between tokens.
+     * @param line The line index is on.
+     * @param column The column index is at.
+     */
+    void load(shared_ptr<const SourceFile> source, int index, int line, int column) {
+      sourceBuffer = source;
+      currentIndex = index;
+      currentLine = line;
+      currentColumn = column;
+    }
+
+    /**
+     * @brief Lexes the next emitted token from the loaded source, skipping over whitespace and comments.
+     * @param token Set to the lexed token, if there is one.
+     * @return True if a token was lexed, false if the end of the source was reached.
+     */
+    bool lexNext(Token &token) {
+      string_view src = sourceBuffer->view();
+      int &i = currentIndex;
+
+      // Iterate over the source until we produce a token we want to keep
+      while (i < src.length()) {
+        char currentChar = src[i];
+        char nextChar = i + 1 < src.length() ? src[i + 1] : '\0';
 
         // We want the line and column numbers for the beginning of the token, not the end. If we were to use
         // currentLine and currentColumn, it would give us the values for the end of the token, since some of
@@ -38,21 +101,14 @@ namespace Theta {
         int lineAtLexStart = currentLine;
         int columnAtLexStart = currentColumn;
 
-        Token newToken = makeToken(currentChar, nextChar, source, i);
-
-        // We don't actually want to keep any whitespace related tokens or comments
-        if (shouldEmitToken(newToken.getType())) {
-          newToken.setStartLine(lineAtLexStart);
-          newToken.setStartColumn(columnAtLexStart);
-          tokens.push_back(newToken);
-        }
+        Token newToken = makeToken(currentChar, nextChar, src, i);
 
         // Some tokens are more than one character. We want to advance the iterator and currentLine by however many
         // characters long the token was. We really only want to do this for any token that was not created by an
         // accumulateUntil function, since those already update the index internally.
         if (!isAccumulatedToken(newToken.getType())) {
-          i += newToken.getLexeme().length();
-          currentColumn += newToken.getLexeme().length();
+          i += newToken.getLexemeView().length();
+          currentColumn += newToken.getLexemeView().length();
         } else if (newToken.getType() == Token::MULTILINE_COMMENT) {
           i += 2;
           currentColumn += 2;
@@ -60,10 +116,28 @@ namespace Theta {
           i++;
           currentColumn++;
         }
+
+        // We don't actually want to keep any whitespace related tokens or comments
+        if (shouldEmitToken(newToken.getType())) {
+          newToken.setStartLine(lineAtLexStart);
+          newToken.setStartColumn(columnAtLexStart);
+          token = newToken;
+          return true;
+        }
       }
+
+      return false;
     }
 
+    /**
+     * @brief Returns the buffer that the lexed tokens point into. Anything that holds on to tokens past the
+     * lifetime of the lexer (the parser, compilation errors) should share ownership of this buffer.
+     */
+    shared_ptr<const SourceFile> getSource() { return sourceBuffer; }
+
   private:
+    shared_ptr<const SourceFile> sourceBuffer = SourceFile::fromString("");
+    int currentIndex = 0;
     int currentLine = 1;
     int currentColumn = 1;
 
@@ -84,79 +158,131 @@ namespace Theta {
       Token::NUMBER
     };
 
-    array<string, 7> LANGUAGE_RESERVED_WORDS = {
-      Lexemes::LINK,
-      Lexemes::CAPSULE,
-      Lexemes::IF,
-      Lexemes::ELSE,
-      Lexemes::STRUCT,
-      Lexemes::ENUM,
-      Lexemes::RETURN
+    /**
+     * @brief Describes a symbol that the lexer recognizes directly, and how a token is made from it.
+     */
+    struct LexemeRule {
+      const string *symbol;
+      Token::Types type;
+      // If set, the token continues until this terminal is found in the source
+      const string *terminal;
+      bool incrementAfter;
     };
 
+    // Order matters here to ensure correct tokenization precedence. Rules that share a first character are
+    // attempted in the order they are listed, and the first one that matches wins.
+    //
+    // This ordering ensures that tokens with longer symbol representations (e.g., multi-character operators)
+    // are prioritized over shorter ones, preventing misinterpretations and ensuring correct tokenization
+    // of the source code.
+    static const vector<LexemeRule> &lexemeRules() {
+      static const vector<LexemeRule> rules = {
+        { &Lexemes::STRING_DELIMITER, Token::STRING, &Lexemes::STRING_DELIMITER, true },
+        { &Lexemes::COMMENT, Token::COMMENT, &Lexemes::NEWLINE, false },
+        { &Lexemes::MULTILINE_COMMENT_DELIMITER_START, Token::MULTILINE_COMMENT, &Lexemes::MULTILINE_COMMENT_DELIMITER_END, true },
+        { &Lexemes::DIVISION, Token::OPERATOR, nullptr, true },
+        { &Lexemes::EQUALITY, Token::OPERATOR, nullptr, true },
+        { &Lexemes::INEQUALITY, Token::OPERATOR, nullptr, true },
+        { &Lexemes::AT, Token::AT, nullptr, true },
+        { &Lexemes::AND, Token::OPERATOR, nullptr, true },
+        { &Lexemes::OR, Token::OPERATOR, nullptr, true },
+        { &Lexemes::NOT, Token::OPERATOR, nullptr, true },
+        { &Lexemes::PIPE, Token::OPERATOR, nullptr, true },
+        { &Lexemes::ASSIGNMENT, Token::ASSIGNMENT, nullptr, true },
+        { &Lexemes::PLUS_EQUALS, Token::OPERATOR, nullptr, true },
+        { &Lexemes::PLUS, Token::OPERATOR, nullptr, true },
+        { &Lexemes::MINUS_EQUALS, Token::OPERATOR, nullptr, true },
+        { &Lexemes::FUNC_DECLARATION, Token::FUNC_DECLARATION, nullptr, true },
+        { &Lexemes::MINUS, Token::OPERATOR, nullptr, true },
+        { &Lexemes::MODULO, Token::OPERATOR, nullptr, true },
+        { &Lexemes::TIMES_EQUALS, Token::OPERATOR, nullptr, true },
+        { &Lexemes::EXPONENT, Token::OPERATOR, nullptr, true },
+        { &Lexemes::TIMES, Token::OPERATOR, nullptr, true },
+        { &Lexemes::BRACE_OPEN, Token::BRACE_OPEN, nullptr, true },
+        { &Lexemes::BRACE_CLOSE, Token::BRACE_CLOSE, nullptr, true },
+        { &Lexemes::PAREN_OPEN, Token::PAREN_OPEN, nullptr, true },
+        { &Lexemes::PAREN_CLOSE, Token::PAREN_CLOSE, nullptr, true },
+        { &Lexemes::LTEQ, Token::OPERATOR, nullptr, true },
+        { &Lexemes::LT, Token::OPERATOR, nullptr, true },
+        { &Lexemes::GTEQ, Token::OPERATOR, nullptr, true },
+        { &Lexemes::GT, Token::OPERATOR, nullptr, true },
+        { &Lexemes::BRACKET_OPEN, Token::BRACKET_OPEN, nullptr, true },
+        { &Lexemes::BRACKET_CLOSE, Token::BRACKET_CLOSE, nullptr, true },
+        { &Lexemes::COMMA, Token::COMMA, nullptr, true },
+        { &Lexemes::COLON, Token::COLON, nullptr, true }
+      };
+
+      return rules;
+    }
+
+    /**
+     * @brief Dispatch table of the lexeme rules, indexed by the first byte of their symbol. It's built once from
+     * lexemeRules(), so the two can never drift apart.
+     */
+    static const array<vector<LexemeRule>, 256> &lexemeRulesByFirstChar() {
+      static const array<vector<LexemeRule>, 256> table = [] {
+        array<vector<LexemeRule>, 256> rulesByFirstChar;
+
+        for (const LexemeRule &rule : lexemeRules()) {
+          rulesByFirstChar[(unsigned char) (*rule.symbol)[0]].push_back(rule);
+        }
+
+        return rulesByFirstChar;
+      }();
+
+      return table;
+    }
+
+    /**
+     * @brief Reserved words (keywords and boolean literals), indexed by their first byte along with the token
+     * type they produce.
+     */
+    static const array<vector<pair<const string *, Token::Types>>, 256> &reservedWordsByFirstChar() {
+      static const array<vector<pair<const string *, Token::Types>>, 256> table = [] {
+        array<vector<pair<const string *, Token::Types>>, 256> wordsByFirstChar;
+        vector<pair<const string *, Token::Types>> reservedWords = {
+          { &Lexemes::LINK, Token::KEYWORD },
+          { &Lexemes::CAPSULE, Token::KEYWORD },
+          { &Lexemes::IF, Token::KEYWORD },
+          { &Lexemes::ELSE, Token::KEYWORD },
+          { &Lexemes::STRUCT, Token::KEYWORD },
+          { &Lexemes::ENUM, Token::KEYWORD },
+          { &Lexemes::RETURN, Token::KEYWORD },
+          { &Lexemes::TRUE, Token::BOOLEAN },
+          { &Lexemes::FALSE, Token::BOOLEAN }
+        };
+
+        for (const pair<const string *, Token::Types> &word : reservedWords) {
+          wordsByFirstChar[(unsigned char) (*word.first)[0]].push_back(word);
+        }
+
+        return wordsByFirstChar;
+      }();
+
+      return table;
+    }
+
     /**
      * @brief Creates a Token object based on the current and next characters in the source code.
      * @param currentChar The current character being processed.
      * @param nextChar The next character to be processed.
-     * @param source The source code string.
+     * @param source A view of the source code buffer.
      * @param i The current index in the source string.
      * @return The generated Token object.
      */
-    Token makeToken(char currentChar, char nextChar, string source, int &i) {
+    Token makeToken(char currentChar, char nextChar, string_view source, int &i) {
       Token token;
 
-      // Order matters here to ensure correct tokenization precedence.
-      // We attempt to lex each potential token type in a specific order of priority.
-      // Each attemptLex function call checks if the current and possibly next character
-      // match the expected symbol(s) for the token type. If a match is found, it processes
-      // and returns the corresponding token. If no match is found, it returns false, and
-      // the next attemptLex in the sequence is checked.
-      //
-      // This sequential checking ensures that tokens with longer symbol representations
-      // (e.g., multi-character operators) are prioritized over shorter ones, preventing
-      // misinterpretations and ensuring correct tokenization of the source code.
-      if (
-        attemptLex(Lexemes::STRING_DELIMITER, Token::STRING, token, currentChar, nextChar, source, i, Lexemes::STRING_DELIMITER) ||
-        attemptLex(Lexemes::COMMENT, Token::COMMENT, token, currentChar, nextChar, source, i, Lexemes::NEWLINE, false, false) ||
-        attemptLex(Lexemes::MULTILINE_COMMENT_DELIMITER_START, Token::MULTILINE_COMMENT, token, currentChar, nextChar, source, i, Lexemes::MULTILINE_COMMENT_DELIMITER_END) ||
-        attemptLex(Lexemes::DIVISION, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::EQUALITY, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::INEQUALITY, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::AT, Token::AT, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::AND, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::OR, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::NOT, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::PIPE, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::ASSIGNMENT, Token::ASSIGNMENT, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::PLUS_EQUALS, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::PLUS, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::MINUS_EQUALS, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::FUNC_DECLARATION, Token::FUNC_DECLARATION, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::MINUS, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::MODULO, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::TIMES_EQUALS, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::EXPONENT, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::TIMES, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::BRACE_OPEN, Token::BRACE_OPEN, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::BRACE_CLOSE, Token::BRACE_CLOSE, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::PAREN_OPEN, Token::PAREN_OPEN, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::PAREN_CLOSE, Token::PAREN_CLOSE, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::LTEQ, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::LT, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::GTEQ, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::GT, Token::OPERATOR, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::BRACKET_OPEN, Token::BRACKET_OPEN, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::BRACKET_CLOSE, Token::BRACKET_CLOSE, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::COMMA, Token::COMMA, token, currentChar, nextChar, source, i) ||
-        attemptLex(Lexemes::COLON, Token::COLON, token, currentChar, nextChar, source, i)
-      ) {
-        return token;
+      // Only the rules whose symbol starts with currentChar can match, so we jump straight to them. Each bucket keeps
+      // the relative order of lexemeRules(), so precedence is identical to trying every rule in sequence.
+      for (const LexemeRule &rule : lexemeRulesByFirstChar()[(unsigned char) currentChar]) {
+        if (attemptLex(rule, token, nextChar, source, i)) return token;
       }
 
       if (currentChar == '\n') {
         currentLine += 1;
         currentColumn = 0;
-        return Token(Token::NEWLINE, Lexemes::NEWLINE);
+        return Token(Token::NEWLINE, source.substr(i, 1));
       } else if (isdigit(currentChar)) {
         int countDecimals = 0;
         return accumulateUntilCondition(
@@ -169,81 +295,47 @@ namespace Theta {
           },
           source,
           i,
-          Token(Token::NUMBER, { currentChar }),
-          "",
+          Token::NUMBER,
           false
         );
       } else if (!isspace(currentChar)) {
         // We default this to an identifier, but then change it later if we discover its actually a keyword or bool
-        Token token = accumulateUntilAnyOf(
-          " <>=/\\!?@#$%^&*()~`|,-+{}[]'\";:\n\r",
-          source,
-          i,
-          Token(Token::IDENTIFIER, { currentChar }),
-          "",
-          false
-        );
+        Token token = accumulateUntilIndex(Scanners::findIdentifierEnd(source, i + 1), source, i, Token::IDENTIFIER, false);
 
-        if (isLanguageKeyword(token.getLexeme())) {
-          token.setType(Token::KEYWORD);
-        } else if (token.getLexeme() == "true" || token.getLexeme() == "false") {
-          token.setType(Token::BOOLEAN);
-        }
+        token.setType(classifyWord(token.getLexemeView()));
 
         return token;
       } else if (isspace(currentChar)) {
-        return Token(Token::WHITESPACE, { currentChar });
+        // Newlines are handled above, so we can skip the whole run of indentation or spacing in one go
+        return Token(Token::WHITESPACE, source.substr(i, Scanners::skipInlineWhitespace(source, i) - i));
       } else {
         cout << "UNHANDLED CHAR: " << currentChar << " \n";
-        return Token(Token::UNHANDLED, { currentChar });
+        return Token(Token::UNHANDLED, source.substr(i, 1));
       }
     }
 
     /**
-     * @brief Attempts to lex a token from the source code based on the given symbol and token type.
-     * @param symbol The symbol representing the token.
-     * @param tokenType The type of token to create.
+     * @brief Attempts to lex a token from the source code based on the given rule. The caller is expected to have
+     * already matched the first character of the rule's symbol.
+     * @param rule The rule describing the symbol, the type of token to create, and how to accumulate it.
      * @param token The token object to update.
-     * @param currentChar The current character being processed.
      * @param nextChar The next character to be processed.
-     * @param source The source code string.
+     * @param source A view of the source code buffer.
      * @param i The current index in the source string.
-     * @param terminal The terminal character string to stop at (default is an empty string).
-     * @param appendSymbol Whether to append the symbol to the token text (default is true).
-     * @param incrementAfter Whether to increment the index after lexing (default is true).
      * @return True if the token was successfully lexed, false otherwise.
      */
-    bool attemptLex(
-      const string &symbol,
-      Token::Types tokenType,
-      Token &token,
-      char currentChar,
-      char nextChar,
-      const string &source,
-      int& i,
-      string terminal = "",
-      bool appendSymbol = true,
-      bool incrementAfter = true
-    ) {
-      if (currentChar == symbol[0] && (symbol.length() == 1 || nextChar == symbol[1])) {
-        if (terminal != "") {
-          // With tokens like comment and multiline_comment, this will format them weirdly
-          // in the token text field, because the combination of an accumulator and a symbol
-          // that is different from the prefix we start at causes some weird insertion to happen.
-          // We could add extra logic to fix it, but we throw out comments anyway right after they are lexed,
-          // so its probably not worth the extra code to do so. Our line numbers and columns are still correct
-          // and the lexing otherwise succeeds. However, if we ever come across a token that is *not* a
-          // comment in the future that follows the same weird capture logic, we'll need to fix it.
-          token = accumulateUntilNext(
-            terminal,
-            source,
-            i,
-            Token(tokenType, symbol),
-            appendSymbol ? symbol : "",
-            incrementAfter
-          );
+    bool attemptLex(const LexemeRule &rule, Token &token, char nextChar, string_view source, int& i) {
+      const string &symbol = *rule.symbol;
+
+      if (symbol.length() == 1 || nextChar == symbol[1]) {
+        if (rule.terminal) {
+          // With multi-character terminals like the multiline comment end delimiter, the lexeme will only span up
+          // to the first character of the terminal. We throw out comments right after they are lexed, so that's fine,
+          // but if we ever come across a token that is *not* a comment in the future that follows the same capture
+          // logic, we'll need to account for it. Our line numbers and columns are still correct either way.
+          token = accumulateUntilNext(*rule.terminal, source, i, rule.type, rule.incrementAfter);
         } else {
-          token = Token(tokenType, symbol);
+          token = Token(rule.type, source.substr(i, symbol.length()));
         }
         return true;
       }
@@ -253,74 +345,62 @@ namespace Theta {
     /**
      * @brief Accumulates characters from the source until all of the specified end characters are encountered as a substring.
      * @param endChars A string containing characters that mark the end of accumulation.
-     * @param source The source code string to lex.
+     * @param source A view of the source code buffer.
      * @param i The current index in the source string.
-     * @param token The Token object to update with accumulated characters.
-     * @param append Additional text to append to the accumulated token text (default is an empty string).
+     * @param tokenType The type of the token being accumulated.
      * @param incrementAfter Whether to increment the index after accumulation (default is true).
-     * @return The updated Token object after accumulation.
+     * @return The accumulated Token object.
      */
-    Token accumulateUntilNext(string endChars, string source, int &i, Token token, string append = "", bool incrementAfter = true) {
-      return accumulateUntilCondition(
-        [endChars, source](int i) { return source.substr(i, endChars.length()) != endChars; },
-        source,
-        i,
-        token,
-        append,
-        incrementAfter
-      );
+    Token accumulateUntilNext(string_view endChars, string_view source, int &i, Token::Types tokenType, bool incrementAfter = true) {
+      return accumulateUntilIndex(Scanners::findTerminal(source, i + 1, endChars), source, i, tokenType, incrementAfter);
     }
 
     /**
-     * @brief Accumulates characters from the source until any character from the specified endChars string is encountered.
-     * @param endChars A string containing characters that mark the end of accumulation.
-     * @param source The source code string to lex.
+     * @brief Generalized accumulation function that continues accumulating characters as long as the provided condition function returns true.
+     * @param shouldContinue A callable that takes an integer index and returns true if accumulation should continue.
+     * @param source A view of the source code buffer.
      * @param i The current index in the source string.
-     * @param token The Token object to update with accumulated characters.
-     * @param append Additional text to append to the accumulated token text (default is an empty string).
+     * @param tokenType The type of the token being accumulated.
      * @param incrementAfter Whether to increment the index after accumulation (default is true).
-     * @return The updated Token object after accumulation.
+     * @return The accumulated Token object.
      */
-    Token accumulateUntilAnyOf(string endChars, string source, int &i, Token token, string append = "", bool incrementAfter = true) {
-      return accumulateUntilCondition(
-        [endChars, source](int i) { return find(endChars.begin(), endChars.end(), source[i]) == endChars.end(); },
-        source,
-        i,
-        token,
-        append,
-        incrementAfter
-      );
+    template<typename Condition>
+    Token accumulateUntilCondition(Condition shouldContinue, string_view source, int &i, Token::Types tokenType, bool incrementAfter = true) {
+      // We start one index forward because we're already on the start char
+      int stop = i + 1;
+      while (stop < source.length() && shouldContinue(stop)) stop++;
+
+      return accumulateUntilIndex(stop, source, i, tokenType, incrementAfter);
     }
 
     /**
-     * @brief Generalized accumulation function that continues accumulating characters as long as the provided condition function returns true.
-     * @param shouldContinue A function that takes an integer index and returns true if accumulation should continue.
-     * @param source The source code string to lex.
-     * @param i The current index in the source string.
-     * @param token The Token object to update with accumulated characters.
-     * @param append Additional text to append to the accumulated token text (default is an empty string).
+     * @brief Accumulates the characters from the current index up until a stop index that has already been found by
+     * one of the scanners. The resulting token's lexeme is a view over the accumulated span of the source, so nothing is copied.
+     * @param stop The index of the character that ended the token (or the source length, if nothing did).
+     * @param source A view of the source code buffer.
+     * @param i The current index in the source string. Updated to the stop index.
+     * @param tokenType The type of the token being accumulated.
      * @param incrementAfter Whether to increment the index after accumulation (default is true).
-     * @return The updated Token object after accumulation.
+     * @return The accumulated Token object.
      */
-    Token accumulateUntilCondition(function<bool(int)> shouldContinue, string source, int &i, Token token, string append = "", bool incrementAfter = true) {
-      // We need to jump forward one index because we're already on the start char
-      i++;
-      currentColumn++;
-
-      // Just collect characters until we hit our end condition
-      for (; i < source.length() && shouldContinue(i); i++) {
-        token.appendLexeme(source[i]);
-
-        // We might hit newlines in multiline comments and strings. We need to keep line and column numbers correct
-        if (source[i] == '\n') {
-          currentLine++;
-          currentColumn = 0;
-        }
+    Token accumulateUntilIndex(size_t stop, string_view source, int &i, Token::Types tokenType, bool incrementAfter = true) {
+      int start = i;
 
-        currentColumn++;
+      // We might have skipped over newlines in multiline comments and strings. We need to keep line and column numbers
+      // correct, so the column restarts after the last newline we passed
+      size_t newlines = Scanners::countNewlines(source, start + 1, stop);
+      if (newlines > 0) {
+        currentLine += newlines;
+        currentColumn = stop - source.rfind('\n', stop - 1);
+      } else {
+        currentColumn += stop - start;
       }
 
-      token.appendLexeme(append);
+      i = stop;
+
+      // Delimited tokens (strings, comments) include the terminal character we stopped on
+      int end = incrementAfter ? min(i + 1, (int) source.length()) : i;
+      Token token(tokenType, source.substr(start, end - start));
 
       // If incrementAfter is false, that means we want to roll back the index to the point right before we hit an endChar.
       // This is probably because the token we're parsing isn't a token thats enclosed in delimiters, so we want to
@@ -334,12 +414,16 @@ namespace Theta {
     }
 
     /**
-     * @brief Checks if a given text is a keyword in the Theta programming language.
+     * @brief Determines whether an accumulated word is a keyword, a boolean literal, or a plain identifier.
      * @param lexeme The text to check.
-     * @return True if the lexeme is a keyword, false otherwise.
+     * @return The token type the word should have.
      */
-    bool isLanguageKeyword(string lexeme) {
-      return find(LANGUAGE_RESERVED_WORDS.begin(), LANGUAGE_RESERVED_WORDS.end(), lexeme) != LANGUAGE_RESERVED_WORDS.end();
+    Token::Types classifyWord(string_view lexeme) {
+      for (const pair<const string *, Token::Types> &word : reservedWordsByFirstChar()[(unsigned char) lexeme[0]]) {
+        if (*word.first == lexeme) return word.second;
+      }
+
+      return Token::IDENTIFIER;
     }
 
     /**
@@ -360,4 +444,43 @@ namespace Theta {
       return find(NON_EMITTED_TOKENS.begin(), NON_EMITTED_TOKENS.end(), type) == NON_EMITTED_TOKENS.end();
     }
   };
+
+  /**
+   * @brief A TokenStream that lexes on demand, so the parser can start consuming tokens before the whole source has
+   * been lexed. Only a small ring buffer of lookahead tokens is ever held in memory.
+   */
+  class LexerTokenStream : public TokenStream {
+  public:
+    static const size_t LOOKAHEAD = 4;
+
+    LexerTokenStream(Lexer &lex) : lexer(lex) {}
+
+    Token * peek(size_t ahead = 0) override {
+      if (ahead >= LOOKAHEAD) throw out_of_range("Cannot look further than " + to_string(LOOKAHEAD) + " tokens ahead");
+
+      while (buffered <= ahead && !isExhausted) {
+        if (lexer.lexNext(lookahead[(head + buffered) % LOOKAHEAD])) {
+          buffered++;
+        } else {
+          isExhausted = true;
+        }
+      }
+
+      return ahead < buffered ? &lookahead[(head + ahead) % LOOKAHEAD] : nullptr;
+    }
+
+    void advance() override {
+      if (!peek()) return;
+
+      head = (head + 1) % LOOKAHEAD;
+      buffered--;
+    }
+
+  private:
+    Lexer &lexer;
+    array<Token, LOOKAHEAD> lookahead;
+    size_t head = 0;
+    size_t buffered = 0;
+    bool isExhausted = false;
+  };
 }
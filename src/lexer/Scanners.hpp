@@ -0,0 +1,212 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__)
+#define THETA_SCANNERS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define THETA_SCANNERS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+/**
+ * @brief Fast scanning routines used by the lexer to skip over runs of bytes it doesn't need to look at individually:
+ * indentation, the bodies of comments and strings, and identifiers. Where SSE2 or NEON is available they look at 16
+ * bytes at a time, otherwise they fall back to a scalar loop with identical results.
+ */
+namespace Theta {
+  namespace Scanners {
+    // Characters that end an identifier. This must stay in sync with IDENTIFIER_STOP_TABLE and the SIMD range checks below
+    constexpr string_view IDENTIFIER_STOP_CHARS = " <>=/\\!?@#$%^&*()~`|,-+{}[]'\";:\n\r";
+
+    constexpr array<bool, 256> makeIdentifierStopTable() {
+      array<bool, 256> table = {};
+      for (char c : IDENTIFIER_STOP_CHARS) table[(unsigned char) c] = true;
+      return table;
+    }
+
+    constexpr array<bool, 256> IDENTIFIER_STOP_TABLE = makeIdentifierStopTable();
+
+    // Whitespace as defined by isspace, except for newlines, which the lexer needs to see to keep track of line numbers
+    inline bool isInlineWhitespace(char c) {
+      return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+#ifdef THETA_SCANNERS_SSE2
+    // All of the bytes we test for are ASCII, so the signed comparisons are fine: bytes >= 0x80 are negative and
+    // never fall inside a range
+    inline __m128i bytesInRange(__m128i bytes, char lo, char hi) {
+      return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(hi + 1)));
+    }
+
+    inline __m128i bytesEqual(__m128i bytes, char c) {
+      return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c));
+    }
+
+    inline int lowestSetBit(int mask) {
+      return __builtin_ctz(mask);
+    }
+#endif
+
+#ifdef THETA_SCANNERS_NEON
+    inline uint8x16_t bytesInRange(uint8x16_t bytes, uint8_t lo, uint8_t hi) {
+      return vandq_u8(vcgeq_u8(bytes, vdupq_n_u8(lo)), vcleq_u8(bytes, vdupq_n_u8(hi)));
+    }
+
+    inline uint8x16_t bytesEqual(uint8x16_t bytes, uint8_t c) {
+      return vceqq_u8(bytes, vdupq_n_u8(c));
+    }
+#endif
+
+    /**
+     * @brief Finds the end of an identifier.
+     * @param source The source being scanned.
+     * @param from The index to start scanning at.
+     * @return The index of the first character at or after from that is in IDENTIFIER_STOP_CHARS, or source.length().
+     */
+    inline size_t findIdentifierEnd(string_view source, size_t from) {
+      size_t i = from;
+
+#if defined(THETA_SCANNERS_SSE2)
+      for (; i + 16 <= source.length(); i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source.data() + i));
+
+        // The stop set, as ranges: [ -,] [/] [:-@] [[-^] [`] [{-~] [\n] [\r]
+        __m128i isStop = _mm_or_si128(
+          _mm_or_si128(
+            _mm_or_si128(bytesInRange(bytes, ' ', '-'), bytesEqual(bytes, '/')),
+            _mm_or_si128(bytesInRange(bytes, ':', '@'), bytesInRange(bytes, '[', '^'))
+          ),
+          _mm_or_si128(
+            _mm_or_si128(bytesEqual(bytes, '`'), bytesInRange(bytes, '{', '~')),
+            _mm_or_si128(bytesEqual(bytes, '\n'), bytesEqual(bytes, '\r'))
+          )
+        );
+
+        int mask = _mm_movemask_epi8(isStop);
+        if (mask != 0) return i + lowestSetBit(mask);
+      }
+#elif defined(THETA_SCANNERS_NEON)
+      for (; i + 16 <= source.length(); i += 16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t *>(source.data() + i));
+
+        uint8x16_t isStop = vorrq_u8(
+          vorrq_u8(
+            vorrq_u8(bytesInRange(bytes, ' ', '-'), bytesEqual(bytes, '/')),
+            vorrq_u8(bytesInRange(bytes, ':', '@'), bytesInRange(bytes, '[', '^'))
+          ),
+          vorrq_u8(
+            vorrq_u8(bytesEqual(bytes, '`'), bytesInRange(bytes, '{', '~')),
+            vorrq_u8(bytesEqual(bytes, '\n'), bytesEqual(bytes, '\r'))
+          )
+        );
+
+        // NEON has no movemask, so once we know the block contains a stop character we find it with the scalar loop
+        if (vmaxvq_u8(isStop) != 0) break;
+      }
+#endif
+
+      for (; i < source.length(); i++) {
+        if (IDENTIFIER_STOP_TABLE[(unsigned char) source[i]]) return i;
+      }
+
+      return source.length();
+    }
+
+    /**
+     * @brief Skips over a run of whitespace that does not contain a newline.
+     * @param source The source being scanned.
+     * @param from The index to start scanning at.
+     * @return The index of the first character at or after from that is not inline whitespace, or source.length().
+     */
+    inline size_t skipInlineWhitespace(string_view source, size_t from) {
+      size_t i = from;
+
+#if defined(THETA_SCANNERS_SSE2)
+      for (; i + 16 <= source.length(); i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source.data() + i));
+
+        // '\t', '\v', '\f' and '\r' are contiguous with '\n' in the middle, so we take the range and knock out '\n'
+        __m128i isWhitespace = _mm_or_si128(
+          bytesEqual(bytes, ' '),
+          _mm_andnot_si128(bytesEqual(bytes, '\n'), bytesInRange(bytes, '\t', '\r'))
+        );
+
+        int mask = ~_mm_movemask_epi8(isWhitespace) & 0xFFFF;
+        if (mask != 0) return i + lowestSetBit(mask);
+      }
+#elif defined(THETA_SCANNERS_NEON)
+      for (; i + 16 <= source.length(); i += 16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t *>(source.data() + i));
+
+        uint8x16_t isWhitespace = vorrq_u8(
+          bytesEqual(bytes, ' '),
+          vbicq_u8(bytesInRange(bytes, '\t', '\r'), bytesEqual(bytes, '\n'))
+        );
+
+        if (vminvq_u8(isWhitespace) == 0) break;
+      }
+#endif
+
+      for (; i < source.length(); i++) {
+        if (!isInlineWhitespace(source[i])) return i;
+      }
+
+      return source.length();
+    }
+
+    /**
+     * @brief Finds the next occurrence of a terminal, such as the end of a comment or string.
+     * @param source The source being scanned.
+     * @param from The index to start scanning at.
+     * @param terminal The text to look for. Must not be empty.
+     * @return The index that the terminal starts at, or source.length() if it doesn't occur.
+     */
+    inline size_t findTerminal(string_view source, size_t from, string_view terminal) {
+      // memchr is vectorized by every libc we build against, so we lean on it to find candidates
+      while (from < source.length()) {
+        const void *found = memchr(source.data() + from, terminal[0], source.length() - from);
+        if (!found) break;
+
+        size_t idx = static_cast<const char *>(found) - source.data();
+        if (source.compare(idx, terminal.length(), terminal) == 0) return idx;
+
+        from = idx + 1;
+      }
+
+      return source.length();
+    }
+
+    /**
+     * @brief Counts the newlines in source[from, to).
+     */
+    inline size_t countNewlines(string_view source, size_t from, size_t to) {
+      size_t count = 0;
+      size_t i = from;
+
+#if defined(THETA_SCANNERS_SSE2)
+      for (; i + 16 <= to; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source.data() + i));
+        count += __builtin_popcount(_mm_movemask_epi8(bytesEqual(bytes, '\n')));
+      }
+#elif defined(THETA_SCANNERS_NEON)
+      for (; i + 16 <= to; i += 16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t *>(source.data() + i));
+        // Each matching lane is 0xFF, so shifting down to 1 and summing gives the count
+        count += vaddvq_u8(vshrq_n_u8(bytesEqual(bytes, '\n'), 7));
+      }
+#endif
+
+      for (; i < to; i++) {
+        if (source[i] == '\n') count++;
+      }
+
+      return count;
+    }
+  }
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if !defined(_WIN32) && !defined(__MSYS__)
+#define THETA_SOURCE_FILE_MMAP
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief An immutable buffer of Theta source code. Files are memory-mapped where the platform supports it, so their
+   * contents are never copied; on Windows and MSYS builds, where we don't have mmap, they are read into memory instead.
+   * Source that doesn't come from a file (e.g. the REPL) is simply owned as a string.
+   *
+   * The lexer produces tokens that are views into this buffer, so it is shared by everything that holds on to tokens.
+   */
+  class SourceFile {
+  public:
+    /**
+     * @brief Opens a source file.
+     * @param path The path of the file to open.
+     * @param maxBytes Only load up to this many bytes from the start of the file. Useful when we only need to peek
+     * at the beginning of a file, as when discovering capsule names.
+     * @return The source file, or nullptr if the file could not be opened.
+     */
+    static shared_ptr<SourceFile> open(const string &path, size_t maxBytes = string::npos) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) return nullptr;
+
+      struct stat fileStat;
+      if (fstat(fd, &fileStat) != 0) {
+        ::close(fd);
+        return nullptr;
+      }
+
+      shared_ptr<SourceFile> file(new SourceFile());
+      size_t length = min((size_t) fileStat.st_size, maxBytes);
+      file->isTruncated = length < (size_t) fileStat.st_size;
+
+#ifdef THETA_SOURCE_FILE_MMAP
+      // Mapping an empty range is an error, so empty files just keep an empty view
+      if (length > 0) {
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapped != MAP_FAILED) {
+          file->mappedData = static_cast<const char *>(mapped);
+          file->mappedLength = length;
+          file->contents = string_view(file->mappedData, length);
+
+          ::close(fd);
+          return file;
+        }
+      }
+#endif
+
+      // Fall back to reading the file into memory
+      file->ownedContents.resize(length);
+      size_t totalRead = 0;
+      while (totalRead < length) {
+        ssize_t bytesRead = ::read(fd, &file->ownedContents[totalRead], length - totalRead);
+        if (bytesRead <= 0) break;
+
+        totalRead += bytesRead;
+      }
+
+      file->ownedContents.resize(totalRead);
+      file->contents = file->ownedContents;
+
+      ::close(fd);
+      return file;
+    }
+
+    /**
+     * @brief Wraps source code held in memory, such as input from the REPL.
+     * @param source The source code. The SourceFile takes ownership of it.
+     */
+    static shared_ptr<SourceFile> fromString(string source) {
+      shared_ptr<SourceFile> file(new SourceFile());
+      file->ownedContents = std::move(source);
+      file->contents = file->ownedContents;
+
+      return file;
+    }
+
+    /**
+     * @brief The page size of the system, which is the smallest amount of a file that mmap can load.
+     */
+    static size_t getPageSize() {
+#ifdef THETA_SOURCE_FILE_MMAP
+      static size_t pageSize = sysconf(_SC_PAGESIZE);
+      return pageSize;
+#else
+      return 4096;
+#endif
+    }
+
+    ~SourceFile() {
+#ifdef THETA_SOURCE_FILE_MMAP
+      if (mappedData) munmap(const_cast<char *>(mappedData), mappedLength);
+#endif
+    }
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    string_view view() const { return contents; }
+
+    /**
+     * @brief Where a view into the source, such as a token's lexeme, starts in it.
+     */
+    size_t offsetOf(string_view text) const { return text.data() - contents.data(); }
+
+    /**
+     * @brief Whether only part of the file was loaded because of maxBytes
+     */
+    bool truncated() const { return isTruncated; }
+
+    /**
+     * @brief The contents of a line, without its newline. The offset of every line is found the first time any line is
+     * asked for, and shared by everything that asks after, so diagnostics don't each scan the file for theirs.
+     * @param line The line, counting from 1.
+     * @return The line, or nullopt if the source doesn't have that many lines
+     */
+    optional<string_view> getLine(int line) const {
+      call_once(lineStartsIndexed, [this]() { indexLineStarts(); });
+
+      if (line < 1 || line > lineStarts.size()) return nullopt;
+
+      size_t start = lineStarts[line - 1];
+      size_t end = line < lineStarts.size() ? lineStarts[line] - 1 : contents.length();
+
+      return contents.substr(start, end - start);
+    }
+
+  private:
+    SourceFile() {}
+
+    string_view contents;
+    string ownedContents;
+    const char *mappedData = nullptr;
+    size_t mappedLength = 0;
+    bool isTruncated = false;
+
+    // The offset each line starts at, indexed by getLine on first use
+    mutable vector<size_t> lineStarts;
+    mutable once_flag lineStartsIndexed;
+
+    void indexLineStarts() const {
+      lineStarts.push_back(0);
+      if (contents.empty()) return;
+
+      const char *data = contents.data();
+      const char *end = data + contents.length();
+
+      for (const char *newline = data; (newline = static_cast<const char *>(memchr(newline, '\n', end - newline))); newline++) {
+        lineStarts.push_back(newline - data + 1);
+      }
+    }
+  };
+}
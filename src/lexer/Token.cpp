@@ -3,7 +3,7 @@
 
 Theta::Token::Token() {}
 
-Theta::Token::Token(Token::Types tokenType, string tokenLexeme) {
+Theta::Token::Token(Token::Types tokenType, string_view tokenLexeme) {
   lexeme = tokenLexeme;
   type = tokenType;
 }
@@ -12,13 +12,11 @@ Theta::Token::Types Theta::Token::getType() { return type; }
 
 void Theta::Token::setType(Theta::Token::Types tokenType) { type = tokenType; }
 
-string Theta::Token::getLexeme() { return lexeme; }
+string Theta::Token::getLexeme() { return string(lexeme); }
 
-void Theta::Token::setLexeme(string tokenText) { lexeme = tokenText;  }
+string_view Theta::Token::getLexemeView() { return lexeme; }
 
-void Theta::Token::appendLexeme(char character) { lexeme += character; }
-
-void Theta::Token::appendLexeme(string appendableText) { lexeme += appendableText; }
+void Theta::Token::setLexeme(string_view tokenText) { lexeme = tokenText;  }
 
 vector<int> Theta::Token::getStartLocation() { return { line, column }; }
 
@@ -31,11 +29,18 @@ void Theta::Token::setStartColumn(int start) { column = start; }
 string Theta::Token::toJSON() {
   ostringstream oss;
 
-  oss << "{";
-  oss << " \"type\": \"" << tokenTypeToString(type) << "\"";
-  oss << ", \"lexeme\": \"" << lexeme << "\"";
-  oss << ", \"location\": \"" << getStartLocationString() << "\"";
-  oss << " }";
+  {
+    JsonWriter writer(oss);
+    writeJSON(writer);
+  }
 
   return oss.str();
 }
+
+void Theta::Token::writeJSON(JsonWriter &writer) {
+  writer.beginObject();
+  writer.field("type", tokenTypeToString(type));
+  writer.field("lexeme", lexeme);
+  writer.field("location", getStartLocationString());
+  writer.endObject();
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include "JsonWriter.hpp"
 
 using namespace std;
 
@@ -49,22 +51,37 @@ namespace Theta {
     };
 
     Token();
-    Token(Token::Types tokenType, string tokenLexeme);
+
+    /**
+     * @brief Creates a token whose lexeme is a view into memory owned elsewhere, usually the
+     * Lexer's source buffer. The token does not copy the text, so whatever owns that memory
+     * must outlive the token.
+     */
+    Token(Token::Types tokenType, string_view tokenLexeme);
 
     Token::Types getType();
 
     void setType(Token::Types tokenType);
 
+    /**
+     * @brief Returns an owned copy of the lexeme. Use this when the text needs to outlive the source buffer,
+     * e.g. when storing it on an AST node.
+     */
     string getLexeme();
 
-    void setLexeme(string tokenText);
-
-    void appendLexeme(char character);
+    /**
+     * @brief Returns the lexeme as a view into the source buffer, without copying.
+     */
+    string_view getLexemeView();
 
-    void appendLexeme(string appendableText);
+    void setLexeme(string_view tokenText);
 
     vector<int> getStartLocation();
 
+    int getStartLine() { return line; }
+
+    int getStartColumn() { return column; }
+
     string getStartLocationString();
 
     void setStartLine(int start);
@@ -73,6 +90,11 @@ namespace Theta {
 
     string toJSON();
 
+    /**
+     * @brief Writes the token as a JSON object, without building it up as a string first.
+     */
+    void writeJSON(JsonWriter &writer);
+
     static string tokenTypeToString(Token::Types token) {
       static map<Token::Types, string> tokensMap = {
         { Token::STRING, "STRING" },
@@ -110,9 +132,9 @@ namespace Theta {
     }
 
   private:
-    string lexeme;
-    int line;
-    int column;
+    string_view lexeme;
+    int line = 0;
+    int column = 0;
     Token::Types type;
   };
 }
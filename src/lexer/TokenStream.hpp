@@ -0,0 +1,57 @@
+#pragma once
+
+#include <deque>
+#include "Token.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A source of tokens that the parser pulls from one at a time. This lets the parser consume tokens
+   * as they are produced, rather than requiring the whole file to be lexed up front.
+   */
+  class TokenStream {
+  public:
+    virtual ~TokenStream() {}
+
+    /**
+     * @brief Returns the token that is a given number of positions past the front of the stream, without consuming it.
+     * @param ahead How many tokens past the front to look. 0 is the front of the stream.
+     * @return A pointer to the token, or nullptr if the stream ends before that position. The pointer is only valid
+     * until the stream is advanced.
+     */
+    virtual Token * peek(size_t ahead = 0) = 0;
+
+    /**
+     * @brief Consumes the token at the front of the stream. Does nothing if the stream is empty.
+     */
+    virtual void advance() = 0;
+
+    bool isEmpty() { return peek() == nullptr; }
+
+    /**
+     * @brief Returns the token at the front of the stream. The stream must not be empty.
+     */
+    Token & front() { return *peek(); }
+  };
+
+  /**
+   * @brief A TokenStream backed by an already lexed deque of tokens. Tokens are removed from the deque as they
+   * are consumed, so any tokens left in it after parsing are the ones the parser didn't use.
+   */
+  class DequeTokenStream : public TokenStream {
+  public:
+    DequeTokenStream(deque<Token> &toks) : tokens(toks) {}
+
+    Token * peek(size_t ahead = 0) override {
+      return ahead < tokens.size() ? &tokens[ahead] : nullptr;
+    }
+
+    void advance() override {
+      if (!tokens.empty()) tokens.pop_front();
+    }
+
+  private:
+    deque<Token> &tokens;
+  };
+}
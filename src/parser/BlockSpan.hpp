@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "ast/BlockNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  struct BlockSpan;
+
+  /**
+   * @brief Where one element of a block is in the source, from the start of its first token to the end of its last.
+   * Offsets are bytes into the source, lines and columns count from 1 like those of tokens.
+   */
+  struct ElementSpan {
+    size_t start = 0;
+    size_t end = 0;
+    size_t firstTokenEnd = 0;
+    int line = 0;
+    int column = 0;
+
+    // The blocks nested directly in the element, such as the body of a function, in source order
+    vector<BlockSpan> blocks;
+  };
+
+  /**
+   * @brief Where a block and each of its elements are in the source, see Parser::recordBlockSpans. The block spans
+   * from its opening brace to just past its closing one, and has a span for each of its elements, in order.
+   */
+  struct BlockSpan {
+    shared_ptr<BlockNode> block;
+    size_t start = 0;
+    size_t end = 0;
+    vector<ElementSpan> elements;
+  };
+}
@@ -0,0 +1,243 @@
+#include "../lexer/Lexer.cpp"
+#include "Parser.cpp"
+#include "IncrementalParser.hpp"
+#include "ast/ASTVisitor.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace Theta;
+
+IncrementalParser::IncrementalParser(string file, string text, shared_ptr<map<string, string>> filesByCapsuleName)
+  : fileName(file), filesByCapsule(filesByCapsuleName), source(SourceFile::fromString(std::move(text))) {
+  string_view contents = source->view();
+
+  lineStarts.push_back(0);
+  for (size_t i = contents.find('\n'); i != string_view::npos; i = contents.find('\n', i + 1)) {
+    lineStarts.push_back(i + 1);
+  }
+
+  parseAll();
+}
+
+bool IncrementalParser::edit(const TextEdit &edit) {
+  string_view previousText = source->view();
+  size_t start = offsetOf(edit.startLine, edit.startColumn);
+  size_t end = offsetOf(edit.endLine, edit.endColumn);
+
+  if (end < start) throw invalid_argument("An edit can't end before it starts");
+
+  size_t lastNewline = edit.text.rfind('\n');
+  int newlines = count(edit.text.begin(), edit.text.end(), '\n');
+
+  change = {
+    start,
+    end,
+    (ptrdiff_t) edit.text.length() - (ptrdiff_t) (end - start),
+    edit.endLine,
+    edit.endColumn,
+    newlines - (edit.endLine - edit.startLine),
+    lastNewline == string::npos ? edit.startColumn + (int) edit.text.length() : (int) (edit.text.length() - lastNewline)
+  };
+
+  string text;
+  text.reserve(previousText.length() + change.delta);
+  text.append(previousText.substr(0, start));
+  text.append(edit.text);
+  text.append(previousText.substr(end));
+
+  // The text from before the edit is kept until we're done with it, to tell whether the edited element's first token changed
+  shared_ptr<const SourceFile> previousSource = source;
+  source = SourceFile::fromString(std::move(text));
+
+  updateLineStarts(edit);
+
+  if (reparseEnclosingElement(*previousSource)) return true;
+
+  parseAll();
+
+  return false;
+}
+
+void IncrementalParser::parseAll() {
+  Lexer lexer;
+  lexer.load(source);
+  LexerTokenStream tokens(lexer);
+
+  blockSpans.clear();
+  capsuleBlock = nullptr;
+
+  Parser parser;
+  parser.recordBlockSpans(&blockSpans);
+  ast = parser.parse(tokens, source, fileName, filesByCapsule);
+
+  shared_ptr<ASTNode> capsule = ast->getValue();
+  if (!capsule || capsule->getNodeType() != ASTNode::CAPSULE) return;
+
+  for (BlockSpan &span : blockSpans) {
+    if (span.block == capsule->getValue()) capsuleBlock = &span;
+  }
+}
+
+bool IncrementalParser::reparseEnclosingElement(const SourceFile &previousSource) {
+  vector<pair<BlockSpan*, size_t>> path;
+  BlockSpan *block = capsuleBlock;
+
+  // Edits that touch a block's braces change what's in it, so we only go into blocks the edit is entirely inside of
+  while (block && block->start < change.start && change.end < block->end) {
+    vector<ElementSpan> &elements = block->elements;
+    auto element = upper_bound(elements.begin(), elements.end(), change.start, [](size_t offset, const ElementSpan &span) {
+      return offset < span.start;
+    });
+
+    if (element == elements.begin()) break;
+    element--;
+
+    if (change.end > element->end) break;
+
+    path.push_back(make_pair(block, element - elements.begin()));
+
+    BlockSpan *nested = nullptr;
+    for (BlockSpan &nestedBlock : element->blocks) {
+      if (nestedBlock.start < change.start && change.end < nestedBlock.end) nested = &nestedBlock;
+    }
+
+    block = nested;
+  }
+
+  for (size_t level = path.size(); level-- > 0;) {
+    if (reparseElement(path, level, previousSource)) return true;
+  }
+
+  return false;
+}
+
+bool IncrementalParser::reparseElement(vector<pair<BlockSpan*, size_t>> &path, size_t level, const SourceFile &previousSource) {
+  auto [block, index] = path[level];
+  ElementSpan &span = block->elements[index];
+
+  // The token after the element is the next element's first, or the block's closing brace
+  size_t next = index + 1 < block->elements.size() ? block->elements[index + 1].start : block->end - 1;
+
+  Lexer lexer;
+  lexer.load(source, span.start, span.line, span.column);
+  LexerTokenStream tokens(lexer);
+
+  if (tokens.isEmpty()) return false;
+
+  // The element before this one ended where it did because of this one's first token, so that has to stay the same
+  string_view firstToken = previousSource.view().substr(span.start, span.firstTokenEnd - span.start);
+  if (index > 0 && tokens.front().getLexemeView() != firstToken) return false;
+
+  Parser parser;
+  ElementSpan reparsedSpan;
+  shared_ptr<ASTNode> element;
+  vector<shared_ptr<Theta::Error>> errors;
+
+  {
+    Compiler::ExceptionScope scope;
+    element = parser.parseElement(tokens, source, fileName, block->block, reparsedSpan);
+    errors = std::move(scope.exceptions);
+  }
+
+  // Parsing the whole document would have ended the element right where the next one starts, so this must have too
+  if (!element || tokens.isEmpty() || source->offsetOf(tokens.front().getLexemeView()) != shift(next)) return false;
+
+  shiftNodes(path, level);
+  shiftSpans(*capsuleBlock);
+
+  block->block->getElements()[index] = element;
+  block->elements[index] = std::move(reparsedSpan);
+
+  for (shared_ptr<Theta::Error> &error : errors) Compiler::getInstance().addException(error);
+
+  return true;
+}
+
+void IncrementalParser::shiftNodes(vector<pair<BlockSpan*, size_t>> &path, size_t level) {
+  for (size_t i = 0; i <= level; i++) {
+    auto [block, index] = path[i];
+    vector<shared_ptr<ASTNode>> &elements = block->block->getElements();
+
+    // The rest of the element around the next block down, such as the else branch after an if branch
+    if (i < level) shiftNodes(elements[index], path[i + 1].first->block.get());
+
+    for (size_t j = index + 1; j < elements.size(); j++) {
+      // An edit that adds or removes no lines only moves what's after it on its last line
+      if (change.lineDelta == 0 && block->elements[j].line > change.endLine) break;
+
+      shiftNodes(elements[j], nullptr);
+    }
+  }
+}
+
+void IncrementalParser::shiftNodes(const shared_ptr<ASTNode> &node, const ASTNode *skip) {
+  if (!node || node.get() == skip) return;
+
+  if (isAfterEdit(node->getLine(), node->getColumn())) {
+    int line = node->getLine();
+    int column = node->getColumn();
+
+    shiftLocation(line, column);
+    node->setSourceLocation(line, column);
+  }
+
+  forEachChild(node, [this, skip](const shared_ptr<ASTNode> &child) { shiftNodes(child, skip); });
+}
+
+void IncrementalParser::shiftSpans(BlockSpan &block) {
+  if (block.end < change.end) return;
+
+  block.start = shift(block.start);
+  block.end = shift(block.end);
+
+  // Elements that end before the edit don't move, so we start at the first one that doesn't
+  auto element = lower_bound(block.elements.begin(), block.elements.end(), change.end, [](const ElementSpan &span, size_t offset) {
+    return span.end < offset;
+  });
+
+  for (; element != block.elements.end(); element++) shiftSpans(*element);
+}
+
+void IncrementalParser::shiftSpans(ElementSpan &element) {
+  if (isAfterEdit(element.line, element.column)) shiftLocation(element.line, element.column);
+
+  element.start = shift(element.start);
+  element.firstTokenEnd = shift(element.firstTokenEnd);
+  element.end = shift(element.end);
+
+  for (BlockSpan &block : element.blocks) shiftSpans(block);
+}
+
+void IncrementalParser::shiftLocation(int &line, int &column) {
+  if (line == change.endLine) column += change.newEndColumn - change.endColumn;
+
+  line += change.lineDelta;
+}
+
+size_t IncrementalParser::offsetOf(int line, int column) {
+  if (line < 1 || (size_t) line > lineStarts.size()) throw out_of_range("No line " + to_string(line) + " in " + fileName);
+
+  size_t lineEnd = (size_t) line < lineStarts.size() ? lineStarts[line] - 1 : source->view().length();
+  size_t offset = lineStarts[line - 1] + column - 1;
+
+  if (column < 1 || offset > lineEnd) {
+    throw out_of_range("No column " + to_string(column) + " on line " + to_string(line) + " of " + fileName);
+  }
+
+  return offset;
+}
+
+void IncrementalParser::updateLineStarts(const TextEdit &edit) {
+  // Lines after the edit move along with the text
+  for (size_t line = edit.endLine; line < lineStarts.size(); line++) lineStarts[line] += change.delta;
+
+  // The lines that started in the replaced text are gone, and the new text starts its own
+  vector<size_t> insertedLineStarts;
+  for (size_t i = edit.text.find('\n'); i != string::npos; i = edit.text.find('\n', i + 1)) {
+    insertedLineStarts.push_back(change.start + i + 1);
+  }
+
+  lineStarts.erase(lineStarts.begin() + edit.startLine, lineStarts.begin() + edit.endLine);
+  lineStarts.insert(lineStarts.begin() + edit.startLine, insertedLineStarts.begin(), insertedLineStarts.end());
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lexer/SourceFile.hpp"
+#include "parser/BlockSpan.hpp"
+#include "parser/ast/ASTNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A change to a document: the text between two positions replaced with new text. Positions are lines and
+   * columns counting from 1, like those of tokens, and the end is just past the last character replaced. Inserting
+   * replaces an empty range, and deleting replaces a range with nothing.
+   */
+  struct TextEdit {
+    int startLine;
+    int startColumn;
+    int endLine;
+    int endColumn;
+    string text;
+  };
+
+  /**
+   * @brief Keeps a document parsed as it is edited, for editors and language servers, without reparsing all of it on
+   * every keystroke. An edit only relexes and reparses the innermost block element it falls in, such as a statement of a
+   * function or a member of the capsule, and the new element takes the old one's place in the tree. Every other node is
+   * kept as it was, along with any type that was resolved for it.
+   *
+   * If the element no longer ends where the next one starts, or its first token changed so the element before it might
+   * not end where it did, the element around it is tried instead. Edits that reach outside the capsule's members, such
+   * as to links or the capsule's name, reparse the whole document.
+   *
+   * Parse errors are reported to the compiler like any other parse's, only for the text that was parsed again.
+   */
+  class IncrementalParser {
+  public:
+    /**
+     * @param file The name of the document, used for error reporting.
+     * @param text The document's text.
+     * @param filesByCapsuleName Mapping of capsule names to the files that define them, used to resolve links.
+     */
+    IncrementalParser(string file, string text, shared_ptr<map<string, string>> filesByCapsuleName);
+
+    /**
+     * @brief Applies an edit to the document and reparses what it touched.
+     * @return Whether only part of the document had to be reparsed. If not, all of it was.
+     */
+    bool edit(const TextEdit &edit);
+
+    shared_ptr<ASTNode> getAST() { return ast; }
+
+    shared_ptr<const SourceFile> getSource() { return source; }
+
+  private:
+    string fileName;
+    shared_ptr<map<string, string>> filesByCapsule;
+    shared_ptr<const SourceFile> source;
+    shared_ptr<ASTNode> ast;
+
+    // The offset each line starts at, kept up to date as the document is edited
+    vector<size_t> lineStarts;
+
+    // Where every block of the document is, and the capsule's block, which edits are looked for in
+    vector<BlockSpan> blockSpans;
+    BlockSpan *capsuleBlock = nullptr;
+
+    // Where the edit being applied was in the text from before it, and how it moved everything after it
+    struct Change {
+      size_t start;
+      size_t end;
+      ptrdiff_t delta;
+      int endLine;
+      int endColumn;
+      int lineDelta;
+      int newEndColumn;
+    } change;
+
+    void parseAll();
+
+    /**
+     * @brief Reparses the innermost element that the edit falls in, or the one around it if that doesn't work out.
+     * @return Whether an element was reparsed.
+     */
+    bool reparseEnclosingElement(const SourceFile &previousSource);
+
+    /**
+     * @brief Reparses one element on the path down to the edit, and puts it in place of the old one.
+     * @param path Each block down to the edit, and the index of its element that the edit is in.
+     * @param level The element of the path to reparse.
+     * @return Whether the element could be reparsed on its own.
+     */
+    bool reparseElement(vector<pair<BlockSpan*, size_t>> &path, size_t level, const SourceFile &previousSource);
+
+    /**
+     * @brief Moves the nodes after the edit to where the edit left them: the rest of each element on the path, and the
+     * elements after them.
+     */
+    void shiftNodes(vector<pair<BlockSpan*, size_t>> &path, size_t level);
+
+    void shiftNodes(const shared_ptr<ASTNode> &node, const ASTNode *skip);
+
+    void shiftSpans(BlockSpan &block);
+
+    void shiftSpans(ElementSpan &element);
+
+    size_t shift(size_t offset) { return offset >= change.end ? offset + change.delta : offset; }
+
+    bool isAfterEdit(int line, int column) {
+      return line > change.endLine || (line == change.endLine && column >= change.endColumn);
+    }
+
+    void shiftLocation(int &line, int &column);
+
+    size_t offsetOf(int line, int column);
+
+    void updateLineStarts(const TextEdit &edit);
+  };
+}
@@ -2,9 +2,12 @@
 #include <algorithm>
 #include <deque>
 #include <string>
+#include <string_view>
 #include <map>
 #include <memory>
 #include "../lexer/Token.hpp"
+#include "../lexer/TokenStream.hpp"
+#include "../lexer/SourceFile.hpp"
 #include "exceptions/CompilationError.hpp"
 #include "exceptions/ParseError.hpp"
 #include "ast/AssignmentNode.hpp"
@@ -30,6 +33,8 @@
 #include "ast/BlockNode.hpp"
 #include "ast/TupleNode.hpp"
 #include "ast/ASTNodeList.hpp"
+#include "ast/ASTArena.hpp"
+#include "BlockSpan.hpp"
 #include "../compiler/Compiler.hpp"
 #include "../lexer/Lexemes.hpp"
 #include "../compiler/DataTypes.hpp"
@@ -39,88 +44,285 @@ using namespace std;
 namespace Theta {
   class Parser {
   public:
-    shared_ptr<ASTNode> parse(deque<Token> &tokens, string &src, string file, shared_ptr<map<string, string>> filesByCapsuleName) {
-      source = src;
-      fileName = file;
-      remainingTokens = &tokens;
-      filesByCapsule = filesByCapsuleName;
+    /**
+     * @brief Parses tokens pulled from the given stream into an AST.
+     * @param tokens The stream to pull tokens from. Tokens are consumed as they are parsed.
+     * @param src The buffer the tokens were lexed from (see Lexer::getSource). Errors share ownership of it.
+     * @param file The name of the file the tokens came from, used for error reporting.
+     * @param filesByCapsuleName Mapping of capsule names to the files that define them, used to resolve links.
+     * @param linkedCapsuleName The name of the capsule the file was linked as, if it was linked. Used to detect link cycles.
+     */
+    shared_ptr<ASTNode> parse(
+      TokenStream &tokens,
+      shared_ptr<const SourceFile> src,
+      string file,
+      shared_ptr<map<string, string>> filesByCapsuleName,
+      string linkedCapsuleName = ""
+    ) {
+      linkedCapsule = linkedCapsuleName;
+      shared_ptr<ASTNode> parsedSource = parseStream(tokens, src, file, filesByCapsuleName);
 
-      shared_ptr<ASTNode> parsedSource = parseSource();
+      // Throw parse errors for any remaining tokens after we've finished our parser run
+      for (; !tokens.isEmpty(); tokens.advance()) {
+        addUnparsedTokenError(tokens.front());
+      }
+
+      return parsedSource;
+    }
+
+    /**
+     * @brief Parses an already lexed deque of tokens into an AST. Any tokens that could not be parsed are left in the deque.
+     */
+    shared_ptr<ASTNode> parse(deque<Token> &tokens, shared_ptr<const SourceFile> src, string file, shared_ptr<map<string, string>> filesByCapsuleName) {
+      linkedCapsule = "";
+      DequeTokenStream stream(tokens);
+      shared_ptr<ASTNode> parsedSource = parseStream(stream, src, file, filesByCapsuleName);
 
       // Throw parse errors for any remaining tokens after we've finished our parser run
       for (int i = 0; i < tokens.size(); i++) {
-        Theta::Compiler::getInstance().addException(
-          make_shared<Theta::CompilationError>(
-            "ParseError",
-            "Unparsed token " + tokens[i].getLexeme(),
-            tokens[i],
-            source,
-            fileName
-          )
-        );
+        addUnparsedTokenError(tokens[i]);
       }
 
       return parsedSource;
     }
 
+    shared_ptr<ASTNode> parse(deque<Token> &tokens, string &src, string file, shared_ptr<map<string, string>> filesByCapsuleName) {
+      return parse(tokens, SourceFile::fromString(src), file, filesByCapsuleName);
+    }
+
+    /**
+     * @brief Parses one element of a block that has already been parsed, such as a member of a capsule, pulling only as
+     * many tokens as the element needs. This is how IncrementalParser reparses just the element an edit was in.
+     * @param tokens The stream to pull tokens from, starting at the element.
+     * @param src The buffer the tokens were lexed from.
+     * @param file The name of the file the tokens came from, used for error reporting.
+     * @param block The block the element is in.
+     * @param span Set to where the element and the blocks nested in it are in the source.
+     * @return The element, or nullptr if one couldn't be parsed.
+     */
+    shared_ptr<ASTNode> parseElement(
+      TokenStream &tokens,
+      shared_ptr<const SourceFile> src,
+      string file,
+      shared_ptr<BlockNode> block,
+      ElementSpan &span
+    ) {
+      linkedCapsule = "";
+      startParse(tokens, src, file, nullptr);
+      stats = nullptr;
+
+      shared_ptr<ASTNode> element;
+
+      try {
+        element = parseRecordedElement(block, span);
+      } catch (ParseError &e) {
+        element = nullptr;
+      }
+
+      arena = nullptr;
+
+      return element;
+    }
+
+    /**
+     * @brief Makes the parser note where every block it parses is in the source, and where each of the block's elements
+     * is, see BlockSpan. Blocks nested in an element go in that element's span, the rest are added to spans.
+     * @param spans Where to add the outermost blocks, or nullptr to stop recording.
+     */
+    void recordBlockSpans(vector<BlockSpan> *spans) { blockSpans = spans; }
+
+    /**
+     * @brief Whether any errors were encountered during the last parse
+     */
+    bool hasErrors() { return errorCount > 0; }
+
   private:
-    string source;
+    shared_ptr<const SourceFile> source;
     string fileName;
-    deque<Token> *remainingTokens;
+    TokenStream *remainingTokens;
+
+    struct BinaryOperatorRule {
+      const string *lexeme;
+      int precedence;
+    };
+
+    // From loosest to tightest. Unary operators bind tighter than all of these
+    static const int PIPELINE_PRECEDENCE = 0;
+    static const int BOOLEAN_PRECEDENCE = 1;
+    static const int EQUALITY_PRECEDENCE = 2;
+    static const int COMPARISON_PRECEDENCE = 3;
+    static const int TERM_PRECEDENCE = 4;
+    static const int FACTOR_PRECEDENCE = 5;
+    static const int EXPONENT_PRECEDENCE = 6;
+
+    static const vector<BinaryOperatorRule> &binaryOperatorRules() {
+      static const vector<BinaryOperatorRule> rules = {
+        { &Lexemes::PIPE, PIPELINE_PRECEDENCE },
+        { &Lexemes::OR, BOOLEAN_PRECEDENCE },
+        { &Lexemes::AND, BOOLEAN_PRECEDENCE },
+        { &Lexemes::EQUALITY, EQUALITY_PRECEDENCE },
+        { &Lexemes::INEQUALITY, EQUALITY_PRECEDENCE },
+        { &Lexemes::GT, COMPARISON_PRECEDENCE },
+        { &Lexemes::GTEQ, COMPARISON_PRECEDENCE },
+        { &Lexemes::LT, COMPARISON_PRECEDENCE },
+        { &Lexemes::LTEQ, COMPARISON_PRECEDENCE },
+        { &Lexemes::MINUS, TERM_PRECEDENCE },
+        { &Lexemes::PLUS, TERM_PRECEDENCE },
+        { &Lexemes::DIVISION, FACTOR_PRECEDENCE },
+        { &Lexemes::TIMES, FACTOR_PRECEDENCE },
+        { &Lexemes::MODULO, FACTOR_PRECEDENCE },
+        { &Lexemes::EXPONENT, EXPONENT_PRECEDENCE }
+      };
+
+      return rules;
+    }
 
     shared_ptr<map<string, string>> filesByCapsule;
+    string linkedCapsule;
     Token currentToken;
+    int errorCount = 0;
+
+    // Every node of the tree being parsed is allocated from here, and released together once the tree is no longer used
+    shared_ptr<ASTArena> arena;
+
+    // How many nodes of each type the tree has, counted only when the compiler is collecting stats
+    CompileStats *stats = nullptr;
+    map<ASTNode::Types, size_t> nodeCounts;
+
+    // Where blocks that are parsed are added, if their spans are being recorded. Points into the span of the element
+    // being parsed while nested blocks are
+    vector<BlockSpan> *blockSpans = nullptr;
+
+    // Nodes start where the token being parsed when they're made does
+    template<typename T, typename... Args>
+    shared_ptr<T> makeNode(Args&&... args) {
+      shared_ptr<T> node = arena->make<T>(std::forward<Args>(args)...);
+      node->setSourceLocation(currentToken.getStartLine(), currentToken.getStartColumn());
+
+      if (stats) nodeCounts[node->getNodeType()]++;
+
+      return node;
+    }
+
+    void startParse(TokenStream &tokens, shared_ptr<const SourceFile> src, string file, shared_ptr<map<string, string>> filesByCapsuleName) {
+      source = src;
+      fileName = file;
+      remainingTokens = &tokens;
+      filesByCapsule = filesByCapsuleName;
+      errorCount = 0;
+      arena = make_shared<ASTArena>();
+      stats = Theta::Compiler::getInstance().getCompileStats();
+      nodeCounts.clear();
+    }
+
+    shared_ptr<ASTNode> parseStream(TokenStream &tokens, shared_ptr<const SourceFile> src, string file, shared_ptr<map<string, string>> filesByCapsuleName) {
+      startParse(tokens, src, file, filesByCapsuleName);
+
+      shared_ptr<ASTNode> parsedSource = parseSource();
+
+      if (stats) stats->addAST(nodeCounts, arena->getBytesAllocated());
+
+      // The tree keeps the arena alive for as long as it needs it, the parser doesn't have to
+      arena = nullptr;
+
+      return parsedSource;
+    }
+
+    void addException(shared_ptr<Theta::Error> e) {
+      errorCount++;
+      Theta::Compiler::getInstance().addException(e);
+    }
+
+    void addUnparsedTokenError(Token &token) {
+      addException(
+        make_shared<Theta::CompilationError>(
+          "ParseError",
+          "Unparsed token " + token.getLexeme(),
+          token,
+          source,
+          fileName
+        )
+      );
+    }
 
     shared_ptr<ASTNode> parseSource() {
-      vector<shared_ptr<ASTNode>> links;
-      shared_ptr<SourceNode> sourceNode = make_shared<SourceNode>();
+      vector<Token> linkTokens;
+      shared_ptr<SourceNode> sourceNode = makeNode<SourceNode>();
 
+      // Links always come first, so we collect all of them before parsing any, which lets them be parsed in parallel
       while (match(Token::KEYWORD, Lexemes::LINK)) {
-        links.push_back(parseLink(sourceNode));
+        match(Token::IDENTIFIER);
+        linkTokens.push_back(currentToken);
       }
 
-      sourceNode->setLinks(links);
+      sourceNode->setLinks(parseLinks(linkTokens, sourceNode));
       sourceNode->setValue(parseCapsule(sourceNode));
 
       return sourceNode;
     }
 
-    shared_ptr<ASTNode> parseLink(shared_ptr<ASTNode> parent) {
-      match(Token::IDENTIFIER);
-      shared_ptr<LinkNode> linkNode = Theta::Compiler::getInstance().getIfExistsParsedLinkAST(currentToken.getLexeme());
+    vector<shared_ptr<ASTNode>> parseLinks(vector<Token> &linkTokens, shared_ptr<ASTNode> parent) {
+      vector<shared_ptr<ASTNode>> links(linkTokens.size());
+      vector<pair<size_t, shared_future<shared_ptr<LinkNode>>>> pendingLinks;
 
-      if (linkNode) return linkNode;
+      for (size_t i = 0; i < linkTokens.size(); i++) {
+        Token &linkToken = linkTokens[i];
+        string capsuleName = linkToken.getLexeme();
 
-      linkNode = make_shared<LinkNode>(currentToken.getLexeme(), parent);
+        shared_ptr<LinkNode> linkNode = Theta::Compiler::getInstance().getIfExistsParsedLinkAST(capsuleName);
+        if (linkNode) {
+          links[i] = linkNode;
+          continue;
+        }
 
-      auto fileContainingLinkedCapsule = filesByCapsule->find(currentToken.getLexeme());
+        optional<string> fileContainingLinkedCapsule = Theta::Compiler::getInstance().resolveCapsuleFile(capsuleName, filesByCapsule);
 
-      if (fileContainingLinkedCapsule == filesByCapsule->end()) {
-        Theta::Compiler::getInstance().addException(
-          make_shared<Theta::CompilationError>(
-            "LinkageError",
-            "Could not find capsule " + currentToken.getLexeme() + " referenced",
-            currentToken,
-            source,
-            fileName
-          )
-        );
-      } else {
-        shared_ptr<ASTNode> linkedAST = Theta::Compiler::getInstance().buildAST(fileContainingLinkedCapsule->second);
+        if (!fileContainingLinkedCapsule) {
+          addLinkageError("Could not find capsule " + capsuleName + " referenced", linkToken);
+
+          linkNode = makeNode<LinkNode>(capsuleName, parent);
+          Theta::Compiler::getInstance().addParsedLinkAST(capsuleName, linkNode);
+
+          links[i] = linkNode;
+          continue;
+        }
 
-        linkNode->setValue(linkedAST);
+        auto linkAST = Theta::Compiler::getInstance().requestLinkAST(capsuleName, *fileContainingLinkedCapsule, linkedCapsule, parent);
+
+        if (!linkAST) {
+          addLinkageError("Capsule " + capsuleName + " is linked in a cycle with " + linkedCapsule, linkToken);
+
+          links[i] = makeNode<LinkNode>(capsuleName, parent);
+          continue;
+        }
+
+        pendingLinks.push_back(make_pair(i, *linkAST));
       }
 
-      Theta::Compiler::getInstance().addParsedLinkAST(currentToken.getLexeme(), linkNode);
+      for (auto &[i, linkAST] : pendingLinks) {
+        links[i] = Theta::Compiler::getInstance().awaitLinkAST(linkAST);
+      }
 
-      return linkNode;
+      return links;
+    }
+
+    void addLinkageError(string message, Token &token) {
+      addException(
+        make_shared<Theta::CompilationError>(
+          "LinkageError",
+          message,
+          token,
+          source,
+          fileName
+        )
+      );
     }
 
     shared_ptr<ASTNode> parseCapsule(shared_ptr<ASTNode> parent) {
       if (match(Token::KEYWORD, Lexemes::CAPSULE)) {
         match(Token::IDENTIFIER);
 
-        shared_ptr<ASTNode> capsule = make_shared<CapsuleNode>(currentToken.getLexeme(), parent);
+        shared_ptr<ASTNode> capsule = makeNode<CapsuleNode>(currentToken.getLexeme(), parent);
         capsule->setValue(parseBlock(capsule));
 
         return capsule;
@@ -129,9 +331,61 @@ namespace Theta {
       return parseAssignment(parent);
     }
 
+    /**
+     * @brief Parses an annotated element of a block, such as `@memo fib<...> = ...`. Annotations are an AT followed by a
+     * name and then the identifier being assigned, which tells them apart from struct declarations like `@Point { ... }`.
+     * Only functions declared directly in a capsule can be annotated.
+     */
+    shared_ptr<ASTNode> parseAnnotation(shared_ptr<ASTNode> parent) {
+      if (!check(Token::AT)) return parseReturn(parent);
+
+      Token *name = remainingTokens->peek(1);
+      Token *annotated = remainingTokens->peek(2);
+
+      if (
+        !name || name->getType() != Token::IDENTIFIER || name->getLexemeView() != Lexemes::MEMO ||
+        !annotated || annotated->getType() != Token::IDENTIFIER
+      ) {
+        return parseReturn(parent);
+      }
+
+      match(Token::AT);
+      match(Token::IDENTIFIER);
+      Token annotation = currentToken;
+
+      shared_ptr<ASTNode> expr = parseReturn(parent);
+
+      bool isCapsuleFunction = (
+        parent->getParent() &&
+        parent->getParent()->getNodeType() == ASTNode::CAPSULE &&
+        expr &&
+        expr->getNodeType() == ASTNode::ASSIGNMENT &&
+        expr->getRight() &&
+        expr->getRight()->getNodeType() == ASTNode::FUNCTION_DECLARATION
+      );
+
+      if (!isCapsuleFunction) {
+        addException(
+          make_shared<Theta::CompilationError>(
+            "SyntaxError",
+            "Only functions declared in a capsule can be memoized",
+            annotation,
+            source,
+            fileName
+          )
+        );
+
+        return expr;
+      }
+
+      dynamic_pointer_cast<FunctionDeclarationNode>(expr->getRight())->setIsMemoized(true);
+
+      return expr;
+    }
+
     shared_ptr<ASTNode> parseReturn(shared_ptr<ASTNode> parent) {
       if (match(Token::KEYWORD, Lexemes::RETURN)) {
-        shared_ptr<ASTNode> ret = make_shared<ReturnNode>(parent);
+        shared_ptr<ASTNode> ret = makeNode<ReturnNode>(parent);
         ret->setValue(parseAssignment(ret));
 
         return ret;
@@ -144,10 +398,10 @@ namespace Theta {
       if (match(Token::KEYWORD, Lexemes::STRUCT)) {
         match(Token::IDENTIFIER);
 
-        shared_ptr<StructDefinitionNode> str = make_shared<StructDefinitionNode>(currentToken.getLexeme(), parent);
+        shared_ptr<StructDefinitionNode> str = makeNode<StructDefinitionNode>(currentToken.getLexeme(), parent);
 
         if (!match(Token::BRACE_OPEN)) {
-          Theta::Compiler::getInstance().addException(
+          addException(
             make_shared<Theta::CompilationError>(
               "SyntaxError",
               "Expected open brace during struct definition",
@@ -183,7 +437,7 @@ namespace Theta {
       if (match(Token::ASSIGNMENT)) {
         shared_ptr<ASTNode> left = expr;
 
-        expr = make_shared<AssignmentNode>(parent);
+        expr = makeNode<AssignmentNode>(parent);
 
         left->setParent(expr);
 
@@ -197,39 +451,93 @@ namespace Theta {
     shared_ptr<ASTNode> parseBlock(shared_ptr<ASTNode> parent) {
       if (match(Token::BRACE_OPEN)) {
         vector<shared_ptr<ASTNode>> blockExpr;
-        shared_ptr<BlockNode> block = make_shared<BlockNode>(parent);
+        shared_ptr<BlockNode> block = makeNode<BlockNode>(parent);
+        BlockSpan blockSpan;
+
+        if (blockSpans) blockSpan = { block, source->offsetOf(currentToken.getLexemeView()) };
+
+        bool isClosed = true;
 
         while (!match(Token::BRACE_CLOSE)) {
-          shared_ptr<ASTNode> expr = parseReturn(block);
+          shared_ptr<ASTNode> expr;
 
-          if (expr == nullptr) break;
+          if (blockSpans) {
+            ElementSpan elementSpan;
+            expr = parseRecordedElement(block, elementSpan);
+
+            if (expr) blockSpan.elements.push_back(std::move(elementSpan));
+          } else {
+            expr = parseAnnotation(block);
+          }
+
+          if (expr == nullptr) {
+            isClosed = false;
+            break;
+          }
 
           blockExpr.push_back(expr);
         }
 
         block->setElements(blockExpr);
 
+        // A block that wasn't closed doesn't end at a brace, so it can't be told apart from what comes after it
+        if (blockSpans && isClosed) {
+          blockSpan.end = source->offsetOf(currentToken.getLexemeView()) + currentToken.getLexemeView().length();
+          blockSpans->push_back(std::move(blockSpan));
+        }
+
         return block;
       }
 
       return parseFunctionDeclaration(parent);
     }
 
+    /**
+     * @brief Parses the next element of a block, noting where it is in the source and collecting the spans of the
+     * blocks nested in it.
+     */
+    shared_ptr<ASTNode> parseRecordedElement(shared_ptr<BlockNode> block, ElementSpan &span) {
+      if (remainingTokens->isEmpty()) return parseAnnotation(block);
+
+      Token &first = remainingTokens->front();
+      span.start = source->offsetOf(first.getLexemeView());
+      span.firstTokenEnd = span.start + first.getLexemeView().length();
+      span.line = first.getStartLine();
+      span.column = first.getStartColumn();
+
+      vector<BlockSpan> *enclosingBlockSpans = blockSpans;
+      blockSpans = &span.blocks;
+
+      shared_ptr<ASTNode> element;
+
+      try {
+        element = parseAnnotation(block);
+      } catch (ParseError &e) {
+        blockSpans = enclosingBlockSpans;
+        throw;
+      }
+
+      blockSpans = enclosingBlockSpans;
+      span.end = source->offsetOf(currentToken.getLexemeView()) + currentToken.getLexemeView().length();
+
+      return element;
+    }
+
     shared_ptr<ASTNode> parseFunctionDeclaration(shared_ptr<ASTNode> parent) {
       shared_ptr<ASTNode> expr = parseAssignment(parent);
 
       if (match(Token::FUNC_DECLARATION)) {
-        shared_ptr<FunctionDeclarationNode> func_def = make_shared<FunctionDeclarationNode>(parent);
+        shared_ptr<FunctionDeclarationNode> func_def = makeNode<FunctionDeclarationNode>(parent);
 
         if (expr && expr->getNodeType() != ASTNode::AST_NODE_LIST) {
-          shared_ptr<ASTNodeList> parameters = make_shared<ASTNodeList>(func_def);
+          shared_ptr<ASTNodeList> parameters = makeNode<ASTNodeList>(func_def);
           expr->setParent(parameters);
 
           parameters->setElements({ expr });
 
           expr = parameters;
         } else if (!expr) {
-          expr = make_shared<ASTNodeList>(func_def);
+          expr = makeNode<ASTNodeList>(func_def);
         }
 
         shared_ptr<ASTNodeList> params = dynamic_pointer_cast<ASTNodeList>(expr); 
@@ -244,7 +552,7 @@ namespace Theta {
         // In the case of shorthand single-line function bodies, we still want to wrap them in a block within the ast
         // for scoping reasons
         if (definitionBlock->getNodeType() != ASTNode::BLOCK) {
-          shared_ptr<BlockNode> block = make_shared<BlockNode>(func_def);
+          shared_ptr<BlockNode> block = makeNode<BlockNode>(func_def);
           definitionBlock->setParent(block);
 
           block->setElements({ definitionBlock });
@@ -268,7 +576,7 @@ namespace Theta {
       if (match(Token::AT)) {
         match(Token::IDENTIFIER);
 
-        shared_ptr<StructDeclarationNode> str = make_shared<StructDeclarationNode>(currentToken.getLexeme(), parent);
+        shared_ptr<StructDeclarationNode> str = makeNode<StructDeclarationNode>(currentToken.getLexeme(), parent);
 
         match(Token::BRACE_OPEN);
 
@@ -284,11 +592,11 @@ namespace Theta {
       if (match(Token::KEYWORD, Lexemes::ENUM)) {
         match(Token::IDENTIFIER);
 
-        shared_ptr<EnumNode> root = make_shared<EnumNode>(parent);
+        shared_ptr<EnumNode> root = makeNode<EnumNode>(parent);
         root->setIdentifier(parseIdentifier(root));
 
         if (!match(Token::BRACE_OPEN)) {
-          Theta::Compiler::getInstance().addException(
+          addException(
             make_shared<Theta::CompilationError>(
               "SyntaxError",
               "Expected opening brace during enum declaration",
@@ -305,7 +613,7 @@ namespace Theta {
 
         while (!match(Token::BRACE_CLOSE)) {
           if (!match(Token::COLON)) {
-            Theta::Compiler::getInstance().addException(
+            addException(
               make_shared<Theta::CompilationError>(
                 "SyntaxError",
                 "Enum must only contain symbols",
@@ -315,7 +623,7 @@ namespace Theta {
               )
             );
 
-            remainingTokens->pop_front();
+            remainingTokens->advance();
 
             continue;
           }
@@ -337,7 +645,7 @@ namespace Theta {
 
     shared_ptr<ASTNode> parseControlFlow(shared_ptr<ASTNode> parent) {
       if (match(Token::KEYWORD, Lexemes::IF)) {
-        shared_ptr<ControlFlowNode> cfNode = make_shared<ControlFlowNode>(parent);
+        shared_ptr<ControlFlowNode> cfNode = makeNode<ControlFlowNode>(parent);
 
         shared_ptr<ASTNode> cnd = parseExpression(cfNode);
         shared_ptr<ASTNode> expr = parseBlock(cfNode);
@@ -353,7 +661,7 @@ namespace Theta {
         }
 
         // If we just matched an else but no if afterwards. This way it only matches one else block per control flow
-        if (currentToken.getType() == Token::KEYWORD && currentToken.getLexeme() == Lexemes::ELSE) {
+        if (currentToken.getType() == Token::KEYWORD && currentToken.getLexemeView() == Lexemes::ELSE) {
           conditionExpressionPairs.push_back(make_pair(nullptr, parseBlock(cfNode)));
         }
 
@@ -362,128 +670,72 @@ namespace Theta {
         return cfNode;
       }
 
-      return parsePipeline(parent);
+      return parseBinaryOperation(parent, PIPELINE_PRECEDENCE);
     }
 
-    shared_ptr<ASTNode> parsePipeline(shared_ptr<ASTNode> parent) {
-      shared_ptr<ASTNode> expr = parseBooleanComparison(parent);
-
-      while (match(Token::OPERATOR, Lexemes::PIPE)) {
-        expr = parseBooleanComparison(parent, expr);
-      }
-
-      return expr;
-    }
-
-    shared_ptr<ASTNode> parseBooleanComparison(shared_ptr<ASTNode> parent, shared_ptr<ASTNode> passedLeftArg = nullptr) {
-      shared_ptr<ASTNode> expr = parseEquality(parent, passedLeftArg);
-
-      while (match(Token::OPERATOR, Lexemes::OR) || match(Token::OPERATOR, Lexemes::AND)) {
-        shared_ptr<ASTNode> left = expr;
-
-        expr = make_shared<BinaryOperationNode>(currentToken.getLexeme(), parent);
-        left->setParent(expr);
-
-        expr->setLeft(left);
-        expr->setRight(parseExpression(expr));
-      }
-
-      return expr;
-    }
-
-    shared_ptr<ASTNode> parseEquality(shared_ptr<ASTNode>parent, shared_ptr<ASTNode> passedLeftArg = nullptr) {
-      shared_ptr<ASTNode> expr = parseComparison(parent, passedLeftArg);
-
-      while (match(Token::OPERATOR, Lexemes::EQUALITY) || match(Token::OPERATOR, Lexemes::INEQUALITY)) {
-        shared_ptr<ASTNode> left = expr;
-
-        expr = make_shared<BinaryOperationNode>(currentToken.getLexeme(), parent);
-        left->setParent(expr);
-    
-        expr->setLeft(left);
-        expr->setRight(parseComparison(expr));
-      }
-
-      return expr;
-    }
-
-    shared_ptr<ASTNode> parseComparison(shared_ptr<ASTNode> parent, shared_ptr<ASTNode> passedLeftArg = nullptr) {
-      shared_ptr<ASTNode> expr = parseTerm(parent, passedLeftArg);
-
-      while (
-        match(Token::OPERATOR, Lexemes::GT) ||
-        match(Token::OPERATOR, Lexemes::GTEQ) ||
-        match(Token::OPERATOR, Lexemes::LT) ||
-        match(Token::OPERATOR, Lexemes::LTEQ)
-      ) {
-        shared_ptr<ASTNode> left = expr;
-
-        expr = make_shared<BinaryOperationNode>(currentToken.getLexeme(), parent);
-        left->setParent(expr);
+    /**
+     * @brief Parses a chain of binary operations by precedence climbing. Operators that bind tighter than minPrecedence
+     * are parsed as the right operand of the operator before them, anything looser is left for the caller.
+     * @param parent The parent of the resulting expression.
+     * @param minPrecedence The loosest operator this call is allowed to consume.
+     * @param passedLeftArg The left side of a pipeline, which becomes the first argument of the function invocation
+     * the right side starts with.
+     */
+    shared_ptr<ASTNode> parseBinaryOperation(shared_ptr<ASTNode> parent, int minPrecedence, shared_ptr<ASTNode> passedLeftArg = nullptr) {
+      shared_ptr<ASTNode> expr = parseUnary(parent, passedLeftArg);
 
-        expr->setLeft(left);
-        expr->setRight(parseTerm(expr));
-      }
+      while (true) {
+        int precedence = peekBinaryOperatorPrecedence();
+        if (precedence < minPrecedence) break;
 
-      return expr;
-    }
+        currentToken = remainingTokens->front();
+        remainingTokens->advance();
 
-    shared_ptr<ASTNode> parseTerm(shared_ptr<ASTNode> parent, shared_ptr<ASTNode> passedLeftArg = nullptr) {
-      shared_ptr<ASTNode> expr = parseFactor(parent, passedLeftArg);
+        if (precedence == PIPELINE_PRECEDENCE) {
+          expr = parseBinaryOperation(parent, PIPELINE_PRECEDENCE + 1, expr);
+          continue;
+        }
 
-      while (match(Token::OPERATOR, Lexemes::MINUS) || match(Token::OPERATOR, Lexemes::PLUS)) {
         shared_ptr<ASTNode> left = expr;
 
-        expr = make_shared<BinaryOperationNode>(currentToken.getLexeme(), parent);
+        expr = makeNode<BinaryOperationNode>(currentToken.getLexeme(), parent);
         left->setParent(expr);
 
         expr->setLeft(left);
-        expr->setRight(parseFactor(expr));
-      }
-
-      return expr;
-    }
-
-    shared_ptr<ASTNode> parseFactor(shared_ptr<ASTNode> parent, shared_ptr<ASTNode> passedLeftArg = nullptr) {
-      shared_ptr<ASTNode> expr = parseExponent(parent, passedLeftArg);
 
-      while (
-        match(Token::OPERATOR, Lexemes::DIVISION) ||
-        match(Token::OPERATOR, Lexemes::TIMES) ||
-        match(Token::OPERATOR, Lexemes::MODULO)
-      ) {
-        shared_ptr<ASTNode> left = expr;
-
-        expr = make_shared<BinaryOperationNode>(currentToken.getLexeme(), parent);
-        left->setParent(expr);
-
-        expr->setLeft(left);
-        expr->setRight(parseExponent(expr));
+        // Boolean operators take the whole expression to their right as their right operand, so they group to the
+        // right. Everything else groups to the left
+        if (precedence == BOOLEAN_PRECEDENCE) {
+          expr->setRight(parseExpression(expr));
+        } else {
+          expr->setRight(parseBinaryOperation(expr, precedence + 1));
+        }
       }
 
       return expr;
     }
 
-    shared_ptr<ASTNode> parseExponent(shared_ptr<ASTNode>parent, shared_ptr<ASTNode> passedLeftArg = nullptr) {
-      shared_ptr<ASTNode> expr = parseUnary(parent, passedLeftArg);
-
-      while (match(Token::OPERATOR, Lexemes::EXPONENT)) {
-        shared_ptr<ASTNode> left = expr;
+    /**
+     * @brief Returns the precedence of the binary operator at the front of the stream, or -1 if it doesn't start with one
+     */
+    int peekBinaryOperatorPrecedence() {
+      if (remainingTokens->isEmpty()) return -1;
 
-        expr = make_shared<BinaryOperationNode>(currentToken.getLexeme(), parent);
-        left->setParent(expr);
+      Token &next = remainingTokens->front();
+      if (next.getType() != Token::OPERATOR) return -1;
 
-        expr->setLeft(left);
-        expr->setRight(parseUnary(expr));
+      string_view lexeme = next.getLexemeView();
+      for (const BinaryOperatorRule &rule : binaryOperatorRules()) {
+        if (*rule.lexeme == lexeme) return rule.precedence;
       }
 
-      return expr;
+      return -1;
     }
 
     shared_ptr<ASTNode> parseUnary(shared_ptr<ASTNode> parent, shared_ptr<ASTNode> passedLeftArg = nullptr) {
       // Unary cant have a left arg, so if we get one passed in we can skip straight to primary
       if (!passedLeftArg && (match(Token::OPERATOR, Lexemes::NOT) || match(Token::OPERATOR, Lexemes::MINUS))) {
-        shared_ptr<ASTNode> un = make_shared<UnaryOperationNode>(currentToken.getLexeme(), parent);
+        shared_ptr<ASTNode> un = makeNode<UnaryOperationNode>(currentToken.getLexeme(), parent);
         un->setValue(parseUnary(un, passedLeftArg));
 
         return un;
@@ -515,7 +767,7 @@ namespace Theta {
           value = value.substr(1, value.length() - 2);
         }
 
-        return make_shared<LiteralNode>(it->second, value, parent);
+        return makeNode<LiteralNode>(it->second, value, parent);
       }
 
       if (match(Token::COLON)) {
@@ -541,7 +793,7 @@ namespace Theta {
       shared_ptr<ASTNode> expr = parseFunctionDeclaration(parent);
 
       if (check(Token::COMMA) || !expr || forceList) {
-        shared_ptr<ASTNodeList> nodeList = make_shared<ASTNodeList>(parent);
+        shared_ptr<ASTNodeList> nodeList = makeNode<ASTNodeList>(parent);
         vector<shared_ptr<ASTNode>> expressions;
 
         if (expr) {
@@ -576,7 +828,7 @@ namespace Theta {
           el.push_back(parseKvPair(parent).second);
         }
 
-        expr = make_shared<DictionaryNode>(parent);
+        expr = makeNode<DictionaryNode>(parent);
 
         for (auto e : el) {
           e->setParent(expr);
@@ -602,10 +854,10 @@ namespace Theta {
         shared_ptr<ASTNode> left = expr;
 
         if (left->getNodeType() == ASTNode::IDENTIFIER) {
-          left = make_shared<SymbolNode>(dynamic_pointer_cast<IdentifierNode>(left)->getIdentifier(), expr);
+          left = makeNode<SymbolNode>(dynamic_pointer_cast<IdentifierNode>(left)->getIdentifier(), expr);
         }
 
-        expr = make_shared<TupleNode>(parent);
+        expr = makeNode<TupleNode>(parent);
         left->setParent(expr);
     
         expr->setLeft(left);
@@ -614,7 +866,7 @@ namespace Theta {
         // parseTuplen will return a nullptr if it just immediately encounters a BRACE_CLOSE. We can treat this
         // as a dict since a valid tuple must have 2 values in it.
         type = "kv";
-        expr = make_shared<TupleNode>(parent);
+        expr = makeNode<TupleNode>(parent);
       }
 
       return make_pair(type, expr);
@@ -628,24 +880,24 @@ namespace Theta {
       try {
         expr = parseExpression(parent);
       } catch (ParseError e) {
-        if (e.getErrorParseType() == "symbol") remainingTokens->pop_front();
+        if (e.getErrorParseType() == "symbol") remainingTokens->advance();
       }
 
       if (match(Token::COMMA)) {
         shared_ptr<ASTNode> first = expr;
 
-        expr = make_shared<TupleNode>(parent);
+        expr = makeNode<TupleNode>(parent);
         first->setParent(expr);
         expr->setLeft(first);
 
         try {
           expr->setRight(parseExpression(expr));
         } catch (ParseError e) {
-          if (e.getErrorParseType() == "symbol") remainingTokens->pop_front();
+          if (e.getErrorParseType() == "symbol") remainingTokens->advance();
         }
 
         if (!match(Token::BRACE_CLOSE)) {
-          Theta::Compiler::getInstance().addException(
+          addException(
             make_shared<Theta::CompilationError>(
               "SyntaxError",
               "Expected closing brace after tuple definition",
@@ -661,7 +913,7 @@ namespace Theta {
     }
 
     shared_ptr<ASTNode> parseList(shared_ptr<ASTNode> parent) {
-      shared_ptr<ListNode> listNode = make_shared<ListNode>(parent);
+      shared_ptr<ListNode> listNode = makeNode<ListNode>(parent);
       vector<shared_ptr<ASTNode>> el;
 
       if (!match(Token::BRACKET_CLOSE)) {
@@ -683,7 +935,7 @@ namespace Theta {
       shared_ptr<ASTNode> expr = parseIdentifier(parent);
 
       if (match(Token::PAREN_OPEN)) {
-        shared_ptr<FunctionInvocationNode> funcInvNode = make_shared<FunctionInvocationNode>(parent);
+        shared_ptr<FunctionInvocationNode> funcInvNode = makeNode<FunctionInvocationNode>(parent);
         expr->setParent(funcInvNode);
         funcInvNode->setIdentifier(expr);
         shared_ptr<ASTNodeList> arguments = dynamic_pointer_cast<ASTNodeList>(parseExpressionList(funcInvNode, true));
@@ -705,7 +957,7 @@ namespace Theta {
     shared_ptr<ASTNode> parseIdentifier(shared_ptr<ASTNode> parent) {
       validateIdentifier(currentToken);
 
-      shared_ptr<ASTNode> ident = make_shared<IdentifierNode>(currentToken.getLexeme(), parent);
+      shared_ptr<ASTNode> ident = makeNode<IdentifierNode>(currentToken.getLexeme(), parent);
 
       if (match(Token::OPERATOR, Lexemes::LT)) {
         ident->setValue(parseType(ident));
@@ -720,7 +972,7 @@ namespace Theta {
       match(Token::IDENTIFIER);
 
       string typeName = currentToken.getLexeme();
-      shared_ptr<ASTNode> typ = make_shared<TypeDeclarationNode>(typeName, parent);
+      shared_ptr<ASTNode> typ = makeNode<TypeDeclarationNode>(typeName, parent);
 
       if (match(Token::OPERATOR, Lexemes::LT)) {
         shared_ptr<TypeDeclarationNode> typeDecl = dynamic_pointer_cast<TypeDeclarationNode>(typ);
@@ -746,10 +998,10 @@ namespace Theta {
       if (match(Token::IDENTIFIER) || match(Token::NUMBER)) {
         if (currentToken.getType() == Token::IDENTIFIER) validateIdentifier(currentToken);
 
-        return make_shared<SymbolNode>(currentToken.getLexeme(), parent);
+        return makeNode<SymbolNode>(currentToken.getLexeme(), parent);
       }
 
-      Theta::Compiler::getInstance().addException(
+      addException(
         make_shared<Theta::CompilationError>(
           "SyntaxError",
           "Expected identifier as part of symbol declaration",
@@ -764,20 +1016,20 @@ namespace Theta {
       return nullptr;
     }
 
-    bool match(Token::Types type, string lexeme = "") {
+    bool match(Token::Types type, string_view lexeme = "") {
       if (check(type, lexeme)) {
         currentToken = remainingTokens->front();
-        remainingTokens->pop_front();
+        remainingTokens->advance();
         return true;
       }
 
       return false;
     }
 
-    bool check(Token::Types type, string lexeme = "") {
-      return remainingTokens->size() != 0 &&
+    bool check(Token::Types type, string_view lexeme = "") {
+      return !remainingTokens->isEmpty() &&
         remainingTokens->front().getType() == type &&
-        (lexeme != "" ? remainingTokens->front().getLexeme() == lexeme : true);
+        (lexeme != "" ? remainingTokens->front().getLexemeView() == lexeme : true);
     }
 
     /**
@@ -793,14 +1045,16 @@ namespace Theta {
     void validateIdentifier(Token token) {
       string disallowedIdentifierChars = "!@#$%^&*()-=+/<>{}[]|?,`~";
 
-      for (int i = 0; i < token.getLexeme().length(); i++) {
-        char identChar = tolower(token.getLexeme()[i]);
+      string_view lexeme = token.getLexemeView();
+
+      for (int i = 0; i < lexeme.length(); i++) {
+        char identChar = tolower(lexeme[i]);
 
         bool isDisallowedChar = find(disallowedIdentifierChars.begin(), disallowedIdentifierChars.end(), identChar) != disallowedIdentifierChars.end();
         bool isStartsWithDigit = i == 0 && isdigit(identChar);
 
         if (isStartsWithDigit || isDisallowedChar) {
-          Theta::Compiler::getInstance().addException(
+          addException(
             make_shared<Theta::CompilationError>(
               "SyntaxError",
               "Invalid identifier \"" + token.getLexeme() + "\"",
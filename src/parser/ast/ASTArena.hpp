@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A bump allocator that AST nodes are allocated out of. Allocating a node is just a pointer increment, and
+   * nodes are never freed individually: the arena's memory is released all at once, when the last node allocated
+   * from it goes away.
+   *
+   * Nodes are still handed out as regular shared_ptrs, so nothing that consumes the AST needs to know about the arena.
+   * Every node's control block holds a reference to the arena it came from, which is what guarantees that the arena
+   * outlives anything still pointing into it (a cached link AST, a type stored in a symbol table, and so on).
+   */
+  class ASTArena : public enable_shared_from_this<ASTArena> {
+  public:
+    /**
+     * @brief Allocator that hands out memory from an arena. Deallocation is a no-op, the memory is reclaimed when the
+     * arena is destroyed.
+     */
+    template<typename T>
+    class Allocator {
+    public:
+      using value_type = T;
+
+      Allocator(shared_ptr<ASTArena> a) : arena(std::move(a)) {}
+
+      template<typename U>
+      Allocator(const Allocator<U> &other) : arena(other.arena) {}
+
+      T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+
+      void deallocate(T*, size_t) {}
+
+      template<typename U>
+      bool operator==(const Allocator<U> &other) const { return arena == other.arena; }
+
+      template<typename U>
+      bool operator!=(const Allocator<U> &other) const { return arena != other.arena; }
+
+    private:
+      template<typename U> friend class Allocator;
+
+      shared_ptr<ASTArena> arena;
+    };
+
+    /**
+     * @param size The size of each block of memory the arena reserves at a time.
+     */
+    ASTArena(size_t size = DEFAULT_BLOCK_SIZE) : blockSize(size) {}
+
+    ~ASTArena() {
+      for (void *block : blocks) free(block);
+    }
+
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+
+    /**
+     * @brief Constructs a node in the arena.
+     * @param args The arguments to pass to the node's constructor.
+     * @return A shared pointer to the node.
+     */
+    template<typename T, typename... Args>
+    shared_ptr<T> make(Args&&... args) {
+      return allocate_shared<T>(Allocator<T>(shared_from_this()), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Reserves a chunk of memory from the arena.
+     * @param size The number of bytes to reserve.
+     * @param alignment The alignment the chunk must have. Must be a power of two.
+     * @return A pointer to the start of the chunk.
+     */
+    void* allocate(size_t size, size_t alignment) {
+      // Allocations that would waste most of a block get one to themselves, and don't disturb the current one
+      if (size + alignment > blockSize / 2) {
+        bytesAllocated += size;
+        return alignUp(allocateBlock(size + alignment), alignment);
+      }
+
+      char *start = cursor ? alignUp(cursor, alignment) : nullptr;
+      if (!start || start + size > blockEnd) {
+        cursor = allocateBlock(blockSize);
+        blockEnd = cursor + blockSize;
+        start = alignUp(cursor, alignment);
+      }
+
+      cursor = start + size;
+      bytesAllocated += size;
+
+      return start;
+    }
+
+    /**
+     * @brief The number of bytes that have been handed out by the arena so far
+     */
+    size_t getBytesAllocated() const { return bytesAllocated; }
+
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+  private:
+    size_t blockSize;
+    vector<void*> blocks;
+    char *cursor = nullptr;
+    char *blockEnd = nullptr;
+    size_t bytesAllocated = 0;
+
+    char* allocateBlock(size_t size) {
+      void *block = malloc(size);
+      if (!block) throw bad_alloc();
+
+      blocks.push_back(block);
+
+      return static_cast<char*>(block);
+    }
+
+    static char* alignUp(char *ptr, size_t alignment) {
+      uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+      return reinterpret_cast<char*>((address + alignment - 1) & ~(uintptr_t) (alignment - 1));
+    }
+  };
+}
@@ -1,3 +1,15 @@
 #include "ASTNode.hpp"
+#include <sstream>
 
-int Theta::ASTNode::nextId = 0;
+atomic<int> Theta::ASTNode::nextId(0);
+
+string Theta::ASTNode::toJSON() const {
+  ostringstream oss;
+
+  {
+    JsonWriter writer(oss);
+    writeJSON(writer);
+  }
+
+  return oss.str();
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include <memory>
 #include <map>
+#include "../../lexer/JsonWriter.hpp"
 
 using namespace std;
 
@@ -44,22 +46,40 @@ namespace Theta {
       UNARY_OPERATION
     };
 
-    static int nextId;
+    // Atomic because linked capsules are parsed on several threads at once
+    static atomic<int> nextId;
     virtual ASTNode::Types getNodeType() { return nodeType; }
     virtual string getNodeTypePretty() const { return nodeTypeToString(nodeType); }
-    virtual string toJSON() const = 0;
+
+    /**
+     * @brief The node and everything under it as JSON. Dumps of whole trees write into a JsonWriter instead, see
+     * writeJSON, so that no subtree is built up as a string of its own.
+     */
+    string toJSON() const;
+
+    /**
+     * @brief Writes the node and everything under it as a JSON object, each child writing itself into the same writer.
+     */
+    virtual void writeJSON(JsonWriter &writer) const = 0;
+
     int id;
     ASTNode::Types nodeType;
     shared_ptr<ASTNode> value;
     shared_ptr<ASTNode> left;
     shared_ptr<ASTNode> right;
     shared_ptr<ASTNode> resolvedType;
-    shared_ptr<ASTNode> parent;
+
+    // Parents are not owned by their children, otherwise every AST would be a reference cycle and never get freed
+    weak_ptr<ASTNode> parent;
     int mappedBinaryenIndex;
 
+    // Where in the source the node starts, 1-based. 0 if the node didn't come from the source, such as nodes made by
+    // optimization passes
+    int line = 0;
+    int column = 0;
+
     ASTNode(ASTNode::Types type, shared_ptr<ASTNode> par) : nodeType(type), parent(par), value(nullptr) {
-      id = nextId;
-      nextId++;
+      id = nextId++;
     };
 
     virtual int getId() { return id; }
@@ -77,7 +97,19 @@ namespace Theta {
     virtual void setMappedBinaryenIndex(int idx) { mappedBinaryenIndex = idx; }
 
     virtual void setParent(shared_ptr<ASTNode> parentNode) { parent = parentNode; }
-    virtual shared_ptr<ASTNode>& getParent() { return parent; }
+
+    void setSourceLocation(int sourceLine, int sourceColumn) {
+      line = sourceLine;
+      column = sourceColumn;
+    }
+
+    int getLine() { return line; }
+    int getColumn() { return column; }
+
+    /**
+     * @brief Returns the parent of this node, or nullptr if it has none or the parent no longer exists.
+     */
+    virtual shared_ptr<ASTNode> getParent() { return parent.lock(); }
 
     void setResolvedType(shared_ptr<ASTNode> typeNode) { resolvedType = typeNode; }
     shared_ptr<ASTNode> getResolvedType() { return resolvedType; }
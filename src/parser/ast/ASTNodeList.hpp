@@ -15,31 +15,21 @@ namespace Theta {
 
     ASTNodeList(shared_ptr<ASTNode> parent, ASTNode::Types type = ASTNode::AST_NODE_LIST) : ASTNode(type, parent) {};
 
-    void setElements(vector<shared_ptr<ASTNode>> el) { elements = el; }
+    virtual void setElements(vector<shared_ptr<ASTNode>> el) { elements = el; }
 
     vector<shared_ptr<ASTNode>>& getElements() { return elements; }
 
     bool hasMany() override { return true; }
 
-    string toJSON() const override {
-      ostringstream oss;
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("elements").beginArray();
 
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-      oss << "\"elements\": [";
+      for (auto &element : elements) writer.node(element);
 
-      for (int i = 0; i < elements.size(); i++) {
-          if (i > 0) {
-              oss << ", ";
-          }
-
-          oss << (elements[i] ? elements[i]->toJSON() : "null");
-      }
-
-      oss << "] ";
-      oss << "}";
-
-      return oss.str();
+      writer.endArray();
+      writer.endObject();
     }
   };
 }
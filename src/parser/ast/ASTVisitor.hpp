@@ -0,0 +1,148 @@
+#pragma once
+
+#include <memory>
+#include "ASTNode.hpp"
+#include "ASTNodeList.hpp"
+#include "AssignmentNode.hpp"
+#include "BinaryOperationNode.hpp"
+#include "BlockNode.hpp"
+#include "CapsuleNode.hpp"
+#include "ControlFlowNode.hpp"
+#include "DictionaryNode.hpp"
+#include "EnumNode.hpp"
+#include "FunctionDeclarationNode.hpp"
+#include "FunctionInvocationNode.hpp"
+#include "IdentifierNode.hpp"
+#include "LinkNode.hpp"
+#include "ListNode.hpp"
+#include "LiteralNode.hpp"
+#include "ReturnNode.hpp"
+#include "SourceNode.hpp"
+#include "StructDeclarationNode.hpp"
+#include "StructDefinitionNode.hpp"
+#include "SymbolNode.hpp"
+#include "TupleNode.hpp"
+#include "TypeDeclarationNode.hpp"
+#include "UnaryOperationNode.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Dispatches on the type of an AST node to a typed hook on Derived, with a single switch and no RTTI. Every
+   * node type is only ever created as one node class, so the node can be cast to it statically.
+   *
+   * A visitor derives from ASTVisitor<Visitor, Result, Args...>, defines the visitX hooks for the node types it handles,
+   * and calls visit. Hooks that aren't defined go to visitNode, which returns a default constructed Result unless the
+   * visitor defines its own. Hooks can be private, as long as the visitor is friends with its ASTVisitor.
+   *
+   * @tparam Derived The visitor.
+   * @tparam Result What each hook returns.
+   * @tparam Args Anything else that is passed through to every hook, such as the module being generated into.
+   */
+  template<typename Derived, typename Result, typename... Args>
+  class ASTVisitor {
+  public:
+    Result visit(const shared_ptr<ASTNode> &node, Args... args) {
+      Derived &visitor = static_cast<Derived&>(*this);
+
+      switch (node->getNodeType()) {
+        case ASTNode::ASSIGNMENT: return visitor.visitAssignment(static_pointer_cast<AssignmentNode>(node), args...);
+        case ASTNode::AST_NODE_LIST: return visitor.visitASTNodeList(static_pointer_cast<ASTNodeList>(node), args...);
+        case ASTNode::BINARY_OPERATION: return visitor.visitBinaryOperation(static_pointer_cast<BinaryOperationNode>(node), args...);
+        case ASTNode::BLOCK: return visitor.visitBlock(static_pointer_cast<BlockNode>(node), args...);
+        case ASTNode::BOOLEAN_LITERAL: return visitor.visitBooleanLiteral(static_pointer_cast<LiteralNode>(node), args...);
+        case ASTNode::CAPSULE: return visitor.visitCapsule(static_pointer_cast<CapsuleNode>(node), args...);
+        case ASTNode::CONTROL_FLOW: return visitor.visitControlFlow(static_pointer_cast<ControlFlowNode>(node), args...);
+        case ASTNode::DICTIONARY: return visitor.visitDictionary(static_pointer_cast<DictionaryNode>(node), args...);
+        case ASTNode::ENUM: return visitor.visitEnum(static_pointer_cast<EnumNode>(node), args...);
+        case ASTNode::FUNCTION_DECLARATION: return visitor.visitFunctionDeclaration(static_pointer_cast<FunctionDeclarationNode>(node), args...);
+        case ASTNode::FUNCTION_INVOCATION: return visitor.visitFunctionInvocation(static_pointer_cast<FunctionInvocationNode>(node), args...);
+        case ASTNode::IDENTIFIER: return visitor.visitIdentifier(static_pointer_cast<IdentifierNode>(node), args...);
+        case ASTNode::LINK: return visitor.visitLink(static_pointer_cast<LinkNode>(node), args...);
+        case ASTNode::LIST: return visitor.visitList(static_pointer_cast<ListNode>(node), args...);
+        case ASTNode::NUMBER_LITERAL: return visitor.visitNumberLiteral(static_pointer_cast<LiteralNode>(node), args...);
+        case ASTNode::RETURN: return visitor.visitReturn(static_pointer_cast<ReturnNode>(node), args...);
+        case ASTNode::SOURCE: return visitor.visitSource(static_pointer_cast<SourceNode>(node), args...);
+        case ASTNode::STRING_LITERAL: return visitor.visitStringLiteral(static_pointer_cast<LiteralNode>(node), args...);
+        case ASTNode::STRUCT_DECLARATION: return visitor.visitStructDeclaration(static_pointer_cast<StructDeclarationNode>(node), args...);
+        case ASTNode::STRUCT_DEFINITION: return visitor.visitStructDefinition(static_pointer_cast<StructDefinitionNode>(node), args...);
+        case ASTNode::SYMBOL: return visitor.visitSymbol(static_pointer_cast<SymbolNode>(node), args...);
+        case ASTNode::TUPLE: return visitor.visitTuple(static_pointer_cast<TupleNode>(node), args...);
+        case ASTNode::TYPE_DECLARATION: return visitor.visitTypeDeclaration(static_pointer_cast<TypeDeclarationNode>(node), args...);
+        case ASTNode::UNARY_OPERATION: return visitor.visitUnaryOperation(static_pointer_cast<UnaryOperationNode>(node), args...);
+      }
+
+      return visitor.visitNode(node, args...);
+    }
+
+  protected:
+    Result visitNode(const shared_ptr<ASTNode> &node, Args... args) { return Result(); }
+
+    Result visitAssignment(const shared_ptr<AssignmentNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitASTNodeList(const shared_ptr<ASTNodeList> &node, Args... args) { return fallback(node, args...); }
+    Result visitBinaryOperation(const shared_ptr<BinaryOperationNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitBlock(const shared_ptr<BlockNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitBooleanLiteral(const shared_ptr<LiteralNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitCapsule(const shared_ptr<CapsuleNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitControlFlow(const shared_ptr<ControlFlowNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitDictionary(const shared_ptr<DictionaryNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitEnum(const shared_ptr<EnumNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitFunctionDeclaration(const shared_ptr<FunctionDeclarationNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitFunctionInvocation(const shared_ptr<FunctionInvocationNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitIdentifier(const shared_ptr<IdentifierNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitLink(const shared_ptr<LinkNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitList(const shared_ptr<ListNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitNumberLiteral(const shared_ptr<LiteralNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitReturn(const shared_ptr<ReturnNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitSource(const shared_ptr<SourceNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitStringLiteral(const shared_ptr<LiteralNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitStructDeclaration(const shared_ptr<StructDeclarationNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitStructDefinition(const shared_ptr<StructDefinitionNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitSymbol(const shared_ptr<SymbolNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitTuple(const shared_ptr<TupleNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitTypeDeclaration(const shared_ptr<TypeDeclarationNode> &node, Args... args) { return fallback(node, args...); }
+    Result visitUnaryOperation(const shared_ptr<UnaryOperationNode> &node, Args... args) { return fallback(node, args...); }
+
+  private:
+    Result fallback(const shared_ptr<ASTNode> &node, Args... args) {
+      return static_cast<Derived&>(*this).visitNode(node, args...);
+    }
+  };
+
+  /**
+   * @brief Calls back with each direct child of a node, in source order, without allocating. Control flow conditions
+   * are skipped where there are none, such as for an else branch.
+   *
+   * @param node The node whose children to go through.
+   * @param callback Called with each child.
+   */
+  template<typename Callback>
+  void forEachChild(const shared_ptr<ASTNode> &node, Callback &&callback) {
+    if (node->getValue()) {
+      callback(node->getValue());
+    } else if (node->getLeft()) {
+      callback(node->getLeft());
+      callback(node->getRight());
+    } else if (node->hasMany()) {
+      for (auto &elem : static_pointer_cast<ASTNodeList>(node)->getElements()) callback(elem);
+    } else if (node->getNodeType() == ASTNode::FUNCTION_DECLARATION) {
+      shared_ptr<FunctionDeclarationNode> funcDecNode = static_pointer_cast<FunctionDeclarationNode>(node);
+      shared_ptr<ASTNode> parameters = funcDecNode->getParameters();
+
+      callback(parameters);
+      callback(funcDecNode->getDefinition());
+    } else if (node->getNodeType() == ASTNode::FUNCTION_INVOCATION) {
+      shared_ptr<FunctionInvocationNode> funcInvNode = static_pointer_cast<FunctionInvocationNode>(node);
+      shared_ptr<ASTNode> parameters = funcInvNode->getParameters();
+
+      callback(funcInvNode->getIdentifier());
+      callback(parameters);
+    } else if (node->getNodeType() == ASTNode::CONTROL_FLOW) {
+      for (auto &conditionExpressionPair : static_pointer_cast<ControlFlowNode>(node)->getConditionExpressionPairs()) {
+        if (conditionExpressionPair.first) callback(conditionExpressionPair.first);
+        callback(conditionExpressionPair.second);
+      }
+    }
+  }
+}
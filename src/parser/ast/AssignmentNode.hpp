@@ -12,16 +12,12 @@ namespace Theta {
   public:
     AssignmentNode(shared_ptr<ASTNode> parent) : ASTNode(ASTNode::ASSIGNMENT, parent) {};
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"left\": " << (left ? left->toJSON() : "null");
-      oss << ", \"right\": " << (right ? right->toJSON() : "null");
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("left").node(left);
+      writer.key("right").node(right);
+      writer.endObject();
     }
   };
 }
@@ -16,15 +16,13 @@ namespace Theta {
 
       string getOperator() { return operatorSymbol; }
 
-      string toJSON() const override {
-        std::ostringstream oss;
-        oss << "{";
-        oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-        oss << "\"operator\": \"" << operatorSymbol << "\", ";
-        oss << "\"left\": " << (left ? left->toJSON() : "null") << ", ";
-        oss << "\"right\": " << (right ? right->toJSON() : "null");
-        oss << "}";
-        return oss.str();
+      void writeJSON(JsonWriter &writer) const override {
+        writer.beginObject();
+        writer.field("type", getNodeTypePretty());
+        writer.field("operator", operatorSymbol);
+        writer.key("left").node(left);
+        writer.key("right").node(right);
+        writer.endObject();
       }
   };
 }
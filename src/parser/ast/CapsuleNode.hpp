@@ -18,16 +18,12 @@ namespace Theta {
 
     bool hasOwnScope() override { return true; }
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"name\": \"" << name << "\"";
-      oss << ", \"value\": " << (value ? value->toJSON() : "null");
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("name", name);
+      writer.key("value").node(value);
+      writer.endObject();
     }
   };
 }
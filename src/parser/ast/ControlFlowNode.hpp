@@ -23,29 +23,20 @@ namespace Theta {
       return conditionExpressionPairs;
     }
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-      oss << "\"conditionExpressionPairs\": [";
-
-      for (int i = 0; i < conditionExpressionPairs.size(); i++) {
-        if (i > 0) {
-            oss << ", ";
-        }
-
-        oss << "[ ";
-        oss << (conditionExpressionPairs[i].first ? conditionExpressionPairs[i].first->toJSON() : "null");
-        oss << ", ";
-        oss << (conditionExpressionPairs[i].second ? conditionExpressionPairs[i].second->toJSON() : "null");
-        oss << "] ";
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("conditionExpressionPairs").beginArray();
+
+      for (auto &[condition, expression] : conditionExpressionPairs) {
+        writer.beginArray();
+        writer.node(condition);
+        writer.node(expression);
+        writer.endArray();
       }
 
-      oss << "] ";
-      oss << "}";
-
-      return oss.str();
+      writer.endArray();
+      writer.endObject();
     }
   };
 }
@@ -19,26 +19,16 @@ namespace Theta {
 
     shared_ptr<ASTNode> getIdentifier() { return identifier; }
 
-    string toJSON() const override {
-      ostringstream oss;
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("identifier").node(identifier);
+      writer.key("elements").beginArray();
 
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-      oss << "\"identifier\": " << (identifier ? identifier->toJSON() : "null") << ", ";
-      oss << "\"elements\": [";
+      for (auto &element : elements) writer.node(element);
 
-      for (int i = 0; i < elements.size(); i++) {
-        if (i > 0) {
-          oss << ", ";
-        }
-
-        oss << (elements[i] ? elements[i]->toJSON() : "null");
-      }
-
-      oss << "] ";
-      oss << "}";
-
-      return oss.str();
+      writer.endArray();
+      writer.endObject();
     }
   };
 }
@@ -16,7 +16,10 @@ namespace Theta {
 
     FunctionDeclarationNode(shared_ptr<ASTNode> parent) : ASTNode(ASTNode::FUNCTION_DECLARATION, parent) {};
 
-    void setParameters(shared_ptr<ASTNodeList> params) { parameters = params; }
+    void setParameters(shared_ptr<ASTNodeList> params) {
+      parameters = params;
+      signatureNameId = -1;
+    }
 
     shared_ptr<ASTNodeList>& getParameters() { return parameters; }
 
@@ -24,28 +27,47 @@ namespace Theta {
 
     shared_ptr<ASTNode>& getDefinition() { return definition; }
 
-    string toJSON() const override {
-      ostringstream oss;
+    /**
+     * @brief Whether the function was annotated with `@memo`, so that its results are kept in a table keyed on its
+     * arguments, see CodeGen::generateMemoizedFunction.
+     */
+    bool getIsMemoized() { return isMemoized; }
 
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"parameters\": [";
+    void setIsMemoized(bool memoized) { isMemoized = memoized; }
 
-      for (int i = 0; i < parameters->getElements().size(); i++) {
-        if (i > 0) {
-          oss << ", ";
-        }
+    /**
+     * @brief The id of this function's qualified name when declared under the given name, if it was already worked out.
+     *
+     * @param nameId The id of the name the function is declared under.
+     * @return The id of the qualified name, or -1 if it isn't known yet
+     */
+    int getSignatureId(int nameId) { return nameId == signatureNameId ? signatureId : -1; }
 
-        oss << (parameters->getElements()[i] ? parameters->getElements()[i]->toJSON() : "null");
-      }
+    void setSignatureId(int nameId, int id) {
+      signatureNameId = nameId;
+      signatureId = id;
+    }
 
-      oss << "] ";
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
 
-      oss << ", \"definition\": " + (definition ? definition->toJSON() : "null");
+      if (isMemoized) writer.key("annotations").beginArray().value("memo").endArray();
 
-      oss << "}";
+      writer.key("parameters").beginArray();
 
-      return oss.str();
-      }
+      for (auto &parameter : parameters->getElements()) writer.node(parameter);
+
+      writer.endArray();
+      writer.key("definition").node(definition);
+      writer.endObject();
+    }
+
+  private:
+    bool isMemoized = false;
+
+    // A function is almost always declared under just one name, so only the last qualified name is kept
+    int signatureNameId = -1;
+    int signatureId = -1;
   };
 }
@@ -25,23 +25,16 @@ namespace Theta {
 
     shared_ptr<ASTNodeList> getParameters() { return arguments; }
 
-    string toJSON() const override {
-      std::ostringstream oss;
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-      oss << "\"function\": " << (identifier ? identifier->toJSON() : "null") << ", ";
-      oss << "\"arguments\": [";
-      for (int i = 0; i < arguments->getElements().size(); i++) {
-        if (i > 0) {
-          oss << ", ";
-        }
-
-        oss << (arguments->getElements()[i] ? arguments->getElements()[i]->toJSON() : "null");
-      }
-
-      oss << "] ";
-      oss << "}";
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("function").node(identifier);
+      writer.key("arguments").beginArray();
+
+      for (auto &argument : arguments->getElements()) writer.node(argument);
+
+      writer.endArray();
+      writer.endObject();
     }
   };
 }
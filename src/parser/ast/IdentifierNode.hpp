@@ -16,16 +16,12 @@ namespace Theta {
 
     string getIdentifier() { return identifier; }
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"value\": \"" << identifier << "\"";
-      oss << ", \"variableType\": " << (value ? value->toJSON() : "null");
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("value", identifier);
+      writer.key("variableType").node(value);
+      writer.endObject();
     }
   };
 }
@@ -14,16 +14,12 @@ namespace Theta {
 
     LinkNode(string cap, shared_ptr<ASTNode> parent) : ASTNode(ASTNode::LINK, parent), capsule(cap) {};
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"capsule\": \"" << capsule << "\"";
-      oss << ", \"value\": " << (value ? value->toJSON() : "null");
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("capsule", capsule);
+      writer.key("value").node(value);
+      writer.endObject();
     }
   };
 }
@@ -17,15 +17,11 @@ namespace Theta {
     string getLiteralValue() { return literalValue; }
     void setLiteralValue(string val) { literalValue = val; }
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-      oss << "\"value\": \"" << literalValue << "\" ";
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("value", literalValue);
+      writer.endObject();
     }
   };
 }
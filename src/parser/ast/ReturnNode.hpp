@@ -12,15 +12,11 @@ namespace Theta {
   public:
     ReturnNode(shared_ptr<ASTNode> parent) : ASTNode(ASTNode::RETURN, parent) {};
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"value\": " << (value ? value->toJSON() : "null");
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("value").node(value);
+      writer.endObject();
     }
   };
 }
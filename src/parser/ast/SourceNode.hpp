@@ -17,26 +17,16 @@ namespace Theta {
 
     vector<shared_ptr<ASTNode>> getLinks() { return links; }
 
-    string toJSON() const override {
-      ostringstream oss;
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("links").beginArray();
 
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"links\": [";
+      for (auto &link : links) writer.node(link);
 
-      for (int i = 0; i < links.size(); i++) {
-        if (i > 0) {
-          oss << ", ";
-        }
-
-        oss << (links[i] ? links[i]->toJSON() : "null");
-      }
-
-      oss << "] ";
-      oss << ", \"value\": " << (value ? value->toJSON() : "null");
-      oss << "}";
-
-      return oss.str();
-      }
+      writer.endArray();
+      writer.key("value").node(value);
+      writer.endObject();
+    }
   };
 }
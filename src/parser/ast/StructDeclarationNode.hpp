@@ -16,16 +16,12 @@ namespace Theta {
 
     string getStructType() { return structType; }
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"struct\": \"" << structType << "\"";
-      oss << ", \"value\": " << (value ? value->toJSON() : "null");
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("struct", structType);
+      writer.key("value").node(value);
+      writer.endObject();
     }
   };
 }
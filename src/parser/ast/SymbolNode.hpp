@@ -16,15 +16,11 @@ namespace Theta {
 
     string getSymbol() { return symbol; }
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ", \"value\": \"" << symbol << "\"";
-      oss << "}";
-
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("value", symbol);
+      writer.endObject();
     }
   };
 }
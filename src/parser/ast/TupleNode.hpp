@@ -12,14 +12,12 @@ namespace Theta {
   public:
     TupleNode(shared_ptr<ASTNode> parent) : ASTNode(ASTNode::TUPLE, parent) {};
 
-    string toJSON() const override {
-      std::ostringstream oss;
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-      oss << "\"first\": " << (left ? left->toJSON() : "null") << ", ";
-      oss << "\"second\": " << (right ? right->toJSON() : "null");
-      oss << "}";
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.key("first").node(left);
+      writer.key("second").node(right);
+      writer.endObject();
     }
   };
 }
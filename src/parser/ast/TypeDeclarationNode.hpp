@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <sstream>
@@ -17,7 +18,46 @@ namespace Theta {
 
     string getType() { return type; }
 
-    void setType(string newType) { type = newType; }
+    void setType(string newType) {
+      invalidateInternedId();
+      type = newType;
+    }
+
+    void setValue(shared_ptr<ASTNode> childNode) override {
+      invalidateInternedId();
+      value = childNode;
+    }
+
+    void setLeft(shared_ptr<ASTNode> childNode) override {
+      invalidateInternedId();
+      left = childNode;
+    }
+
+    void setRight(shared_ptr<ASTNode> childNode) override {
+      invalidateInternedId();
+      right = childNode;
+    }
+
+    void setElements(vector<shared_ptr<ASTNode>> el) override {
+      invalidateInternedId();
+      elements = el;
+    }
+
+    /**
+     * @brief The id the TypeInterner gave this type, or -1 if it hasn't been interned since it, or a type in it, last
+     * changed
+     */
+    int getInternedId() { return internedId; }
+
+    /**
+     * @brief Caches the id the TypeInterner gave this type.
+     * @param id The id.
+     * @param canonical Whether this is the instance the interner shares for the type, which is never changed.
+     */
+    void setInternedId(int id, bool canonical = false) {
+      internedId = id;
+      if (canonical) isCanonical = true;
+    }
 
     string toString(bool bare = false) {
       string typeString;
@@ -48,35 +88,46 @@ namespace Theta {
       return typeString;
     }
 
-    string toJSON() const override {
-      ostringstream oss;
-
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\"";
-      oss << ",\"declaredType\": \"" << type << "\"";
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("declaredType", type);
 
       if (left) {
-        oss << ",\"left\": " << left->toJSON();
-        oss << ",\"right\": " << (right ? right->toJSON() : "null");
+        writer.key("left").node(left);
+        writer.key("right").node(right);
       } else if (elements.size() > 0) {
-        oss << ",\"elements\": [";
+        writer.key("elements").beginArray();
 
-        for (int i = 0; i < elements.size(); i++) {
-          if (i > 0) {
-            oss << ", ";
-          }
-
-          oss << elements.at(i)->toJSON();
-        }
+        for (auto &element : elements) writer.node(element);
 
-        oss << "]";
+        writer.endArray();
       } else {
-        oss << ",\"value\": " << (value ? value->toJSON() : "null");
+        writer.key("value").node(value);
       }
 
-      oss << "}";
+      writer.endObject();
+    }
 
-      return oss.str();
+  private:
+    // Types that are only read, like hoisted signatures, can be interned from several threads at once. They all cache
+    // the same id, so it doesn't matter whose write wins
+    atomic<int> internedId = -1;
+    bool isCanonical = false;
+
+    /**
+     * @brief Drops the cached id of this type and of the types it is part of, since their ids are made from the ids of
+     * their children. Those are found through parents, the way the parser links them. Types that share a child they
+     * don't own must share a canonical one, which never changes.
+     */
+    void invalidateInternedId() {
+      // A type is only interned after its children are, so if this one has no id, neither do the types it is part of
+      if (isCanonical || internedId < 0) return;
+
+      internedId = -1;
+
+      shared_ptr<TypeDeclarationNode> parentType = dynamic_pointer_cast<TypeDeclarationNode>(getParent());
+      if (parentType) parentType->invalidateInternedId();
     }
   };
 }
@@ -16,14 +16,12 @@ namespace Theta {
 
     string getOperator() { return operatorSymbol; }
 
-    string toJSON() const override {
-      std::ostringstream oss;
-      oss << "{";
-      oss << "\"type\": \"" << getNodeTypePretty() << "\", ";
-      oss << "\"operator\": \"" << operatorSymbol << "\", ";
-      oss << "\"value\": " << (value ? value->toJSON() : "null");
-      oss << "}";
-      return oss.str();
+    void writeJSON(JsonWriter &writer) const override {
+      writer.beginObject();
+      writer.field("type", getNodeTypePretty());
+      writer.field("operator", operatorSymbol);
+      writer.key("value").node(value);
+      writer.endObject();
     }
   };
 }
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "wasm.hh"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "runtime/ExecutionContext.hpp"
+#include "runtime/Runtime.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Runs programs compiled a module per capsule, see Compiler::setIsSplittingCapsules, loading each capsule the
+   * first time one of its functions is called. Functions are called by their capsule's name and their own, such as
+   * "Theta.Scoring.score1Number", so a program only pays for compiling and instantiating the capsules it actually uses.
+   *
+   * Capsules are read from `<directory>/<capsule>.wasm` unless they were added beforehand. Like the runtime it loads
+   * into, a loader must only be used by the thread that made it.
+   */
+  class CapsuleLoader {
+  public:
+    /**
+     * @param runtime The runtime capsules are compiled and run in.
+     * @param directory Where the modules of capsules that weren't added are read from.
+     */
+    CapsuleLoader(Runtime &runtime, filesystem::path directory) : runtime(runtime), directory(std::move(directory)) {}
+
+    /**
+     * @brief Provides a capsule's module, such as the entrypoint's, rather than reading it from the directory. It is
+     * still only compiled once one of its functions is called.
+     */
+    void addCapsule(const string &capsule, vector<char> wasmBinary) {
+      binaries[capsule] = std::move(wasmBinary);
+    }
+
+    /**
+     * @brief Whether a capsule's module has been compiled, which happens the first time one of its functions is called.
+     */
+    bool isLoaded(const string &capsule) const { return loadedCapsules.count(capsule) > 0; }
+
+    /**
+     * @brief Runs a function of a capsule, loading the capsule if it isn't already, like Runtime::execute.
+     * @param qualifiedName The capsule's name, then a dot, then the function's qualified name.
+     */
+    ExecutionContext execute(const string &qualifiedName) {
+      auto [capsule, functionName] = splitQualifiedName(qualifiedName);
+
+      return runtime.execute(load(capsule), functionName);
+    }
+
+    /**
+     * @brief Calls a function of a capsule with arguments, loading the capsule if it isn't already, like
+     * Runtime::invoke.
+     * @param qualifiedName The capsule's name, then a dot, then the function's qualified name.
+     */
+    void invoke(const string &qualifiedName, const wasm::Val args[], size_t argCount, wasm::Val results[], size_t resultCapacity) {
+      auto [capsule, functionName] = splitQualifiedName(qualifiedName);
+
+      runtime.invoke(load(capsule), functionName, args, argCount, results, resultCapacity);
+    }
+
+  private:
+    Runtime &runtime;
+    filesystem::path directory;
+    map<string, vector<char>> binaries;
+
+    // The capsules compiled so far, by handles to their modules so that calls don't hash their binaries again
+    map<string, Runtime::ModuleHandle> loadedCapsules;
+
+    /**
+     * @brief The module of a capsule, read and compiled the first time it's asked for.
+     */
+    const Runtime::ModuleHandle& load(const string &capsule) {
+      auto loaded = loadedCapsules.find(capsule);
+      if (loaded != loadedCapsules.end()) return loaded->second;
+
+      auto it = binaries.find(capsule);
+
+      if (it == binaries.end()) {
+        filesystem::path file = directory / (capsule + ".wasm");
+        ifstream wasmStream(file, ios::binary);
+
+        if (!wasmStream) throw runtime_error("No module for capsule " + capsule + " at " + file.string());
+
+        vector<char> wasm((istreambuf_iterator<char>(wasmStream)), istreambuf_iterator<char>());
+        it = binaries.insert(make_pair(capsule, std::move(wasm))).first;
+      }
+
+      Runtime::ModuleHandle handle = runtime.precompile(it->second);
+
+      // The handle keeps the binary from here on
+      binaries.erase(it);
+
+      return loadedCapsules.insert(make_pair(capsule, handle)).first->second;
+    }
+
+    /**
+     * @brief Splits "Capsule.Name.function" into the capsule's name and the function's, at the last dot, since capsule
+     * names have dots in them and function names don't.
+     */
+    static pair<string, string> splitQualifiedName(const string &qualifiedName) {
+      size_t dot = qualifiedName.rfind('.');
+
+      if (dot == string::npos || dot == 0 || dot + 1 == qualifiedName.size()) {
+        throw runtime_error("Expected a capsule and a function, such as Capsule.function, but got " + qualifiedName);
+      }
+
+      return make_pair(qualifiedName.substr(0, dot), qualifiedName.substr(dot + 1));
+    }
+  };
+}
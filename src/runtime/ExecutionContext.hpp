@@ -1,6 +1,12 @@
 #pragma once
 
 #include "wasm.hh"
+#include "GCStats.hpp"
+#include "runtime/InstanceMemory.hpp"
+#include "runtime/InstancePool.hpp"
+#include "runtime/ResultTypes.hpp"
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <vector>
 
@@ -10,15 +16,186 @@ namespace Theta {
   class ExecutionContext {
   public:
     wasm::Val result;
+
+    // Every value the function returned, the first of which is also the result. Functions returning a tuple return one
+    // for each of its elements
+    vector<wasm::Val> results;
+
     vector<string> exportNames;
+    GCStats gcStats;
+
+    // The Theta type of the result, such as List<Number>, if the module records it, and its layout if it's a struct
+    string resultType;
+    optional<StructType> resultStruct;
+
+    // Results that live in memory keep the instance they were returned from until the context is destroyed, so they
+    // can be read in place. The context must not outlive the runtime it was returned by
+    shared_ptr<PooledInstance> resultInstance;
+
+    ExecutionContext(vector<wasm::Val> results, vector<string> exportNames)
+      : result(results.empty() ? wasm::Val() : results[0].copy()), results(std::move(results)), exportNames(exportNames) {}
+
+    /**
+     * @brief The elements of a List<Number> result, where they are in memory.
+     */
+    MemoryView<int64_t> getNumbers() const {
+      requireResultType(LIST_OF_NUMBERS);
+      return getMemory().getNumbers(result);
+    }
+
+    /**
+     * @brief The elements of a List<Boolean> result, each 0 or 1, where they are in memory.
+     */
+    MemoryView<int32_t> getBooleans() const {
+      requireResultType(LIST_OF_BOOLEANS);
+      return getMemory().getBooleans(result);
+    }
+
+    /**
+     * @brief A Number field of a struct result.
+     */
+    int64_t getNumberField(const string &fieldName) const {
+      int64_t value;
+      memcpy(&value, getField(fieldName, NUMBER).data, sizeof(int64_t));
+
+      return value;
+    }
+
+    /**
+     * @brief A Boolean field of a struct result.
+     */
+    bool getBooleanField(const string &fieldName) const {
+      return getField(fieldName, BOOLEAN)[0] != 0;
+    }
+
+    /**
+     * @brief The id of a Symbol field of a struct result.
+     */
+    uint32_t getSymbolField(const string &fieldName) const {
+      uint32_t value;
+      memcpy(&value, getField(fieldName, SYMBOL).data, sizeof(uint32_t));
+
+      return value;
+    }
+
+    string stringifiedResult() const {
+      if (resultType == LIST_OF_NUMBERS) return stringifyList(getNumbers(), [](int64_t n) { return to_string(n); });
+      if (resultType == LIST_OF_BOOLEANS) return stringifyList(getBooleans(), [](int32_t b) { return string(b ? "true" : "false"); });
+      if (resultStruct) return stringifyStruct();
+      if (results.size() > 1) return stringifyTuple();
+
+      return stringifyValue(result);
+    }
+
+  private:
+    static inline const string LIST_OF_NUMBERS = "List<Number>";
+    static inline const string LIST_OF_BOOLEANS = "List<Boolean>";
+    static inline const string TUPLE_PREFIX = "Tuple<";
+
+    static inline const string NUMBER = "Number";
+    static inline const string BOOLEAN = "Boolean";
+    static inline const string SYMBOL = "Symbol";
+
+    InstanceMemory getMemory() const {
+      if (!resultInstance) throw runtime_error("The result doesn't live in memory");
+
+      return InstanceMemory(resultInstance->memory);
+    }
+
+    void requireResultType(const string &type) const {
+      if (resultType != type) throw runtime_error("The result is a " + resultType + ", not a " + type);
+    }
 
-    ExecutionContext(wasm::Val result, vector<string> exportNames) : result(std::move(result)), exportNames(exportNames) {}
+    MemoryView<byte_t> getField(const string &fieldName, const string &type) const {
+      if (!resultStruct) throw runtime_error("The result isn't a struct");
+
+      const StructType::Field *field = resultStruct->getField(fieldName);
+      if (!field) throw runtime_error(resultStruct->name + " has no field " + fieldName);
+      if (field->type != type) throw runtime_error(resultStruct->name + "." + fieldName + " is a " + field->type + ", not a " + type);
+
+      return getMemory().getBytes((uint64_t) (uint32_t) result.i32() + field->offset, field->size);
+    }
+
+    template<typename T, typename Stringify>
+    static string stringifyList(MemoryView<T> elements, Stringify stringify) {
+      string list = "[";
+
+      for (size_t i = 0; i < elements.size; i++) {
+        if (i > 0) list += ", ";
+        list += stringify(elements[i]);
+      }
+
+      return list + "]";
+    }
+
+    static string stringifyValue(const wasm::Val &value) {
+      if (value.kind() == wasm::I64) return to_string(value.i64());
+      if (value.kind() == wasm::I32) return value.i32() == 1 ? "true" : "false";
 
-    string stringifiedResult() {
-      if (result.kind() == wasm::I64) return to_string(result.i64());
-      if (result.kind() == wasm::I32) return result.i32() == 1 ? "true" : "false";
-      
       throw runtime_error("Could not parse result string");
     }
+
+    /**
+     * @brief A tuple result as it would be written in Theta, such as { 1, true }. Its elements are told apart by the
+     * tuple's type where the module records it, since Booleans and Symbols are both i32s.
+     */
+    string stringifyTuple() const {
+      vector<string> elementTypes = getTupleElementTypes();
+      string elements;
+
+      for (size_t i = 0; i < results.size(); i++) {
+        if (i > 0) elements += ", ";
+
+        if (i < elementTypes.size() && elementTypes[i] == SYMBOL) elements += "Symbol(" + to_string((uint32_t) results[i].i32()) + ")";
+        else elements += stringifyValue(results[i]);
+      }
+
+      return "{ " + elements + " }";
+    }
+
+    /**
+     * @brief The types of a tuple result's elements, split from its type at the commas that aren't nested in another
+     * type. Empty if the result type isn't a tuple.
+     */
+    vector<string> getTupleElementTypes() const {
+      vector<string> elementTypes;
+      if (resultType.rfind(TUPLE_PREFIX, 0) != 0 || resultType.back() != '>') return elementTypes;
+
+      string elementType;
+      int depth = 0;
+
+      for (size_t i = TUPLE_PREFIX.length(); i < resultType.length() - 1; i++) {
+        char c = resultType[i];
+
+        if (c == ',' && depth == 0) {
+          elementTypes.push_back(elementType);
+          elementType.clear();
+          continue;
+        }
+
+        if (c == '<') depth++;
+        if (c == '>') depth--;
+        if (c != ' ') elementType += c;
+      }
+
+      elementTypes.push_back(elementType);
+
+      return elementTypes;
+    }
+
+    string stringifyStruct() const {
+      string fields;
+
+      for (const StructType::Field &field : resultStruct->fields) {
+        if (!fields.empty()) fields += ", ";
+        fields += field.name + ": ";
+
+        if (field.type == NUMBER) fields += to_string(getNumberField(field.name));
+        else if (field.type == BOOLEAN) fields += getBooleanField(field.name) ? "true" : "false";
+        else fields += "Symbol(" + to_string(getSymbolField(field.name)) + ")";
+      }
+
+      return "@" + resultStruct->name + " { " + fields + " }";
+    }
   };
 }
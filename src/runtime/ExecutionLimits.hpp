@@ -0,0 +1,136 @@
+#pragma once
+
+#include "wasm.hh"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief How long a program is allowed to run before the runtime stops it. Only modules compiled with fuel metering
+   * can be stopped, see Compiler::setIsMeteringFuel: they spend a unit of fuel on entering a function and on each turn
+   * of a loop, and check whether the host has interrupted them as they do. Neither limit is set by default.
+   */
+  struct ExecutionLimits {
+    // How many units of fuel each call to a program's function can spend
+    optional<uint64_t> fuel;
+
+    // How long each run can take, in wall time. A batch of calls is a single run
+    optional<chrono::milliseconds> deadline;
+
+    bool isLimited() const { return fuel || deadline; }
+  };
+
+  /**
+   * @brief Thrown when a run spends all the fuel it was given.
+   */
+  class OutOfFuelError : public runtime_error {
+  public:
+    OutOfFuelError(uint64_t fuel) : runtime_error("Out of fuel, after spending " + to_string(fuel) + " units") {}
+  };
+
+  /**
+   * @brief Thrown when a run is still going when its deadline passes.
+   */
+  class DeadlineExceededError : public runtime_error {
+  public:
+    DeadlineExceededError(chrono::milliseconds deadline)
+      : runtime_error("Deadline exceeded, after " + to_string(deadline.count()) + "ms") {}
+  };
+
+  /**
+   * @brief Thrown when a function allocates more than is left of the heap before it reaches a function boundary, where
+   * the collector could make room. The core module flags the trap in memory, after the interrupt flag.
+   */
+  class OutOfMemoryError : public runtime_error {
+  public:
+    static const size_t FLAG_OFFSET = 33;
+
+    OutOfMemoryError() : runtime_error("Out of memory, a function allocated more than the heap has room for") {}
+  };
+
+  /**
+   * @brief Interrupts runs that go past their deadline, from a thread of its own, by setting the interrupt flag in the
+   * memory of the instance they run in. Metered modules check the flag wherever they spend fuel, and trap once it's
+   * set. The wasm C API doesn't give access to the isolate underneath, so V8's own TerminateExecution can't be used.
+   */
+  class Watchdog {
+  public:
+    // Where the flag is in memory, after the collector's counters, see src/wasm/ThetaLangCore.wat
+    static const size_t INTERRUPT_OFFSET = 32;
+
+    Watchdog() : watcher([this]() { watch(); }) {}
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    ~Watchdog() {
+      {
+        lock_guard<mutex> guard(lock);
+        isStopping = true;
+      }
+
+      changed.notify_one();
+      watcher.join();
+    }
+
+    /**
+     * @brief Interrupts the instance the memory belongs to once the deadline passes, unless disarmed before.
+     */
+    void arm(wasm::Memory *memory, chrono::milliseconds deadline) {
+      {
+        lock_guard<mutex> guard(lock);
+        armedMemory = memory;
+        armedUntil = chrono::steady_clock::now() + deadline;
+      }
+
+      changed.notify_one();
+    }
+
+    /**
+     * @brief Stops watching the run it was armed for. The memory isn't touched once this returns.
+     */
+    void disarm() {
+      lock_guard<mutex> guard(lock);
+      armedMemory = nullptr;
+    }
+
+  private:
+    mutex lock;
+    condition_variable changed;
+    wasm::Memory *armedMemory = nullptr;
+    chrono::steady_clock::time_point armedUntil;
+    bool isStopping = false;
+
+    // Started last, once everything it reads is
+    thread watcher;
+
+    void watch() {
+      unique_lock<mutex> guard(lock);
+
+      while (!isStopping) {
+        if (!armedMemory) {
+          changed.wait(guard);
+          continue;
+        }
+
+        if (chrono::steady_clock::now() < armedUntil) {
+          changed.wait_until(guard, armedUntil);
+          continue;
+        }
+
+        // The run reads the flag as it goes, so the write has to actually happen rather than be kept in a register.
+        // Memory is reserved up front by V8, so growing it while the run is going doesn't move the flag
+        *reinterpret_cast<volatile wasm::byte_t*>(armedMemory->data() + INTERRUPT_OFFSET) = 1;
+        armedMemory = nullptr;
+      }
+    }
+  };
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "wasm.hh"
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "runtime/ExecutionContext.hpp"
+#include "runtime/Runtime.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Runs compiled Theta programs on a pool of threads, so that runs can use every core rather than one. Each
+   * thread makes a runtime of its own when it starts, since a runtime's store can only be used by the thread that made
+   * it. Modules are still only compiled once, by whichever thread runs them first, see Runtime.
+   *
+   * Only results that aren't references, such as Numbers and Booleans, can be read back from another thread.
+   */
+  class Executor {
+  public:
+    /**
+     * @param threadCount How many threads to run programs on. Defaults to one per core.
+     */
+    Executor(size_t threadCount = thread::hardware_concurrency()) {
+      threadCount = max<size_t>(threadCount, 1);
+
+      for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back([this]() { work(); });
+      }
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /**
+     * @brief Finishes the runs that were already submitted, then stops the threads.
+     */
+    ~Executor() {
+      {
+        lock_guard<mutex> guard(tasksLock);
+        isStopping = true;
+      }
+
+      tasksChanged.notify_all();
+
+      for (thread &worker : workers) worker.join();
+    }
+
+    size_t getThreadCount() const { return workers.size(); }
+
+    /**
+     * @brief Runs a function exported by a compiled module, like Runtime::execute, on whichever thread is free first.
+     * @return The result of the run, or the exception it threw.
+     */
+    future<ExecutionContext> submit(vector<char> wasmBinary, string functionName) {
+      Runtime::ModuleHandle handle = Runtime::makeHandle(std::move(wasmBinary));
+
+      return enqueue<ExecutionContext>([handle, functionName](Runtime &runtime) {
+        ExecutionContext context = runtime.execute(handle, functionName);
+
+        // The instance a list or struct lives in can only be handed back on this thread
+        context.resultInstance.reset();
+
+        return context;
+      });
+    }
+
+    /**
+     * @brief Calls a function exported by a compiled module once for each of several sets of arguments, like
+     * Runtime::invokeBatch, splitting the calls evenly between the threads. Returns once every call has.
+     */
+    void invokeBatch(
+      const vector<char> &wasmBinary,
+      const string &functionName,
+      size_t callCount,
+      const wasm::Val args[],
+      size_t argCount,
+      wasm::Val results[],
+      size_t resultCapacity
+    ) {
+      size_t chunkSize = (callCount + workers.size() - 1) / workers.size();
+      vector<future<void>> chunks;
+
+      // Hashed once here rather than by every chunk
+      Runtime::ModuleHandle handle = Runtime::makeHandle(wasmBinary);
+
+      for (size_t first = 0; first < callCount; first += chunkSize) {
+        size_t count = min(chunkSize, callCount - first);
+
+        // Nothing here outlives the call, since it waits for every chunk before returning
+        chunks.push_back(enqueue<void>([&handle, &functionName, callCount, args, argCount, results, resultCapacity, first, count](Runtime &runtime) {
+          auto [paramCount, resultCount] = runtime.getArity(handle, functionName);
+
+          // Each chunk checks the whole batch before calling anything, so that none of them goes past its end
+          Runtime::checkBatchSizes(functionName, callCount, argCount, resultCapacity, paramCount, resultCount);
+
+          runtime.invokeBatch(
+            handle,
+            functionName,
+            count,
+            args + first * paramCount,
+            count * paramCount,
+            results + first * resultCount,
+            count * resultCount
+          );
+        }));
+      }
+
+      // Wait for every chunk before rethrowing, so no thread is left writing to results after this returns
+      for (future<void> &chunk : chunks) chunk.wait();
+      for (future<void> &chunk : chunks) chunk.get();
+    }
+
+  private:
+    vector<thread> workers;
+
+    mutex tasksLock;
+    condition_variable tasksChanged;
+    queue<function<void(Runtime&)>> tasks;
+    bool isStopping = false;
+
+    template<typename T>
+    future<T> enqueue(function<T(Runtime&)> run) {
+      auto task = make_shared<packaged_task<T(Runtime&)>>(std::move(run));
+      future<T> result = task->get_future();
+
+      {
+        lock_guard<mutex> guard(tasksLock);
+        tasks.push([task](Runtime &runtime) { (*task)(runtime); });
+      }
+
+      tasksChanged.notify_one();
+
+      return result;
+    }
+
+    void work() {
+      Runtime runtime;
+
+      while (true) {
+        function<void(Runtime&)> task;
+
+        {
+          unique_lock<mutex> guard(tasksLock);
+          tasksChanged.wait(guard, [this]() { return isStopping || !tasks.empty(); });
+
+          if (tasks.empty()) return;
+
+          task = std::move(tasks.front());
+          tasks.pop();
+        }
+
+        task(runtime);
+      }
+    }
+  };
+}
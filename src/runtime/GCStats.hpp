@@ -0,0 +1,66 @@
+#pragma once
+
+#include "wasm.hh"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief What the collector did while a program ran, and how often memoized functions found their results in their
+   * tables. The core module keeps these counters at the start of memory, see src/wasm/ThetaLangCore.wat.
+   */
+  struct GCStats {
+    uint64_t bytesAllocated = 0;
+    uint64_t bytesCopied = 0;
+    uint64_t pauseNanoseconds = 0;
+    uint32_t collections = 0;
+    uint32_t maxShadowStackDepth = 0;
+    uint32_t memoryPages = 0;
+    uint64_t memoHits = 0;
+    uint64_t memoMisses = 0;
+
+    /**
+     * @brief Reads the counters out of a module's memory, leaving them all 0 if it has none.
+     */
+    static GCStats fromMemory(const wasm::Memory *memory) {
+      GCStats stats;
+      if (!memory || memory->data_size() < COUNTERS_SIZE) return stats;
+
+      const wasm::byte_t *data = memory->data();
+      memcpy(&stats.bytesAllocated, data + BYTES_ALLOCATED_OFFSET, sizeof(uint64_t));
+      memcpy(&stats.bytesCopied, data + BYTES_COPIED_OFFSET, sizeof(uint64_t));
+      memcpy(&stats.pauseNanoseconds, data + PAUSE_NANOSECONDS_OFFSET, sizeof(uint64_t));
+      memcpy(&stats.collections, data + COLLECTIONS_OFFSET, sizeof(uint32_t));
+      memcpy(&stats.maxShadowStackDepth, data + MAX_SHADOW_STACK_DEPTH_OFFSET, sizeof(uint32_t));
+      memcpy(&stats.memoHits, data + MEMO_HITS_OFFSET, sizeof(uint64_t));
+      memcpy(&stats.memoMisses, data + MEMO_MISSES_OFFSET, sizeof(uint64_t));
+      stats.memoryPages = memory->size();
+
+      return stats;
+    }
+
+    /**
+     * @brief The clock modules compiled to time their collections import as `theta.now`, in nanoseconds.
+     */
+    static wasm::own<wasm::Trap> now(const wasm::Val args[], wasm::Val results[]) {
+      auto elapsed = chrono::steady_clock::now().time_since_epoch();
+      results[0] = wasm::Val::i64(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+
+      return nullptr;
+    }
+
+  private:
+    // Wasm memory is little endian, like every host V8 runs wasm on
+    static const size_t BYTES_ALLOCATED_OFFSET = 0;
+    static const size_t BYTES_COPIED_OFFSET = 8;
+    static const size_t PAUSE_NANOSECONDS_OFFSET = 16;
+    static const size_t COLLECTIONS_OFFSET = 24;
+    static const size_t MAX_SHADOW_STACK_DEPTH_OFFSET = 28;
+    static const size_t MEMO_HITS_OFFSET = 40;
+    static const size_t MEMO_MISSES_OFFSET = 48;
+    static const size_t COUNTERS_SIZE = 56;
+  };
+}
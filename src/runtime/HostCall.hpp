@@ -0,0 +1,28 @@
+#pragma once
+
+#include "wasm.hh"
+#include <functional>
+#include "runtime/InstanceMemory.hpp"
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief What a host function is handed when a program calls it: access to the memory of the instance it was called
+   * from, to read the lists it was passed where they are rather than copying them out.
+   *
+   * Views are only valid until the host function returns, since the collector moves what's on the heap once the
+   * program carries on. Nothing stops the host from writing to a list, which every other holder of the list would then
+   * see.
+   */
+  class HostCall : public InstanceMemory {
+  public:
+    HostCall(wasm::Memory *memory) : InstanceMemory(memory) {}
+  };
+
+  /**
+   * @brief The implementation of a host function. It's called with the program's arguments, and writes its result to
+   * results[0]. Exceptions it throws trap the program.
+   */
+  using HostCallback = function<void(HostCall &call, const wasm::Val args[], wasm::Val results[])>;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "wasm.hh"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A view of values in an instance's memory, read and written in place.
+   */
+  template<typename T>
+  struct MemoryView {
+    T *data;
+    size_t size;
+
+    T* begin() const { return data; }
+    T* end() const { return data + size; }
+    T& operator[](size_t i) const { return data[i]; }
+  };
+
+  /**
+   * @brief Reads the values a program keeps on the heap where they are in an instance's memory, rather than copying
+   * them out. Every view is checked against the bounds of memory.
+   */
+  class InstanceMemory {
+  public:
+    InstanceMemory(wasm::Memory *memory) : memory(memory) {}
+
+    /**
+     * @brief The instance's memory, or nullptr if it doesn't export any.
+     */
+    wasm::Memory* getMemory() const { return memory; }
+
+    /**
+     * @brief The bytes of memory from address on.
+     */
+    MemoryView<byte_t> getBytes(uint64_t address, size_t length) const {
+      if (!memory || address + length > memory->data_size()) throw out_of_range("Read past the end of memory");
+
+      return { memory->data() + address, length };
+    }
+
+    /**
+     * @brief The elements of a List<Number>.
+     */
+    MemoryView<int64_t> getNumbers(const wasm::Val &list) const { return getElements<int64_t>(list); }
+
+    /**
+     * @brief The elements of a List<Boolean>, each 0 or 1.
+     */
+    MemoryView<int32_t> getBooleans(const wasm::Val &list) const { return getElements<int32_t>(list); }
+
+    // Where a list's elements start, after its length. See the memory layout in doc/gc_process.md
+    static const uint32_t LIST_ELEMENTS_OFFSET = 8;
+
+  protected:
+    wasm::Memory *memory;
+
+  private:
+    template<typename T>
+    MemoryView<T> getElements(const wasm::Val &list) const {
+      uint64_t address = (uint32_t) list.i32();
+
+      uint32_t length;
+      memcpy(&length, getBytes(address, sizeof(uint32_t)).data, sizeof(uint32_t));
+
+      MemoryView<byte_t> elements = getBytes(address + LIST_ELEMENTS_OFFSET, (size_t) length * sizeof(T));
+
+      return { reinterpret_cast<T*>(elements.data), length };
+    }
+  };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "wasm.hh"
+#include "runtime/ExecutionLimits.hpp"
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief An instance of a module, along with the exports it was instantiated with.
+   */
+  struct PooledInstance {
+    wasm::own<wasm::Instance> instance;
+    wasm::ownvec<wasm::Extern> exports;
+    wasm::Memory *memory = nullptr;
+  };
+
+  /**
+   * @brief Instances of a single compiled module, kept around to be run again rather than instantiated for every run.
+   * An instance handed back to the pool is put back exactly the way it was right after it was instantiated: its memory
+   * is restored from a snapshot of a fresh instance's, and the module's Theta.reset export resets everything else (see
+   * src/wasm/ThetaLangCore.wat). So each run still sees a fresh instance, it just doesn't pay for making one.
+   *
+   * Instances whose memory grew, or whose run trapped, aren't handed back, since they can't be shrunk back to their
+   * snapshot. Neither are instances of modules that don't export Theta.reset.
+   */
+  class InstancePool {
+  public:
+    /**
+     * @param store The store to instantiate the module in.
+     * @param module The compiled module.
+     * @param imports What to instantiate the module with.
+     * @param memoryExport The index of the module's memory among its exports, if it exports one.
+     * @param resetExport The index of the module's Theta.reset function among its exports, if it exports one.
+     */
+    InstancePool(
+      wasm::Store *store,
+      const wasm::Module *module,
+      vector<const wasm::Extern*> imports,
+      optional<size_t> memoryExport,
+      optional<size_t> resetExport
+    ) : store(store), module(module), imports(imports), memoryExport(memoryExport), resetExport(resetExport) {}
+
+    /**
+     * @brief An instance that's ready to run, either one that was handed back or a new one.
+     */
+    PooledInstance acquire() {
+      if (!idle.empty()) {
+        PooledInstance pooled = std::move(idle.back());
+        idle.pop_back();
+
+        // Runs disarm their deadline before handing their instance back, but an interrupt can't be left for the next
+        if (pooled.memory) pooled.memory->data()[Watchdog::INTERRUPT_OFFSET] = 0;
+
+        return pooled;
+      }
+
+      auto instance = wasm::Instance::make(store, module, imports.data());
+      if (!instance) throw runtime_error("Error instantiating module");
+
+      auto exports = instance->exports();
+      wasm::Memory *memory = memoryExport ? exports[*memoryExport]->memory() : nullptr;
+
+      PooledInstance pooled{std::move(instance), std::move(exports), memory};
+
+      // Every instance starts out the same, so the first one's memory is the snapshot they're all restored to
+      if (pooled.memory && !snapshotPages) {
+        snapshotPages = pooled.memory->size();
+        snapshot.assign(pooled.memory->data(), pooled.memory->data() + pooled.memory->data_size());
+      }
+
+      return pooled;
+    }
+
+    /**
+     * @brief Hands an instance back once it's done running, resetting it for the next run. Instances that can't be
+     * reset are dropped.
+     */
+    void release(PooledInstance pooled) {
+      if (!resetExport || !pooled.memory || idle.size() >= MAX_IDLE_INSTANCES) return;
+      if (pooled.memory->size() != *snapshotPages) return;
+
+      memcpy(pooled.memory->data(), snapshot.data(), snapshot.size());
+
+      wasm::Val args[0];
+      wasm::Val results[0];
+      if (pooled.exports[*resetExport]->func()->call(args, results)) return;
+
+      idle.push_back(std::move(pooled));
+    }
+
+    // Instances handed back past this many are dropped, so a burst of nested runs doesn't keep its memory forever
+    static const size_t MAX_IDLE_INSTANCES = 8;
+
+  private:
+    wasm::Store *store;
+    const wasm::Module *module;
+    vector<const wasm::Extern*> imports;
+    optional<size_t> memoryExport;
+    optional<size_t> resetExport;
+
+    optional<uint32_t> snapshotPages;
+    vector<byte_t> snapshot;
+
+    vector<PooledInstance> idle;
+  };
+}
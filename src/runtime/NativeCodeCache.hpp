@@ -0,0 +1,161 @@
+#pragma once
+
+#include "wasm.hh"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <v8.h>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief An on-disk cache of the machine code V8 compiles modules to, keyed by a hash of the module's binary. A
+   * runtime that finds a module here loads its code rather than compiling it again, which is most of the time it takes
+   * to first run a large module.
+   *
+   * Machine code only runs on the V8 it was compiled by, on a CPU with the same features, so both are recorded with
+   * each entry and entries recorded for anything else are ignored. V8 also checks its own flags when it loads one.
+   *
+   * Two binaries can hash the same, so each entry also keeps the binary it was compiled from, and is only loaded for
+   * a module whose bytes are the same. Running code compiled for some other module is never an option.
+   */
+  class NativeCodeCache {
+  public:
+    /**
+     * @param directory Where cache entries are stored.
+     */
+    NativeCodeCache(filesystem::path directory = DEFAULT_CACHE_DIR) : cacheDir(directory) {}
+
+    /**
+     * @brief Loads the code compiled for a module, if there is any for this V8 and CPU.
+     * @param store The store to load the module into.
+     * @param wasmHash The hash of the module's binary.
+     * @param wasmBinary The module's binary, which the entry must have been compiled from.
+     * @return The compiled module, or nullptr if there is no valid entry for it.
+     */
+    wasm::own<wasm::Module> load(wasm::Store *store, uint64_t wasmHash, const vector<char> &wasmBinary) {
+      ifstream entryFile(getEntryPath(wasmHash), ios::binary);
+      if (!entryFile) return nullptr;
+
+      vector<char> entry((istreambuf_iterator<char>(entryFile)), istreambuf_iterator<char>());
+      string header = makeHeader(wasmHash, wasmBinary.size());
+      size_t codeOffset = header.size() + wasmBinary.size();
+
+      if (entry.size() <= codeOffset || memcmp(entry.data(), header.data(), header.size()) != 0) return nullptr;
+      if (memcmp(entry.data() + header.size(), wasmBinary.data(), wasmBinary.size()) != 0) return nullptr;
+
+      auto serialized = wasm::vec<byte_t>::make_uninitialized(entry.size() - codeOffset);
+      memcpy(serialized.get(), entry.data() + codeOffset, serialized.size());
+
+      return wasm::Module::deserialize(store, serialized);
+    }
+
+    /**
+     * @brief Stores the code compiled for a module. Failing to write the entry is not an error, the next runtime to
+     * run the module will just compile it again.
+     * @param wasmHash The hash of the module's binary.
+     * @param wasmBinary The binary the module was compiled from.
+     * @param module The compiled module.
+     */
+    void store(uint64_t wasmHash, const vector<char> &wasmBinary, const wasm::Module &module) {
+      wasm::vec<byte_t> serialized = module.serialize();
+      if (!serialized) return;
+
+      error_code ec;
+      filesystem::create_directories(cacheDir, ec);
+
+      // Write to a temporary file and move it into place, so a runtime starting at the same time never loads a
+      // partially written entry
+      filesystem::path entryPath = getEntryPath(wasmHash);
+      filesystem::path tempPath = entryPath;
+      tempPath += ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()));
+
+      {
+        ofstream entryFile(tempPath, ios::binary | ios::trunc);
+        if (!entryFile) return;
+
+        string header = makeHeader(wasmHash, wasmBinary.size());
+        entryFile.write(header.data(), header.size());
+        entryFile.write(wasmBinary.data(), wasmBinary.size());
+        entryFile.write(serialized.get(), serialized.size());
+        if (!entryFile.good()) return;
+      }
+
+      filesystem::rename(tempPath, entryPath, ec);
+      if (ec) filesystem::remove(tempPath, ec);
+    }
+
+    /**
+     * @brief The features of this CPU that V8 generates different code for, such as "avx2,bmi2,popcnt".
+     */
+    static string getCPUFeatures() {
+      string features;
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+      __builtin_cpu_init();
+
+      auto add = [&features](bool isSupported, const char *name) {
+        if (!isSupported) return;
+
+        if (!features.empty()) features += ",";
+        features += name;
+      };
+
+      add(__builtin_cpu_supports("sse3"), "sse3");
+      add(__builtin_cpu_supports("ssse3"), "ssse3");
+      add(__builtin_cpu_supports("sse4.1"), "sse4.1");
+      add(__builtin_cpu_supports("sse4.2"), "sse4.2");
+      add(__builtin_cpu_supports("popcnt"), "popcnt");
+      add(__builtin_cpu_supports("avx"), "avx");
+      add(__builtin_cpu_supports("avx2"), "avx2");
+      add(__builtin_cpu_supports("fma"), "fma");
+      add(__builtin_cpu_supports("bmi"), "bmi");
+      add(__builtin_cpu_supports("bmi2"), "bmi2");
+#endif
+
+      return features;
+    }
+
+    static inline const filesystem::path DEFAULT_CACHE_DIR = filesystem::path(".theta") / "native-cache";
+
+    // Changes whenever the layout of an entry does, so that entries written by older compilers are ignored
+    static const uint32_t FORMAT_VERSION = 2;
+
+  private:
+    filesystem::path cacheDir;
+
+    filesystem::path getEntryPath(uint64_t wasmHash) {
+      char name[32];
+      snprintf(name, sizeof(name), "%016llx.native", (unsigned long long) wasmHash);
+
+      return cacheDir / name;
+    }
+
+    /**
+     * @brief What every entry for the module starts with: the entry's format, the module's hash and length, and the V8
+     * and CPU the code was compiled for, each on its own line. The module's binary follows, then its code.
+     */
+    static string makeHeader(uint64_t wasmHash, size_t wasmLength) {
+      static const string target = string(v8::V8::GetVersion()) + "\n" + getArchitecture() + ":" + getCPUFeatures() + "\n";
+
+      return "theta-native " + to_string(FORMAT_VERSION) + "\n" + to_string(wasmHash) + "\n" + to_string(wasmLength) + "\n" + target;
+    }
+
+    static string getArchitecture() {
+#if defined(__x86_64__)
+      return "x86_64";
+#elif defined(__aarch64__)
+      return "arm64";
+#else
+      return "unknown";
+#endif
+    }
+  };
+}
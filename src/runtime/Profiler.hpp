@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief Where the time went in the programs a runtime ran, for modules compiled with profiling, see
+   * Compiler::setIsProfiling. Those modules call into the host on entering and leaving each of their functions, lifted
+   * lambdas included, and the profiler times each call against the host's clock. Calls are attributed to functions by
+   * their readable names, so the same function is counted as one across every module that has it.
+   *
+   * Profiles add up over every run until reset.
+   */
+  class Profiler {
+  public:
+    struct FunctionProfile {
+      string name;
+      uint64_t calls = 0;
+
+      // Time spent in the function and everything it called, not counting recursive calls twice
+      uint64_t totalNanoseconds = 0;
+
+      // Time spent in the function itself
+      uint64_t selfNanoseconds = 0;
+    };
+
+    /**
+     * @brief The id the profiler knows a function by, made the first time it's asked for the name.
+     */
+    uint32_t getFunctionId(const string &name) {
+      auto found = functionIds.find(name);
+      if (found != functionIds.end()) return found->second;
+
+      uint32_t id = functions.size();
+      functions.push_back({ name });
+      activeDepths.push_back(0);
+      functionIds.insert(make_pair(name, id));
+
+      return id;
+    }
+
+    void enter(uint32_t functionId) {
+      functions[functionId].calls++;
+      activeDepths[functionId]++;
+
+      stack.push_back({ functionId, now(), 0 });
+      stackIds.push_back(functionId);
+    }
+
+    void exit() {
+      if (stack.empty()) return;
+
+      Frame frame = stack.back();
+      uint64_t elapsed = now() - frame.start;
+      uint64_t self = elapsed - min(elapsed, frame.childNanoseconds);
+
+      FunctionProfile &function = functions[frame.functionId];
+      function.selfNanoseconds += self;
+
+      // A recursive call's time is already part of the outermost call's
+      if (--activeDepths[frame.functionId] == 0) function.totalNanoseconds += elapsed;
+
+      selfByStack[stackIds] += self;
+
+      stack.pop_back();
+      stackIds.pop_back();
+
+      if (!stack.empty()) stack.back().childNanoseconds += elapsed;
+    }
+
+    /**
+     * @brief How many calls are in progress, so that a run that traps can drop the calls it never returned from.
+     */
+    size_t getDepth() const { return stack.size(); }
+
+    /**
+     * @brief Drops the calls in progress past the given depth, without counting their time.
+     */
+    void unwindTo(size_t depth) {
+      while (stack.size() > depth) {
+        activeDepths[stack.back().functionId]--;
+
+        stack.pop_back();
+        stackIds.pop_back();
+      }
+    }
+
+    void reset() {
+      for (FunctionProfile &function : functions) function = { function.name };
+
+      stack.clear();
+      stackIds.clear();
+      selfByStack.clear();
+      fill(activeDepths.begin(), activeDepths.end(), 0);
+    }
+
+    /**
+     * @brief The functions that were called, by the time spent in them alone, most first.
+     * @param count How many to return at most.
+     */
+    vector<FunctionProfile> getTopFunctions(size_t count) const {
+      vector<FunctionProfile> called;
+
+      for (const FunctionProfile &function : functions) {
+        if (function.calls > 0) called.push_back(function);
+      }
+
+      sort(called.begin(), called.end(), [](const FunctionProfile &a, const FunctionProfile &b) {
+        return a.selfNanoseconds > b.selfNanoseconds;
+      });
+
+      if (called.size() > count) called.resize(count);
+
+      return called;
+    }
+
+    /**
+     * @brief The time spent in each stack of calls, in the collapsed format flamegraph.pl reads: a line per stack, with
+     * the functions from the outermost in, separated by semicolons, then the nanoseconds spent at its top.
+     */
+    string toCollapsedStacks() const {
+      string collapsed;
+
+      for (auto &[ids, self] : selfByStack) {
+        for (size_t i = 0; i < ids.size(); i++) {
+          if (i > 0) collapsed += ";";
+          collapsed += functions[ids[i]].name;
+        }
+
+        collapsed += " " + to_string(self) + "\n";
+      }
+
+      return collapsed;
+    }
+
+    /**
+     * @brief A table of the functions that took the most time, with their calls and time in milliseconds.
+     * @param count How many functions to list at most.
+     */
+    string toTable(size_t count) const {
+      vector<FunctionProfile> top = getTopFunctions(count);
+
+      size_t nameWidth = string("Function").length();
+      for (const FunctionProfile &function : top) nameWidth = max(nameWidth, function.name.length());
+
+      auto row = [nameWidth](const string &name, const string &calls, const string &self, const string &total) {
+        string line = name + string(nameWidth - name.length(), ' ');
+
+        for (const string *column : { &calls, &self, &total }) {
+          line += "  " + string(column->length() < 12 ? 12 - column->length() : 0, ' ') + *column;
+        }
+
+        return line + "\n";
+      };
+
+      string table = row("Function", "Calls", "Self (ms)", "Total (ms)");
+      table += string(nameWidth + 42, '-') + "\n";
+
+      for (const FunctionProfile &function : top) {
+        table += row(
+          function.name,
+          to_string(function.calls),
+          formatMs(function.selfNanoseconds),
+          formatMs(function.totalNanoseconds)
+        );
+      }
+
+      return table;
+    }
+
+  private:
+    struct Frame {
+      uint32_t functionId;
+      uint64_t start;
+      uint64_t childNanoseconds;
+    };
+
+    vector<FunctionProfile> functions;
+    unordered_map<string, uint32_t> functionIds;
+
+    // How many calls of each function are in progress
+    vector<uint32_t> activeDepths;
+
+    vector<Frame> stack;
+    vector<uint32_t> stackIds;
+
+    map<vector<uint32_t>, uint64_t> selfByStack;
+
+    static uint64_t now() {
+      return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static string formatMs(uint64_t nanoseconds) {
+      char formatted[32];
+      snprintf(formatted, sizeof(formatted), "%.3f", nanoseconds / 1e6);
+
+      return formatted;
+    }
+  };
+}
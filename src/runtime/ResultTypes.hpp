@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief A struct as it's laid out in memory, see StructLayout.
+   */
+  struct StructType {
+    struct Field {
+      string name;
+      string type;
+      uint32_t offset;
+      uint32_t size;
+    };
+
+    string name;
+
+    // The fields, in the order they are laid out in
+    vector<Field> fields;
+
+    /**
+     * @brief The field with the given name, or nullptr if there isn't one.
+     */
+    const Field* getField(const string &fieldName) const {
+      for (const Field &field : fields) {
+        if (field.name == fieldName) return &field;
+      }
+
+      return nullptr;
+    }
+  };
+
+  /**
+   * @brief The Theta types of what a module's exported functions return, read from the theta.types custom section
+   * CodeGen adds to every module. It has a line per export, with its name and result type, such as `main0 List<Number>`,
+   * and a line per struct any of them return, with the struct's name after an @ and then each field as
+   * `name:Type:offset:size`.
+   */
+  class ResultTypes {
+  public:
+    static inline const string SECTION_NAME = "theta.types";
+
+    /**
+     * @brief Reads the result types out of a module's binary. Modules without the section have none.
+     */
+    static ResultTypes fromBinary(const vector<char> &wasmBinary) {
+      ResultTypes resultTypes;
+
+      optional<string> section = readCustomSection(wasmBinary, SECTION_NAME);
+      if (!section) return resultTypes;
+
+      istringstream lines(*section);
+      string line;
+
+      while (getline(lines, line)) {
+        istringstream words(line);
+        string name;
+        words >> name;
+
+        if (name.empty()) continue;
+
+        // Types with more than one parameter, such as Tuple<Number, Boolean>, have spaces in them
+        if (name[0] != '@') {
+          getline(words >> ws, resultTypes.exportTypes[name]);
+          continue;
+        }
+
+        StructType structType{ name.substr(1), {} };
+
+        string field;
+        while (words >> field) {
+          size_t typeStart = field.find(':');
+          size_t offsetStart = field.find(':', typeStart + 1);
+          size_t sizeStart = field.find(':', offsetStart + 1);
+          if (sizeStart == string::npos) break;
+
+          structType.fields.push_back({
+            field.substr(0, typeStart),
+            field.substr(typeStart + 1, offsetStart - typeStart - 1),
+            (uint32_t) stoul(field.substr(offsetStart + 1, sizeStart - offsetStart - 1)),
+            (uint32_t) stoul(field.substr(sizeStart + 1))
+          });
+        }
+
+        resultTypes.structTypes.insert(make_pair(structType.name, structType));
+      }
+
+      return resultTypes;
+    }
+
+    /**
+     * @brief The type an export returns, such as List<Number>, or an empty string if it isn't known.
+     */
+    string getResultType(const string &exportName) const {
+      auto found = exportTypes.find(exportName);
+      return found == exportTypes.end() ? "" : found->second;
+    }
+
+    /**
+     * @brief The struct of the given name, or nullptr if no export returns it.
+     */
+    const StructType* getStructType(const string &name) const {
+      auto found = structTypes.find(name);
+      return found == structTypes.end() ? nullptr : &found->second;
+    }
+
+    /**
+     * @brief The contents of a custom section of a module's binary, found by walking its sections.
+     */
+    static optional<string> readCustomSection(const vector<char> &wasmBinary, const string &name) {
+      // Past the magic number and version
+      size_t position = 8;
+
+      auto readLEB = [&wasmBinary, &position]() -> optional<uint32_t> {
+        uint32_t value = 0;
+
+        for (int shift = 0; shift < 35 && position < wasmBinary.size(); shift += 7) {
+          unsigned char byte = wasmBinary[position++];
+          value |= (uint32_t) (byte & 0x7f) << shift;
+
+          if (!(byte & 0x80)) return value;
+        }
+
+        return nullopt;
+      };
+
+      while (position < wasmBinary.size()) {
+        unsigned char sectionId = wasmBinary[position++];
+
+        optional<uint32_t> sectionSize = readLEB();
+        if (!sectionSize || *sectionSize > wasmBinary.size() - position) return nullopt;
+
+        size_t sectionEnd = position + *sectionSize;
+
+        if (sectionId == 0) {
+          optional<uint32_t> nameLength = readLEB();
+          if (!nameLength || position > sectionEnd || *nameLength > sectionEnd - position) return nullopt;
+
+          if (string(wasmBinary.data() + position, *nameLength) == name) {
+            position += *nameLength;
+            return string(wasmBinary.data() + position, sectionEnd - position);
+          }
+        }
+
+        position = sectionEnd;
+      }
+
+      return nullopt;
+    }
+
+  private:
+    unordered_map<string, string> exportTypes;
+    unordered_map<string, StructType> structTypes;
+  };
+}
@@ -1,81 +1,793 @@
 #pragma once
 
 #include "wasm.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <stdexcept>
 #include "runtime/ExecutionContext.hpp"
+#include "runtime/ExecutionLimits.hpp"
+#include "runtime/HostCall.hpp"
+#include "runtime/InstancePool.hpp"
+#include "runtime/NativeCodeCache.hpp"
+#include "runtime/Profiler.hpp"
+#include "runtime/ResultTypes.hpp"
+#include "runtime/RuntimeOptions.hpp"
 #include <iostream>
 #include <v8.h>
 
 using namespace std;
 
 namespace Theta {
+  /**
+   * @brief Runs compiled Theta programs. Every runtime has its own store, which must only be used by the thread that
+   * made the runtime, so each thread that runs programs needs its own runtime (see Executor for a pool of threads that
+   * each have one). The engine underneath is shared by all of them, since V8 can only be set up once per process, and
+   * so are the modules they compile: a module one runtime compiled is only obtained by the others, not compiled again.
+   */
   class Runtime {
   public:
-    wasm::own<wasm::Engine> engine;
     wasm::own<wasm::Store> store;
 
+    Runtime() : store(wasm::Store::make(getEngine())) {}
+
+    Runtime(const Runtime&) = delete;
+    Runtime& operator=(const Runtime&) = delete;
+
+    /**
+     * @brief A module's binary along with its hash, for running the module again and again without hashing its binary
+     * every time, as running it by its binary does. Handles aren't tied to a runtime: any runtime can run the module a
+     * handle is for, compiling it first if it hasn't yet. See makeHandle and precompile.
+     */
+    struct ModuleHandle {
+      uint64_t hash;
+      shared_ptr<const vector<char>> binary;
+    };
+
+    /**
+     * @brief A handle for a module, taking its binary.
+     */
+    static ModuleHandle makeHandle(vector<char> wasmBinary) {
+      uint64_t hash = hashBinary(wasmBinary);
+
+      return ModuleHandle{ hash, make_shared<const vector<char>>(std::move(wasmBinary)) };
+    }
+
+    /**
+     * @brief The calling thread's default runtime, made the first time the thread asks for it.
+     */
     static Runtime& getInstance() {
-      static Runtime instance;
+      thread_local Runtime instance;
       return instance;
     }
 
     wasm::Store* getStore() { return store.get(); }
 
-    wasm::Engine* getEngine() { return engine.get(); }
+    static wasm::Engine* getEngine() {
+      static wasm::own<wasm::Engine> engine = makeEngine();
+      return engine.get();
+    }
+
+    /**
+     * @brief Sets how V8 compiles and runs modules, for every runtime in the process. The engine is made along with the
+     * first runtime, and V8 can't be set up again after, so this has to be called before then.
+     * @return false If the engine was already made, in which case the options don't take effect
+     */
+    static bool setEngineOptions(RuntimeOptions options) {
+      EngineSetup &setup = getEngineSetup();
+      lock_guard<mutex> guard(setup.lock);
+
+      if (setup.isEngineMade) return false;
+
+      setup.options = options;
+      return true;
+    }
   
-    ExecutionContext execute(vector<char> wasmBinary, string functionName) {
-      auto binary = wasm::vec<byte_t>::make_uninitialized(wasmBinary.size());
-      memcpy(binary.get(), wasmBinary.data(), wasmBinary.size());
+    /**
+     * @brief Runs a function exported by a compiled module, in a fresh instance of the module. Modules are compiled
+     * once per runtime: running a binary that was run before reuses its compiled module and the exports looked up for
+     * it, found by a hash of the binary and then compared byte for byte. Instances are pooled per module and reset
+     * after each run, see InstancePool, so running it again usually only takes resetting an instance and calling the
+     * function.
+     */
+    ExecutionContext execute(const vector<char> &wasmBinary, const string &functionName) {
+      return execute(getCompiledModule(wasmBinary), functionName);
+    }
+
+    /**
+     * @brief Runs a function exported by the module a handle is for, like execute does with its binary, without hashing
+     * the binary again.
+     */
+    ExecutionContext execute(const ModuleHandle &handle, const string &functionName) {
+      return execute(getCompiledModule(handle), functionName);
+    }
 
-      auto wasmModule = wasm::Module::make(store.get(), binary);
-      if (!wasmModule) throw runtime_error("Error compiling module");
+    /**
+     * @brief Calls a function exported by a compiled module with arguments, in an instance of the module like execute
+     * does.
+     * @param args The function's arguments.
+     * @param argCount How many arguments there are, which has to be as many as the function takes.
+     * @param results Where the function's results are written.
+     * @param resultCapacity How many results there is room for, which has to be at least as many as the function returns.
+     */
+    void invoke(
+      const vector<char> &wasmBinary,
+      const string &functionName,
+      const wasm::Val args[],
+      size_t argCount,
+      wasm::Val results[],
+      size_t resultCapacity
+    ) {
+      invokeBatch(getCompiledModule(wasmBinary), functionName, 1, args, argCount, results, resultCapacity);
+    }
 
-      // Can pass imports in place of nullptr if needed
-      auto instance = wasm::Instance::make(store.get(), wasmModule.get(), nullptr);
-      if (!instance) throw runtime_error("Error instantiating module");
+    /**
+     * @brief Calls a function exported by the module a handle is for, like invoke does with its binary.
+     */
+    void invoke(
+      const ModuleHandle &handle,
+      const string &functionName,
+      const wasm::Val args[],
+      size_t argCount,
+      wasm::Val results[],
+      size_t resultCapacity
+    ) {
+      invokeBatch(getCompiledModule(handle), functionName, 1, args, argCount, results, resultCapacity);
+    }
+
+    /**
+     * @brief Calls a function exported by a compiled module once for each of several sets of arguments, one after the
+     * other in the same instance. The module and the function are only looked up once, and the instance is only
+     * acquired and reset once, so the calls cost little more than crossing into wasm. Programs don't keep any state in
+     * between calls, so each call still returns what it would have in an instance of its own.
+     * @param callCount How many times to call the function.
+     * @param args The arguments of each call, one set after the other, each with as many as the function takes.
+     * @param argCount How many arguments there are in all, see checkBatchSizes.
+     * @param results Where the results of each call are written, one set after the other.
+     * @param resultCapacity How many results there is room for in all, see checkBatchSizes.
+     */
+    void invokeBatch(
+      const vector<char> &wasmBinary,
+      const string &functionName,
+      size_t callCount,
+      const wasm::Val args[],
+      size_t argCount,
+      wasm::Val results[],
+      size_t resultCapacity
+    ) {
+      invokeBatch(getCompiledModule(wasmBinary), functionName, callCount, args, argCount, results, resultCapacity);
+    }
 
+    /**
+     * @brief Calls a function exported by the module a handle is for, like invokeBatch does with its binary.
+     */
+    void invokeBatch(
+      const ModuleHandle &handle,
+      const string &functionName,
+      size_t callCount,
+      const wasm::Val args[],
+      size_t argCount,
+      wasm::Val results[],
+      size_t resultCapacity
+    ) {
+      invokeBatch(getCompiledModule(handle), functionName, callCount, args, argCount, results, resultCapacity);
+    }
+
+    /**
+     * @brief Throws invalid_argument unless a batch of calls to a function is given exactly as many arguments as its
+     * calls take, and room for at least as many results as they return, so that calling it never reads or writes past
+     * either.
+     */
+    static void checkBatchSizes(
+      const string &functionName,
+      size_t callCount,
+      size_t argCount,
+      size_t resultCapacity,
+      size_t paramCount,
+      size_t resultCount
+    ) {
+      if (argCount != callCount * paramCount) {
+        throw invalid_argument(
+          functionName + " takes " + to_string(paramCount) + " arguments per call, so " + to_string(callCount) +
+          " calls take " + to_string(callCount * paramCount) + ", but were given " + to_string(argCount)
+        );
+      }
+
+      if (resultCapacity < callCount * resultCount) {
+        throw invalid_argument(
+          functionName + " returns " + to_string(resultCount) + " results per call, so " + to_string(callCount) +
+          " calls need room for " + to_string(callCount * resultCount) + ", but there is only room for " +
+          to_string(resultCapacity)
+        );
+      }
+    }
 
-      // Extract exports
-      wasm::ownvec<wasm::ExportType> exportTypes = wasmModule->exports();
-      auto instanceExports = instance->exports();
+    /**
+     * @brief Compiles a module ahead of running it, so that its first run doesn't have to, and so that its machine code
+     * gets stored if there is a native code cache.
+     * @return A handle for the module, to run it by without hashing its binary again.
+     */
+    ModuleHandle precompile(const vector<char> &wasmBinary) {
+      CompiledModule &compiled = getCompiledModule(wasmBinary);
+
+      return ModuleHandle{ compiled.hash, compiled.binary };
+    }
+
+    /**
+     * @brief Sets a cache on disk for the machine code modules compile to, shared by runtimes in other processes.
+     * Modules are looked up there before being compiled, and stored there once they are. There is none by default.
+     */
+    void setNativeCodeCache(optional<NativeCodeCache> cache) { nativeCodeCache = cache; }
+
+    /**
+     * @brief Sets what a function the host provides to programs does, see HostFunction. Modules that import it call
+     * whatever it was last set to, including modules compiled before it was set. Programs that call a host function
+     * that was never set trap.
+     */
+    void setHostFunction(const string &name, HostCallback callback) {
+      getHostImport(name).callback = callback;
+    }
+
+    /**
+     * @brief Sets how long the programs the runtime runs are allowed to run for, see ExecutionLimits. Runs that go past
+     * them throw OutOfFuelError or DeadlineExceededError rather than the runtime_error other traps throw, as runs that
+     * run out of memory throw OutOfMemoryError. There are no limits by default.
+     */
+    void setExecutionLimits(ExecutionLimits limits) { executionLimits = limits; }
+
+    /**
+     * @brief Where the time went in the programs this runtime ran, if they were compiled with profiling. Their
+     * profiles add up until the profiler is reset.
+     */
+    Profiler& getProfiler() { return profiler; }
+
+    /**
+     * @brief How many params and results a function exported by a module takes and returns.
+     */
+    pair<size_t, size_t> getArity(const vector<char> &wasmBinary, const string &functionName) {
+      const FunctionExport &function = getFunctionExport(getCompiledModule(wasmBinary), functionName);
+
+      return make_pair(function.paramCount, function.resultCount);
+    }
+
+    pair<size_t, size_t> getArity(const ModuleHandle &handle, const string &functionName) {
+      const FunctionExport &function = getFunctionExport(getCompiledModule(handle), functionName);
+
+      return make_pair(function.paramCount, function.resultCount);
+    }
+
+    /**
+     * @brief How many compiled modules the runtime keeps, and how many the runtimes of a process share. Once either has
+     * this many, the one compiled longest ago is dropped to make room for the next.
+     */
+    static const size_t MAX_COMPILED_MODULES = 64;
+
+  private:
+    struct FunctionExport {
+      size_t index;
+      size_t paramCount;
+      size_t resultCount;
+    };
+
+    struct CompiledModule {
+      // The binary the module was compiled from, which a binary hashing the same has to match to share it
+      uint64_t hash;
+      shared_ptr<const vector<char>> binary;
+
+      wasm::own<wasm::Module> module;
       vector<string> exportNames;
-      wasm::Func* func = nullptr;
+      unordered_map<string, FunctionExport> functionExports;
+      ResultTypes resultTypes;
+      shared_ptr<InstancePool> pool;
+      optional<size_t> fuelExport;
+
+      // The profiler's ids for the module's functions, by the ids the module calls the profiler with
+      vector<uint32_t> profileIds;
+    };
+
+    // Exports the core module makes for the runtime itself, rather than for the program, start with this
+    string CORE_EXPORT_PREFIX = "Theta.";
+    string RESET_EXPORT = "Theta.reset";
+    string FUEL_EXPORT = "Theta.fuel";
+
+    // The module functions the host provides are imported from, see HostFunction
+    string HOST_IMPORT_MODULE = "host";
+
+    string LIST_TYPE_PREFIX = "List<";
+
+    // What modules compiled with profiling import, and the custom section naming their functions, see Profiler
+    string PROFILE_ENTER_IMPORT = "profileEnter";
+    string PROFILE_EXIT_IMPORT = "profileExit";
+    string PROFILE_SECTION = "theta.profile";
+
+    // A function the host provides, and the function modules import it as, made from the type of the first import of it
+    struct HostImport {
+      Runtime *runtime;
+      string name;
+      HostCallback callback;
+      wasm::own<wasm::Func> func;
+    };
+
+    wasm::own<wasm::Func> clock;
+    wasm::own<wasm::Func> profileEnter;
+    wasm::own<wasm::Func> profileExit;
+    unordered_map<string, unique_ptr<HostImport>> hostImports;
+
+    // The memory of the instance last called into, which is the one any host function being called was called from
+    wasm::Memory *callingMemory = nullptr;
+
+    Profiler profiler;
+    const vector<uint32_t> *callingProfileIds = nullptr;
+
+    // How many runs are in progress, more than one when host functions run programs of their own
+    size_t runDepth = 0;
+
+    // Compiled modules by the hash of their binary, and the modules in the order they were compiled in. Binaries that
+    // hash the same but differ each get a module of their own
+    unordered_multimap<uint64_t, CompiledModule> compiledModules;
+    deque<const CompiledModule*> compiledOrder;
+
+    optional<NativeCodeCache> nativeCodeCache;
+
+    ExecutionLimits executionLimits;
+
+    // Only started once a run has a deadline
+    unique_ptr<Watchdog> watchdog;
+
+    ExecutionContext execute(CompiledModule &compiled, const string &functionName) {
+      const FunctionExport &function = getFunctionExport(compiled, functionName);
+
+      PooledInstance instance = compiled.pool->acquire();
+      wasm::Func *func = instance.exports[function.index]->func();
+      CallingScope calling(*this, instance, compiled);
+
+      ArmedDeadline deadline = armDeadline(instance);
+
+      // Call the function with no arguments. Functions returning a tuple return a value for each of its elements
+      wasm::Val args[0];
+      vector<wasm::Val> results(function.resultCount);
+
+      // An instance that trapped is dropped rather than handed back, whatever state it was left in
+      callWithinLimits(compiled, instance, func, args, results.data(), "Error calling function");
+      deadline.disarm();
+
+      ExecutionContext context(std::move(results), compiled.exportNames);
+      context.gcStats = GCStats::fromMemory(instance.memory);
+      context.resultType = compiled.resultTypes.getResultType(functionName);
+
+      const StructType *structType = compiled.resultTypes.getStructType(context.resultType);
+      if (structType) context.resultStruct = *structType;
+
+      // Lists and structs are read where they are in memory, so their instance is only handed back once the context
+      // is done with it
+      if (structType || context.resultType.rfind(LIST_TYPE_PREFIX, 0) == 0) {
+        context.resultInstance = holdInstance(compiled, std::move(instance));
+      } else {
+        compiled.pool->release(std::move(instance));
+      }
+
+      return context;
+    }
+
+    void invokeBatch(
+      CompiledModule &compiled,
+      const string &functionName,
+      size_t callCount,
+      const wasm::Val args[],
+      size_t argCount,
+      wasm::Val results[],
+      size_t resultCapacity
+    ) {
+      const FunctionExport &function = getFunctionExport(compiled, functionName);
+
+      checkBatchSizes(functionName, callCount, argCount, resultCapacity, function.paramCount, function.resultCount);
+
+      PooledInstance instance = compiled.pool->acquire();
+      wasm::Func *func = instance.exports[function.index]->func();
+      CallingScope calling(*this, instance, compiled);
+
+      ArmedDeadline deadline = armDeadline(instance);
+
+      for (size_t i = 0; i < callCount; i++) {
+        // As with execute, the instance isn't handed back once it has trapped
+        callWithinLimits(
+          compiled,
+          instance,
+          func,
+          args + i * function.paramCount,
+          results + i * function.resultCount,
+          "Error calling function, on call " + to_string(i)
+        );
+      }
+
+      deadline.disarm();
+
+      compiled.pool->release(std::move(instance));
+    }
+
+    CompiledModule& getCompiledModule(const vector<char> &wasmBinary) {
+      uint64_t hash = hashBinary(wasmBinary);
+
+      CompiledModule *cached = findCompiledModule(hash, wasmBinary);
+      if (cached) return *cached;
+
+      return compileModule(hash, make_shared<const vector<char>>(wasmBinary));
+    }
+
+    CompiledModule& getCompiledModule(const ModuleHandle &handle) {
+      CompiledModule *cached = findCompiledModule(handle.hash, *handle.binary);
+      if (cached) return *cached;
+
+      return compileModule(handle.hash, handle.binary);
+    }
+
+    CompiledModule* findCompiledModule(uint64_t hash, const vector<char> &wasmBinary) {
+      auto [first, last] = compiledModules.equal_range(hash);
+
+      // A handle shares the binary of the module it was made for, so it's usually found without comparing any bytes
+      for (auto cached = first; cached != last; cached++) {
+        const CompiledModule &compiled = cached->second;
+        if (compiled.binary.get() == &wasmBinary || *compiled.binary == wasmBinary) return &cached->second;
+      }
+
+      return nullptr;
+    }
+
+    CompiledModule& compileModule(uint64_t hash, shared_ptr<const vector<char>> binary) {
+      const vector<char> &wasmBinary = *binary;
+
+      CompiledModule compiled;
+      compiled.hash = hash;
+      compiled.binary = binary;
+      compiled.module = obtainSharedModule(hash, wasmBinary);
+
+      if (!compiled.module && nativeCodeCache) compiled.module = nativeCodeCache->load(store.get(), hash, wasmBinary);
+
+      if (!compiled.module) {
+        auto bytes = wasm::vec<byte_t>::make_uninitialized(wasmBinary.size());
+        memcpy(bytes.get(), wasmBinary.data(), wasmBinary.size());
+
+        compiled.module = wasm::Module::make(store.get(), bytes);
+        if (!compiled.module) throw runtime_error("Error compiling module");
+
+        if (nativeCodeCache) nativeCodeCache->store(hash, wasmBinary, *compiled.module);
+      }
+
+      shareModule(hash, binary, *compiled.module);
+
+      // Modules import the clock they time collections with, and the functions the host provides
+      vector<const wasm::Extern*> imports;
+
+      wasm::ownvec<wasm::ImportType> importTypes = compiled.module->imports();
+      for (size_t i = 0; i < importTypes.size(); i++) {
+        string moduleName(importTypes[i]->module().get(), importTypes[i]->module().size());
+        string importName(importTypes[i]->name().get(), importTypes[i]->name().size());
+        const wasm::FuncType *funcType = importTypes[i]->type()->func();
+
+        if (moduleName == HOST_IMPORT_MODULE && funcType) {
+          HostImport &hostImport = getHostImport(importName);
+          if (!hostImport.func) hostImport.func = wasm::Func::make(store.get(), funcType, callHost, &hostImport);
+
+          imports.push_back(hostImport.func.get());
+          continue;
+        }
+
+        if (importName == PROFILE_ENTER_IMPORT || importName == PROFILE_EXIT_IMPORT) {
+          bool isEnter = importName == PROFILE_ENTER_IMPORT;
+          wasm::own<wasm::Func> &profile = isEnter ? profileEnter : profileExit;
+
+          if (!profile) profile = wasm::Func::make(store.get(), funcType, isEnter ? enterProfiled : exitProfiled, this);
+
+          imports.push_back(profile.get());
+          continue;
+        }
+
+        if (importName != "now") throw runtime_error("Unknown import " + moduleName + "." + importName);
+
+        // Every module imports the same clock, so the store only needs the one function for it
+        if (!clock) clock = wasm::Func::make(store.get(), funcType, GCStats::now);
+
+        imports.push_back(clock.get());
+      }
+
+      optional<size_t> memoryExport;
+      optional<size_t> resetExport;
+
+      wasm::ownvec<wasm::ExportType> exportTypes = compiled.module->exports();
       for (size_t i = 0; i < exportTypes.size(); i++) {
         wasm::ExportType *exportType = exportTypes[i].get();
 
         string exportName(exportType->name().get(), exportType->name().size());
-      
-        // Save the idx of the function so we can call it later
-        if (exportType->type()->kind() == wasm::EXTERN_FUNC && exportName == functionName) {
-          func = instanceExports[i]->func();
+
+        if (exportType->type()->kind() == wasm::EXTERN_MEMORY) memoryExport = i;
+
+        if (exportName.compare(0, CORE_EXPORT_PREFIX.length(), CORE_EXPORT_PREFIX) == 0) {
+          if (exportName == RESET_EXPORT) resetExport = i;
+          if (exportName == FUEL_EXPORT) compiled.fuelExport = i;
+
+          continue;
         }
-      
-        exportNames.push_back(exportName);
+
+        if (exportType->type()->kind() == wasm::EXTERN_FUNC) {
+          const wasm::FuncType *funcType = exportType->type()->func();
+
+          compiled.functionExports.insert(make_pair(
+            exportName,
+            FunctionExport{ i, funcType->params().size(), funcType->results().size() }
+          ));
+        }
+
+        compiled.exportNames.push_back(exportName);
       }
 
-      if (!func) throw runtime_error("Exported function not found");
+      compiled.resultTypes = ResultTypes::fromBinary(wasmBinary);
+
+      optional<string> profileNames = ResultTypes::readCustomSection(wasmBinary, PROFILE_SECTION);
+      if (profileNames) {
+        istringstream names(*profileNames);
+        string name;
+
+        while (getline(names, name)) compiled.profileIds.push_back(profiler.getFunctionId(name));
+      }
+      compiled.pool = make_shared<InstancePool>(store.get(), compiled.module.get(), imports, memoryExport, resetExport);
+
+      // Modules are only dropped in between runs, since a host function can compile one while another is running
+      while (compiledOrder.size() >= MAX_COMPILED_MODULES && runDepth == 0) {
+        const CompiledModule *oldest = compiledOrder.front();
+        auto [first, last] = compiledModules.equal_range(oldest->hash);
+
+        for (auto cached = first; cached != last; cached++) {
+          if (&cached->second == oldest) {
+            compiledModules.erase(cached);
+            break;
+          }
+        }
+
+        compiledOrder.pop_front();
+      }
+
+      CompiledModule &inserted = compiledModules.insert(make_pair(hash, std::move(compiled)))->second;
+      compiledOrder.push_back(&inserted);
+
+      return inserted;
+    }
+
+    /**
+     * @brief Modules compiled by any runtime in the process, in a form any other store can obtain them from, by the
+     * hash of their binary. Only the first of several binaries that hash the same is shared, the others are compiled
+     * by each runtime that runs them.
+     */
+    struct SharedModule {
+      shared_ptr<const vector<char>> binary;
+      wasm::own<wasm::Shared<wasm::Module>> module;
+    };
+
+    struct SharedModules {
+      mutex lock;
+      unordered_map<uint64_t, SharedModule> modules;
+      deque<uint64_t> order;
+    };
+
+    static SharedModules& getSharedModules() {
+      static SharedModules sharedModules;
+      return sharedModules;
+    }
+
+    wasm::own<wasm::Module> obtainSharedModule(uint64_t hash, const vector<char> &wasmBinary) {
+      SharedModules &shared = getSharedModules();
+      lock_guard<mutex> guard(shared.lock);
+
+      auto module = shared.modules.find(hash);
+      if (module == shared.modules.end()) return nullptr;
+
+      const SharedModule &sharedModule = module->second;
+      if (sharedModule.binary.get() != &wasmBinary && *sharedModule.binary != wasmBinary) return nullptr;
+
+      return wasm::Module::obtain(store.get(), sharedModule.module.get());
+    }
+
+    static void shareModule(uint64_t hash, shared_ptr<const vector<char>> binary, const wasm::Module &module) {
+      SharedModules &shared = getSharedModules();
+      lock_guard<mutex> guard(shared.lock);
+
+      if (shared.modules.count(hash)) return;
+
+      if (shared.order.size() == MAX_COMPILED_MODULES) {
+        shared.modules.erase(shared.order.front());
+        shared.order.pop_front();
+      }
+
+      shared.order.push_back(hash);
+      shared.modules.insert(make_pair(hash, SharedModule{ binary, module.share() }));
+    }
+
+    /**
+     * @brief Keeps an instance out of its pool for as long as something holds on to it, handing it back after. Instances
+     * of modules the runtime has dropped since are dropped too.
+     */
+    static shared_ptr<PooledInstance> holdInstance(CompiledModule &compiled, PooledInstance instance) {
+      weak_ptr<InstancePool> pool = compiled.pool;
+
+      return shared_ptr<PooledInstance>(new PooledInstance(std::move(instance)), [pool](PooledInstance *held) {
+        if (shared_ptr<InstancePool> owner = pool.lock()) owner->release(std::move(*held));
+
+        delete held;
+      });
+    }
+
+    /**
+     * @brief Points host functions at the instance a run calls into for as long as the run lasts. Host functions can
+     * run programs of their own, so the instance called into before is pointed at again once the run is over.
+     */
+    struct CallingScope {
+      Runtime &runtime;
+      wasm::Memory *enclosingMemory;
+      const vector<uint32_t> *enclosingProfileIds;
+
+      CallingScope(Runtime &runtime, const PooledInstance &instance, const CompiledModule &compiled)
+        : runtime(runtime), enclosingMemory(runtime.callingMemory), enclosingProfileIds(runtime.callingProfileIds) {
+        runtime.callingMemory = instance.memory;
+        runtime.callingProfileIds = &compiled.profileIds;
+        runtime.runDepth++;
+      }
+
+      ~CallingScope() {
+        runtime.callingMemory = enclosingMemory;
+        runtime.callingProfileIds = enclosingProfileIds;
+        runtime.runDepth--;
+      }
+    };
+
+    /**
+     * @brief Disarms the watchdog once the run it was armed for is over, however it ended. Runs that finish have to
+     * disarm it before handing their instance back, or it could still interrupt the instance while it's idle.
+     */
+    struct ArmedDeadline {
+      Watchdog *watchdog;
+
+      void disarm() {
+        if (watchdog) watchdog->disarm();
+        watchdog = nullptr;
+      }
+
+      ~ArmedDeadline() { disarm(); }
+    };
+
+    ArmedDeadline armDeadline(const PooledInstance &instance) {
+      if (!executionLimits.deadline || !instance.memory) return ArmedDeadline{ nullptr };
+
+      if (!watchdog) watchdog = make_unique<Watchdog>();
+      watchdog->arm(instance.memory, *executionLimits.deadline);
+
+      return ArmedDeadline{ watchdog.get() };
+    }
+
+    /**
+     * @brief Calls a function with the fuel it's allowed, throwing if it traps. Running out of fuel and being
+     * interrupted are told apart from other traps by the fuel left and the interrupt flag, since metered modules trap
+     * the same way for all of them, and running out of memory by the flag the collector sets before it traps.
+     */
+    void callWithinLimits(
+      const CompiledModule &compiled,
+      const PooledInstance &instance,
+      wasm::Func *func,
+      const wasm::Val args[],
+      wasm::Val results[],
+      const string &trapMessage
+    ) {
+      wasm::Global *fuel = compiled.fuelExport ? instance.exports[*compiled.fuelExport]->global() : nullptr;
+      if (fuel && executionLimits.fuel) fuel->set(wasm::Val::i64((int64_t) min<uint64_t>(*executionLimits.fuel, INT64_MAX)));
+
+      size_t profileDepth = profiler.getDepth();
 
-      // Call the function with no arguments
-      wasm::Val args[0];  // No arguments for this test
-      wasm::Val results[1];  // A single result (the number returned by the function)
       auto trap = func->call(args, results);
+      if (!trap) return;
 
+      // The calls the trap cut short never return to the profiler
+      profiler.unwindTo(profileDepth);
 
-      if (trap) throw runtime_error("Error calling function");
+      if (fuel && executionLimits.fuel && fuel->get().i64() < 0) throw OutOfFuelError(*executionLimits.fuel);
 
-      return ExecutionContext(std::move(results[0]), exportNames);
+      if (executionLimits.deadline && instance.memory && instance.memory->data()[Watchdog::INTERRUPT_OFFSET]) {
+        throw DeadlineExceededError(*executionLimits.deadline);
+      }
+
+      if (instance.memory && instance.memory->data()[OutOfMemoryError::FLAG_OFFSET]) throw OutOfMemoryError();
+
+      throw runtime_error(trapMessage);
     }
-  
-  private:
-    Runtime() {
-      v8::V8::SetFlagsFromString("--experimental-wasm-stringref");
-      engine = wasm::Engine::make();
-      store = wasm::Store::make(engine.get());
-    } 
 
-    Runtime(const Runtime&) = delete;
-    Runtime& operator=(const Runtime&) = delete;
+    HostImport& getHostImport(const string &name) {
+      unique_ptr<HostImport> &hostImport = hostImports[name];
+      if (!hostImport) hostImport = make_unique<HostImport>(HostImport{ this, name, nullptr, nullptr });
+
+      return *hostImport;
+    }
+
+    /**
+     * @brief What every host function is made with, calling the callback the host set for it. Exceptions it throws,
+     * and calls to host functions that were never set, trap the program.
+     */
+    static wasm::own<wasm::Trap> callHost(void *env, const wasm::Val args[], wasm::Val results[]) {
+      HostImport *hostImport = static_cast<HostImport*>(env);
+      wasm::Store *store = hostImport->runtime->getStore();
+
+      if (!hostImport->callback) {
+        return wasm::Trap::make(store, wasm::Message::make("Host function " + hostImport->name + " was never set"));
+      }
+
+      try {
+        HostCall call(hostImport->runtime->callingMemory);
+        hostImport->callback(call, args, results);
+      } catch (const exception &e) {
+        return wasm::Trap::make(store, wasm::Message::make(hostImport->name + ": " + e.what()));
+      }
+
+      return nullptr;
+    }
+
+    static wasm::own<wasm::Trap> enterProfiled(void *env, const wasm::Val args[], wasm::Val results[]) {
+      Runtime *runtime = static_cast<Runtime*>(env);
+      runtime->profiler.enter((*runtime->callingProfileIds)[args[0].i32()]);
+
+      return nullptr;
+    }
+
+    static wasm::own<wasm::Trap> exitProfiled(void *env, const wasm::Val args[], wasm::Val results[]) {
+      static_cast<Runtime*>(env)->profiler.exit();
+
+      return nullptr;
+    }
+
+    static const FunctionExport& getFunctionExport(const CompiledModule &compiled, const string &functionName) {
+      auto function = compiled.functionExports.find(functionName);
+      if (function == compiled.functionExports.end()) throw runtime_error("Exported function not found");
+
+      return function->second;
+    }
+
+    static uint64_t hashBinary(const vector<char> &wasmBinary) {
+      // FNV-1a, like the compiler's caches. The length is mixed in too, so that a binary and a prefix of it never share
+      // a hash just because the rest of it happened to cancel out
+      uint64_t hash = 14695981039346656037ULL ^ wasmBinary.size();
+
+      for (unsigned char c : wasmBinary) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+      }
+
+      return hash;
+    }
+
+    struct EngineSetup {
+      mutex lock;
+      RuntimeOptions options;
+      bool isEngineMade = false;
+    };
+
+    static EngineSetup& getEngineSetup() {
+      static EngineSetup setup;
+      return setup;
+    }
+
+    static wasm::own<wasm::Engine> makeEngine() {
+      EngineSetup &setup = getEngineSetup();
+      lock_guard<mutex> guard(setup.lock);
+
+      setup.isEngineMade = true;
+
+      // V8 reads its flags when the engine is made, so they must be set first
+      v8::V8::SetFlagsFromString(setup.options.toV8Flags().c_str());
+      return wasm::Engine::make();
+    }
   };
 }
 
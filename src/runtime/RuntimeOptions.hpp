@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cctype>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+namespace Theta {
+  /**
+   * @brief How V8 compiles and runs the modules every runtime in the process runs. V8 reads its flags once, when the
+   * engine is made, so these only take effect if they are set before the first runtime is, see
+   * Runtime::setEngineOptions.
+   */
+  struct RuntimeOptions {
+    enum class CompilationStrategy {
+      // Starts every function on Liftoff, V8's baseline compiler, and recompiles the ones that run hot with TurboFan.
+      // V8's own default
+      DYNAMIC,
+      // Only ever compiles with Liftoff, for the fastest startup, at the cost of slower code
+      LIFTOFF,
+      // Starts on Liftoff, but recompiles every function with TurboFan in the background straight away, for the best
+      // code in long running programs
+      TURBOFAN,
+      // Compiles each function the first time it's called, rather than the whole module up front
+      LAZY
+    };
+
+    CompilationStrategy compilationStrategy = CompilationStrategy::DYNAMIC;
+
+    // The most machine code V8 keeps for wasm modules, in megabytes, or V8's own limit if unset
+    optional<int> codeSpaceMegabytes;
+
+    // Modules the compiler generates need tail calls and multiple values, so only hosts running modules of their own
+    // should turn these off
+    bool isTailCallEnabled = true;
+    bool isSimdEnabled = true;
+    bool isMultiValueEnabled = true;
+
+    /**
+     * @brief Parses a compilation strategy, for the --wasm-tier flag: dynamic, liftoff, turbofan or lazy.
+     * @return The strategy, or nullopt if it isn't one
+     */
+    static optional<CompilationStrategy> parseCompilationStrategy(const string &strategy) {
+      if (strategy == "dynamic") return CompilationStrategy::DYNAMIC;
+      if (strategy == "liftoff") return CompilationStrategy::LIFTOFF;
+      if (strategy == "turbofan") return CompilationStrategy::TURBOFAN;
+      if (strategy == "lazy") return CompilationStrategy::LAZY;
+
+      return nullopt;
+    }
+
+    /**
+     * @brief Parses a size in megabytes, for the --wasm-code-space flag.
+     * @return The size, or nullopt if it isn't a number between 1 and MAX_CODE_SPACE_MEGABYTES
+     */
+    static optional<int> parseCodeSpaceMegabytes(const string &megabytes) {
+      if (megabytes.empty() || megabytes.length() > 9) return nullopt;
+
+      for (char c : megabytes) {
+        if (!isdigit(static_cast<unsigned char>(c))) return nullopt;
+      }
+
+      int parsed = stoi(megabytes);
+      if (parsed < 1 || parsed > MAX_CODE_SPACE_MEGABYTES) return nullopt;
+
+      return parsed;
+    }
+
+    /**
+     * @brief The flags V8 is set up with for these options. Strings are always enabled, since every module the
+     * compiler generates uses them.
+     */
+    string toV8Flags() const {
+      string flags = "--experimental-wasm-stringref";
+
+      flags += isTailCallEnabled ? " --experimental-wasm-return-call" : " --no-experimental-wasm-return-call";
+      flags += isSimdEnabled ? " --experimental-wasm-simd" : " --no-experimental-wasm-simd";
+      flags += isMultiValueEnabled ? " --experimental-wasm-mv" : " --no-experimental-wasm-mv";
+
+      switch (compilationStrategy) {
+        case CompilationStrategy::DYNAMIC:
+          flags += " --liftoff --wasm-tier-up --wasm-dynamic-tiering --no-wasm-lazy-compilation";
+          break;
+        case CompilationStrategy::LIFTOFF:
+          flags += " --liftoff --no-wasm-tier-up --no-wasm-dynamic-tiering --no-wasm-lazy-compilation";
+          break;
+        case CompilationStrategy::TURBOFAN:
+          flags += " --liftoff --wasm-tier-up --no-wasm-dynamic-tiering --no-wasm-lazy-compilation";
+          break;
+        case CompilationStrategy::LAZY:
+          flags += " --wasm-lazy-compilation";
+          break;
+      }
+
+      if (codeSpaceMegabytes) flags += " --wasm-max-code-space-size-mb=" + to_string(*codeSpaceMegabytes);
+
+      return flags;
+    }
+
+    static const int MAX_CODE_SPACE_MEGABYTES = 4096;
+  };
+}
@@ -1,6 +1,736 @@
 (module
 ;;  (import "console" "log" (func $log (param stringref))) ;; TODO: Remove this
-  (memory $0 1 10)
+  (memory $0 9 1024)
+
+  ;; Strings can't be stored in memory, so heap cells hold their index in this table instead. Index 0 is never handed
+  ;; out, and the indices of strings whose cells didn't survive a collection are handed out again after it
+  (table $ThetaStringRefs 64 stringref)
+  (global $Theta.Strings.nextIndex (mut i32) (i32.const 1))
+
+  ;; How many strings have survived the collection in progress
+  (global $Theta.Strings.liveCount (mut i32) (i32.const 0))
+
+  ;; Memory is laid out as the collector's counters and the shadow stack, which take up the first page, followed by the
+  ;; tables of memoized functions, if there are any, and then the heap. The compiler moves the start of the heap past
+  ;; the pages the tables take up. The heap is split into two equal semispaces, and objects are only ever allocated in
+  ;; the current one. See doc/gc_process.md
+  (global $Theta.GC.SHADOW_STACK_START i32 (i32.const 64))
+  (global $Theta.GC.SHADOW_STACK_END i32 (i32.const 65536))
+  (global $Theta.GC.HEAP_START i32 (i32.const 65536))
+
+  ;; Kinds of heap object. Data holds no heap references, a reference holds one, a closure holds a pointer to each
+  ;; argument bound to it, which are the slots after its arity, and a string holds an index into the string table
+  (global $Theta.GC.KIND_DATA i32 (i32.const 0))
+  (global $Theta.GC.KIND_REFERENCE i32 (i32.const 1))
+  (global $Theta.GC.KIND_CLOSURE i32 (i32.const 2))
+  (global $Theta.GC.KIND_STRING i32 (i32.const 3))
+
+  ;; Counters the host reads out of memory once a program has run. The byte counts and the total pause time, in
+  ;; nanoseconds, are i64s, and the number of collections and the deepest the shadow stack got, in slots, are i32s
+  (global $Theta.GC.STATS_BYTES_ALLOCATED i32 (i32.const 0))
+  (global $Theta.GC.STATS_BYTES_COPIED i32 (i32.const 8))
+  (global $Theta.GC.STATS_PAUSE_NANOSECONDS i32 (i32.const 16))
+  (global $Theta.GC.STATS_COLLECTIONS i32 (i32.const 24))
+  (global $Theta.GC.STATS_MAX_SHADOW_STACK_DEPTH i32 (i32.const 28))
+
+  ;; Modules compiled with fuel metering spend a unit of fuel on entering a function and on each turn of a loop, and
+  ;; trap once it runs out or once the host sets the interrupt flag, a byte of memory after the counters. The host sets
+  ;; the fuel before each run, and there's no limit unless it does
+  (global $Theta.Fuel.remaining (export "Theta.fuel") (mut i64) (i64.const 0x7fffffffffffffff))
+  (global $Theta.Fuel.INTERRUPT i32 (i32.const 32))
+
+  ;; Set just before trapping when a function allocates more than the heap has room for, so that the host can tell
+  ;; running out of memory apart from other traps. A byte after the interrupt flag
+  (global $Theta.GC.OUT_OF_MEMORY i32 (i32.const 33))
+
+  ;; How many calls to memoized functions were answered from their tables, and how many had to run, as i64s after the
+  ;; interrupt flag
+  (global $Theta.Memo.STATS_HITS i32 (i32.const 40))
+  (global $Theta.Memo.STATS_MISSES i32 (i32.const 48))
+
+  ;; Memo table entries are grouped into sets of this many, and are flagged as occupied once a result is stored in
+  ;; them, and as referenced whenever they're found
+  (global $Theta.Memo.WAYS i32 (i32.const 4))
+  (global $Theta.Memo.OCCUPIED i32 (i32.const 1))
+  (global $Theta.Memo.REFERENCED i32 (i32.const 2))
+
+  ;; The heap references held by running functions, a frame per function. The pointer is the end of the top frame
+  (global $Theta.GC.shadowStackPointer (mut i32) (i32.const 64))
+
+  (global $Theta.GC.semispaceSize (mut i32) (i32.const 0))
+  (global $Theta.GC.fromSpace (mut i32) (i32.const 0))
+  (global $Theta.GC.fromSpaceEnd (mut i32) (i32.const 0))
+  (global $Theta.GC.toSpace (mut i32) (i32.const 0))
+  (global $Theta.GC.heapPointer (mut i32) (i32.const 0))
+
+  ;; Once the heap pointer passes the threshold, the next function boundary collects
+  (global $Theta.GC.collectionThreshold (mut i32) (i32.const 0))
+  (global $Theta.GC.isCollectionRequested (mut i32) (i32.const 0))
+
+  ;; The percentage of the space left after a collection that can be allocated before the next one. The compiler
+  ;; replaces it with the one it was configured with
+  (global $Theta.GC.collectionRatio i32 (i32.const 50))
+
+  ;; Set when more than the collection ratio of a semispace survived a collection, so the next one grows the heap
+  (global $Theta.GC.isGrowthRequested (mut i32) (i32.const 0))
+
+  ;; Incremented by every collection. Functions compare it to the epoch they last loaded their heap references in, to
+  ;; tell whether they have to load them from their frame again
+  (global $Theta.GC.epoch (mut i32) (i32.const 0))
+
+  (start $Theta.GC.initialize)
+
+  ;; The time in nanoseconds, for timing collections. Pauses aren't timed by default, and the compiler replaces this
+  ;; with a clock imported from the host when they are
+  (func $Theta.GC.now (result i64)
+    (i64.const 0)
+  )
+
+  ;; The address after which the collection ratio of the space from the given address to the end of from-space is used
+  (func $Theta.GC.thresholdFrom (param $start i32) (result i32)
+    (i32.add
+      (local.get $start)
+      (i32.mul
+        (i32.div_u
+          (i32.sub (global.get $Theta.GC.fromSpaceEnd) (local.get $start))
+          (i32.const 100)
+        )
+        (global.get $Theta.GC.collectionRatio)
+      )
+    )
+  )
+
+  ;; Puts an instance back the way it was right after it was instantiated, so that hosts can run programs in it again
+  ;; rather than instantiating the module for every run. The host restores memory from a snapshot before calling this,
+  ;; which resets everything else: the strings left in the string table, and the globals that change while running
+  (func $Theta.reset (export "Theta.reset")
+    (table.fill $ThetaStringRefs (i32.const 1) (string.const "") (i32.sub (table.size $ThetaStringRefs) (i32.const 1)))
+
+    (global.set $Theta.Strings.nextIndex (i32.const 1))
+    (global.set $Theta.Strings.liveCount (i32.const 0))
+    (global.set $Theta.GC.shadowStackPointer (global.get $Theta.GC.SHADOW_STACK_START))
+    (global.set $Theta.GC.isCollectionRequested (i32.const 0))
+    (global.set $Theta.GC.isGrowthRequested (i32.const 0))
+    (global.set $Theta.GC.epoch (i32.const 0))
+    (global.set $Theta.Fuel.remaining (i64.const 0x7fffffffffffffff))
+
+    (call $Theta.GC.initialize)
+  )
+
+  (func $Theta.GC.initialize
+    (global.set $Theta.GC.semispaceSize
+      (i32.and
+        (i32.shr_u
+          (i32.sub
+            (i32.shl (memory.size) (i32.const 16))
+            (global.get $Theta.GC.HEAP_START)
+          )
+          (i32.const 1)
+        )
+        (i32.const -8)
+      )
+    )
+    (global.set $Theta.GC.fromSpace (global.get $Theta.GC.HEAP_START))
+    (global.set $Theta.GC.fromSpaceEnd (i32.add (global.get $Theta.GC.fromSpace) (global.get $Theta.GC.semispaceSize)))
+    (global.set $Theta.GC.toSpace (global.get $Theta.GC.fromSpaceEnd))
+    (global.set $Theta.GC.heapPointer (global.get $Theta.GC.fromSpace))
+    (global.set $Theta.GC.collectionThreshold (call $Theta.GC.thresholdFrom (global.get $Theta.GC.fromSpace)))
+  )
+
+  ;; Allocates an object of the given size and kind, returning a pointer to it. Never collects, so pointers held by the
+  ;; caller stay valid until the next function boundary. Each object is preceded by a header of two words: its size
+  ;; shifted left by two and or-ed with its kind, and the address it was copied to, which is 0 until it is copied
+  (func $Theta.GC.allocate (param $size i32) (param $kind i32) (result i32) (local $object i32) (local $next i32)
+    (local.set $object (i32.add (global.get $Theta.GC.heapPointer) (i32.const 8)))
+    (local.set $next
+      (i32.add
+        (local.get $object)
+        (i32.and (i32.add (local.get $size) (i32.const 7)) (i32.const -8))
+      )
+    )
+
+    ;; A function allocated more than the space left between collections, without reaching a function boundary
+    (if (i32.gt_u (local.get $next) (global.get $Theta.GC.fromSpaceEnd))
+      (then (call $Theta.GC.outOfMemory))
+    )
+
+    (i32.store
+      (global.get $Theta.GC.heapPointer)
+      (i32.or (i32.shl (local.get $size) (i32.const 2)) (local.get $kind))
+    )
+    (i32.store offset=4 (global.get $Theta.GC.heapPointer) (i32.const 0))
+    (i64.store
+      (global.get $Theta.GC.STATS_BYTES_ALLOCATED)
+      (i64.add
+        (i64.load (global.get $Theta.GC.STATS_BYTES_ALLOCATED))
+        (i64.extend_i32_u (i32.sub (local.get $next) (global.get $Theta.GC.heapPointer)))
+      )
+    )
+    (global.set $Theta.GC.heapPointer (local.get $next))
+
+    (if (i32.ge_u (local.get $next) (global.get $Theta.GC.collectionThreshold))
+      (then (global.set $Theta.GC.isCollectionRequested (i32.const 1)))
+    )
+
+    (local.get $object)
+  )
+
+  ;; Traps, flagging that it was for running out of memory. Objects can't be moved while the function that allocated
+  ;; them is still using them, so there's no collecting to make room
+  (func $Theta.GC.outOfMemory
+    (i32.store8 (global.get $Theta.GC.OUT_OF_MEMORY) (i32.const 1))
+    (unreachable)
+  )
+
+  ;; Pushes a frame of the given number of slots onto the shadow stack, returning its address. Frames are popped by
+  ;; setting the shadow stack pointer back to that address
+  (func $Theta.GC.pushFrame (param $slots i32) (result i32) (local $frame i32) (local $slot i32) (local $depth i32)
+    (local.set $frame (global.get $Theta.GC.shadowStackPointer))
+    (global.set $Theta.GC.shadowStackPointer
+      (i32.add (local.get $frame) (i32.shl (local.get $slots) (i32.const 2)))
+    )
+
+    (if (i32.gt_u (global.get $Theta.GC.shadowStackPointer) (global.get $Theta.GC.SHADOW_STACK_END))
+      (then (unreachable))
+    )
+
+    (local.set $depth
+      (i32.shr_u
+        (i32.sub (global.get $Theta.GC.shadowStackPointer) (global.get $Theta.GC.SHADOW_STACK_START))
+        (i32.const 2)
+      )
+    )
+    (if (i32.gt_u (local.get $depth) (i32.load (global.get $Theta.GC.STATS_MAX_SHADOW_STACK_DEPTH)))
+      (then (i32.store (global.get $Theta.GC.STATS_MAX_SHADOW_STACK_DEPTH) (local.get $depth)))
+    )
+
+    ;; Every slot is a root as soon as the frame is pushed, so none of them can keep what an earlier frame left there
+    (local.set $slot (local.get $frame))
+    (block $done
+      (loop $clear
+        (br_if $done (i32.ge_u (local.get $slot) (global.get $Theta.GC.shadowStackPointer)))
+        (i32.store (local.get $slot) (i32.const 0))
+        (local.set $slot (i32.add (local.get $slot) (i32.const 4)))
+        (br $clear)
+      )
+    )
+
+    (local.get $frame)
+  )
+
+  ;; Copies an object into to-space, if it wasn't already, and returns its new address. Anything that doesn't point
+  ;; into from-space, such as an empty slot or a boolean, is returned as it is
+  (func $Theta.GC.forward (param $object i32) (result i32) (local $header i32) (local $copy i32) (local $offset i32)
+    (if
+      (i32.or
+        (i32.lt_u (local.get $object) (global.get $Theta.GC.fromSpace))
+        (i32.ge_u (local.get $object) (global.get $Theta.GC.fromSpaceEnd))
+      )
+      (then (return (local.get $object)))
+    )
+
+    (local.set $copy (i32.load (i32.sub (local.get $object) (i32.const 4))))
+    (if (local.get $copy)
+      (then (return (local.get $copy)))
+    )
+
+    (local.set $header (i32.sub (local.get $object) (i32.const 8)))
+    (local.set $copy (i32.add (global.get $Theta.GC.heapPointer) (i32.const 8)))
+
+    ;; Objects are a multiple of 8 bytes long, header included
+    (local.set $offset (i32.const 0))
+    (block $done
+      (loop $copyWord
+        (br_if $done
+          (i32.ge_u
+            (local.get $offset)
+            (i32.add
+              (i32.and
+                (i32.add (i32.shr_u (i32.load (local.get $header)) (i32.const 2)) (i32.const 7))
+                (i32.const -8)
+              )
+              (i32.const 8)
+            )
+          )
+        )
+        (i64.store
+          (i32.add (global.get $Theta.GC.heapPointer) (local.get $offset))
+          (i64.load (i32.add (local.get $header) (local.get $offset)))
+        )
+        (local.set $offset (i32.add (local.get $offset) (i32.const 8)))
+        (br $copyWord)
+      )
+    )
+
+    (global.set $Theta.GC.heapPointer (i32.add (global.get $Theta.GC.heapPointer) (local.get $offset)))
+    (i32.store (i32.sub (local.get $object) (i32.const 4)) (local.get $copy))
+
+    (local.get $copy)
+  )
+
+  ;; Forwards the object a slot points to, and updates the slot to point to its copy
+  (func $Theta.GC.forwardSlot (param $slot i32)
+    (i32.store (local.get $slot) (call $Theta.GC.forward (i32.load (local.get $slot))))
+  )
+
+  ;; Copies everything reachable from the shadow stack into to-space, which then becomes the space allocated in. Objects
+  ;; that were copied are scanned in the order they were copied in, so no stack of objects left to scan is needed
+  (func $Theta.GC.collect
+    (local $slot i32) (local $scan i32) (local $object i32) (local $header i32) (local $end i32)
+    (local $start i64) (local $memoryEnd i32) (local $hasGrown i32)
+    (local.set $start (call $Theta.GC.now))
+
+    ;; The heap doubles by growing memory by as much as the heap already takes up, and copying into the new memory. All
+    ;; of the memory before it then becomes the other semispace. If memory can't grow any more, the heap stays as it is
+    (if (global.get $Theta.GC.isGrowthRequested)
+      (then
+        (local.set $memoryEnd (i32.shl (memory.size) (i32.const 16)))
+        (if
+          (i32.ne
+            (memory.grow
+              (i32.shr_u (i32.sub (local.get $memoryEnd) (global.get $Theta.GC.HEAP_START)) (i32.const 16))
+            )
+            (i32.const -1)
+          )
+          (then
+            (global.set $Theta.GC.semispaceSize (i32.sub (local.get $memoryEnd) (global.get $Theta.GC.HEAP_START)))
+            (global.set $Theta.GC.toSpace (local.get $memoryEnd))
+            (local.set $hasGrown (i32.const 1))
+          )
+        )
+        (global.set $Theta.GC.isGrowthRequested (i32.const 0))
+      )
+    )
+
+    (global.set $Theta.GC.heapPointer (global.get $Theta.GC.toSpace))
+
+    (local.set $slot (global.get $Theta.GC.SHADOW_STACK_START))
+    (block $rootsDone
+      (loop $roots
+        (br_if $rootsDone (i32.ge_u (local.get $slot) (global.get $Theta.GC.shadowStackPointer)))
+        (call $Theta.GC.forwardSlot (local.get $slot))
+        (local.set $slot (i32.add (local.get $slot) (i32.const 4)))
+        (br $roots)
+      )
+    )
+
+    (local.set $scan (global.get $Theta.GC.toSpace))
+    (block $scanDone
+      (loop $scanObject
+        (br_if $scanDone (i32.ge_u (local.get $scan) (global.get $Theta.GC.heapPointer)))
+
+        (local.set $header (i32.load (local.get $scan)))
+        (local.set $object (i32.add (local.get $scan) (i32.const 8)))
+        (local.set $end (i32.add (local.get $object) (i32.shr_u (local.get $header) (i32.const 2))))
+
+        (if (i32.eq (i32.and (local.get $header) (i32.const 3)) (global.get $Theta.GC.KIND_REFERENCE))
+          (then (call $Theta.GC.forwardSlot (local.get $object)))
+        )
+
+        (if (i32.eq (i32.and (local.get $header) (i32.const 3)) (global.get $Theta.GC.KIND_STRING))
+          (then (call $Theta.Strings.relocate (local.get $object)))
+        )
+
+        (if (i32.eq (i32.and (local.get $header) (i32.const 3)) (global.get $Theta.GC.KIND_CLOSURE))
+          (then
+            ;; Slots before the arity are still waiting for arguments
+            (local.set $slot
+              (i32.add
+                (i32.add (local.get $object) (i32.const 8))
+                (i32.shl (i32.load offset=4 (local.get $object)) (i32.const 2))
+              )
+            )
+            (block $slotsDone
+              (loop $slots
+                (br_if $slotsDone (i32.ge_u (local.get $slot) (local.get $end)))
+                (call $Theta.GC.forwardSlot (local.get $slot))
+                (local.set $slot (i32.add (local.get $slot) (i32.const 4)))
+                (br $slots)
+              )
+            )
+          )
+        )
+
+        (local.set $scan
+          (i32.add
+            (local.get $object)
+            (i32.and (i32.add (i32.shr_u (local.get $header) (i32.const 2)) (i32.const 7)) (i32.const -8))
+          )
+        )
+        (br $scanObject)
+      )
+    )
+
+    (call $Theta.Strings.compact)
+
+    (local.set $slot (global.get $Theta.GC.fromSpace))
+    (if (local.get $hasGrown)
+      (then (local.set $slot (global.get $Theta.GC.HEAP_START)))
+    )
+    (global.set $Theta.GC.fromSpace (global.get $Theta.GC.toSpace))
+    (global.set $Theta.GC.fromSpaceEnd (i32.add (global.get $Theta.GC.fromSpace) (global.get $Theta.GC.semispaceSize)))
+    (global.set $Theta.GC.toSpace (local.get $slot))
+
+    ;; What survived stays, so the next collection is due once the collection ratio of the space left after it is used
+    (global.set $Theta.GC.collectionThreshold (call $Theta.GC.thresholdFrom (global.get $Theta.GC.heapPointer)))
+    (global.set $Theta.GC.isCollectionRequested (i32.const 0))
+    (global.set $Theta.GC.epoch (i32.add (global.get $Theta.GC.epoch) (i32.const 1)))
+
+    (if
+      (i32.gt_u
+        (i32.sub (global.get $Theta.GC.heapPointer) (global.get $Theta.GC.fromSpace))
+        (i32.mul
+          (i32.div_u (global.get $Theta.GC.semispaceSize) (i32.const 100))
+          (global.get $Theta.GC.collectionRatio)
+        )
+      )
+      (then (global.set $Theta.GC.isGrowthRequested (i32.const 1)))
+    )
+
+    (i64.store
+      (global.get $Theta.GC.STATS_BYTES_COPIED)
+      (i64.add
+        (i64.load (global.get $Theta.GC.STATS_BYTES_COPIED))
+        (i64.extend_i32_u (i32.sub (global.get $Theta.GC.heapPointer) (global.get $Theta.GC.fromSpace)))
+      )
+    )
+    (i32.store
+      (global.get $Theta.GC.STATS_COLLECTIONS)
+      (i32.add (i32.load (global.get $Theta.GC.STATS_COLLECTIONS)) (i32.const 1))
+    )
+    (i64.store
+      (global.get $Theta.GC.STATS_PAUSE_NANOSECONDS)
+      (i64.add
+        (i64.load (global.get $Theta.GC.STATS_PAUSE_NANOSECONDS))
+        (i64.sub (call $Theta.GC.now) (local.get $start))
+      )
+    )
+  )
+
+  ;; Stores a string in the next free index of the string table, doubling the table if it is full, and returns the
+  ;; index
+  (func $Theta.Strings.store (param $string stringref) (result i32) (local $index i32)
+    (local.set $index (global.get $Theta.Strings.nextIndex))
+
+    (if (i32.ge_u (local.get $index) (table.size $ThetaStringRefs))
+      (then (drop (table.grow $ThetaStringRefs (local.get $string) (table.size $ThetaStringRefs))))
+    )
+
+    (table.set $ThetaStringRefs (local.get $index) (local.get $string))
+    (global.set $Theta.Strings.nextIndex (i32.add (local.get $index) (i32.const 1)))
+
+    (local.get $index)
+  )
+
+  ;; Moves the string held by a cell that survived a collection past the indices in use, where it waits for
+  ;; Theta.Strings.compact, and points the cell at the index it ends up at. Surviving strings end up in the order their
+  ;; cells were copied in, from index 1
+  (func $Theta.Strings.relocate (param $cell i32) (local $string stringref) (local $staged i32)
+    (local.set $string (table.get $ThetaStringRefs (i32.load (local.get $cell))))
+    (local.set $staged (i32.add (global.get $Theta.Strings.nextIndex) (global.get $Theta.Strings.liveCount)))
+
+    (if (i32.ge_u (local.get $staged) (table.size $ThetaStringRefs))
+      (then (drop (table.grow $ThetaStringRefs (local.get $string) (table.size $ThetaStringRefs))))
+    )
+
+    (table.set $ThetaStringRefs (local.get $staged) (local.get $string))
+    (global.set $Theta.Strings.liveCount (i32.add (global.get $Theta.Strings.liveCount) (i32.const 1)))
+    (i32.store (local.get $cell) (global.get $Theta.Strings.liveCount))
+  )
+
+  ;; Moves the strings that survived a collection down to the start of the table, and clears every index after them, so
+  ;; the table doesn't keep strings that are no longer used alive
+  (func $Theta.Strings.compact
+    (table.copy $ThetaStringRefs $ThetaStringRefs
+      (i32.const 1)
+      (global.get $Theta.Strings.nextIndex)
+      (global.get $Theta.Strings.liveCount)
+    )
+    (table.fill $ThetaStringRefs
+      (i32.add (global.get $Theta.Strings.liveCount) (i32.const 1))
+      (string.const "")
+      (i32.sub (global.get $Theta.Strings.nextIndex) (i32.const 1))
+    )
+
+    (global.set $Theta.Strings.nextIndex (i32.add (global.get $Theta.Strings.liveCount) (i32.const 1)))
+    (global.set $Theta.Strings.liveCount (i32.const 0))
+  )
+
+  ;; Adds up a list of Numbers, two at a time. A list is its length, then its elements from offset 8, which the
+  ;; allocator keeps 8 byte aligned, so each pair is a single aligned v128 load
+  (func $Theta.List.sum (param $list i32) (result i64) (local $length i32) (local $index i32) (local $sums v128)
+    (local.set $length (i32.load (local.get $list)))
+    (local.set $sums (v128.const i64x2 0 0))
+
+    (block $done
+      (loop $pairs
+        (br_if $done (i32.ge_u (i32.add (local.get $index) (i32.const 1)) (local.get $length)))
+
+        (local.set $sums
+          (i64x2.add
+            (local.get $sums)
+            (v128.load offset=8 (i32.add (local.get $list) (i32.shl (local.get $index) (i32.const 3))))
+          )
+        )
+        (local.set $index (i32.add (local.get $index) (i32.const 2)))
+        (br $pairs)
+      )
+    )
+
+    ;; A list of odd length has one element left over
+    (if (i32.lt_u (local.get $index) (local.get $length))
+      (then
+        (local.set $sums
+          (i64x2.replace_lane 0
+            (local.get $sums)
+            (i64.add
+              (i64x2.extract_lane 0 (local.get $sums))
+              (i64.load offset=8 (i32.add (local.get $list) (i32.shl (local.get $index) (i32.const 3))))
+            )
+          )
+        )
+      )
+    )
+
+    (i64.add (i64x2.extract_lane 0 (local.get $sums)) (i64x2.extract_lane 1 (local.get $sums)))
+  )
+
+  ;; Dictionaries are open addressing hash tables with Robin Hood insertion, laid out as described in
+  ;; src/compiler/DictionaryLayout.hpp: their capacity and count, then 16 byte entries of key, distance from the slot
+  ;; the key hashes to, and value. Keys are never 0, which marks an empty slot. Dictionaries with constant keys are
+  ;; laid out at compile time with the same hash, so these functions read them like any other
+  (func $Theta.Dict.hash (param $key i32) (result i32) (local $hashed i32)
+    (local.set $hashed (i32.mul (local.get $key) (i32.const 0x9E3779B1)))
+    (i32.xor (local.get $hashed) (i32.shr_u (local.get $hashed) (i32.const 16)))
+  )
+
+  ;; Returns the address of the entry holding a key, or 0 if there is none. Entries are ordered by their distance from
+  ;; home, so the probe stops at the first one closer to its own than the key would be
+  (func $Theta.Dict.find (param $dict i32) (param $key i32) (result i32)
+    (local $mask i32) (local $index i32) (local $distance i32) (local $entry i32) (local $stored i32)
+    (local.set $mask (i32.sub (i32.load (local.get $dict)) (i32.const 1)))
+    (local.set $index (i32.and (call $Theta.Dict.hash (local.get $key)) (local.get $mask)))
+
+    (loop $probe
+      (local.set $entry (i32.add (local.get $dict) (i32.add (i32.const 8) (i32.shl (local.get $index) (i32.const 4)))))
+      (local.set $stored (i32.load (local.get $entry)))
+
+      (if (i32.eq (local.get $stored) (local.get $key))
+        (then (return (local.get $entry)))
+      )
+
+      (if (i32.or
+            (i32.eqz (local.get $stored))
+            (i32.lt_u (i32.load offset=4 (local.get $entry)) (local.get $distance))
+          )
+        (then (return (i32.const 0)))
+      )
+
+      (local.set $index (i32.and (i32.add (local.get $index) (i32.const 1)) (local.get $mask)))
+      (local.set $distance (i32.add (local.get $distance) (i32.const 1)))
+      (br $probe)
+    )
+
+    (unreachable)
+  )
+
+  ;; Returns the address of the entry holding a key, trapping if there is none
+  (func $Theta.Dict.get (param $dict i32) (param $key i32) (result i32) (local $entry i32)
+    (local.set $entry (call $Theta.Dict.find (local.get $dict) (local.get $key)))
+
+    (if (i32.eqz (local.get $entry))
+      (then (unreachable))
+    )
+
+    (local.get $entry)
+  )
+
+  ;; Sets the value of a key, adding it if the dictionary doesn't have it yet. The dictionary must have room for it,
+  ;; which the compiler makes sure of by sizing it for every key of its literal
+  (func $Theta.Dict.insert (param $dict i32) (param $key i32) (param $value i64)
+    (local $mask i32) (local $index i32) (local $distance i32) (local $entry i32) (local $stored i32)
+    (local $storedDistance i32) (local $storedValue i64)
+    (local.set $mask (i32.sub (i32.load (local.get $dict)) (i32.const 1)))
+    (local.set $index (i32.and (call $Theta.Dict.hash (local.get $key)) (local.get $mask)))
+
+    (loop $probe
+      (local.set $entry (i32.add (local.get $dict) (i32.add (i32.const 8) (i32.shl (local.get $index) (i32.const 4)))))
+      (local.set $stored (i32.load (local.get $entry)))
+
+      (if (i32.eqz (local.get $stored))
+        (then
+          (i32.store (local.get $entry) (local.get $key))
+          (i32.store offset=4 (local.get $entry) (local.get $distance))
+          (i64.store offset=8 (local.get $entry) (local.get $value))
+          (i32.store offset=4 (local.get $dict) (i32.add (i32.load offset=4 (local.get $dict)) (i32.const 1)))
+          (return)
+        )
+      )
+
+      (if (i32.eq (local.get $stored) (local.get $key))
+        (then
+          (i64.store offset=8 (local.get $entry) (local.get $value))
+          (return)
+        )
+      )
+
+      ;; An entry closer to its own slot than the one being placed gives its slot up, and carries on looking for another
+      (local.set $storedDistance (i32.load offset=4 (local.get $entry)))
+      (if (i32.lt_u (local.get $storedDistance) (local.get $distance))
+        (then
+          (local.set $storedValue (i64.load offset=8 (local.get $entry)))
+          (i32.store (local.get $entry) (local.get $key))
+          (i32.store offset=4 (local.get $entry) (local.get $distance))
+          (i64.store offset=8 (local.get $entry) (local.get $value))
+          (local.set $key (local.get $stored))
+          (local.set $distance (local.get $storedDistance))
+          (local.set $value (local.get $storedValue))
+        )
+      )
+
+      (local.set $index (i32.and (i32.add (local.get $index) (i32.const 1)) (local.get $mask)))
+      (local.set $distance (i32.add (local.get $distance) (i32.const 1)))
+      (br $probe)
+    )
+  )
+
+  ;; A memoized function keeps its results in a table of its own, laid out by the compiler between the shadow stack
+  ;; and the heap, where the collector never looks, since the tables only hold numbers, booleans and symbols. A table
+  ;; starts with the arguments being looked up or stored, an i64 each, which the function writes there before calling
+  ;; these, and then its entries. Each entry is a word of flags, the arguments it was stored for and the result
+  (func $Theta.Memo.entrySize (param $arity i32) (result i32)
+    (i32.add (i32.const 16) (i32.shl (local.get $arity) (i32.const 3)))
+  )
+
+  ;; Returns the address of the first entry of the set the arguments hash to. They're hashed a word at a time, the same
+  ;; way dictionary keys are. The capacity is a power of two, and a multiple of the number of ways
+  (func $Theta.Memo.findSet (param $table i32) (param $arity i32) (param $capacity i32) (result i32)
+    (local $hash i32) (local $i i32) (local $argument i64)
+    (block $hashed
+      (loop $arguments
+        (br_if $hashed (i32.ge_u (local.get $i) (local.get $arity)))
+        (local.set $argument (i64.load (i32.add (local.get $table) (i32.shl (local.get $i) (i32.const 3)))))
+        (local.set $hash
+          (call $Theta.Dict.hash
+            (i32.xor
+              (i32.xor (local.get $hash) (i32.wrap_i64 (local.get $argument)))
+              (i32.rotl (i32.wrap_i64 (i64.shr_u (local.get $argument) (i64.const 32))) (i32.const 16))
+            )
+          )
+        )
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $arguments)
+      )
+    )
+    (i32.add
+      (i32.add (local.get $table) (i32.shl (local.get $arity) (i32.const 3)))
+      (i32.mul
+        (i32.and (local.get $hash) (i32.sub (local.get $capacity) (global.get $Theta.Memo.WAYS)))
+        (call $Theta.Memo.entrySize (local.get $arity))
+      )
+    )
+  )
+
+  ;; Whether an entry was stored for the arguments being looked up
+  (func $Theta.Memo.isMatch (param $table i32) (param $entry i32) (param $arity i32) (result i32) (local $i i32)
+    (block $matched
+      (loop $arguments
+        (br_if $matched (i32.ge_u (local.get $i) (local.get $arity)))
+        (if
+          (i64.ne
+            (i64.load (i32.add (local.get $table) (i32.shl (local.get $i) (i32.const 3))))
+            (i64.load offset=8 (i32.add (local.get $entry) (i32.shl (local.get $i) (i32.const 3))))
+          )
+          (then (return (i32.const 0)))
+        )
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $arguments)
+      )
+    )
+    (i32.const 1)
+  )
+
+  ;; Returns the address of the result stored for the arguments at the start of a table, or 0 if there isn't one
+  (func $Theta.Memo.find (param $table i32) (param $arity i32) (param $capacity i32) (result i32)
+    (local $entrySize i32) (local $entry i32) (local $end i32)
+    (local.set $entrySize (call $Theta.Memo.entrySize (local.get $arity)))
+    (local.set $entry (call $Theta.Memo.findSet (local.get $table) (local.get $arity) (local.get $capacity)))
+    (local.set $end (i32.add (local.get $entry) (i32.mul (local.get $entrySize) (global.get $Theta.Memo.WAYS))))
+
+    (block $missed
+      (loop $probe
+        (br_if $missed (i32.ge_u (local.get $entry) (local.get $end)))
+        (if
+          (i32.and
+            (i32.load (local.get $entry))
+            (call $Theta.Memo.isMatch (local.get $table) (local.get $entry) (local.get $arity))
+          )
+          (then
+            (i32.store (local.get $entry) (i32.or (global.get $Theta.Memo.OCCUPIED) (global.get $Theta.Memo.REFERENCED)))
+            (i64.store
+              (global.get $Theta.Memo.STATS_HITS)
+              (i64.add (i64.load (global.get $Theta.Memo.STATS_HITS)) (i64.const 1))
+            )
+            (return (i32.sub (i32.add (local.get $entry) (local.get $entrySize)) (i32.const 8)))
+          )
+        )
+        (local.set $entry (i32.add (local.get $entry) (local.get $entrySize)))
+        (br $probe)
+      )
+    )
+
+    (i64.store
+      (global.get $Theta.Memo.STATS_MISSES)
+      (i64.add (i64.load (global.get $Theta.Memo.STATS_MISSES)) (i64.const 1))
+    )
+    (i32.const 0)
+  )
+
+  ;; Stores the result for the arguments at the start of a table. It takes the first entry of their set that is empty
+  ;; or wasn't found since it was stored, giving the ones that were found before it a second chance by clearing their
+  ;; referenced flag, like the hand of a clock. If every entry of the set was found, the first one is taken
+  (func $Theta.Memo.store (param $table i32) (param $arity i32) (param $capacity i32) (param $value i64)
+    (local $entrySize i32) (local $set i32) (local $entry i32) (local $end i32) (local $victim i32) (local $i i32)
+    (local.set $entrySize (call $Theta.Memo.entrySize (local.get $arity)))
+    (local.set $set (call $Theta.Memo.findSet (local.get $table) (local.get $arity) (local.get $capacity)))
+    (local.set $end (i32.add (local.get $set) (i32.mul (local.get $entrySize) (global.get $Theta.Memo.WAYS))))
+    (local.set $entry (local.get $set))
+    (local.set $victim (local.get $set))
+
+    (block $found
+      (loop $sweep
+        (br_if $found (i32.ge_u (local.get $entry) (local.get $end)))
+        (if
+          (i32.ne
+            (i32.load (local.get $entry))
+            (i32.or (global.get $Theta.Memo.OCCUPIED) (global.get $Theta.Memo.REFERENCED))
+          )
+          (then
+            (local.set $victim (local.get $entry))
+            (br $found)
+          )
+        )
+        (i32.store (local.get $entry) (global.get $Theta.Memo.OCCUPIED))
+        (local.set $entry (i32.add (local.get $entry) (local.get $entrySize)))
+        (br $sweep)
+      )
+    )
+
+    (i32.store (local.get $victim) (global.get $Theta.Memo.OCCUPIED))
+    (block $copied
+      (loop $arguments
+        (br_if $copied (i32.ge_u (local.get $i) (local.get $arity)))
+        (i64.store offset=8
+          (i32.add (local.get $victim) (i32.shl (local.get $i) (i32.const 3)))
+          (i64.load (i32.add (local.get $table) (i32.shl (local.get $i) (i32.const 3))))
+        )
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $arguments)
+      )
+    )
+    (i64.store (i32.sub (i32.add (local.get $victim) (local.get $entrySize)) (i32.const 8)) (local.get $value))
+  )
+
   (func $Theta.Function.populateClosure (param $closure_mem_addr i32) (param $param_addr i32) (local $arity i32)
     (local.set $arity ;; Load the closure arity
       (i32.load 
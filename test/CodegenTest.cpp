@@ -5,13 +5,27 @@
 #include "../src/compiler/Compiler.hpp"
 #include "../src/compiler/TypeChecker.hpp"
 #include "../src/compiler/CodeGen.hpp"
+#include "../src/compiler/ReplSession.hpp"
+#include "cli/CompileServer.hpp"
+#include "runtime/CapsuleLoader.hpp"
+#include "runtime/Executor.hpp"
 #include "runtime/Runtime.hpp"
 #include "binaryen-c.h"
 #include "wasm.hh"
 #include <v8.h>
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <regex>
 #include <string>
 #include <vector>
 
+#ifdef THETA_COMPILE_SERVER_SOCKETS
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 using namespace Theta;
 
@@ -49,6 +63,8 @@ public:
 
         if (!isTypeValid) FAIL("Typechecking failed");
 
+        Compiler::getInstance().optimizeCheckedAST(parsedAST);
+
         BinaryenModuleRef module = codeGen.generateWasmFromAST(parsedAST);
 
         vector<char> buffer = Compiler::writeModuleToBuffer(module);
@@ -138,6 +154,256 @@ TEST_CASE_METHOD(CodeGenTest, "CodeGen") {
     //    REQUIRE(result_string == "Hello, world!");
     //}
 
+    SECTION("Can codegen chains of string concatenation") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Boolean>> = () -> {
+                    name<String> = 'world'
+
+                    'Hello' + ', ' + name + '!' + ' Hello' + ', ' + name + '!' == 'Hello, world! Hello, world!'
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I32);
+        REQUIRE(context.result.i32() == 1);
+    }
+
+    SECTION("Can sum lists of Numbers of odd length") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    numbers<List<Number>> = [1, 2, 3, 4, 5, 6, 7]
+
+                    sum(numbers) * 10 + length(numbers)
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 287);
+    }
+
+    SECTION("Can map, filter and reduce lists with capsule functions") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    numbers<List<Number>> = [1, 2, 3, 4, 5, 6, 7]
+
+                    reduce(filter(map(numbers, double), isLarge), add, 0)
+                }
+
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+                isLarge<Function<Number, Boolean>> = (x<Number>) -> x > 6
+                add<Function<Number, Number, Number>> = (total<Number>, x<Number>) -> total + x
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 44);
+    }
+
+    SECTION("Can look up keys of dictionaries with constant keys") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    config<Dict<Number>> = { port: 8080, retries: 3, timeout: double(15), retries: 4 }
+
+                    if (has(config, :verbose)) {
+                        0
+                    } else {
+                        get(config, :port) + get(config, :retries) + get(config, :timeout)
+                    }
+                }
+
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 8114);
+    }
+
+    SECTION("Can read the fields of structs, whether they are in memory or replaced by locals") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                struct Point {
+                    visible<Boolean>
+                    x<Number>
+                    y<Number>
+                }
+
+                main<Function<Number>> = () -> {
+                    origin<Point> = @Point { visible: true, x: 3, y: 4 }
+                    local<Point> = @Point { visible: false, x: 1, y: 2 }
+                    far<Point> = offset(origin, 10)
+
+                    if (get(far, :visible)) {
+                        get(far, :x) + get(far, :y) + get(local, :y) * 100
+                    } else {
+                        0
+                    }
+                }
+
+                offset<Function<Point, Number, Point>> = (p<Point>, by<Number>) -> {
+                    @Point { visible: get(p, :visible), x: get(p, :x) + by, y: get(p, :y) + by }
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 227);
+    }
+
+    SECTION("Can return tuples from functions and read their values") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                divide<Function<Number, Number, Tuple<Number, Boolean>>> = (a<Number>, b<Number>) -> {
+                    if (b == 0) {
+                        { 0, false }
+                    } else {
+                        { a / b, true }
+                    }
+                }
+
+                main<Function<Number>> = () -> {
+                    result<Tuple<Number, Boolean>> = divide(84, 2)
+                    failed<Tuple<Number, Boolean>> = divide(1, 0)
+
+                    if (second(failed)) {
+                        0
+                    } else {
+                        if (second(result)) {
+                            first(result)
+                        } else {
+                            0
+                        }
+                    }
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 42);
+    }
+
+    SECTION("Can run functions that return tuples") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Tuple<Number, Boolean>>> = () -> {
+                    { 42, true }
+                }
+            }
+        )");
+
+        REQUIRE(context.results.size() == 2);
+        REQUIRE(context.results[0].i64() == 42);
+        REQUIRE(context.results[1].i32() == 1);
+        REQUIRE(context.result.i64() == 42);
+        REQUIRE(context.stringifiedResult() == "{ 42, true }");
+    }
+
+    SECTION("Can match values against many constants with jump tables") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                dense<Function<Number, Number>> = (n<Number>) -> {
+                    if (n == 0) {
+                        10
+                    } else if (n == 1) {
+                        20
+                    } else if (n == 2) {
+                        30
+                    } else if (3 == n) {
+                        40
+                    } else if (n == 5) {
+                        60
+                    } else {
+                        0
+                    }
+                }
+
+                sparse<Function<Number, Number>> = (n<Number>) -> {
+                    if (n == 1) {
+                        1
+                    } else if (n == 100) {
+                        2
+                    } else if (n == 1000) {
+                        3
+                    } else if (n == 10000) {
+                        4
+                    } else if (n == 100000) {
+                        5
+                    } else {
+                        0
+                    }
+                }
+
+                code<Function<Symbol, Number>> = (s<Symbol>) -> {
+                    if (s == :a) {
+                        1
+                    } else if (s == :b) {
+                        2
+                    } else if (s == :c) {
+                        3
+                    } else if (s == :d) {
+                        4
+                    } else {
+                        0
+                    }
+                }
+
+                main<Function<Number>> = () -> {
+                    dense(3) + dense(5) + dense(4) + dense(-1) + sparse(10000) * 1000 + sparse(100000) * 10000 + sparse(7) + code(:c)
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 54103);
+    }
+
+    SECTION("Can search, slice and measure strings with the string intrinsics") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    text<String> = 'hello, world'
+
+                    if (slice(text, 7, 12) == 'world') {
+                        if (charAt(text, 4) == 'o') {
+                            length(text) * 1000000 + indexOf(text, 'world') * 10000 + charCodeAt(text, 1) + indexOf(text, 'xyz') * 100
+                        } else {
+                            0
+                        }
+                    } else {
+                        0
+                    }
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 12070001);
+    }
+
+    SECTION("Can read code points and hash strings") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    emoji<String> = 'a😀b'
+
+                    if (hash('abc') == hash(slice('xabcx', 1, 4))) {
+                        codePointAt(emoji, 1) + codePointAt(emoji, 3) * 1000000 + length(emoji) * 1000000000
+                    } else {
+                        0
+                    }
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 4098128512);
+    }
+
     SECTION("Correctly codegens negative numbers") {
         ExecutionContext context = setup(R"(
             capsule Test {
@@ -274,6 +540,184 @@ TEST_CASE_METHOD(CodeGenTest, "CodeGen") {
         REQUIRE(context.result.i64() == 10);
     }
 
+    SECTION("Can raise numbers to any power") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> power(3, 13) + power(2, 0) + power(-2, 3) + power(5, -1) + power(-1, -3)
+
+                power<Function<Number, Number, Number>> = (base<Number>, exponent<Number>) -> {
+                    result<Number> = base ** exponent
+
+                    result
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 1594323 + 1 - 8 + 0 - 1);
+    }
+
+    SECTION("Small constant powers become multiplications") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> cube(3)
+
+                cube<Function<Number, Number>> = (x<Number>) -> {
+                    y<Number> = x + 1
+
+                    y ** 3 + y ** 0
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 65);
+    }
+
+    SECTION("Functions that call themselves in tail position run in constant stack") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> sumTo(100000, 0)
+
+                sumTo<Function<Number, Number, Number>> = (n<Number>, total<Number>) -> {
+                    if (n == 0) {
+                        return total
+                    }
+
+                    sumTo(n - 1, total + n)
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 5000050000);
+    }
+
+    SECTION("Mutually recursive functions make tail calls") {
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> ping(100001)
+
+                ping<Function<Number, Number>> = (n<Number>) -> if (n == 0) { 0 } else { pong(n - 1) }
+
+                pong<Function<Number, Number>> = (n<Number>) -> if (n == 0) { 1 } else { ping(n - 1) }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 1);
+    }
+
+    SECTION("Fully applied calls to capsule functions are direct, and only partial application builds a closure") {
+        auto generateText = [this](string mainBody, string definitions = "") {
+            string source = R"(
+                capsule Test {
+                    main<Function<Number>> = () -> )" + mainBody + R"(
+                    )" + definitions + R"(
+                    combine<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> {
+                        if (x == 0) {
+                            return y
+                        }
+
+                        x + y
+                    }
+                }
+            )";
+
+            Compiler::getInstance().clearExceptions();
+            lexer.lex(source);
+
+            shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+            Compiler::getInstance().optimizeAST(parsedAST, true);
+            REQUIRE(typeChecker.checkAST(parsedAST));
+            Compiler::getInstance().optimizeCheckedAST(parsedAST);
+
+            CodeGen moduleCodeGen;
+            BinaryenModuleRef module = moduleCodeGen.generateWasmFromAST(parsedAST);
+            char *text = BinaryenModuleAllocateAndWriteText(module);
+            string moduleText(text);
+            free(text);
+            BinaryenModuleDispose(module);
+
+            return moduleText;
+        };
+
+        // combine and applyPartially have bodies of more than one expression, so they are never inlined into main
+        auto calls = [](const string &moduleText, const string &instruction, const string &function) {
+            return regex_search(moduleText, regex("\\(" + instruction + " \\$[^\\s()]*" + function));
+        };
+
+        string fullyApplied = generateText("combine(1, 2) + 1");
+        REQUIRE(calls(fullyApplied, "call", "combine"));
+        REQUIRE_FALSE(calls(fullyApplied, "return_call", "combine"));
+        REQUIRE(fullyApplied.find("call_indirect") == string::npos);
+
+        string tailCall = generateText("combine(1, 2)");
+        REQUIRE(calls(tailCall, "return_call", "combine"));
+        REQUIRE_FALSE(calls(tailCall, "call", "combine"));
+        REQUIRE(tailCall.find("call_indirect") == string::npos);
+
+        // addTo is applied to a parameter, so its closure is built at runtime and called through the table
+        string partialDefinitions = R"(
+                    applyPartially<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> {
+                        addX<Function<Number, Number>> = addTo(x)
+
+                        addX(y)
+                    }
+
+                    addTo<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x + y
+        )";
+
+        string partiallyApplied = generateText("applyPartially(1, 2)", partialDefinitions);
+        REQUIRE(calls(partiallyApplied, "call", "addTo"));
+        REQUIRE(partiallyApplied.find("call_indirect") != string::npos);
+
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> applyPartially(1, 2) + combine(0, 5) + combine(1, 2)
+
+                applyPartially<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> {
+                    addX<Function<Number, Number>> = addTo(x)
+
+                    addX(y)
+                }
+
+                addTo<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x + y
+
+                combine<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> {
+                    if (x == 0) {
+                        return y
+                    }
+
+                    x + y
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 11);
+    }
+
+    SECTION("Only the requested exports and what they use end up in the module") {
+        Compiler::getInstance().setExports({ "main" });
+
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> double(5)
+
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+
+                triple<Function<Number, Number>> = (x<Number>) -> x * 3
+            }
+        )");
+
+        Compiler::getInstance().setExports({});
+
+        REQUIRE(context.exportNames.size() == 2);
+        REQUIRE(find(context.exportNames.begin(), context.exportNames.end(), "main0") != context.exportNames.end());
+        REQUIRE(context.result.i64() == 10);
+    }
+
 // TODO: Fix this test case. This is failing because of the unary comparison
 // to i64.eqz that the !isOdd is doing. 
 //
@@ -331,40 +775,1080 @@ TEST_CASE_METHOD(CodeGenTest, "CodeGen") {
         REQUIRE(context.result.i64() == 1005);
     }
 
-    SECTION("Correctly return value if an assignment is the last expression in a block") {
+    SECTION("Can pipe values through the same closure more than once") {
          ExecutionContext context = setup(R"(
             capsule Test {
-                main<Function<Boolean>> = () -> {
-                    x<Boolean> = false
+                main<Function<Number>> = () -> scaleTwice(3)
+
+                scaleTwice<Function<Number, Number>> = (n<Number>) -> {
+                    times<Function<Number, Number>> = scale(n)
+
+                    n => times() => times()
                 }
+
+                scale<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x * y
             }
         )");
 
-        REQUIRE(context.exportNames.size() == 2);
-        REQUIRE(context.result.kind() == wasm::I32);
-        REQUIRE(context.result.i32() == 0);
+        REQUIRE(context.exportNames.size() == 4);
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 27);
     }
 
-    SECTION("Can call recursive functions correctly") {
-         ExecutionContext context = setup(R"(
-            capsule Test {
-                main<Function<Number>> = () -> {
-                    fibonacci(10)
-                }
+    SECTION("Calls that leave a closure short of arguments are rejected rather than compiled") {
+        auto compileWithCall = [](string call) {
+            Compiler::getInstance().clearExceptions();
 
-                fibonacci<Function<Number, Number>> = (n<Number>) -> {
-                    if (n <= 1) {
-                        return n
+            return Compiler::getInstance().compileDirect(R"(
+                capsule Test {
+                    main<Function<Number>> = () -> applyOnce(3)
+
+                    applyOnce<Function<Number, Number>> = (n<Number>) -> {
+                        combineWith<Function<Number, Number, Number>> = weigh(n)
+
+                        )" + call + R"(
                     }
 
-                    fibonacci(n - 1) + fibonacci(n - 2)
+                    weigh<Function<Number, Function<Number, Number, Number>>> = (x<Number>) -> (y<Number>, z<Number>) -> x * y + z
                 }
-            }
+            )");
+        };
+
+        REQUIRE(compileWithCall("combineWith(2)").empty());
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+
+        REQUIRE(compileWithCall("n => combineWith()").empty());
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+
+        vector<char> saturated = compileWithCall("n => combineWith(1)");
+        REQUIRE(saturated.size() > 0);
+        REQUIRE(Runtime::getInstance().execute(saturated, "main0").result.i64() == 10);
+    }
+
+    SECTION("Lambdas that only differ in their names share one function") {
+         ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> scaleBoth(5)
+
+                scaleBoth<Function<Number, Number>> = (n<Number>) -> {
+                    m<Number> = n + 1
+
+                    scaleByN<Function<Number, Number>> = (x<Number>) -> x * n
+                    scaleByM<Function<Number, Number>> = (y<Number>) -> y * m
+
+                    scaleByN(2) + scaleByM(3)
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 28);
+
+        auto countFunctions = [this](string secondLambda) {
+            string source = R"(
+                capsule Test {
+                    scaleBoth<Function<Number, Number>> = (n<Number>) -> {
+                        m<Number> = n + 1
+
+                        scaleByN<Function<Number, Number>> = (x<Number>) -> x * n
+                        scaleByM<Function<Number, Number>> = )" + secondLambda + R"(
+
+                        scaleByN(2) + scaleByM(3)
+                    }
+                }
+            )";
+
+            Compiler::getInstance().clearExceptions();
+            lexer.lex(source);
+
+            shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+            Compiler::getInstance().optimizeAST(parsedAST, true);
+            REQUIRE(typeChecker.checkAST(parsedAST));
+
+            CodeGen moduleCodeGen;
+            BinaryenModuleRef module = moduleCodeGen.generateWasmFromAST(parsedAST);
+            int functions = BinaryenGetNumFunctions(module);
+            BinaryenModuleDispose(module);
+
+            return functions;
+        };
+
+        REQUIRE(countFunctions("(y<Number>) -> y * m") == countFunctions("(y<Number>) -> y + m") - 1);
+    }
+
+    SECTION("Library functions a program never calls are left out of its module") {
+        auto hasFunction = [this](string body, string functionName) {
+            string source = R"(
+                capsule Test {
+                    main<Function<Number>> = () -> {
+                        text<String> = 'haystack needle'
+                        )" + body + R"(
+                    }
+                }
+            )";
+
+            Compiler::getInstance().clearExceptions();
+            lexer.lex(source);
+
+            shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+            Compiler::getInstance().optimizeAST(parsedAST, true);
+            REQUIRE(typeChecker.checkAST(parsedAST));
+
+            CodeGen moduleCodeGen;
+            BinaryenModuleRef module = moduleCodeGen.generateWasmFromAST(parsedAST);
+            bool isPresent = BinaryenGetFunction(module, functionName.c_str()) != nullptr;
+            BinaryenModuleDispose(module);
+
+            return isPresent;
+        };
+
+        REQUIRE(hasFunction("indexOf(text, 'needle')", "Theta.String.indexOf"));
+        REQUIRE_FALSE(hasFunction("length(text)", "Theta.String.indexOf"));
+        REQUIRE_FALSE(hasFunction("length(text)", "Theta.Math.pow"));
+    }
+
+    SECTION("Recursive calls get closures of their own") {
+         ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> sumClosures(100)
+
+                sumClosures<Function<Number, Number>> = (n<Number>) -> {
+                    if (n == 0) {
+                        return 0
+                    }
+
+                    addN<Function<Number, Number>> = add(n)
+                    rest<Number> = sumClosures(n - 1)
+
+                    addN(rest)
+                }
+
+                add<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x + y
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 5050);
+    }
+
+    SECTION("Closures that are no longer reachable are collected") {
+         ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> sumClosures(50000, 0)
+
+                sumClosures<Function<Number, Number, Number>> = (n<Number>, total<Number>) -> {
+                    if (n == 0) {
+                        return total
+                    }
+
+                    addN<Function<Number, Number>> = add(n)
+
+                    sumClosures(n - 1, addN(total))
+                }
+
+                add<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x + y
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 1250025000);
+    }
+
+    SECTION("Closures and lists that are live in a caller's frame survive being moved by the collector") {
+        HeapOptions heapOptions;
+        heapOptions.initialPages = HeapOptions::MIN_PAGES;
+        Compiler::getInstance().setHeapOptions(heapOptions);
+
+        // churn fills the smallest heap's semispace many times over while holdAcrossCollections still holds addBase and digits
+        ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> holdAcrossCollections(10)
+
+                holdAcrossCollections<Function<Number, Number>> = (base<Number>) -> {
+                    addBase<Function<Number, Number>> = add(base)
+                    digits<List<Number>> = [5, 6, 7, 8]
+                    churned<Number> = churn(20000, 0)
+
+                    addBase(reduce(digits, appendDigit, 0)) * 1000000000 + length(digits) * 100000000 + churned
+                }
+
+                churn<Function<Number, Number, Number>> = (n<Number>, total<Number>) -> {
+                    if (n == 0) {
+                        return total
+                    }
+
+                    addN<Function<Number, Number>> = add(n)
+
+                    churn(n - 1, addN(total))
+                }
+
+                add<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x + y
+                appendDigit<Function<Number, Number, Number>> = (total<Number>, digit<Number>) -> total * 10 + digit
+            }
+        )");
+
+        Compiler::getInstance().setHeapOptions(HeapOptions());
+
+        REQUIRE(context.gcStats.collections >= 3);
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 5688LL * 1000000000 + 4 * 100000000 + 200010000);
+    }
+
+    SECTION("The collector's counters start at zero and grow with what a program allocates") {
+        auto churn = [this](int count) {
+            return setup(R"(
+                capsule Test {
+                    main<Function<Number>> = () -> churn()" + to_string(count) + R"(, 0)
+
+                    churn<Function<Number, Number, Number>> = (n<Number>, total<Number>) -> {
+                        if (n == 0) {
+                            return total
+                        }
+
+                        pair<List<Number>> = [n, total]
+
+                        churn(n - 1, sum(pair))
+                    }
+                }
+            )").gcStats;
+        };
+
+        GCStats idle = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> 10 * 5
+            }
+        )").gcStats;
+
+        REQUIRE(idle.bytesAllocated == 0);
+        REQUIRE(idle.bytesCopied == 0);
+        REQUIRE(idle.collections == 0);
+
+        GCStats small = churn(100);
+        GCStats large = churn(50000);
+
+        REQUIRE(small.bytesAllocated > 0);
+        REQUIRE(small.collections == 0);
+        REQUIRE(large.bytesAllocated > small.bytesAllocated);
+        REQUIRE(large.collections > small.collections);
+        REQUIRE(large.bytesAllocated > large.bytesCopied);
+        REQUIRE(large.maxShadowStackDepth >= small.maxShadowStackDepth);
+        REQUIRE(large.memoryPages >= 9);
+    }
+
+    SECTION("Functions that allocate more than is left of the heap stop with an out of memory error") {
+        Compiler::getInstance().clearExceptions();
+
+        HeapOptions heapOptions;
+        heapOptions.initialPages = HeapOptions::MIN_PAGES;
+        Compiler::getInstance().setHeapOptions(heapOptions);
+
+        // A single list bigger than a semispace of the smallest heap, which can't be collected to make room for
+        string numbers;
+        for (int i = 0; i < 10000; i++) numbers += (i > 0 ? ", " : "") + to_string(i);
+
+        vector<char> wasm = Compiler::getInstance().compileDirect(
+            "capsule Test {\n    main<Function<List<Number>>> = () -> [" + numbers + "]\n}"
+        );
+
+        Compiler::getInstance().setHeapOptions(HeapOptions());
+        REQUIRE(wasm.size() > 0);
+
+        Runtime runtime;
+        REQUIRE_THROWS_AS(runtime.execute(wasm, "main0"), OutOfMemoryError);
+    }
+
+    SECTION("Memoized functions look their results up rather than recomputing them") {
+         ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> fib(80)
+
+                @memo fib<Function<Number, Number>> = (n<Number>) -> {
+                    if (2 > n) {
+                        return n
+                    }
+
+                    fib(n - 1) + fib(n - 2)
+                }
+            }
+        )");
+
+        REQUIRE(context.result.kind() == wasm::I64);
+        REQUIRE(context.result.i64() == 23416728348467685);
+        REQUIRE(context.gcStats.memoHits > 0);
+        REQUIRE(context.gcStats.memoMisses >= 81);
+    }
+
+    SECTION("Correctly return value if an assignment is the last expression in a block") {
+         ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Boolean>> = () -> {
+                    x<Boolean> = false
+                }
+            }
+        )");
+
+        REQUIRE(context.exportNames.size() == 2);
+        REQUIRE(context.result.kind() == wasm::I32);
+        REQUIRE(context.result.i32() == 0);
+    }
+
+    SECTION("Can call recursive functions correctly") {
+         ExecutionContext context = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    fibonacci(10)
+                }
+
+                fibonacci<Function<Number, Number>> = (n<Number>) -> {
+                    if (n <= 1) {
+                        return n
+                    }
+
+                    fibonacci(n - 1) + fibonacci(n - 2)
+                }
+            }
         )");
 
         REQUIRE(context.exportNames.size() == 3);
         REQUIRE(context.result.kind() == wasm::I64);
         REQUIRE(context.result.i64() == 55);
     }
-}
 
+    SECTION("Modules optimized by Binaryen compute the same results") {
+        REQUIRE(OptimizationLevel::fromFlag("-O3")->optimizeLevel == 3);
+        REQUIRE(OptimizationLevel::fromFlag("-Oz")->shrinkLevel == 2);
+        REQUIRE(OptimizationLevel::fromFlag("-O")->toString() == "-Os");
+        REQUIRE(!OptimizationLevel::fromFlag("-O9"));
+
+        string source = R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    fibonacci(10)
+                }
+
+                fibonacci<Function<Number, Number>> = (n<Number>) -> {
+                    if (n <= 1) {
+                        return n
+                    }
+
+                    fibonacci(n - 1) + fibonacci(n - 2)
+                }
+            }
+        )";
+
+        Compiler::getInstance().clearExceptions();
+        vector<char> unoptimized = Compiler::getInstance().compileDirect(source);
+        vector<char> optimized = Compiler::getInstance().compileDirect(source, *OptimizationLevel::fromFlag("-O3"));
+
+        REQUIRE(unoptimized.size() > 0);
+        REQUIRE(optimized.size() > 0);
+        REQUIRE(Runtime::getInstance().execute(unoptimized, "main0").result.i64() == 55);
+        REQUIRE(Runtime::getInstance().execute(optimized, "main0").result.i64() == 55);
+    }
+
+    SECTION("Running a module again reuses its compiled module with a fresh instance") {
+        string source = R"(
+            capsule Test {
+                main<Function<Number>> = () -> sumClosures(1000, 0)
+
+                sumClosures<Function<Number, Number, Number>> = (n<Number>, total<Number>) -> {
+                    if (n == 0) {
+                        return total
+                    }
+
+                    addN<Function<Number, Number>> = add(n)
+
+                    sumClosures(n - 1, addN(total))
+                }
+
+                add<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x + y
+            }
+        )";
+
+        Compiler::getInstance().clearExceptions();
+        vector<char> wasm = Compiler::getInstance().compileDirect(source);
+        REQUIRE(wasm.size() > 0);
+
+        Runtime runtime;
+        ExecutionContext first = runtime.execute(wasm, "main0");
+        ExecutionContext second = runtime.execute(wasm, "main0");
+
+        REQUIRE(first.result.i64() == 500500);
+        REQUIRE(second.result.i64() == 500500);
+        REQUIRE(second.exportNames == first.exportNames);
+        REQUIRE(second.gcStats.bytesAllocated == first.gcStats.bytesAllocated);
+        REQUIRE_THROWS(runtime.execute(wasm, "missing"));
+
+        // Handles run the same module without hashing its binary again, on any runtime
+        Runtime::ModuleHandle handle = runtime.precompile(wasm);
+        REQUIRE(runtime.execute(handle, "main0").result.i64() == 500500);
+
+        Runtime other;
+        REQUIRE(other.execute(Runtime::makeHandle(wasm), "main0").result.i64() == 500500);
+    }
+
+    SECTION("Pooled instances are reset to the state of a fresh instance between runs") {
+        string source = R"(
+            capsule Test {
+                main<Function<Number>> = () -> sumClosures(100, 0)
+
+                sumClosures<Function<Number, Number, Number>> = (n<Number>, total<Number>) -> {
+                    if (n == 0) {
+                        return total
+                    }
+
+                    addN<Function<Number, Number>> = add(n)
+
+                    sumClosures(n - 1, addN(total))
+                }
+
+                add<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x + y
+            }
+        )";
+
+        Compiler::getInstance().clearExceptions();
+        vector<char> wasm = Compiler::getInstance().compileDirect(source);
+        REQUIRE(wasm.size() > 0);
+
+        Runtime runtime;
+        ExecutionContext first = runtime.execute(wasm, "main0");
+        REQUIRE(first.result.i64() == 5050);
+
+        for (int i = 0; i < 5; i++) {
+            ExecutionContext next = runtime.execute(wasm, "main0");
+
+            REQUIRE(next.result.i64() == 5050);
+            REQUIRE(next.gcStats.bytesAllocated == first.gcStats.bytesAllocated);
+            REQUIRE(next.gcStats.collections == first.gcStats.collections);
+            REQUIRE(next.gcStats.maxShadowStackDepth == first.gcStats.maxShadowStackDepth);
+        }
+
+        REQUIRE(find(first.exportNames.begin(), first.exportNames.end(), "Theta.reset") == first.exportNames.end());
+    }
+
+    SECTION("Exported functions can be called with arguments, one call or many at a time") {
+        Compiler::getInstance().clearExceptions();
+        vector<char> wasm = Compiler::getInstance().compileDirect(R"(
+            capsule Test {
+                main<Function<Number>> = () -> add(1, 2)
+
+                add<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> x + y
+            }
+        )");
+        REQUIRE(wasm.size() > 0);
+
+        Runtime runtime;
+
+        wasm::Val args[] = { wasm::Val(int64_t(20)), wasm::Val(int64_t(22)) };
+        wasm::Val result[1];
+        runtime.invoke(wasm, "add2", args, 2, result, 1);
+
+        REQUIRE(result[0].i64() == 42);
+
+        vector<wasm::Val> batchArgs;
+        for (int64_t i = 0; i < 100; i++) {
+            batchArgs.push_back(wasm::Val(i));
+            batchArgs.push_back(wasm::Val(i * 10));
+        }
+
+        vector<wasm::Val> batchResults(100);
+        runtime.invokeBatch(wasm, "add2", 100, batchArgs.data(), batchArgs.size(), batchResults.data(), batchResults.size());
+
+        for (int64_t i = 0; i < 100; i++) {
+            REQUIRE(batchResults[i].i64() == i * 11);
+        }
+
+        REQUIRE_THROWS(runtime.invoke(wasm, "missing", args, 2, result, 1));
+
+        // Calls given the wrong number of args, or too little room for their results, are refused before they're made
+        REQUIRE_THROWS_AS(runtime.invoke(wasm, "add2", args, 1, result, 1), invalid_argument);
+        REQUIRE_THROWS_AS(runtime.invoke(wasm, "add2", args, 2, result, 0), invalid_argument);
+        REQUIRE_THROWS_AS(
+            runtime.invokeBatch(wasm, "add2", 101, batchArgs.data(), batchArgs.size(), batchResults.data(), batchResults.size()),
+            invalid_argument
+        );
+    }
+
+    SECTION("Executors spread runs and batched calls across their threads") {
+        Compiler::getInstance().clearExceptions();
+        vector<char> wasm = Compiler::getInstance().compileDirect(R"(
+            capsule Test {
+                main<Function<Number>> = () -> add(40, 2)
+
+                add<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> x + y
+            }
+        )");
+        REQUIRE(wasm.size() > 0);
+
+        Executor executor(4);
+        REQUIRE(executor.getThreadCount() == 4);
+
+        vector<future<ExecutionContext>> runs;
+        for (int i = 0; i < 16; i++) runs.push_back(executor.submit(wasm, "main0"));
+
+        for (future<ExecutionContext> &run : runs) {
+            REQUIRE(run.get().result.i64() == 42);
+        }
+
+        vector<wasm::Val> args;
+        for (int64_t i = 0; i < 1000; i++) {
+            args.push_back(wasm::Val(i));
+            args.push_back(wasm::Val(int64_t(1)));
+        }
+
+        vector<wasm::Val> results(1000);
+        executor.invokeBatch(wasm, "add2", 1000, args.data(), args.size(), results.data(), results.size());
+
+        for (int64_t i = 0; i < 1000; i++) {
+            REQUIRE(results[i].i64() == i + 1);
+        }
+
+        REQUIRE_THROWS(executor.submit(wasm, "missing").get());
+    }
+
+    SECTION("Programs can call functions the host provides, which read the lists they are passed in place") {
+        Compiler::getInstance().clearExceptions();
+        Compiler::getInstance().setHostFunctions({
+            { "weightedSum", { "List<Number>", "Number" }, "Number" },
+            { "isEven", { "Number" }, "Boolean" }
+        });
+
+        vector<char> wasm = Compiler::getInstance().compileDirect(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    numbers<List<Number>> = [1, 2, 3, 4, 5]
+
+                    if (isEven(weightedSum(numbers, 2))) {
+                        weightedSum(numbers, 2)
+                    } else {
+                        0
+                    }
+                }
+            }
+        )");
+
+        Compiler::getInstance().setHostFunctions({});
+        REQUIRE(wasm.size() > 0);
+
+        Runtime runtime;
+        runtime.setHostFunction("weightedSum", [](HostCall &call, const wasm::Val args[], wasm::Val results[]) {
+            int64_t total = 0;
+            for (int64_t number : call.getNumbers(args[0])) total += number * args[1].i64();
+
+            results[0] = wasm::Val(total);
+        });
+
+        runtime.setHostFunction("isEven", [](HostCall &call, const wasm::Val args[], wasm::Val results[]) {
+            results[0] = wasm::Val(int32_t(args[0].i64() % 2 == 0));
+        });
+
+        REQUIRE(runtime.execute(wasm, "main0").result.i64() == 30);
+
+        runtime.setHostFunction("isEven", [](HostCall &call, const wasm::Val args[], wasm::Val results[]) {
+            throw runtime_error("Not today");
+        });
+
+        REQUIRE_THROWS(runtime.execute(wasm, "main0"));
+    }
+
+    SECTION("Lists and structs that are returned are read in place, by the types the module records") {
+        ExecutionContext list = setup(R"(
+            capsule Test {
+                main<Function<List<Number>>> = () -> map([1, 2, 3, 4], double)
+
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+            }
+        )");
+
+        REQUIRE(list.resultType == "List<Number>");
+        REQUIRE(list.getNumbers().size == 4);
+        REQUIRE(list.getNumbers()[3] == 8);
+        REQUIRE(list.stringifiedResult() == "[2, 4, 6, 8]");
+        REQUIRE_THROWS(list.getBooleans());
+
+        ExecutionContext point = setup(R"(
+            capsule Test {
+                struct Point {
+                    visible<Boolean>
+                    x<Number>
+                    y<Number>
+                }
+
+                main<Function<Point>> = () -> @Point { visible: true, x: 3, y: 4 }
+            }
+        )");
+
+        REQUIRE(point.resultStruct);
+        REQUIRE(point.getNumberField("y") == 4);
+        REQUIRE(point.getBooleanField("visible"));
+        REQUIRE(point.stringifiedResult() == "@Point { x: 3, y: 4, visible: true }");
+        REQUIRE_THROWS(point.getNumberField("visible"));
+    }
+
+    SECTION("Metered programs are stopped once they run out of fuel or past their deadline") {
+        Compiler::getInstance().clearExceptions();
+        Compiler::getInstance().setIsMeteringFuel(true);
+
+        vector<char> wasm = Compiler::getInstance().compileDirect(R"(
+            capsule Test {
+                main<Function<Number>> = () -> count(0, 100)
+
+                forever<Function<Number>> = () -> count(0, -1)
+
+                count<Function<Number, Number, Number>> = (n<Number>, limit<Number>) -> {
+                    if (n == limit) {
+                        n
+                    } else {
+                        count(n + 1, limit)
+                    }
+                }
+            }
+        )");
+
+        Compiler::getInstance().setIsMeteringFuel(false);
+        REQUIRE(wasm.size() > 0);
+
+        Runtime runtime;
+        runtime.setExecutionLimits({ 1000, nullopt });
+
+        REQUIRE(runtime.execute(wasm, "main0").result.i64() == 100);
+        REQUIRE_THROWS_AS(runtime.execute(wasm, "forever0"), OutOfFuelError);
+
+        // A fresh instance gets its full fuel again
+        REQUIRE(runtime.execute(wasm, "main0").result.i64() == 100);
+
+        runtime.setExecutionLimits({ nullopt, chrono::milliseconds(50) });
+        REQUIRE_THROWS_AS(runtime.execute(wasm, "forever0"), DeadlineExceededError);
+        REQUIRE(runtime.execute(wasm, "main0").result.i64() == 100);
+
+        // Runs that finish just as their deadline passes don't leave the instance they hand back interrupted
+        runtime.setExecutionLimits({ nullopt, chrono::milliseconds(0) });
+        for (int i = 0; i < 20; i++) {
+            try {
+                runtime.execute(wasm, "main0");
+            } catch (const DeadlineExceededError&) {}
+        }
+
+        runtime.setExecutionLimits({ nullopt, chrono::seconds(10) });
+        REQUIRE(runtime.execute(wasm, "main0").result.i64() == 100);
+    }
+
+    SECTION("Profiled programs count the calls and time of each function, lifted lambdas by readable names") {
+        Compiler::getInstance().clearExceptions();
+        Compiler::getInstance().setIsProfiling(true);
+
+        vector<char> wasm = Compiler::getInstance().compileDirect(R"(
+            capsule Test {
+                main<Function<Number>> = () -> add1000(5) + 1
+
+                add1000<Function<Number, Number>> = (x<Number>) -> {
+                    add<Function<Number, Number>> = (y<Number>) -> x + y
+
+                    result<Number> = add(1000)
+
+                    return result
+                }
+            }
+        )");
+
+        Compiler::getInstance().setIsProfiling(false);
+        REQUIRE(wasm.size() > 0);
+
+        Runtime runtime;
+        REQUIRE(runtime.execute(wasm, "main0").result.i64() == 1006);
+        REQUIRE(runtime.execute(wasm, "main0").result.i64() == 1006);
+
+        vector<Profiler::FunctionProfile> top = runtime.getProfiler().getTopFunctions(10);
+        REQUIRE(top.size() >= 2);
+
+        for (const Profiler::FunctionProfile &function : top) {
+            if (function.name == "main0" || function.name == "add10001") REQUIRE(function.calls == 2);
+            else REQUIRE(function.name.find('/') != string::npos);
+
+            REQUIRE(function.totalNanoseconds >= function.selfNanoseconds);
+        }
+
+        string stacks = runtime.getProfiler().toCollapsedStacks();
+        REQUIRE(stacks.find("main0;add10001") != string::npos);
+        REQUIRE(runtime.getProfiler().toTable(5).find("add10001") != string::npos);
+
+        runtime.getProfiler().reset();
+        REQUIRE(runtime.getProfiler().getTopFunctions(10).empty());
+    }
+
+    SECTION("Engine options pick V8's flags, and only take effect before the engine is made") {
+        RuntimeOptions options;
+        options.compilationStrategy = *RuntimeOptions::parseCompilationStrategy("liftoff");
+        options.codeSpaceMegabytes = RuntimeOptions::parseCodeSpaceMegabytes("256");
+        options.isSimdEnabled = false;
+
+        string flags = options.toV8Flags();
+        REQUIRE(flags.find("--experimental-wasm-stringref") != string::npos);
+        REQUIRE(flags.find("--no-wasm-tier-up") != string::npos);
+        REQUIRE(flags.find("--no-experimental-wasm-simd") != string::npos);
+        REQUIRE(flags.find("--wasm-max-code-space-size-mb=256") != string::npos);
+
+        REQUIRE(!RuntimeOptions::parseCompilationStrategy("fastest"));
+        REQUIRE(!RuntimeOptions::parseCodeSpaceMegabytes("0"));
+
+        Runtime::getEngine();
+        REQUIRE(!Runtime::setEngineOptions(options));
+    }
+
+    SECTION("REPL sessions keep the functions defined on earlier lines, compiling only what each line defines") {
+        Compiler::getInstance().clearExceptions();
+        ReplSession repl;
+
+        ReplSession::Result defined = repl.evaluate("double<Function<Number, Number>> = (x<Number>) -> x * 2");
+        REQUIRE(defined.isOk);
+        REQUIRE(repl.getDefinitions().count("double") == 1);
+
+        REQUIRE(repl.evaluate("quadruple<Function<Number, Number>> = (x<Number>) -> double(double(x))").isOk);
+
+        ReplSession::Result called = repl.evaluate("quadruple(10) + double(1)");
+        REQUIRE(called.isOk);
+        REQUIRE(called.output == "42");
+
+        REQUIRE(repl.evaluate("double<Function<Number, Number>> = (x<Number>) -> x * 3").isOk);
+        REQUIRE(repl.evaluate("double(2)").output == "6");
+
+        REQUIRE(!repl.evaluate("double<Function<Boolean, Boolean>> = (x<Boolean>) -> !x").isOk);
+        REQUIRE(!repl.evaluate("doubleAll<Function<List<Number>, Number>> = (xs<List<Number>>) -> 1").isOk);
+
+        REQUIRE(repl.evaluate("1 + 2").output == "3");
+    }
+
+    SECTION("Sessions warmed up in the background compile and run as they would otherwise") {
+        CompilerSession session;
+        session.warmUp();
+        session.warmUp();
+
+        REQUIRE(CodeGen::getCoreLangWasm() != nullptr);
+
+        vector<char> wasm = session.compileDirect("6 * 7");
+        REQUIRE(wasm.size() > 0);
+        REQUIRE(session.execute(wasm, "main").result.i64() == 42);
+    }
+
+#ifdef THETA_COMPILE_SERVER_SOCKETS
+    SECTION("Compile servers answer compile and run requests sent over a connection") {
+        filesystem::path outputDir = filesystem::temp_directory_path() / "ThetaCompileServerTest";
+        filesystem::remove_all(outputDir);
+        filesystem::create_directories(outputDir);
+
+        string entryFile = (outputDir / "Game.th").string();
+        string outputFile = (outputDir / "Game.wasm").string();
+        ofstream(entryFile) << "capsule Game {\n    main<Function<Number>> = () -> 6 * 7\n}";
+
+        CompilerSession session;
+        session.setIsWasmCacheEnabled(false);
+        CompileServer server(session, outputDir / "server.sock");
+
+        int fds[2];
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        // The requests are small enough to all be sent before the server reads any of them
+        REQUIRE(CompileServer::writeFrame(fds[0], "compile\n" + entryFile + "\n" + outputFile));
+        REQUIRE(CompileServer::writeFrame(fds[0], "run\ncapsule Test {\n    main<Function<Number>> = () -> 6 * 7\n}"));
+        REQUIRE(CompileServer::writeFrame(fds[0], "shutdown"));
+
+        server.handleConnection(fds[1]);
+
+        string response;
+        REQUIRE(CompileServer::readFrame(fds[0], response));
+        REQUIRE(response.rfind("ok\n", 0) == 0);
+        REQUIRE(filesystem::exists(outputFile));
+
+        REQUIRE(CompileServer::readFrame(fds[0], response));
+        REQUIRE(response == "ok\n42");
+
+        REQUIRE(CompileServer::readFrame(fds[0], response));
+        REQUIRE(response == "ok\n");
+
+        close(fds[0]);
+        close(fds[1]);
+        filesystem::remove_all(outputDir);
+    }
+
+    SECTION("Compile servers answer clients while others stay connected without sending anything") {
+        filesystem::path outputDir = filesystem::temp_directory_path() / "ThetaCompileServerClientsTest";
+        filesystem::remove_all(outputDir);
+        filesystem::create_directories(outputDir);
+
+        CompilerSession session;
+        session.setIsWasmCacheEnabled(false);
+        CompileServer server(session, outputDir / "server.sock");
+        REQUIRE(server.listen());
+
+        future<void> serving = async(launch::async, [&server]() { server.serve(); });
+
+        auto connectToServer = [&outputDir]() {
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, (outputDir / "server.sock").c_str(), sizeof(address.sun_path) - 1);
+
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+
+            return fd;
+        };
+
+        // The first client connects and sends half of a frame's header, then nothing more
+        int idle = connectToServer();
+        REQUIRE(write(idle, "\0\0", 2) == 2);
+
+        int active = connectToServer();
+        REQUIRE(CompileServer::writeFrame(active, "run\ncapsule Test {\n    main<Function<Number>> = () -> 6 * 7\n}"));
+
+        string response;
+        REQUIRE(CompileServer::readFrame(active, response));
+        REQUIRE(response == "ok\n42");
+
+        REQUIRE(CompileServer::writeFrame(active, "shutdown"));
+        REQUIRE(CompileServer::readFrame(active, response));
+        REQUIRE(response == "ok\n");
+
+        REQUIRE(serving.wait_for(chrono::seconds(30)) == future_status::ready);
+
+        close(idle);
+        close(active);
+        filesystem::remove_all(outputDir);
+    }
+#endif
+
+    SECTION("Runtimes load the machine code other runtimes stored in the native code cache") {
+        Compiler::getInstance().clearExceptions();
+        vector<char> wasm = Compiler::getInstance().compileDirect(R"(
+            capsule Test {
+                main<Function<Number>> = () -> 6 * 7
+            }
+        )");
+        REQUIRE(wasm.size() > 0);
+
+        filesystem::path cacheDir = filesystem::temp_directory_path() / "ThetaNativeCodeCacheTest";
+        filesystem::remove_all(cacheDir);
+
+        Runtime compiling;
+        compiling.setNativeCodeCache(NativeCodeCache(cacheDir));
+        REQUIRE(compiling.execute(wasm, "main0").result.i64() == 42);
+        REQUIRE(!filesystem::is_empty(cacheDir));
+
+        Runtime loading;
+        loading.setNativeCodeCache(NativeCodeCache(cacheDir));
+        REQUIRE(loading.execute(wasm, "main0").result.i64() == 42);
+
+        // An entry found under another module's hash, as if the two collided, is compiled again rather than loaded
+        filesystem::path firstEntry = filesystem::directory_iterator(cacheDir)->path();
+
+        Compiler::getInstance().clearExceptions();
+        vector<char> otherWasm = Compiler::getInstance().compileDirect(R"(
+            capsule Test {
+                main<Function<Number>> = () -> 5 * 5
+            }
+        )");
+        REQUIRE(compiling.execute(otherWasm, "main0").result.i64() == 25);
+
+        for (const filesystem::directory_entry &entry : filesystem::directory_iterator(cacheDir)) {
+            if (entry.path() != firstEntry) filesystem::copy_file(firstEntry, entry.path(), filesystem::copy_options::overwrite_existing);
+        }
+
+        Runtime colliding;
+        colliding.setNativeCodeCache(NativeCodeCache(cacheDir));
+        REQUIRE(colliding.execute(otherWasm, "main0").result.i64() == 25);
+
+        filesystem::remove_all(cacheDir);
+    }
+
+    SECTION("Programs split into a module per capsule load each capsule the first time it's called") {
+        filesystem::path outputDir = filesystem::temp_directory_path() / "ThetaSplitCapsulesTest";
+        filesystem::remove_all(outputDir);
+        filesystem::create_directories(outputDir);
+
+        string entryFile = (outputDir / "Game.th").string();
+        ofstream(entryFile) << "link Theta.Scoring\n\ncapsule Game {\n    main<Function<Number>> = () -> 6 * 7\n}";
+
+        CompilerSession session;
+        session.setIsWasmCacheEnabled(false);
+        session.setIsSplittingCapsules(true);
+
+        string outputFile = (outputDir / "Game.wasm").string();
+        REQUIRE(session.compile(entryFile, outputFile));
+        REQUIRE(filesystem::exists(outputDir / "Theta.Scoring.wasm"));
+
+        ifstream entryStream(outputFile, ios::binary);
+        vector<char> entryWasm((istreambuf_iterator<char>(entryStream)), istreambuf_iterator<char>());
+
+        Runtime runtime;
+        CapsuleLoader loader(runtime, outputDir);
+        loader.addCapsule("Game", entryWasm);
+
+        REQUIRE(loader.execute("Game.main0").result.i64() == 42);
+        REQUIRE(loader.isLoaded("Game"));
+        REQUIRE_FALSE(loader.isLoaded("Theta.Scoring"));
+
+        wasm::Val args[] = { wasm::Val(int64_t(21)) };
+        wasm::Val results[1];
+        loader.invoke("Theta.Scoring.score1Number", args, 1, results, 1);
+
+        REQUIRE(results[0].i64() == 42);
+        REQUIRE(loader.isLoaded("Theta.Scoring"));
+
+        filesystem::remove_all(outputDir);
+    }
+
+    SECTION("Entrypoints compiled together each write their own module, sharing the capsules they link") {
+        filesystem::path outputDir = filesystem::temp_directory_path() / "ThetaBatchCompileTest";
+        filesystem::remove_all(outputDir);
+        filesystem::create_directories(outputDir);
+
+        vector<pair<string, string>> entrypoints;
+        for (int i = 1; i <= 3; i++) {
+            string name = "Game" + to_string(i);
+            string entryFile = (outputDir / (name + ".th")).string();
+            ofstream(entryFile) << "link Theta.Scoring\n\ncapsule " + name + " {\n    main<Function<Number>> = () -> 6 * " + to_string(i) + "\n}";
+
+            entrypoints.push_back(make_pair(entryFile, (outputDir / (name + ".wasm")).string()));
+        }
+
+        string brokenFile = (outputDir / "Broken.th").string();
+        ofstream(brokenFile) << "capsule Broken {\n    main<Function<Number>> = () -> 'a'\n}";
+
+        CompilerSession session;
+        session.setIsWasmCacheEnabled(false);
+        session.setIsSplittingCapsules(true);
+
+        REQUIRE(session.compileBatch(entrypoints));
+        REQUIRE(filesystem::exists(outputDir / "Theta.Scoring.wasm"));
+
+        Runtime runtime;
+        for (int i = 1; i <= 3; i++) {
+            ifstream wasmStream(entrypoints[i - 1].second, ios::binary);
+            vector<char> wasm((istreambuf_iterator<char>(wasmStream)), istreambuf_iterator<char>());
+
+            REQUIRE(runtime.execute(wasm, "main0").result.i64() == 6 * i);
+        }
+
+        entrypoints.push_back(make_pair(brokenFile, (outputDir / "Broken.wasm").string()));
+
+        REQUIRE_FALSE(session.compileBatch(entrypoints));
+        REQUIRE_FALSE(filesystem::exists(outputDir / "Broken.wasm"));
+        REQUIRE(session.getEncounteredExceptions().empty());
+
+        filesystem::remove_all(outputDir);
+    }
+
+    SECTION("Capsule functions generated on several threads compile to the same module every time") {
+        Compiler::getInstance().clearExceptions();
+
+        string source = R"(
+            capsule Test {
+                main<Function<Number>> = () -> scale(3) + offset(2) + lookup(4) + sum() + greet(5)
+
+                scale<Function<Number, Number>> = (n<Number>) -> {
+                    times<Function<Number, Number>> = (x<Number>) -> x * n
+
+                    times(10)
+                }
+
+                offset<Function<Number, Number>> = (n<Number>) -> {
+                    plus<Function<Number, Number>> = (y<Number>) -> y * n
+
+                    plus(10)
+                }
+
+                lookup<Function<Number, Number>> = (n<Number>) -> {
+                    config<Dict<Number>> = { port: 8080, retries: n }
+
+                    get(config, :retries)
+                }
+
+                sum<Function<Number>> = () -> reduce(map([1, 2, 3], double), add, 0)
+
+                greet<Function<Number, Number>> = (n<Number>) -> {
+                    if ('a' + 'b' == 'ab') {
+                        n
+                    } else {
+                        0
+                    }
+                }
+
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+                add<Function<Number, Number, Number>> = (total<Number>, x<Number>) -> total + x
+            }
+        )";
+
+        vector<char> first = Compiler::getInstance().compileDirect(source);
+        vector<char> second = Compiler::getInstance().compileDirect(source);
+        REQUIRE(first.size() > 0);
+        REQUIRE(first == second);
+
+        Runtime runtime;
+        REQUIRE(runtime.execute(first, "main0").result.i64() == 71);
+    }
+
+    SECTION("Source maps point generated code back to the source") {
+        string source = "capsule Test {\n    main<Function<Number>> = () -> 2 + 3\n}";
+
+        Compiler::getInstance().clearExceptions();
+        lexer.lex(source);
+
+        shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+        Compiler::getInstance().optimizeAST(parsedAST, true);
+        REQUIRE(typeChecker.checkAST(parsedAST));
+
+        CodeGen sourceMappedCodeGen;
+        sourceMappedCodeGen.setDebugInfoFile("fakeFile.th");
+        BinaryenModuleRef module = sourceMappedCodeGen.generateWasmFromAST(parsedAST);
+
+        BinaryenModuleAllocateAndWriteResult result = BinaryenModuleAllocateAndWrite(module, "fakeFile.wasm.map");
+        REQUIRE(result.sourceMap != nullptr);
+
+        string sourceMap = result.sourceMap;
+        REQUIRE(sourceMap.find("\"sources\":[\"fakeFile.th\"]") != string::npos);
+        REQUIRE(sourceMap.find("\"mappings\":\"\"") == string::npos);
+
+        free(result.binary);
+        free(result.sourceMap);
+        BinaryenModuleDispose(module);
+    }
+
+    SECTION("Symbol names are only emitted in modules built with debug info") {
+        string source = R"(
+            capsule Test {
+                main<Function<Boolean>> = () -> {
+                    status<Symbol> = :ok
+                    status == :error
+                }
+            }
+        )";
+
+        Compiler::getInstance().clearExceptions();
+        lexer.lex(source);
+
+        shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+        Compiler::getInstance().optimizeAST(parsedAST, true);
+        REQUIRE(typeChecker.checkAST(parsedAST));
+
+        CodeGen plainCodeGen;
+        BinaryenModuleRef plainModule = plainCodeGen.generateWasmFromAST(parsedAST);
+        BinaryenModuleAllocateAndWriteResult plain = BinaryenModuleAllocateAndWrite(plainModule, nullptr);
+
+        CodeGen debugCodeGen;
+        debugCodeGen.setDebugInfoFile("fakeFile.th");
+        BinaryenModuleRef debugModule = debugCodeGen.generateWasmFromAST(parsedAST);
+        BinaryenModuleAllocateAndWriteResult debug = BinaryenModuleAllocateAndWrite(debugModule, "fakeFile.wasm.map");
+
+        string plainBinary(static_cast<char*>(plain.binary), plain.binaryBytes);
+        string debugBinary(static_cast<char*>(debug.binary), debug.binaryBytes);
+
+        REQUIRE(plainBinary.find("theta.symbols") == string::npos);
+        REQUIRE(debugBinary.find("theta.symbols") != string::npos);
+        REQUIRE(debugBinary.find(":ok\n:error\n") != string::npos);
+
+        free(plain.binary);
+        free(debug.binary);
+        free(debug.sourceMap);
+        BinaryenModuleDispose(plainModule);
+        BinaryenModuleDispose(debugModule);
+    }
+}
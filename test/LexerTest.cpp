@@ -1,6 +1,8 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch2/catch_amalgamated.hpp"
 #include "../src/lexer/Lexer.cpp"
+#include <filesystem>
+#include <fstream>
 
 using namespace std;
 using namespace Theta;
@@ -445,4 +447,113 @@ TEST_CASE("Lexer") {
         verifyTokens(lexer.tokens, expectedTokens);
     }
 
+    SECTION("Token lexemes are views into the lexer's source buffer") {
+        string source = "greeting<String> = 'hello' + name";
+        lexer.lex(source);
+
+        string_view buffer = lexer.getSource()->view();
+
+        REQUIRE(lexer.tokens.size() == 8);
+        for (int i = 0; i < lexer.tokens.size(); i++) {
+            string_view lexeme = lexer.tokens[i].getLexemeView();
+
+            REQUIRE(lexeme.data() >= buffer.data());
+            REQUIRE(lexeme.data() + lexeme.length() <= buffer.data() + buffer.length());
+        }
+    }
+
+    SECTION("Token stream lexes the same tokens on demand") {
+        string source = "x<Number> = 5 // comment\ny<String> = 'a' + 'b'";
+
+        Theta::Lexer eagerLexer;
+        eagerLexer.lex(source);
+
+        lexer.load(source);
+        LexerTokenStream stream(lexer);
+
+        REQUIRE(stream.peek(2)->getLexeme() == "Number");
+
+        for (int i = 0; i < eagerLexer.tokens.size(); i++) {
+            REQUIRE(!stream.isEmpty());
+            REQUIRE(stream.front().getType() == eagerLexer.tokens[i].getType());
+            REQUIRE(stream.front().getLexeme() == eagerLexer.tokens[i].getLexeme());
+            REQUIRE(stream.front().getStartLocation() == eagerLexer.tokens[i].getStartLocation());
+            stream.advance();
+        }
+
+        REQUIRE(stream.isEmpty());
+        REQUIRE(stream.peek() == nullptr);
+    }
+
+    SECTION("Tracks line and column numbers across whitespace runs, comments and identifiers") {
+        string source = "capsule   Test {\n                    abcdefghijklmnopqrstuvwxyz<Number> = 1 // trailing\n  /- a\n     multiline\n  comment -/ z\n}";
+        lexer.lex(source);
+
+        vector<tuple<string, int, int>> expectedLocations = {
+            { "capsule", 1, 1 },
+            { "Test", 1, 11 },
+            { "{", 1, 16 },
+            { "abcdefghijklmnopqrstuvwxyz", 2, 21 },
+            { "<", 2, 47 },
+            { "Number", 2, 48 },
+            { ">", 2, 54 },
+            { "=", 2, 56 },
+            { "1", 2, 58 },
+            { "z", 5, 14 },
+            { "}", 6, 1 }
+        };
+
+        REQUIRE(lexer.tokens.size() == expectedLocations.size());
+        for (int i = 0; i < expectedLocations.size(); i++) {
+            REQUIRE(lexer.tokens[i].getLexeme() == get<0>(expectedLocations[i]));
+            REQUIRE(lexer.tokens[i].getStartLocation() == vector<int>{ get<1>(expectedLocations[i]), get<2>(expectedLocations[i]) });
+        }
+    }
+
+    SECTION("Can lex a source file directly") {
+        string path = (filesystem::temp_directory_path() / "ThetaLexerTestSourceFile.th").string();
+        ofstream(path) << "capsule Test {\n  x<Number> = 5\n}";
+
+        shared_ptr<SourceFile> sourceFile = SourceFile::open(path);
+        REQUIRE(sourceFile != nullptr);
+        REQUIRE(!sourceFile->truncated());
+
+        lexer.lex(sourceFile);
+
+        vector<pair<Token::Types, string>> expectedTokens = {
+            { Token::KEYWORD, Lexemes::CAPSULE },
+            { Token::IDENTIFIER, "Test" },
+            { Token::BRACE_OPEN, Lexemes::BRACE_OPEN },
+            { Token::IDENTIFIER, "x" },
+            { Token::OPERATOR, Lexemes::LT },
+            { Token::IDENTIFIER, "Number" },
+            { Token::OPERATOR, Lexemes::GT },
+            { Token::ASSIGNMENT, Lexemes::ASSIGNMENT },
+            { Token::NUMBER, "5" },
+            { Token::BRACE_CLOSE, Lexemes::BRACE_CLOSE }
+        };
+
+        verifyTokens(lexer.tokens, expectedTokens);
+
+        shared_ptr<SourceFile> prefix = SourceFile::open(path, 7);
+        REQUIRE(prefix->view() == "capsule");
+        REQUIRE(prefix->truncated());
+
+        REQUIRE(SourceFile::open(path + ".missing") == nullptr);
+
+        filesystem::remove(path);
+    }
+
+    SECTION("Lines of a source file can be looked up without rescanning it") {
+        shared_ptr<SourceFile> sourceFile = SourceFile::fromString("capsule Test {\n  x<Number> = 5\n\n}");
+
+        REQUIRE(sourceFile->getLine(1) == "capsule Test {");
+        REQUIRE(sourceFile->getLine(2) == "  x<Number> = 5");
+        REQUIRE(sourceFile->getLine(3) == "");
+        REQUIRE(sourceFile->getLine(4) == "}");
+        REQUIRE(sourceFile->getLine(5) == nullopt);
+        REQUIRE(sourceFile->getLine(0) == nullopt);
+
+        REQUIRE(SourceFile::fromString("")->getLine(1) == "");
+    }
 }
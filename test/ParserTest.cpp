@@ -2,6 +2,7 @@
 #include "catch2/catch_amalgamated.hpp"
 #include "../src/lexer/Lexer.cpp"
 #include "../src/parser/Parser.cpp"
+#include "../src/parser/IncrementalParser.hpp"
 #include "../src/compiler/Compiler.hpp"
 
 using namespace std;
@@ -2114,6 +2115,45 @@ TEST_CASE("Parser") {
         REQUIRE(mainRightNode->getIdentifier() == "Theta.StringUtil.name");
     }
 
+    SECTION("Reports capsules that link each other in a cycle instead of waiting on them forever") {
+        string source = R"(
+            link Theta.LinkCycleA
+
+            capsule MyTestCapsule {
+                x<Number> = Theta.LinkCycleA.a
+            }
+        )";
+        lexer.lex(source);
+
+        Compiler::getInstance().clearExceptions();
+
+        shared_ptr<SourceNode> parsedAST = dynamic_pointer_cast<SourceNode>(
+            parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName)
+        );
+
+        REQUIRE(parsedAST->getLinks().size() == 1);
+
+        shared_ptr<LinkNode> linkNodeA = dynamic_pointer_cast<LinkNode>(parsedAST->getLinks()[0]);
+        REQUIRE(linkNodeA->capsule == "Theta.LinkCycleA");
+
+        shared_ptr<SourceNode> linkedSourceA = dynamic_pointer_cast<SourceNode>(linkNodeA->getValue());
+        REQUIRE(linkedSourceA->getLinks().size() == 1);
+
+        shared_ptr<LinkNode> linkNodeB = dynamic_pointer_cast<LinkNode>(linkedSourceA->getLinks()[0]);
+        REQUIRE(linkNodeB->capsule == "Theta.LinkCycleB");
+
+        // B links back to A, which is where the cycle gets cut
+        shared_ptr<SourceNode> linkedSourceB = dynamic_pointer_cast<SourceNode>(linkNodeB->getValue());
+        REQUIRE(linkedSourceB->getLinks().size() == 1);
+        REQUIRE(linkedSourceB->getLinks()[0]->getValue() == nullptr);
+
+        vector<shared_ptr<Error>> exceptions = Compiler::getInstance().getEncounteredExceptions();
+        REQUIRE(exceptions.size() == 1);
+        REQUIRE(dynamic_pointer_cast<CompilationError>(exceptions[0])->what().find("linked in a cycle") != string::npos);
+
+        Compiler::getInstance().clearExceptions();
+    }
+
     SECTION("Can parse struct declarations inside a capsule") {
         string source = R"(
             capsule Math {
@@ -2311,4 +2351,283 @@ TEST_CASE("Parser") {
         REQUIRE(returnValueNode->getNodeType() == ASTNode::BOOLEAN_LITERAL);
         REQUIRE(returnValueNode->getLiteralValue() == "true");
     }
+
+    SECTION("ASTs survive a round trip through the binary AST cache format") {
+        string source = R"(
+            link Theta.StringUtil
+
+            capsule Math {
+                struct Point {
+                    x<Number>
+                    y<Number>
+                }
+
+                enum Level {
+                    :LOW
+                    :HIGH
+                }
+
+                origin<Point> = Point { x: 0, y: 0 }
+                names<List<String>> = ['Alex', 'Tony']
+                lookup<Dict<Number>> = { a: 1, b: -2 }
+                status<Tuple<Symbol, String>> = { :ok, 'Success' }
+
+                pick<Number> = (name<String>, n<Number>) -> {
+                    if (name == 'Mike') {
+                        return n ** 2
+                    } else if (!(n > 3)) {
+                        return n
+                    }
+
+                    'hello' => reverse()
+                    return 0
+                }
+            }
+        )";
+        lexer.lex(source);
+
+        shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+        REQUIRE(parsedAST != nullptr);
+
+        uint64_t sourceHash = ASTCache::hashSource(source);
+        vector<char> encoded = ASTCache::serialize(parsedAST, source, sourceHash);
+
+        shared_ptr<ASTNode> decodedAST = ASTCache::deserialize(string_view(encoded.data(), encoded.size()), source, sourceHash);
+        REQUIRE(decodedAST != nullptr);
+
+        // Links are only stored by name, they get resolved again when an entry is loaded
+        shared_ptr<SourceNode> decodedSource = dynamic_pointer_cast<SourceNode>(decodedAST);
+        REQUIRE(decodedSource->getLinks().size() == 1);
+        REQUIRE(dynamic_pointer_cast<LinkNode>(decodedSource->getLinks()[0])->capsule == "Theta.StringUtil");
+        REQUIRE(decodedSource->getLinks()[0]->getValue() == nullptr);
+
+        REQUIRE(decodedAST->getValue()->toJSON() == parsedAST->getValue()->toJSON());
+        REQUIRE(decodedAST->getValue()->getParent() == decodedAST);
+        REQUIRE(decodedAST->getValue()->getLine() == parsedAST->getValue()->getLine());
+        REQUIRE(decodedAST->getValue()->getColumn() == parsedAST->getValue()->getColumn());
+
+        // Entries for other sources, and corrupt entries, are rejected rather than decoded into garbage
+        REQUIRE(ASTCache::deserialize(string_view(encoded.data(), encoded.size()), source, sourceHash + 1) == nullptr);
+        REQUIRE(ASTCache::deserialize(string_view(encoded.data(), encoded.size() / 2), source, sourceHash) == nullptr);
+
+        vector<char> corrupted = encoded;
+        uint32_t badOffset = corrupted.size() + 64;
+        memcpy(corrupted.data() + 12, &badOffset, sizeof(badOffset));
+        REQUIRE(ASTCache::deserialize(string_view(corrupted.data(), corrupted.size()), source, sourceHash) == nullptr);
+
+        // A source whose hash collides with the entry's, whether or not it is as long, still isn't given its tree
+        string sameLength = source;
+        sameLength[sameLength.find("Mike")] = 'm';
+        REQUIRE(ASTCache::deserialize(string_view(encoded.data(), encoded.size()), sameLength, sourceHash) == nullptr);
+        REQUIRE(ASTCache::deserialize(string_view(encoded.data(), encoded.size()), source + " ", sourceHash) == nullptr);
+    }
+
+    SECTION("Capsules only need rebuilding when their source or the interfaces they link change") {
+        auto parseSource = [&](string source) {
+            Theta::Lexer sourceLexer;
+            sourceLexer.lex(source);
+
+            return parser.parse(sourceLexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+        };
+
+        shared_ptr<ASTNode> original = parseSource(
+            "link Theta.StringUtil\n\ncapsule Math {\n  add<Number> = (a<Number>, b<Number>) -> a + b\n}"
+        );
+
+        CapsuleGraph graph = CapsuleGraph::build(original, "fakeFile.th", *filesByCapsuleName);
+        REQUIRE(graph.getUnits().size() == 2);
+        REQUIRE(graph.getUnits()[0].name == "Theta.StringUtil");
+        REQUIRE(graph.getEntrypoint().name == "Math");
+        REQUIRE(graph.getEntrypoint().dependencies == vector<string>{ "Theta.StringUtil" });
+        REQUIRE(graph.findUnit("Theta.StringUtil")->ast != nullptr);
+
+        // Editing a function body changes what has to be rebuilt, but not what other capsules see
+        shared_ptr<ASTNode> editedBody = parseSource(
+            "link Theta.StringUtil\n\ncapsule Math {\n  add<Number> = (a<Number>, b<Number>) -> a - b\n}"
+        );
+        CapsuleGraph editedBodyGraph = CapsuleGraph::build(editedBody, "fakeFile.th", *filesByCapsuleName);
+
+        REQUIRE(editedBodyGraph.getEntrypoint().interfaceHash == graph.getEntrypoint().interfaceHash);
+        REQUIRE(editedBodyGraph.getEntrypoint().buildKey != graph.getEntrypoint().buildKey);
+        REQUIRE(editedBodyGraph.findUnit("Theta.StringUtil")->buildKey == graph.findUnit("Theta.StringUtil")->buildKey);
+
+        shared_ptr<ASTNode> editedReturnType = parseSource(
+            "capsule Math {\n  add<String> = (a<Number>, b<Number>) -> a + b\n}"
+        );
+        shared_ptr<ASTNode> editedParameter = parseSource(
+            "capsule Math {\n  add<Number> = (a<Number>, c<Number>) -> a + b\n}"
+        );
+
+        REQUIRE(CapsuleGraph::hashInterface(editedReturnType) != CapsuleGraph::hashInterface(original));
+        REQUIRE(CapsuleGraph::hashInterface(editedParameter) != CapsuleGraph::hashInterface(original));
+    }
+
+    SECTION("Parsed ASTs are released once nothing references them") {
+        string source = "capsule Math {\n  add<Number> = (a<Number>, b<Number>) -> a + b\n}";
+        lexer.lex(source);
+
+        shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+
+        shared_ptr<ASTNode> capsuleNode = parsedAST->getValue();
+        shared_ptr<ASTNode> blockNode = capsuleNode->getValue();
+        REQUIRE(capsuleNode->getParent() == parsedAST);
+        REQUIRE(blockNode->getParent() == capsuleNode);
+
+        weak_ptr<ASTNode> weakAST = parsedAST;
+        weak_ptr<ASTNode> weakBlock = blockNode;
+
+        capsuleNode = nullptr;
+        blockNode = nullptr;
+        parsedAST = nullptr;
+
+        REQUIRE(weakAST.expired());
+        REQUIRE(weakBlock.expired());
+    }
+
+    SECTION("Lexing and parsing are timed apart when timing phases") {
+        Theta::Compiler compiler;
+        REQUIRE(compiler.getPhaseTimer() == nullptr);
+
+        compiler.setIsTimingPhases(true);
+        shared_ptr<ASTNode> parsedAST = compiler.buildAST("x<Number> = 5 + 3", "fakeFile.th");
+        REQUIRE(parsedAST != nullptr);
+
+        vector<PhaseTimer::Phase> phases = compiler.getPhaseTimer()->getPhases();
+        REQUIRE(phases.size() == 2);
+        REQUIRE(phases[0].name == "Lex fakeFile.th");
+        REQUIRE(phases[1].name == "Parse fakeFile.th");
+        REQUIRE(phases[1].wallMs >= 0);
+
+        string json = compiler.getPhaseTimer()->toJSON();
+        REQUIRE(json.find("{\"name\":\"Lex fakeFile.th\",\"wallMs\":") != string::npos);
+        REQUIRE(compiler.getPhaseTimer()->toTable().find("Parse fakeFile.th") != string::npos);
+    }
+
+    SECTION("ASTs are written as JSON straight into a stream") {
+        Theta::Compiler compiler;
+        shared_ptr<ASTNode> parsedAST = compiler.buildAST("x<Number> = 5 + 3", "fakeFile.th");
+        REQUIRE(parsedAST != nullptr);
+
+        ostringstream oss;
+
+        {
+            JsonWriter writer(oss);
+            parsedAST->writeJSON(writer);
+        }
+
+        REQUIRE(oss.str() == parsedAST->toJSON());
+        REQUIRE(oss.str().find("{\"type\": \"BinaryOperation\", \"operator\": \"+\", \"left\": {\"type\": \"NumberLiteral\", \"value\": \"5\"}") != string::npos);
+
+        ostringstream escaped;
+
+        {
+            JsonWriter writer(escaped);
+            writer.beginObject().field("lexeme", "'a\"b\\c'\n").key("value").null().endObject();
+        }
+
+        REQUIRE(escaped.str() == "{\"lexeme\": \"'a\\\"b\\\\c'\\n\", \"value\": null}");
+    }
+
+    SECTION("Tokens and nodes are counted by type when collecting stats") {
+        Theta::Compiler compiler;
+        REQUIRE(compiler.getCompileStats() == nullptr);
+
+        compiler.setIsCollectingStats(true);
+        shared_ptr<ASTNode> parsedAST = compiler.buildAST("x<Number> = 5 + 3", "fakeFile.th");
+        REQUIRE(parsedAST != nullptr);
+
+        string json = compiler.getCompileStats()->toJSON();
+        REQUIRE(json.find("\"tokens\":0,") == string::npos);
+        REQUIRE(json.find("\"sourceBytes\":17,") != string::npos);
+        REQUIRE(json.find("\"NumberLiteral\":2") != string::npos);
+        REQUIRE(json.find("\"BinaryOperation\":1") != string::npos);
+        REQUIRE(json.find("\"astArenaBytes\":0,") == string::npos);
+        REQUIRE(compiler.getCompileStats()->toTable().find("AST nodes") != string::npos);
+    }
+
+    SECTION("Capsule functions can be annotated to be memoized") {
+        string source = R"(
+            capsule Math {
+                @memo fib<Function<Number, Number>> = (n<Number>) -> fib(n - 1) + fib(n - 2)
+                @Point { x: 1 }
+            }
+        )";
+        lexer.lex(source);
+
+        shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(parsedAST->getValue()->getValue())->getElements();
+
+        REQUIRE(elements.size() == 2);
+        REQUIRE(elements[0]->getNodeType() == ASTNode::ASSIGNMENT);
+        REQUIRE(dynamic_pointer_cast<FunctionDeclarationNode>(elements[0]->getRight())->getIsMemoized());
+        REQUIRE(elements[0]->getRight()->toJSON().find("\"annotations\": [\"memo\"]") != string::npos);
+        REQUIRE(elements[1]->getNodeType() == ASTNode::STRUCT_DECLARATION);
+    }
+
+    SECTION("Nodes remember where in the source they start") {
+        string source = "capsule Math {\n  x<Number> = 5 +\n    abc\n}";
+        lexer.lex(source);
+
+        shared_ptr<ASTNode> parsedAST = parser.parse(lexer.tokens, source, "fakeFile.th", filesByCapsuleName);
+
+        shared_ptr<ASTNode> capsuleNode = parsedAST->getValue();
+        REQUIRE(capsuleNode->getLine() == 1);
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(capsuleNode->getValue())->getElements()[0];
+        shared_ptr<ASTNode> binOp = assignment->getRight();
+        REQUIRE(binOp->getNodeType() == ASTNode::BINARY_OPERATION);
+        REQUIRE(binOp->getLine() == 2);
+        REQUIRE(binOp->getColumn() == 17);
+
+        REQUIRE(binOp->getRight()->getLine() == 3);
+        REQUIRE(binOp->getRight()->getColumn() == 5);
+    }
+
+    SECTION("Edits only reparse the block element they're in") {
+        string source = "capsule Math {\n  x<Number> = 5\n  y<Number> = 6\n  double<Function<Number, Number>> = (n<Number>) -> {\n    n * 2\n  }\n  z<Number> = 7\n}";
+        IncrementalParser document("fakeFile.th", source, filesByCapsuleName);
+
+        auto getMembers = [&document]() {
+            return dynamic_pointer_cast<ASTNodeList>(document.getAST()->getValue()->getValue())->getElements();
+        };
+
+        vector<shared_ptr<ASTNode>> members = getMembers();
+        REQUIRE(members.size() == 4);
+
+        // Typing in y's value replaces y, and nothing else
+        REQUIRE(document.edit({ 3, 15, 3, 16, "60" }));
+
+        vector<shared_ptr<ASTNode>> edited = getMembers();
+        REQUIRE(edited[0] == members[0]);
+        REQUIRE(edited[1] != members[1]);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(edited[1]->getRight())->getLiteralValue() == "60");
+        REQUIRE(edited[2] == members[2]);
+        REQUIRE(edited[3] == members[3]);
+
+        // An edit in a function's body only replaces the statement it's in, and moves everything after it down a line
+        shared_ptr<ASTNodeList> body = dynamic_pointer_cast<ASTNodeList>(
+            dynamic_pointer_cast<FunctionDeclarationNode>(members[2]->getRight())->getDefinition()
+        );
+        shared_ptr<ASTNode> statement = body->getElements()[0];
+
+        REQUIRE(document.edit({ 5, 9, 5, 10, "2 +\n    n" }));
+
+        REQUIRE(getMembers()[2] == members[2]);
+        REQUIRE(body->getElements()[0] != statement);
+        REQUIRE(body->getElements()[0]->getRight()->getLine() == 6);
+        REQUIRE(members[3]->getLine() == 8);
+
+        // A new member typed after x doesn't fit in x's place, so the whole document is reparsed
+        REQUIRE_FALSE(document.edit({ 2, 16, 2, 16, " w<Number> = 1" }));
+        REQUIRE(getMembers().size() == 5);
+        REQUIRE(getMembers()[0] != members[0]);
+
+        // As are edits outside of the capsule's members
+        REQUIRE_FALSE(document.edit({ 1, 9, 1, 13, "Maths" }));
+        REQUIRE(dynamic_pointer_cast<CapsuleNode>(document.getAST()->getValue())->getName() == "Maths");
+
+        string reparsed = document.getAST()->toJSON();
+        lexer.lex(string(document.getSource()->view()));
+        REQUIRE(parser.parse(lexer.tokens, lexer.getSource(), "fakeFile.th", filesByCapsuleName)->toJSON() == reparsed);
+    }
 }
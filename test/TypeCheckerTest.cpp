@@ -4,6 +4,10 @@
 #include "../src/parser/Parser.cpp"
 #include "../src/compiler/Compiler.hpp"
 #include "../src/compiler/TypeChecker.hpp"
+#include "../src/compiler/TypeInterner.hpp"
+#include "../src/exceptions/ReferenceError.hpp"
+#include "../src/compiler/CompilerSession.hpp"
+#include <thread>
 
 using namespace std;
 using namespace Theta;
@@ -116,6 +120,34 @@ TEST_CASE_METHOD(TypeCheckerTest, "TypeChecker") {
         REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 0);
     }
 
+    SECTION("Throws if the function passed to filter doesn't return a Boolean") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                main<Function<List<Number>>> = () -> filter([1, 2, 3], double)
+
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+            }
+        )");
+
+        bool isValid = typeChecker.checkAST(ast);
+
+        REQUIRE(!isValid);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+    }
+
+    SECTION("Throws if a dictionary is looked up by something other than a symbol") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> get({ port: 8080 }, 'port')
+            }
+        )");
+
+        bool isValid = typeChecker.checkAST(ast);
+
+        REQUIRE(!isValid);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+    }
+
     SECTION("Throws if list is not homogenous") {
         shared_ptr<ASTNode> ast = setup(R"(
             capsule Test {
@@ -207,6 +239,34 @@ TEST_CASE_METHOD(TypeCheckerTest, "TypeChecker") {
         REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
     }
 
+    SECTION("Throws if a value read from a tuple doesnt match type spec") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                x<Tuple<Symbol, Number>> = { :ok, 5 }
+                y<Number> = second(x)
+                z<Number> = first(x)
+            }
+        )");
+
+        bool isValid = typeChecker.checkAST(ast);
+
+        REQUIRE(!isValid);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+    }
+
+    SECTION("Throws if a string intrinsic is passed the wrong type") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                find<Function<String, Number>> = (text<String>) -> indexOf(text, 5)
+            }
+        )");
+
+        bool isValid = typeChecker.checkAST(ast);
+
+        REQUIRE(!isValid);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+    }
+
     SECTION("Can typecheck function assignments correctly") {
         shared_ptr<ASTNode> ast = setup(R"(
             capsule Test {
@@ -424,6 +484,33 @@ TEST_CASE_METHOD(TypeCheckerTest, "TypeChecker") {
         REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 0);
     }
 
+    SECTION("Function declarations and the calls to them resolve to the same signature id") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                add<Function<Number, Number, Number>> = (x<Number>, y<Number>) -> x + y
+                add<Function<Number, String, Number>> = (x<Number>, y<String>) -> x
+                main<Function<Number>> = () -> add(1, 2)
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+        shared_ptr<FunctionDeclarationNode> numbers = dynamic_pointer_cast<FunctionDeclarationNode>(elements[0]->getRight());
+        shared_ptr<FunctionDeclarationNode> strings = dynamic_pointer_cast<FunctionDeclarationNode>(elements[1]->getRight());
+        shared_ptr<FunctionDeclarationNode> main = dynamic_pointer_cast<FunctionDeclarationNode>(elements[2]->getRight());
+        shared_ptr<ASTNode> call = dynamic_pointer_cast<ASTNodeList>(main->getDefinition())->getElements()[0];
+
+        int numbersId = Compiler::getQualifiedFunctionId("add", numbers);
+
+        REQUIRE(numbers->getSignatureId(SymbolInterner::getInstance().getId("add")) == numbersId);
+        REQUIRE(Compiler::getQualifiedFunctionId("add", call) == numbersId);
+        REQUIRE(Compiler::getQualifiedFunctionId("add", elements[0]->getLeft()->getValue()) == numbersId);
+        REQUIRE(Compiler::getQualifiedFunctionId("add", strings) != numbersId);
+        REQUIRE(Compiler::getQualifiedFunctionIdentifier("add", call) == "add2NumberNumber");
+        REQUIRE(Compiler::getQualifiedFunctionIdentifier("add", strings) == "add2NumberString");
+    }
+
     SECTION("Throws if trying to access a variable before defining it") {
         shared_ptr<ASTNode> ast = setup(R"(
             capsule Test {
@@ -516,6 +603,25 @@ TEST_CASE_METHOD(TypeCheckerTest, "TypeChecker") {
         REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 0);
     }
 
+    SECTION("Can typecheck struct declarations whose fields have different types") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                struct Point {
+                    visible<Boolean>
+                    x<Number>
+                    y<Number>
+                }
+
+                origin<Function<Point>> = () -> @Point { visible: true, x: 3, y: 4 }
+            }
+        )");
+
+        bool isValid = typeChecker.checkAST(ast);
+
+        REQUIRE(isValid);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 0);
+    }
+
     SECTION("Throws if struct declaration is missing fields from definition") {
         shared_ptr<ASTNode> ast = setup(R"(
             capsule Test {
@@ -563,6 +669,24 @@ TEST_CASE_METHOD(TypeCheckerTest, "TypeChecker") {
         REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
     }
 
+    SECTION("Throws if a field that isn't in the struct's definition is read") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                struct Point {
+                    x<Number>
+                    y<Number>
+                }
+
+                getZ<Function<Point, Number>> = (p<Point>) -> get(p, :z)
+            }
+        )");
+
+        bool isValid = typeChecker.checkAST(ast);
+
+        REQUIRE(!isValid);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+    }
+
     SECTION("Throws if struct declaration field types dont match") {
         shared_ptr<ASTNode> ast = setup(R"(
             capsule Test {
@@ -638,4 +762,475 @@ TEST_CASE_METHOD(TypeCheckerTest, "TypeChecker") {
 
         REQUIRE(isValid);
     }
+
+    SECTION("Constant expressions are folded into literals") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                x<Number> = 1 + 2 * 3
+                isBig<Boolean> = !(x > 5) || 2 ** 3 == 8
+                greeting<String> = 'hello, ' + 'world'
+                undefined<Number> = 1 / 0
+            }
+        )");
+
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+
+        REQUIRE(elements[0]->getRight()->getNodeType() == ASTNode::NUMBER_LITERAL);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(elements[0]->getRight())->getLiteralValue() == "7");
+
+        REQUIRE(elements[1]->getRight()->getNodeType() == ASTNode::BOOLEAN_LITERAL);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(elements[1]->getRight())->getLiteralValue() == "true");
+
+        REQUIRE(elements[2]->getRight()->getNodeType() == ASTNode::STRING_LITERAL);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(elements[2]->getRight())->getLiteralValue() == "hello, world");
+
+        REQUIRE(elements[3]->getRight()->getNodeType() == ASTNode::BINARY_OPERATION);
+
+        REQUIRE(typeChecker.checkAST(ast));
+    }
+
+    SECTION("Folded constants are inlined and folded again until nothing changes") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                scaled<Function<Number>> = () -> {
+                    base<Number> = 2 + 3
+                    base * 2
+                }
+            }
+        )");
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements()[0];
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+        vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements();
+
+        REQUIRE(body.size() == 1);
+        REQUIRE(body[0]->getNodeType() == ASTNode::NUMBER_LITERAL);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(body[0])->getLiteralValue() == "10");
+
+        REQUIRE(typeChecker.checkAST(ast));
+    }
+
+    SECTION("Dead branches and code after returns are removed once type checked") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                main<Function<Number>> = () -> {
+                    if (1 > 2) {
+                        return 1
+                    } else if (true) {
+                        return 2
+                    } else {
+                        return 3
+                    }
+
+                    return 4
+                }
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().optimizeCheckedAST(ast);
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements()[0];
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+        vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements();
+
+        REQUIRE(body.size() == 1);
+        REQUIRE(body[0]->getNodeType() == ASTNode::BLOCK);
+        REQUIRE(body[0]->getParent() == funcDecl->getDefinition());
+
+        vector<shared_ptr<ASTNode>> branch = dynamic_pointer_cast<ASTNodeList>(body[0])->getElements();
+
+        REQUIRE(branch.size() == 1);
+        REQUIRE(branch[0]->getNodeType() == ASTNode::RETURN);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(branch[0]->getValue())->getLiteralValue() == "2");
+    }
+
+    SECTION("Capsule functions the exports can't reach are removed") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                helper<Function<Number, Number>> = (n<Number>) -> n * n
+                unused<Function<Number>> = () -> 2
+                main<Function<Number, Number>> = (x<Number>) -> helper(x + 1)
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().setExports({ "main" });
+        Compiler::getInstance().optimizeCheckedAST(ast);
+        Compiler::getInstance().setExports({});
+
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+
+        REQUIRE(elements.size() == 2);
+        REQUIRE(dynamic_pointer_cast<IdentifierNode>(elements[0]->getLeft())->getIdentifier() == "helper");
+        REQUIRE(dynamic_pointer_cast<IdentifierNode>(elements[1]->getLeft())->getIdentifier() == "main");
+    }
+
+    SECTION("Functions referenced only beside a node's value are kept") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                helper<Function<Number, Number>> = (n<Number>) -> n * n
+                main<Function<Number, Number>> = (x<Number>) -> x + helper(x)
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(elements[1]->getRight());
+        shared_ptr<ASTNode> sum = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements()[0];
+
+        // The call to helper now sits only in the right of a node that also has a value
+        sum->setValue(make_shared<LiteralNode>(ASTNode::NUMBER_LITERAL, "0", sum));
+
+        PassManager passManager({ make_shared<DeadCodeEliminationPass>(set<string>{ "main" }) });
+        passManager.run(ast);
+
+        elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+
+        REQUIRE(elements.size() == 2);
+        REQUIRE(dynamic_pointer_cast<IdentifierNode>(elements[0]->getLeft())->getIdentifier() == "helper");
+    }
+
+    SECTION("Calls to small capsule functions are inlined and folded") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+                main<Function<Number>> = () -> double(5)
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().optimizeCheckedAST(ast);
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements()[1];
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+        vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements();
+
+        REQUIRE(body.size() == 1);
+        REQUIRE(body[0]->getNodeType() == ASTNode::NUMBER_LITERAL);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(body[0])->getLiteralValue() == "10");
+        REQUIRE(dynamic_pointer_cast<TypeDeclarationNode>(body[0]->getResolvedType())->getType() == DataTypes::NUMBER);
+        REQUIRE(body[0]->getParent() == funcDecl->getDefinition());
+    }
+
+    SECTION("Recursive functions and arguments that would be evaluated twice are not inlined") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                countdown<Function<Number, Number>> = (n<Number>) -> if (n == 0) { 0 } else { countdown(n - 1) }
+                square<Function<Number, Number>> = (n<Number>) -> n * n
+                main<Function<Number, Number>> = (x<Number>) -> square(x + 1) + countdown(x)
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().optimizeCheckedAST(ast);
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements()[2];
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+        vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements();
+
+        REQUIRE(body.size() == 1);
+        REQUIRE(body[0]->getNodeType() == ASTNode::BINARY_OPERATION);
+        REQUIRE(body[0]->getLeft()->getNodeType() == ASTNode::FUNCTION_INVOCATION);
+        REQUIRE(body[0]->getRight()->getNodeType() == ASTNode::FUNCTION_INVOCATION);
+    }
+
+    SECTION("Repeated subexpressions are computed once") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                main<Function<Number, Number, Number>> = (a<Number>, b<Number>) -> (a * b) + (a * b)
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().optimizeCheckedAST(ast);
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements()[0];
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+        vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements();
+
+        REQUIRE(body.size() == 2);
+        REQUIRE(body[0]->getNodeType() == ASTNode::ASSIGNMENT);
+        REQUIRE(body[0]->getRight()->getNodeType() == ASTNode::BINARY_OPERATION);
+        REQUIRE(body[0]->getRight()->getParent() == body[0]);
+        REQUIRE(dynamic_pointer_cast<TypeDeclarationNode>(body[0]->getResolvedType())->getType() == DataTypes::NUMBER);
+
+        string binding = dynamic_pointer_cast<IdentifierNode>(body[0]->getLeft())->getIdentifier();
+
+        REQUIRE(body[1]->getNodeType() == ASTNode::BINARY_OPERATION);
+        REQUIRE(body[1]->getLeft()->getNodeType() == ASTNode::IDENTIFIER);
+        REQUIRE(dynamic_pointer_cast<IdentifierNode>(body[1]->getLeft())->getIdentifier() == binding);
+        REQUIRE(dynamic_pointer_cast<IdentifierNode>(body[1]->getRight())->getIdentifier() == binding);
+    }
+
+    SECTION("Subexpressions that are only evaluated some of the time are not computed ahead of time") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                main<Function<Number, Boolean>> = (n<Number>) -> n == 0 || n - 1 == 0 && n - 1 == 0
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().optimizeCheckedAST(ast);
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements()[0];
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+
+        REQUIRE(dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements().size() == 1);
+    }
+
+    SECTION("Passes that don't depend on each other share a traversal") {
+        PassManager passManager({
+            make_shared<DeadCodeEliminationPass>(),
+            make_shared<SpecializationPass>(),
+            make_shared<InliningPass>(),
+            make_shared<ConstantFoldingPass>()
+        });
+
+        vector<vector<shared_ptr<OptimizationPass>>> stages = passManager.getStages();
+
+        REQUIRE(stages.size() == 2);
+        REQUIRE(stages[0].size() == 2);
+        REQUIRE(stages[0][0]->getName() == "Specialization");
+        REQUIRE(stages[0][1]->getName() == "Inlining");
+        REQUIRE(stages[1].size() == 2);
+        REQUIRE(stages[1][0]->getName() == "DeadCodeElimination");
+        REQUIRE(stages[1][1]->getName() == "ConstantFolding");
+    }
+
+    SECTION("Fused passes see each other's changes in the same traversal, and report them") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                double<Function<Number, Number>> = (x<Number>) -> x * 2
+                main<Function<Number>> = () -> double(5)
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        PhaseTimer timer;
+        PassManager passManager({ make_shared<InliningPass>(), make_shared<ConstantFoldingPass>() });
+
+        REQUIRE(passManager.run(ast, &timer));
+
+        shared_ptr<ASTNode> assignment = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements()[1];
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(assignment->getRight());
+        vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements();
+
+        REQUIRE(body[0]->getNodeType() == ASTNode::NUMBER_LITERAL);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(body[0])->getLiteralValue() == "10");
+
+        vector<PhaseTimer::Phase> phases = timer.getPhases();
+
+        REQUIRE(phases.size() == 2);
+        REQUIRE(phases[0].name == "Inlining");
+        REQUIRE(phases[0].changes == 1);
+        REQUIRE(phases[1].name == "ConstantFolding");
+        REQUIRE(phases[1].changes == 1);
+        REQUIRE(timer.toJSON().find("\"changes\":1") != string::npos);
+    }
+
+    SECTION("Curried functions applied to constants are specialized") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                multiply<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x * y
+                main<Function<Number>> = () -> {
+                    multiplyBy10<Function<Number, Number>> = multiply(10)
+                    bigger<Function<Number, Number>> = multiply(10)
+
+                    return multiplyBy10(50) + bigger(2)
+                }
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().optimizeCheckedAST(ast);
+
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+
+        // The specialization both applications share is inlined, and then isn't needed anymore
+        REQUIRE(elements.size() == 2);
+
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(elements[1]->getRight());
+        vector<shared_ptr<ASTNode>> body = dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements();
+
+        REQUIRE(body.size() == 1);
+        REQUIRE(body[0]->getNodeType() == ASTNode::RETURN);
+        REQUIRE(dynamic_pointer_cast<LiteralNode>(body[0]->getValue())->getLiteralValue() == "520");
+    }
+
+    SECTION("Partial applications whose closures escape are not specialized") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                multiply<Function<Number, Function<Number, Number>>> = (x<Number>) -> (y<Number>) -> x * y
+                main<Function<Function<Number, Number>>> = () -> {
+                    multiplyBy10<Function<Number, Number>> = multiply(10)
+
+                    return multiplyBy10
+                }
+            }
+        )");
+
+        REQUIRE(typeChecker.checkAST(ast));
+
+        Compiler::getInstance().optimizeCheckedAST(ast);
+
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+        shared_ptr<FunctionDeclarationNode> funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(elements[1]->getRight());
+
+        REQUIRE(elements.size() == 2);
+        REQUIRE(dynamic_pointer_cast<ASTNodeList>(funcDecl->getDefinition())->getElements().size() == 2);
+    }
+
+    SECTION("Function bodies of large capsules are checked in parallel, calling each other in either direction") {
+        string source = "capsule Test {\n";
+
+        // Each function calls the one after it, and refers to the one before it, so bodies depend on signatures that
+        // are both earlier and later in the capsule
+        for (int i = 0; i < TypeChecker::PARALLEL_CHECK_CHUNK_SIZE * 4; i++) {
+            source += "  f" + to_string(i) + "<Function<Number, Number>> = (x<Number>) -> {\n";
+
+            // Functions can only be referenced without being called once they've been declared
+            if (i > 0) source += "    g<Function<Number, Number>> = f" + to_string(i - 1) + "\n";
+
+            source += "    return f" + to_string(i + 1) + "(x + 1)\n";
+            source += "  }\n";
+        }
+
+        source += "  f" + to_string(TypeChecker::PARALLEL_CHECK_CHUNK_SIZE * 4) + "<Function<Number, Number>> = (x<Number>) -> x\n";
+        source += "}\n";
+
+        shared_ptr<ASTNode> ast = setup(source);
+
+        REQUIRE(typeChecker.checkAST(ast));
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 0);
+
+        vector<shared_ptr<ASTNode>> elements = dynamic_pointer_cast<ASTNodeList>(ast->getValue()->getValue())->getElements();
+        shared_ptr<TypeDeclarationNode> lastType = dynamic_pointer_cast<TypeDeclarationNode>(elements.back()->getRight()->getResolvedType());
+
+        REQUIRE(lastType->toString() == "<Function<Number, Number>>");
+    }
+
+    SECTION("Errors from function bodies checked in parallel are reported as if the capsule was checked in order") {
+        string source = "capsule Test {\n";
+
+        for (int i = 0; i < TypeChecker::PARALLEL_CHECK_CHUNK_SIZE * 4; i++) {
+            // Only the first error is reported, since checking stops at the first invalid element
+            if (i == 21) {
+                source += "  f21<Function<Number, Number>> = (x<Number>) -> twentyOne\n";
+            } else if (i == 43) {
+                source += "  f43<Function<Number, Number>> = (x<Number>) -> 'forty three'\n";
+            } else {
+                source += "  f" + to_string(i) + "<Function<Number, Number>> = (x<Number>) -> x + 1\n";
+            }
+        }
+
+        source += "}\n";
+
+        // However the chunks happen to be scheduled
+        for (int attempt = 0; attempt < 5; attempt++) {
+            shared_ptr<ASTNode> ast = setup(source);
+            TypeChecker checker;
+
+            REQUIRE(!checker.checkAST(ast));
+            REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+            REQUIRE(dynamic_pointer_cast<ReferenceError>(Compiler::getInstance().getEncounteredExceptions()[0]));
+        }
+    }
+
+    SECTION("Errors found inside an exception scope are kept out of the compiler's list") {
+        shared_ptr<ASTNode> ast = setup(R"(
+            capsule Test {
+                x<String> = 5
+            }
+        )");
+
+        bool isValid;
+        vector<shared_ptr<Error>> scopedExceptions;
+
+        {
+            Compiler::ExceptionScope scope;
+            isValid = typeChecker.checkAST(ast);
+            scopedExceptions = scope.exceptions;
+        }
+
+        REQUIRE(!isValid);
+        REQUIRE(scopedExceptions.size() == 1);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 0);
+    }
+
+    SECTION("Structurally equal types share an interned id") {
+        TypeInterner &interner = TypeInterner::getInstance();
+
+        shared_ptr<TypeDeclarationNode> first = make_shared<TypeDeclarationNode>(DataTypes::LIST, nullptr);
+        first->setValue(make_shared<TypeDeclarationNode>(DataTypes::NUMBER, first));
+
+        shared_ptr<TypeDeclarationNode> second = make_shared<TypeDeclarationNode>(DataTypes::LIST, nullptr);
+        second->setValue(make_shared<TypeDeclarationNode>(DataTypes::NUMBER, second));
+
+        shared_ptr<TypeDeclarationNode> strings = make_shared<TypeDeclarationNode>(DataTypes::LIST, nullptr);
+        strings->setValue(make_shared<TypeDeclarationNode>(DataTypes::STRING, strings));
+
+        REQUIRE(interner.getId(first) == interner.getId(second));
+        REQUIRE(interner.intern(first) == interner.intern(second));
+        REQUIRE(interner.getId(first) != interner.getId(strings));
+        REQUIRE(TypeChecker::isSameType(first, second));
+        REQUIRE(!TypeChecker::isSameType(first, strings));
+
+        // Changing a type, even deep inside it, has to give it the id of what it now is
+        dynamic_pointer_cast<TypeDeclarationNode>(second->getValue())->setType(DataTypes::STRING);
+
+        REQUIRE(interner.getId(second) == interner.getId(strings));
+        REQUIRE(interner.getId(first) != interner.getId(second));
+
+        // Only the changed type and the types it is part of lose their ids
+        shared_ptr<TypeDeclarationNode> nested = make_shared<TypeDeclarationNode>(DataTypes::LIST, nullptr);
+        shared_ptr<TypeDeclarationNode> inner = make_shared<TypeDeclarationNode>(DataTypes::LIST, nested);
+        inner->setValue(make_shared<TypeDeclarationNode>(DataTypes::NUMBER, inner));
+        nested->setValue(inner);
+
+        int nestedId = interner.getId(nested);
+        dynamic_pointer_cast<TypeDeclarationNode>(inner->getValue())->setType(DataTypes::STRING);
+
+        REQUIRE(nested->getInternedId() == -1);
+        REQUIRE(first->getInternedId() >= 0);
+        REQUIRE(interner.getId(nested) != nestedId);
+        REQUIRE(interner.getId(inner) == interner.getId(strings));
+    }
+
+    SECTION("Type errors in linked capsules are reported") {
+        Compiler::getInstance().clearExceptions();
+
+        vector<char> wasm = Compiler::getInstance().compileDirect("link Theta.LinkedTypeError\n\n5 * 12.23");
+
+        REQUIRE(wasm.empty());
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 1);
+
+        Compiler::getInstance().clearExceptions();
+    }
+
+    SECTION("Compiler sessions on different threads keep their errors to themselves") {
+        Compiler::getInstance().clearExceptions();
+
+        CompilerSession first;
+        CompilerSession second;
+
+        thread firstThread([&first]() { first.compileDirect("capsule Test {\n  x<String> = 5\n}"); });
+        thread secondThread([&second]() { second.compileDirect("capsule Test {\n  x<String> = 5\n  y<Number> = 'a'\n}"); });
+
+        firstThread.join();
+        secondThread.join();
+
+        REQUIRE(first.getEncounteredExceptions().size() == 1);
+        REQUIRE(second.getEncounteredExceptions().size() == 1);
+        REQUIRE(Compiler::getInstance().getEncounteredExceptions().size() == 0);
+    }
 }